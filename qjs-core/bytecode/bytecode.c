@@ -0,0 +1,1613 @@
+#include "bytecode.h"
+#include "jit.h"
+
+/* The final code is compact: the frequent operations have one byte
+   forms without operand (push_0, get_loc1, call2...), the jumps take
+   the smallest offset which fits, and the atoms and constant pool
+   indexes are LEB128 indexes in the function tables. The line numbers
+   are kept aside in a delta encoded pc2line table.
+
+   A peephole pass removes the dead code and the jumps to the next
+   instruction, threads the jumps to jumps, and fuses the frequent
+   sequences into superinstructions (get_loc_get_field, add_i8,
+   lt_if_false...), so that the interpreter dispatches less.
+
+   The captured variables which are no longer modified once the
+   closures are created are copied in the closures instead of being
+   shared in a JSVarRef (see js_select_copied_vars()). */
+
+const JSOpCode opcode_info[OP_TEMP_END] = {
+#define FMT(f)
+#define DEF(id, size, n_pop, n_push, f) { #id, size, n_pop, n_push, OP_FMT_ ## f },
+#include "qjs-opcode.h"
+#undef DEF
+#undef FMT
+};
+
+#define JS_STACK_SIZE_MAX 65534
+
+int js_opcode_size(const uint8_t *pc)
+{
+    const JSOpCode *oi = &opcode_info[*pc];
+    const uint8_t *p = pc + 1;
+
+    switch(oi->fmt) {
+    case OP_FMT_atom:
+    case OP_FMT_const:
+        js_bc_get_leb128(&p);
+        return p - pc;
+    case OP_FMT_atom_u8:
+        js_bc_get_leb128(&p);
+        return p - pc + 1;
+    case OP_FMT_loc8_atom:
+    case OP_FMT_arg8_atom:
+        p++;
+        js_bc_get_leb128(&p);
+        return p - pc;
+    default:
+        return oi->size;
+    }
+}
+
+int js_opcode_n_pop(const uint8_t *pc)
+{
+    const JSOpCode *oi = &opcode_info[*pc];
+
+    switch(oi->fmt) {
+    case OP_FMT_npop:
+        return oi->n_pop + get_u16(pc + 1);
+    case OP_FMT_npopx:
+        return oi->n_pop + *pc - OP_call0;
+    default:
+        return oi->n_pop;
+    }
+}
+
+static int leb128_size(uint32_t v)
+{
+    int n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static void *js_dbuf_realloc(void *opaque, void *ptr, size_t size)
+{
+    return js_realloc_rt(opaque, ptr, size);
+}
+
+void js_dbuf_init(JSContext *ctx, DynBuf *s)
+{
+    dbuf_init2(s, ctx->rt, js_dbuf_realloc);
+}
+
+/* atom table of the function being finalized */
+typedef struct AtomIndexMap {
+    JSContext *ctx;
+    JSAtom *atoms;
+    int count;
+    int size;
+    uint32_t *hash; /* index + 1, 0 = free */
+    uint32_t hash_mask;
+} AtomIndexMap;
+
+static int atom_index_resize(AtomIndexMap *m, int new_size)
+{
+    uint32_t *hash, h;
+    JSAtom *atoms;
+    int i;
+
+    atoms = js_realloc(m->ctx, m->atoms, sizeof(atoms[0]) * new_size);
+    if (!atoms)
+        return -1;
+    m->atoms = atoms;
+    hash = js_mallocz(m->ctx, sizeof(hash[0]) * new_size * 2);
+    if (!hash)
+        return -1;
+    js_free(m->ctx, m->hash);
+    m->hash = hash;
+    m->hash_mask = new_size * 2 - 1;
+    m->size = new_size;
+    for(i = 0; i < m->count; i++) {
+        h = (atoms[i] * 0x9e3779b1) & m->hash_mask;
+        while (hash[h] != 0)
+            h = (h + 1) & m->hash_mask;
+        hash[h] = i + 1;
+    }
+    return 0;
+}
+
+/* return the index of 'atom' or -1 if error */
+static int atom_index_get(AtomIndexMap *m, JSAtom atom)
+{
+    uint32_t h = 0, idx;
+
+    if (m->size > 0) {
+        h = (atom * 0x9e3779b1) & m->hash_mask;
+        while ((idx = m->hash[h]) != 0) {
+            if (m->atoms[idx - 1] == atom)
+                return idx - 1;
+            h = (h + 1) & m->hash_mask;
+        }
+    }
+    if (m->count >= m->size) {
+        if (atom_index_resize(m, max_int(m->size * 2, 16)))
+            return -1;
+        h = (atom * 0x9e3779b1) & m->hash_mask;
+        while (m->hash[h] != 0)
+            h = (h + 1) & m->hash_mask;
+    }
+    m->hash[h] = m->count + 1;
+    m->atoms[m->count] = JS_DupAtom(m->ctx, atom);
+    return m->count++;
+}
+
+/* raw instruction and its final encoding */
+typedef struct RawInsn {
+    int pos; /* in the raw code */
+    int offset; /* in the final code */
+    int label; /* jump target, -1 if not a jump */
+    /* atom, constant pool index or label number (OP_label). The atoms
+       become indexes in the atom table of the function. */
+    uint32_t arg;
+    uint8_t op; /* raw opcode, then final opcode. OP_invalid if removed. */
+    uint8_t size; /* final size, 0 for the labels, line numbers and
+                     removed instructions */
+} RawInsn;
+
+static BOOL is_short_jump(int op)
+{
+    return op == OP_goto8 || op == OP_goto16 ||
+        op == OP_if_false8 || op == OP_if_true8 ||
+        (op >= OP_lt_if_false8 && op <= OP_gte_if_false8);
+}
+
+/* take the next larger jump form if the offset does not fit */
+static BOOL relax_jump(RawInsn *insn, int diff)
+{
+    switch(insn->op) {
+    case OP_goto8:
+        if (diff == (int8_t)diff)
+            return FALSE;
+        if (diff == (int16_t)diff) {
+            insn->op = OP_goto16;
+            insn->size = 3;
+        } else {
+            insn->op = OP_goto;
+            insn->size = 5;
+        }
+        return TRUE;
+    case OP_goto16:
+        if (diff == (int16_t)diff)
+            return FALSE;
+        insn->op = OP_goto;
+        insn->size = 5;
+        return TRUE;
+    case OP_if_false8:
+    case OP_if_true8:
+        if (diff == (int8_t)diff)
+            return FALSE;
+        insn->op = insn->op - OP_if_false8 + OP_if_false;
+        insn->size = 5;
+        return TRUE;
+    case OP_lt_if_false8:
+    case OP_lte_if_false8:
+    case OP_gt_if_false8:
+    case OP_gte_if_false8:
+        if (diff == (int8_t)diff)
+            return FALSE;
+        insn->op = insn->op - OP_lt_if_false8 + OP_lt_if_false;
+        insn->size = 5;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* short form of the operations on the locals, the arguments and the
+   closure variables. 'op' is get_x, put_x or set_x. */
+static void select_var_op(RawInsn *insn, int op, int idx, int op_short,
+                          int op_8)
+{
+    if (idx < 4) {
+        insn->op = op_short + idx;
+        insn->size = 1;
+    } else if (idx < 256 && op_8 != OP_invalid) {
+        insn->op = op_8;
+        insn->size = 2;
+    } else {
+        insn->op = op;
+        insn->size = 3;
+    }
+}
+
+static void pc2line_put(DynBuf *dbuf, int diff_pc, int diff_line)
+{
+    if (diff_line >= PC2LINE_BASE &&
+        diff_line < PC2LINE_BASE + PC2LINE_RANGE &&
+        diff_pc <= PC2LINE_DIFF_PC_MAX) {
+        dbuf_putc(dbuf, (diff_line - PC2LINE_BASE) +
+                  diff_pc * PC2LINE_RANGE + PC2LINE_OP_FIRST);
+    } else {
+        dbuf_putc(dbuf, 0);
+        dbuf_put_leb128(dbuf, diff_pc);
+        dbuf_put_sleb128(dbuf, diff_line);
+    }
+}
+
+typedef struct StackSizeState {
+    int bc_len;
+    int stack_len_max;
+    uint16_t *stack_level_tab;
+    /* position of the innermost catch instruction whose offset is on
+       the stack, -1 if none */
+    int *catch_pos_tab;
+    /* entry of the innermost finally block whose return address is on
+       the stack, -1 if none */
+    int *finally_pos_tab;
+    /* for a finally entry, the finally level of the gosubs to it */
+    int *finally_parent_tab;
+    int *pc_stack;
+    int pc_stack_len;
+} StackSizeState;
+
+/* 'pos' is reached with 'stack_len' values on the stack */
+static int ss_check(JSContext *ctx, StackSizeState *s,
+                    int pos, int op, int stack_len, int catch_pos,
+                    int finally_pos)
+{
+    if ((unsigned)pos >= s->bc_len) {
+        JS_ThrowInternalError(ctx, "bytecode buffer overflow (op %s, pc %d)",
+                              opcode_info[op].name, pos);
+        return -1;
+    }
+    if (stack_len > s->stack_len_max) {
+        s->stack_len_max = stack_len;
+        if (s->stack_len_max > JS_STACK_SIZE_MAX) {
+            JS_ThrowInternalError(ctx, "stack overflow (op %s, pc %d)",
+                                  opcode_info[op].name, pos);
+            return -1;
+        }
+    }
+    if (s->stack_level_tab[pos] != 0xffff) {
+        /* already explored */
+        if (s->stack_level_tab[pos] != stack_len) {
+            JS_ThrowInternalError(ctx, "inconsistent stack size: %d %d (pc=%d)",
+                                  s->stack_level_tab[pos], stack_len, pos);
+            return -1;
+        }
+        if (s->catch_pos_tab[pos] != catch_pos) {
+            JS_ThrowInternalError(ctx, "inconsistent catch position: %d %d (pc=%d)",
+                                  s->catch_pos_tab[pos], catch_pos, pos);
+            return -1;
+        }
+        if (s->finally_pos_tab[pos] != finally_pos) {
+            JS_ThrowInternalError(ctx, "inconsistent finally position: %d %d (pc=%d)",
+                                  s->finally_pos_tab[pos], finally_pos, pos);
+            return -1;
+        }
+        return 0;
+    }
+    s->stack_level_tab[pos] = stack_len;
+    s->catch_pos_tab[pos] = catch_pos;
+    s->finally_pos_tab[pos] = finally_pos;
+    s->pc_stack[s->pc_stack_len++] = pos;
+    return 0;
+}
+
+static int jump_target(const uint8_t *bc, int pos)
+{
+    switch(opcode_info[bc[pos]].fmt) {
+    case OP_FMT_label8:
+        return pos + 1 + (int8_t)bc[pos + 1];
+    case OP_FMT_label16:
+        return pos + 1 + get_i16(bc + pos + 1);
+    default:
+        return pos + 1 + get_i32(bc + pos + 1);
+    }
+}
+
+/* maximum stack depth, found by following all the paths of the code.
+   The catch offsets on the stack are tracked for nip_catch, which
+   drops the values up to the innermost one. The return addresses of
+   the finally blocks are tracked for ret: it must pop the address
+   pushed by gosub, so that it resumes after a gosub with the stack
+   depth of that gosub. */
+static int compute_stack_size(JSContext *ctx, JSFunctionBytecode *b)
+{
+    StackSizeState s_s, *s = &s_s;
+    const uint8_t *bc = b->byte_code_buf;
+    int i, pos, pos_next, op, stack_len, stack_keep, n_pop, catch_pos;
+    int finally_pos, target;
+
+    s->bc_len = b->byte_code_len;
+    s->stack_len_max = 0;
+    s->pc_stack_len = 0;
+    s->stack_level_tab = js_malloc(ctx, sizeof(s->stack_level_tab[0]) *
+                                   s->bc_len);
+    s->catch_pos_tab = js_malloc(ctx, sizeof(s->catch_pos_tab[0]) *
+                                 s->bc_len);
+    s->finally_pos_tab = js_malloc(ctx, sizeof(s->finally_pos_tab[0]) *
+                                   s->bc_len);
+    s->finally_parent_tab = js_malloc(ctx, sizeof(s->finally_parent_tab[0]) *
+                                      s->bc_len);
+    s->pc_stack = js_malloc(ctx, sizeof(s->pc_stack[0]) * s->bc_len);
+    if (!s->stack_level_tab || !s->catch_pos_tab || !s->finally_pos_tab ||
+        !s->finally_parent_tab || !s->pc_stack)
+        goto fail;
+    for(i = 0; i < s->bc_len; i++) {
+        s->stack_level_tab[i] = 0xffff;
+        s->finally_parent_tab[i] = -2;
+    }
+
+    if (ss_check(ctx, s, 0, OP_invalid, 0, -1, -1))
+        goto fail;
+    while (s->pc_stack_len > 0) {
+        pos = s->pc_stack[--s->pc_stack_len];
+        stack_len = s->stack_level_tab[pos];
+        catch_pos = s->catch_pos_tab[pos];
+        finally_pos = s->finally_pos_tab[pos];
+        op = bc[pos];
+        if (op == OP_invalid || op >= OP_TEMP_START) {
+            JS_ThrowInternalError(ctx, "invalid opcode (pc=%d)", pos);
+            goto fail;
+        }
+        pos_next = pos + js_opcode_size(bc + pos);
+        n_pop = js_opcode_n_pop(bc + pos);
+        if (stack_len < n_pop) {
+            JS_ThrowInternalError(ctx, "stack underflow (op %s, pc %d)",
+                                  opcode_info[op].name, pos);
+            goto fail;
+        }
+        if (op == OP_ret) {
+            /* the return address must be on top of the stack */
+            if (finally_pos < 0 ||
+                s->stack_level_tab[finally_pos] != stack_len) {
+                JS_ThrowInternalError(ctx, "unbalanced ret (pc %d)", pos);
+                goto fail;
+            }
+            continue;
+        }
+        if (op == OP_nip_catch) {
+            if (catch_pos < 0) {
+                JS_ThrowInternalError(ctx, "no catch offset (pc %d)", pos);
+                goto fail;
+            }
+            /* the value replaces the catch offset */
+            stack_keep = s->stack_level_tab[catch_pos];
+            stack_len = stack_keep + 1;
+            catch_pos = s->catch_pos_tab[catch_pos];
+        } else {
+            /* the catch offsets popped by the instruction */
+            stack_keep = stack_len - n_pop;
+            while (catch_pos >= 0 &&
+                   s->stack_level_tab[catch_pos] >= stack_keep)
+                catch_pos = s->catch_pos_tab[catch_pos];
+            stack_len += opcode_info[op].n_push - n_pop;
+        }
+        /* the return addresses popped by the instruction. A value
+           pushed back in the same slot is not a return address. */
+        while (finally_pos >= 0 &&
+               s->stack_level_tab[finally_pos] - 1 >= stack_keep)
+            finally_pos = s->finally_parent_tab[finally_pos];
+        switch(op) {
+        case OP_return:
+        case OP_return_undef:
+        case OP_throw:
+        case OP_throw_error:
+            continue;
+        case OP_goto8:
+        case OP_goto16:
+        case OP_goto:
+            if (ss_check(ctx, s, jump_target(bc, pos), op, stack_len,
+                         catch_pos, finally_pos))
+                goto fail;
+            continue;
+        case OP_if_false8:
+        case OP_if_true8:
+        case OP_if_false:
+        case OP_if_true:
+        case OP_lt_if_false:
+        case OP_lte_if_false:
+        case OP_gt_if_false:
+        case OP_gte_if_false:
+        case OP_lt_if_false8:
+        case OP_lte_if_false8:
+        case OP_gt_if_false8:
+        case OP_gte_if_false8:
+            if (ss_check(ctx, s, jump_target(bc, pos), op, stack_len,
+                         catch_pos, finally_pos))
+                goto fail;
+            break;
+        case OP_catch:
+            /* the exception replaces the catch offset */
+            if (ss_check(ctx, s, jump_target(bc, pos), op, stack_len,
+                         catch_pos, finally_pos))
+                goto fail;
+            catch_pos = pos;
+            break;
+        case OP_gosub:
+            /* the finally block is entered with its return address */
+            target = jump_target(bc, pos);
+            if (s->finally_parent_tab[target] == -2) {
+                s->finally_parent_tab[target] = finally_pos;
+            } else if (s->finally_parent_tab[target] != finally_pos) {
+                JS_ThrowInternalError(ctx, "inconsistent finally position: %d %d (pc=%d)",
+                                      s->finally_parent_tab[target],
+                                      finally_pos, pos);
+                goto fail;
+            }
+            if (ss_check(ctx, s, target, op, stack_len + 1, catch_pos,
+                         target))
+                goto fail;
+            break;
+        default:
+            break;
+        }
+        if (ss_check(ctx, s, pos_next, op, stack_len, catch_pos,
+                     finally_pos))
+            goto fail;
+    }
+    b->stack_size = s->stack_len_max;
+    js_free(ctx, s->stack_level_tab);
+    js_free(ctx, s->catch_pos_tab);
+    js_free(ctx, s->finally_pos_tab);
+    js_free(ctx, s->finally_parent_tab);
+    js_free(ctx, s->pc_stack);
+    return 0;
+ fail:
+    js_free(ctx, s->stack_level_tab);
+    js_free(ctx, s->catch_pos_tab);
+    js_free(ctx, s->finally_pos_tab);
+    js_free(ctx, s->finally_parent_tab);
+    js_free(ctx, s->pc_stack);
+    return -1;
+}
+
+/* peephole optimization of the raw instructions */
+typedef struct PeepholeState {
+    const uint8_t *raw;
+    RawInsn *tab;
+    int tab_len;
+    const int *label_insn; /* index in 'tab' of each label */
+    int *label_ref; /* number of jumps to each label */
+} PeepholeState;
+
+/* the passes are bounded: a loop of gotos is never fully threaded */
+#define PEEPHOLE_MAX_PASSES 8
+#define PEEPHOLE_MAX_THREADING 16
+
+static void ph_remove(PeepholeState *s, RawInsn *insn)
+{
+    if (insn->label >= 0)
+        s->label_ref[insn->label]--;
+    insn->op = OP_invalid;
+    insn->label = -1;
+}
+
+/* the first instruction at or after 'i' which is run: the labels,
+   line numbers and removed instructions are skipped */
+static int ph_skip(PeepholeState *s, int i)
+{
+    int op;
+
+    for(; i < s->tab_len; i++) {
+        op = s->tab[i].op;
+        if (op != OP_label && op != OP_line_num && op != OP_invalid)
+            break;
+    }
+    return i;
+}
+
+/* the instruction run after a jump to 'label' */
+static int ph_jump_target(PeepholeState *s, int label)
+{
+    return ph_skip(s, s->label_insn[label] + 1);
+}
+
+/* the instruction after 'i' if no jump goes between them and they are
+   on the same line, -1 otherwise */
+static int ph_next(PeepholeState *s, int i)
+{
+    RawInsn *insn;
+
+    for(i++; i < s->tab_len; i++) {
+        insn = &s->tab[i];
+        if (insn->op == OP_invalid ||
+            (insn->op == OP_label && s->label_ref[insn->arg] == 0))
+            continue;
+        if (insn->op == OP_label || insn->op == OP_line_num)
+            return -1;
+        return i;
+    }
+    return -1;
+}
+
+/* the next instruction is never run after 'op' */
+static BOOL is_block_end(int op)
+{
+    switch(op) {
+    case OP_goto:
+    case OP_return:
+    case OP_return_undef:
+    case OP_throw:
+    case OP_throw_error:
+    case OP_ret:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* thread the jumps, remove the jumps to the next instruction and the
+   unreachable code. Return TRUE if the code was modified. */
+static BOOL ph_simplify_jumps(PeepholeState *s)
+{
+    RawInsn *insn;
+    BOOL changed;
+    int i, j, n, op;
+
+    changed = FALSE;
+    for(i = 0; i < s->tab_len; i++) {
+        insn = &s->tab[i];
+        op = insn->op;
+        if (op == OP_goto || op == OP_if_false || op == OP_if_true) {
+            for(n = 0; n < PEEPHOLE_MAX_THREADING; n++) {
+                j = ph_jump_target(s, insn->label);
+                if (j >= s->tab_len || s->tab[j].op != OP_goto ||
+                    s->tab[j].label == insn->label)
+                    break;
+                s->label_ref[insn->label]--;
+                insn->label = s->tab[j].label;
+                s->label_ref[insn->label]++;
+                changed = TRUE;
+            }
+            j = ph_jump_target(s, insn->label);
+            if (j == ph_skip(s, i + 1)) {
+                if (op == OP_goto) {
+                    ph_remove(s, insn);
+                } else {
+                    /* the conversion to a boolean has no side effect */
+                    s->label_ref[insn->label]--;
+                    insn->label = -1;
+                    insn->op = OP_drop;
+                }
+                changed = TRUE;
+            } else if (op == OP_goto && j < s->tab_len &&
+                       (s->tab[j].op == OP_return ||
+                        s->tab[j].op == OP_return_undef)) {
+                s->label_ref[insn->label]--;
+                insn->label = -1;
+                insn->op = s->tab[j].op;
+                changed = TRUE;
+            }
+        }
+        if (is_block_end(insn->op)) {
+            /* the code up to the next label used by a jump is dead */
+            for(j = i + 1; j < s->tab_len; j++) {
+                op = s->tab[j].op;
+                if (op == OP_label && s->label_ref[s->tab[j].arg] > 0)
+                    break;
+                if (op != OP_label && op != OP_line_num && op != OP_invalid) {
+                    ph_remove(s, &s->tab[j]);
+                    changed = TRUE;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+/* fuse the instruction 'i' with the next one. Return TRUE if it was
+   modified. */
+static BOOL ph_fuse(PeepholeState *s, int i)
+{
+    RawInsn *insn = &s->tab[i], *next;
+    const uint8_t *p = s->raw + insn->pos;
+    int j, op, op1;
+
+    j = ph_next(s, i);
+    if (j < 0)
+        return FALSE;
+    next = &s->tab[j];
+    op = insn->op;
+    op1 = next->op;
+    switch(op) {
+    case OP_get_loc:
+    case OP_get_arg:
+        if (op1 == OP_get_field && get_u16(p + 1) < 256) {
+            insn->op = (op == OP_get_loc) ? OP_get_loc_get_field :
+                OP_get_arg_get_field;
+            insn->arg = next->arg;
+            break;
+        }
+        return FALSE;
+    case OP_push_i32:
+        /* the i8 operand is read from the push_i32 */
+        if (op1 == OP_add && get_i32(p + 1) == (int8_t)get_i32(p + 1)) {
+            insn->op = OP_add_i8;
+            break;
+        }
+        return FALSE;
+    case OP_lt:
+    case OP_lte:
+    case OP_gt:
+    case OP_gte:
+        if (op1 == OP_if_false) {
+            insn->op = op - OP_lt + OP_lt_if_false;
+            insn->label = next->label;
+            next->label = -1;
+            break;
+        }
+        return FALSE;
+    case OP_dup:
+        /* dup, put_x -> set_x */
+        if (op1 == OP_put_loc || op1 == OP_put_arg || op1 == OP_put_var_ref) {
+            insn->op = op1 + 1;
+            insn->pos = next->pos;
+            break;
+        }
+        return FALSE;
+    case OP_put_loc:
+    case OP_put_arg:
+    case OP_put_var_ref:
+        /* put_x n, get_x n -> set_x n */
+        if (op1 == op - 1 &&
+            get_u16(p + 1) == get_u16(s->raw + next->pos + 1)) {
+            insn->op = op + 1;
+            break;
+        }
+        return FALSE;
+    case OP_set_loc:
+    case OP_set_arg:
+    case OP_set_var_ref:
+        /* set_x, drop -> put_x */
+        if (op1 == OP_drop) {
+            insn->op = op - 1;
+            break;
+        }
+        return FALSE;
+    default:
+        return FALSE;
+    }
+    ph_remove(s, next);
+    return TRUE;
+}
+
+static int js_optimize_code(JSContext *ctx, const uint8_t *raw, RawInsn *tab,
+                            int tab_len, const int *label_insn,
+                            int label_count)
+{
+    PeepholeState s_s, *s = &s_s;
+    int i, n;
+
+    s->raw = raw;
+    s->tab = tab;
+    s->tab_len = tab_len;
+    s->label_insn = label_insn;
+    s->label_ref = js_mallocz(ctx, sizeof(s->label_ref[0]) *
+                              max_int(label_count, 1));
+    if (!s->label_ref)
+        return -1;
+    for(i = 0; i < tab_len; i++) {
+        if (tab[i].label >= 0)
+            s->label_ref[tab[i].label]++;
+    }
+    for(n = 0; n < PEEPHOLE_MAX_PASSES; n++) {
+        if (!ph_simplify_jumps(s))
+            break;
+    }
+    for(i = 0; i < tab_len; i++) {
+        if (tab[i].op != OP_label && tab[i].op != OP_line_num) {
+            while (ph_fuse(s, i))
+                continue;
+        }
+    }
+    js_free(ctx, s->label_ref);
+    return 0;
+}
+
+/* set the copy of the closure variable 'idx' of 'b' and of the
+   closure variables of the inner functions which refer to it */
+static void set_closure_var_copied(JSFunctionBytecode *b, int idx,
+                                   BOOL is_copied)
+{
+    JSFunctionBytecode *b1;
+    JSClosureVar *cv;
+    int i, j;
+
+    b->closure_var[idx].is_copied = is_copied;
+    for(i = 0; i < b->cpool_count; i++) {
+        if (JS_VALUE_GET_TAG(b->cpool[i]) != JS_TAG_FUNCTION_BYTECODE)
+            continue;
+        b1 = JS_VALUE_GET_PTR(b->cpool[i]);
+        for(j = 0; j < b1->closure_var_count; j++) {
+            cv = &b1->closure_var[j];
+            if (!cv->is_local && cv->var_idx == idx)
+                set_closure_var_copied(b1, j, is_copied);
+        }
+    }
+}
+
+/* a backward jump of the code */
+typedef struct CVJump {
+    int from, to; /* indexes in the instruction table, to < from */
+} CVJump;
+
+/* Select the captured variables of 'b' which are copied in the
+   closures: they are not assigned by the closures and they are not
+   assigned by 'b' after the creation of a closure using them. The
+   code runs in the order of 'tab' except for the backward jumps, so
+   the last assignment must be before the first capture and no chain of
+   backward jumps may lead from the capture to an assignment. A jump
+   before the scope of a lexical variable is allowed: the scope is
+   entered again and creates a new variable.
+   The inner functions are set according to the variables of 'b' and
+   to its own closure variables (set later by its parent, see
+   set_closure_var_copied()). */
+static int js_select_copied_vars(JSContext *ctx, JSFunctionBytecode *b,
+                                 const uint8_t *raw, const RawInsn *tab,
+                                 int tab_len, const int *label_insn)
+{
+    JSFunctionBytecode *b1;
+    const RawInsn *insn;
+    JSClosureVar *cv;
+    JSVarDef *vd;
+    CVJump *jumps;
+    int *first_write, *last_write, *first_capture;
+    uint8_t *is_copied;
+    int n, i, j, v, op, jump_count, ret_max, gosub_min, lo, lo_min;
+    BOOL changed;
+
+    n = b->arg_count + b->var_count;
+    for(v = 0; v < n; v++) {
+        if (b->vardefs[v].is_captured)
+            break;
+    }
+    if (v == n)
+        goto set_children;
+
+    first_write = js_malloc(ctx, sizeof(first_write[0]) * n * 3 + n);
+    jumps = js_malloc(ctx, sizeof(jumps[0]) * (tab_len + 1));
+    if (!first_write || !jumps) {
+        js_free(ctx, first_write);
+        js_free(ctx, jumps);
+        return -1;
+    }
+    last_write = first_write + n;
+    first_capture = last_write + n;
+    is_copied = (uint8_t *)(first_capture + n);
+    for(v = 0; v < n; v++) {
+        first_write[v] = tab_len;
+        last_write[v] = -1;
+        first_capture[v] = tab_len;
+    }
+    jump_count = 0;
+    ret_max = -1;
+    gosub_min = tab_len;
+    for(i = 0; i < tab_len; i++) {
+        insn = &tab[i];
+        op = insn->op;
+        v = -1;
+        switch(op) {
+        case OP_put_loc:
+        case OP_set_loc:
+        case OP_put_loc_check:
+        case OP_set_loc_uninitialized:
+            v = b->arg_count + get_u16(raw + insn->pos + 1);
+            break;
+        case OP_put_arg:
+        case OP_set_arg:
+            v = get_u16(raw + insn->pos + 1);
+            break;
+        case OP_fclosure:
+            if (JS_VALUE_GET_TAG(b->cpool[insn->arg]) != JS_TAG_FUNCTION_BYTECODE)
+                break;
+            b1 = JS_VALUE_GET_PTR(b->cpool[insn->arg]);
+            for(j = 0; j < b1->closure_var_count; j++) {
+                cv = &b1->closure_var[j];
+                if (cv->is_local) {
+                    v = cv->var_idx + (cv->is_arg ? 0 : b->arg_count);
+                    first_capture[v] = min_int(first_capture[v], i);
+                }
+            }
+            v = -1;
+            break;
+        case OP_gosub:
+            /* the finally block returns after the gosub */
+            gosub_min = min_int(gosub_min, i + 1);
+            break;
+        case OP_ret:
+            ret_max = i;
+            break;
+        default:
+            break;
+        }
+        if (v >= 0) {
+            first_write[v] = min_int(first_write[v], i);
+            last_write[v] = i;
+        }
+        if (insn->label >= 0 && label_insn[insn->label] < i) {
+            jumps[jump_count].from = i;
+            jumps[jump_count].to = label_insn[insn->label];
+            jump_count++;
+        }
+    }
+    /* all the returns of the finally blocks may go to all the gosubs */
+    if (gosub_min < ret_max) {
+        jumps[jump_count].from = ret_max;
+        jumps[jump_count].to = gosub_min;
+        jump_count++;
+    }
+
+    for(v = 0; v < n; v++) {
+        vd = &b->vardefs[v];
+        is_copied[v] = FALSE;
+        if (!vd->is_captured || vd->is_closure_modified ||
+            last_write[v] >= first_capture[v])
+            continue;
+        /* 'lo' is the first instruction which can run after the
+           capture */
+        lo_min = -1;
+        if (vd->is_lexical && first_write[v] < tab_len &&
+            tab[first_write[v]].op == OP_set_loc_uninitialized)
+            lo_min = first_write[v];
+        lo = first_capture[v];
+        do {
+            changed = FALSE;
+            for(j = 0; j < jump_count; j++) {
+                if (jumps[j].from >= lo && jumps[j].to < lo &&
+                    jumps[j].to > lo_min) {
+                    lo = jumps[j].to;
+                    changed = TRUE;
+                }
+            }
+        } while (changed && lo > last_write[v]);
+        is_copied[v] = (lo > last_write[v]);
+    }
+
+    for(i = 0; i < b->cpool_count; i++) {
+        if (JS_VALUE_GET_TAG(b->cpool[i]) != JS_TAG_FUNCTION_BYTECODE)
+            continue;
+        b1 = JS_VALUE_GET_PTR(b->cpool[i]);
+        for(j = 0; j < b1->closure_var_count; j++) {
+            cv = &b1->closure_var[j];
+            if (cv->is_local) {
+                v = cv->var_idx + (cv->is_arg ? 0 : b->arg_count);
+                set_closure_var_copied(b1, j, is_copied[v]);
+            }
+        }
+    }
+    js_free(ctx, first_write);
+    js_free(ctx, jumps);
+
+ set_children:
+    /* the variables of the parents */
+    for(i = 0; i < b->cpool_count; i++) {
+        if (JS_VALUE_GET_TAG(b->cpool[i]) != JS_TAG_FUNCTION_BYTECODE)
+            continue;
+        b1 = JS_VALUE_GET_PTR(b->cpool[i]);
+        for(j = 0; j < b1->closure_var_count; j++) {
+            cv = &b1->closure_var[j];
+            if (!cv->is_local) {
+                set_closure_var_copied(b1, j,
+                                       b->closure_var[cv->var_idx].is_copied);
+            }
+        }
+    }
+    return 0;
+}
+
+int js_bytecode_finalize(JSContext *ctx, JSFunctionBytecode *b,
+                         const uint8_t *raw, int raw_len, int label_count)
+{
+    AtomIndexMap atom_map;
+    RawInsn *tab, *insn;
+    int *label_insn;
+    int tab_len, tab_size, pos, op, fmt, idx, i, code_len, ret;
+    int cur_line, last_line, last_pc, diff;
+    BOOL changed;
+    uint8_t *bc, *q;
+    const uint8_t *p;
+    DynBuf pc2line;
+
+    memset(&atom_map, 0, sizeof(atom_map));
+    atom_map.ctx = ctx;
+    tab = NULL;
+    bc = NULL;
+    ret = -1;
+    js_dbuf_init(ctx, &pc2line);
+    label_insn = js_malloc(ctx, sizeof(label_insn[0]) * max_int(label_count, 1));
+    if (!label_insn)
+        goto done;
+    for(i = 0; i < label_count; i++)
+        label_insn[i] = -1;
+
+    /* read the raw code */
+    tab_len = 0;
+    tab_size = 0;
+    for(pos = 0; pos < raw_len; pos += opcode_info[op].size) {
+        op = raw[pos];
+        assert(op < OP_TEMP_END && (op < OP_TEMP_START ||
+                                    op == OP_label || op == OP_line_num));
+        if (tab_len >= tab_size) {
+            RawInsn *new_tab;
+            tab_size = max_int(tab_size * 3 / 2, 64);
+            new_tab = js_realloc(ctx, tab, sizeof(tab[0]) * tab_size);
+            if (!new_tab)
+                goto done;
+            tab = new_tab;
+        }
+        insn = &tab[tab_len];
+        insn->pos = pos;
+        insn->label = -1;
+        insn->arg = 0;
+        insn->op = op;
+        insn->size = 0;
+        switch(op) {
+        case OP_label:
+            idx = get_u32(raw + pos + 1);
+            assert(idx < label_count);
+            label_insn[idx] = tab_len;
+            insn->arg = idx;
+            break;
+        case OP_goto:
+        case OP_if_false:
+        case OP_if_true:
+        case OP_catch:
+        case OP_gosub:
+            insn->label = get_u32(raw + pos + 1);
+            break;
+        default:
+            fmt = opcode_info[op].fmt;
+            if (fmt == OP_FMT_atom || fmt == OP_FMT_atom_u8 ||
+                fmt == OP_FMT_const)
+                insn->arg = get_u32(raw + pos + 1);
+            break;
+        }
+        tab_len++;
+    }
+
+    if (js_optimize_code(ctx, raw, tab, tab_len, label_insn, label_count))
+        goto done;
+    if (js_select_copied_vars(ctx, b, raw, tab, tab_len, label_insn))
+        goto done;
+
+    /* select the final opcodes */
+    for(i = 0; i < tab_len; i++) {
+        insn = &tab[i];
+        op = insn->op;
+        if (op == OP_label || op == OP_line_num || op == OP_invalid)
+            continue;
+        pos = insn->pos;
+        insn->size = opcode_info[op].size;
+        switch(op) {
+        case OP_push_i32:
+            {
+                int32_t val = get_i32(raw + pos + 1);
+                if (val >= -1 && val <= 7) {
+                    insn->op = OP_push_0 + val;
+                    insn->size = 1;
+                } else if (val == (int8_t)val) {
+                    insn->op = OP_push_i8;
+                    insn->size = 2;
+                } else if (val == (int16_t)val) {
+                    insn->op = OP_push_i16;
+                    insn->size = 3;
+                }
+            }
+            break;
+        case OP_get_loc:
+        case OP_put_loc:
+        case OP_set_loc:
+            select_var_op(insn, op, get_u16(raw + pos + 1),
+                          OP_get_loc0 + (op - OP_get_loc) * 4,
+                          OP_get_loc8 + (op - OP_get_loc));
+            break;
+        case OP_get_arg:
+        case OP_put_arg:
+        case OP_set_arg:
+            select_var_op(insn, op, get_u16(raw + pos + 1),
+                          OP_get_arg0 + (op - OP_get_arg) * 4, OP_invalid);
+            break;
+        case OP_get_var_ref:
+        case OP_put_var_ref:
+        case OP_set_var_ref:
+            select_var_op(insn, op, get_u16(raw + pos + 1),
+                          OP_get_var_ref0 + (op - OP_get_var_ref) * 4,
+                          OP_invalid);
+            break;
+        case OP_call:
+            idx = get_u16(raw + pos + 1);
+            if (idx < 4) {
+                insn->op = OP_call0 + idx;
+                insn->size = 1;
+            }
+            break;
+        case OP_goto:
+        case OP_if_false:
+        case OP_if_true:
+            /* start with the short jumps, relaxed below */
+            insn->op = (op == OP_goto) ? OP_goto8 : op - OP_if_false + OP_if_false8;
+            insn->size = 2;
+            break;
+        case OP_lt_if_false:
+        case OP_lte_if_false:
+        case OP_gt_if_false:
+        case OP_gte_if_false:
+            insn->op = op - OP_lt_if_false + OP_lt_if_false8;
+            insn->size = 2;
+            break;
+        default:
+            fmt = opcode_info[op].fmt;
+            if (fmt == OP_FMT_atom || fmt == OP_FMT_atom_u8 ||
+                fmt == OP_FMT_loc8_atom || fmt == OP_FMT_arg8_atom) {
+                idx = atom_index_get(&atom_map, insn->arg);
+                if (idx < 0)
+                    goto done;
+                insn->arg = idx;
+                insn->size = 1 + leb128_size(idx) + (fmt != OP_FMT_atom);
+            } else if (fmt == OP_FMT_const) {
+                assert(insn->arg < b->cpool_count);
+                insn->size = 1 + leb128_size(insn->arg);
+            }
+            break;
+        }
+    }
+
+    /* relax the jumps until all the offsets fit. The sizes only grow,
+       so it terminates. */
+    do {
+        code_len = 0;
+        for(i = 0; i < tab_len; i++) {
+            tab[i].offset = code_len;
+            code_len += tab[i].size;
+        }
+        changed = FALSE;
+        for(i = 0; i < tab_len; i++) {
+            insn = &tab[i];
+            if (insn->label >= 0 && is_short_jump(insn->op)) {
+                assert(label_insn[insn->label] >= 0);
+                diff = tab[label_insn[insn->label]].offset - (insn->offset + 1);
+                changed |= relax_jump(insn, diff);
+            }
+        }
+    } while (changed);
+
+    bc = js_malloc(ctx, max_int(code_len, 1));
+    if (!bc)
+        goto done;
+    q = bc;
+    cur_line = last_line = b->debug.line_num;
+    last_pc = 0;
+    for(i = 0; i < tab_len; i++) {
+        insn = &tab[i];
+        p = raw + insn->pos;
+        op = insn->op;
+        if (op == OP_line_num) {
+            cur_line = get_u32(p + 1);
+            continue;
+        }
+        if (insn->size == 0)
+            continue;
+        if (cur_line != last_line) {
+            pc2line_put(&pc2line, insn->offset - last_pc, cur_line - last_line);
+            last_pc = insn->offset;
+            last_line = cur_line;
+        }
+        assert(q - bc == insn->offset);
+        *q++ = op;
+        if (insn->label >= 0) {
+            diff = tab[label_insn[insn->label]].offset - (insn->offset + 1);
+            switch(opcode_info[op].fmt) {
+            case OP_FMT_label8:
+                *q++ = diff;
+                break;
+            case OP_FMT_label16:
+                put_u16(q, diff);
+                q += 2;
+                break;
+            default:
+                put_u32(q, diff);
+                q += 4;
+                break;
+            }
+            continue;
+        }
+        switch(opcode_info[op].fmt) {
+        case OP_FMT_i8:
+            *q++ = get_i32(p + 1);
+            break;
+        case OP_FMT_i16:
+            put_u16(q, get_i32(p + 1));
+            q += 2;
+            break;
+        case OP_FMT_loc8:
+            *q++ = get_u16(p + 1);
+            break;
+        case OP_FMT_loc8_atom:
+        case OP_FMT_arg8_atom:
+            /* the variable of the get_loc or get_arg */
+            *q++ = get_u16(p + 1);
+            /* fall through */
+        case OP_FMT_atom:
+        case OP_FMT_atom_u8:
+        case OP_FMT_const:
+            {
+                uint32_t v = insn->arg;
+                while (v >= 0x80) {
+                    *q++ = (v & 0x7f) | 0x80;
+                    v >>= 7;
+                }
+                *q++ = v;
+                if (opcode_info[op].fmt == OP_FMT_atom_u8)
+                    *q++ = p[5];
+            }
+            break;
+        default:
+            /* same operand as the raw instruction, if any */
+            memcpy(q, p + 1, insn->size - 1);
+            q += insn->size - 1;
+            break;
+        }
+    }
+    assert(q - bc == code_len);
+    if (dbuf_error(&pc2line)) {
+        JS_ThrowOutOfMemory(ctx);
+        goto done;
+    }
+
+    b->byte_code_buf = bc;
+    b->byte_code_len = code_len;
+    bc = NULL;
+    b->atoms = atom_map.atoms;
+    b->atom_count = atom_map.count;
+    atom_map.atoms = NULL;
+    atom_map.count = 0;
+    if (pc2line.size > 0) {
+        b->debug.pc2line_buf = js_malloc(ctx, pc2line.size);
+        if (!b->debug.pc2line_buf)
+            goto done;
+        memcpy(b->debug.pc2line_buf, pc2line.buf, pc2line.size);
+        b->debug.pc2line_len = pc2line.size;
+    }
+    ret = compute_stack_size(ctx, b);
+ done:
+    for(i = 0; i < atom_map.count; i++)
+        JS_FreeAtom(ctx, atom_map.atoms[i]);
+    js_free(ctx, atom_map.atoms);
+    js_free(ctx, atom_map.hash);
+    js_free(ctx, label_insn);
+    js_free(ctx, tab);
+    js_free(ctx, bc);
+    dbuf_free(&pc2line);
+    return ret;
+}
+
+int js_bytecode_check(JSContext *ctx, JSFunctionBytecode *b)
+{
+    const uint8_t *bc = b->byte_code_buf, *bc_end;
+    uint8_t *insn_start;
+    const JSOpCode *oi;
+    int pos, op, size, ret, target;
+    uint32_t idx, idx_max;
+
+    ret = -1;
+    bc_end = bc + b->byte_code_len;
+    insn_start = js_mallocz(ctx, max_int(b->byte_code_len, 1));
+    if (!insn_start)
+        return -1;
+    for(pos = 0; pos < b->byte_code_len; pos += size) {
+        op = bc[pos];
+        if (op == OP_invalid || op >= OP_TEMP_START)
+            goto invalid;
+        insn_start[pos] = 1;
+        oi = &opcode_info[op];
+        /* only the generators are suspended */
+        if ((op == OP_initial_yield || op == OP_yield) && !b->is_generator)
+            goto invalid;
+        idx = 0;
+        idx_max = 1;
+        switch(oi->fmt) {
+        case OP_FMT_atom:
+        case OP_FMT_atom_u8:
+        case OP_FMT_const:
+            size = get_leb128(&idx, bc + pos + 1, bc_end);
+            if (size < 0)
+                goto invalid;
+            size += 1 + (oi->fmt == OP_FMT_atom_u8);
+            if (oi->fmt == OP_FMT_const) {
+                idx_max = b->cpool_count;
+                if (op == OP_fclosure && idx < idx_max &&
+                    JS_VALUE_GET_TAG(b->cpool[idx]) != JS_TAG_FUNCTION_BYTECODE)
+                    goto invalid;
+            } else {
+                idx_max = b->atom_count;
+            }
+            break;
+        case OP_FMT_loc8_atom:
+        case OP_FMT_arg8_atom:
+            size = get_leb128(&idx, bc + pos + 2, bc_end);
+            if (size < 0 || idx >= b->atom_count)
+                goto invalid;
+            size += 2;
+            break;
+        default:
+            size = oi->size;
+            break;
+        }
+        if (size > bc_end - (bc + pos))
+            goto invalid;
+        switch(oi->fmt) {
+        case OP_FMT_none_loc:
+            idx = (op - OP_get_loc0) % 4;
+            idx_max = b->var_count;
+            break;
+        case OP_FMT_none_arg:
+            idx = (op - OP_get_loc0) % 4;
+            idx_max = b->arg_count;
+            break;
+        case OP_FMT_none_var_ref:
+            idx = (op - OP_get_loc0) % 4;
+            idx_max = b->closure_var_count;
+            break;
+        case OP_FMT_loc8:
+        case OP_FMT_loc8_atom:
+            idx = bc[pos + 1];
+            idx_max = b->var_count;
+            break;
+        case OP_FMT_arg8_atom:
+            idx = bc[pos + 1];
+            idx_max = b->arg_count;
+            break;
+        case OP_FMT_loc:
+            idx = get_u16(bc + pos + 1);
+            idx_max = b->var_count;
+            break;
+        case OP_FMT_arg:
+            idx = get_u16(bc + pos + 1);
+            idx_max = b->arg_count;
+            break;
+        case OP_FMT_var_ref:
+            idx = get_u16(bc + pos + 1);
+            idx_max = b->closure_var_count;
+            break;
+        case OP_FMT_u8:
+            if (op == OP_special_object) {
+                idx = bc[pos + 1];
+                idx_max = OP_SPECIAL_OBJECT_NEW_TARGET + 1;
+            }
+            break;
+        default:
+            break;
+        }
+        if (idx >= idx_max)
+            goto invalid;
+    }
+    /* the jumps go to the start of an instruction */
+    for(pos = 0; pos < b->byte_code_len; pos += js_opcode_size(bc + pos)) {
+        switch(opcode_info[bc[pos]].fmt) {
+        case OP_FMT_label8:
+        case OP_FMT_label16:
+        case OP_FMT_label:
+            target = jump_target(bc, pos);
+            if (target < 0 || target >= b->byte_code_len ||
+                !insn_start[target])
+                goto invalid;
+            break;
+        default:
+            break;
+        }
+    }
+    ret = compute_stack_size(ctx, b);
+    goto done;
+ invalid:
+    JS_ThrowInternalError(ctx, "invalid bytecode (pc=%d)", pos);
+ done:
+    js_free(ctx, insn_start);
+    return ret;
+}
+
+void js_free_raw_code_atoms(JSRuntime *rt, const uint8_t *raw, int raw_len)
+{
+    int pos, fmt;
+
+    for(pos = 0; pos < raw_len; pos += opcode_info[raw[pos]].size) {
+        /* the last instruction is truncated after an allocation error */
+        if (pos + opcode_info[raw[pos]].size > raw_len)
+            break;
+        fmt = opcode_info[raw[pos]].fmt;
+        if (fmt == OP_FMT_atom || fmt == OP_FMT_atom_u8 ||
+            fmt == OP_FMT_atom_u16)
+            JS_FreeAtomRT(rt, get_u32(raw + pos + 1));
+    }
+}
+
+void js_free_lazy_function(JSRuntime *rt, JSLazyFunction *lf)
+{
+    if (lf->compiled)
+        JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, lf->compiled));
+    js_free_rt(rt, lf->source);
+    js_free_rt(rt, lf);
+}
+
+void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
+{
+    int i;
+
+    for(i = 0; i < b->atom_count; i++)
+        JS_FreeAtomRT(rt, b->atoms[i]);
+    js_free_rt(rt, b->atoms);
+    js_free_ic(rt, b);
+#ifdef CONFIG_JIT
+    js_jit_free(rt, b);
+#endif
+    if (!b->read_only_bytecode) {
+        js_free_rt(rt, b->byte_code_buf);
+        js_free_rt(rt, b->debug.pc2line_buf);
+    }
+    if (b->vardefs) {
+        for(i = 0; i < b->arg_count + b->var_count; i++)
+            JS_FreeAtomRT(rt, b->vardefs[i].var_name);
+    }
+    for(i = 0; i < b->closure_var_count; i++)
+        JS_FreeAtomRT(rt, b->closure_var[i].var_name);
+    for(i = 0; i < b->cpool_count; i++)
+        JS_FreeValueRT(rt, b->cpool[i]);
+    JS_FreeAtomRT(rt, b->func_name);
+    JS_FreeAtomRT(rt, b->debug.filename);
+    if (b->lazy)
+        js_free_lazy_function(rt, b->lazy);
+
+    remove_gc_object(&b->header);
+    if (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && b->header.ref_count != 0) {
+        list_add_tail(&b->header.link, &rt->gc_zero_ref_count_list);
+    } else {
+        js_free_gc_rt(rt, b, b->header.account_id);
+    }
+}
+
+void mark_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b,
+                            JS_MarkFunc *mark_func)
+{
+    int i;
+
+    for(i = 0; i < b->cpool_count; i++)
+        JS_MarkValue(rt, b->cpool[i], mark_func);
+    if (b->lazy && b->lazy->compiled)
+        mark_func(rt, &b->lazy->compiled->header);
+}
+
+void compute_bytecode_size(JSFunctionBytecode *b, JSMemoryUsage_helper *hp)
+{
+    int memory_used_count, i;
+    double js_func_size;
+
+    memory_used_count = 0;
+    js_func_size = sizeof(*b);
+    if (b->vardefs)
+        js_func_size += (b->arg_count + b->var_count) * sizeof(*b->vardefs);
+    js_func_size += b->closure_var_count * sizeof(*b->closure_var);
+    js_func_size += b->cpool_count * sizeof(*b->cpool);
+    for(i = 0; i < b->cpool_count; i++) {
+        JSValueConst val = b->cpool[i];
+        if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING) {
+            JSString *str = JS_VALUE_GET_STRING(val);
+            hp->str_count += 1.0 / str->header.ref_count;
+            hp->str_size += (sizeof(*str) + (str->len << str->is_wide_char) +
+                             1 - str->is_wide_char) /
+                (double)str->header.ref_count;
+        }
+    }
+    if (b->atoms) {
+        memory_used_count++;
+        js_func_size += b->atom_count * sizeof(*b->atoms);
+    }
+    if (b->ic) {
+        memory_used_count++;
+        js_func_size += b->atom_count * sizeof(*b->ic);
+        for(i = 0; i < b->atom_count; i++) {
+            if (b->ic[i]) {
+                memory_used_count++;
+                js_func_size += sizeof(JSInlineCache) +
+                    b->ic[i]->size * sizeof(b->ic[i]->entries[0]);
+            }
+        }
+    }
+    /* the read-only buffers are not allocated by the runtime */
+    if (!b->read_only_bytecode && b->byte_code_buf) {
+        memory_used_count++;
+        hp->js_func_code_size += b->byte_code_len;
+    }
+    if (!b->read_only_bytecode && b->debug.pc2line_buf) {
+        memory_used_count++;
+        hp->js_func_pc2line_count += 1;
+        hp->js_func_pc2line_size += b->debug.pc2line_len;
+    }
+    /* the machine code is not allocated with malloc() */
+    if (b->jit) {
+        memory_used_count += 2;
+        js_func_size += sizeof(*b->jit) +
+            b->byte_code_len * sizeof(b->jit->pc_map[0]);
+        hp->jit_func_count += 1;
+        hp->jit_code_size += b->jit->code_size;
+    }
+    /* the compiled function is counted separately */
+    if (b->lazy) {
+        memory_used_count++;
+        js_func_size += sizeof(*b->lazy);
+        if (b->lazy->source) {
+            memory_used_count++;
+            js_func_size += b->lazy->source_len + 1;
+        }
+    }
+    hp->js_func_size += js_func_size;
+    hp->js_func_count += 1;
+    hp->memory_used_count += memory_used_count;
+}
+
+int js_bytecode_find_line_num(JSFunctionBytecode *b, uint32_t pc_value)
+{
+    const uint8_t *p_end, *p;
+    int line_num, diff_line, ret;
+    uint32_t pc, diff_pc, op, v;
+
+    line_num = b->debug.line_num;
+    p = b->debug.pc2line_buf;
+    if (!p)
+        return line_num;
+    p_end = p + b->debug.pc2line_len;
+    pc = 0;
+    while (p < p_end) {
+        op = *p++;
+        if (op == 0) {
+            ret = get_leb128(&diff_pc, p, p_end);
+            if (ret < 0)
+                break;
+            p += ret;
+            ret = get_sleb128(&diff_line, p, p_end);
+            if (ret < 0)
+                break;
+            p += ret;
+        } else {
+            v = op - PC2LINE_OP_FIRST;
+            diff_pc = v / PC2LINE_RANGE;
+            diff_line = (int)(v % PC2LINE_RANGE) + PC2LINE_BASE;
+        }
+        pc += diff_pc;
+        if (pc > pc_value)
+            break;
+        line_num += diff_line;
+    }
+    return line_num;
+}
+
+static const char *dump_var_name(JSContext *ctx, char *buf, int buf_size,
+                                 JSFunctionBytecode *b, int fmt, int idx)
+{
+    JSAtom name = JS_ATOM_NULL;
+
+    switch(fmt) {
+    case OP_FMT_loc:
+    case OP_FMT_loc8:
+    case OP_FMT_none_loc:
+    case OP_FMT_loc8_atom:
+        if (idx < b->var_count)
+            name = b->vardefs[b->arg_count + idx].var_name;
+        break;
+    case OP_FMT_arg:
+    case OP_FMT_none_arg:
+    case OP_FMT_arg8_atom:
+        if (idx < b->arg_count)
+            name = b->vardefs[idx].var_name;
+        break;
+    default:
+        if (idx < b->closure_var_count)
+            name = b->closure_var[idx].var_name;
+        break;
+    }
+    return JS_AtomGetStr(ctx, buf, buf_size, name);
+}
+
+void js_dump_function_bytecode(JSContext *ctx, DynBuf *dbuf,
+                               JSFunctionBytecode *b)
+{
+    char buf[64];
+    const uint8_t *bc = b->byte_code_buf, *p;
+    const JSOpCode *oi;
+    int pos, op, idx;
+
+    if (b->lazy) {
+        if (!b->lazy->compiled) {
+            dbuf_printf(dbuf, "function %s: not compiled, source=%u bytes\n",
+                        JS_AtomGetStr(ctx, buf, sizeof(buf), b->func_name),
+                        b->lazy->source_len);
+            return;
+        }
+        b = b->lazy->compiled;
+        bc = b->byte_code_buf;
+    }
+    dbuf_printf(dbuf, "function %s: args=%d vars=%d closure_vars=%d "
+                "stack_size=%d code=%d bytes\n",
+                JS_AtomGetStr(ctx, buf, sizeof(buf), b->func_name),
+                b->arg_count, b->var_count, b->closure_var_count,
+                b->stack_size, b->byte_code_len);
+    for(pos = 0; pos < b->byte_code_len; pos += js_opcode_size(bc + pos)) {
+        op = bc[pos];
+        oi = &opcode_info[op];
+        dbuf_printf(dbuf, "%5d: %s", pos, oi->name);
+        p = bc + pos + 1;
+        switch(oi->fmt) {
+        case OP_FMT_u8:
+            dbuf_printf(dbuf, " %u", *p);
+            break;
+        case OP_FMT_i8:
+            dbuf_printf(dbuf, " %d", (int8_t)*p);
+            break;
+        case OP_FMT_i16:
+            dbuf_printf(dbuf, " %d", get_i16(p));
+            break;
+        case OP_FMT_i32:
+            dbuf_printf(dbuf, " %d", get_i32(p));
+            break;
+        case OP_FMT_u16:
+        case OP_FMT_npop:
+            dbuf_printf(dbuf, " %u", get_u16(p));
+            break;
+        case OP_FMT_label8:
+        case OP_FMT_label16:
+        case OP_FMT_label:
+            dbuf_printf(dbuf, " %d", jump_target(bc, pos));
+            break;
+        case OP_FMT_loc8:
+            idx = *p;
+            goto has_var;
+        case OP_FMT_loc:
+        case OP_FMT_arg:
+        case OP_FMT_var_ref:
+            idx = get_u16(p);
+            dbuf_printf(dbuf, " %d", idx);
+        has_var:
+            dbuf_printf(dbuf, " ; %s", dump_var_name(ctx, buf, sizeof(buf),
+                                                     b, oi->fmt, idx));
+            break;
+        case OP_FMT_none_loc:
+        case OP_FMT_none_arg:
+        case OP_FMT_none_var_ref:
+            idx = (op - OP_get_loc0) % 4;
+            dbuf_printf(dbuf, " ; %s", dump_var_name(ctx, buf, sizeof(buf),
+                                                     b, oi->fmt, idx));
+            break;
+        case OP_FMT_const:
+            idx = js_bc_get_leb128(&p);
+            dbuf_printf(dbuf, " %d", idx);
+            break;
+        case OP_FMT_atom:
+        case OP_FMT_atom_u8:
+            idx = js_bc_get_leb128(&p);
+            dbuf_printf(dbuf, " %s", JS_AtomGetStr(ctx, buf, sizeof(buf),
+                                                   b->atoms[idx]));
+            if (oi->fmt == OP_FMT_atom_u8)
+                dbuf_printf(dbuf, ",%u", *p);
+            break;
+        case OP_FMT_loc8_atom:
+        case OP_FMT_arg8_atom:
+            idx = *p++;
+            dbuf_printf(dbuf, " %s", JS_AtomGetStr(ctx, buf, sizeof(buf),
+                                                   b->atoms[js_bc_get_leb128(&p)]));
+            goto has_var;
+        default:
+            break;
+        }
+        dbuf_putc(dbuf, '\n');
+    }
+    for(idx = 0; idx < b->cpool_count; idx++) {
+        if (JS_VALUE_GET_TAG(b->cpool[idx]) == JS_TAG_FUNCTION_BYTECODE) {
+            dbuf_putc(dbuf, '\n');
+            js_dump_function_bytecode(ctx, dbuf,
+                                      JS_VALUE_GET_PTR(b->cpool[idx]));
+        }
+    }
+}
@@ -0,0 +1,260 @@
+#ifndef QJS_BYTECODE_H
+#define QJS_BYTECODE_H
+#include "context.h"
+
+typedef enum OPCodeFormat {
+#define FMT(f) OP_FMT_ ## f,
+#define DEF(id, size, n_pop, n_push, f)
+#include "qjs-opcode.h"
+#undef DEF
+#undef FMT
+} OPCodeFormat;
+
+enum OPCodeEnum {
+#define FMT(f)
+#define DEF(id, size, n_pop, n_push, f) OP_ ## id,
+#include "qjs-opcode.h"
+#undef DEF
+#undef FMT
+    OP_TEMP_END,
+};
+
+/* the opcodes of the final code are below OP_TEMP_START */
+#define OP_TEMP_START OP_enter_scope
+
+typedef struct JSOpCode {
+    const char *name;
+    uint8_t size; /* size of the raw instruction, in bytes */
+    /* the stack effect. The npop formats pop their operand too. */
+    uint8_t n_pop;
+    uint8_t n_push;
+    uint8_t fmt;
+} JSOpCode;
+
+extern const JSOpCode opcode_info[];
+
+/* operand of OP_special_object */
+typedef enum {
+    OP_SPECIAL_OBJECT_THIS_FUNC,
+    OP_SPECIAL_OBJECT_NEW_TARGET,
+} OPSpecialObjectEnum;
+
+/* operand of OP_throw_error */
+#define JS_THROW_VAR_RO             0
+#define JS_THROW_VAR_UNINITIALIZED  1
+
+typedef struct JSVarDef {
+    JSAtom var_name;
+    /* the lexical variables are declared in scope_level > 0 and are
+       linked by scope_next in the scope chain */
+    int scope_level;
+    int scope_next; /* -1 if last */
+    uint8_t is_const : 1;
+    uint8_t is_lexical : 1;
+    uint8_t is_captured : 1; /* referenced by a closure */
+    uint8_t is_func_var : 1; /* name of a function expression */
+    /* assigned by a closure. Only used by the compilation of the
+       function. */
+    uint8_t is_closure_modified : 1;
+    /* hoisted function declaration: its index in the constant pool,
+       -1 otherwise */
+    int func_pool_idx;
+} JSVarDef;
+
+typedef struct JSClosureVar {
+    uint8_t is_local : 1; /* variable of the parent function, else
+                             closure variable of the parent */
+    uint8_t is_arg : 1;
+    uint8_t is_const : 1;
+    uint8_t is_lexical : 1;
+    /* the variable is not modified after the creation of the closure:
+       its value is copied (see JSVarCell) */
+    uint8_t is_copied : 1;
+    uint16_t var_idx; /* index in the parent vars, args or closure vars */
+    JSAtom var_name;
+} JSClosureVar;
+
+/* Inline caches of the property accesses. There is one cache per
+   atom of a function, shared by the get/put instructions using the
+   atom: an entry only depends on the shape of the object. A hit gives
+   the property in the object, or in its prototype if the property is
+   not an own property. The entries are not references: a shape is
+   identified by its address and its version, which changes when the
+   shape is modified in place. */
+#define JS_IC_MAX_ENTRIES 4 /* polymorphic cache size */
+
+typedef struct JSInlineCacheEntry {
+    JSShape *shape; /* shape of the object */
+    uint32_t version; /* version of 'shape' */
+    uint32_t prop_idx; /* index of the property in the holder */
+    /* the holder is the object if 'proto' is NULL. Otherwise it is
+       the prototype of the object, which must be 'proto' with the
+       shape 'proto_shape'. */
+    JSObject *proto;
+    JSShape *proto_shape;
+    uint32_t proto_version;
+    uint8_t prop_flags; /* JS_PROP_XXX */
+} JSInlineCacheEntry;
+
+typedef struct JSInlineCache {
+    uint8_t count;
+    uint8_t size; /* allocated entries */
+    uint8_t next; /* next entry replaced when the cache is full */
+    JSInlineCacheEntry entries[0];
+} JSInlineCache;
+
+/* Inner function created by the parser without its code: it is
+   compiled from its source on the first call (see
+   JS_EVAL_FLAG_EAGER). Only its closure variables are known, they are
+   resolved with the code of the parent. */
+typedef struct JSLazyFunction {
+    /* the compiled function, shared by all the closures. NULL if not
+       compiled yet. */
+    struct JSFunctionBytecode *compiled;
+    uint8_t func_type; /* JSParseFunctionEnum of the parser */
+    uint8_t is_func_expr : 1;
+    uint8_t is_parent_strict : 1;
+    int line_num; /* line of the source start */
+    /* the arguments and the body, null terminated. Freed when
+       compiled. */
+    uint8_t *source;
+    uint32_t source_len;
+} JSLazyFunction;
+
+/* A compiled function. It is shared by all the closures of the
+   function and does not depend on a context: it can be run in any
+   context of the runtime. */
+typedef struct JSFunctionBytecode {
+    JSGCObjectHeader header; /* must come first */
+    uint8_t is_strict : 1;
+    uint8_t is_arrow : 1; /* lexical this */
+    uint8_t has_prototype : 1; /* constructor */
+    uint8_t is_generator : 1; /* the calls return a generator object */
+    /* byte_code_buf and debug.pc2line_buf are not owned (read from a
+       buffer kept by the caller, see JS_READ_OBJ_ROM_DATA) */
+    uint8_t read_only_bytecode : 1;
+    uint8_t jit_disabled : 1; /* not compiled or its code is not used */
+    uint8_t *byte_code_buf;
+    int byte_code_len;
+    JSAtom func_name;
+    /* the atom operands of the code are indexes in this table, so that
+       the code does not depend on the atom numbers of the runtime */
+    JSAtom *atoms;
+    int atom_count;
+    JSVarDef *vardefs; /* arguments + local variables */
+    JSClosureVar *closure_var;
+    uint16_t arg_count;
+    uint16_t var_count;
+    uint16_t defined_arg_count; /* the length of the function */
+    uint16_t stack_size; /* maximum stack depth */
+    JSValue *cpool; /* numbers, strings and inner functions */
+    int cpool_count;
+    int closure_var_count;
+    /* atom_count inline caches, allocated on the first miss */
+    JSInlineCache **ic;
+    struct {
+        JSAtom filename;
+        int line_num; /* line of the function start */
+        int pc2line_len;
+        uint8_t *pc2line_buf;
+    } debug;
+    /* not NULL if the function has no code yet: only the closure
+       variables, the name, the flags and defined_arg_count are set */
+    JSLazyFunction *lazy;
+    /* machine code of the hot functions (see jit.h) */
+    int jit_counter;
+    struct JSJitCode *jit;
+} JSFunctionBytecode;
+
+/* pc2line: the entries are the (pc, line) deltas from the previous
+   entry, starting from (0, debug.line_num). The usual small deltas
+   take one byte: PC2LINE_OP_FIRST + diff_line - PC2LINE_BASE +
+   diff_pc * PC2LINE_RANGE. The other ones are 0 followed by
+   leb128(diff_pc) and sleb128(diff_line). */
+#define PC2LINE_BASE     (-1)
+#define PC2LINE_RANGE    5
+#define PC2LINE_OP_FIRST 1
+#define PC2LINE_DIFF_PC_MAX ((255 - PC2LINE_OP_FIRST) / PC2LINE_RANGE)
+
+/* the code was validated when it was created: the operands are
+   decoded without bound checks */
+static inline uint32_t js_bc_get_leb128(const uint8_t **pp)
+{
+    const uint8_t *p = *pp;
+    uint32_t v, a;
+    int shift;
+
+    v = *p++;
+    if (likely(v < 0x80)) {
+        *pp = p;
+        return v;
+    }
+    v &= 0x7f;
+    shift = 7;
+    do {
+        a = *p++;
+        v |= (a & 0x7f) << shift;
+        shift += 7;
+    } while (a & 0x80);
+    *pp = p;
+    return v;
+}
+
+JSProperty *js_ic_lookup(JSRuntime *rt, JSFunctionBytecode *b,
+                         int atom_idx, JSObject *p, BOOL is_put);
+
+/* the property 'atom_idx' of 'p' (own or prototype property if is_put
+   = FALSE, writable own property otherwise) or NULL if it must be
+   accessed with the generic functions. Only the first entry is tested
+   inline: most of the accesses see a single shape. */
+static inline JSProperty *js_ic_get_prop(JSRuntime *rt, JSFunctionBytecode *b,
+                                         int atom_idx, JSObject *p,
+                                         BOOL is_put)
+{
+    JSInlineCache *ic;
+    JSInlineCacheEntry *e;
+    JSShape *sh = p->shape;
+
+    if (likely(b->ic != NULL) && (ic = b->ic[atom_idx]) != NULL) {
+        e = &ic->entries[0];
+        if (likely(e->shape == sh && e->version == sh->version &&
+                   !e->proto &&
+                   (!is_put || (e->prop_flags & JS_PROP_WRITABLE))))
+            return &p->prop[e->prop_idx];
+    }
+    return js_ic_lookup(rt, b, atom_idx, p, is_put);
+}
+void js_free_ic(JSRuntime *rt, JSFunctionBytecode *b);
+
+/* DynBuf allocated with js_realloc_rt() */
+void js_dbuf_init(JSContext *ctx, DynBuf *s);
+/* size of the final instruction at 'pc' */
+int js_opcode_size(const uint8_t *pc);
+/* number of values popped by the final instruction at 'pc' */
+int js_opcode_n_pop(const uint8_t *pc);
+
+/* Build the final code of 'b' from the raw code of the compiler: the
+   labels are resolved, the short forms are selected, the atoms and the
+   constant pool indexes are encoded, and the pc2line table and the
+   stack size are computed. The raw code keeps its atom references.
+   Return -1 if error. */
+int js_bytecode_finalize(JSContext *ctx, JSFunctionBytecode *b,
+                         const uint8_t *raw, int raw_len, int label_count);
+/* Check final code coming from outside the compiler: the instructions,
+   their operands and the jump targets must be valid for 'b'. The stack
+   size is recomputed. Return -1 if error. */
+int js_bytecode_check(JSContext *ctx, JSFunctionBytecode *b);
+/* release the atom operands of raw code */
+void js_free_raw_code_atoms(JSRuntime *rt, const uint8_t *raw, int raw_len);
+void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b);
+void js_free_lazy_function(JSRuntime *rt, JSLazyFunction *lf);
+void mark_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b,
+                            JS_MarkFunc *mark_func);
+void compute_bytecode_size(JSFunctionBytecode *b, JSMemoryUsage_helper *hp);
+/* source line of the instruction at 'pc' */
+int js_bytecode_find_line_num(JSFunctionBytecode *b, uint32_t pc);
+/* disassemble 'b' (and its inner functions) */
+void js_dump_function_bytecode(JSContext *ctx, DynBuf *dbuf,
+                               JSFunctionBytecode *b);
+
+#endif //QJS_BYTECODE_H
@@ -0,0 +1,145 @@
+#include "bytecode.h"
+
+/* The caches start monomorphic and grow up to JS_IC_MAX_ENTRIES
+   entries. When full, the entries are replaced in turn. They belong to
+   the bytecode, which is shared by the contexts of the runtime: they
+   are charged to the runtime and not to the running context. */
+
+static JSInlineCache *js_ic_get(JSRuntime *rt, JSFunctionBytecode *b,
+                                int atom_idx)
+{
+    JSInlineCache *ic, *new_ic;
+    int new_size;
+
+    if (!b->ic) {
+        b->ic = js_malloc_account(rt, NULL, sizeof(b->ic[0]) * b->atom_count);
+        if (!b->ic)
+            return NULL;
+        memset(b->ic, 0, sizeof(b->ic[0]) * b->atom_count);
+    }
+    ic = b->ic[atom_idx];
+    if (ic && (ic->count < ic->size || ic->size == JS_IC_MAX_ENTRIES))
+        return ic;
+    new_size = ic ? JS_IC_MAX_ENTRIES : 1;
+    new_ic = js_realloc_account(rt, NULL, ic, sizeof(JSInlineCache) +
+                                sizeof(ic->entries[0]) * new_size);
+    if (!new_ic)
+        return ic;
+    if (!ic) {
+        new_ic->count = 0;
+        new_ic->next = 0;
+    }
+    new_ic->size = new_size;
+    b->ic[atom_idx] = new_ic;
+    return new_ic;
+}
+
+static void js_ic_add(JSInlineCache *ic, JSObject *p, JSShapeProperty *prs,
+                      JSObject *holder)
+{
+    JSInlineCacheEntry *e;
+    int i;
+
+    /* an entry of the same shape is out of date */
+    for(i = 0; i < ic->count; i++) {
+        e = &ic->entries[i];
+        if (e->shape == p->shape)
+            goto found;
+    }
+    if (ic->count < ic->size) {
+        e = &ic->entries[ic->count++];
+    } else {
+        e = &ic->entries[ic->next];
+        ic->next = (ic->next + 1) % ic->size;
+    }
+ found:
+    e->shape = p->shape;
+    e->version = p->shape->version;
+    e->prop_idx = prs - get_shape_prop(holder->shape);
+    e->prop_flags = prs->flags;
+    /* the 'length' of the fast arrays cannot be set directly (and
+       their shape may be shared with other objects) */
+    if (prs->atom == JS_ATOM_length)
+        e->prop_flags &= ~JS_PROP_WRITABLE;
+    if (holder == p) {
+        e->proto = NULL;
+        e->proto_shape = NULL;
+        e->proto_version = 0;
+    } else {
+        e->proto = holder;
+        e->proto_shape = holder->shape;
+        e->proto_version = holder->shape->version;
+    }
+}
+
+static JSProperty *js_ic_find(JSInlineCache *ic, JSObject *p, BOOL is_put)
+{
+    JSInlineCacheEntry *e;
+    JSShape *sh = p->shape;
+    JSObject *proto;
+    int i;
+
+    for(i = 0; i < ic->count; i++) {
+        e = &ic->entries[i];
+        if (e->shape != sh || e->version != sh->version)
+            continue;
+        if (!e->proto) {
+            if (!is_put || (e->prop_flags & JS_PROP_WRITABLE))
+                return &p->prop[e->prop_idx];
+        } else if (!is_put) {
+            proto = p->proto;
+            if (proto == e->proto && proto->shape == e->proto_shape &&
+                proto->shape->version == e->proto_version)
+                return &proto->prop[e->prop_idx];
+        }
+        break;
+    }
+    return NULL;
+}
+
+JSProperty *js_ic_lookup(JSRuntime *rt, JSFunctionBytecode *b,
+                         int atom_idx, JSObject *p, BOOL is_put)
+{
+    JSAtom atom = b->atoms[atom_idx];
+    JSInlineCache *ic;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    JSObject *holder;
+
+    if (b->ic && b->ic[atom_idx]) {
+        pr = js_ic_find(b->ic[atom_idx], p, is_put);
+        if (pr)
+            return pr;
+    }
+
+    holder = p;
+    prs = find_own_property(&pr, p, atom);
+    if (!prs) {
+        /* only the properties of the prototype are cached, a deeper
+           lookup would have to check all the objects of the chain */
+        if (is_put || !p->proto)
+            return NULL;
+        holder = p->proto;
+        prs = find_own_property(&pr, holder, atom);
+        if (!prs)
+            return NULL;
+    }
+    if (is_put && (!(prs->flags & JS_PROP_WRITABLE) || atom == JS_ATOM_length))
+        return NULL;
+    ic = js_ic_get(rt, b, atom_idx);
+    if (ic)
+        js_ic_add(ic, p, prs, holder);
+    return pr;
+}
+
+void js_free_ic(JSRuntime *rt, JSFunctionBytecode *b)
+{
+    int i;
+
+    if (!b->ic)
+        return;
+    for(i = 0; i < b->atom_count; i++)
+        js_free_rt(rt, b->ic[i]);
+    js_free_rt(rt, b->ic);
+    b->ic = NULL;
+}
@@ -0,0 +1,2829 @@
+#include <math.h>
+#include <alloca.h>
+#include "bytecode.h"
+#include "parser.h"
+#include "jit.h"
+
+/* The bytecode interpreter. The arguments, the local variables and
+   the value stack of a call are allocated together on the C stack.
+
+   With gcc and clang, the instructions are dispatched with computed
+   gotos: each instruction handler ends with its own indirect jump to
+   the next handler, which gives the branch predictor one history per
+   handler instead of a single shared one. CONFIG_NO_DIRECT_DISPATCH
+   selects the portable switch() dispatch. The common cases (int32
+   arithmetic and comparisons, tests of booleans) are handled inline,
+   the other ones in the no_inline slow functions.
+
+   With CONFIG_JIT, the hot functions run as machine code (see
+   jit.c). The machine code and the interpreter share the frame: they
+   are switched at the function start and at the loop heads, and the
+   machine code returns to the interpreter for the instructions it
+   does not compile and for the exceptions.
+
+   The frame of a generator is a JSAsyncFrame allocated from the frame
+   pools of the runtime. The interpreter returns at each yield and
+   resumes the frame with JS_CALL_FLAG_GENERATOR. */
+
+#if defined(__GNUC__) && !defined(CONFIG_NO_DIRECT_DISPATCH)
+#define DIRECT_DISPATCH  1
+#else
+#define DIRECT_DISPATCH  0
+#endif
+
+static inline void set_value(JSContext *ctx, JSValue *pval, JSValue new_val)
+{
+    JSValue old_val;
+    old_val = *pval;
+    *pval = new_val;
+    JS_FreeValue(ctx, old_val);
+}
+
+/* closures */
+
+static JSVarRef *get_var_ref(JSContext *ctx, JSStackFrame *sf, int var_idx,
+                             BOOL is_arg)
+{
+    JSVarRef *var_ref;
+    struct list_head *el;
+
+    list_for_each(el, &sf->var_ref_list) {
+        var_ref = list_entry(el, JSVarRef, header.link);
+        if (var_ref->var_idx == var_idx && var_ref->is_arg == is_arg) {
+            var_ref->header.ref_count++;
+            return var_ref;
+        }
+    }
+    /* create a new one */
+    var_ref = js_malloc(ctx, sizeof(JSVarRef));
+    if (!var_ref)
+        return NULL;
+    var_ref->header.ref_count = 1;
+    var_ref->is_detached = FALSE;
+    var_ref->is_arg = is_arg;
+    var_ref->var_idx = var_idx;
+    list_add_tail(&var_ref->header.link, &sf->var_ref_list);
+    if (is_arg)
+        var_ref->pvalue = &sf->arg_buf[var_idx];
+    else
+        var_ref->pvalue = &sf->var_buf[var_idx];
+    var_ref->async_frame = sf->async_frame;
+    if (sf->async_frame)
+        sf->async_frame->header.ref_count++;
+    return var_ref;
+}
+
+static void detach_var_ref(JSRuntime *rt, JSVarRef *var_ref)
+{
+    JSAsyncFrame *af = var_ref->async_frame;
+
+    /* 'value' replaces 'async_frame' */
+    var_ref->value = JS_DupValueRT(rt, *var_ref->pvalue);
+    var_ref->pvalue = &var_ref->value;
+    /* the reference is no longer on the stack */
+    var_ref->is_detached = TRUE;
+    add_gc_object(rt, &var_ref->header, JS_GC_OBJ_TYPE_VAR_REF);
+    if (af)
+        free_async_frame(rt, af);
+}
+
+/* the frame is left: the closures keep a copy of the variables */
+static void close_var_refs(JSRuntime *rt, JSStackFrame *sf)
+{
+    struct list_head *el, *el1;
+    JSVarRef *var_ref;
+
+    list_for_each_safe(el, el1, &sf->var_ref_list) {
+        var_ref = list_entry(el, JSVarRef, header.link);
+        detach_var_ref(rt, var_ref);
+    }
+}
+
+/* the scope of a captured lexical variable is left (e.g. at the end
+   of each loop iteration): the next closures see a new variable */
+static void close_lexical_var(JSContext *ctx, JSStackFrame *sf, int var_idx)
+{
+    struct list_head *el, *el1;
+    JSVarRef *var_ref;
+
+    list_for_each_safe(el, el1, &sf->var_ref_list) {
+        var_ref = list_entry(el, JSVarRef, header.link);
+        if (var_idx == var_ref->var_idx && !var_ref->is_arg) {
+            list_del(&var_ref->header.link);
+            detach_var_ref(ctx->rt, var_ref);
+        }
+    }
+}
+
+/* new function object for the bytecode 'bfunc' (takes ownership). The
+   closure variables are taken from the frame 'sf' or from the closure
+   variables of the parent. The copied variables are stored after the
+   var_refs array. */
+static JSValue js_closure(JSContext *ctx, JSValue bfunc,
+                          JSVarRef **cur_var_refs, JSStackFrame *sf)
+{
+    JSFunctionBytecode *b;
+    JSValue func_obj, proto, val;
+    JSVarRef **var_refs, *var_ref;
+    JSVarCell *cell;
+    JSClosureVar *cv;
+    JSObject *p;
+    int i, copied_count;
+
+    b = JS_VALUE_GET_PTR(bfunc);
+    /* already compiled by another closure */
+    if (b->lazy && b->lazy->compiled) {
+        bfunc = JS_DupValue(ctx, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE,
+                                          b->lazy->compiled));
+        JS_FreeValue(ctx, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b));
+        b = JS_VALUE_GET_PTR(bfunc);
+    }
+    func_obj = JS_NewObjectClass(ctx, JS_CLASS_BYTECODE_FUNCTION);
+    if (JS_IsException(func_obj)) {
+        JS_FreeValue(ctx, bfunc);
+        return JS_EXCEPTION;
+    }
+    p = JS_VALUE_GET_OBJ(func_obj);
+    p->u.func.function_bytecode = b;
+    p->u.func.realm = JS_DupContext(ctx);
+    if (b->closure_var_count) {
+        copied_count = 0;
+        for(i = 0; i < b->closure_var_count; i++)
+            copied_count += b->closure_var[i].is_copied;
+        var_refs = js_mallocz(ctx, sizeof(var_refs[0]) * b->closure_var_count +
+                              sizeof(JSVarCell) * copied_count);
+        if (!var_refs)
+            goto fail;
+        p->u.func.var_refs = var_refs;
+        cell = (JSVarCell *)(var_refs + b->closure_var_count);
+        for(i = 0; i < b->closure_var_count; i++) {
+            cv = &b->closure_var[i];
+            if (cv->is_copied) {
+                if (!cv->is_local)
+                    val = *cur_var_refs[cv->var_idx]->pvalue;
+                else if (cv->is_arg)
+                    val = sf->arg_buf[cv->var_idx];
+                else
+                    val = sf->var_buf[cv->var_idx];
+                cell->value = JS_DupValue(ctx, val);
+                cell->pvalue = &cell->value;
+                var_ref = (JSVarRef *)cell++;
+            } else if (cv->is_local) {
+                var_ref = get_var_ref(ctx, sf, cv->var_idx, cv->is_arg);
+                if (!var_ref)
+                    goto fail;
+            } else {
+                var_ref = cur_var_refs[cv->var_idx];
+                var_ref->header.ref_count++;
+            }
+            var_refs[i] = var_ref;
+        }
+    }
+    if (b->has_prototype) {
+        p->is_constructor = TRUE;
+        proto = JS_NewObject(ctx);
+        if (JS_IsException(proto))
+            goto fail;
+        if (JS_DefinePropertyValue(ctx, proto, JS_ATOM_constructor,
+                                   JS_DupValue(ctx, func_obj),
+                                   JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE) < 0) {
+            JS_FreeValue(ctx, proto);
+            goto fail;
+        }
+        if (JS_DefinePropertyValue(ctx, func_obj, JS_ATOM_prototype, proto,
+                                   JS_PROP_WRITABLE) < 0)
+            goto fail;
+    }
+    if (js_function_set_properties(ctx, func_obj,
+                                   b->func_name != JS_ATOM_NULL ?
+                                   b->func_name : JS_ATOM_empty_string,
+                                   b->defined_arg_count) < 0)
+        goto fail;
+    return func_obj;
+ fail:
+    /* the bytecode is freed with the object */
+    JS_FreeValue(ctx, func_obj);
+    return JS_EXCEPTION;
+}
+
+/* the bytecode of 'p' is lazy: replace it by the compiled function,
+   compiling it on the first call. The closure variables are the same. */
+static JSFunctionBytecode *js_link_lazy_function(JSContext *ctx, JSObject *p)
+{
+    JSRuntime *rt = ctx->rt;
+    JSFunctionBytecode *b, *b1;
+    JSMemAccount *saved_account;
+
+    b = p->u.func.function_bytecode;
+    b1 = b->lazy->compiled;
+    if (!b1) {
+        /* the compiler buffers are charged to the context */
+        saved_account = rt->malloc_account;
+        rt->malloc_account = ctx->mem_account;
+        b1 = js_compile_lazy_function(ctx, b);
+        rt->malloc_account = saved_account;
+        if (!b1)
+            return NULL;
+    }
+    b1->header.ref_count++;
+    p->u.func.function_bytecode = b1;
+    JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b));
+    return b1;
+}
+
+/* global variables */
+
+static JSValue js_throw_not_defined(JSContext *ctx, JSAtom atom)
+{
+    char buf[64];
+    return JS_ThrowReferenceError(ctx, "'%s' is not defined",
+                                  JS_AtomGetStr(ctx, buf, sizeof(buf), atom));
+}
+
+static JSValue js_throw_uninitialized(JSContext *ctx, JSAtom atom)
+{
+    char buf[64];
+    return JS_ThrowReferenceError(ctx, "'%s' is not initialized",
+                                  JS_AtomGetStr(ctx, buf, sizeof(buf), atom));
+}
+
+static JSValue js_get_global_var(JSContext *ctx, JSAtom atom,
+                                 BOOL throw_ref_error)
+{
+    JSObject *p;
+    JSProperty *pr;
+
+    for(p = JS_VALUE_GET_OBJ(ctx->global_obj); p != NULL; p = p->proto) {
+        if (find_own_property(&pr, p, atom))
+            return JS_DupValue(ctx, pr->value);
+    }
+    if (throw_ref_error)
+        return js_throw_not_defined(ctx, atom);
+    return JS_UNDEFINED;
+}
+
+/* takes ownership of 'val' */
+static int js_put_global_var(JSContext *ctx, JSAtom atom, JSValue val,
+                             BOOL is_strict, BOOL check_ref_error)
+{
+    if (check_ref_error && !JS_HasProperty(ctx, ctx->global_obj, atom)) {
+        JS_FreeValue(ctx, val);
+        js_throw_not_defined(ctx, atom);
+        return -1;
+    }
+    return JS_SetPropertyInternal(ctx, ctx->global_obj, atom, val,
+                                  is_strict ? JS_PROP_THROW : 0);
+}
+
+static int js_define_global_var(JSContext *ctx, JSAtom atom)
+{
+    JSProperty *pr;
+
+    if (find_own_property(&pr, JS_VALUE_GET_OBJ(ctx->global_obj), atom))
+        return 0;
+    return JS_DefinePropertyValue(ctx, ctx->global_obj, atom, JS_UNDEFINED,
+                                  JS_PROP_WRITABLE | JS_PROP_ENUMERABLE |
+                                  JS_PROP_THROW);
+}
+
+/* properties with a computed name */
+
+static JSValue js_get_property_value(JSContext *ctx, JSValueConst obj,
+                                     JSValueConst prop)
+{
+    JSAtom atom;
+    JSValue ret;
+
+    atom = JS_ValueToAtom(ctx, prop);
+    if (unlikely(atom == JS_ATOM_NULL))
+        return JS_EXCEPTION;
+    ret = JS_GetProperty(ctx, obj, atom);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+/* takes ownership of 'val' */
+static int js_put_property_value(JSContext *ctx, JSValueConst obj,
+                                 JSValueConst prop, JSValue val, int flags)
+{
+    JSAtom atom;
+    int ret;
+
+    atom = JS_ValueToAtom(ctx, prop);
+    if (unlikely(atom == JS_ATOM_NULL)) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    ret = JS_SetPropertyInternal(ctx, obj, atom, val, flags);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+static int js_define_property_value(JSContext *ctx, JSValueConst obj,
+                                    JSValueConst prop, JSValue val)
+{
+    JSAtom atom;
+    int ret;
+
+    atom = JS_ValueToAtom(ctx, prop);
+    if (unlikely(atom == JS_ATOM_NULL)) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    ret = JS_DefinePropertyValue(ctx, obj, atom, val,
+                                 JS_PROP_C_W_E | JS_PROP_THROW);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+/* Slow paths of the operators. The operands are at sp[-2] and sp[-1]
+   (sp[-1] for the unary operators); the result replaces the first
+   one. If exception, the operands are replaced by undefined. */
+
+static BOOL js_string_eq(const JSString *p1, const JSString *p2)
+{
+    return p1->len == p2->len && !js_string_memcmp(p1, p2, p1->len);
+}
+
+static int js_string_compare(const JSString *p1, const JSString *p2)
+{
+    int res, len;
+
+    len = min_int(p1->len, p2->len);
+    res = js_string_memcmp(p1, p2, len);
+    if (res == 0)
+        res = (int)p1->len - (int)p2->len;
+    return res;
+}
+
+static double js_pow(double a, double b)
+{
+    /* pow(1, NaN) and pow(1, Infinity) are 1 in C */
+    if (unlikely(isnan(b) || (isinf(b) && fabs(a) == 1)))
+        return NAN;
+    return pow(a, b);
+}
+
+static no_inline int js_add_slow(JSContext *ctx, JSValue *sp)
+{
+    JSValue op1, op2, res;
+    double d1, d2;
+
+    op1 = JS_ToPrimitive(ctx, sp[-2], HINT_NONE);
+    if (JS_IsException(op1))
+        goto exception;
+    JS_FreeValue(ctx, sp[-2]);
+    sp[-2] = op1;
+    op2 = JS_ToPrimitive(ctx, sp[-1], HINT_NONE);
+    if (JS_IsException(op2))
+        goto exception;
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-1] = op2;
+
+    if (JS_IsString(op1) || JS_IsString(op2)) {
+        if (!JS_IsString(op1)) {
+            op1 = JS_ToString(ctx, sp[-2]);
+            if (JS_IsException(op1))
+                goto exception;
+            JS_FreeValue(ctx, sp[-2]);
+        }
+        if (!JS_IsString(op2)) {
+            op2 = JS_ToString(ctx, sp[-1]);
+            if (JS_IsException(op2)) {
+                sp[-2] = op1;
+                goto exception;
+            }
+            JS_FreeValue(ctx, sp[-1]);
+        }
+        sp[-2] = JS_UNDEFINED;
+        sp[-1] = JS_UNDEFINED;
+        res = JS_ConcatStrings(ctx, op1, op2);
+        if (JS_IsException(res))
+            return -1;
+        sp[-2] = res;
+        return 0;
+    }
+    /* primitive values: no exception */
+    JS_ToFloat64(ctx, &d1, op1);
+    JS_ToFloat64(ctx, &d2, op2);
+    sp[-2] = JS_NewNumber(ctx, d1 + d2);
+    return 0;
+ exception:
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-2] = JS_UNDEFINED;
+    sp[-1] = JS_UNDEFINED;
+    return -1;
+}
+
+/* add_i8 when sp[-1] is not a number. The immediate is not pushed:
+   it could overflow the stack. */
+static no_inline int js_add_imm_slow(JSContext *ctx, JSValue *sp, int imm)
+{
+    JSValue tab[2];
+
+    tab[0] = sp[-1];
+    tab[1] = JS_NewInt32(ctx, imm);
+    if (js_add_slow(ctx, tab + 2)) {
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    sp[-1] = tab[0];
+    return 0;
+}
+
+static no_inline int js_binary_arith_slow(JSContext *ctx, JSValue *sp,
+                                          int op)
+{
+    double d1, d2, r;
+    int32_t v1, v2;
+    uint32_t r32;
+
+    if (JS_ToFloat64(ctx, &d1, sp[-2]) || JS_ToFloat64(ctx, &d2, sp[-1])) {
+        JS_FreeValue(ctx, sp[-2]);
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-2] = JS_UNDEFINED;
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    switch(op) {
+    case OP_sub:
+        r = d1 - d2;
+        break;
+    case OP_mul:
+        r = d1 * d2;
+        break;
+    case OP_div:
+        r = d1 / d2;
+        break;
+    case OP_mod:
+        r = fmod(d1, d2);
+        break;
+    case OP_pow:
+        r = js_pow(d1, d2);
+        break;
+    default:
+        v1 = js_double_to_int32(d1);
+        v2 = js_double_to_int32(d2);
+        switch(op) {
+        case OP_shl:
+            r32 = (uint32_t)v1 << (v2 & 0x1f);
+            break;
+        case OP_sar:
+            r32 = v1 >> (v2 & 0x1f);
+            break;
+        case OP_shr:
+            /* the only unsigned result */
+            r32 = (uint32_t)v1 >> (v2 & 0x1f);
+            sp[-2] = JS_NewNumber(ctx, r32);
+            return 0;
+        case OP_and:
+            r32 = v1 & v2;
+            break;
+        case OP_or:
+            r32 = v1 | v2;
+            break;
+        case OP_xor:
+            r32 = v1 ^ v2;
+            break;
+        default:
+            abort();
+        }
+        sp[-2] = JS_NewInt32(ctx, r32);
+        return 0;
+    }
+    sp[-2] = JS_NewNumber(ctx, r);
+    return 0;
+}
+
+static no_inline int js_unary_arith_slow(JSContext *ctx, JSValue *sp,
+                                         int op)
+{
+    double d;
+
+    if (JS_ToFloat64(ctx, &d, sp[-1])) {
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    JS_FreeValue(ctx, sp[-1]);
+    switch(op) {
+    case OP_neg:
+        d = -d;
+        break;
+    case OP_inc:
+        d = d + 1;
+        break;
+    case OP_dec:
+        d = d - 1;
+        break;
+    case OP_not:
+        sp[-1] = JS_NewInt32(ctx, ~js_double_to_int32(d));
+        return 0;
+    default: /* OP_plus */
+        break;
+    }
+    sp[-1] = JS_NewNumber(ctx, d);
+    return 0;
+}
+
+/* a -> num(a) num(a)+/-1 */
+static no_inline int js_post_inc_slow(JSContext *ctx, JSValue *sp,
+                                      int op)
+{
+    double d;
+
+    if (JS_ToFloat64(ctx, &d, sp[-1])) {
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-1] = JS_NewNumber(ctx, d);
+    sp[0] = JS_NewNumber(ctx, op == OP_post_inc ? d + 1 : d - 1);
+    return 0;
+}
+
+static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
+                                        int op)
+{
+    JSValue op1, op2;
+    double d1, d2;
+    int res, cmp;
+
+    op1 = JS_ToPrimitive(ctx, sp[-2], HINT_NUMBER);
+    if (JS_IsException(op1))
+        goto exception;
+    JS_FreeValue(ctx, sp[-2]);
+    sp[-2] = op1;
+    op2 = JS_ToPrimitive(ctx, sp[-1], HINT_NUMBER);
+    if (JS_IsException(op2))
+        goto exception;
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-1] = op2;
+
+    if (JS_IsString(op1) && JS_IsString(op2)) {
+        cmp = js_string_compare(JS_VALUE_GET_STRING(op1),
+                                JS_VALUE_GET_STRING(op2));
+        switch(op) {
+        case OP_lt:
+            res = (cmp < 0);
+            break;
+        case OP_lte:
+            res = (cmp <= 0);
+            break;
+        case OP_gt:
+            res = (cmp > 0);
+            break;
+        default:
+            res = (cmp >= 0);
+            break;
+        }
+    } else {
+        /* primitive values: no exception */
+        JS_ToFloat64(ctx, &d1, op1);
+        JS_ToFloat64(ctx, &d2, op2);
+        /* false if NaN */
+        switch(op) {
+        case OP_lt:
+            res = (d1 < d2);
+            break;
+        case OP_lte:
+            res = (d1 <= d2);
+            break;
+        case OP_gt:
+            res = (d1 > d2);
+            break;
+        default:
+            res = (d1 >= d2);
+            break;
+        }
+    }
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    sp[-2] = JS_NewBool(ctx, res);
+    return 0;
+ exception:
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-2] = JS_UNDEFINED;
+    sp[-1] = JS_UNDEFINED;
+    return -1;
+}
+
+static BOOL js_strict_eq(JSValueConst op1, JSValueConst op2)
+{
+    int tag1, tag2;
+    double d1, d2;
+
+    tag1 = JS_VALUE_GET_NORM_TAG(op1);
+    tag2 = JS_VALUE_GET_NORM_TAG(op2);
+    if ((tag1 == JS_TAG_INT || tag1 == JS_TAG_FLOAT64) &&
+        (tag2 == JS_TAG_INT || tag2 == JS_TAG_FLOAT64)) {
+        d1 = tag1 == JS_TAG_INT ? JS_VALUE_GET_INT(op1) : JS_VALUE_GET_FLOAT64(op1);
+        d2 = tag2 == JS_TAG_INT ? JS_VALUE_GET_INT(op2) : JS_VALUE_GET_FLOAT64(op2);
+        return d1 == d2;
+    }
+    if (tag1 != tag2)
+        return FALSE;
+    switch(tag1) {
+    case JS_TAG_BOOL:
+        return JS_VALUE_GET_BOOL(op1) == JS_VALUE_GET_BOOL(op2);
+    case JS_TAG_NULL:
+    case JS_TAG_UNDEFINED:
+        return TRUE;
+    case JS_TAG_STRING:
+        return js_string_eq(JS_VALUE_GET_STRING(op1), JS_VALUE_GET_STRING(op2));
+    case JS_TAG_OBJECT:
+        return JS_VALUE_GET_OBJ(op1) == JS_VALUE_GET_OBJ(op2);
+    default:
+        return FALSE;
+    }
+}
+
+static no_inline void js_strict_eq_slow(JSContext *ctx, JSValue *sp,
+                                        BOOL is_neq)
+{
+    BOOL res;
+    res = js_strict_eq(sp[-2], sp[-1]);
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    sp[-2] = JS_NewBool(ctx, res ^ is_neq);
+}
+
+static BOOL tag_is_number(int tag)
+{
+    return tag == JS_TAG_INT || tag == JS_TAG_FLOAT64;
+}
+
+/* IsLooselyEqual. Return -1 if exception. */
+static int js_loose_eq(JSContext *ctx, JSValueConst op1, JSValueConst op2)
+{
+    JSValue v;
+    double d1, d2;
+    int tag1, tag2, res;
+
+    tag1 = JS_VALUE_GET_NORM_TAG(op1);
+    tag2 = JS_VALUE_GET_NORM_TAG(op2);
+    if (tag1 == tag2 || (tag_is_number(tag1) && tag_is_number(tag2)))
+        return js_strict_eq(op1, op2);
+    if ((tag1 == JS_TAG_NULL || tag1 == JS_TAG_UNDEFINED) &&
+        (tag2 == JS_TAG_NULL || tag2 == JS_TAG_UNDEFINED))
+        return TRUE;
+    if ((tag_is_number(tag1) || tag1 == JS_TAG_STRING || tag1 == JS_TAG_BOOL) &&
+        (tag_is_number(tag2) || tag2 == JS_TAG_STRING || tag2 == JS_TAG_BOOL)) {
+        /* the primitive values are compared as numbers */
+        if (JS_ToFloat64(ctx, &d1, op1) || JS_ToFloat64(ctx, &d2, op2))
+            return -1;
+        return d1 == d2;
+    }
+    if (tag1 == JS_TAG_OBJECT &&
+        (tag_is_number(tag2) || tag2 == JS_TAG_STRING || tag2 == JS_TAG_BOOL)) {
+        v = JS_ToPrimitive(ctx, op1, HINT_NONE);
+        if (JS_IsException(v))
+            return -1;
+        res = js_loose_eq(ctx, v, op2);
+        JS_FreeValue(ctx, v);
+        return res;
+    }
+    if (tag2 == JS_TAG_OBJECT &&
+        (tag_is_number(tag1) || tag1 == JS_TAG_STRING || tag1 == JS_TAG_BOOL)) {
+        v = JS_ToPrimitive(ctx, op2, HINT_NONE);
+        if (JS_IsException(v))
+            return -1;
+        res = js_loose_eq(ctx, op1, v);
+        JS_FreeValue(ctx, v);
+        return res;
+    }
+    return FALSE;
+}
+
+static no_inline int js_eq_slow(JSContext *ctx, JSValue *sp, BOOL is_neq)
+{
+    int res;
+
+    res = js_loose_eq(ctx, sp[-2], sp[-1]);
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    if (res < 0) {
+        sp[-2] = JS_UNDEFINED;
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    sp[-2] = JS_NewBool(ctx, res ^ is_neq);
+    return 0;
+}
+
+static JSValue js_typeof(JSContext *ctx, JSValueConst op1)
+{
+    JSAtom atom;
+
+    switch(JS_VALUE_GET_NORM_TAG(op1)) {
+    case JS_TAG_INT:
+    case JS_TAG_FLOAT64:
+        atom = JS_ATOM_number;
+        break;
+    case JS_TAG_UNDEFINED:
+        atom = JS_ATOM_undefined;
+        break;
+    case JS_TAG_BOOL:
+        atom = JS_ATOM_boolean;
+        break;
+    case JS_TAG_STRING:
+        atom = JS_ATOM_string;
+        break;
+    case JS_TAG_OBJECT:
+        if (JS_IsFunction(ctx, op1)) {
+            atom = JS_ATOM_function;
+            break;
+        }
+        /* fall thru */
+    default: /* null */
+        atom = JS_ATOM_object;
+        break;
+    }
+    return JS_AtomToString(ctx, atom);
+}
+
+/* OrdinaryHasInstance (no Symbol.hasInstance) */
+static int js_instanceof(JSContext *ctx, JSValueConst val, JSValueConst obj)
+{
+    JSValue proto;
+    JSObject *p, *proto1;
+
+    if (!JS_IsObject(obj) || !JS_IsFunction(ctx, obj)) {
+        JS_ThrowTypeError(ctx, "invalid 'instanceof' right operand");
+        return -1;
+    }
+    if (!JS_IsObject(val))
+        return FALSE;
+    proto = JS_GetProperty(ctx, obj, JS_ATOM_prototype);
+    if (JS_IsException(proto))
+        return -1;
+    if (!JS_IsObject(proto)) {
+        JS_FreeValue(ctx, proto);
+        JS_ThrowTypeError(ctx, "operand 'prototype' property is not an object");
+        return -1;
+    }
+    proto1 = JS_VALUE_GET_OBJ(proto);
+    JS_FreeValue(ctx, proto);
+    for(p = JS_VALUE_GET_OBJ(val)->proto; p != NULL; p = p->proto) {
+        if (p == proto1)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static int js_in(JSContext *ctx, JSValueConst prop, JSValueConst obj)
+{
+    JSAtom atom;
+    int ret;
+
+    if (!JS_IsObject(obj)) {
+        JS_ThrowTypeError(ctx, "invalid 'in' operand");
+        return -1;
+    }
+    atom = JS_ValueToAtom(ctx, prop);
+    if (atom == JS_ATOM_NULL)
+        return -1;
+    ret = JS_HasProperty(ctx, obj, atom);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+static no_inline int js_operator_slow(JSContext *ctx, JSValue *sp,
+                                      int op)
+{
+    int res;
+
+    if (op == OP_instanceof)
+        res = js_instanceof(ctx, sp[-2], sp[-1]);
+    else
+        res = js_in(ctx, sp[-2], sp[-1]);
+    JS_FreeValue(ctx, sp[-2]);
+    JS_FreeValue(ctx, sp[-1]);
+    if (res < 0) {
+        sp[-2] = JS_UNDEFINED;
+        sp[-1] = JS_UNDEFINED;
+        return -1;
+    }
+    sp[-2] = JS_NewBool(ctx, res);
+    return 0;
+}
+
+/* add the location of the error if it was created without one */
+static void js_set_error_location(JSContext *ctx, JSFunctionBytecode *b,
+                                  const uint8_t *pc)
+{
+    JSValueConst error = ctx->rt->current_exception;
+    JSProperty *pr;
+    JSObject *p;
+    int line_num;
+
+    if (!JS_IsObject(error))
+        return;
+    p = JS_VALUE_GET_OBJ(error);
+    if (p->class_id != JS_CLASS_ERROR ||
+        find_own_property(&pr, p, JS_ATOM_lineNumber))
+        return;
+    /* 'pc' is after the opcode of the instruction */
+    line_num = js_bytecode_find_line_num(b, pc - 1 - b->byte_code_buf);
+    if (b->debug.filename != JS_ATOM_NULL) {
+        JS_DefinePropertyValue(ctx, error, JS_ATOM_fileName,
+                               JS_AtomToString(ctx, b->debug.filename),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+    JS_DefinePropertyValue(ctx, error, JS_ATOM_lineNumber,
+                           JS_NewInt32(ctx, line_num),
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+}
+
+static BOOL js_is_uncatchable_error(JSValueConst val)
+{
+    return JS_IsObject(val) && JS_VALUE_GET_OBJ(val)->is_uncatchable_error;
+}
+
+#ifdef CONFIG_JIT
+/* Run the instruction at 'pc' for the machine code: the instructions
+   which are not compiled inline and the slow cases of the other ones.
+   Return the new stack pointer, or NULL if exception: f->sp and f->pc
+   are then set for the exception handling of the interpreter. */
+static force_inline JSValue *js_jit_op(JSJitFrame *f, JSValue *sp,
+                                       const uint8_t *pc, int opcode)
+{
+    JSContext *ctx = f->ctx;
+    JSRuntime *rt = ctx->rt;
+    JSFunctionBytecode *b = f->b;
+    const uint8_t *insn_pc = pc;
+    int call_argc, idx, res;
+    JSValue *call_argv, *pval, op1, ret_val;
+    JSAtom atom;
+    JSProperty *pr;
+
+    pc++;
+    switch(opcode) {
+    case OP_fclosure:
+        idx = js_bc_get_leb128(&pc);
+        op1 = js_closure(ctx, JS_DupValue(ctx, b->cpool[idx]),
+                         f->var_refs, f->sf);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        *sp++ = op1;
+        break;
+    case OP_push_atom_value:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        *sp++ = JS_AtomToString(ctx, atom);
+        break;
+    case OP_push_this:
+        if (!b->is_strict &&
+            (JS_IsUndefined(f->this_obj) || JS_IsNull(f->this_obj))) {
+            *sp++ = JS_DupValue(ctx, ctx->global_obj);
+        } else {
+            *sp++ = JS_DupValue(ctx, f->this_obj);
+        }
+        break;
+    case OP_object:
+        op1 = JS_NewObject(ctx);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        *sp++ = op1;
+        break;
+    case OP_special_object:
+        if (*pc++ == OP_SPECIAL_OBJECT_THIS_FUNC)
+            *sp++ = JS_DupValue(ctx, f->func_obj);
+        else
+            *sp++ = JS_DupValue(ctx, f->new_target);
+        break;
+    case OP_array_from:
+        call_argc = get_u16(pc);
+        op1 = js_create_array(ctx, call_argc, sp - call_argc);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        sp -= call_argc;
+        *sp++ = op1;
+        break;
+
+    case OP_call0:
+    case OP_call1:
+    case OP_call2:
+    case OP_call3:
+        call_argc = opcode - OP_call0;
+        goto has_call_argc;
+    case OP_call:
+        call_argc = get_u16(pc);
+    has_call_argc:
+        call_argv = sp - call_argc;
+        ret_val = JS_CallInternal(ctx, call_argv[-1], JS_UNDEFINED,
+                                  JS_UNDEFINED, call_argc, call_argv, 0);
+        if (unlikely(JS_IsException(ret_val)))
+            goto exception;
+        for(pval = call_argv - 1; pval < sp; pval++)
+            JS_FreeValue(ctx, *pval);
+        sp = call_argv;
+        sp[-1] = ret_val;
+        break;
+    case OP_call_method:
+        call_argc = get_u16(pc);
+        call_argv = sp - call_argc;
+        ret_val = JS_CallInternal(ctx, call_argv[-1], call_argv[-2],
+                                  JS_UNDEFINED, call_argc, call_argv, 0);
+        if (unlikely(JS_IsException(ret_val)))
+            goto exception;
+        for(pval = call_argv - 2; pval < sp; pval++)
+            JS_FreeValue(ctx, *pval);
+        sp = call_argv - 1;
+        sp[-1] = ret_val;
+        break;
+    case OP_call_constructor:
+        call_argc = get_u16(pc);
+        call_argv = sp - call_argc;
+        ret_val = JS_CallConstructorInternal(ctx, call_argv[-1],
+                                             call_argv[-1], call_argc,
+                                             call_argv, 0);
+        if (unlikely(JS_IsException(ret_val)))
+            goto exception;
+        for(pval = call_argv - 1; pval < sp; pval++)
+            JS_FreeValue(ctx, *pval);
+        sp = call_argv;
+        sp[-1] = ret_val;
+        break;
+    case OP_throw:
+        JS_Throw(ctx, *--sp);
+        goto exception;
+    case OP_throw_error:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        if (*pc == JS_THROW_VAR_RO)
+            JS_ThrowTypeErrorAtom(ctx, "'%s' is read-only", atom);
+        else
+            js_throw_uninitialized(ctx, atom);
+        goto exception;
+
+    case OP_get_var_undef:
+    case OP_get_var:
+        idx = js_bc_get_leb128(&pc);
+        pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(ctx->global_obj),
+                            FALSE);
+        if (likely(pr != NULL)) {
+            *sp++ = JS_DupValue(ctx, pr->value);
+            break;
+        }
+        op1 = js_get_global_var(ctx, b->atoms[idx], opcode == OP_get_var);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        *sp++ = op1;
+        break;
+    case OP_put_var:
+    case OP_put_var_strict:
+        idx = js_bc_get_leb128(&pc);
+        pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(ctx->global_obj),
+                            TRUE);
+        if (likely(pr != NULL)) {
+            set_value(ctx, &pr->value, *--sp);
+            break;
+        }
+        res = js_put_global_var(ctx, b->atoms[idx], sp[-1], b->is_strict,
+                                opcode == OP_put_var_strict);
+        sp--;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+    case OP_delete_var:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        res = JS_DeleteProperty(ctx, ctx->global_obj, atom, 0);
+        if (unlikely(res < 0))
+            goto exception;
+        *sp++ = JS_NewBool(ctx, res);
+        break;
+    case OP_define_var:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        if (js_define_global_var(ctx, atom) < 0)
+            goto exception;
+        break;
+    case OP_define_func:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        res = JS_DefinePropertyValue(ctx, ctx->global_obj, atom, sp[-1],
+                                     JS_PROP_WRITABLE | JS_PROP_ENUMERABLE |
+                                     JS_PROP_THROW);
+        sp--;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+
+    case OP_get_loc_get_field:
+    case OP_get_arg_get_field:
+        /* the machine code has pushed the variable */
+        pc++;
+        opcode = OP_get_field;
+        /* fall through */
+    case OP_get_field:
+    case OP_get_field2:
+        idx = js_bc_get_leb128(&pc);
+        if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT)) {
+            pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(sp[-1]), FALSE);
+            if (likely(pr != NULL)) {
+                op1 = JS_DupValue(ctx, pr->value);
+                goto get_field_done;
+            }
+        }
+        op1 = JS_GetProperty(ctx, sp[-1], b->atoms[idx]);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+    get_field_done:
+        if (opcode == OP_get_field2) {
+            *sp++ = op1;
+        } else {
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = op1;
+        }
+        break;
+    case OP_put_field:
+        idx = js_bc_get_leb128(&pc);
+        if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT)) {
+            pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(sp[-2]), TRUE);
+            if (likely(pr != NULL)) {
+                set_value(ctx, &pr->value, sp[-1]);
+                JS_FreeValue(ctx, sp[-2]);
+                sp -= 2;
+                break;
+            }
+        }
+        res = JS_SetPropertyInternal(ctx, sp[-2], b->atoms[idx], sp[-1],
+                                     b->is_strict ? JS_PROP_THROW : 0);
+        JS_FreeValue(ctx, sp[-2]);
+        sp -= 2;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+    case OP_define_field:
+        atom = b->atoms[js_bc_get_leb128(&pc)];
+        res = JS_DefinePropertyValue(ctx, sp[-2], atom, sp[-1],
+                                     JS_PROP_C_W_E | JS_PROP_THROW);
+        sp--;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+    case OP_get_array_el:
+    case OP_get_array_el2:
+        if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT &&
+                   JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_INT)) {
+            JSObject *p = JS_VALUE_GET_OBJ(sp[-2]);
+            idx = JS_VALUE_GET_INT(sp[-1]);
+            if (likely(p->fast_array && (uint32_t)idx < p->u.array.count)) {
+                op1 = js_array_get_fast(ctx, p, idx);
+                goto get_array_el_done;
+            }
+        }
+        op1 = js_get_property_value(ctx, sp[-2], sp[-1]);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        JS_FreeValue(ctx, sp[-1]);
+    get_array_el_done:
+        if (opcode == OP_get_array_el2) {
+            sp[-1] = op1;
+        } else {
+            JS_FreeValue(ctx, sp[-2]);
+            sp--;
+            sp[-1] = op1;
+        }
+        break;
+    case OP_put_array_el:
+        if (likely(JS_VALUE_GET_TAG(sp[-3]) == JS_TAG_OBJECT &&
+                   JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_INT)) {
+            JSObject *p = JS_VALUE_GET_OBJ(sp[-3]);
+            idx = JS_VALUE_GET_INT(sp[-2]);
+            if (likely(p->fast_array && (uint32_t)idx < p->u.array.count &&
+                       js_array_set_fast(ctx, p, idx, sp[-1]))) {
+                JS_FreeValue(ctx, sp[-3]);
+                sp -= 3;
+                break;
+            }
+        }
+        res = js_put_property_value(ctx, sp[-3], sp[-2], sp[-1],
+                                    b->is_strict ? JS_PROP_THROW : 0);
+        JS_FreeValue(ctx, sp[-3]);
+        JS_FreeValue(ctx, sp[-2]);
+        sp -= 3;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+    case OP_define_array_el:
+        res = js_define_property_value(ctx, sp[-3], sp[-2], sp[-1]);
+        JS_FreeValue(ctx, sp[-2]);
+        sp -= 2;
+        if (unlikely(res < 0))
+            goto exception;
+        break;
+    case OP_delete:
+        atom = JS_ValueToAtom(ctx, sp[-1]);
+        if (unlikely(atom == JS_ATOM_NULL))
+            goto exception;
+        res = JS_DeleteProperty(ctx, sp[-2], atom,
+                                b->is_strict ? JS_PROP_THROW : 0);
+        JS_FreeAtom(ctx, atom);
+        if (unlikely(res < 0))
+            goto exception;
+        JS_FreeValue(ctx, sp[-2]);
+        JS_FreeValue(ctx, sp[-1]);
+        sp--;
+        sp[-1] = JS_NewBool(ctx, res);
+        break;
+
+    /* uninitialized variables (the other case is inline) */
+    case OP_get_loc_check:
+    case OP_put_loc_check:
+        idx = get_u16(pc);
+        js_throw_uninitialized(ctx, b->vardefs[b->arg_count + idx].var_name);
+        goto exception;
+    case OP_get_var_ref_check:
+    case OP_put_var_ref_check:
+        idx = get_u16(pc);
+        js_throw_uninitialized(ctx, b->closure_var[idx].var_name);
+        goto exception;
+    case OP_close_loc:
+        close_lexical_var(ctx, f->sf, get_u16(pc));
+        break;
+
+    /* the int32 cases are inline */
+    case OP_neg:
+        op1 = sp[-1];
+        if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(op1))) {
+            sp[-1] = JS_NewFloat64(ctx, -JS_VALUE_GET_FLOAT64(op1));
+            break;
+        }
+        /* fall through */
+    case OP_plus:
+    case OP_inc:
+    case OP_dec:
+    case OP_not:
+        if (js_unary_arith_slow(ctx, sp, opcode))
+            goto exception;
+        break;
+    case OP_post_inc:
+    case OP_post_dec:
+        if (js_post_inc_slow(ctx, sp, opcode))
+            goto exception;
+        sp++;
+        break;
+    case OP_lnot:
+        res = JS_ToBool(ctx, sp[-1]);
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = JS_NewBool(ctx, !res);
+        break;
+    case OP_typeof:
+        op1 = js_typeof(ctx, sp[-1]);
+        if (unlikely(JS_IsException(op1)))
+            goto exception;
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = op1;
+        break;
+    case OP_add:
+        if (js_add_slow(ctx, sp))
+            goto exception;
+        sp--;
+        break;
+    case OP_add_i8:
+        if (js_add_imm_slow(ctx, sp, (int8_t)*pc))
+            goto exception;
+        break;
+    case OP_sub:
+    case OP_mul:
+    case OP_mod:
+    case OP_div:
+    case OP_pow:
+    case OP_shl:
+    case OP_sar:
+    case OP_shr:
+    case OP_and:
+    case OP_or:
+    case OP_xor:
+        if (js_binary_arith_slow(ctx, sp, opcode))
+            goto exception;
+        sp--;
+        break;
+    case OP_lt:
+    case OP_lte:
+    case OP_gt:
+    case OP_gte:
+        if (js_relational_slow(ctx, sp, opcode))
+            goto exception;
+        sp--;
+        break;
+    case OP_lt_if_false:
+    case OP_lte_if_false:
+    case OP_gt_if_false:
+    case OP_gte_if_false:
+    case OP_lt_if_false8:
+    case OP_lte_if_false8:
+    case OP_gt_if_false8:
+    case OP_gte_if_false8:
+        /* the machine code jumps according to the result */
+        if (js_relational_slow(ctx, sp,
+                               OP_lt + (opcode - OP_lt_if_false) % 4))
+            goto exception;
+        sp--;
+        break;
+    case OP_eq:
+    case OP_neq:
+        if (js_eq_slow(ctx, sp, opcode == OP_neq))
+            goto exception;
+        sp--;
+        break;
+    case OP_strict_eq:
+    case OP_strict_neq:
+        js_strict_eq_slow(ctx, sp, opcode == OP_strict_neq);
+        sp--;
+        break;
+    case OP_instanceof:
+    case OP_in:
+        if (js_operator_slow(ctx, sp, opcode))
+            goto exception;
+        sp--;
+        break;
+    default:
+        abort();
+    }
+    return sp;
+ exception:
+    f->sp = sp;
+    f->pc = insn_pc + 1 - b->byte_code_buf;
+    return NULL;
+}
+
+JSValue *js_jit_slow_op(JSJitFrame *f, JSValue *sp, const uint8_t *pc)
+{
+    return js_jit_op(f, sp, pc, *pc);
+}
+
+/* The frequent instructions have their own copy of js_jit_op() so that
+   their branches are predicted separately. */
+#define DEF_JIT_OP(name, opcode)                                        \
+JSValue *js_jit_op_ ## name(JSJitFrame *f, JSValue *sp,                 \
+                            const uint8_t *pc)                          \
+{                                                                       \
+    return js_jit_op(f, sp, pc, opcode);                                \
+}
+
+DEF_JIT_OP(get_var, OP_get_var)
+DEF_JIT_OP(get_var_undef, OP_get_var_undef)
+DEF_JIT_OP(put_var, OP_put_var)
+DEF_JIT_OP(get_field, OP_get_field)
+DEF_JIT_OP(get_loc_get_field, OP_get_loc_get_field)
+DEF_JIT_OP(get_arg_get_field, OP_get_arg_get_field)
+DEF_JIT_OP(get_field2, OP_get_field2)
+DEF_JIT_OP(put_field, OP_put_field)
+DEF_JIT_OP(get_array_el, OP_get_array_el)
+DEF_JIT_OP(put_array_el, OP_put_array_el)
+DEF_JIT_OP(call0, OP_call0)
+DEF_JIT_OP(call1, OP_call1)
+DEF_JIT_OP(call2, OP_call2)
+DEF_JIT_OP(call3, OP_call3)
+DEF_JIT_OP(call_method, OP_call_method)
+#undef DEF_JIT_OP
+#endif /* CONFIG_JIT */
+
+/* generators */
+
+/* frame for 'slot_count' values, from the free frames of its size class
+   if possible */
+static JSAsyncFrame *async_frame_alloc(JSRuntime *rt, int slot_count)
+{
+    JSAsyncFrame *af;
+    int cls;
+
+    if (slot_count <= JS_FRAME_POOL_CLASSES * JS_FRAME_POOL_GRANULE) {
+        cls = max_int(slot_count - 1, 0) / JS_FRAME_POOL_GRANULE;
+        if (!list_empty(&rt->frame_pool[cls])) {
+            af = list_entry(rt->frame_pool[cls].next, JSAsyncFrame,
+                            header.link);
+            list_del(&af->header.link);
+            rt->frame_pool_count[cls]--;
+            rt->frame_pool_size -= sizeof(JSAsyncFrame) +
+                sizeof(JSValue) * af->slot_count;
+            return af;
+        }
+        slot_count = (cls + 1) * JS_FRAME_POOL_GRANULE;
+    }
+    af = js_malloc_account(rt, NULL, sizeof(JSAsyncFrame) +
+                           sizeof(JSValue) * slot_count);
+    if (!af)
+        return NULL;
+    af->slot_count = slot_count;
+    return af;
+}
+
+static void async_frame_release(JSRuntime *rt, JSAsyncFrame *af)
+{
+    int cls;
+
+    cls = (af->slot_count - 1) / JS_FRAME_POOL_GRANULE;
+    if (cls < JS_FRAME_POOL_CLASSES &&
+        rt->frame_pool_count[cls] < JS_FRAME_POOL_MAX_FREE) {
+        list_add(&af->header.link, &rt->frame_pool[cls]);
+        rt->frame_pool_count[cls]++;
+        rt->frame_pool_size += sizeof(JSAsyncFrame) +
+            sizeof(JSValue) * af->slot_count;
+    } else {
+        js_free_rt(rt, af);
+    }
+}
+
+void js_free_frame_pools(JSRuntime *rt)
+{
+    struct list_head *el, *el1;
+    int i;
+
+    for(i = 0; i < JS_FRAME_POOL_CLASSES; i++) {
+        list_for_each_safe(el, el1, &rt->frame_pool[i]) {
+            js_free_rt(rt, list_entry(el, JSAsyncFrame, header.link));
+        }
+        init_list_head(&rt->frame_pool[i]);
+        rt->frame_pool_count[i] = 0;
+    }
+    rt->frame_pool_size = 0;
+}
+
+/* frame of a call to the generator function 'func_obj', stopped at the
+   start of its code */
+static JSAsyncFrame *async_frame_new(JSContext *ctx, JSValueConst func_obj,
+                                     JSValueConst this_obj,
+                                     int argc, JSValueConst *argv)
+{
+    JSRuntime *rt = ctx->rt;
+    JSFunctionBytecode *b;
+    JSAsyncFrame *af;
+    int i, n;
+
+    b = JS_VALUE_GET_OBJ(func_obj)->u.func.function_bytecode;
+    af = async_frame_alloc(rt, b->arg_count + b->var_count + b->stack_size);
+    if (!af) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    af->header.ref_count = 1;
+    add_gc_object(rt, &af->header, JS_GC_OBJ_TYPE_ASYNC_FUNCTION);
+    af->sf.arg_buf = af->buf;
+    af->sf.var_buf = af->buf + b->arg_count;
+    init_list_head(&af->sf.var_ref_list);
+    af->sf.async_frame = af;
+    af->func_obj = JS_DupValue(ctx, func_obj);
+    af->this_val = JS_DupValue(ctx, this_obj);
+    af->is_completed = FALSE;
+    af->throw_flag = FALSE;
+    n = min_int(argc, b->arg_count);
+    for(i = 0; i < n; i++)
+        af->buf[i] = JS_DupValue(ctx, argv[i]);
+    for(; i < b->arg_count + b->var_count; i++)
+        af->buf[i] = JS_UNDEFINED;
+    af->sp = af->buf + i;
+    af->pc = b->byte_code_buf;
+    return af;
+}
+
+/* the values of the frame are freed. The closures keep a copy of its
+   variables. */
+static void async_frame_close(JSRuntime *rt, JSAsyncFrame *af)
+{
+    JSValue *pval;
+
+    if (!af->sp)
+        return;
+    close_var_refs(rt, &af->sf);
+    init_list_head(&af->sf.var_ref_list);
+    for(pval = af->buf; pval < af->sp; pval++)
+        JS_FreeValueRT(rt, *pval);
+    af->sp = NULL;
+    JS_FreeValueRT(rt, af->func_obj);
+    JS_FreeValueRT(rt, af->this_val);
+}
+
+void free_async_frame(JSRuntime *rt, JSAsyncFrame *af)
+{
+    if (--af->header.ref_count == 0) {
+        async_frame_close(rt, af);
+        remove_gc_object(&af->header);
+        async_frame_release(rt, af);
+    }
+}
+
+void mark_async_frame(JSRuntime *rt, JSAsyncFrame *af,
+                      JS_MarkFunc *mark_func)
+{
+    JSValue *pval;
+
+    if (!af->sp)
+        return;
+    JS_MarkValue(rt, af->func_obj, mark_func);
+    JS_MarkValue(rt, af->this_val, mark_func);
+    for(pval = af->buf; pval < af->sp; pval++)
+        JS_MarkValue(rt, *pval, mark_func);
+}
+
+/* run the frame up to its next yield (af->is_completed = FALSE) or up
+   to its end */
+static JSValue async_frame_resume(JSContext *ctx, JSAsyncFrame *af)
+{
+    return JS_CallInternal(ctx, JS_MKPTR(JS_TAG_INT, af), af->this_val,
+                           JS_UNDEFINED, 0, NULL, JS_CALL_FLAG_GENERATOR);
+}
+
+static void generator_complete(JSRuntime *rt, JSObject *p)
+{
+    JSAsyncFrame *af = p->u.generator.frame;
+
+    p->u.generator.state = JS_GENERATOR_STATE_COMPLETED;
+    if (af) {
+        p->u.generator.frame = NULL;
+        async_frame_close(rt, af);
+        free_async_frame(rt, af);
+    }
+}
+
+void free_generator(JSRuntime *rt, JSObject *p)
+{
+    generator_complete(rt, p);
+}
+
+void mark_generator(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func)
+{
+    if (p->u.generator.frame)
+        mark_func(rt, &p->u.generator.frame->header);
+}
+
+/* the arguments are evaluated (up to initial_yield) before the
+   generator object is returned */
+static JSValue js_generator_function_call(JSContext *caller_ctx,
+                                          JSValueConst func_obj,
+                                          JSValueConst this_obj,
+                                          int argc, JSValueConst *argv)
+{
+    JSContext *ctx = JS_VALUE_GET_OBJ(func_obj)->u.func.realm;
+    JSAsyncFrame *af;
+    JSObject *p;
+    JSValue obj, ret;
+
+    af = async_frame_new(ctx, func_obj, this_obj, argc, argv);
+    if (!af)
+        return JS_EXCEPTION;
+    obj = JS_NewObjectClass(ctx, JS_CLASS_GENERATOR);
+    if (JS_IsException(obj)) {
+        async_frame_close(ctx->rt, af);
+        free_async_frame(ctx->rt, af);
+        return obj;
+    }
+    p = JS_VALUE_GET_OBJ(obj);
+    p->u.generator.frame = af;
+    p->u.generator.state = JS_GENERATOR_STATE_EXECUTING;
+    ret = async_frame_resume(caller_ctx, af);
+    if (af->is_completed) {
+        generator_complete(ctx->rt, p);
+        if (JS_IsException(ret)) {
+            JS_FreeValue(ctx, obj);
+            return ret;
+        }
+    } else {
+        p->u.generator.state = JS_GENERATOR_STATE_SUSPENDED_START;
+    }
+    JS_FreeValue(ctx, ret);
+    return obj;
+}
+
+/* { value, done } */
+static JSValue js_create_iterator_result(JSContext *ctx, JSValue val,
+                                         BOOL done)
+{
+    JSValue obj;
+
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj)) {
+        JS_FreeValue(ctx, val);
+        return obj;
+    }
+    if (JS_DefinePropertyValue(ctx, obj, JS_ATOM_value, val,
+                               JS_PROP_C_W_E) < 0 ||
+        JS_DefinePropertyValue(ctx, obj, JS_ATOM_done, JS_NewBool(ctx, done),
+                               JS_PROP_C_W_E) < 0) {
+        JS_FreeValue(ctx, obj);
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
+JSValue js_generator_next(JSContext *ctx, JSValueConst this_val,
+                          int argc, JSValueConst *argv, int magic)
+{
+    JSObject *p;
+    JSAsyncFrame *af;
+    JSValue ret;
+
+    if (!JS_IsObject(this_val) ||
+        JS_VALUE_GET_OBJ(this_val)->class_id != JS_CLASS_GENERATOR)
+        return JS_ThrowTypeError(ctx, "not a generator");
+    p = JS_VALUE_GET_OBJ(this_val);
+    af = p->u.generator.frame;
+    switch(p->u.generator.state) {
+    case JS_GENERATOR_STATE_SUSPENDED_START:
+        if (magic != JS_GENERATOR_NEXT) {
+            generator_complete(ctx->rt, p);
+            goto completed;
+        }
+        break;
+    case JS_GENERATOR_STATE_SUSPENDED_YIELD:
+        if (magic == JS_GENERATOR_THROW) {
+            JS_Throw(ctx, JS_DupValue(ctx, argv[0]));
+            af->throw_flag = TRUE;
+        } else {
+            /* the result of the yield expression, and TRUE to return
+               from the generator (see js_parse_yield()) */
+            af->sp[0] = JS_DupValue(ctx, argv[0]);
+            af->sp[1] = JS_NewBool(ctx, magic == JS_GENERATOR_RETURN);
+            af->sp += 2;
+        }
+        break;
+    case JS_GENERATOR_STATE_EXECUTING:
+        return JS_ThrowTypeError(ctx, "cannot invoke a running generator");
+    default:
+    completed:
+        if (magic == JS_GENERATOR_THROW)
+            return JS_Throw(ctx, JS_DupValue(ctx, argv[0]));
+        return js_create_iterator_result(ctx, magic == JS_GENERATOR_RETURN ?
+                                         JS_DupValue(ctx, argv[0]) :
+                                         JS_UNDEFINED, TRUE);
+    }
+    p->u.generator.state = JS_GENERATOR_STATE_EXECUTING;
+    ret = async_frame_resume(ctx, af);
+    if (af->is_completed) {
+        /* the frame goes back to its pool */
+        generator_complete(ctx->rt, p);
+        if (JS_IsException(ret))
+            return ret;
+        return js_create_iterator_result(ctx, ret, TRUE);
+    }
+    p->u.generator.state = JS_GENERATOR_STATE_SUSPENDED_YIELD;
+    return js_create_iterator_result(ctx, ret, FALSE);
+}
+
+/* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0 */
+JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
+                        JSValueConst this_obj, JSValueConst new_target,
+                        int argc, JSValue *argv, int flags)
+{
+    JSRuntime *rt = caller_ctx->rt;
+    JSContext *ctx;
+    JSObject *p;
+    JSFunctionBytecode *b;
+    JSStackFrame sf_s, *sf = &sf_s;
+    JSMemAccount *saved_account;
+    const uint8_t *pc;
+    int opcode, arg_allocated_size, i;
+    JSValue *local_buf, *stack_buf, *var_buf, *arg_buf, *sp, ret_val, *pval;
+    JSVarRef **var_refs;
+    size_t alloca_size;
+#ifdef CONFIG_JIT
+    JSJitFrame jf;
+    int jit_ret;
+#endif
+
+#if DIRECT_DISPATCH
+    static const void * const dispatch_table[256] = {
+#define DEF(id, size, n_pop, n_push, f) && case_OP_ ## id,
+#define def(id, size, n_pop, n_push, f)
+#include "qjs-opcode.h"
+        [ OP_TEMP_START ... 255 ] = &&case_default,
+    };
+#define SWITCH(pc)      goto *dispatch_table[opcode = *pc++];
+#define CASE(op)        case_ ## op
+#define DEFAULT         case_default
+#define BREAK           SWITCH(pc)
+#else
+#define SWITCH(pc)      switch (opcode = *pc++)
+#define CASE(op)        case op
+#define DEFAULT         default
+#define BREAK           break
+#endif
+
+    if (js_poll_interrupts(caller_ctx))
+        return JS_EXCEPTION;
+    if (unlikely(flags & JS_CALL_FLAG_GENERATOR)) {
+        JSAsyncFrame *af = JS_VALUE_GET_PTR(func_obj);
+
+        /* resume the suspended frame */
+        func_obj = af->func_obj;
+        this_obj = af->this_val;
+        p = JS_VALUE_GET_OBJ(func_obj);
+        b = p->u.func.function_bytecode;
+        if (js_check_stack_overflow(rt, 0))
+            return JS_ThrowInternalError(caller_ctx, "stack overflow");
+        ctx = p->u.func.realm;
+        saved_account = rt->malloc_account;
+        rt->malloc_account = ctx->mem_account;
+        sf = &af->sf;
+        arg_buf = sf->arg_buf;
+        var_buf = sf->var_buf;
+        local_buf = af->buf;
+        stack_buf = var_buf + b->var_count;
+        sp = af->sp;
+        pc = af->pc;
+        var_refs = p->u.func.var_refs;
+        if (af->throw_flag) {
+            af->throw_flag = FALSE;
+            goto exception;
+        }
+        goto restart;
+    }
+    if (unlikely(!JS_IsObject(func_obj)))
+        goto not_a_function;
+    p = JS_VALUE_GET_OBJ(func_obj);
+    if (unlikely(p->class_id != JS_CLASS_BYTECODE_FUNCTION)) {
+        if (p->class_id == JS_CLASS_C_FUNCTION) {
+            if (js_check_stack_overflow(rt, 0))
+                return JS_ThrowInternalError(caller_ctx, "stack overflow");
+            return js_call_c_function(caller_ctx, func_obj, this_obj,
+                                      argc, (JSValueConst *)argv,
+                                      (flags & JS_CALL_FLAG_CONSTRUCTOR) != 0);
+        }
+    not_a_function:
+        return JS_ThrowTypeError(caller_ctx, "not a function");
+    }
+    b = p->u.func.function_bytecode;
+    if (unlikely(b->lazy)) {
+        b = js_link_lazy_function(p->u.func.realm, p);
+        if (!b)
+            return JS_EXCEPTION;
+    }
+    if (unlikely(b->is_generator))
+        return js_generator_function_call(caller_ctx, func_obj, this_obj,
+                                          argc, (JSValueConst *)argv);
+
+    if (unlikely(argc < b->arg_count || (flags & JS_CALL_FLAG_COPY_ARGV))) {
+        arg_allocated_size = b->arg_count;
+    } else {
+        arg_allocated_size = 0;
+    }
+    alloca_size = sizeof(JSValue) * (arg_allocated_size + b->var_count +
+                                     b->stack_size);
+    if (js_check_stack_overflow(rt, alloca_size))
+        return JS_ThrowInternalError(caller_ctx, "stack overflow");
+
+    /* the code runs in the realm of the function */
+    ctx = p->u.func.realm;
+    saved_account = rt->malloc_account;
+    rt->malloc_account = ctx->mem_account;
+
+    local_buf = alloca(alloca_size);
+    if (unlikely(arg_allocated_size)) {
+        int n = min_int(argc, b->arg_count);
+        arg_buf = local_buf;
+        for(i = 0; i < n; i++)
+            arg_buf[i] = JS_DupValue(caller_ctx, argv[i]);
+        for(; i < b->arg_count; i++)
+            arg_buf[i] = JS_UNDEFINED;
+    } else {
+        arg_buf = argv;
+    }
+    var_buf = local_buf + arg_allocated_size;
+    for(i = 0; i < b->var_count; i++)
+        var_buf[i] = JS_UNDEFINED;
+    stack_buf = var_buf + b->var_count;
+    sp = stack_buf;
+    sf->arg_buf = arg_buf;
+    sf->var_buf = var_buf;
+    init_list_head(&sf->var_ref_list);
+    sf->async_frame = NULL;
+    var_refs = p->u.func.var_refs;
+    pc = b->byte_code_buf;
+
+#ifdef CONFIG_JIT
+    if (js_jit_check(ctx, b, pc)) {
+    jit_enter:
+        jf.ctx = ctx;
+        jf.sp = sp;
+        jf.var_buf = var_buf;
+        jf.arg_buf = arg_buf;
+        jf.var_refs = var_refs;
+        jf.sf = sf;
+        jf.b = b;
+        jf.func_obj = func_obj;
+        jf.this_obj = this_obj;
+        jf.new_target = new_target;
+        jit_ret = js_jit_run(&jf, pc);
+        sp = jf.sp;
+        pc = b->byte_code_buf + jf.pc;
+        if (jit_ret == JS_JIT_RETURN) {
+            ret_val = jf.ret_val;
+            goto done;
+        }
+        if (jit_ret == JS_JIT_EXCEPTION)
+            goto exception;
+        /* JS_JIT_EXIT: the instruction at pc is interpreted */
+    }
+#endif
+
+ restart:
+    for(;;) {
+        int call_argc;
+        JSValue *call_argv;
+        JSValue op1, op2;
+        JSAtom atom;
+        int32_t diff;
+        int idx, res;
+        JSProperty *pr;
+
+        SWITCH(pc) {
+        CASE(OP_push_i32):
+            *sp++ = JS_NewInt32(ctx, get_i32(pc));
+            pc += 4;
+            BREAK;
+        CASE(OP_push_const):
+            idx = js_bc_get_leb128(&pc);
+            *sp++ = JS_DupValue(ctx, b->cpool[idx]);
+            BREAK;
+        CASE(OP_fclosure):
+            idx = js_bc_get_leb128(&pc);
+            op1 = js_closure(ctx, JS_DupValue(ctx, b->cpool[idx]),
+                             var_refs, sf);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            *sp++ = op1;
+            BREAK;
+        CASE(OP_push_atom_value):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            *sp++ = JS_AtomToString(ctx, atom);
+            BREAK;
+        CASE(OP_undefined):
+            *sp++ = JS_UNDEFINED;
+            BREAK;
+        CASE(OP_null):
+            *sp++ = JS_NULL;
+            BREAK;
+        CASE(OP_push_this):
+            /* in sloppy mode, the global object replaces a missing
+               'this' (no primitive wrappers yet) */
+            if (!b->is_strict &&
+                (JS_IsUndefined(this_obj) || JS_IsNull(this_obj))) {
+                *sp++ = JS_DupValue(ctx, ctx->global_obj);
+            } else {
+                *sp++ = JS_DupValue(ctx, this_obj);
+            }
+            BREAK;
+        CASE(OP_push_false):
+            *sp++ = JS_FALSE;
+            BREAK;
+        CASE(OP_push_true):
+            *sp++ = JS_TRUE;
+            BREAK;
+        CASE(OP_object):
+            op1 = JS_NewObject(ctx);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            *sp++ = op1;
+            BREAK;
+        CASE(OP_special_object):
+            if (*pc++ == OP_SPECIAL_OBJECT_THIS_FUNC)
+                *sp++ = JS_DupValue(ctx, func_obj);
+            else
+                *sp++ = JS_DupValue(ctx, new_target);
+            BREAK;
+        CASE(OP_array_from):
+            call_argc = get_u16(pc);
+            pc += 2;
+            op1 = js_create_array(ctx, call_argc, sp - call_argc);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            sp -= call_argc;
+            *sp++ = op1;
+            BREAK;
+
+        CASE(OP_drop):
+            JS_FreeValue(ctx, sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_nip):
+            JS_FreeValue(ctx, sp[-2]);
+            sp[-2] = sp[-1];
+            sp--;
+            BREAK;
+        CASE(OP_dup):
+            sp[0] = JS_DupValue(ctx, sp[-1]);
+            sp++;
+            BREAK;
+        CASE(OP_dup2): /* a b -> a b a b */
+            sp[0] = JS_DupValue(ctx, sp[-2]);
+            sp[1] = JS_DupValue(ctx, sp[-1]);
+            sp += 2;
+            BREAK;
+        CASE(OP_insert2): /* obj a -> a obj a */
+            sp[0] = sp[-1];
+            sp[-1] = sp[-2];
+            sp[-2] = JS_DupValue(ctx, sp[0]);
+            sp++;
+            BREAK;
+        CASE(OP_insert3): /* obj prop a -> a obj prop a */
+            sp[0] = sp[-1];
+            sp[-1] = sp[-2];
+            sp[-2] = sp[-3];
+            sp[-3] = JS_DupValue(ctx, sp[0]);
+            sp++;
+            BREAK;
+        CASE(OP_perm3): /* obj a b -> a obj b */
+            op1 = sp[-2];
+            sp[-2] = sp[-3];
+            sp[-3] = op1;
+            BREAK;
+        CASE(OP_perm4): /* obj prop a b -> a obj prop b */
+            op1 = sp[-2];
+            sp[-2] = sp[-3];
+            sp[-3] = sp[-4];
+            sp[-4] = op1;
+            BREAK;
+        CASE(OP_swap):
+            op1 = sp[-2];
+            sp[-2] = sp[-1];
+            sp[-1] = op1;
+            BREAK;
+        CASE(OP_rot3l): /* x a b -> a b x */
+            op1 = sp[-3];
+            sp[-3] = sp[-2];
+            sp[-2] = sp[-1];
+            sp[-1] = op1;
+            BREAK;
+
+        CASE(OP_call0):
+        CASE(OP_call1):
+        CASE(OP_call2):
+        CASE(OP_call3):
+            call_argc = opcode - OP_call0;
+            goto has_call_argc;
+        CASE(OP_call):
+            call_argc = get_u16(pc);
+            pc += 2;
+        has_call_argc:
+            call_argv = sp - call_argc;
+            ret_val = JS_CallInternal(ctx, call_argv[-1], JS_UNDEFINED,
+                                      JS_UNDEFINED, call_argc, call_argv, 0);
+            if (unlikely(JS_IsException(ret_val)))
+                goto exception;
+            for(pval = call_argv - 1; pval < sp; pval++)
+                JS_FreeValue(ctx, *pval);
+            sp = call_argv;
+            sp[-1] = ret_val;
+            BREAK;
+        CASE(OP_call_method):
+            call_argc = get_u16(pc);
+            pc += 2;
+            call_argv = sp - call_argc;
+            ret_val = JS_CallInternal(ctx, call_argv[-1], call_argv[-2],
+                                      JS_UNDEFINED, call_argc, call_argv, 0);
+            if (unlikely(JS_IsException(ret_val)))
+                goto exception;
+            for(pval = call_argv - 2; pval < sp; pval++)
+                JS_FreeValue(ctx, *pval);
+            sp = call_argv - 1;
+            sp[-1] = ret_val;
+            BREAK;
+        CASE(OP_call_constructor):
+            call_argc = get_u16(pc);
+            pc += 2;
+            call_argv = sp - call_argc;
+            ret_val = JS_CallConstructorInternal(ctx, call_argv[-1],
+                                                 call_argv[-1], call_argc,
+                                                 call_argv, 0);
+            if (unlikely(JS_IsException(ret_val)))
+                goto exception;
+            for(pval = call_argv - 1; pval < sp; pval++)
+                JS_FreeValue(ctx, *pval);
+            sp = call_argv;
+            sp[-1] = ret_val;
+            BREAK;
+        CASE(OP_return):
+            ret_val = *--sp;
+            goto done;
+        CASE(OP_return_undef):
+            ret_val = JS_UNDEFINED;
+            goto done;
+        CASE(OP_throw):
+            JS_Throw(ctx, *--sp);
+            goto exception;
+        CASE(OP_throw_error):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            if (*pc++ == JS_THROW_VAR_RO)
+                JS_ThrowTypeErrorAtom(ctx, "'%s' is read-only", atom);
+            else
+                js_throw_uninitialized(ctx, atom);
+            goto exception;
+
+        CASE(OP_get_var_undef):
+        CASE(OP_get_var):
+            idx = js_bc_get_leb128(&pc);
+            pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(ctx->global_obj),
+                                FALSE);
+            if (likely(pr != NULL)) {
+                *sp++ = JS_DupValue(ctx, pr->value);
+                BREAK;
+            }
+            atom = b->atoms[idx];
+            op1 = js_get_global_var(ctx, atom, opcode == OP_get_var);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            *sp++ = op1;
+            BREAK;
+        CASE(OP_put_var):
+        CASE(OP_put_var_strict):
+            idx = js_bc_get_leb128(&pc);
+            pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(ctx->global_obj),
+                                TRUE);
+            if (likely(pr != NULL)) {
+                set_value(ctx, &pr->value, *--sp);
+                BREAK;
+            }
+            atom = b->atoms[idx];
+            res = js_put_global_var(ctx, atom, sp[-1], b->is_strict,
+                                    opcode == OP_put_var_strict);
+            sp--;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+        CASE(OP_delete_var):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            res = JS_DeleteProperty(ctx, ctx->global_obj, atom, 0);
+            if (unlikely(res < 0))
+                goto exception;
+            *sp++ = JS_NewBool(ctx, res);
+            BREAK;
+        CASE(OP_define_var):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            if (js_define_global_var(ctx, atom) < 0)
+                goto exception;
+            BREAK;
+        CASE(OP_define_func):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            res = JS_DefinePropertyValue(ctx, ctx->global_obj, atom, sp[-1],
+                                         JS_PROP_WRITABLE | JS_PROP_ENUMERABLE |
+                                         JS_PROP_THROW);
+            sp--;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+
+        CASE(OP_get_loc_get_field):
+            op1 = var_buf[*pc++];
+            goto get_var_field;
+        CASE(OP_get_arg_get_field):
+            op1 = arg_buf[*pc++];
+        get_var_field:
+            idx = js_bc_get_leb128(&pc);
+            /* the variable is only pushed in the slow case */
+            if (likely(JS_VALUE_GET_TAG(op1) == JS_TAG_OBJECT)) {
+                pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(op1), FALSE);
+                if (likely(pr != NULL)) {
+                    *sp++ = JS_DupValue(ctx, pr->value);
+                    BREAK;
+                }
+            }
+            *sp++ = JS_DupValue(ctx, op1);
+            goto get_field_slow;
+        CASE(OP_get_field):
+            idx = js_bc_get_leb128(&pc);
+            if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT)) {
+                pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(sp[-1]),
+                                    FALSE);
+                if (likely(pr != NULL)) {
+                    op1 = JS_DupValue(ctx, pr->value);
+                    JS_FreeValue(ctx, sp[-1]);
+                    sp[-1] = op1;
+                    BREAK;
+                }
+            }
+        get_field_slow:
+            atom = b->atoms[idx];
+            op1 = JS_GetProperty(ctx, sp[-1], atom);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = op1;
+            BREAK;
+        CASE(OP_get_field2):
+            idx = js_bc_get_leb128(&pc);
+            if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT)) {
+                pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(sp[-1]),
+                                    FALSE);
+                if (likely(pr != NULL)) {
+                    *sp++ = JS_DupValue(ctx, pr->value);
+                    BREAK;
+                }
+            }
+            atom = b->atoms[idx];
+            op1 = JS_GetProperty(ctx, sp[-1], atom);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            *sp++ = op1;
+            BREAK;
+        CASE(OP_put_field):
+            idx = js_bc_get_leb128(&pc);
+            if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT)) {
+                pr = js_ic_get_prop(rt, b, idx, JS_VALUE_GET_OBJ(sp[-2]),
+                                    TRUE);
+                if (likely(pr != NULL)) {
+                    set_value(ctx, &pr->value, sp[-1]);
+                    JS_FreeValue(ctx, sp[-2]);
+                    sp -= 2;
+                    BREAK;
+                }
+            }
+            atom = b->atoms[idx];
+            res = JS_SetPropertyInternal(ctx, sp[-2], atom, sp[-1],
+                                         b->is_strict ? JS_PROP_THROW : 0);
+            JS_FreeValue(ctx, sp[-2]);
+            sp -= 2;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+        CASE(OP_define_field):
+            atom = b->atoms[js_bc_get_leb128(&pc)];
+            res = JS_DefinePropertyValue(ctx, sp[-2], atom, sp[-1],
+                                         JS_PROP_C_W_E | JS_PROP_THROW);
+            sp--;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+        CASE(OP_get_array_el):
+            if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT &&
+                       JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_INT)) {
+                p = JS_VALUE_GET_OBJ(sp[-2]);
+                idx = JS_VALUE_GET_INT(sp[-1]);
+                if (likely(p->fast_array &&
+                           (uint32_t)idx < p->u.array.count)) {
+                    op1 = js_array_get_fast(ctx, p, idx);
+                    JS_FreeValue(ctx, sp[-2]);
+                    sp--;
+                    sp[-1] = op1;
+                    BREAK;
+                }
+            }
+            op1 = js_get_property_value(ctx, sp[-2], sp[-1]);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            JS_FreeValue(ctx, sp[-2]);
+            JS_FreeValue(ctx, sp[-1]);
+            sp--;
+            sp[-1] = op1;
+            BREAK;
+        CASE(OP_get_array_el2): /* obj prop -> obj value */
+            if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT &&
+                       JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_INT)) {
+                p = JS_VALUE_GET_OBJ(sp[-2]);
+                idx = JS_VALUE_GET_INT(sp[-1]);
+                if (likely(p->fast_array &&
+                           (uint32_t)idx < p->u.array.count)) {
+                    sp[-1] = js_array_get_fast(ctx, p, idx);
+                    BREAK;
+                }
+            }
+            op1 = js_get_property_value(ctx, sp[-2], sp[-1]);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = op1;
+            BREAK;
+        CASE(OP_put_array_el):
+            if (likely(JS_VALUE_GET_TAG(sp[-3]) == JS_TAG_OBJECT &&
+                       JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_INT)) {
+                p = JS_VALUE_GET_OBJ(sp[-3]);
+                idx = JS_VALUE_GET_INT(sp[-2]);
+                if (likely(p->fast_array && (uint32_t)idx < p->u.array.count &&
+                           js_array_set_fast(ctx, p, idx, sp[-1]))) {
+                    JS_FreeValue(ctx, sp[-3]);
+                    sp -= 3;
+                    BREAK;
+                }
+            }
+            res = js_put_property_value(ctx, sp[-3], sp[-2], sp[-1],
+                                        b->is_strict ? JS_PROP_THROW : 0);
+            JS_FreeValue(ctx, sp[-3]);
+            JS_FreeValue(ctx, sp[-2]);
+            sp -= 3;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+        CASE(OP_define_array_el):
+            res = js_define_property_value(ctx, sp[-3], sp[-2], sp[-1]);
+            JS_FreeValue(ctx, sp[-2]);
+            sp -= 2;
+            if (unlikely(res < 0))
+                goto exception;
+            BREAK;
+        CASE(OP_delete):
+            atom = JS_ValueToAtom(ctx, sp[-1]);
+            if (unlikely(atom == JS_ATOM_NULL))
+                goto exception;
+            res = JS_DeleteProperty(ctx, sp[-2], atom,
+                                    b->is_strict ? JS_PROP_THROW : 0);
+            JS_FreeAtom(ctx, atom);
+            if (unlikely(res < 0))
+                goto exception;
+            JS_FreeValue(ctx, sp[-2]);
+            JS_FreeValue(ctx, sp[-1]);
+            sp--;
+            sp[-1] = JS_NewBool(ctx, res);
+            BREAK;
+
+        CASE(OP_get_loc):
+            idx = get_u16(pc);
+            pc += 2;
+            *sp++ = JS_DupValue(ctx, var_buf[idx]);
+            BREAK;
+        CASE(OP_put_loc):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, &var_buf[idx], sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_set_loc):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, &var_buf[idx], JS_DupValue(ctx, sp[-1]));
+            BREAK;
+        CASE(OP_get_arg):
+            idx = get_u16(pc);
+            pc += 2;
+            *sp++ = JS_DupValue(ctx, arg_buf[idx]);
+            BREAK;
+        CASE(OP_put_arg):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, &arg_buf[idx], sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_set_arg):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, &arg_buf[idx], JS_DupValue(ctx, sp[-1]));
+            BREAK;
+        CASE(OP_get_var_ref):
+            idx = get_u16(pc);
+            pc += 2;
+            *sp++ = JS_DupValue(ctx, *var_refs[idx]->pvalue);
+            BREAK;
+        CASE(OP_put_var_ref):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, var_refs[idx]->pvalue, sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_set_var_ref):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, var_refs[idx]->pvalue, JS_DupValue(ctx, sp[-1]));
+            BREAK;
+        CASE(OP_set_loc_uninitialized):
+            idx = get_u16(pc);
+            pc += 2;
+            set_value(ctx, &var_buf[idx], JS_UNINITIALIZED);
+            BREAK;
+        CASE(OP_get_loc_check):
+            idx = get_u16(pc);
+            pc += 2;
+            if (unlikely(JS_IsUninitialized(var_buf[idx]))) {
+                js_throw_uninitialized(ctx, b->vardefs[b->arg_count + idx].var_name);
+                goto exception;
+            }
+            *sp++ = JS_DupValue(ctx, var_buf[idx]);
+            BREAK;
+        CASE(OP_put_loc_check):
+            idx = get_u16(pc);
+            pc += 2;
+            if (unlikely(JS_IsUninitialized(var_buf[idx]))) {
+                js_throw_uninitialized(ctx, b->vardefs[b->arg_count + idx].var_name);
+                goto exception;
+            }
+            set_value(ctx, &var_buf[idx], sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_get_var_ref_check):
+            idx = get_u16(pc);
+            pc += 2;
+            op1 = *var_refs[idx]->pvalue;
+            if (unlikely(JS_IsUninitialized(op1))) {
+                js_throw_uninitialized(ctx, b->closure_var[idx].var_name);
+                goto exception;
+            }
+            *sp++ = JS_DupValue(ctx, op1);
+            BREAK;
+        CASE(OP_put_var_ref_check):
+            idx = get_u16(pc);
+            pc += 2;
+            if (unlikely(JS_IsUninitialized(*var_refs[idx]->pvalue))) {
+                js_throw_uninitialized(ctx, b->closure_var[idx].var_name);
+                goto exception;
+            }
+            set_value(ctx, var_refs[idx]->pvalue, sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_close_loc):
+            idx = get_u16(pc);
+            pc += 2;
+            close_lexical_var(ctx, sf, idx);
+            BREAK;
+
+        CASE(OP_if_false):
+        CASE(OP_if_true):
+            op1 = sp[-1];
+            /* int, bool, null and undefined: the payload is the value */
+            if ((uint32_t)JS_VALUE_GET_TAG(op1) <= JS_TAG_UNDEFINED)
+                res = JS_VALUE_GET_INT(op1);
+            else
+                res = JS_ToBool(ctx, op1);
+            JS_FreeValue(ctx, op1);
+            sp--;
+            if ((res != 0) == (opcode == OP_if_true)) {
+                diff = get_i32(pc);
+                goto has_jump;
+            }
+            pc += 4;
+            BREAK;
+        CASE(OP_goto):
+            diff = get_i32(pc);
+        has_jump:
+            pc += diff;
+            /* the loops are the backward jumps */
+            if (unlikely(diff < 0)) {
+                if (js_poll_interrupts(ctx))
+                    goto exception;
+#ifdef CONFIG_JIT
+                if (js_jit_check(ctx, b, pc))
+                    goto jit_enter;
+#endif
+            }
+            BREAK;
+        CASE(OP_if_false8):
+        CASE(OP_if_true8):
+            op1 = sp[-1];
+            if ((uint32_t)JS_VALUE_GET_TAG(op1) <= JS_TAG_UNDEFINED)
+                res = JS_VALUE_GET_INT(op1);
+            else
+                res = JS_ToBool(ctx, op1);
+            JS_FreeValue(ctx, op1);
+            sp--;
+            if ((res != 0) == (opcode == OP_if_true8)) {
+                diff = (int8_t)*pc;
+                goto has_jump;
+            }
+            pc += 1;
+            BREAK;
+        CASE(OP_goto8):
+            diff = (int8_t)*pc;
+            goto has_jump;
+        CASE(OP_goto16):
+            diff = get_i16(pc);
+            goto has_jump;
+        CASE(OP_catch):
+            diff = get_i32(pc);
+            sp[0] = JS_MKVAL(JS_TAG_CATCH_OFFSET, pc + diff - b->byte_code_buf);
+            sp++;
+            pc += 4;
+            BREAK;
+        CASE(OP_gosub):
+            diff = get_i32(pc);
+            /* the finally block returns after the instruction */
+            sp[0] = JS_NewInt32(ctx, pc + 4 - b->byte_code_buf);
+            sp++;
+            pc += diff;
+            BREAK;
+        CASE(OP_ret):
+            op1 = sp[-1];
+            if (unlikely(JS_VALUE_GET_TAG(op1) != JS_TAG_INT ||
+                         (uint32_t)JS_VALUE_GET_INT(op1) >= b->byte_code_len)) {
+                JS_ThrowInternalError(ctx, "invalid ret value");
+                goto exception;
+            }
+            sp--;
+            pc = b->byte_code_buf + JS_VALUE_GET_INT(op1);
+            BREAK;
+        CASE(OP_nip_catch): /* catch_offset ... a -> a */
+            op1 = *--sp;
+            do {
+                op2 = *--sp;
+                JS_FreeValue(ctx, op2);
+            } while (JS_VALUE_GET_TAG(op2) != JS_TAG_CATCH_OFFSET);
+            *sp++ = op1;
+            BREAK;
+        CASE(OP_initial_yield):
+            ret_val = JS_UNDEFINED;
+            goto suspend;
+        CASE(OP_yield):
+            /* the caller pushes the received value and is_return */
+            ret_val = *--sp;
+            goto suspend;
+
+        CASE(OP_neg):
+            op1 = sp[-1];
+            /* -0 and -INT32_MIN are not int32 */
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT &&
+                (JS_VALUE_GET_INT(op1) & 0x7fffffff) != 0) {
+                sp[-1] = JS_NewInt32(ctx, -JS_VALUE_GET_INT(op1));
+            } else if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(op1))) {
+                sp[-1] = JS_NewFloat64(ctx, -JS_VALUE_GET_FLOAT64(op1));
+            } else {
+                if (js_unary_arith_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_plus):
+            if (!JS_IsNumber(sp[-1])) {
+                if (js_unary_arith_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_inc):
+            op1 = sp[-1];
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT &&
+                JS_VALUE_GET_INT(op1) != INT32_MAX) {
+                sp[-1] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) + 1);
+            } else {
+                if (js_unary_arith_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_dec):
+            op1 = sp[-1];
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT &&
+                JS_VALUE_GET_INT(op1) != INT32_MIN) {
+                sp[-1] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) - 1);
+            } else {
+                if (js_unary_arith_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_post_inc):
+            op1 = sp[-1];
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT &&
+                JS_VALUE_GET_INT(op1) != INT32_MAX) {
+                sp[0] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) + 1);
+            } else {
+                if (js_post_inc_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            sp++;
+            BREAK;
+        CASE(OP_post_dec):
+            op1 = sp[-1];
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT &&
+                JS_VALUE_GET_INT(op1) != INT32_MIN) {
+                sp[0] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) - 1);
+            } else {
+                if (js_post_inc_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            sp++;
+            BREAK;
+        CASE(OP_not):
+            op1 = sp[-1];
+            if (JS_VALUE_GET_TAG(op1) == JS_TAG_INT) {
+                sp[-1] = JS_NewInt32(ctx, ~JS_VALUE_GET_INT(op1));
+            } else {
+                if (js_unary_arith_slow(ctx, sp, opcode))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_lnot):
+            op1 = sp[-1];
+            if ((uint32_t)JS_VALUE_GET_TAG(op1) <= JS_TAG_UNDEFINED)
+                res = JS_VALUE_GET_INT(op1) != 0;
+            else
+                res = JS_ToBool(ctx, op1);
+            JS_FreeValue(ctx, op1);
+            sp[-1] = JS_NewBool(ctx, !res);
+            BREAK;
+        CASE(OP_typeof):
+            op1 = js_typeof(ctx, sp[-1]);
+            if (unlikely(JS_IsException(op1)))
+                goto exception;
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = op1;
+            BREAK;
+
+        CASE(OP_add):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                int64_t r;
+                r = (int64_t)JS_VALUE_GET_INT(op1) + JS_VALUE_GET_INT(op2);
+                if (unlikely((int)r != r))
+                    goto add_slow;
+                sp[-2] = JS_NewInt32(ctx, r);
+                sp--;
+            } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+                sp[-2] = JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) +
+                                       JS_VALUE_GET_FLOAT64(op2));
+                sp--;
+            } else {
+            add_slow:
+                if (js_add_slow(ctx, sp))
+                    goto exception;
+                sp--;
+            }
+            BREAK;
+        CASE(OP_add_i8):
+            op1 = sp[-1];
+            if (likely(JS_VALUE_GET_TAG(op1) == JS_TAG_INT)) {
+                int64_t r;
+                r = (int64_t)JS_VALUE_GET_INT(op1) + (int8_t)*pc;
+                if (likely((int)r == r)) {
+                    sp[-1] = JS_NewInt32(ctx, r);
+                    pc += 1;
+                    BREAK;
+                }
+            } else if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(op1))) {
+                sp[-1] = JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) +
+                                       (int8_t)*pc);
+                pc += 1;
+                BREAK;
+            }
+            if (js_add_imm_slow(ctx, sp, (int8_t)*pc))
+                goto exception;
+            pc += 1;
+            BREAK;
+        CASE(OP_sub):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                int64_t r;
+                r = (int64_t)JS_VALUE_GET_INT(op1) - JS_VALUE_GET_INT(op2);
+                if (unlikely((int)r != r))
+                    goto binary_arith_slow;
+                sp[-2] = JS_NewInt32(ctx, r);
+                sp--;
+            } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+                sp[-2] = JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) -
+                                       JS_VALUE_GET_FLOAT64(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_mul):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                int32_t v1, v2;
+                int64_t r;
+                v1 = JS_VALUE_GET_INT(op1);
+                v2 = JS_VALUE_GET_INT(op2);
+                r = (int64_t)v1 * v2;
+                if (unlikely((int)r != r))
+                    goto binary_arith_slow;
+                /* -0 is a float */
+                if (unlikely(r == 0 && (v1 | v2) < 0))
+                    goto binary_arith_slow;
+                sp[-2] = JS_NewInt32(ctx, r);
+                sp--;
+            } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+                sp[-2] = JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) *
+                                       JS_VALUE_GET_FLOAT64(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_mod):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2)) &&
+                JS_VALUE_GET_INT(op1) >= 0 && JS_VALUE_GET_INT(op2) > 0) {
+                sp[-2] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) %
+                                     JS_VALUE_GET_INT(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_div):
+        CASE(OP_pow):
+        binary_arith_slow:
+            if (js_binary_arith_slow(ctx, sp, opcode))
+                goto exception;
+            sp--;
+            BREAK;
+        CASE(OP_shl):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewInt32(ctx, (uint32_t)JS_VALUE_GET_INT(op1) <<
+                                     (JS_VALUE_GET_INT(op2) & 0x1f));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_sar):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) >>
+                                     (JS_VALUE_GET_INT(op2) & 0x1f));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_shr):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                uint32_t r;
+                r = (uint32_t)JS_VALUE_GET_INT(op1) >>
+                    (JS_VALUE_GET_INT(op2) & 0x1f);
+                sp[-2] = JS_NewNumber(ctx, r);
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_and):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) &
+                                     JS_VALUE_GET_INT(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_or):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) |
+                                     JS_VALUE_GET_INT(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+        CASE(OP_xor):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewInt32(ctx, JS_VALUE_GET_INT(op1) ^
+                                     JS_VALUE_GET_INT(op2));
+                sp--;
+            } else {
+                goto binary_arith_slow;
+            }
+            BREAK;
+
+#define OP_CMP(opcode, binary_op)                                       \
+        CASE(opcode):                                                   \
+            op1 = sp[-2];                                               \
+            op2 = sp[-1];                                               \
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {               \
+                sp[-2] = JS_NewBool(ctx, JS_VALUE_GET_INT(op1) binary_op \
+                                    JS_VALUE_GET_INT(op2));             \
+                sp--;                                                   \
+            } else {                                                    \
+                if (js_relational_slow(ctx, sp, opcode))                \
+                    goto exception;                                     \
+                sp--;                                                   \
+            }                                                           \
+            BREAK
+
+        OP_CMP(OP_lt, <);
+        OP_CMP(OP_lte, <=);
+        OP_CMP(OP_gt, >);
+        OP_CMP(OP_gte, >=);
+#undef OP_CMP
+
+        /* comparison and if_false. 'size' is the size of the offset. */
+#define OP_CMP_IF_FALSE(opcode, cmp_opcode, binary_op, get_diff, size)  \
+        CASE(opcode):                                                   \
+            op1 = sp[-2];                                               \
+            op2 = sp[-1];                                               \
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {               \
+                res = JS_VALUE_GET_INT(op1) binary_op JS_VALUE_GET_INT(op2); \
+            } else {                                                    \
+                if (js_relational_slow(ctx, sp, cmp_opcode))            \
+                    goto exception;                                     \
+                res = JS_VALUE_GET_BOOL(sp[-2]);                        \
+            }                                                           \
+            sp -= 2;                                                    \
+            if (!res) {                                                 \
+                diff = get_diff;                                        \
+                goto has_jump;                                          \
+            }                                                           \
+            pc += size;                                                 \
+            BREAK
+
+        OP_CMP_IF_FALSE(OP_lt_if_false8, OP_lt, <, (int8_t)*pc, 1);
+        OP_CMP_IF_FALSE(OP_lte_if_false8, OP_lte, <=, (int8_t)*pc, 1);
+        OP_CMP_IF_FALSE(OP_gt_if_false8, OP_gt, >, (int8_t)*pc, 1);
+        OP_CMP_IF_FALSE(OP_gte_if_false8, OP_gte, >=, (int8_t)*pc, 1);
+        OP_CMP_IF_FALSE(OP_lt_if_false, OP_lt, <, get_i32(pc), 4);
+        OP_CMP_IF_FALSE(OP_lte_if_false, OP_lte, <=, get_i32(pc), 4);
+        OP_CMP_IF_FALSE(OP_gt_if_false, OP_gt, >, get_i32(pc), 4);
+        OP_CMP_IF_FALSE(OP_gte_if_false, OP_gte, >=, get_i32(pc), 4);
+#undef OP_CMP_IF_FALSE
+
+        CASE(OP_eq):
+        CASE(OP_neq):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewBool(ctx, (JS_VALUE_GET_INT(op1) ==
+                                          JS_VALUE_GET_INT(op2)) ^
+                                    (opcode == OP_neq));
+            } else {
+                if (js_eq_slow(ctx, sp, opcode == OP_neq))
+                    goto exception;
+            }
+            sp--;
+            BREAK;
+        CASE(OP_strict_eq):
+        CASE(OP_strict_neq):
+            op1 = sp[-2];
+            op2 = sp[-1];
+            if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                sp[-2] = JS_NewBool(ctx, (JS_VALUE_GET_INT(op1) ==
+                                          JS_VALUE_GET_INT(op2)) ^
+                                    (opcode == OP_strict_neq));
+            } else {
+                js_strict_eq_slow(ctx, sp, opcode == OP_strict_neq);
+            }
+            sp--;
+            BREAK;
+        CASE(OP_instanceof):
+        CASE(OP_in):
+            if (js_operator_slow(ctx, sp, opcode))
+                goto exception;
+            sp--;
+            BREAK;
+        CASE(OP_is_undefined_or_null):
+            op1 = sp[-1];
+            res = JS_IsUndefined(op1) || JS_IsNull(op1);
+            JS_FreeValue(ctx, op1);
+            sp[-1] = JS_NewBool(ctx, res);
+            BREAK;
+        CASE(OP_nop):
+            BREAK;
+
+        /* short forms */
+        CASE(OP_push_minus1):
+        CASE(OP_push_0):
+        CASE(OP_push_1):
+        CASE(OP_push_2):
+        CASE(OP_push_3):
+        CASE(OP_push_4):
+        CASE(OP_push_5):
+        CASE(OP_push_6):
+        CASE(OP_push_7):
+            *sp++ = JS_NewInt32(ctx, opcode - OP_push_0);
+            BREAK;
+        CASE(OP_push_i8):
+            *sp++ = JS_NewInt32(ctx, (int8_t)*pc);
+            pc += 1;
+            BREAK;
+        CASE(OP_push_i16):
+            *sp++ = JS_NewInt32(ctx, get_i16(pc));
+            pc += 2;
+            BREAK;
+        CASE(OP_get_loc8):
+            *sp++ = JS_DupValue(ctx, var_buf[*pc++]);
+            BREAK;
+        CASE(OP_put_loc8):
+            set_value(ctx, &var_buf[*pc++], sp[-1]);
+            sp--;
+            BREAK;
+        CASE(OP_set_loc8):
+            set_value(ctx, &var_buf[*pc++], JS_DupValue(ctx, sp[-1]));
+            BREAK;
+
+        CASE(OP_get_loc0): *sp++ = JS_DupValue(ctx, var_buf[0]); BREAK;
+        CASE(OP_get_loc1): *sp++ = JS_DupValue(ctx, var_buf[1]); BREAK;
+        CASE(OP_get_loc2): *sp++ = JS_DupValue(ctx, var_buf[2]); BREAK;
+        CASE(OP_get_loc3): *sp++ = JS_DupValue(ctx, var_buf[3]); BREAK;
+        CASE(OP_put_loc0): set_value(ctx, &var_buf[0], *--sp); BREAK;
+        CASE(OP_put_loc1): set_value(ctx, &var_buf[1], *--sp); BREAK;
+        CASE(OP_put_loc2): set_value(ctx, &var_buf[2], *--sp); BREAK;
+        CASE(OP_put_loc3): set_value(ctx, &var_buf[3], *--sp); BREAK;
+        CASE(OP_set_loc0): set_value(ctx, &var_buf[0], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_loc1): set_value(ctx, &var_buf[1], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_loc2): set_value(ctx, &var_buf[2], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_loc3): set_value(ctx, &var_buf[3], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_get_arg0): *sp++ = JS_DupValue(ctx, arg_buf[0]); BREAK;
+        CASE(OP_get_arg1): *sp++ = JS_DupValue(ctx, arg_buf[1]); BREAK;
+        CASE(OP_get_arg2): *sp++ = JS_DupValue(ctx, arg_buf[2]); BREAK;
+        CASE(OP_get_arg3): *sp++ = JS_DupValue(ctx, arg_buf[3]); BREAK;
+        CASE(OP_put_arg0): set_value(ctx, &arg_buf[0], *--sp); BREAK;
+        CASE(OP_put_arg1): set_value(ctx, &arg_buf[1], *--sp); BREAK;
+        CASE(OP_put_arg2): set_value(ctx, &arg_buf[2], *--sp); BREAK;
+        CASE(OP_put_arg3): set_value(ctx, &arg_buf[3], *--sp); BREAK;
+        CASE(OP_set_arg0): set_value(ctx, &arg_buf[0], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_arg1): set_value(ctx, &arg_buf[1], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_arg2): set_value(ctx, &arg_buf[2], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_arg3): set_value(ctx, &arg_buf[3], JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_get_var_ref0): *sp++ = JS_DupValue(ctx, *var_refs[0]->pvalue); BREAK;
+        CASE(OP_get_var_ref1): *sp++ = JS_DupValue(ctx, *var_refs[1]->pvalue); BREAK;
+        CASE(OP_get_var_ref2): *sp++ = JS_DupValue(ctx, *var_refs[2]->pvalue); BREAK;
+        CASE(OP_get_var_ref3): *sp++ = JS_DupValue(ctx, *var_refs[3]->pvalue); BREAK;
+        CASE(OP_put_var_ref0): set_value(ctx, var_refs[0]->pvalue, *--sp); BREAK;
+        CASE(OP_put_var_ref1): set_value(ctx, var_refs[1]->pvalue, *--sp); BREAK;
+        CASE(OP_put_var_ref2): set_value(ctx, var_refs[2]->pvalue, *--sp); BREAK;
+        CASE(OP_put_var_ref3): set_value(ctx, var_refs[3]->pvalue, *--sp); BREAK;
+        CASE(OP_set_var_ref0): set_value(ctx, var_refs[0]->pvalue, JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_var_ref1): set_value(ctx, var_refs[1]->pvalue, JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_var_ref2): set_value(ctx, var_refs[2]->pvalue, JS_DupValue(ctx, sp[-1])); BREAK;
+        CASE(OP_set_var_ref3): set_value(ctx, var_refs[3]->pvalue, JS_DupValue(ctx, sp[-1])); BREAK;
+
+        CASE(OP_invalid):
+        DEFAULT:
+            JS_ThrowInternalError(ctx, "invalid opcode: pc=%u opcode=0x%02x",
+                                  (int)(pc - b->byte_code_buf - 1), opcode);
+            goto exception;
+        }
+    }
+ exception:
+    js_set_error_location(ctx, b, pc);
+    if (!js_is_uncatchable_error(rt->current_exception)) {
+        while (sp > stack_buf) {
+            JSValue val = *--sp;
+            JS_FreeValue(ctx, val);
+            if (JS_VALUE_GET_TAG(val) == JS_TAG_CATCH_OFFSET) {
+                /* the exception replaces the catch offset */
+                *sp++ = rt->current_exception;
+                rt->current_exception = JS_NULL;
+                pc = b->byte_code_buf + JS_VALUE_GET_INT(val);
+                goto restart;
+            }
+        }
+    }
+    ret_val = JS_EXCEPTION;
+ done:
+    if (unlikely(sf->async_frame != NULL)) {
+        /* the generator closes its frame (see async_frame_close()) */
+        sf->async_frame->is_completed = TRUE;
+        goto suspend;
+    }
+    if (unlikely(!list_empty(&sf->var_ref_list))) {
+        /* the closures reference the frame */
+        close_var_refs(rt, sf);
+    }
+    for(pval = local_buf; pval < sp; pval++)
+        JS_FreeValue(ctx, *pval);
+    rt->malloc_account = saved_account;
+    return ret_val;
+ suspend:
+    sf->async_frame->pc = pc;
+    sf->async_frame->sp = sp;
+    rt->malloc_account = saved_account;
+    return ret_val;
+}
+
+JSValue JS_CallConstructorInternal(JSContext *ctx, JSValueConst func_obj,
+                                   JSValueConst new_target,
+                                   int argc, JSValue *argv, int flags)
+{
+    JSObject *p;
+    JSValue obj, ret;
+
+    if (unlikely(!JS_IsObject(func_obj)))
+        goto not_a_constructor;
+    p = JS_VALUE_GET_OBJ(func_obj);
+    if (unlikely(!p->is_constructor)) {
+    not_a_constructor:
+        return JS_ThrowTypeError(ctx, "not a constructor");
+    }
+    flags |= JS_CALL_FLAG_CONSTRUCTOR;
+    /* the C constructors receive new_target as 'this' */
+    if (p->class_id == JS_CLASS_C_FUNCTION)
+        return JS_CallInternal(ctx, func_obj, new_target, new_target,
+                               argc, argv, flags);
+    obj = js_create_from_ctor(ctx, new_target, JS_CLASS_OBJECT);
+    if (JS_IsException(obj))
+        return obj;
+    ret = JS_CallInternal(ctx, func_obj, obj, new_target, argc, argv, flags);
+    if (JS_IsObject(ret) || JS_IsException(ret)) {
+        JS_FreeValue(ctx, obj);
+        return ret;
+    }
+    JS_FreeValue(ctx, ret);
+    return obj;
+}
+
+JSValue JS_EvalFunction(JSContext *ctx, JSValue fun_obj)
+{
+    JSValue func, ret;
+
+    if (JS_VALUE_GET_TAG(fun_obj) != JS_TAG_FUNCTION_BYTECODE) {
+        JS_FreeValue(ctx, fun_obj);
+        return JS_ThrowTypeError(ctx, "bytecode function expected");
+    }
+    /* the global code has no closure variables */
+    func = js_closure(ctx, fun_obj, NULL, NULL);
+    if (JS_IsException(func))
+        return func;
+    ret = JS_CallInternal(ctx, func, ctx->global_obj, JS_UNDEFINED,
+                          0, NULL, 0);
+    JS_FreeValue(ctx, func);
+    return ret;
+}
@@ -0,0 +1,1374 @@
+#include "jit.h"
+
+void JS_SetJITEnabled(JSRuntime *rt, int enabled)
+{
+    rt->jit_enabled = (enabled != 0);
+}
+
+#ifdef CONFIG_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* The code of a function is generated in a single pass, each
+   instruction giving a fixed sequence of x86-64 instructions. The
+   common cases (local variables, stack manipulations, int32
+   arithmetic and comparisons, jumps) are inline. The other
+   instructions and the slow cases call js_jit_slow_op(), which runs
+   the instruction as the interpreter does. The few instructions which
+   change the control flow or the stack dynamically (ret, nip_catch
+   and the yields of the generators) return to the interpreter.
+
+   During the execution, the registers are:
+   rbx: stack pointer
+   r12: var_buf
+   r13: arg_buf
+   r14: JSJitFrame
+   r15: ctx
+   rbp: (JS_TAG_INT - JS_TAG_FIRST) << 48. It is both the tag of the
+        int32 values and the limit of the reference counted values.
+   They are callee saved, so the C functions are called without
+   saving anything: the values are always in the frame. */
+
+/* larger functions are not compiled */
+#define JS_JIT_MAX_BYTECODE_LEN (64 * 1024)
+
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+#define REG_SP      RBX
+#define REG_VAR_BUF R12
+#define REG_ARG_BUF R13
+#define REG_FRAME   R14
+#define REG_CTX     R15
+#define REG_TAG_INT RBP
+
+/* condition codes */
+enum {
+    CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G,
+};
+
+/* "op r/m, reg" instructions */
+#define X86_ADD   0x01
+#define X86_OR    0x09
+#define X86_AND   0x21
+#define X86_SUB   0x29
+#define X86_XOR   0x31
+#define X86_CMP   0x39
+#define X86_TEST  0x85
+#define X86_MOV   0x89
+#define X86_LOAD  0x8b /* mov reg, r/m */
+#define X86_IMUL  0x0faf /* imul reg, r/m */
+
+/* group 1 (immediate operand) */
+#define ALU_ADD 0
+#define ALU_OR  1
+#define ALU_AND 4
+#define ALU_SUB 5
+#define ALU_XOR 6
+#define ALU_CMP 7
+
+/* group 2 (shifts) */
+#define SHIFT_SHL 4
+#define SHIFT_SHR 5
+#define SHIFT_SAR 7
+
+#define SP_OFFSET(n) (-8 * (n)) /* offset of sp[-n] */
+#define FRAME_OFFSET(field) ((int32_t)offsetof(JSJitFrame, field))
+
+#define JS_VALUE_BOOL_TAG JS_MKVAL(JS_TAG_BOOL, 0)
+
+typedef struct JITFixup {
+    uint32_t pos; /* position of the rel32 operand */
+    uint32_t target; /* bytecode offset */
+} JITFixup;
+
+typedef struct JITState {
+    JSContext *ctx;
+    JSFunctionBytecode *b;
+    DynBuf code;
+    DynBuf fixups; /* JITFixup of the jumps of the bytecode */
+    uint32_t *pc_map;
+    uint32_t epilogue_pos;
+    uint32_t exception_pos;
+} JITState;
+
+typedef int JSJitEntry(JSJitFrame *f, const uint8_t *code);
+
+static inline uint32_t jit_pos(JITState *s)
+{
+    return s->code.size;
+}
+
+static void emit8(JITState *s, int v)
+{
+    dbuf_putc(&s->code, v);
+}
+
+static void emit32(JITState *s, uint32_t v)
+{
+    dbuf_put_u32(&s->code, v);
+}
+
+static void emit_bytes(JITState *s, const uint8_t *buf, int len)
+{
+    dbuf_put(&s->code, buf, len);
+}
+
+static void emit_rex(JITState *s, int w, int reg, int rm)
+{
+    int rex = (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+    if (rex)
+        emit8(s, 0x40 | rex);
+}
+
+static void emit_opcode(JITState *s, int op)
+{
+    if (op > 0xff)
+        emit8(s, op >> 8);
+    emit8(s, op & 0xff);
+}
+
+/* op reg, [base + disp] */
+static void emit_mem(JITState *s, int w, int op, int reg, int base,
+                     int32_t disp)
+{
+    BOOL disp8 = (disp == (int8_t)disp);
+
+    emit_rex(s, w, reg, base);
+    emit_opcode(s, op);
+    emit8(s, (disp8 ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit8(s, 0x24); /* SIB byte */
+    if (disp8)
+        emit8(s, disp);
+    else
+        emit32(s, disp);
+}
+
+/* op reg, rm (register operands) */
+static void emit_rr(JITState *s, int w, int op, int reg, int rm)
+{
+    emit_rex(s, w, reg, rm);
+    emit_opcode(s, op);
+    emit8(s, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* op dst, src for the "op r/m, reg" instructions */
+static void emit_alu(JITState *s, int w, int op, int dst, int src)
+{
+    emit_rr(s, w, op, src, dst);
+}
+
+static void emit_alu_imm(JITState *s, int w, int alu, int reg, int32_t imm)
+{
+    if (imm == (int8_t)imm) {
+        emit_rr(s, w, 0x83, alu, reg);
+        emit8(s, imm);
+    } else {
+        emit_rr(s, w, 0x81, alu, reg);
+        emit32(s, imm);
+    }
+}
+
+static void emit_shift_imm(JITState *s, int w, int shift, int reg, int n)
+{
+    emit_rr(s, w, 0xc1, shift, reg);
+    emit8(s, n);
+}
+
+static void emit_mov(JITState *s, int dst, int src)
+{
+    emit_rr(s, 1, X86_MOV, src, dst);
+}
+
+static void emit_mov_imm(JITState *s, int reg, uint64_t v)
+{
+    if (v <= UINT32_MAX) {
+        emit_rex(s, 0, 0, reg);
+        emit8(s, 0xb8 + (reg & 7));
+        emit32(s, v);
+    } else {
+        emit_rex(s, 1, 0, reg);
+        emit8(s, 0xb8 + (reg & 7));
+        dbuf_put_u64(&s->code, v);
+    }
+}
+
+static void emit_load(JITState *s, int reg, int base, int32_t disp)
+{
+    emit_mem(s, 1, X86_LOAD, reg, base, disp);
+}
+
+static void emit_store(JITState *s, int base, int32_t disp, int reg)
+{
+    emit_mem(s, 1, X86_MOV, reg, base, disp);
+}
+
+/* mov dword [base + disp], imm */
+static void emit_store32_imm(JITState *s, int base, int32_t disp,
+                             uint32_t imm)
+{
+    emit_mem(s, 0, 0xc7, 0, base, disp);
+    emit32(s, imm);
+}
+
+/* jump with a rel32 operand to be patched. Return its position. */
+static uint32_t emit_jcc(JITState *s, int cc)
+{
+    emit8(s, 0x0f);
+    emit8(s, 0x80 + cc);
+    emit32(s, 0);
+    return jit_pos(s) - 4;
+}
+
+static uint32_t emit_jmp(JITState *s)
+{
+    emit8(s, 0xe9);
+    emit32(s, 0);
+    return jit_pos(s) - 4;
+}
+
+static void patch_jump(JITState *s, uint32_t pos, uint32_t target)
+{
+    int32_t rel = target - (pos + 4);
+    if (!dbuf_error(&s->code))
+        memcpy(s->code.buf + pos, &rel, 4);
+}
+
+static void patch_here(JITState *s, uint32_t pos)
+{
+    patch_jump(s, pos, jit_pos(s));
+}
+
+static void emit_jcc_to(JITState *s, int cc, uint32_t target)
+{
+    patch_jump(s, emit_jcc(s, cc), target);
+}
+
+static void emit_jmp_to(JITState *s, uint32_t target)
+{
+    patch_jump(s, emit_jmp(s), target);
+}
+
+/* jump to the instruction at 'target' of the bytecode (cc < 0 if
+   unconditional) */
+static void emit_goto(JITState *s, int cc, uint32_t target)
+{
+    JITFixup fixup;
+
+    fixup.pos = (cc < 0) ? emit_jmp(s) : emit_jcc(s, cc);
+    fixup.target = target;
+    dbuf_put(&s->fixups, (uint8_t *)&fixup, sizeof(fixup));
+}
+
+static void emit_call(JITState *s, const void *func)
+{
+    emit_mov_imm(s, RAX, (uintptr_t)func);
+    emit_rr(s, 0, 0xff, 2, RAX); /* call rax */
+}
+
+static void emit_push(JITState *s, int reg)
+{
+    emit_store(s, REG_SP, 0, reg);
+    emit_alu_imm(s, 1, ALU_ADD, REG_SP, 8);
+}
+
+static void emit_pop(JITState *s, int reg)
+{
+    emit_load(s, reg, REG_SP, SP_OFFSET(1));
+    emit_alu_imm(s, 1, ALU_SUB, REG_SP, 8);
+}
+
+static void emit_push_imm(JITState *s, JSValue v)
+{
+    emit_mov_imm(s, RAX, v);
+    emit_push(s, RAX);
+}
+
+/* rdx = pointer of the value in 'reg' */
+static void emit_get_ptr(JITState *s, int reg)
+{
+    emit_mov(s, RDX, reg);
+    emit_shift_imm(s, 1, SHIFT_SHL, RDX, 64 - JS_VALUE_TAG_SHIFT);
+    emit_shift_imm(s, 1, SHIFT_SHR, RDX, 64 - JS_VALUE_TAG_SHIFT);
+}
+
+/* JS_DupValue(reg). Modifies rdx. */
+static void emit_dup_value(JITState *s, int reg)
+{
+    uint32_t j;
+
+    emit_alu(s, 1, X86_CMP, reg, REG_TAG_INT);
+    j = emit_jcc(s, CC_AE);
+    emit_get_ptr(s, reg);
+    emit_mem(s, 0, 0xff, 0, RDX, 0); /* inc ref_count */
+    patch_here(s, j);
+}
+
+/* JS_FreeValue(rax). Modifies the scratch registers. */
+static void emit_free_value(JITState *s)
+{
+    uint32_t j1, j2;
+
+    emit_alu(s, 1, X86_CMP, RAX, REG_TAG_INT);
+    j1 = emit_jcc(s, CC_AE);
+    emit_get_ptr(s, RAX);
+    emit_mem(s, 0, 0xff, 1, RDX, 0); /* dec ref_count */
+    j2 = emit_jcc(s, CC_G);
+    emit_mov(s, RSI, RAX);
+    emit_mov(s, RDI, REG_CTX);
+    emit_call(s, __JS_FreeValue);
+    patch_here(s, j1);
+    patch_here(s, j2);
+}
+
+/* set_value(ctx, &[base + disp], reg) with 'reg' not rax or rdx */
+static void emit_set_value(JITState *s, int base, int32_t disp, int reg)
+{
+    emit_load(s, RAX, base, disp);
+    emit_store(s, base, disp, reg);
+    emit_free_value(s);
+}
+
+/* jump if 'reg' is not an int32. Modifies rdx. */
+static uint32_t emit_check_int(JITState *s, int reg)
+{
+    emit_mov(s, RDX, reg);
+    emit_shift_imm(s, 1, SHIFT_SHR, RDX, JS_VALUE_TAG_SHIFT);
+    emit_alu_imm(s, 0, ALU_CMP, RDX, JS_TAG_INT - JS_TAG_FIRST);
+    return emit_jcc(s, CC_NE);
+}
+
+/* jump if 'reg' is not an int, a bool, null or undefined, whose
+   payload is their value. Modifies rdx. */
+static uint32_t emit_check_small(JITState *s, int reg)
+{
+    emit_mov(s, RDX, reg);
+    emit_shift_imm(s, 1, SHIFT_SHR, RDX, JS_VALUE_TAG_SHIFT);
+    emit_alu_imm(s, 0, ALU_SUB, RDX, JS_TAG_INT - JS_TAG_FIRST);
+    emit_alu_imm(s, 0, ALU_CMP, RDX, JS_TAG_UNDEFINED - JS_TAG_INT);
+    return emit_jcc(s, CC_A);
+}
+
+/* rcx = var_refs[idx]->pvalue */
+static void emit_var_ref_ptr(JITState *s, int idx)
+{
+    emit_load(s, RCX, REG_FRAME, FRAME_OFFSET(var_refs));
+    emit_load(s, RCX, RCX, idx * 8);
+    emit_load(s, RCX, RCX, offsetof(JSVarRef, pvalue));
+}
+
+/* rax = bool(eax 'cc' ecx) */
+static void emit_setcc_bool(JITState *s, int cc)
+{
+    const uint8_t movzx[] = { 0x0f, 0xb6, 0xc0 }; /* movzx eax, al */
+
+    emit8(s, 0x0f);
+    emit8(s, 0x90 + cc);
+    emit8(s, 0xc0); /* setcc al */
+    emit_bytes(s, movzx, sizeof(movzx));
+    emit_mov_imm(s, RCX, JS_VALUE_BOOL_TAG);
+    emit_alu(s, 1, X86_OR, RAX, RCX);
+}
+
+static void emit_store_pc(JITState *s, uint32_t pc_pos)
+{
+    emit_store32_imm(s, REG_FRAME, FRAME_OFFSET(pc), pc_pos);
+}
+
+/* the interpreter continues at the instruction 'pc_pos' */
+static void emit_exit(JITState *s, uint32_t pc_pos)
+{
+    emit_store(s, REG_FRAME, FRAME_OFFSET(sp), REG_SP);
+    emit_store_pc(s, pc_pos);
+    emit_mov_imm(s, RAX, JS_JIT_EXIT);
+    emit_jmp_to(s, s->epilogue_pos);
+}
+
+/* run the instruction at 'pc' with js_jit_slow_op() */
+static void emit_slow_op(JITState *s, const uint8_t *pc)
+{
+    void *func;
+
+    switch(*pc) {
+    case OP_get_var: func = js_jit_op_get_var; break;
+    case OP_get_var_undef: func = js_jit_op_get_var_undef; break;
+    case OP_put_var: func = js_jit_op_put_var; break;
+    case OP_get_field: func = js_jit_op_get_field; break;
+    case OP_get_loc_get_field: func = js_jit_op_get_loc_get_field; break;
+    case OP_get_arg_get_field: func = js_jit_op_get_arg_get_field; break;
+    case OP_get_field2: func = js_jit_op_get_field2; break;
+    case OP_put_field: func = js_jit_op_put_field; break;
+    case OP_get_array_el: func = js_jit_op_get_array_el; break;
+    case OP_put_array_el: func = js_jit_op_put_array_el; break;
+    case OP_call0: func = js_jit_op_call0; break;
+    case OP_call1: func = js_jit_op_call1; break;
+    case OP_call2: func = js_jit_op_call2; break;
+    case OP_call3: func = js_jit_op_call3; break;
+    case OP_call_method: func = js_jit_op_call_method; break;
+    default: func = js_jit_slow_op; break;
+    }
+    emit_mov(s, RDI, REG_FRAME);
+    emit_mov(s, RSI, REG_SP);
+    emit_mov_imm(s, RDX, (uintptr_t)pc);
+    emit_call(s, func);
+    emit_alu(s, 1, X86_TEST, RAX, RAX);
+    emit_jcc_to(s, CC_E, s->exception_pos);
+    emit_mov(s, REG_SP, RAX);
+}
+
+/* the interrupts are polled at the backward jumps, as in the
+   interpreter */
+static void emit_poll_interrupts(JITState *s, uint32_t pc_pos)
+{
+    uint32_t j1, j2;
+
+    emit_mov_imm(s, RAX, (uintptr_t)&s->ctx->rt->interrupt_counter);
+    emit_mem(s, 0, 0xff, 1, RAX, 0); /* dec */
+    j1 = emit_jcc(s, CC_G);
+    emit_mov(s, RDI, REG_CTX);
+    emit_call(s, __js_poll_interrupts);
+    emit_alu(s, 0, X86_TEST, RAX, RAX);
+    j2 = emit_jcc(s, CC_E);
+    emit_store(s, REG_FRAME, FRAME_OFFSET(sp), REG_SP);
+    emit_store_pc(s, pc_pos);
+    emit_jmp_to(s, s->exception_pos);
+    patch_here(s, j1);
+    patch_here(s, j2);
+}
+
+static void emit_prologue(JITState *s)
+{
+    static const int saved_regs[] = { RBX, RBP, R12, R13, R14, R15 };
+    int i;
+
+    for(i = 0; i < countof(saved_regs); i++) {
+        emit_rex(s, 0, 0, saved_regs[i]);
+        emit8(s, 0x50 + (saved_regs[i] & 7)); /* push */
+    }
+    /* align the stack for the calls */
+    emit_alu_imm(s, 1, ALU_SUB, RSP, 8);
+    emit_mov(s, REG_FRAME, RDI);
+    emit_load(s, REG_CTX, REG_FRAME, FRAME_OFFSET(ctx));
+    emit_load(s, REG_SP, REG_FRAME, FRAME_OFFSET(sp));
+    emit_load(s, REG_VAR_BUF, REG_FRAME, FRAME_OFFSET(var_buf));
+    emit_load(s, REG_ARG_BUF, REG_FRAME, FRAME_OFFSET(arg_buf));
+    emit_mov_imm(s, REG_TAG_INT, JS_MKVAL(JS_TAG_INT, 0));
+    emit_rr(s, 0, 0xff, 4, RSI); /* jmp rsi */
+
+    s->epilogue_pos = jit_pos(s);
+    emit_alu_imm(s, 1, ALU_ADD, RSP, 8);
+    for(i = countof(saved_regs) - 1; i >= 0; i--) {
+        emit_rex(s, 0, 0, saved_regs[i]);
+        emit8(s, 0x58 + (saved_regs[i] & 7)); /* pop */
+    }
+    emit8(s, 0xc3); /* ret */
+
+    /* js_jit_slow_op() has set f->sp and f->pc */
+    s->exception_pos = jit_pos(s);
+    emit_mov_imm(s, RAX, JS_JIT_EXCEPTION);
+    emit_jmp_to(s, s->epilogue_pos);
+}
+
+static void emit_get(JITState *s, int base, int idx)
+{
+    emit_load(s, RAX, base, idx * 8);
+    emit_dup_value(s, RAX);
+    emit_push(s, RAX);
+}
+
+static void emit_put(JITState *s, int base, int idx)
+{
+    emit_pop(s, RSI);
+    emit_set_value(s, base, idx * 8, RSI);
+}
+
+static void emit_set(JITState *s, int base, int idx)
+{
+    emit_load(s, RSI, REG_SP, SP_OFFSET(1));
+    emit_dup_value(s, RSI);
+    emit_set_value(s, base, idx * 8, RSI);
+}
+
+/* get_loc_check and get_var_ref_check: the value is in rax. The
+   uninitialized case throws in js_jit_slow_op(). */
+static void emit_get_check(JITState *s, const uint8_t *pc)
+{
+    uint32_t j_slow, j_done;
+
+    emit_mov_imm(s, RDX, JS_UNINITIALIZED);
+    emit_alu(s, 1, X86_CMP, RAX, RDX);
+    j_slow = emit_jcc(s, CC_E);
+    emit_dup_value(s, RAX);
+    emit_push(s, RAX);
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done);
+}
+
+/* put_loc_check and put_var_ref_check: [base + disp] is the variable */
+static void emit_put_check(JITState *s, const uint8_t *pc, int base,
+                           int32_t disp)
+{
+    uint32_t j_slow, j_done;
+
+    emit_load(s, RAX, base, disp);
+    emit_mov_imm(s, RDX, JS_UNINITIALIZED);
+    emit_alu(s, 1, X86_CMP, RAX, RDX);
+    j_slow = emit_jcc(s, CC_E);
+    emit_pop(s, RSI);
+    emit_set_value(s, base, disp, RSI);
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done);
+}
+
+/* double operation on two float64 values, as in the interpreter. The
+   operands are in rax and rcx. */
+static void emit_float_arith(JITState *s, int opcode, uint32_t *j_slow)
+{
+    static const uint8_t movq_xmm0_rax[] = { 0x66, 0x48, 0x0f, 0x6e, 0xc0 };
+    static const uint8_t movq_xmm1_rcx[] = { 0x66, 0x48, 0x0f, 0x6e, 0xc9 };
+    static const uint8_t movq_rax_xmm0[] = { 0x66, 0x48, 0x0f, 0x7e, 0xc0 };
+    static const uint8_t ucomisd_xmm0[] = { 0x66, 0x0f, 0x2e, 0xc0 };
+    uint8_t arith[4] = { 0xf2, 0x0f, 0x00, 0xc1 }; /* op xmm0, xmm1 */
+    uint32_t j_nan, j_store;
+
+    emit_mov_imm(s, RDX, JS_FLOAT64_TAG_ADDEND);
+    emit_alu(s, 1, X86_CMP, RAX, RDX);
+    j_slow[0] = emit_jcc(s, CC_B);
+    emit_alu(s, 1, X86_CMP, RCX, RDX);
+    j_slow[1] = emit_jcc(s, CC_B);
+    emit_alu(s, 1, X86_SUB, RAX, RDX);
+    emit_alu(s, 1, X86_SUB, RCX, RDX);
+    emit_bytes(s, movq_xmm0_rax, sizeof(movq_xmm0_rax));
+    emit_bytes(s, movq_xmm1_rcx, sizeof(movq_xmm1_rcx));
+    switch(opcode) {
+    case OP_add:
+        arith[2] = 0x58;
+        break;
+    case OP_sub:
+        arith[2] = 0x5c;
+        break;
+    default:
+        arith[2] = 0x59; /* mul */
+        break;
+    }
+    emit_bytes(s, arith, sizeof(arith));
+    /* the NaNs are normalized */
+    emit_bytes(s, ucomisd_xmm0, sizeof(ucomisd_xmm0));
+    j_nan = emit_jcc(s, CC_P);
+    emit_bytes(s, movq_rax_xmm0, sizeof(movq_rax_xmm0));
+    emit_alu(s, 1, X86_ADD, RAX, RDX);
+    j_store = emit_jmp(s);
+    patch_here(s, j_nan);
+    emit_mov_imm(s, RAX, JS_NAN);
+    patch_here(s, j_store);
+    emit_store(s, REG_SP, SP_OFFSET(2), RAX);
+    emit_alu_imm(s, 1, ALU_SUB, REG_SP, 8);
+}
+
+/* sp[-2] op sp[-1] with the int32 case inline */
+static void emit_binary_op(JITState *s, const uint8_t *pc)
+{
+    int opcode = *pc;
+    uint32_t j_slow[6], j_done[2];
+    int n_slow, i;
+
+    n_slow = 0;
+    emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+    emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+    j_slow[n_slow++] = emit_check_int(s, RAX);
+    j_slow[n_slow++] = emit_check_int(s, RCX);
+    switch(opcode) {
+    case OP_add:
+        emit_alu(s, 0, X86_ADD, RAX, RCX);
+        j_slow[n_slow++] = emit_jcc(s, CC_O);
+        break;
+    case OP_sub:
+        emit_alu(s, 0, X86_SUB, RAX, RCX);
+        j_slow[n_slow++] = emit_jcc(s, CC_O);
+        break;
+    case OP_mul:
+        /* -0 is a float */
+        emit_rr(s, 0, X86_MOV, RAX, RDX);
+        emit_alu(s, 0, X86_OR, RDX, RCX);
+        emit_rr(s, 0, X86_IMUL, RAX, RCX);
+        j_slow[n_slow++] = emit_jcc(s, CC_O);
+        emit_alu(s, 0, X86_TEST, RAX, RAX);
+        j_done[0] = emit_jcc(s, CC_NE);
+        emit_alu(s, 0, X86_TEST, RDX, RDX);
+        j_slow[n_slow++] = emit_jcc(s, CC_S);
+        patch_here(s, j_done[0]);
+        break;
+    case OP_mod:
+        emit_alu(s, 0, X86_TEST, RAX, RAX);
+        j_slow[n_slow++] = emit_jcc(s, CC_S);
+        emit_alu(s, 0, X86_TEST, RCX, RCX);
+        j_slow[n_slow++] = emit_jcc(s, CC_LE);
+        emit_alu(s, 0, X86_XOR, RDX, RDX);
+        emit_rr(s, 0, 0xf7, 6, RCX); /* div ecx */
+        emit_rr(s, 0, X86_MOV, RDX, RAX);
+        break;
+    case OP_and:
+        emit_alu(s, 0, X86_AND, RAX, RCX);
+        break;
+    case OP_or:
+        emit_alu(s, 0, X86_OR, RAX, RCX);
+        break;
+    case OP_xor:
+        emit_alu(s, 0, X86_XOR, RAX, RCX);
+        break;
+    case OP_shl:
+        emit_rr(s, 0, 0xd3, SHIFT_SHL, RAX);
+        break;
+    case OP_sar:
+        emit_rr(s, 0, 0xd3, SHIFT_SAR, RAX);
+        break;
+    default:
+        abort();
+    }
+    emit_alu(s, 1, X86_OR, RAX, REG_TAG_INT);
+    emit_store(s, REG_SP, SP_OFFSET(2), RAX);
+    emit_alu_imm(s, 1, ALU_SUB, REG_SP, 8);
+    j_done[0] = emit_jmp(s);
+
+    for(i = 0; i < n_slow; i++)
+        patch_here(s, j_slow[i]);
+    n_slow = 0;
+    if (opcode == OP_add || opcode == OP_sub || opcode == OP_mul) {
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+        emit_float_arith(s, opcode, j_slow);
+        n_slow = 2;
+        j_done[1] = emit_jmp(s);
+    }
+    for(i = 0; i < n_slow; i++)
+        patch_here(s, j_slow[i]);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done[0]);
+    if (n_slow)
+        patch_here(s, j_done[1]);
+}
+
+/* add_i8 on an int32 inline */
+static void emit_add_imm(JITState *s, const uint8_t *pc)
+{
+    uint32_t j_slow[2], j_done;
+
+    emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+    j_slow[0] = emit_check_int(s, RAX);
+    emit_alu_imm(s, 0, ALU_ADD, RAX, (int8_t)pc[1]);
+    j_slow[1] = emit_jcc(s, CC_O);
+    emit_alu(s, 1, X86_OR, RAX, REG_TAG_INT);
+    emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow[0]);
+    patch_here(s, j_slow[1]);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done);
+}
+
+/* comparison of two int32 inline */
+static void emit_compare_op(JITState *s, const uint8_t *pc)
+{
+    uint32_t j_slow[2], j_done;
+    int cc;
+
+    switch(*pc) {
+    case OP_lt:
+        cc = CC_L;
+        break;
+    case OP_lte:
+        cc = CC_LE;
+        break;
+    case OP_gt:
+        cc = CC_G;
+        break;
+    case OP_gte:
+        cc = CC_GE;
+        break;
+    case OP_eq:
+    case OP_strict_eq:
+        cc = CC_E;
+        break;
+    default:
+        cc = CC_NE;
+        break;
+    }
+    emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+    emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+    j_slow[0] = emit_check_int(s, RAX);
+    j_slow[1] = emit_check_int(s, RCX);
+    emit_alu(s, 0, X86_CMP, RAX, RCX);
+    emit_setcc_bool(s, cc);
+    emit_store(s, REG_SP, SP_OFFSET(2), RAX);
+    emit_alu_imm(s, 1, ALU_SUB, REG_SP, 8);
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow[0]);
+    patch_here(s, j_slow[1]);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done);
+}
+
+/* inc, dec, post_inc, post_dec, neg and not on an int32 inline */
+static void emit_unary_op(JITState *s, const uint8_t *pc)
+{
+    int opcode = *pc;
+    uint32_t j_slow[2], j_done;
+
+    emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+    j_slow[0] = emit_check_int(s, RAX);
+    j_slow[1] = 0;
+    switch(opcode) {
+    case OP_inc:
+    case OP_post_inc:
+        emit_alu_imm(s, 0, ALU_ADD, RAX, 1);
+        j_slow[1] = emit_jcc(s, CC_O);
+        break;
+    case OP_dec:
+    case OP_post_dec:
+        emit_alu_imm(s, 0, ALU_SUB, RAX, 1);
+        j_slow[1] = emit_jcc(s, CC_O);
+        break;
+    case OP_neg:
+        /* -0 and -INT32_MIN are not int32 */
+        emit_rr(s, 0, 0xf7, 0, RAX); /* test eax, imm */
+        emit32(s, 0x7fffffff);
+        j_slow[1] = emit_jcc(s, CC_E);
+        emit_rr(s, 0, 0xf7, 3, RAX); /* neg eax */
+        break;
+    case OP_not:
+        emit_rr(s, 0, 0xf7, 2, RAX); /* not eax */
+        break;
+    default:
+        abort();
+    }
+    emit_alu(s, 1, X86_OR, RAX, REG_TAG_INT);
+    if (opcode == OP_post_inc || opcode == OP_post_dec) {
+        emit_push(s, RAX);
+    } else {
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+    }
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow[0]);
+    if (j_slow[1])
+        patch_here(s, j_slow[1]);
+    emit_slow_op(s, pc);
+    patch_here(s, j_done);
+}
+
+static int js_jit_to_bool_free(JSContext *ctx, JSValue val)
+{
+    int res = JS_ToBool(ctx, val);
+    JS_FreeValue(ctx, val);
+    return res;
+}
+
+/* jump to 'target' if 'cc'. The interrupts are polled before the
+   backward jumps. */
+static void emit_cond_goto(JITState *s, int cc, uint32_t pos,
+                           uint32_t target)
+{
+    uint32_t j_skip;
+
+    if (target > pos) {
+        emit_goto(s, cc, target);
+    } else {
+        j_skip = emit_jcc(s, cc ^ 1);
+        emit_poll_interrupts(s, pos + 1);
+        emit_goto(s, -1, target);
+        patch_here(s, j_skip);
+    }
+}
+
+/* if_true, if_false and their short forms */
+static void emit_if(JITState *s, BOOL is_true, uint32_t pos, uint32_t target)
+{
+    uint32_t j_slow, j_test;
+
+    emit_pop(s, RAX);
+    j_slow = emit_check_small(s, RAX);
+    emit_alu(s, 0, X86_TEST, RAX, RAX);
+    j_test = emit_jmp(s);
+    patch_here(s, j_slow);
+    emit_mov(s, RSI, RAX);
+    emit_mov(s, RDI, REG_CTX);
+    emit_call(s, js_jit_to_bool_free);
+    emit_alu(s, 0, X86_TEST, RAX, RAX);
+    patch_here(s, j_test);
+    emit_cond_goto(s, is_true ? CC_NE : CC_E, pos, target);
+}
+
+/* lt_if_false... with the int32 comparison inline */
+static void emit_compare_if_false(JITState *s, const uint8_t *pc,
+                                  uint32_t pos, uint32_t target)
+{
+    /* the jump conditions of lt, lte, gt and gte */
+    static const uint8_t cc_false[4] = { CC_GE, CC_G, CC_LE, CC_L };
+    uint32_t j_slow[2], j_done;
+
+    emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+    emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+    j_slow[0] = emit_check_int(s, RAX);
+    j_slow[1] = emit_check_int(s, RCX);
+    emit_alu_imm(s, 1, ALU_SUB, REG_SP, 16);
+    emit_alu(s, 0, X86_CMP, RAX, RCX);
+    emit_cond_goto(s, cc_false[(*pc - OP_lt_if_false) % 4], pos, target);
+    j_done = emit_jmp(s);
+    patch_here(s, j_slow[0]);
+    patch_here(s, j_slow[1]);
+    /* js_jit_slow_op() leaves the result of the comparison */
+    emit_slow_op(s, pc);
+    emit_pop(s, RAX);
+    emit_alu(s, 0, X86_TEST, RAX, RAX);
+    emit_cond_goto(s, CC_E, pos, target);
+    patch_here(s, j_done);
+}
+
+static void emit_jump(JITState *s, uint32_t pos, uint32_t target)
+{
+    if (target <= pos)
+        emit_poll_interrupts(s, pos + 1);
+    emit_goto(s, -1, target);
+}
+
+static void emit_return(JITState *s)
+{
+    emit_store(s, REG_FRAME, FRAME_OFFSET(ret_val), RAX);
+    emit_store(s, REG_FRAME, FRAME_OFFSET(sp), REG_SP);
+    emit_mov_imm(s, RAX, JS_JIT_RETURN);
+    emit_jmp_to(s, s->epilogue_pos);
+}
+
+static void emit_insn(JITState *s, const uint8_t *pc)
+{
+    JSFunctionBytecode *b = s->b;
+    uint32_t pos = pc - b->byte_code_buf;
+    int opcode = *pc, idx;
+    uint32_t j1, j2, j3;
+    const uint8_t *p;
+    JSValue val;
+
+    switch(opcode) {
+    case OP_push_i32:
+        emit_push_imm(s, JS_MKVAL(JS_TAG_INT, get_i32(pc + 1)));
+        break;
+    case OP_push_minus1:
+    case OP_push_0:
+    case OP_push_1:
+    case OP_push_2:
+    case OP_push_3:
+    case OP_push_4:
+    case OP_push_5:
+    case OP_push_6:
+    case OP_push_7:
+        emit_push_imm(s, JS_MKVAL(JS_TAG_INT, opcode - OP_push_0));
+        break;
+    case OP_push_i8:
+        emit_push_imm(s, JS_MKVAL(JS_TAG_INT, (int8_t)pc[1]));
+        break;
+    case OP_push_i16:
+        emit_push_imm(s, JS_MKVAL(JS_TAG_INT, get_i16(pc + 1)));
+        break;
+    case OP_push_const:
+        /* the constants are owned by the function, as the code */
+        p = pc + 1;
+        val = b->cpool[js_bc_get_leb128(&p)];
+        if (JS_VALUE_HAS_REF_COUNT(val)) {
+            emit_mov_imm(s, RDX, (uintptr_t)JS_VALUE_GET_PTR(val));
+            emit_mem(s, 0, 0xff, 0, RDX, 0); /* inc ref_count */
+        }
+        emit_push_imm(s, val);
+        break;
+    case OP_undefined:
+        emit_push_imm(s, JS_UNDEFINED);
+        break;
+    case OP_null:
+        emit_push_imm(s, JS_NULL);
+        break;
+    case OP_push_false:
+        emit_push_imm(s, JS_FALSE);
+        break;
+    case OP_push_true:
+        emit_push_imm(s, JS_TRUE);
+        break;
+
+    case OP_drop:
+        emit_pop(s, RAX);
+        emit_free_value(s);
+        break;
+    case OP_nip:
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_alu_imm(s, 1, ALU_SUB, REG_SP, 8);
+        emit_free_value(s);
+        break;
+    case OP_dup:
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_dup_value(s, RAX);
+        emit_push(s, RAX);
+        break;
+    case OP_dup2: /* a b -> a b a b */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_dup_value(s, RAX);
+        emit_store(s, REG_SP, 0, RAX);
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_dup_value(s, RAX);
+        emit_store(s, REG_SP, 8, RAX);
+        emit_alu_imm(s, 1, ALU_ADD, REG_SP, 16);
+        break;
+    case OP_insert2: /* obj a -> a obj a */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(2));
+        emit_store(s, REG_SP, 0, RAX);
+        emit_store(s, REG_SP, SP_OFFSET(1), RCX);
+        emit_dup_value(s, RAX);
+        emit_store(s, REG_SP, SP_OFFSET(2), RAX);
+        emit_alu_imm(s, 1, ALU_ADD, REG_SP, 8);
+        break;
+    case OP_insert3: /* obj prop a -> a obj prop a */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_store(s, REG_SP, 0, RAX);
+        emit_load(s, RCX, REG_SP, SP_OFFSET(2));
+        emit_store(s, REG_SP, SP_OFFSET(1), RCX);
+        emit_load(s, RCX, REG_SP, SP_OFFSET(3));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_dup_value(s, RAX);
+        emit_store(s, REG_SP, SP_OFFSET(3), RAX);
+        emit_alu_imm(s, 1, ALU_ADD, REG_SP, 8);
+        break;
+    case OP_perm3: /* obj a b -> a obj b */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(3));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_store(s, REG_SP, SP_OFFSET(3), RAX);
+        break;
+    case OP_perm4: /* obj prop a b -> a obj prop b */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(3));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_load(s, RCX, REG_SP, SP_OFFSET(4));
+        emit_store(s, REG_SP, SP_OFFSET(3), RCX);
+        emit_store(s, REG_SP, SP_OFFSET(4), RAX);
+        break;
+    case OP_swap:
+        emit_load(s, RAX, REG_SP, SP_OFFSET(2));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+        break;
+    case OP_rot3l: /* x a b -> a b x */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(3));
+        emit_load(s, RCX, REG_SP, SP_OFFSET(2));
+        emit_store(s, REG_SP, SP_OFFSET(3), RCX);
+        emit_load(s, RCX, REG_SP, SP_OFFSET(1));
+        emit_store(s, REG_SP, SP_OFFSET(2), RCX);
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+        break;
+
+    case OP_get_loc:
+    case OP_put_loc:
+    case OP_set_loc:
+    case OP_get_arg:
+    case OP_put_arg:
+    case OP_set_arg:
+    case OP_set_loc_uninitialized:
+    case OP_get_loc_check:
+    case OP_put_loc_check:
+    case OP_get_var_ref:
+    case OP_put_var_ref:
+    case OP_set_var_ref:
+    case OP_get_var_ref_check:
+    case OP_put_var_ref_check:
+        idx = get_u16(pc + 1);
+        goto has_idx;
+    case OP_get_loc8:
+    case OP_put_loc8:
+    case OP_set_loc8:
+        idx = pc[1];
+        opcode += OP_get_loc - OP_get_loc8;
+        goto has_idx;
+    case OP_get_loc0 ... OP_get_loc3:
+        idx = opcode - OP_get_loc0;
+        opcode = OP_get_loc;
+        goto has_idx;
+    case OP_put_loc0 ... OP_put_loc3:
+        idx = opcode - OP_put_loc0;
+        opcode = OP_put_loc;
+        goto has_idx;
+    case OP_set_loc0 ... OP_set_loc3:
+        idx = opcode - OP_set_loc0;
+        opcode = OP_set_loc;
+        goto has_idx;
+    case OP_get_arg0 ... OP_get_arg3:
+        idx = opcode - OP_get_arg0;
+        opcode = OP_get_arg;
+        goto has_idx;
+    case OP_put_arg0 ... OP_put_arg3:
+        idx = opcode - OP_put_arg0;
+        opcode = OP_put_arg;
+        goto has_idx;
+    case OP_set_arg0 ... OP_set_arg3:
+        idx = opcode - OP_set_arg0;
+        opcode = OP_set_arg;
+        goto has_idx;
+    case OP_get_var_ref0 ... OP_get_var_ref3:
+        idx = opcode - OP_get_var_ref0;
+        opcode = OP_get_var_ref;
+        goto has_idx;
+    case OP_put_var_ref0 ... OP_put_var_ref3:
+        idx = opcode - OP_put_var_ref0;
+        opcode = OP_put_var_ref;
+        goto has_idx;
+    case OP_set_var_ref0 ... OP_set_var_ref3:
+        idx = opcode - OP_set_var_ref0;
+        opcode = OP_set_var_ref;
+    has_idx:
+        switch(opcode) {
+        case OP_get_loc:
+            emit_get(s, REG_VAR_BUF, idx);
+            break;
+        case OP_put_loc:
+            emit_put(s, REG_VAR_BUF, idx);
+            break;
+        case OP_set_loc:
+            emit_set(s, REG_VAR_BUF, idx);
+            break;
+        case OP_get_arg:
+            emit_get(s, REG_ARG_BUF, idx);
+            break;
+        case OP_put_arg:
+            emit_put(s, REG_ARG_BUF, idx);
+            break;
+        case OP_set_arg:
+            emit_set(s, REG_ARG_BUF, idx);
+            break;
+        case OP_set_loc_uninitialized:
+            emit_mov_imm(s, RSI, JS_UNINITIALIZED);
+            emit_set_value(s, REG_VAR_BUF, idx * 8, RSI);
+            break;
+        case OP_get_loc_check:
+            emit_load(s, RAX, REG_VAR_BUF, idx * 8);
+            emit_get_check(s, pc);
+            break;
+        case OP_put_loc_check:
+            emit_put_check(s, pc, REG_VAR_BUF, idx * 8);
+            break;
+        case OP_get_var_ref:
+            emit_var_ref_ptr(s, idx);
+            emit_load(s, RAX, RCX, 0);
+            emit_dup_value(s, RAX);
+            emit_push(s, RAX);
+            break;
+        case OP_put_var_ref:
+            emit_pop(s, RSI);
+            emit_var_ref_ptr(s, idx);
+            emit_set_value(s, RCX, 0, RSI);
+            break;
+        case OP_set_var_ref:
+            emit_load(s, RSI, REG_SP, SP_OFFSET(1));
+            emit_dup_value(s, RSI);
+            emit_var_ref_ptr(s, idx);
+            emit_set_value(s, RCX, 0, RSI);
+            break;
+        case OP_get_var_ref_check:
+            emit_var_ref_ptr(s, idx);
+            emit_load(s, RAX, RCX, 0);
+            emit_get_check(s, pc);
+            break;
+        case OP_put_var_ref_check:
+            emit_var_ref_ptr(s, idx);
+            emit_put_check(s, pc, RCX, 0);
+            break;
+        default:
+            abort();
+        }
+        break;
+
+    case OP_if_false:
+    case OP_if_true:
+        emit_if(s, opcode == OP_if_true, pos, pos + 1 + get_i32(pc + 1));
+        break;
+    case OP_if_false8:
+    case OP_if_true8:
+        emit_if(s, opcode == OP_if_true8, pos, pos + 1 + (int8_t)pc[1]);
+        break;
+    case OP_lt_if_false:
+    case OP_lte_if_false:
+    case OP_gt_if_false:
+    case OP_gte_if_false:
+        emit_compare_if_false(s, pc, pos, pos + 1 + get_i32(pc + 1));
+        break;
+    case OP_lt_if_false8:
+    case OP_lte_if_false8:
+    case OP_gt_if_false8:
+    case OP_gte_if_false8:
+        emit_compare_if_false(s, pc, pos, pos + 1 + (int8_t)pc[1]);
+        break;
+    case OP_goto:
+        emit_jump(s, pos, pos + 1 + get_i32(pc + 1));
+        break;
+    case OP_goto16:
+        emit_jump(s, pos, pos + 1 + get_i16(pc + 1));
+        break;
+    case OP_goto8:
+        emit_jump(s, pos, pos + 1 + (int8_t)pc[1]);
+        break;
+    case OP_catch:
+        emit_push_imm(s, JS_MKVAL(JS_TAG_CATCH_OFFSET,
+                                  pos + 1 + get_i32(pc + 1)));
+        break;
+    case OP_gosub:
+        /* the finally block returns after the instruction */
+        emit_push_imm(s, JS_MKVAL(JS_TAG_INT, pos + 5));
+        emit_goto(s, -1, pos + 1 + get_i32(pc + 1));
+        break;
+    case OP_return:
+        emit_pop(s, RAX);
+        emit_return(s);
+        break;
+    case OP_return_undef:
+        emit_mov_imm(s, RAX, JS_UNDEFINED);
+        emit_return(s);
+        break;
+
+    case OP_add:
+    case OP_sub:
+    case OP_mul:
+    case OP_mod:
+    case OP_and:
+    case OP_or:
+    case OP_xor:
+    case OP_shl:
+    case OP_sar:
+        emit_binary_op(s, pc);
+        break;
+    case OP_lt:
+    case OP_lte:
+    case OP_gt:
+    case OP_gte:
+    case OP_eq:
+    case OP_neq:
+    case OP_strict_eq:
+    case OP_strict_neq:
+        emit_compare_op(s, pc);
+        break;
+    case OP_add_i8:
+        emit_add_imm(s, pc);
+        break;
+    case OP_inc:
+    case OP_dec:
+    case OP_post_inc:
+    case OP_post_dec:
+    case OP_neg:
+    case OP_not:
+        emit_unary_op(s, pc);
+        break;
+    case OP_lnot:
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        j1 = emit_check_small(s, RAX);
+        emit_alu(s, 0, X86_TEST, RAX, RAX);
+        emit_setcc_bool(s, CC_E);
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+        j2 = emit_jmp(s);
+        patch_here(s, j1);
+        emit_slow_op(s, pc);
+        patch_here(s, j2);
+        break;
+    case OP_plus:
+        /* nothing to do for the numbers */
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_mov(s, RDX, RAX);
+        emit_shift_imm(s, 1, SHIFT_SHR, RDX, JS_VALUE_TAG_SHIFT);
+        emit_alu_imm(s, 0, ALU_CMP, RDX, JS_TAG_INT - JS_TAG_FIRST);
+        j1 = emit_jcc(s, CC_E);
+        emit_mov_imm(s, RDX, JS_FLOAT64_TAG_ADDEND);
+        emit_alu(s, 1, X86_CMP, RAX, RDX);
+        j2 = emit_jcc(s, CC_AE);
+        emit_slow_op(s, pc);
+        patch_here(s, j1);
+        patch_here(s, j2);
+        break;
+    case OP_is_undefined_or_null:
+        emit_load(s, RAX, REG_SP, SP_OFFSET(1));
+        emit_mov_imm(s, RCX, JS_UNDEFINED);
+        emit_alu(s, 1, X86_CMP, RAX, RCX);
+        j1 = emit_jcc(s, CC_E);
+        emit_mov_imm(s, RCX, JS_NULL);
+        emit_alu(s, 1, X86_CMP, RAX, RCX);
+        j2 = emit_jcc(s, CC_E);
+        emit_free_value(s);
+        emit_mov_imm(s, RAX, JS_FALSE);
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+        j3 = emit_jmp(s);
+        patch_here(s, j1);
+        patch_here(s, j2);
+        emit_mov_imm(s, RAX, JS_TRUE);
+        emit_store(s, REG_SP, SP_OFFSET(1), RAX);
+        patch_here(s, j3);
+        break;
+    case OP_nop:
+        break;
+
+    case OP_get_loc_get_field:
+        emit_get(s, REG_VAR_BUF, pc[1]);
+        emit_slow_op(s, pc);
+        break;
+    case OP_get_arg_get_field:
+        emit_get(s, REG_ARG_BUF, pc[1]);
+        emit_slow_op(s, pc);
+        break;
+
+    case OP_fclosure:
+    case OP_push_atom_value:
+    case OP_push_this:
+    case OP_object:
+    case OP_special_object:
+    case OP_array_from:
+    case OP_call0:
+    case OP_call1:
+    case OP_call2:
+    case OP_call3:
+    case OP_call:
+    case OP_call_method:
+    case OP_call_constructor:
+    case OP_throw:
+    case OP_throw_error:
+    case OP_get_var_undef:
+    case OP_get_var:
+    case OP_put_var:
+    case OP_put_var_strict:
+    case OP_delete_var:
+    case OP_define_var:
+    case OP_define_func:
+    case OP_get_field:
+    case OP_get_field2:
+    case OP_put_field:
+    case OP_define_field:
+    case OP_get_array_el:
+    case OP_get_array_el2:
+    case OP_put_array_el:
+    case OP_define_array_el:
+    case OP_delete:
+    case OP_close_loc:
+    case OP_typeof:
+    case OP_div:
+    case OP_pow:
+    case OP_shr:
+    case OP_instanceof:
+    case OP_in:
+        emit_slow_op(s, pc);
+        break;
+    default:
+        /* ret, nip_catch, the yields and invalid */
+        emit_exit(s, pos);
+        break;
+    }
+}
+
+int js_jit_compile(JSContext *ctx, JSFunctionBytecode *b)
+{
+    JSRuntime *rt = ctx->rt;
+    JITState s_s, *s = &s_s;
+    JSJitCode *jc;
+    const uint8_t *pc, *pc_end;
+    JITFixup *fixups;
+    size_t map_size, page_size;
+    uint8_t *code;
+    int i, fixup_count;
+
+    if (b->byte_code_len > JS_JIT_MAX_BYTECODE_LEN)
+        return -1;
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->b = b;
+    s->pc_map = js_malloc_account(rt, NULL,
+                                  sizeof(s->pc_map[0]) * b->byte_code_len);
+    if (!s->pc_map)
+        return -1;
+    memset(s->pc_map, 0, sizeof(s->pc_map[0]) * b->byte_code_len);
+    js_dbuf_init(ctx, &s->code);
+    js_dbuf_init(ctx, &s->fixups);
+
+    emit_prologue(s);
+    pc = b->byte_code_buf;
+    pc_end = pc + b->byte_code_len;
+    while (pc < pc_end) {
+        s->pc_map[pc - b->byte_code_buf] = jit_pos(s);
+        emit_insn(s, pc);
+        pc += js_opcode_size(pc);
+    }
+    if (dbuf_error(&s->code) || dbuf_error(&s->fixups))
+        goto fail;
+    fixups = (JITFixup *)s->fixups.buf;
+    fixup_count = s->fixups.size / sizeof(JITFixup);
+    for(i = 0; i < fixup_count; i++)
+        patch_jump(s, fixups[i].pos, s->pc_map[fixups[i].target]);
+
+    /* the code is written before being made executable */
+    page_size = sysconf(_SC_PAGESIZE);
+    map_size = (s->code.size + page_size - 1) & ~(page_size - 1);
+    code = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+        goto fail;
+    memcpy(code, s->code.buf, s->code.size);
+    if (mprotect(code, map_size, PROT_READ | PROT_EXEC) < 0) {
+        munmap(code, map_size);
+        goto fail;
+    }
+    jc = js_malloc_account(rt, NULL, sizeof(*jc));
+    if (!jc) {
+        munmap(code, map_size);
+        goto fail;
+    }
+    jc->code = code;
+    jc->code_size = map_size;
+    jc->exit_count = 0;
+    jc->pc_map = s->pc_map;
+    b->jit = jc;
+    dbuf_free(&s->code);
+    dbuf_free(&s->fixups);
+    return 0;
+ fail:
+    dbuf_free(&s->code);
+    dbuf_free(&s->fixups);
+    js_free_rt(rt, s->pc_map);
+    return -1;
+}
+
+void js_jit_free(JSRuntime *rt, JSFunctionBytecode *b)
+{
+    JSJitCode *jc = b->jit;
+
+    if (!jc)
+        return;
+    munmap(jc->code, jc->code_size);
+    js_free_rt(rt, jc->pc_map);
+    js_free_rt(rt, jc);
+    b->jit = NULL;
+}
+
+int js_jit_run(JSJitFrame *f, const uint8_t *pc)
+{
+    JSFunctionBytecode *b = f->b;
+    JSJitCode *jc = b->jit;
+    JSJitEntry *entry = (JSJitEntry *)jc->code;
+    int ret;
+
+    ret = entry(f, jc->code + jc->pc_map[pc - b->byte_code_buf]);
+    /* the code is no longer used if the function is mostly
+       interpreted */
+    if (ret == JS_JIT_EXIT && ++jc->exit_count >= JS_JIT_MAX_EXITS)
+        b->jit_disabled = TRUE;
+    return ret;
+}
+
+#endif /* CONFIG_JIT */
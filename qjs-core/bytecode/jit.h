@@ -0,0 +1,100 @@
+#ifndef QJS_JIT_H
+#define QJS_JIT_H
+#include "bytecode.h"
+
+/* Baseline JIT: the hot functions are translated to machine code by
+   concatenating a template per instruction. The code uses the frame
+   of the interpreter (arguments, variables and value stack), so that
+   the interpreter and the machine code can be switched at any
+   instruction. It needs the NaN-boxed values. Define CONFIG_NO_JIT to
+   disable it. */
+#if !defined(CONFIG_NO_JIT) && defined(JS_NAN_BOXING) && \
+    defined(__x86_64__) && defined(__linux__)
+#define CONFIG_JIT
+#endif
+
+/* calls + backward jumps before a function is compiled */
+#define JS_JIT_THRESHOLD 1000
+/* exits to the interpreter before the code of a function is no longer
+   used */
+#define JS_JIT_MAX_EXITS 1000
+
+/* result of js_jit_run() */
+enum {
+    JS_JIT_EXIT, /* the interpreter continues at pc */
+    JS_JIT_RETURN, /* the function returns ret_val */
+    JS_JIT_EXCEPTION, /* exception raised at pc */
+};
+
+/* the state of the interpreter shared with the machine code */
+typedef struct JSJitFrame {
+    JSContext *ctx;
+    JSValue *sp;
+    JSValue *var_buf;
+    JSValue *arg_buf;
+    JSVarRef **var_refs;
+    struct JSStackFrame *sf;
+    JSFunctionBytecode *b;
+    JSValueConst func_obj;
+    JSValueConst this_obj;
+    JSValueConst new_target;
+    JSValue ret_val;
+    uint32_t pc; /* offset in b->byte_code_buf */
+} JSJitFrame;
+
+typedef struct JSJitCode {
+    uint8_t *code; /* executable mapping of code_size bytes */
+    uint32_t code_size;
+    uint32_t exit_count;
+    /* offset in 'code' of each instruction of the bytecode, 0 if none */
+    uint32_t *pc_map;
+} JSJitCode;
+
+#ifdef CONFIG_JIT
+
+int js_jit_compile(JSContext *ctx, JSFunctionBytecode *b);
+void js_jit_free(JSRuntime *rt, JSFunctionBytecode *b);
+/* run the code of f->b from 'pc' (f->sp is the stack pointer) */
+int js_jit_run(JSJitFrame *f, const uint8_t *pc);
+/* instructions which are not compiled inline (see interpreter.c) */
+JSValue *js_jit_slow_op(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+/* js_jit_slow_op() for a single instruction */
+JSValue *js_jit_op_get_var(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_get_var_undef(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_put_var(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_get_field(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_get_loc_get_field(JSJitFrame *f, JSValue *sp,
+                                     const uint8_t *pc);
+JSValue *js_jit_op_get_arg_get_field(JSJitFrame *f, JSValue *sp,
+                                     const uint8_t *pc);
+JSValue *js_jit_op_get_field2(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_put_field(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_get_array_el(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_put_array_el(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_call0(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_call1(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_call2(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_call3(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+JSValue *js_jit_op_call_method(JSJitFrame *f, JSValue *sp, const uint8_t *pc);
+
+/* TRUE if the code of 'b' must be run from 'pc'. It is compiled once
+   the function is hot. */
+static inline BOOL js_jit_check(JSContext *ctx, JSFunctionBytecode *b,
+                                const uint8_t *pc)
+{
+    if (!ctx->rt->jit_enabled || b->jit_disabled)
+        return FALSE;
+    if (!b->jit) {
+        if (++b->jit_counter < JS_JIT_THRESHOLD)
+            return FALSE;
+        if (js_jit_compile(ctx, b)) {
+            b->jit_disabled = TRUE;
+            return FALSE;
+        }
+    }
+    return b->jit->pc_map[pc - b->byte_code_buf] != 0;
+}
+
+#endif /* CONFIG_JIT */
+
+#endif //QJS_JIT_H
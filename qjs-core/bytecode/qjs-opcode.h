@@ -0,0 +1,277 @@
+/*
+ * QuickJS opcode definitions
+ *
+ * Copyright (c) 2017-2018 Fabrice Bellard
+ * Copyright (c) 2017-2018 Charlie Gordon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* The compiler emits the long forms ('raw' code) with 32 bit atoms,
+   constant pool indexes and label numbers. js_bytecode_finalize()
+   encodes them: the atoms and the constant pool indexes become LEB128
+   indexes in the function tables, and the short forms and the
+   superinstructions are selected. */
+
+#ifdef FMT
+FMT(none)
+FMT(none_int)
+FMT(none_loc)
+FMT(none_arg)
+FMT(none_var_ref)
+FMT(u8)
+FMT(i8)
+FMT(loc8)
+FMT(label8)
+FMT(u16)
+FMT(i16)
+FMT(label16)
+FMT(npop)
+FMT(npopx)
+FMT(loc)
+FMT(arg)
+FMT(var_ref)
+FMT(u32)
+FMT(i32)
+FMT(const)
+FMT(label)
+FMT(atom)
+FMT(atom_u8)
+FMT(atom_u16)
+FMT(loc8_atom)
+FMT(arg8_atom)
+#undef FMT
+#endif /* FMT */
+
+#ifdef DEF
+
+#ifndef def
+#define def(id, size, n_pop, n_push, f) DEF(id, size, n_pop, n_push, f)
+#endif
+
+/* 'size' is the size of the raw instruction. The npop formats pop
+   'n_pop' plus their operand. */
+DEF(invalid, 1, 0, 0, none) /* never emitted */
+
+/* push values */
+DEF(push_i32, 5, 0, 1, i32)
+DEF(push_const, 5, 0, 1, const)
+DEF(fclosure, 5, 0, 1, const) /* new closure of the function in the constant pool */
+DEF(push_atom_value, 5, 0, 1, atom)
+DEF(undefined, 1, 0, 1, none)
+DEF(null, 1, 0, 1, none)
+DEF(push_this, 1, 0, 1, none)
+DEF(push_false, 1, 0, 1, none)
+DEF(push_true, 1, 0, 1, none)
+DEF(object, 1, 0, 1, none)
+DEF(special_object, 2, 0, 1, u8) /* OP_SPECIAL_OBJECT_x */
+DEF(array_from, 3, 0, 1, npop) /* elements -> array */
+
+DEF(drop, 1, 1, 0, none) /* a -> */
+DEF(nip, 1, 2, 1, none) /* a b -> b */
+DEF(dup, 1, 1, 2, none) /* a -> a a */
+DEF(dup2, 1, 2, 4, none) /* a b -> a b a b */
+DEF(insert2, 1, 2, 3, none) /* obj a -> a obj a */
+DEF(insert3, 1, 3, 4, none) /* obj prop a -> a obj prop a */
+DEF(perm3, 1, 3, 3, none) /* obj a b -> a obj b */
+DEF(perm4, 1, 4, 4, none) /* obj prop a b -> a obj prop b */
+DEF(swap, 1, 2, 2, none) /* a b -> b a */
+DEF(rot3l, 1, 3, 3, none) /* x a b -> a b x */
+
+DEF(call, 3, 1, 1, npop) /* func args -> ret */
+DEF(call_method, 3, 2, 1, npop) /* this func args -> ret */
+DEF(call_constructor, 3, 1, 1, npop) /* func args -> ret */
+DEF(return, 1, 1, 0, none)
+DEF(return_undef, 1, 0, 0, none)
+DEF(throw, 1, 1, 0, none)
+DEF(throw_error, 6, 0, 0, atom_u8) /* JS_THROW_ERROR_x with the atom */
+
+/* global variables */
+DEF(get_var_undef, 5, 0, 1, atom) /* undefined if not defined (typeof) */
+DEF(get_var, 5, 0, 1, atom) /* ReferenceError if not defined */
+DEF(put_var, 5, 1, 0, atom) /* creates the variable if not defined */
+DEF(put_var_strict, 5, 1, 0, atom) /* ReferenceError if not defined */
+DEF(delete_var, 5, 0, 1, atom)
+DEF(define_var, 5, 0, 0, atom) /* global var declaration */
+DEF(define_func, 5, 1, 0, atom) /* global function declaration */
+
+/* properties */
+DEF(get_field, 5, 1, 1, atom) /* obj -> value */
+DEF(get_field2, 5, 1, 2, atom) /* obj -> obj value */
+DEF(put_field, 5, 2, 0, atom) /* obj value -> */
+DEF(define_field, 5, 2, 1, atom) /* obj value -> obj */
+DEF(get_array_el, 1, 2, 1, none) /* obj prop -> value */
+DEF(get_array_el2, 1, 2, 2, none) /* obj prop -> obj value */
+DEF(put_array_el, 1, 3, 0, none) /* obj prop value -> */
+DEF(define_array_el, 1, 3, 1, none) /* obj prop value -> obj */
+DEF(delete, 1, 2, 1, none) /* obj prop -> bool */
+
+/* variables of the function and of its closures */
+DEF(get_loc, 3, 0, 1, loc)
+DEF(put_loc, 3, 1, 0, loc)
+DEF(set_loc, 3, 1, 1, loc)
+DEF(get_arg, 3, 0, 1, arg)
+DEF(put_arg, 3, 1, 0, arg)
+DEF(set_arg, 3, 1, 1, arg)
+DEF(get_var_ref, 3, 0, 1, var_ref)
+DEF(put_var_ref, 3, 1, 0, var_ref)
+DEF(set_var_ref, 3, 1, 1, var_ref)
+DEF(set_loc_uninitialized, 3, 0, 0, loc)
+DEF(get_loc_check, 3, 0, 1, loc) /* ReferenceError if uninitialized */
+DEF(put_loc_check, 3, 1, 0, loc)
+DEF(get_var_ref_check, 3, 0, 1, var_ref)
+DEF(put_var_ref_check, 3, 1, 0, var_ref)
+DEF(close_loc, 3, 0, 0, loc) /* detach the closures from the variable */
+
+/* control flow */
+DEF(if_false, 5, 1, 0, label)
+DEF(if_true, 5, 1, 0, label)
+DEF(goto, 5, 0, 0, label)
+DEF(catch, 5, 0, 1, label) /* push the catch offset */
+DEF(gosub, 5, 0, 0, label) /* call a finally block */
+DEF(ret, 1, 1, 0, none) /* return from a finally block */
+DEF(nip_catch, 1, 2, 1, none) /* catch_offset ... a -> a */
+
+/* generators */
+DEF(initial_yield, 1, 0, 0, none) /* end of the prologue */
+DEF(yield, 1, 1, 2, none) /* a -> received_value is_return */
+
+/* operators */
+DEF(neg, 1, 1, 1, none)
+DEF(plus, 1, 1, 1, none)
+DEF(dec, 1, 1, 1, none)
+DEF(inc, 1, 1, 1, none)
+DEF(post_dec, 1, 1, 2, none) /* a -> num(a) num(a)-1 */
+DEF(post_inc, 1, 1, 2, none)
+DEF(not, 1, 1, 1, none)
+DEF(lnot, 1, 1, 1, none)
+DEF(typeof, 1, 1, 1, none)
+DEF(mul, 1, 2, 1, none)
+DEF(div, 1, 2, 1, none)
+DEF(mod, 1, 2, 1, none)
+DEF(add, 1, 2, 1, none)
+DEF(sub, 1, 2, 1, none)
+DEF(pow, 1, 2, 1, none)
+DEF(shl, 1, 2, 1, none)
+DEF(sar, 1, 2, 1, none)
+DEF(shr, 1, 2, 1, none)
+DEF(lt, 1, 2, 1, none)
+DEF(lte, 1, 2, 1, none)
+DEF(gt, 1, 2, 1, none)
+DEF(gte, 1, 2, 1, none)
+DEF(instanceof, 1, 2, 1, none)
+DEF(in, 1, 2, 1, none)
+DEF(eq, 1, 2, 1, none)
+DEF(neq, 1, 2, 1, none)
+DEF(strict_eq, 1, 2, 1, none)
+DEF(strict_neq, 1, 2, 1, none)
+DEF(and, 1, 2, 1, none)
+DEF(xor, 1, 2, 1, none)
+DEF(or, 1, 2, 1, none)
+DEF(is_undefined_or_null, 1, 1, 1, none)
+DEF(nop, 1, 0, 0, none)
+
+/* short forms */
+DEF(push_minus1, 1, 0, 1, none_int)
+DEF(push_0, 1, 0, 1, none_int)
+DEF(push_1, 1, 0, 1, none_int)
+DEF(push_2, 1, 0, 1, none_int)
+DEF(push_3, 1, 0, 1, none_int)
+DEF(push_4, 1, 0, 1, none_int)
+DEF(push_5, 1, 0, 1, none_int)
+DEF(push_6, 1, 0, 1, none_int)
+DEF(push_7, 1, 0, 1, none_int)
+DEF(push_i8, 2, 0, 1, i8)
+DEF(push_i16, 3, 0, 1, i16)
+DEF(get_loc8, 2, 0, 1, loc8)
+DEF(put_loc8, 2, 1, 0, loc8)
+DEF(set_loc8, 2, 1, 1, loc8)
+DEF(get_loc0, 1, 0, 1, none_loc)
+DEF(get_loc1, 1, 0, 1, none_loc)
+DEF(get_loc2, 1, 0, 1, none_loc)
+DEF(get_loc3, 1, 0, 1, none_loc)
+DEF(put_loc0, 1, 1, 0, none_loc)
+DEF(put_loc1, 1, 1, 0, none_loc)
+DEF(put_loc2, 1, 1, 0, none_loc)
+DEF(put_loc3, 1, 1, 0, none_loc)
+DEF(set_loc0, 1, 1, 1, none_loc)
+DEF(set_loc1, 1, 1, 1, none_loc)
+DEF(set_loc2, 1, 1, 1, none_loc)
+DEF(set_loc3, 1, 1, 1, none_loc)
+DEF(get_arg0, 1, 0, 1, none_arg)
+DEF(get_arg1, 1, 0, 1, none_arg)
+DEF(get_arg2, 1, 0, 1, none_arg)
+DEF(get_arg3, 1, 0, 1, none_arg)
+DEF(put_arg0, 1, 1, 0, none_arg)
+DEF(put_arg1, 1, 1, 0, none_arg)
+DEF(put_arg2, 1, 1, 0, none_arg)
+DEF(put_arg3, 1, 1, 0, none_arg)
+DEF(set_arg0, 1, 1, 1, none_arg)
+DEF(set_arg1, 1, 1, 1, none_arg)
+DEF(set_arg2, 1, 1, 1, none_arg)
+DEF(set_arg3, 1, 1, 1, none_arg)
+DEF(get_var_ref0, 1, 0, 1, none_var_ref)
+DEF(get_var_ref1, 1, 0, 1, none_var_ref)
+DEF(get_var_ref2, 1, 0, 1, none_var_ref)
+DEF(get_var_ref3, 1, 0, 1, none_var_ref)
+DEF(put_var_ref0, 1, 1, 0, none_var_ref)
+DEF(put_var_ref1, 1, 1, 0, none_var_ref)
+DEF(put_var_ref2, 1, 1, 0, none_var_ref)
+DEF(put_var_ref3, 1, 1, 0, none_var_ref)
+DEF(set_var_ref0, 1, 1, 1, none_var_ref)
+DEF(set_var_ref1, 1, 1, 1, none_var_ref)
+DEF(set_var_ref2, 1, 1, 1, none_var_ref)
+DEF(set_var_ref3, 1, 1, 1, none_var_ref)
+DEF(call0, 1, 1, 1, npopx)
+DEF(call1, 1, 1, 1, npopx)
+DEF(call2, 1, 1, 1, npopx)
+DEF(call3, 1, 1, 1, npopx)
+DEF(if_false8, 2, 1, 0, label8)
+DEF(if_true8, 2, 1, 0, label8)
+DEF(goto8, 2, 0, 0, label8)
+DEF(goto16, 3, 0, 0, label16)
+
+/* superinstructions, selected by the peephole optimization of
+   js_bytecode_finalize() */
+DEF(get_loc_get_field, 6, 0, 1, loc8_atom) /* -> loc.atom */
+DEF(get_arg_get_field, 6, 0, 1, arg8_atom) /* -> arg.atom */
+DEF(add_i8, 2, 1, 1, i8) /* a -> a + i8 */
+DEF(lt_if_false, 5, 2, 0, label) /* a b -> , jump if !(a < b) */
+DEF(lte_if_false, 5, 2, 0, label)
+DEF(gt_if_false, 5, 2, 0, label)
+DEF(gte_if_false, 5, 2, 0, label)
+DEF(lt_if_false8, 2, 2, 0, label8)
+DEF(lte_if_false8, 2, 2, 0, label8)
+DEF(gt_if_false8, 2, 2, 0, label8)
+DEF(gte_if_false8, 2, 2, 0, label8)
+
+/* temporary opcodes, removed before the function is created */
+def(enter_scope, 3, 0, 0, u16) /* removed by the variable resolution */
+def(leave_scope, 3, 0, 0, u16)
+def(scope_get_var, 7, 0, 1, atom_u16) /* atom scope_level */
+def(scope_get_var_undef, 7, 0, 1, atom_u16)
+def(scope_put_var, 7, 1, 0, atom_u16)
+def(scope_put_var_init, 7, 1, 0, atom_u16)
+def(scope_delete_var, 7, 0, 1, atom_u16)
+def(label, 5, 0, 0, label) /* removed by js_bytecode_finalize() */
+def(line_num, 5, 0, 0, u32)
+
+#undef DEF
+#undef def
+#endif /* DEF */
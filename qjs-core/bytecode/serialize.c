@@ -0,0 +1,754 @@
+#include "bytecode.h"
+#include "gc.h"
+
+/* Serialization of the compiled functions. The final code does not
+   depend on the runtime (its atom operands are indexes in the function
+   atom table), so it is written as is and, with JS_READ_OBJ_ROM_DATA,
+   used in place from the read buffer. Only the atoms are translated:
+   they are written once as strings at the start of the buffer.
+
+   buffer:    version (u8), endianness (u8), leb128 atom count, the atoms
+              (leb128(len << 1 | is_wide_char) and the characters), then
+              the object.
+   atom ref:  leb128: 0 = JS_ATOM_NULL, (n << 1) | 1 = integer atom n,
+              (idx + 1) << 1 = atom 'idx' of the table. */
+
+#define BC_VERSION 3
+/* maximum nesting of the functions */
+#define BC_MAX_LEVEL 1024
+
+typedef union {
+    double d;
+    uint64_t u64;
+} BCFloat64Union;
+
+typedef enum BCTagEnum {
+    BC_TAG_NULL = 1,
+    BC_TAG_UNDEFINED,
+    BC_TAG_BOOL_FALSE,
+    BC_TAG_BOOL_TRUE,
+    BC_TAG_INT32,
+    BC_TAG_FLOAT64,
+    BC_TAG_STRING,
+    BC_TAG_FUNCTION_BYTECODE,
+} BCTagEnum;
+
+static uint8_t bc_host_endian(void)
+{
+    union {
+        uint16_t v;
+        uint8_t c[2];
+    } u = { .v = 1 };
+    return u.c[0]; /* 1 = little endian */
+}
+
+typedef struct BCWriterState {
+    JSContext *ctx;
+    DynBuf dbuf;
+    BOOL allow_bytecode;
+    /* index + 1 of the atoms in idx_to_atom, 0 if not written yet */
+    uint32_t *atom_to_idx;
+    int atom_to_idx_size;
+    JSAtom *idx_to_atom;
+    int idx_to_atom_count;
+    int idx_to_atom_size;
+} BCWriterState;
+
+static int bc_resize(JSContext *ctx, void **parray, int elem_size,
+                     int *psize, int req_size)
+{
+    int new_size;
+    void *new_array;
+
+    if (req_size > *psize) {
+        new_size = max_int(req_size, *psize * 3 / 2);
+        new_array = js_realloc(ctx, *parray, (size_t)new_size * elem_size);
+        if (!new_array)
+            return -1;
+        *parray = new_array;
+        *psize = new_size;
+    }
+    return 0;
+}
+
+static int bc_put_atom(BCWriterState *s, JSAtom atom)
+{
+    uint32_t idx;
+    int old_size;
+
+    if (atom == JS_ATOM_NULL) {
+        dbuf_put_leb128(&s->dbuf, 0);
+        return 0;
+    }
+    if (__JS_AtomIsTaggedInt(atom)) {
+        dbuf_put_leb128(&s->dbuf, (__JS_AtomToUInt32(atom) << 1) | 1);
+        return 0;
+    }
+    if (atom >= s->atom_to_idx_size) {
+        old_size = s->atom_to_idx_size;
+        if (bc_resize(s->ctx, (void **)&s->atom_to_idx,
+                      sizeof(s->atom_to_idx[0]), &s->atom_to_idx_size,
+                      atom + 1))
+            return -1;
+        memset(s->atom_to_idx + old_size, 0,
+               sizeof(s->atom_to_idx[0]) * (s->atom_to_idx_size - old_size));
+    }
+    idx = s->atom_to_idx[atom];
+    if (idx == 0) {
+        if (bc_resize(s->ctx, (void **)&s->idx_to_atom,
+                      sizeof(s->idx_to_atom[0]), &s->idx_to_atom_size,
+                      s->idx_to_atom_count + 1))
+            return -1;
+        s->idx_to_atom[s->idx_to_atom_count++] = atom;
+        idx = s->idx_to_atom_count;
+        s->atom_to_idx[atom] = idx;
+    }
+    dbuf_put_leb128(&s->dbuf, idx << 1);
+    return 0;
+}
+
+static void bc_put_string(DynBuf *dbuf, JSString *p)
+{
+    dbuf_put_leb128(dbuf, (p->len << 1) | p->is_wide_char);
+    if (p->is_wide_char)
+        dbuf_put(dbuf, (const uint8_t *)p->u.str16, p->len * 2);
+    else
+        dbuf_put(dbuf, p->u.str8, p->len);
+}
+
+static int bc_write_value(BCWriterState *s, JSValueConst val);
+
+static int bc_write_function(BCWriterState *s, JSFunctionBytecode *b)
+{
+    DynBuf *d = &s->dbuf;
+    JSVarDef *vd;
+    JSClosureVar *cv;
+    int i;
+
+    dbuf_putc(d, BC_TAG_FUNCTION_BYTECODE);
+    dbuf_putc(d, b->is_strict | (b->is_arrow << 1) | (b->has_prototype << 2) |
+              ((b->lazy != NULL) << 3) | (b->is_generator << 4));
+    if (bc_put_atom(s, b->func_name))
+        return -1;
+    dbuf_put_leb128(d, b->arg_count);
+    dbuf_put_leb128(d, b->var_count);
+    dbuf_put_leb128(d, b->defined_arg_count);
+    dbuf_put_leb128(d, b->closure_var_count);
+    dbuf_put_leb128(d, b->cpool_count);
+    dbuf_put_leb128(d, b->atom_count);
+    dbuf_put_leb128(d, b->byte_code_len);
+    for(i = 0; i < b->atom_count; i++) {
+        if (bc_put_atom(s, b->atoms[i]))
+            return -1;
+    }
+    for(i = 0; i < b->arg_count + b->var_count; i++) {
+        vd = &b->vardefs[i];
+        if (bc_put_atom(s, vd->var_name))
+            return -1;
+        dbuf_put_leb128(d, vd->scope_level);
+        dbuf_put_leb128(d, vd->scope_next + 1);
+        dbuf_putc(d, vd->is_const | (vd->is_lexical << 1) |
+                  (vd->is_captured << 2) | (vd->is_func_var << 3));
+        dbuf_put_leb128(d, vd->func_pool_idx + 1);
+    }
+    for(i = 0; i < b->closure_var_count; i++) {
+        cv = &b->closure_var[i];
+        if (bc_put_atom(s, cv->var_name))
+            return -1;
+        dbuf_put_leb128(d, cv->var_idx);
+        dbuf_putc(d, cv->is_local | (cv->is_arg << 1) | (cv->is_const << 2) |
+                  (cv->is_lexical << 3) | (cv->is_copied << 4));
+    }
+    if (bc_put_atom(s, b->debug.filename))
+        return -1;
+    dbuf_put_leb128(d, b->debug.line_num);
+    dbuf_put_leb128(d, b->debug.pc2line_len);
+    if (b->debug.pc2line_len > 0)
+        dbuf_put(d, b->debug.pc2line_buf, b->debug.pc2line_len);
+    if (b->lazy) {
+        /* the lazy functions are written with their source */
+        dbuf_putc(d, b->lazy->func_type);
+        dbuf_putc(d, b->lazy->is_func_expr | (b->lazy->is_parent_strict << 1));
+        dbuf_put_leb128(d, b->lazy->line_num);
+        dbuf_put_leb128(d, b->lazy->source_len);
+        dbuf_put(d, b->lazy->source, b->lazy->source_len);
+        return 0;
+    }
+    dbuf_put(d, b->byte_code_buf, b->byte_code_len);
+    for(i = 0; i < b->cpool_count; i++) {
+        if (bc_write_value(s, b->cpool[i]))
+            return -1;
+    }
+    return 0;
+}
+
+static int bc_write_value(BCWriterState *s, JSValueConst val)
+{
+    DynBuf *d = &s->dbuf;
+
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_NULL:
+        dbuf_putc(d, BC_TAG_NULL);
+        break;
+    case JS_TAG_UNDEFINED:
+        dbuf_putc(d, BC_TAG_UNDEFINED);
+        break;
+    case JS_TAG_BOOL:
+        dbuf_putc(d, JS_VALUE_GET_BOOL(val) ? BC_TAG_BOOL_TRUE : BC_TAG_BOOL_FALSE);
+        break;
+    case JS_TAG_INT:
+        dbuf_putc(d, BC_TAG_INT32);
+        dbuf_put_sleb128(d, JS_VALUE_GET_INT(val));
+        break;
+    case JS_TAG_FLOAT64:
+        {
+            BCFloat64Union u;
+            dbuf_putc(d, BC_TAG_FLOAT64);
+            u.d = JS_VALUE_GET_FLOAT64(val);
+            dbuf_put_u64(d, u.u64);
+        }
+        break;
+    case JS_TAG_STRING:
+        dbuf_putc(d, BC_TAG_STRING);
+        bc_put_string(d, JS_VALUE_GET_STRING(val));
+        break;
+    case JS_TAG_FUNCTION_BYTECODE:
+        {
+            JSFunctionBytecode *b = JS_VALUE_GET_PTR(val);
+            if (!s->allow_bytecode)
+                goto invalid_tag;
+            if (b->lazy && b->lazy->compiled)
+                b = b->lazy->compiled;
+            return bc_write_function(s, b);
+        }
+    default:
+    invalid_tag:
+        JS_ThrowTypeError(s->ctx, "unsupported tag (%d)", JS_VALUE_GET_TAG(val));
+        return -1;
+    }
+    return 0;
+}
+
+uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
+                        int flags)
+{
+    BCWriterState ss, *s = &ss;
+    JSRuntime *rt = ctx->rt;
+    DynBuf out;
+    uint8_t *buf;
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->allow_bytecode = ((flags & JS_WRITE_OBJ_BYTECODE) != 0);
+    js_dbuf_init(ctx, &s->dbuf);
+    js_dbuf_init(ctx, &out);
+    buf = NULL;
+    if (bc_write_value(s, obj))
+        goto done;
+
+    /* the atom table precedes the object */
+    dbuf_putc(&out, BC_VERSION);
+    dbuf_putc(&out, bc_host_endian());
+    dbuf_put_leb128(&out, s->idx_to_atom_count);
+    for(i = 0; i < s->idx_to_atom_count; i++)
+        bc_put_string(&out, rt->atom_array[s->idx_to_atom[i]]);
+    dbuf_put(&out, s->dbuf.buf, s->dbuf.size);
+    if (dbuf_error(&s->dbuf) || dbuf_error(&out)) {
+        JS_ThrowOutOfMemory(ctx);
+        goto done;
+    }
+    buf = out.buf;
+    *psize = out.size;
+    out.buf = NULL;
+ done:
+    dbuf_free(&out);
+    dbuf_free(&s->dbuf);
+    js_free(ctx, s->atom_to_idx);
+    js_free(ctx, s->idx_to_atom);
+    return buf;
+}
+
+typedef struct BCReaderState {
+    JSContext *ctx;
+    const uint8_t *buf_start, *ptr, *buf_end;
+    JSAtom *idx_to_atom;
+    uint32_t idx_to_atom_count;
+    BOOL allow_bytecode;
+    BOOL is_rom_data;
+    int level;
+} BCReaderState;
+
+static int bc_read_error_end(BCReaderState *s)
+{
+    JS_ThrowSyntaxError(s->ctx, "read after the end of the buffer");
+    return -1;
+}
+
+static int bc_get_u8(BCReaderState *s, uint8_t *pval)
+{
+    if (s->ptr >= s->buf_end)
+        return bc_read_error_end(s);
+    *pval = *s->ptr++;
+    return 0;
+}
+
+static int bc_get_leb128(BCReaderState *s, uint32_t *pval)
+{
+    int ret;
+
+    ret = get_leb128(pval, s->ptr, s->buf_end);
+    if (ret < 0)
+        return bc_read_error_end(s);
+    s->ptr += ret;
+    return 0;
+}
+
+static int bc_get_sleb128(BCReaderState *s, int32_t *pval)
+{
+    int ret;
+
+    ret = get_sleb128(pval, s->ptr, s->buf_end);
+    if (ret < 0)
+        return bc_read_error_end(s);
+    s->ptr += ret;
+    return 0;
+}
+
+/* leb128 value lower than 'max' */
+static int bc_get_count(BCReaderState *s, uint32_t *pval, uint32_t max)
+{
+    if (bc_get_leb128(s, pval))
+        return -1;
+    if (*pval >= max) {
+        JS_ThrowSyntaxError(s->ctx, "invalid count");
+        return -1;
+    }
+    return 0;
+}
+
+/* 'len' bytes of the buffer */
+static const uint8_t *bc_get_buf(BCReaderState *s, uint32_t len)
+{
+    const uint8_t *p;
+
+    if (len > s->buf_end - s->ptr) {
+        bc_read_error_end(s);
+        return NULL;
+    }
+    p = s->ptr;
+    s->ptr += len;
+    return p;
+}
+
+/* the atom is duplicated */
+static int bc_get_atom(BCReaderState *s, JSAtom *patom)
+{
+    uint32_t v;
+
+    if (bc_get_leb128(s, &v))
+        return -1;
+    if (v == 0) {
+        *patom = JS_ATOM_NULL;
+    } else if (v & 1) {
+        *patom = __JS_AtomFromUInt32(v >> 1);
+    } else {
+        v = (v >> 1) - 1;
+        if (v >= s->idx_to_atom_count) {
+            JS_ThrowSyntaxError(s->ctx, "invalid atom index");
+            return -1;
+        }
+        *patom = JS_DupAtom(s->ctx, s->idx_to_atom[v]);
+    }
+    return 0;
+}
+
+static JSString *bc_get_string(BCReaderState *s)
+{
+    JSString *p;
+    const uint8_t *buf;
+    uint32_t len;
+    int is_wide_char;
+
+    if (bc_get_leb128(s, &len))
+        return NULL;
+    is_wide_char = len & 1;
+    len >>= 1;
+    if (len > JS_STRING_LEN_MAX) {
+        JS_ThrowSyntaxError(s->ctx, "invalid string length");
+        return NULL;
+    }
+    buf = bc_get_buf(s, len << is_wide_char);
+    if (!buf)
+        return NULL;
+    p = js_alloc_string(s->ctx, len, is_wide_char);
+    if (!p)
+        return NULL;
+    if (is_wide_char) {
+        memcpy(p->u.str16, buf, len * 2);
+    } else {
+        memcpy(p->u.str8, buf, len);
+        p->u.str8[len] = '\0';
+    }
+    return p;
+}
+
+static JSValue bc_read_value(BCReaderState *s);
+
+/* the closure variables of the inner functions refer to 'b' */
+static int bc_check_closure_vars(BCReaderState *s, JSFunctionBytecode *b)
+{
+    JSFunctionBytecode *b1;
+    JSClosureVar *cv;
+    int i, j, idx_max;
+
+    for(i = 0; i < b->cpool_count; i++) {
+        if (JS_VALUE_GET_TAG(b->cpool[i]) != JS_TAG_FUNCTION_BYTECODE)
+            continue;
+        b1 = JS_VALUE_GET_PTR(b->cpool[i]);
+        for(j = 0; j < b1->closure_var_count; j++) {
+            cv = &b1->closure_var[j];
+            if (!cv->is_local)
+                idx_max = b->closure_var_count;
+            else if (cv->is_arg)
+                idx_max = b->arg_count;
+            else
+                idx_max = b->var_count;
+            /* a copied variable is not a JSVarRef in the closures of
+               'b' */
+            if (cv->var_idx >= idx_max ||
+                (!cv->is_local &&
+                 cv->is_copied != b->closure_var[cv->var_idx].is_copied)) {
+                JS_ThrowSyntaxError(s->ctx, "invalid closure variable");
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* the function is compiled from its source on the first call */
+static int bc_read_lazy_function(BCReaderState *s, JSFunctionBytecode *b)
+{
+    JSContext *ctx = s->ctx;
+    JSLazyFunction *lf;
+    const uint8_t *buf;
+    uint8_t v8;
+    uint32_t v;
+
+    lf = js_mallocz(ctx, sizeof(*lf));
+    if (!lf)
+        return -1;
+    b->lazy = lf;
+    if (bc_get_u8(s, &v8))
+        return -1;
+    lf->func_type = v8;
+    if (bc_get_u8(s, &v8))
+        return -1;
+    lf->is_func_expr = v8 & 1;
+    lf->is_parent_strict = (v8 >> 1) & 1;
+    if (bc_get_leb128(s, &v))
+        return -1;
+    lf->line_num = v;
+    if (bc_get_leb128(s, &v))
+        return -1;
+    buf = bc_get_buf(s, v);
+    if (!buf)
+        return -1;
+    /* the parser needs a null terminated copy */
+    lf->source = js_malloc(ctx, v + 1);
+    if (!lf->source)
+        return -1;
+    memcpy(lf->source, buf, v);
+    lf->source[v] = '\0';
+    lf->source_len = v;
+    return 0;
+}
+
+static JSValue bc_read_function(BCReaderState *s)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionBytecode *b;
+    JSValue obj;
+    JSVarDef *vd;
+    JSClosureVar *cv;
+    uint32_t arg_count, var_count, defined_arg_count, closure_var_count;
+    uint32_t cpool_count, atom_count, byte_code_len, v;
+    int function_size, cpool_offset, vardefs_offset, closure_var_offset;
+    const uint8_t *buf;
+    JSAtom func_name;
+    uint8_t flags, func_flags;
+    uint32_t i;
+
+    if (bc_get_u8(s, &func_flags) || bc_get_atom(s, &func_name))
+        return JS_EXCEPTION;
+    /* the counts are bounded by the remaining size of the buffer */
+    v = s->buf_end - s->ptr + 1;
+    if (bc_get_count(s, &arg_count, min_uint32(v, 65536)) ||
+        bc_get_count(s, &var_count, min_uint32(v, 65536)) ||
+        bc_get_count(s, &defined_arg_count,
+                     (func_flags & 8) ? 65536 : arg_count + 1) ||
+        bc_get_count(s, &closure_var_count, min_uint32(v, 65536)) ||
+        bc_get_count(s, &cpool_count, v) ||
+        bc_get_count(s, &atom_count, v) ||
+        bc_get_count(s, &byte_code_len, v)) {
+        JS_FreeAtom(ctx, func_name);
+        return JS_EXCEPTION;
+    }
+    /* a lazy function only has closure variables */
+    if ((func_flags & 8) && (arg_count | var_count | cpool_count |
+                             atom_count | byte_code_len) != 0) {
+        JS_ThrowSyntaxError(ctx, "invalid lazy function");
+        JS_FreeAtom(ctx, func_name);
+        return JS_EXCEPTION;
+    }
+
+    function_size = sizeof(*b);
+    cpool_offset = function_size;
+    function_size += cpool_count * sizeof(*b->cpool);
+    vardefs_offset = function_size;
+    function_size += (arg_count + var_count) * sizeof(*b->vardefs);
+    closure_var_offset = function_size;
+    function_size += closure_var_count * sizeof(*b->closure_var);
+    b = js_mallocz_gc(ctx, function_size);
+    if (!b) {
+        JS_FreeAtom(ctx, func_name);
+        return JS_EXCEPTION;
+    }
+    b->header.ref_count = 1;
+    b->header.account_id = ctx->mem_account->id;
+    b->is_strict = func_flags & 1;
+    b->is_arrow = (func_flags >> 1) & 1;
+    b->has_prototype = (func_flags >> 2) & 1;
+    b->is_generator = (func_flags >> 4) & 1;
+    b->func_name = func_name;
+    b->arg_count = arg_count;
+    b->var_count = var_count;
+    b->defined_arg_count = defined_arg_count;
+    if (cpool_count > 0)
+        b->cpool = (void *)((uint8_t *)b + cpool_offset);
+    if (arg_count + var_count > 0)
+        b->vardefs = (void *)((uint8_t *)b + vardefs_offset);
+    if (closure_var_count > 0)
+        b->closure_var = (void *)((uint8_t *)b + closure_var_offset);
+    b->read_only_bytecode = s->is_rom_data;
+    add_gc_object(ctx->rt, &b->header, JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
+    /* the partially read function is freed with the usual destructor:
+       the counts are incremented as the fields are read */
+    obj = JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b);
+
+    if (atom_count > 0) {
+        b->atoms = js_malloc(ctx, sizeof(b->atoms[0]) * atom_count);
+        if (!b->atoms)
+            goto fail;
+        for(i = 0; i < atom_count; i++) {
+            if (bc_get_atom(s, &b->atoms[i]))
+                goto fail;
+            b->atom_count++;
+        }
+    }
+    for(i = 0; i < arg_count + var_count; i++) {
+        vd = &b->vardefs[i];
+        if (bc_get_atom(s, &vd->var_name) ||
+            bc_get_leb128(s, &v))
+            goto fail;
+        vd->scope_level = v;
+        if (bc_get_leb128(s, &v))
+            goto fail;
+        vd->scope_next = v - 1;
+        if (bc_get_u8(s, &flags))
+            goto fail;
+        vd->is_const = flags & 1;
+        vd->is_lexical = (flags >> 1) & 1;
+        vd->is_captured = (flags >> 2) & 1;
+        vd->is_func_var = (flags >> 3) & 1;
+        if (bc_get_count(s, &v, cpool_count + 1))
+            goto fail;
+        vd->func_pool_idx = v - 1;
+    }
+    for(i = 0; i < closure_var_count; i++) {
+        cv = &b->closure_var[i];
+        if (bc_get_atom(s, &cv->var_name))
+            goto fail;
+        b->closure_var_count++;
+        if (bc_get_count(s, &v, 65536) || bc_get_u8(s, &flags))
+            goto fail;
+        cv->var_idx = v;
+        cv->is_local = flags & 1;
+        cv->is_arg = (flags >> 1) & 1;
+        cv->is_const = (flags >> 2) & 1;
+        cv->is_lexical = (flags >> 3) & 1;
+        cv->is_copied = (flags >> 4) & 1;
+    }
+    if (bc_get_atom(s, &b->debug.filename) ||
+        bc_get_leb128(s, &v))
+        goto fail;
+    b->debug.line_num = v;
+    if (bc_get_leb128(s, &v))
+        goto fail;
+    if (v > 0) {
+        buf = bc_get_buf(s, v);
+        if (!buf)
+            goto fail;
+        if (s->is_rom_data) {
+            b->debug.pc2line_buf = (uint8_t *)buf;
+        } else {
+            b->debug.pc2line_buf = js_malloc(ctx, v);
+            if (!b->debug.pc2line_buf)
+                goto fail;
+            memcpy(b->debug.pc2line_buf, buf, v);
+        }
+        b->debug.pc2line_len = v;
+    }
+    if (func_flags & 8) {
+        if (bc_read_lazy_function(s, b))
+            goto fail;
+        return obj;
+    }
+    buf = bc_get_buf(s, byte_code_len);
+    if (!buf)
+        goto fail;
+    if (s->is_rom_data) {
+        b->byte_code_buf = (uint8_t *)buf;
+    } else {
+        b->byte_code_buf = js_malloc(ctx, max_int(byte_code_len, 1));
+        if (!b->byte_code_buf)
+            goto fail;
+        memcpy(b->byte_code_buf, buf, byte_code_len);
+    }
+    b->byte_code_len = byte_code_len;
+
+    for(i = 0; i < cpool_count; i++) {
+        JSValue val = bc_read_value(s);
+        if (JS_IsException(val))
+            goto fail;
+        b->cpool[i] = val;
+        b->cpool_count++;
+    }
+    if (bc_check_closure_vars(s, b) || js_bytecode_check(ctx, b))
+        goto fail;
+    return obj;
+ fail:
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+static JSValue bc_read_value(BCReaderState *s)
+{
+    JSContext *ctx = s->ctx;
+    JSValue obj;
+    JSString *p;
+    uint8_t tag;
+
+    if (bc_get_u8(s, &tag))
+        return JS_EXCEPTION;
+    switch(tag) {
+    case BC_TAG_NULL:
+        obj = JS_NULL;
+        break;
+    case BC_TAG_UNDEFINED:
+        obj = JS_UNDEFINED;
+        break;
+    case BC_TAG_BOOL_FALSE:
+    case BC_TAG_BOOL_TRUE:
+        obj = JS_NewBool(ctx, tag - BC_TAG_BOOL_FALSE);
+        break;
+    case BC_TAG_INT32:
+        {
+            int32_t v;
+            if (bc_get_sleb128(s, &v))
+                return JS_EXCEPTION;
+            obj = JS_NewInt32(ctx, v);
+        }
+        break;
+    case BC_TAG_FLOAT64:
+        {
+            BCFloat64Union u;
+            const uint8_t *buf = bc_get_buf(s, sizeof(u.u64));
+            if (!buf)
+                return JS_EXCEPTION;
+            u.u64 = get_u64(buf);
+            obj = __JS_NewFloat64(ctx, u.d);
+        }
+        break;
+    case BC_TAG_STRING:
+        p = bc_get_string(s);
+        if (!p)
+            return JS_EXCEPTION;
+        obj = JS_MKPTR(JS_TAG_STRING, p);
+        break;
+    case BC_TAG_FUNCTION_BYTECODE:
+        if (!s->allow_bytecode)
+            goto invalid_tag;
+        if (s->level >= BC_MAX_LEVEL) {
+            JS_ThrowSyntaxError(ctx, "too many nested functions");
+            return JS_EXCEPTION;
+        }
+        s->level++;
+        obj = bc_read_function(s);
+        s->level--;
+        break;
+    default:
+    invalid_tag:
+        JS_ThrowSyntaxError(ctx, "invalid tag (tag=%d pos=%u)", tag,
+                            (unsigned)(s->ptr - 1 - s->buf_start));
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
+JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                      int flags)
+{
+    BCReaderState ss, *s = &ss;
+    JSValue obj;
+    JSString *p;
+    uint8_t version, endian;
+    uint32_t i, count;
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->buf_start = buf;
+    s->ptr = buf;
+    s->buf_end = buf + buf_len;
+    s->allow_bytecode = ((flags & JS_READ_OBJ_BYTECODE) != 0);
+    s->is_rom_data = ((flags & JS_READ_OBJ_ROM_DATA) != 0);
+    obj = JS_EXCEPTION;
+
+    if (bc_get_u8(s, &version) || bc_get_u8(s, &endian))
+        return JS_EXCEPTION;
+    if (version != BC_VERSION || endian != bc_host_endian()) {
+        JS_ThrowSyntaxError(ctx, "invalid version (%d expected=%d)",
+                            version, BC_VERSION);
+        return JS_EXCEPTION;
+    }
+    if (bc_get_count(s, &count, s->buf_end - s->ptr + 1))
+        return JS_EXCEPTION;
+    if (count > 0) {
+        s->idx_to_atom = js_malloc(ctx, sizeof(s->idx_to_atom[0]) * count);
+        if (!s->idx_to_atom)
+            return JS_EXCEPTION;
+    }
+    for(i = 0; i < count; i++) {
+        p = bc_get_string(s);
+        if (!p)
+            goto done;
+        s->idx_to_atom[i] = JS_ValueToAtom(ctx, JS_MKPTR(JS_TAG_STRING, p));
+        JS_FreeValue(ctx, JS_MKPTR(JS_TAG_STRING, p));
+        if (s->idx_to_atom[i] == JS_ATOM_NULL)
+            goto done;
+        s->idx_to_atom_count++;
+    }
+    obj = bc_read_value(s);
+    if (!JS_IsException(obj) && JS_VALUE_GET_TAG(obj) == JS_TAG_FUNCTION_BYTECODE &&
+        ((JSFunctionBytecode *)JS_VALUE_GET_PTR(obj))->closure_var_count != 0) {
+        /* only the top level functions can be read */
+        JS_FreeValue(ctx, obj);
+        obj = JS_ThrowSyntaxError(ctx, "invalid closure variable");
+    }
+ done:
+    for(i = 0; i < s->idx_to_atom_count; i++)
+        JS_FreeAtom(ctx, s->idx_to_atom[i]);
+    js_free(ctx, s->idx_to_atom);
+    return obj;
+}
@@ -0,0 +1,299 @@
+#include "bytecode.h"
+
+/* Context cloning: the objects reachable from the template roots are
+   copied once (the copies keep the same graph, including the cycles),
+   the shapes and the strings are shared with the template. Shared
+   shapes are copied on write by add_property() and
+   js_shape_prepare_update(), so the template and the clones never see
+   each other's modifications.
+
+   The objects themselves are not copy-on-write: it would need a check
+   on every property store (the generic paths, the fast arrays and the
+   inline caches of the interpreter), which all the contexts would pay.
+   Instead a clone costs one allocation per reachable object plus its
+   property array and its fast array elements, and the time is linear
+   in the size of the template graph. The bytecode and the C function
+   tables are shared.
+
+   Only the classes whose whole state is the property array (plus the
+   fast array elements or the function pointers) are cloned. A bytecode
+   function with closure variables is rejected because its variable
+   references point to the frames of the template. The other classes
+   (generators, array buffers, typed arrays, ...) have internal state
+   which is not copied, so they are rejected too. */
+
+typedef struct JSCloneEntry {
+    JSObject *src; /* NULL = free entry */
+    JSObject *dst;
+} JSCloneEntry;
+
+typedef struct JSCloneState {
+    JSContext *ctx; /* new context */
+    JSContext *tmpl;
+    /* open addressing hash table: template object -> copy */
+    JSCloneEntry *hash;
+    uint32_t hash_size; /* power of two */
+    uint32_t count;
+    /* objects whose prototype and properties must be copied, in
+       insertion order */
+    JSObject **todo;
+    uint32_t todo_size;
+    uint32_t todo_len;
+} JSCloneState;
+
+static inline uint32_t clone_hash_ptr(const void *p, uint32_t mask)
+{
+    uintptr_t h = (uintptr_t)p;
+    h ^= h >> 17;
+    h *= 0x9e3779b1;
+    return (uint32_t)(h >> 7) & mask;
+}
+
+static int clone_hash_resize(JSCloneState *s, uint32_t new_size)
+{
+    JSCloneEntry *new_hash, *e;
+    uint32_t i, h, mask;
+
+    new_hash = js_mallocz(s->tmpl, sizeof(new_hash[0]) * new_size);
+    if (!new_hash)
+        return -1;
+    mask = new_size - 1;
+    for(i = 0; i < s->hash_size; i++) {
+        e = &s->hash[i];
+        if (!e->src)
+            continue;
+        h = clone_hash_ptr(e->src, mask);
+        while (new_hash[h].src)
+            h = (h + 1) & mask;
+        new_hash[h] = *e;
+    }
+    js_free(s->tmpl, s->hash);
+    s->hash = new_hash;
+    s->hash_size = new_size;
+    return 0;
+}
+
+static JSCloneEntry *clone_hash_find(JSCloneState *s, JSObject *src)
+{
+    JSCloneEntry *e;
+    uint32_t h, mask;
+
+    mask = s->hash_size - 1;
+    h = clone_hash_ptr(src, mask);
+    for(;;) {
+        e = &s->hash[h];
+        if (e->src == src || !e->src)
+            return e;
+        h = (h + 1) & mask;
+    }
+}
+
+static JSObject *clone_object(JSCloneState *s, JSObject *p);
+
+static JSValue clone_value(JSCloneState *s, JSValueConst val)
+{
+    JSObject *q;
+
+    if (JS_VALUE_GET_TAG(val) != JS_TAG_OBJECT)
+        return JS_DupValue(s->ctx, val);
+    q = clone_object(s, JS_VALUE_GET_OBJ(val));
+    if (!q)
+        return JS_EXCEPTION;
+    return JS_DupValue(s->ctx, JS_MKPTR(JS_TAG_OBJECT, q));
+}
+
+/* return the copy of 'p' (not duplicated: it is owned by the hash
+   table), or NULL if exception. The properties and the prototype of
+   a new copy are set later by clone_object_fields(). */
+static JSObject *clone_object(JSCloneState *s, JSObject *p)
+{
+    JSContext *ctx = s->ctx;
+    JSCloneEntry *e;
+    JSObject *q;
+    JSValue obj;
+    int i;
+
+    e = clone_hash_find(s, p);
+    if (e->src)
+        return e->dst;
+
+    switch(p->class_id) {
+    case JS_CLASS_OBJECT:
+    case JS_CLASS_ERROR:
+    case JS_CLASS_C_FUNCTION:
+    case JS_CLASS_ARRAY:
+        break;
+    case JS_CLASS_BYTECODE_FUNCTION:
+        if (p->u.func.function_bytecode->closure_var_count == 0)
+            break;
+        JS_ThrowInternalError(s->tmpl, "cannot clone a function with "
+                              "closure variables");
+        return NULL;
+    default:
+        JS_ThrowInternalError(s->tmpl, "cannot clone objects of class %d",
+                              p->class_id);
+        return NULL;
+    }
+
+    if (s->count + 1 > s->hash_size / 2) {
+        if (clone_hash_resize(s, s->hash_size * 2))
+            return NULL;
+        e = clone_hash_find(s, p);
+    }
+    if (s->todo_len >= s->todo_size) {
+        JSObject **new_todo;
+        uint32_t new_size = s->todo_size * 3 / 2;
+        new_todo = js_realloc(s->tmpl, s->todo, sizeof(s->todo[0]) * new_size);
+        if (!new_todo)
+            return NULL;
+        s->todo = new_todo;
+        s->todo_size = new_size;
+    }
+
+    obj = JS_NewObjectFromShape(ctx, js_dup_shape(p->shape), NULL,
+                                p->class_id);
+    if (JS_IsException(obj))
+        return NULL;
+    q = JS_VALUE_GET_OBJ(obj);
+    /* keep the object valid for the GC until its fields are copied */
+    for(i = 0; i < q->shape->prop_count; i++)
+        q->prop[i].value = JS_UNDEFINED;
+    q->extensible = p->extensible;
+    q->is_constructor = p->is_constructor;
+    switch(p->class_id) {
+    case JS_CLASS_C_FUNCTION:
+        q->u.cfunc = p->u.cfunc;
+        q->u.cfunc.realm = JS_DupContext(ctx);
+        break;
+    case JS_CLASS_BYTECODE_FUNCTION:
+        /* the bytecode does not depend on the context: it is shared */
+        q->u.func.function_bytecode = p->u.func.function_bytecode;
+        p->u.func.function_bytecode->header.ref_count++;
+        q->u.func.realm = JS_DupContext(ctx);
+        break;
+    case JS_CLASS_ARRAY:
+        q->fast_array = p->fast_array;
+        if (p->fast_array && p->u.array.count != 0) {
+            q->u.array.kind = p->u.array.kind;
+            if (expand_fast_array(ctx, q, p->u.array.count)) {
+                JS_FreeValue(ctx, obj);
+                return NULL;
+            }
+            if (q->u.array.kind == JS_ARRAY_KIND_VALUE) {
+                /* copied by clone_object_fields() */
+                for(i = 0; i < p->u.array.count; i++)
+                    q->u.array.u.values[i] = JS_UNDEFINED;
+            } else {
+                memcpy(q->u.array.u.ptr, p->u.array.u.ptr,
+                       (q->u.array.kind == JS_ARRAY_KIND_INT ?
+                        sizeof(int32_t) : sizeof(double)) *
+                       p->u.array.count);
+            }
+            q->u.array.count = p->u.array.count;
+        }
+        break;
+    default:
+        break;
+    }
+
+    e->src = p;
+    e->dst = q;
+    s->count++;
+    s->todo[s->todo_len++] = p;
+    return q;
+}
+
+static int clone_object_fields(JSCloneState *s, JSObject *p)
+{
+    JSObject *q, *proto;
+    JSValue val;
+    int i;
+
+    q = clone_hash_find(s, p)->dst;
+    if (p->proto) {
+        proto = clone_object(s, p->proto);
+        if (!proto)
+            return -1;
+        q->proto = proto;
+        proto->header.ref_count++;
+    }
+    for(i = 0; i < p->shape->prop_count; i++) {
+        val = clone_value(s, p->prop[i].value);
+        if (JS_IsException(val))
+            return -1;
+        q->prop[i].value = val;
+    }
+    if (p->fast_array && p->u.array.kind == JS_ARRAY_KIND_VALUE) {
+        for(i = 0; i < p->u.array.count; i++) {
+            val = clone_value(s, p->u.array.u.values[i]);
+            if (JS_IsException(val))
+                return -1;
+            q->u.array.u.values[i] = val;
+        }
+    }
+    return 0;
+}
+
+JSContext *JS_CloneContext(JSContext *tmpl)
+{
+    JSCloneState s_s, *s = &s_s;
+    JSContext *ctx;
+    JSCloneEntry *e;
+    uint32_t i;
+    int ret = -1;
+
+    ctx = JS_NewContextRaw(tmpl->rt);
+    if (!ctx) {
+        JS_ThrowOutOfMemory(tmpl);
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->tmpl = tmpl;
+    s->hash_size = 256;
+    s->hash = js_mallocz(tmpl, sizeof(s->hash[0]) * s->hash_size);
+    s->todo_size = 128;
+    s->todo = js_malloc(tmpl, sizeof(s->todo[0]) * s->todo_size);
+    if (!s->hash || !s->todo)
+        goto done;
+
+    for(i = 0; i < JS_CLASS_INIT_COUNT; i++) {
+        ctx->class_proto[i] = clone_value(s, tmpl->class_proto[i]);
+        if (JS_IsException(ctx->class_proto[i]))
+            goto done;
+    }
+    ctx->function_proto = clone_value(s, tmpl->function_proto);
+    if (JS_IsException(ctx->function_proto))
+        goto done;
+    for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++) {
+        ctx->native_error_proto[i] = clone_value(s, tmpl->native_error_proto[i]);
+        if (JS_IsException(ctx->native_error_proto[i]))
+            goto done;
+    }
+    ctx->global_obj = clone_value(s, tmpl->global_obj);
+    if (JS_IsException(ctx->global_obj))
+        goto done;
+
+    /* the list grows while the copied objects reference new ones */
+    for(i = 0; i < s->todo_len; i++) {
+        if (clone_object_fields(s, s->todo[i]))
+            goto done;
+    }
+    ret = 0;
+ done:
+    /* release the references held by the hash table */
+    if (s->hash) {
+        for(i = 0; i < s->hash_size; i++) {
+            e = &s->hash[i];
+            if (e->src)
+                JS_FreeValue(ctx, JS_MKPTR(JS_TAG_OBJECT, e->dst));
+        }
+    }
+    js_free(tmpl, s->hash);
+    js_free(tmpl, s->todo);
+    if (ret < 0) {
+        JS_FreeContext(ctx);
+        return NULL;
+    }
+    return ctx;
+}
@@ -2,13 +2,525 @@
 // Created by benpeng.jiang on 2021/5/22.
 //
 
-#include "qjs.h"
+#include <stdarg.h>
+#include <math.h>
+#include "context.h"
 
-#include "list.h"
-#include "qjs-runtime.h"
-#include "gc.h"
-struct JSContext {
-    JSGCObjectHeader header; /* must come first */
-    JSRuntime *rt;
-    struct list_head link;
+JSContext *JS_NewContextRaw(JSRuntime *rt)
+{
+    JSMemAccount *account;
+    JSContext *ctx;
+    int i;
+
+    account = js_new_account(rt);
+    if (!account)
+        return NULL;
+    ctx = js_malloc_account(rt, account, sizeof(JSContext));
+    if (!ctx) {
+        js_free_account(rt, account);
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    account->ctx = ctx;
+    ctx->mem_account = account;
+    ctx->header.ref_count = 1;
+    add_gc_object(rt, &ctx->header, JS_GC_OBJ_TYPE_JS_CONTEXT);
+
+    ctx->rt = rt;
+    list_add_tail(&ctx->link, &rt->context_list);
+    for(i = 0; i < JS_CLASS_INIT_COUNT; i++)
+        ctx->class_proto[i] = JS_NULL;
+    ctx->function_proto = JS_NULL;
+    for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++)
+        ctx->native_error_proto[i] = JS_NULL;
+    ctx->global_obj = JS_NULL;
+    return ctx;
+}
+
+JSContext *JS_NewContext(JSRuntime *rt)
+{
+    JSContext *ctx;
+
+    ctx = JS_NewContextRaw(rt);
+    if (!ctx)
+        return NULL;
+    JS_AddIntrinsicBaseObjects(ctx);
+    if (JS_IsException(ctx->global_obj)) {
+        JS_FreeContext(ctx);
+        return NULL;
+    }
+    JS_AddIntrinsicTypedArrays(ctx);
+    return ctx;
+}
+
+JSContext *JS_DupContext(JSContext *ctx)
+{
+    ctx->header.ref_count++;
+    return ctx;
+}
+
+void JS_MarkContext(JSRuntime *rt, JSContext *ctx, JS_MarkFunc *mark_func)
+{
+    int i;
+
+    for(i = 0; i < JS_CLASS_INIT_COUNT; i++)
+        JS_MarkValue(rt, ctx->class_proto[i], mark_func);
+    JS_MarkValue(rt, ctx->function_proto, mark_func);
+    for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++)
+        JS_MarkValue(rt, ctx->native_error_proto[i], mark_func);
+    JS_MarkValue(rt, ctx->global_obj, mark_func);
+}
+
+void JS_FreeContext(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+    JSMemAccount *account = ctx->mem_account;
+    int i;
+
+    if (--ctx->header.ref_count > 0)
+        return;
+    assert(ctx->header.ref_count == 0);
+
+    for(i = 0; i < JS_CLASS_INIT_COUNT; i++)
+        JS_FreeValue(ctx, ctx->class_proto[i]);
+    JS_FreeValue(ctx, ctx->function_proto);
+    for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++)
+        JS_FreeValue(ctx, ctx->native_error_proto[i]);
+    JS_FreeValue(ctx, ctx->global_obj);
+
+    list_del(&ctx->link);
+    remove_gc_object(&ctx->header);
+    js_free_rt(rt, ctx);
+
+    /* the blocks still charged to the context keep its account */
+    account->ctx = NULL;
+    if (rt->malloc_account == account)
+        rt->malloc_account = NULL;
+    if (account->malloc_count == 0)
+        js_free_account(rt, account);
+}
+
+void JS_SetContextMemoryLimit(JSContext *ctx, size_t limit)
+{
+    JSMemAccount *account = ctx->mem_account;
+
+    account->malloc_limit = limit;
+    js_account_update_gc_threshold(account);
+}
+
+void JS_ComputeContextMemoryUsage(JSContext *ctx, JSContextMemoryUsage *s)
+{
+    JSMemAccount *account = ctx->mem_account;
+
+    s->malloc_count = account->malloc_count;
+    s->malloc_size = account->malloc_size;
+    s->malloc_limit = account->malloc_limit;
+}
+
+JSRuntime *JS_GetRuntime(JSContext *ctx)
+{
+    return ctx->rt;
+}
+
+JSValue JS_GetGlobalObject(JSContext *ctx)
+{
+    return JS_DupValue(ctx, ctx->global_obj);
+}
+
+/* exceptions */
+
+JSValue JS_Throw(JSContext *ctx, JSValue obj)
+{
+    JSRuntime *rt = ctx->rt;
+    JS_FreeValue(ctx, rt->current_exception);
+    rt->current_exception = obj;
+    return JS_EXCEPTION;
+}
+
+/* return the pending exception (cannot be called twice). */
+JSValue JS_GetException(JSContext *ctx)
+{
+    JSValue val;
+    JSRuntime *rt = ctx->rt;
+    val = rt->current_exception;
+    rt->current_exception = JS_NULL;
+    return val;
+}
+
+JSValue JS_ThrowError(JSContext *ctx, JSErrorEnum error_num,
+                      const char *fmt, va_list ap)
+{
+    char buf[256];
+    JSValue obj;
+
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    obj = JS_NewObjectProtoClass(ctx, ctx->native_error_proto[error_num],
+                                 JS_CLASS_ERROR);
+    if (unlikely(JS_IsException(obj))) {
+        /* out of memory: throw JS_NULL to avoid recursing */
+        obj = JS_NULL;
+    } else {
+        JS_DefinePropertyValue(ctx, obj, JS_ATOM_message,
+                               JS_NewString(ctx, buf),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+    return JS_Throw(ctx, obj);
+}
+
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowSyntaxError(JSContext *ctx, const char *fmt, ...)
+{
+    JSValue val;
+    va_list ap;
+
+    va_start(ap, fmt);
+    val = JS_ThrowError(ctx, JS_SYNTAX_ERROR, fmt, ap);
+    va_end(ap);
+    return val;
+}
+
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowTypeError(JSContext *ctx, const char *fmt, ...)
+{
+    JSValue val;
+    va_list ap;
+
+    va_start(ap, fmt);
+    val = JS_ThrowError(ctx, JS_TYPE_ERROR, fmt, ap);
+    va_end(ap);
+    return val;
+}
+
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowReferenceError(JSContext *ctx, const char *fmt, ...)
+{
+    JSValue val;
+    va_list ap;
+
+    va_start(ap, fmt);
+    val = JS_ThrowError(ctx, JS_REFERENCE_ERROR, fmt, ap);
+    va_end(ap);
+    return val;
+}
+
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowRangeError(JSContext *ctx, const char *fmt, ...)
+{
+    JSValue val;
+    va_list ap;
+
+    va_start(ap, fmt);
+    val = JS_ThrowError(ctx, JS_RANGE_ERROR, fmt, ap);
+    va_end(ap);
+    return val;
+}
+
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowInternalError(JSContext *ctx, const char *fmt, ...)
+{
+    JSValue val;
+    va_list ap;
+
+    va_start(ap, fmt);
+    val = JS_ThrowError(ctx, JS_INTERNAL_ERROR, fmt, ap);
+    va_end(ap);
+    return val;
+}
+
+JSValue JS_ThrowOutOfMemory(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+    if (!rt->in_out_of_memory) {
+        rt->in_out_of_memory = TRUE;
+        JS_ThrowInternalError(ctx, "out of memory");
+        rt->in_out_of_memory = FALSE;
+    }
+    return JS_EXCEPTION;
+}
+
+JSValue JS_ThrowTypeErrorAtom(JSContext *ctx, const char *fmt, JSAtom atom)
+{
+    char buf[64];
+    return JS_ThrowTypeError(ctx, fmt, JS_AtomGetStr(ctx, buf, sizeof(buf), atom));
+}
+
+/* Object */
+
+static JSValue js_object_constructor(JSContext *ctx, JSValueConst new_target,
+                                     int argc, JSValueConst *argv)
+{
+    if (JS_IsObject(argv[0]))
+        return JS_DupValue(ctx, argv[0]);
+    if (JS_IsNull(argv[0]) || JS_IsUndefined(argv[0]))
+        return js_create_from_ctor(ctx, new_target, JS_CLASS_OBJECT);
+    /* no primitive wrapper objects yet */
+    return JS_ThrowTypeError(ctx, "cannot convert to object");
+}
+
+static JSValue js_object_getPrototypeOf(JSContext *ctx, JSValueConst this_val,
+                                        int argc, JSValueConst *argv)
+{
+    if (!JS_IsObject(argv[0]))
+        return JS_ThrowTypeError(ctx, "not an object");
+    return JS_GetPrototype(ctx, argv[0]);
+}
+
+static JSValue js_object_toString(JSContext *ctx, JSValueConst this_val,
+                                  int argc, JSValueConst *argv)
+{
+    if (JS_IsNull(this_val))
+        return JS_NewString(ctx, "[object Null]");
+    if (JS_IsUndefined(this_val))
+        return JS_NewString(ctx, "[object Undefined]");
+    if (JS_IsFunction(ctx, this_val))
+        return JS_NewString(ctx, "[object Function]");
+    if (JS_IsError(ctx, this_val))
+        return JS_NewString(ctx, "[object Error]");
+    if (JS_IsObject(this_val) &&
+        JS_VALUE_GET_OBJ(this_val)->class_id == JS_CLASS_ARRAY)
+        return JS_NewString(ctx, "[object Array]");
+    return JS_NewString(ctx, "[object Object]");
+}
+
+static JSValue js_object_valueOf(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv)
+{
+    if (!JS_IsObject(this_val))
+        return JS_ThrowTypeError(ctx, "not an object");
+    return JS_DupValue(ctx, this_val);
+}
+
+static JSValue js_object_hasOwnProperty(JSContext *ctx, JSValueConst this_val,
+                                        int argc, JSValueConst *argv)
+{
+    JSObject *p;
+    JSProperty *pr;
+    JSAtom atom;
+    BOOL ret;
+
+    atom = JS_ValueToAtom(ctx, argv[0]);
+    if (unlikely(atom == JS_ATOM_NULL))
+        return JS_EXCEPTION;
+    if (!JS_IsObject(this_val)) {
+        JS_FreeAtom(ctx, atom);
+        return JS_ThrowTypeError(ctx, "not an object");
+    }
+    p = JS_VALUE_GET_OBJ(this_val);
+    ret = (p->fast_array && js_fast_array_has(p, atom)) ||
+        find_own_property(&pr, p, atom) != NULL;
+    JS_FreeAtom(ctx, atom);
+    return JS_NewBool(ctx, ret);
+}
+
+static const JSCFunctionListEntry js_object_funcs[] = {
+    JS_CFUNC_DEF("getPrototypeOf", 1, js_object_getPrototypeOf ),
+};
+
+static const JSCFunctionListEntry js_object_proto_funcs[] = {
+    JS_CFUNC_DEF("toString", 0, js_object_toString ),
+    JS_CFUNC_DEF("valueOf", 0, js_object_valueOf ),
+    JS_CFUNC_DEF("hasOwnProperty", 1, js_object_hasOwnProperty ),
+};
+
+/* Function */
+
+static JSValue js_function_proto(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv)
+{
+    return JS_UNDEFINED;
+}
+
+static JSValue js_function_proto_call(JSContext *ctx, JSValueConst this_val,
+                                      int argc, JSValueConst *argv)
+{
+    if (argc <= 0)
+        return JS_Call(ctx, this_val, JS_UNDEFINED, 0, NULL);
+    return JS_Call(ctx, this_val, argv[0], argc - 1, argv + 1);
+}
+
+static const JSCFunctionListEntry js_function_proto_funcs[] = {
+    JS_CFUNC_DEF("call", 1, js_function_proto_call ),
+};
+
+/* Error */
+
+/* magic = -1 for Error, the JSErrorEnum index for the native errors */
+static JSValue js_error_constructor(JSContext *ctx, JSValueConst new_target,
+                                    int argc, JSValueConst *argv, int magic)
+{
+    JSValue obj, msg, proto;
+
+    if (JS_IsUndefined(new_target)) {
+        if (magic < 0)
+            proto = JS_DupValue(ctx, ctx->class_proto[JS_CLASS_ERROR]);
+        else
+            proto = JS_DupValue(ctx, ctx->native_error_proto[magic]);
+    } else {
+        proto = JS_GetProperty(ctx, new_target, JS_ATOM_prototype);
+        if (JS_IsException(proto))
+            return proto;
+    }
+    obj = JS_NewObjectProtoClass(ctx, proto, JS_CLASS_ERROR);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(obj))
+        return obj;
+    if (!JS_IsUndefined(argv[0])) {
+        msg = JS_ToString(ctx, argv[0]);
+        if (unlikely(JS_IsException(msg)))
+            goto exception;
+        if (JS_DefinePropertyValue(ctx, obj, JS_ATOM_message, msg,
+                                   JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE) < 0)
+            goto exception;
+    }
+    return obj;
+ exception:
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+static JSValue js_error_toString(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv)
+{
+    JSValue name, msg, val;
+
+    if (!JS_IsObject(this_val))
+        return JS_ThrowTypeError(ctx, "not an object");
+    val = JS_GetProperty(ctx, this_val, JS_ATOM_name);
+    if (JS_IsUndefined(val))
+        name = JS_AtomToString(ctx, JS_ATOM_Error);
+    else
+        name = JS_ToString(ctx, val);
+    JS_FreeValue(ctx, val);
+    if (JS_IsException(name))
+        return JS_EXCEPTION;
+
+    val = JS_GetProperty(ctx, this_val, JS_ATOM_message);
+    if (JS_IsUndefined(val))
+        msg = JS_AtomToString(ctx, JS_ATOM_empty_string);
+    else
+        msg = JS_ToString(ctx, val);
+    JS_FreeValue(ctx, val);
+    if (JS_IsException(msg)) {
+        JS_FreeValue(ctx, name);
+        return JS_EXCEPTION;
+    }
+    if (JS_VALUE_GET_STRING(name)->len != 0 &&
+        JS_VALUE_GET_STRING(msg)->len != 0) {
+        name = JS_ConcatStrings(ctx, name, JS_NewString(ctx, ": "));
+        if (JS_IsException(name)) {
+            JS_FreeValue(ctx, msg);
+            return JS_EXCEPTION;
+        }
+    }
+    return JS_ConcatStrings(ctx, name, msg);
+}
+
+static const JSCFunctionListEntry js_error_proto_funcs[] = {
+    JS_CFUNC_DEF("toString", 0, js_error_toString ),
 };
+
+static const JSCFunctionListEntry js_generator_proto_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("next", 1, js_generator_next, JS_GENERATOR_NEXT ),
+    JS_CFUNC_MAGIC_DEF("return", 1, js_generator_next, JS_GENERATOR_RETURN ),
+    JS_CFUNC_MAGIC_DEF("throw", 1, js_generator_next, JS_GENERATOR_THROW ),
+};
+
+static void JS_AddIntrinsicBasicObjects(JSContext *ctx)
+{
+    JSValue proto;
+
+    /* Object.prototype has a null prototype */
+    proto = JS_NewObjectProto(ctx, JS_NULL);
+    ctx->class_proto[JS_CLASS_OBJECT] = proto;
+    /* Function.prototype is itself a function */
+    ctx->function_proto = js_new_cfunction_proto(ctx, js_function_proto, "", 0,
+                                                 JS_CFUNC_generic, 0, proto);
+    ctx->class_proto[JS_CLASS_C_FUNCTION] = JS_DupValue(ctx, ctx->function_proto);
+    ctx->class_proto[JS_CLASS_BYTECODE_FUNCTION] = JS_DupValue(ctx, ctx->function_proto);
+    ctx->class_proto[JS_CLASS_ERROR] = JS_NewObject(ctx);
+    /* XXX: no Array constructor and no Array.prototype methods yet */
+    ctx->class_proto[JS_CLASS_ARRAY] = JS_NewObject(ctx);
+    ctx->class_proto[JS_CLASS_GENERATOR] = JS_NewObject(ctx);
+}
+
+void JS_AddIntrinsicBaseObjects(JSContext *ctx)
+{
+    JSValue obj, proto, error_ctor, ctor;
+    JSCFunctionType ft;
+    int i;
+
+    JS_AddIntrinsicBasicObjects(ctx);
+    ctx->global_obj = JS_NewObject(ctx);
+    if (JS_IsException(ctx->global_obj))
+        return;
+
+    /* Object */
+    obj = JS_NewCFunction2(ctx, js_object_constructor, "Object", 1,
+                           JS_CFUNC_constructor, 0);
+    JS_SetPropertyFunctionList(ctx, obj, js_object_funcs,
+                               countof(js_object_funcs));
+    JS_SetPropertyFunctionList(ctx, ctx->class_proto[JS_CLASS_OBJECT],
+                               js_object_proto_funcs,
+                               countof(js_object_proto_funcs));
+    JS_SetConstructor(ctx, obj, ctx->class_proto[JS_CLASS_OBJECT]);
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_Object, obj,
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+
+    /* Function */
+    JS_SetPropertyFunctionList(ctx, ctx->function_proto,
+                               js_function_proto_funcs,
+                               countof(js_function_proto_funcs));
+
+    /* Error */
+    JS_SetPropertyFunctionList(ctx, ctx->class_proto[JS_CLASS_ERROR],
+                               js_error_proto_funcs,
+                               countof(js_error_proto_funcs));
+    JS_DefinePropertyValue(ctx, ctx->class_proto[JS_CLASS_ERROR], JS_ATOM_name,
+                           JS_AtomToString(ctx, JS_ATOM_Error),
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    JS_DefinePropertyValue(ctx, ctx->class_proto[JS_CLASS_ERROR], JS_ATOM_message,
+                           JS_AtomToString(ctx, JS_ATOM_empty_string),
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    /* the constructor takes a magic argument: go through the union
+       instead of casting between incompatible function types */
+    ft.generic_magic = js_error_constructor;
+    error_ctor = JS_NewCFunction2(ctx, ft.generic,
+                                  "Error", 1, JS_CFUNC_constructor_magic, -1);
+    JS_SetConstructor(ctx, error_ctor, ctx->class_proto[JS_CLASS_ERROR]);
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_Error, error_ctor,
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+
+    /* XXX: no GeneratorFunction and no %GeneratorPrototype% chain: the
+       generator objects all share this prototype */
+    JS_SetPropertyFunctionList(ctx, ctx->class_proto[JS_CLASS_GENERATOR],
+                               js_generator_proto_funcs,
+                               countof(js_generator_proto_funcs));
+
+    /* the native error constructors inherit from Error */
+    for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++) {
+        JSAtom name = JS_ATOM_RangeError + i;
+        char buf[64];
+
+        proto = JS_NewObjectProto(ctx, ctx->class_proto[JS_CLASS_ERROR]);
+        JS_DefinePropertyValue(ctx, proto, JS_ATOM_name,
+                               JS_AtomToString(ctx, name),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+        JS_DefinePropertyValue(ctx, proto, JS_ATOM_message,
+                               JS_AtomToString(ctx, JS_ATOM_empty_string),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+        ctx->native_error_proto[i] = proto;
+        ctor = js_new_cfunction_proto(ctx, ft.generic,
+                                      JS_AtomGetStr(ctx, buf, sizeof(buf), name),
+                                      1, JS_CFUNC_constructor_magic, i,
+                                      error_ctor);
+        JS_SetConstructor(ctx, ctor, proto);
+        JS_DefinePropertyValue(ctx, ctx->global_obj, name, ctor,
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_globalThis,
+                           JS_DupValue(ctx, ctx->global_obj),
+                           JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+
+    /* the value properties of the global object are read-only */
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_undefined,
+                           JS_UNDEFINED, 0);
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_NaN, JS_NAN, 0);
+    JS_DefinePropertyValue(ctx, ctx->global_obj, JS_ATOM_Infinity,
+                           JS_NewFloat64(ctx, INFINITY), 0);
+}
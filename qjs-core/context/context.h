@@ -0,0 +1,118 @@
+#ifndef QJS_CONTEXT_H
+#define QJS_CONTEXT_H
+#include <stdarg.h>
+#include "object.h"
+
+typedef enum JSErrorEnum {
+    JS_RANGE_ERROR,
+    JS_REFERENCE_ERROR,
+    JS_SYNTAX_ERROR,
+    JS_TYPE_ERROR,
+    JS_INTERNAL_ERROR,
+
+    JS_NATIVE_ERROR_COUNT, /* number of different NativeError objects */
+} JSErrorEnum;
+
+struct JSContext {
+    JSGCObjectHeader header; /* must come first */
+    JSRuntime *rt;
+    struct list_head link;
+
+    JSValue class_proto[JS_CLASS_INIT_COUNT];
+    JSValue function_proto;
+    JSValue native_error_proto[JS_NATIVE_ERROR_COUNT];
+    JSValue global_obj; /* global object */
+
+    JSMemAccount *mem_account; /* memory charged to the context */
+};
+
+static inline void *js_malloc(JSContext *ctx, size_t size)
+{
+    void *ptr;
+    ptr = js_malloc_account(ctx->rt, ctx->mem_account, size);
+    if (unlikely(!ptr)) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    return ptr;
+}
+
+static inline void *js_mallocz(JSContext *ctx, size_t size)
+{
+    void *ptr;
+    ptr = js_malloc(ctx, size);
+    if (unlikely(!ptr))
+        return NULL;
+    return memset(ptr, 0, size);
+}
+
+static inline void *js_realloc(JSContext *ctx, void *ptr, size_t size)
+{
+    void *ret;
+    ret = js_realloc_account(ctx->rt, ctx->mem_account, ptr, size);
+    if (unlikely(!ret && size != 0)) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    return ret;
+}
+
+static inline void js_free(JSContext *ctx, void *ptr)
+{
+    js_free_rt(ctx->rt, ptr);
+}
+
+/* block without account header, freed by js_free_gc_rt() with the id
+   of ctx->mem_account */
+static inline void *js_malloc_gc(JSContext *ctx, size_t size)
+{
+    void *ptr;
+    ptr = js_malloc_gc_rt(ctx->rt, ctx->mem_account, size);
+    if (unlikely(!ptr)) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    return ptr;
+}
+
+static inline void *js_mallocz_gc(JSContext *ctx, size_t size)
+{
+    void *ptr;
+    ptr = js_malloc_gc(ctx, size);
+    if (unlikely(!ptr))
+        return NULL;
+    return memset(ptr, 0, size);
+}
+
+/* called at the function calls (and at the backward branches of the
+   interpreter). Return -1 if the script must stop: the exception is
+   then set. */
+static inline int js_poll_interrupts(JSContext *ctx)
+{
+    if (unlikely(--ctx->rt->interrupt_counter <= 0))
+        return __js_poll_interrupts(ctx);
+    return 0;
+}
+
+/* context without the intrinsic objects */
+JSContext *JS_NewContextRaw(JSRuntime *rt);
+/* mark the values referenced by the context */
+void JS_MarkContext(JSRuntime *rt, JSContext *ctx, JS_MarkFunc *mark_func);
+void JS_AddIntrinsicBaseObjects(JSContext *ctx);
+/* ArrayBuffer, the typed arrays and DataView (see typedarray.c) */
+void JS_AddIntrinsicTypedArrays(JSContext *ctx);
+JSValue JS_ThrowError(JSContext *ctx, JSErrorEnum error_num,
+                      const char *fmt, va_list ap);
+JSValue JS_ThrowTypeErrorAtom(JSContext *ctx, const char *fmt, JSAtom atom);
+
+/* conversions (see conversion.c) */
+#define HINT_STRING  0
+#define HINT_NUMBER  1
+#define HINT_NONE    2
+JSValue JS_ToPrimitive(JSContext *ctx, JSValueConst val, int hint);
+/* return an int32 or float64 value, or JS_EXCEPTION */
+JSValue JS_ToNumber(JSContext *ctx, JSValueConst val);
+/* ToInt32 of a number */
+int32_t js_double_to_int32(double d);
+
+#endif //QJS_CONTEXT_H
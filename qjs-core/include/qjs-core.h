@@ -4,7 +4,285 @@
 
 #ifndef TUTORIAL_QJS_CORE_H
 #define TUTORIAL_QJS_CORE_H
-typedef struct JSContext JSContext;
+#include <stddef.h>
+#include "qjs-runtime.h"
+#include "qjs-value.h"
 
+#define JS_ATOM_NULL 0
+
+/* flags for object properties */
+#define JS_PROP_CONFIGURABLE  (1 << 0)
+#define JS_PROP_WRITABLE      (1 << 1)
+#define JS_PROP_ENUMERABLE    (1 << 2)
+#define JS_PROP_C_W_E         (JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE | JS_PROP_ENUMERABLE)
+
+/* throw an exception if false would be returned */
+#define JS_PROP_THROW            (1 << 14)
+
+typedef JSValue JSCFunction(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+typedef JSValue JSCFunctionMagic(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic);
+
+/* C function prototypes. The constructors receive new_target as
+   this_val and undefined when called as a function. */
+typedef enum JSCFunctionEnum {
+    JS_CFUNC_generic,
+    JS_CFUNC_generic_magic,
+    JS_CFUNC_constructor,
+    JS_CFUNC_constructor_magic,
+} JSCFunctionEnum;
+
+/* context */
+
+JSContext *JS_NewContext(JSRuntime *rt);
+/* Create a context sharing the initial state of 'tmpl' (a context used
+   as a template). The clone is isolated from the template and from the
+   other clones: the objects reachable from the template globals are
+   copied, the shapes and the strings are shared. Return NULL if error
+   (the exception is then set in tmpl). */
+JSContext *JS_CloneContext(JSContext *tmpl);
+void JS_FreeContext(JSContext *ctx);
+JSContext *JS_DupContext(JSContext *ctx);
+JSRuntime *JS_GetRuntime(JSContext *ctx);
+JSValue JS_GetGlobalObject(JSContext *ctx);
+
+/* per context memory. The blocks allocated for a context (its objects
+   and strings, and the atoms and shapes created while it runs) are
+   charged to it until they are freed, even by another context. The
+   shared atoms and shapes are charged to the context which created
+   them. */
+typedef struct JSContextMemoryUsage {
+    int64_t malloc_count, malloc_size, malloc_limit;
+} JSContextMemoryUsage;
+
+/* the allocations exceeding 'limit' bytes throw an out of memory
+   error in the context ((size_t)-1 = no limit) */
+void JS_SetContextMemoryLimit(JSContext *ctx, size_t limit);
+void JS_ComputeContextMemoryUsage(JSContext *ctx, JSContextMemoryUsage *s);
+
+/* atoms */
+
+JSAtom JS_NewAtomLen(JSContext *ctx, const char *str, size_t len);
+JSAtom JS_NewAtom(JSContext *ctx, const char *str);
+JSAtom JS_NewAtomUInt32(JSContext *ctx, uint32_t n);
+JSAtom JS_DupAtom(JSContext *ctx, JSAtom v);
+void JS_FreeAtom(JSContext *ctx, JSAtom v);
+void JS_FreeAtomRT(JSRuntime *rt, JSAtom v);
+JSValue JS_AtomToString(JSContext *ctx, JSAtom atom);
+
+/* values */
+
+void __JS_FreeValue(JSContext *ctx, JSValue v);
+void __JS_FreeValueRT(JSRuntime *rt, JSValue v);
+
+static inline void JS_FreeValue(JSContext *ctx, JSValue v)
+{
+    if (JS_VALUE_HAS_REF_COUNT(v)) {
+        JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
+        if (--p->ref_count <= 0) {
+            __JS_FreeValue(ctx, v);
+        }
+    }
+}
+
+static inline void JS_FreeValueRT(JSRuntime *rt, JSValue v)
+{
+    if (JS_VALUE_HAS_REF_COUNT(v)) {
+        JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
+        if (--p->ref_count <= 0) {
+            __JS_FreeValueRT(rt, v);
+        }
+    }
+}
+
+static inline JSValue JS_DupValue(JSContext *ctx, JSValueConst v)
+{
+    if (JS_VALUE_HAS_REF_COUNT(v)) {
+        JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
+        p->ref_count++;
+    }
+    return (JSValue)v;
+}
+
+static inline JSValue JS_DupValueRT(JSRuntime *rt, JSValueConst v)
+{
+    if (JS_VALUE_HAS_REF_COUNT(v)) {
+        JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
+        p->ref_count++;
+    }
+    return (JSValue)v;
+}
+
+/* the conversions return -1 if exception */
+int JS_ToBool(JSContext *ctx, JSValueConst val);
+int JS_ToInt32(JSContext *ctx, int32_t *pres, JSValueConst val);
+int JS_ToFloat64(JSContext *ctx, double *pres, JSValueConst val);
+
+JSValue JS_NewStringLen(JSContext *ctx, const char *str1, size_t len1);
+JSValue JS_NewString(JSContext *ctx, const char *str);
+/* build a string from UTF-8 input received in chunks (e.g. from a pipe
+   or a socket). A chunk may end in the middle of a multi-byte
+   sequence, so the input never has to be buffered: only the decoded
+   string is kept. */
+typedef struct JSStringDecoder JSStringDecoder;
+JSStringDecoder *JS_NewStringDecoder(JSContext *ctx);
+/* Return -1 if exception */
+int JS_StringDecoderWrite(JSStringDecoder *d, const char *buf, size_t len);
+/* return the decoded string and free the decoder */
+JSValue JS_StringDecoderEnd(JSStringDecoder *d);
+void JS_FreeStringDecoder(JSStringDecoder *d);
+JSValue JS_ToString(JSContext *ctx, JSValueConst val);
+/* UTF-8 representation of JS_ToString(val), to be freed with
+   JS_FreeCString(). Return NULL if exception. */
+const char *JS_ToCStringLen(JSContext *ctx, size_t *plen, JSValueConst val);
+static inline const char *JS_ToCString(JSContext *ctx, JSValueConst val)
+{
+    return JS_ToCStringLen(ctx, NULL, val);
+}
+void JS_FreeCString(JSContext *ctx, const char *ptr);
+
+/* objects */
+
+JSValue JS_NewObject(JSContext *ctx);
+/* 'proto' is an object or null */
+JSValue JS_NewObjectProto(JSContext *ctx, JSValueConst proto);
+JSValue JS_NewError(JSContext *ctx);
+JSValue JS_GetPrototype(JSContext *ctx, JSValueConst val);
+int JS_IsFunction(JSContext *ctx, JSValueConst val);
+int JS_IsError(JSContext *ctx, JSValueConst val);
+/* TRUE if 'val' cannot be caught by the scripts, i.e. it was raised by
+   an interrupt (see JS_RequestInterrupt() and JS_SetCPUTimeLimit()) */
+int JS_IsUncatchableError(JSContext *ctx, JSValueConst val);
+
+JSValue JS_GetProperty(JSContext *ctx, JSValueConst obj, JSAtom prop);
+JSValue JS_GetPropertyStr(JSContext *ctx, JSValueConst this_obj,
+                          const char *prop);
+/* the Set and Define functions take ownership of 'val'. They return -1
+   if exception, FALSE or TRUE otherwise. */
+int JS_SetProperty(JSContext *ctx, JSValueConst this_obj,
+                   JSAtom prop, JSValue val);
+int JS_SetPropertyStr(JSContext *ctx, JSValueConst this_obj,
+                      const char *prop, JSValue val);
+int JS_HasProperty(JSContext *ctx, JSValueConst obj, JSAtom prop);
+int JS_DeleteProperty(JSContext *ctx, JSValueConst obj, JSAtom prop, int flags);
+int JS_DefinePropertyValue(JSContext *ctx, JSValueConst this_obj,
+                           JSAtom prop, JSValue val, int flags);
+int JS_DefinePropertyValueStr(JSContext *ctx, JSValueConst this_obj,
+                              const char *prop, JSValue val, int flags);
+
+/* functions */
+
+JSValue JS_NewCFunction2(JSContext *ctx, JSCFunction *func,
+                         const char *name,
+                         int length, JSCFunctionEnum cproto, int magic);
+static inline JSValue JS_NewCFunction(JSContext *ctx, JSCFunction *func,
+                                      const char *name, int length)
+{
+    return JS_NewCFunction2(ctx, func, name, length, JS_CFUNC_generic, 0);
+}
+static inline JSValue JS_NewCFunctionMagic(JSContext *ctx,
+                                           JSCFunctionMagic *func,
+                                           const char *name, int length,
+                                           JSCFunctionEnum cproto, int magic)
+{
+    /* no cast between incompatible function types */
+    union {
+        JSCFunction *generic;
+        JSCFunctionMagic *generic_magic;
+    } ft;
+    ft.generic_magic = func;
+    return JS_NewCFunction2(ctx, ft.generic, name, length, cproto, magic);
+}
+JSValue JS_Call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_obj,
+                int argc, JSValueConst *argv);
+JSValue JS_CallConstructor(JSContext *ctx, JSValueConst func_obj,
+                           int argc, JSValueConst *argv);
+
+/* binary data */
+
+typedef void JSFreeArrayBufferDataFunc(JSRuntime *rt, void *opaque, void *ptr);
+
+/* ArrayBuffer using the 'len' bytes of 'buf' without copying them.
+   free_func(rt, opaque, buf) is called when the ArrayBuffer is
+   collected; 'buf' is owned by the caller if free_func is NULL. It is
+   read and written in place by the typed arrays of the scripts. */
+JSValue JS_NewArrayBuffer(JSContext *ctx, uint8_t *buf, size_t len,
+                          JSFreeArrayBufferDataFunc *free_func, void *opaque);
+/* ArrayBuffer holding a copy of 'buf' */
+JSValue JS_NewArrayBufferCopy(JSContext *ctx, const uint8_t *buf, size_t len);
+/* return the data of the ArrayBuffer 'obj' and its length in *psize, or
+   NULL if exception */
+uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj);
+
+/* script evaluation */
+
+#define JS_EVAL_TYPE_GLOBAL   (0 << 0) /* global code (default) */
+#define JS_EVAL_TYPE_MASK     (3 << 0)
+
+#define JS_EVAL_FLAG_STRICT   (1 << 3) /* force 'strict' mode */
+/* compile but do not run. The result is the compiled function
+   (JS_TAG_FUNCTION_BYTECODE). */
+#define JS_EVAL_FLAG_COMPILE_ONLY (1 << 5)
+/* compile all the functions now. By default, only the top level code
+   and the function expressions in parentheses ("(function() {...})()")
+   are compiled at once: the other functions are only checked and are
+   compiled on their first call. */
+#define JS_EVAL_FLAG_EAGER    (1 << 6)
+
+/* 'input' must be zero terminated i.e. input[input_len] = '\0'. */
+JSValue JS_Eval(JSContext *ctx, const char *input, size_t input_len,
+                const char *filename, int eval_flags);
+/* run a function compiled with JS_EVAL_FLAG_COMPILE_ONLY or read with
+   JS_ReadObject(). 'fun_obj' is freed. */
+JSValue JS_EvalFunction(JSContext *ctx, JSValue fun_obj);
+
+/* object serialization. Only the primitive values and the compiled
+   functions are supported for now. */
+
+#define JS_WRITE_OBJ_BYTECODE (1 << 0) /* allow function bytecode */
+
+#define JS_READ_OBJ_BYTECODE  (1 << 0) /* allow function bytecode */
+/* the code is used in place from 'buf', which must stay valid and
+   unmodified until the objects are freed */
+#define JS_READ_OBJ_ROM_DATA  (1 << 1)
+
+/* Return a buffer to free with js_free_rt() or NULL if exception */
+uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
+                        int flags);
+JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                      int flags);
+
+/* jobs */
+
+typedef JSValue JSJobFunc(JSContext *ctx, int argc, JSValueConst *argv);
+/* queue a job running 'job_func' in the realm 'ctx'. 'argc' must be <=
+   5. The arguments are duplicated. Return -1 if exception. */
+int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func, int argc,
+                  JSValueConst *argv);
+int JS_IsJobPending(JSRuntime *rt);
+/* run one pending job. Return < 0 if exception, 0 if no job was
+   pending, 1 if a job was executed. In case of exception, *pctx holds
+   a reference to the context of the job which must be freed with
+   JS_FreeContext() once the exception is read. Otherwise *pctx is set
+   to NULL. */
+int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx);
+/* run at most 'max_jobs' pending jobs (no limit if <= 0), including
+   the jobs queued during the drain, and stop after 'budget_us'
+   microseconds (no limit if <= 0). Return the number of executed jobs
+   or < 0 if a job raised an exception (*pctx is then set as in
+   JS_ExecutePendingJob()). */
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, int64_t budget_us,
+                          JSContext **pctx);
+
+/* exceptions */
+
+JSValue JS_Throw(JSContext *ctx, JSValue obj);
+/* return the pending exception and clear it */
+JSValue JS_GetException(JSContext *ctx);
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowSyntaxError(JSContext *ctx, const char *fmt, ...);
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowTypeError(JSContext *ctx, const char *fmt, ...);
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowReferenceError(JSContext *ctx, const char *fmt, ...);
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowRangeError(JSContext *ctx, const char *fmt, ...);
+JSValue __attribute__((format(printf, 2, 3))) JS_ThrowInternalError(JSContext *ctx, const char *fmt, ...);
+JSValue JS_ThrowOutOfMemory(JSContext *ctx);
 
 #endif //TUTORIAL_QJS_CORE_H
@@ -6,6 +6,7 @@
 #define RUNTIME_H
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
 
 typedef struct JSRuntime JSRuntime;
 
@@ -20,6 +21,7 @@ typedef struct JSMemoryUsage {
     int64_t shape_count, shape_size;
     int64_t js_func_count, js_func_size, js_func_code_size;
     int64_t js_func_pc2line_count, js_func_pc2line_size;
+    int64_t jit_func_count, jit_code_size; /* machine code */
     int64_t c_func_count, array_count;
     int64_t fast_array_count, fast_array_elements;
     int64_t binary_object_count, binary_object_size;
@@ -36,12 +38,44 @@ typedef struct JSMemoryUsage_helper {
     int64_t js_func_code_size;
     int64_t js_func_pc2line_count;
     int64_t js_func_pc2line_size;
+    int64_t jit_func_count;
+    int64_t jit_code_size;
 } JSMemoryUsage_helper;
 
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s);
 void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt);
 
 JSRuntime *JS_NewRuntime(void);
+void JS_FreeRuntime(JSRuntime *rt);
+/* collect the reference cycles */
+void JS_RunGC(JSRuntime *rt);
+/* maximum C stack used by the scripts (0 = no limit). The stack top is
+   the stack pointer of the thread calling JS_NewRuntime(): call
+   JS_UpdateStackTop() to run the scripts from another thread. */
+void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
+void JS_UpdateStackTop(JSRuntime *rt);
+void *JS_GetRuntimeOpaque(JSRuntime *rt);
+void JS_SetRuntimeOpaque(JSRuntime *rt, void *opaque);
+
+/* interrupts. The poll points check a counter, so an interrupt is
+   delivered after at most JS_INTERRUPT_COUNTER_INIT polls. The running
+   script then stops with an InternalError "interrupted". */
+
+/* return != 0 to interrupt the running script */
+typedef int JSInterruptHandler(JSRuntime *rt, void *opaque);
+void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb,
+                            void *opaque);
+/* interrupt the script running in 'rt'. Can be called from any thread
+   (e.g. a watchdog). */
+void JS_RequestInterrupt(JSRuntime *rt);
+/* interrupt the scripts when the current thread has used 'limit_us'
+   more microseconds of CPU time (no limit if <= 0). It starts a new
+   budget (e.g. per request) and drops a pending JS_RequestInterrupt(). */
+void JS_SetCPUTimeLimit(JSRuntime *rt, int64_t limit_us);
+
+/* compile the hot functions to machine code (default). It has no
+   effect if the JIT is not supported by the target. */
+void JS_SetJITEnabled(JSRuntime *rt, int enabled);
 
 void *js_malloc_rt(JSRuntime *rt, size_t size);
 void js_free_rt(JSRuntime *rt, void *ptr);
@@ -0,0 +1,244 @@
+#ifndef QJS_VALUE_H
+#define QJS_VALUE_H
+#include <stdint.h>
+#include <math.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define js_force_inline       inline __attribute__((always_inline))
+#else
+#define js_force_inline  inline
+#endif
+
+typedef struct JSContext JSContext;
+typedef struct JSObject JSObject;
+typedef uint32_t JSAtom;
+
+enum {
+    /* all tags with a reference count are negative */
+    JS_TAG_FIRST       = -7, /* first negative tag */
+    JS_TAG_STRING      = -7,
+    JS_TAG_FUNCTION_BYTECODE = -2, /* used internally */
+    JS_TAG_OBJECT      = -1,
+
+    JS_TAG_INT         = 0,
+    JS_TAG_BOOL        = 1,
+    JS_TAG_NULL        = 2,
+    JS_TAG_UNDEFINED   = 3,
+    JS_TAG_UNINITIALIZED = 4,
+    JS_TAG_CATCH_OFFSET = 5,
+    JS_TAG_EXCEPTION   = 6,
+    JS_TAG_FLOAT64     = 7,
+    /* any larger tag is FLOAT64 if JS_NAN_BOXING */
+};
+
+typedef struct JSRefCountHeader {
+    int ref_count;
+} JSRefCountHeader;
+
+/* NaN boxing: a value is a 64-bit word on the 64-bit Linux targets,
+   whose user space pointers have at most 48 bits. The tag
+   (JS_TAG_x - JS_TAG_FIRST) is in the 16 upper bits and the payload
+   in the 48 lower bits. The doubles are offset so that their upper 16
+   bits are above the tags. It works because the NaNs are canonicalized.
+   Define CONFIG_NO_NAN_BOXING to use the (value, tag) structure. */
+#if !defined(CONFIG_NO_NAN_BOXING) && defined(__linux__) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#define JS_NAN_BOXING
+#endif
+
+#ifdef JS_NAN_BOXING
+
+typedef uint64_t JSValue;
+
+#define JS_VALUE_TAG_SHIFT 48
+#define JS_VALUE_PAYLOAD_MASK (((uint64_t)1 << JS_VALUE_TAG_SHIFT) - 1)
+#define JS_FLOAT64_TAG_ADDEND ((uint64_t)(JS_TAG_FLOAT64 - JS_TAG_FIRST) << JS_VALUE_TAG_SHIFT)
+#define JS_FLOAT64_NAN 0x7ff8000000000000
+
+/* JSValueConst marks the values which are not owned by the callee */
+#define JSValueConst JSValue
+
+#define JS_VALUE_GET_TAG(v) ((int32_t)((v) >> JS_VALUE_TAG_SHIFT) + JS_TAG_FIRST)
+/* same as JS_VALUE_GET_TAG, but return JS_TAG_FLOAT64 with NaN boxing */
+#define JS_VALUE_GET_NORM_TAG(v) JS_VALUE_GET_NORM_TAG1(JS_VALUE_GET_TAG(v))
+#define JS_VALUE_GET_INT(v) ((int32_t)(v))
+#define JS_VALUE_GET_BOOL(v) ((int32_t)(v))
+#define JS_VALUE_GET_PTR(v) ((void *)(intptr_t)((v) & JS_VALUE_PAYLOAD_MASK))
+
+#define JS_MKVAL(tag, val) (((uint64_t)((tag) - JS_TAG_FIRST) << JS_VALUE_TAG_SHIFT) | (uint32_t)(val))
+#define JS_MKPTR(tag, p) (((uint64_t)((tag) - JS_TAG_FIRST) << JS_VALUE_TAG_SHIFT) | (uintptr_t)(p))
+
+#define JS_TAG_IS_FLOAT64(tag) ((int32_t)(tag) >= JS_TAG_FLOAT64)
+
+#define JS_NAN (JS_FLOAT64_NAN + JS_FLOAT64_TAG_ADDEND)
+
+/* the tests on the upper bits avoid computing the tags */
+#define JS_VALUE_INT_HI32 ((uint32_t)(JS_TAG_INT - JS_TAG_FIRST) << (JS_VALUE_TAG_SHIFT - 32))
+#define JS_VALUE_IS_BOTH_INT(v1, v2) ((((uint32_t)((v1) >> 32) ^ JS_VALUE_INT_HI32) | \
+                                       ((uint32_t)((v2) >> 32) ^ JS_VALUE_INT_HI32)) == 0)
+#define JS_VALUE_IS_BOTH_FLOAT(v1, v2) (((v1) >= JS_FLOAT64_TAG_ADDEND) & ((v2) >= JS_FLOAT64_TAG_ADDEND))
+#define JS_VALUE_HAS_REF_COUNT(v) ((v) < ((uint64_t)(0 - JS_TAG_FIRST) << JS_VALUE_TAG_SHIFT))
+
+static inline int32_t JS_VALUE_GET_NORM_TAG1(int32_t tag)
+{
+    return JS_TAG_IS_FLOAT64(tag) ? JS_TAG_FLOAT64 : tag;
+}
+
+static inline double JS_VALUE_GET_FLOAT64(JSValue v)
+{
+    union {
+        JSValue v;
+        double d;
+    } u;
+    u.v = v - JS_FLOAT64_TAG_ADDEND;
+    return u.d;
+}
+
+static inline JSValue __JS_NewFloat64(JSContext *ctx, double d)
+{
+    union {
+        double d;
+        uint64_t u64;
+    } u;
+    JSValue v;
+    u.d = d;
+    /* normalize NaN */
+    if (__builtin_expect((u.u64 & 0x7fffffffffffffff) > 0x7ff0000000000000, 0))
+        v = JS_NAN;
+    else
+        v = u.u64 + JS_FLOAT64_TAG_ADDEND;
+    return v;
+}
+
+#else /* !JS_NAN_BOXING */
+
+typedef union JSValueUnion {
+    int32_t int32;
+    double float64;
+    void *ptr;
+} JSValueUnion;
+
+typedef struct JSValue {
+    JSValueUnion u;
+    int64_t tag;
+} JSValue;
+
+/* JSValueConst marks the values which are not owned by the callee */
+#define JSValueConst JSValue
+
+#define JS_VALUE_GET_TAG(v) ((int32_t)(v).tag)
+/* same as JS_VALUE_GET_TAG, but return JS_TAG_FLOAT64 with NaN boxing */
+#define JS_VALUE_GET_NORM_TAG(v) JS_VALUE_GET_TAG(v)
+#define JS_VALUE_GET_INT(v) ((v).u.int32)
+#define JS_VALUE_GET_BOOL(v) ((v).u.int32)
+#define JS_VALUE_GET_FLOAT64(v) ((v).u.float64)
+#define JS_VALUE_GET_PTR(v) ((v).u.ptr)
+
+#define JS_MKVAL(tag, val) (JSValue){ (JSValueUnion){ .int32 = val }, tag }
+#define JS_MKPTR(tag, p) (JSValue){ (JSValueUnion){ .ptr = p }, tag }
+
+#define JS_TAG_IS_FLOAT64(tag) ((unsigned)(tag) == JS_TAG_FLOAT64)
+
+#define JS_NAN (JSValue){ .u.float64 = NAN, JS_TAG_FLOAT64 }
+
+#define JS_VALUE_IS_BOTH_INT(v1, v2) ((JS_VALUE_GET_TAG(v1) | JS_VALUE_GET_TAG(v2)) == 0)
+#define JS_VALUE_IS_BOTH_FLOAT(v1, v2) (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(v1)) && JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(v2)))
+#define JS_VALUE_HAS_REF_COUNT(v) ((unsigned)JS_VALUE_GET_TAG(v) >= (unsigned)JS_TAG_FIRST)
+
+static inline JSValue __JS_NewFloat64(JSContext *ctx, double d)
+{
+    JSValue v;
+    v.tag = JS_TAG_FLOAT64;
+    v.u.float64 = d;
+    return v;
+}
+
+#endif /* !JS_NAN_BOXING */
+
+#define JS_VALUE_GET_OBJ(v) ((JSObject *)JS_VALUE_GET_PTR(v))
+
+/* special values */
+#define JS_NULL      JS_MKVAL(JS_TAG_NULL, 0)
+#define JS_UNDEFINED JS_MKVAL(JS_TAG_UNDEFINED, 0)
+#define JS_FALSE     JS_MKVAL(JS_TAG_BOOL, 0)
+#define JS_TRUE      JS_MKVAL(JS_TAG_BOOL, 1)
+#define JS_EXCEPTION JS_MKVAL(JS_TAG_EXCEPTION, 0)
+#define JS_UNINITIALIZED JS_MKVAL(JS_TAG_UNINITIALIZED, 0)
+
+static js_force_inline JSValue JS_NewBool(JSContext *ctx, int val)
+{
+    return JS_MKVAL(JS_TAG_BOOL, (val != 0));
+}
+
+static js_force_inline JSValue JS_NewInt32(JSContext *ctx, int32_t val)
+{
+    return JS_MKVAL(JS_TAG_INT, val);
+}
+
+static js_force_inline JSValue JS_NewFloat64(JSContext *ctx, double d)
+{
+    return __JS_NewFloat64(ctx, d);
+}
+
+/* return an integer value when 'd' is an int32 (but not -0) */
+static inline JSValue JS_NewNumber(JSContext *ctx, double d)
+{
+    int32_t val;
+    union {
+        double d;
+        uint64_t u;
+    } u, t;
+    if (d >= INT32_MIN && d <= INT32_MAX) {
+        u.d = d;
+        val = (int32_t)d;
+        t.d = val;
+        /* -0 cannot be represented as integer, so we compare the bit
+           representation */
+        if (u.u == t.u)
+            return JS_MKVAL(JS_TAG_INT, val);
+    }
+    return __JS_NewFloat64(ctx, d);
+}
+
+static inline int JS_IsNumber(JSValueConst v)
+{
+    int tag = JS_VALUE_GET_TAG(v);
+    return tag == JS_TAG_INT || JS_TAG_IS_FLOAT64(tag);
+}
+
+static inline int JS_IsBool(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_BOOL;
+}
+
+static inline int JS_IsNull(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_NULL;
+}
+
+static inline int JS_IsUndefined(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_UNDEFINED;
+}
+
+static inline int JS_IsException(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_EXCEPTION;
+}
+
+static inline int JS_IsUninitialized(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_UNINITIALIZED;
+}
+
+static inline int JS_IsString(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_STRING;
+}
+
+static inline int JS_IsObject(JSValueConst v)
+{
+    return JS_VALUE_GET_TAG(v) == JS_TAG_OBJECT;
+}
+
+#endif //QJS_VALUE_H
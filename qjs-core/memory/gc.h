@@ -6,10 +6,9 @@
 #define QJS_GC_H
 #include <stdint.h>
 #include "list.h"
-
-typedef struct JSRefCountHeader {
-    int ref_count;
-} JSRefCountHeader;
+#include "qjs-value.h"
+#include "qjs-runtime.h"
+#include "jmemory.h"
 
 typedef enum {
     JS_GC_OBJ_TYPE_JS_OBJECT,
@@ -28,10 +27,43 @@ struct JSGCObjectHeader {
     JSGCObjectTypeEnum gc_obj_type : 4;
     uint8_t mark : 4; /* used by the GC */
     uint8_t dummy1; /* not used by the GC */
-    uint16_t dummy2; /* not used by the GC */
+    /* JSMemAccount.id of the objects and the function bytecodes. Not
+       used by the GC */
+    uint16_t account_id;
     struct list_head link;
 };
 
 typedef struct JSGCObjectHeader JSGCObjectHeader;
 
+typedef enum JSGCPhaseEnum {
+    JS_GC_PHASE_NONE,
+    JS_GC_PHASE_DECREF,
+    JS_GC_PHASE_REMOVE_CYCLES,
+} JSGCPhaseEnum;
+
+typedef void JS_MarkFunc(JSRuntime *rt, JSGCObjectHeader *gp);
+
+static inline void JS_MarkValue(JSRuntime *rt, JSValueConst val,
+                                JS_MarkFunc *mark_func)
+{
+    if (JS_VALUE_HAS_REF_COUNT(val)) {
+        switch(JS_VALUE_GET_TAG(val)) {
+        case JS_TAG_OBJECT:
+        case JS_TAG_FUNCTION_BYTECODE:
+            mark_func(rt, JS_VALUE_GET_PTR(val));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h,
+                   JSGCObjectTypeEnum type);
+void remove_gc_object(JSGCObjectHeader *h);
+/* run the cycle collector if enough memory was allocated since the
+   last run, or if 'account' (may be NULL) is close to its limit */
+void js_trigger_gc(JSRuntime *rt, JSMemAccount *account, size_t size);
+void js_account_update_gc_threshold(JSMemAccount *account);
+
 #endif //QJS_GC_H
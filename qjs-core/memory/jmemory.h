@@ -6,6 +6,7 @@
 #define QJS_MEMORY_H
 #include "cutils.h"
 #include <assert.h>
+#include <stddef.h>
 #include "qjs-runtime.h"
 
 #if defined(__APPLE__)
@@ -27,6 +28,35 @@ typedef struct JSMallocState {
     void *opaque; /* user opaque */
 } JSMallocState;
 
+/* memory charged to a context. It is freed with its context, or later
+   when the last block charged to it is freed. */
+typedef struct JSMemAccount {
+    size_t malloc_count;
+    size_t malloc_size;
+    size_t malloc_limit;
+    size_t gc_threshold; /* collect the cycles above this size */
+    struct JSContext *ctx; /* NULL once the context is freed */
+    uint16_t id; /* index in JSRuntime.account_array */
+} JSMemAccount;
+
+/* account ids are kept in 16 bits, 0 is the runtime */
+#define JS_ACCOUNT_ID_MAX 0xffff
+
+/* each block allocated by js_malloc_rt() starts with the account it is
+   charged to (NULL for the runtime), so that the free credits the same
+   account whichever context releases the block. The header is padded
+   so that the returned pointer keeps the alignment of malloc().
+
+   The objects, the function bytecodes and the shapes are the most
+   numerous blocks: they are allocated by js_malloc_gc_rt() without
+   header and keep the id of their account in a spare field. */
+typedef union JSMallocHeader {
+    JSMemAccount *account;
+    max_align_t align;
+} JSMallocHeader;
+
+#define JS_MALLOC_HEADER_SIZE sizeof(JSMallocHeader)
+
 /* default memory allocation functions with memory limitation */
 static inline size_t js_def_malloc_usable_size(void *ptr)
 {
@@ -0,0 +1,234 @@
+#include <alloca.h>
+#include "bytecode.h"
+
+int js_function_set_properties(JSContext *ctx, JSValueConst func_obj,
+                               JSAtom name, int len)
+{
+    /* same order as the other engines: length, then name */
+    JS_DefinePropertyValue(ctx, func_obj, JS_ATOM_length, JS_NewInt32(ctx, len),
+                           JS_PROP_CONFIGURABLE);
+    return JS_DefinePropertyValue(ctx, func_obj, JS_ATOM_name,
+                                  JS_AtomToString(ctx, name),
+                                  JS_PROP_CONFIGURABLE);
+}
+
+/* Note: at least 'length' arguments will be readable in 'argv' */
+static JSValue JS_NewCFunction3(JSContext *ctx, JSCFunction *func,
+                                const char *name,
+                                int length, JSCFunctionEnum cproto, int magic,
+                                JSValueConst proto_val)
+{
+    JSValue func_obj;
+    JSObject *p;
+    JSAtom name_atom;
+
+    func_obj = JS_NewObjectProtoClass(ctx, proto_val, JS_CLASS_C_FUNCTION);
+    if (JS_IsException(func_obj))
+        return func_obj;
+    p = JS_VALUE_GET_OBJ(func_obj);
+    p->u.cfunc.realm = JS_DupContext(ctx);
+    p->u.cfunc.c_function.generic = func;
+    p->u.cfunc.length = length;
+    p->u.cfunc.cproto = cproto;
+    p->u.cfunc.magic = magic;
+    p->is_constructor = (cproto == JS_CFUNC_constructor ||
+                         cproto == JS_CFUNC_constructor_magic);
+    if (!name)
+        name = "";
+    name_atom = JS_NewAtom(ctx, name);
+    if (name_atom == JS_ATOM_NULL) {
+        JS_FreeValue(ctx, func_obj);
+        return JS_EXCEPTION;
+    }
+    js_function_set_properties(ctx, func_obj, name_atom, length);
+    JS_FreeAtom(ctx, name_atom);
+    return func_obj;
+}
+
+JSValue JS_NewCFunction2(JSContext *ctx, JSCFunction *func,
+                         const char *name,
+                         int length, JSCFunctionEnum cproto, int magic)
+{
+    return JS_NewCFunction3(ctx, func, name, length, cproto, magic,
+                            ctx->function_proto);
+}
+
+JSValue js_new_cfunction_proto(JSContext *ctx, JSCFunction *func,
+                               const char *name, int length,
+                               JSCFunctionEnum cproto, int magic,
+                               JSValueConst proto_val)
+{
+    return JS_NewCFunction3(ctx, func, name, length, cproto, magic, proto_val);
+}
+
+void JS_SetConstructor(JSContext *ctx, JSValueConst func_obj,
+                       JSValueConst proto)
+{
+    JS_DefinePropertyValue(ctx, func_obj, JS_ATOM_prototype,
+                           JS_DupValue(ctx, proto), 0);
+    JS_DefinePropertyValue(ctx, proto, JS_ATOM_constructor,
+                           JS_DupValue(ctx, func_obj),
+                           JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+}
+
+int JS_SetPropertyFunctionList(JSContext *ctx, JSValueConst obj,
+                               const JSCFunctionListEntry *tab, int len)
+{
+    const JSCFunctionListEntry *e;
+    JSValue val;
+    int i;
+
+    for(i = 0; i < len; i++) {
+        e = &tab[i];
+        val = JS_NewCFunction2(ctx, e->cfunc.generic, e->name, e->length,
+                               e->cproto, e->magic);
+        if (JS_IsException(val))
+            return -1;
+        if (JS_DefinePropertyValueStr(ctx, obj, e->name, val,
+                                      JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
+                           JSValueConst this_obj,
+                           int argc, JSValueConst *argv,
+                           BOOL is_constructor_call)
+{
+    JSObject *p;
+    JSRuntime *rt;
+    JSContext *realm;
+    JSMemAccount *saved_account;
+    JSCFunctionType func;
+    JSValue ret;
+    JSValueConst *arg_buf;
+    int arg_count, i;
+
+    p = JS_VALUE_GET_OBJ(func_obj);
+    realm = p->u.cfunc.realm;
+    func = p->u.cfunc.c_function;
+    arg_count = p->u.cfunc.length;
+
+    /* fill the missing arguments with undefined */
+    if (unlikely(argc < arg_count)) {
+        arg_buf = alloca(sizeof(arg_buf[0]) * arg_count);
+        for(i = 0; i < argc; i++)
+            arg_buf[i] = argv[i];
+        for(i = argc; i < arg_count; i++)
+            arg_buf[i] = JS_UNDEFINED;
+        argv = arg_buf;
+    }
+
+    /* the allocations of the call are charged to the function realm */
+    rt = realm->rt;
+    saved_account = rt->malloc_account;
+    rt->malloc_account = realm->mem_account;
+    switch(p->u.cfunc.cproto) {
+    case JS_CFUNC_constructor:
+        /* here this_obj is new_target */
+        if (!is_constructor_call)
+            this_obj = JS_UNDEFINED;
+        /* fall thru */
+    case JS_CFUNC_generic:
+        ret = func.generic(realm, this_obj, argc, argv);
+        break;
+    case JS_CFUNC_constructor_magic:
+        if (!is_constructor_call)
+            this_obj = JS_UNDEFINED;
+        /* fall thru */
+    case JS_CFUNC_generic_magic:
+        ret = func.generic_magic(realm, this_obj, argc, argv,
+                                 p->u.cfunc.magic);
+        break;
+    default:
+        abort();
+    }
+    rt->malloc_account = saved_account;
+    return ret;
+}
+
+JSValue JS_Call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_obj,
+                int argc, JSValueConst *argv)
+{
+    return JS_CallInternal(ctx, func_obj, this_obj, JS_UNDEFINED,
+                           argc, (JSValue *)argv, JS_CALL_FLAG_COPY_ARGV);
+}
+
+JSValue JS_CallConstructor(JSContext *ctx, JSValueConst func_obj,
+                           int argc, JSValueConst *argv)
+{
+    return JS_CallConstructorInternal(ctx, func_obj, func_obj,
+                                      argc, (JSValue *)argv,
+                                      JS_CALL_FLAG_COPY_ARGV);
+}
+
+/* bytecode functions */
+
+void free_var_ref(JSRuntime *rt, JSVarRef *var_ref)
+{
+    if (var_ref) {
+        assert(var_ref->header.ref_count > 0);
+        if (--var_ref->header.ref_count == 0) {
+            if (var_ref->is_detached) {
+                JS_FreeValueRT(rt, var_ref->value);
+                remove_gc_object(&var_ref->header);
+            } else {
+                list_del(&var_ref->header.link); /* still on the stack */
+                if (var_ref->async_frame)
+                    free_async_frame(rt, var_ref->async_frame);
+            }
+            js_free_rt(rt, var_ref);
+        }
+    }
+}
+
+void free_bytecode_function(JSRuntime *rt, JSObject *p)
+{
+    JSFunctionBytecode *b;
+    JSVarRef **var_refs;
+    int i;
+
+    b = p->u.func.function_bytecode;
+    var_refs = p->u.func.var_refs;
+    if (var_refs) {
+        for(i = 0; i < b->closure_var_count; i++) {
+            if (!var_refs[i])
+                break; /* the creation of the closure failed */
+            if (b->closure_var[i].is_copied)
+                JS_FreeValueRT(rt, *var_refs[i]->pvalue);
+            else
+                free_var_ref(rt, var_refs[i]);
+        }
+        js_free_rt(rt, var_refs);
+    }
+    JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b));
+    if (p->u.func.realm)
+        JS_FreeContext(p->u.func.realm);
+}
+
+void mark_bytecode_function(JSRuntime *rt, JSObject *p,
+                            JS_MarkFunc *mark_func)
+{
+    JSFunctionBytecode *b = p->u.func.function_bytecode;
+    JSVarRef **var_refs = p->u.func.var_refs;
+    int i;
+
+    /* the references which are not detached point to a live frame,
+       which is a GC object if it is suspended */
+    if (var_refs) {
+        for(i = 0; i < b->closure_var_count; i++) {
+            if (!var_refs[i])
+                break;
+            if (b->closure_var[i].is_copied)
+                JS_MarkValue(rt, *var_refs[i]->pvalue, mark_func);
+            else if (var_refs[i]->is_detached)
+                mark_func(rt, &var_refs[i]->header);
+            else if (var_refs[i]->async_frame)
+                mark_func(rt, &var_refs[i]->async_frame->header);
+        }
+    }
+    mark_func(rt, &b->header);
+    if (p->u.func.realm)
+        mark_func(rt, &p->u.func.realm->header);
+}
@@ -0,0 +1,859 @@
+#include "context.h"
+
+static inline void set_value(JSContext *ctx, JSValue *pval, JSValue new_val)
+{
+    JSValue old_val;
+    old_val = *pval;
+    *pval = new_val;
+    JS_FreeValue(ctx, old_val);
+}
+
+static int JS_ThrowTypeErrorOrFalse(JSContext *ctx, int flags,
+                                    const char *fmt, JSAtom atom)
+{
+    if (flags & JS_PROP_THROW) {
+        JS_ThrowTypeErrorAtom(ctx, fmt, atom);
+        return -1;
+    } else {
+        return FALSE;
+    }
+}
+
+/* takes ownership of the shape reference */
+JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSObject *proto,
+                              JSClassEnum class_id)
+{
+    JSObject *p;
+
+    js_trigger_gc(ctx->rt, ctx->mem_account, sizeof(JSObject));
+    p = js_malloc_gc(ctx, sizeof(JSObject));
+    if (unlikely(!p))
+        goto fail;
+    p->header.account_id = ctx->mem_account->id;
+    p->class_id = class_id;
+    p->extensible = TRUE;
+    p->free_mark = 0;
+    p->is_constructor = 0;
+    p->is_uncatchable_error = 0;
+    p->fast_array = 0;
+    p->shape = sh;
+    p->prop = js_malloc(ctx, sizeof(JSProperty) * sh->prop_size);
+    if (unlikely(!p->prop)) {
+        js_free_gc_rt(ctx->rt, p, p->header.account_id);
+    fail:
+        js_free_shape(ctx->rt, sh);
+        return JS_EXCEPTION;
+    }
+    p->proto = proto;
+    if (proto)
+        proto->header.ref_count++;
+
+    switch(class_id) {
+    case JS_CLASS_C_FUNCTION:
+        p->u.cfunc.realm = NULL;
+        break;
+    case JS_CLASS_BYTECODE_FUNCTION:
+        p->u.func.realm = NULL;
+        p->u.func.function_bytecode = NULL;
+        p->u.func.var_refs = NULL;
+        break;
+    case JS_CLASS_ARRAY:
+        p->fast_array = 1;
+        p->u.array.u.ptr = NULL;
+        p->u.array.count = 0;
+        p->u.array.size = 0;
+        p->u.array.kind = JS_ARRAY_KIND_INT;
+        break;
+    case JS_CLASS_GENERATOR:
+        p->u.generator.frame = NULL;
+        p->u.generator.state = JS_GENERATOR_STATE_COMPLETED;
+        break;
+    case JS_CLASS_ARRAY_BUFFER:
+        p->u.array_buffer = NULL;
+        break;
+    case JS_CLASS_UINT8C_ARRAY ... JS_CLASS_FLOAT64_ARRAY:
+        p->fast_array = 1;
+        /* fall thru */
+    case JS_CLASS_DATAVIEW:
+        p->u.array.u.ptr = NULL;
+        p->u.array.buffer = NULL;
+        p->u.array.count = 0;
+        p->u.array.kind = class_id - JS_CLASS_UINT8C_ARRAY +
+            JS_ARRAY_KIND_UINT8C;
+        break;
+    default:
+        break;
+    }
+    p->header.ref_count = 1;
+    add_gc_object(ctx->rt, &p->header, JS_GC_OBJ_TYPE_JS_OBJECT);
+    return JS_MKPTR(JS_TAG_OBJECT, p);
+}
+
+JSValue JS_NewObjectProtoClass(JSContext *ctx, JSValueConst proto_val,
+                               JSClassEnum class_id)
+{
+    JSShape *sh;
+    JSObject *proto;
+
+    proto = JS_IsObject(proto_val) ? JS_VALUE_GET_OBJ(proto_val) : NULL;
+    sh = js_new_shape(ctx);
+    if (unlikely(!sh))
+        return JS_EXCEPTION;
+    return JS_NewObjectFromShape(ctx, sh, proto, class_id);
+}
+
+JSValue JS_NewObjectClass(JSContext *ctx, int class_id)
+{
+    return JS_NewObjectProtoClass(ctx, ctx->class_proto[class_id], class_id);
+}
+
+JSValue JS_NewObjectProto(JSContext *ctx, JSValueConst proto)
+{
+    return JS_NewObjectProtoClass(ctx, proto, JS_CLASS_OBJECT);
+}
+
+JSValue JS_NewObject(JSContext *ctx)
+{
+    /* inline JS_NewObjectClass(ctx, JS_CLASS_OBJECT); */
+    return JS_NewObjectProtoClass(ctx, ctx->class_proto[JS_CLASS_OBJECT],
+                                  JS_CLASS_OBJECT);
+}
+
+JSValue JS_NewError(JSContext *ctx)
+{
+    return JS_NewObjectClass(ctx, JS_CLASS_ERROR);
+}
+
+JSValue js_create_from_ctor(JSContext *ctx, JSValueConst new_target,
+                            int class_id)
+{
+    JSValue proto, obj;
+
+    if (JS_IsUndefined(new_target)) {
+        proto = JS_DupValue(ctx, ctx->class_proto[class_id]);
+    } else {
+        proto = JS_GetProperty(ctx, new_target, JS_ATOM_prototype);
+        if (JS_IsException(proto))
+            return proto;
+        if (!JS_IsObject(proto)) {
+            JS_FreeValue(ctx, proto);
+            proto = JS_DupValue(ctx, ctx->class_proto[class_id]);
+        }
+    }
+    obj = JS_NewObjectProtoClass(ctx, proto, class_id);
+    JS_FreeValue(ctx, proto);
+    return obj;
+}
+
+static void js_free_fast_array(JSRuntime *rt, JSObject *p)
+{
+    uint32_t i;
+
+    if (p->u.array.kind == JS_ARRAY_KIND_VALUE) {
+        for(i = 0; i < p->u.array.count; i++)
+            JS_FreeValueRT(rt, p->u.array.u.values[i]);
+    }
+    js_free_rt(rt, p->u.array.u.ptr);
+    p->u.array.u.ptr = NULL;
+    p->u.array.count = 0;
+    p->u.array.size = 0;
+}
+
+void free_object(JSRuntime *rt, JSObject *p)
+{
+    int i;
+    JSShape *sh;
+
+    p->free_mark = 1; /* used to tell the object is invalid when
+                         freeing cycles */
+    /* free all the fields */
+    sh = p->shape;
+    for(i = 0; i < sh->prop_count; i++) {
+        JS_FreeValueRT(rt, p->prop[i].value);
+    }
+    js_free_rt(rt, p->prop);
+    /* as an optimization we destroy the shape immediately without
+       putting it in gc_zero_ref_count_list */
+    js_free_shape(rt, sh);
+
+    /* fail safe */
+    p->shape = NULL;
+    p->prop = NULL;
+
+    if (p->proto)
+        JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_OBJECT, p->proto));
+    p->proto = NULL;
+
+    switch(p->class_id) {
+    case JS_CLASS_C_FUNCTION:
+        if (p->u.cfunc.realm)
+            JS_FreeContext(p->u.cfunc.realm);
+        break;
+    case JS_CLASS_BYTECODE_FUNCTION:
+        /* NULL if the function creation failed */
+        if (p->u.func.function_bytecode)
+            free_bytecode_function(rt, p);
+        break;
+    case JS_CLASS_ARRAY:
+        if (p->fast_array)
+            js_free_fast_array(rt, p);
+        break;
+    case JS_CLASS_GENERATOR:
+        free_generator(rt, p);
+        break;
+    case JS_CLASS_ARRAY_BUFFER:
+        free_array_buffer(rt, p);
+        break;
+    case JS_CLASS_UINT8C_ARRAY ... JS_CLASS_DATAVIEW:
+        free_typed_array(rt, p);
+        break;
+    default:
+        break;
+    }
+
+    /* fail safe */
+    p->class_id = 0;
+
+    remove_gc_object(&p->header);
+    if (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && p->header.ref_count != 0) {
+        list_add_tail(&p->header.link, &rt->gc_zero_ref_count_list);
+    } else {
+        js_free_gc_rt(rt, p, p->header.account_id);
+    }
+}
+
+void mark_object_children(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func)
+{
+    JSShape *sh;
+    int i;
+
+    sh = p->shape;
+    for(i = 0; i < sh->prop_count; i++) {
+        JS_MarkValue(rt, p->prop[i].value, mark_func);
+    }
+    if (p->proto)
+        mark_func(rt, &p->proto->header);
+
+    switch(p->class_id) {
+    case JS_CLASS_C_FUNCTION:
+        if (p->u.cfunc.realm)
+            mark_func(rt, &p->u.cfunc.realm->header);
+        break;
+    case JS_CLASS_BYTECODE_FUNCTION:
+        if (p->u.func.function_bytecode)
+            mark_bytecode_function(rt, p, mark_func);
+        break;
+    case JS_CLASS_ARRAY:
+        /* the numeric elements are not scanned */
+        if (p->fast_array && p->u.array.kind == JS_ARRAY_KIND_VALUE) {
+            for(i = 0; i < p->u.array.count; i++)
+                JS_MarkValue(rt, p->u.array.u.values[i], mark_func);
+        }
+        break;
+    case JS_CLASS_GENERATOR:
+        mark_generator(rt, p, mark_func);
+        break;
+    case JS_CLASS_UINT8C_ARRAY ... JS_CLASS_DATAVIEW:
+        mark_typed_array(rt, p, mark_func);
+        break;
+    default:
+        break;
+    }
+}
+
+JSValue JS_GetPrototype(JSContext *ctx, JSValueConst obj)
+{
+    JSObject *p;
+
+    if (!JS_IsObject(obj))
+        return JS_NULL;
+    p = JS_VALUE_GET_OBJ(obj)->proto;
+    if (!p)
+        return JS_NULL;
+    return JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, p));
+}
+
+int JS_IsFunction(JSContext *ctx, JSValueConst val)
+{
+    JSObject *p;
+    if (!JS_IsObject(val))
+        return FALSE;
+    p = JS_VALUE_GET_OBJ(val);
+    switch(p->class_id) {
+    case JS_CLASS_C_FUNCTION:
+    case JS_CLASS_BYTECODE_FUNCTION:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+int JS_IsError(JSContext *ctx, JSValueConst val)
+{
+    return JS_IsObject(val) &&
+        JS_VALUE_GET_OBJ(val)->class_id == JS_CLASS_ERROR;
+}
+
+JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
+                               JSAtom prop, JSValueConst this_obj)
+{
+    JSObject *p;
+    JSProperty *pr;
+    JSShapeProperty *prs;
+    uint32_t tag, idx;
+
+    tag = JS_VALUE_GET_TAG(obj);
+    if (unlikely(tag != JS_TAG_OBJECT)) {
+        switch(tag) {
+        case JS_TAG_NULL:
+            return JS_ThrowTypeErrorAtom(ctx, "cannot read property '%s' of null", prop);
+        case JS_TAG_UNDEFINED:
+            return JS_ThrowTypeErrorAtom(ctx, "cannot read property '%s' of undefined", prop);
+        case JS_TAG_EXCEPTION:
+            return JS_EXCEPTION;
+        case JS_TAG_STRING:
+            if (prop == JS_ATOM_length)
+                return JS_NewInt32(ctx, JS_VALUE_GET_STRING(obj)->len);
+            return JS_UNDEFINED;
+        default:
+            /* no primitive wrapper objects yet */
+            return JS_UNDEFINED;
+        }
+    }
+    p = JS_VALUE_GET_OBJ(obj);
+    for(;;) {
+        if (p->fast_array && __JS_AtomIsTaggedInt(prop)) {
+            /* no index property in the shape */
+            idx = __JS_AtomToUInt32(prop);
+            if (idx < p->u.array.count)
+                return js_array_get_fast(ctx, p, idx);
+        } else {
+            prs = find_own_property(&pr, p, prop);
+            if (prs)
+                return JS_DupValue(ctx, pr->value);
+        }
+        p = p->proto;
+        if (!p)
+            break;
+    }
+    return JS_UNDEFINED;
+}
+
+JSValue JS_GetProperty(JSContext *ctx, JSValueConst obj, JSAtom prop)
+{
+    return JS_GetPropertyInternal(ctx, obj, prop, obj);
+}
+
+JSValue JS_GetPropertyStr(JSContext *ctx, JSValueConst this_obj,
+                          const char *prop)
+{
+    JSAtom atom;
+    JSValue ret;
+    atom = JS_NewAtom(ctx, prop);
+    if (atom == JS_ATOM_NULL)
+        return JS_EXCEPTION;
+    ret = JS_GetProperty(ctx, this_obj, atom);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+/* arrays */
+
+/* the 'length' of the arrays follows the added elements */
+static void js_update_array_length(JSContext *ctx, JSObject *p, JSAtom prop)
+{
+    JSProperty *pr;
+    uint32_t idx;
+    double len;
+
+    if (!JS_AtomIsArrayIndex(ctx, &idx, prop))
+        return;
+    if (!find_own_property(&pr, p, JS_ATOM_length))
+        return;
+    /* always a number */
+    JS_ToFloat64(ctx, &len, pr->value);
+    if (idx >= len)
+        set_value(ctx, &pr->value, JS_NewNumber(ctx, (double)idx + 1));
+}
+
+/* the 'length' property of a fast array is u.array.count */
+static void js_fast_array_update_length(JSContext *ctx, JSObject *p)
+{
+    JSProperty *pr;
+
+    if (find_own_property(&pr, p, JS_ATOM_length))
+        set_value(ctx, &pr->value,
+                  JS_NewNumber(ctx, (double)p->u.array.count));
+}
+
+static int js_array_value_kind(JSValueConst val)
+{
+    uint32_t tag = JS_VALUE_GET_TAG(val);
+    if (tag == JS_TAG_INT)
+        return JS_ARRAY_KIND_INT;
+    if (JS_TAG_IS_FLOAT64(tag))
+        return JS_ARRAY_KIND_DOUBLE;
+    return JS_ARRAY_KIND_VALUE;
+}
+
+static size_t js_array_elem_size(int kind)
+{
+    switch(kind) {
+    case JS_ARRAY_KIND_INT:
+        return sizeof(int32_t);
+    case JS_ARRAY_KIND_DOUBLE:
+        return sizeof(double);
+    default:
+        return sizeof(JSValue);
+    }
+}
+
+/* convert the elements to the wider kind 'kind' */
+static int js_array_widen(JSContext *ctx, JSObject *p, int kind)
+{
+    void *ptr;
+    JSValue *values;
+    double *doubles;
+    uint32_t i, count;
+
+    count = p->u.array.count;
+    ptr = NULL;
+    if (p->u.array.size != 0) {
+        ptr = js_malloc(ctx, js_array_elem_size(kind) * p->u.array.size);
+        if (!ptr)
+            return -1;
+    }
+    if (kind == JS_ARRAY_KIND_DOUBLE) {
+        doubles = ptr;
+        for(i = 0; i < count; i++)
+            doubles[i] = p->u.array.u.int32s[i];
+    } else {
+        values = ptr;
+        for(i = 0; i < count; i++)
+            values[i] = js_array_get_fast(ctx, p, i);
+    }
+    js_free(ctx, p->u.array.u.ptr);
+    p->u.array.u.ptr = ptr;
+    p->u.array.kind = kind;
+    return 0;
+}
+
+int expand_fast_array(JSContext *ctx, JSObject *p, uint32_t new_len)
+{
+    uint32_t new_size;
+    void *ptr;
+
+    new_size = max_int(new_len, p->u.array.size * 3 / 2);
+    ptr = js_realloc(ctx, p->u.array.u.ptr,
+                     js_array_elem_size(p->u.array.kind) * new_size);
+    if (!ptr)
+        return -1;
+    p->u.array.u.ptr = ptr;
+    p->u.array.size = new_size;
+    return 0;
+}
+
+int js_array_set_element(JSContext *ctx, JSObject *p, uint32_t idx,
+                         JSValue val)
+{
+    int kind;
+
+    kind = js_array_value_kind(val);
+    if (kind > p->u.array.kind && js_array_widen(ctx, p, kind))
+        goto fail;
+    if (idx == p->u.array.count) {
+        if (idx >= p->u.array.size && expand_fast_array(ctx, p, idx + 1))
+            goto fail;
+        if (p->u.array.kind == JS_ARRAY_KIND_VALUE)
+            p->u.array.u.values[idx] = JS_UNDEFINED;
+        p->u.array.count++;
+        js_fast_array_update_length(ctx, p);
+    }
+    js_array_set_fast(ctx, p, idx, val);
+    return TRUE;
+ fail:
+    JS_FreeValue(ctx, val);
+    return -1;
+}
+
+int convert_fast_array_to_array(JSContext *ctx, JSObject *p)
+{
+    JSProperty *pr;
+    uint32_t i, len;
+
+    len = p->u.array.count;
+    /* the array must not be left half converted */
+    if (js_shape_reserve_properties(ctx, p, len))
+        return -1;
+    for(i = 0; i < len; i++) {
+        pr = add_property(ctx, p, __JS_AtomFromUInt32(i), JS_PROP_C_W_E);
+        pr->value = js_array_get_fast(ctx, p, i);
+    }
+    js_free_fast_array(ctx->rt, p);
+    p->fast_array = 0;
+    return 0;
+}
+
+/* ToUint32(val) if it is equal to ToNumber(val), a RangeError
+   otherwise */
+static int js_to_array_length(JSContext *ctx, uint32_t *plen,
+                              JSValueConst val)
+{
+    double d;
+
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT && JS_VALUE_GET_INT(val) >= 0) {
+        *plen = JS_VALUE_GET_INT(val);
+        return 0;
+    }
+    if (JS_ToFloat64(ctx, &d, val))
+        return -1;
+    if (!(d >= 0 && d <= UINT32_MAX) || (uint32_t)d != d) {
+        JS_ThrowRangeError(ctx, "invalid array length");
+        return -1;
+    }
+    *plen = d;
+    return 0;
+}
+
+/* set the 'length' of an array (takes ownership of 'val'). A smaller
+   length deletes the elements at or above it, down to the last one
+   which is not configurable. A larger length converts a fast array to
+   a generic one. */
+static int js_array_set_length(JSContext *ctx, JSObject *p, JSValue val,
+                               int flags)
+{
+    JSShape *sh;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    uint32_t len, new_len, idx, i;
+    double old_len;
+    int j, ret;
+
+    ret = js_to_array_length(ctx, &len, val);
+    JS_FreeValue(ctx, val);
+    if (ret)
+        return -1;
+    if (p->fast_array) {
+        if (len <= p->u.array.count) {
+            if (p->u.array.kind == JS_ARRAY_KIND_VALUE) {
+                for(i = len; i < p->u.array.count; i++)
+                    JS_FreeValue(ctx, p->u.array.u.values[i]);
+            }
+            p->u.array.count = len;
+            js_fast_array_update_length(ctx, p);
+            return TRUE;
+        }
+        if (convert_fast_array_to_array(ctx, p))
+            return -1;
+    }
+    prs = find_own_property(&pr, p, JS_ATOM_length);
+    if (!(prs->flags & JS_PROP_WRITABLE))
+        return JS_ThrowTypeErrorOrFalse(ctx, flags, "'%s' is read-only",
+                                        JS_ATOM_length);
+    /* always a number */
+    JS_ToFloat64(ctx, &old_len, pr->value);
+    new_len = len;
+    if (len < old_len) {
+        sh = p->shape;
+        for(j = 0, prs = get_shape_prop(sh); j < sh->prop_count; j++, prs++) {
+            if (prs->atom != JS_ATOM_NULL &&
+                !(prs->flags & JS_PROP_CONFIGURABLE) &&
+                JS_AtomIsArrayIndex(ctx, &idx, prs->atom) && idx >= new_len)
+                new_len = idx + 1;
+        }
+        for(j = 0; j < p->shape->prop_count; j++) {
+            prs = get_shape_prop(p->shape) + j;
+            if (prs->atom == JS_ATOM_NULL ||
+                !JS_AtomIsArrayIndex(ctx, &idx, prs->atom) || idx < new_len)
+                continue;
+            if (delete_property(ctx, p, prs->atom) < 0)
+                return -1;
+            /* the deleted properties were removed: scan again */
+            if (p->shape->deleted_prop_count == 0)
+                j = -1;
+        }
+        find_own_property(&pr, p, JS_ATOM_length);
+    }
+    set_value(ctx, &pr->value, JS_NewNumber(ctx, new_len));
+    if (new_len != len)
+        return JS_ThrowTypeErrorOrFalse(ctx, flags, "could not delete property '%s'",
+                                        JS_ATOM_length);
+    return TRUE;
+}
+
+JSValue js_create_array(JSContext *ctx, int len, JSValue *tab)
+{
+    JSValue obj;
+    JSObject *p;
+    JSProperty *pr;
+    int i, kind;
+
+    obj = JS_NewObjectClass(ctx, JS_CLASS_ARRAY);
+    if (JS_IsException(obj))
+        goto fail;
+    p = JS_VALUE_GET_OBJ(obj);
+    pr = add_property(ctx, p, JS_ATOM_length, JS_PROP_WRITABLE);
+    if (!pr)
+        goto fail;
+    pr->value = JS_NewInt32(ctx, 0);
+    if (len > 0) {
+        /* the kind of the elements is chosen once */
+        kind = JS_ARRAY_KIND_INT;
+        for(i = 0; i < len; i++)
+            kind = max_int(kind, js_array_value_kind(tab[i]));
+        p->u.array.kind = kind;
+        if (expand_fast_array(ctx, p, len))
+            goto fail;
+        for(i = 0; i < len; i++) {
+            if (kind == JS_ARRAY_KIND_VALUE)
+                p->u.array.u.values[i] = JS_UNDEFINED;
+            js_array_set_fast(ctx, p, i, tab[i]);
+            tab[i] = JS_UNDEFINED;
+        }
+        p->u.array.count = len;
+        pr->value = JS_NewInt32(ctx, len);
+    }
+    return obj;
+ fail:
+    for(i = 0; i < len; i++) {
+        JS_FreeValue(ctx, tab[i]);
+        tab[i] = JS_UNDEFINED;
+    }
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+int JS_SetPropertyInternal(JSContext *ctx, JSValueConst this_obj,
+                           JSAtom prop, JSValue val, int flags)
+{
+    JSObject *p, *p1;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    uint32_t tag, idx;
+
+    tag = JS_VALUE_GET_TAG(this_obj);
+    if (unlikely(tag != JS_TAG_OBJECT)) {
+        JS_FreeValue(ctx, val);
+        switch(tag) {
+        case JS_TAG_NULL:
+            JS_ThrowTypeErrorAtom(ctx, "cannot set property '%s' of null", prop);
+            return -1;
+        case JS_TAG_UNDEFINED:
+            JS_ThrowTypeErrorAtom(ctx, "cannot set property '%s' of undefined", prop);
+            return -1;
+        default:
+            /* the properties of primitive values are ignored */
+            return TRUE;
+        }
+    }
+    p = JS_VALUE_GET_OBJ(this_obj);
+    if (p->fast_array) {
+        if (js_fast_array_has(p, prop)) {
+            idx = __JS_AtomToUInt32(prop);
+            if (js_array_set_fast(ctx, p, idx, val))
+                return TRUE;
+            if (p->class_id != JS_CLASS_ARRAY)
+                return js_typed_array_set_element(ctx, p, idx, val);
+            return js_array_set_element(ctx, p, idx, val);
+        } else if (p->class_id != JS_CLASS_ARRAY) {
+            /* the elements out of the bounds of a typed array are
+               ignored */
+            if (JS_AtomIsArrayIndex(ctx, &idx, prop)) {
+                JS_FreeValue(ctx, val);
+                return TRUE;
+            }
+        }
+    }
+    /* the arrays always have an own 'length' */
+    if (p->class_id == JS_CLASS_ARRAY && prop == JS_ATOM_length)
+        return js_array_set_length(ctx, p, val, flags);
+    prs = find_own_property(&pr, p, prop);
+    if (prs) {
+        if (likely(prs->flags & JS_PROP_WRITABLE)) {
+            set_value(ctx, &pr->value, val);
+            return TRUE;
+        }
+        goto read_only_prop;
+    }
+    /* a read-only property in the prototype chain prevents the
+       creation of an own property */
+    for(p1 = p->proto; p1 != NULL; p1 = p1->proto) {
+        prs = find_own_property(&pr, p1, prop);
+        if (prs) {
+            if (!(prs->flags & JS_PROP_WRITABLE))
+                goto read_only_prop;
+            break;
+        }
+    }
+    if (unlikely(!p->extensible)) {
+        JS_FreeValue(ctx, val);
+        return JS_ThrowTypeErrorOrFalse(ctx, flags, "object is not extensible", prop);
+    }
+    if (p->fast_array && JS_AtomIsArrayIndex(ctx, &idx, prop)) {
+        if (idx == p->u.array.count)
+            return js_array_set_element(ctx, p, idx, val);
+        /* a hole */
+        if (convert_fast_array_to_array(ctx, p)) {
+            JS_FreeValue(ctx, val);
+            return -1;
+        }
+    }
+    pr = add_property(ctx, p, prop, JS_PROP_C_W_E);
+    if (unlikely(!pr)) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    pr->value = val;
+    if (p->class_id == JS_CLASS_ARRAY)
+        js_update_array_length(ctx, p, prop);
+    return TRUE;
+ read_only_prop:
+    JS_FreeValue(ctx, val);
+    return JS_ThrowTypeErrorOrFalse(ctx, flags, "'%s' is read-only", prop);
+}
+
+int JS_SetProperty(JSContext *ctx, JSValueConst this_obj,
+                   JSAtom prop, JSValue val)
+{
+    return JS_SetPropertyInternal(ctx, this_obj, prop, val, JS_PROP_THROW);
+}
+
+int JS_SetPropertyStr(JSContext *ctx, JSValueConst this_obj,
+                      const char *prop, JSValue val)
+{
+    JSAtom atom;
+    int ret;
+    atom = JS_NewAtom(ctx, prop);
+    if (atom == JS_ATOM_NULL) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    ret = JS_SetPropertyInternal(ctx, this_obj, atom, val, JS_PROP_THROW);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
+
+int JS_HasProperty(JSContext *ctx, JSValueConst obj, JSAtom prop)
+{
+    JSObject *p;
+    JSProperty *pr;
+
+    if (!JS_IsObject(obj))
+        return FALSE;
+    for(p = JS_VALUE_GET_OBJ(obj); p != NULL; p = p->proto) {
+        if (p->fast_array && js_fast_array_has(p, prop))
+            return TRUE;
+        if (find_own_property(&pr, p, prop))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+int JS_DeleteProperty(JSContext *ctx, JSValueConst obj, JSAtom prop, int flags)
+{
+    JSObject *p;
+    int res;
+
+    if (!JS_IsObject(obj))
+        return TRUE;
+    p = JS_VALUE_GET_OBJ(obj);
+    if (p->fast_array && js_fast_array_has(p, prop)) {
+        /* the elements of the typed arrays cannot be deleted */
+        if (p->class_id != JS_CLASS_ARRAY)
+            return JS_ThrowTypeErrorOrFalse(ctx, flags, "could not delete property '%s'", prop);
+        /* the deleted element is a hole */
+        if (convert_fast_array_to_array(ctx, p))
+            return -1;
+    }
+    res = delete_property(ctx, p, prop);
+    if (res != FALSE)
+        return res;
+    return JS_ThrowTypeErrorOrFalse(ctx, flags, "could not delete property '%s'", prop);
+}
+
+int JS_DefinePropertyValue(JSContext *ctx, JSValueConst this_obj,
+                           JSAtom prop, JSValue val, int flags)
+{
+    JSObject *p;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    uint32_t idx;
+
+    if (!JS_IsObject(this_obj)) {
+        JS_FreeValue(ctx, val);
+        JS_ThrowTypeError(ctx, "not an object");
+        return -1;
+    }
+    p = JS_VALUE_GET_OBJ(this_obj);
+    if (p->fast_array && p->class_id != JS_CLASS_ARRAY) {
+        /* typed array: the elements are always defined */
+        if (JS_AtomIsArrayIndex(ctx, &idx, prop)) {
+            if (idx < p->u.array.count)
+                return js_typed_array_set_element(ctx, p, idx, val);
+            JS_FreeValue(ctx, val);
+            return JS_ThrowTypeErrorOrFalse(ctx, flags, "out-of-bound index '%s'", prop);
+        }
+    } else if (p->fast_array &&
+               (prop == JS_ATOM_length || JS_AtomIsArrayIndex(ctx, &idx, prop))) {
+        if (prop != JS_ATOM_length &&
+            (flags & JS_PROP_C_W_E) == JS_PROP_C_W_E &&
+            (idx < p->u.array.count ||
+             (idx == p->u.array.count && p->extensible)))
+            return js_array_set_element(ctx, p, idx, val);
+        /* other flags, a hole or a new definition of 'length' */
+        if (convert_fast_array_to_array(ctx, p)) {
+            JS_FreeValue(ctx, val);
+            return -1;
+        }
+    }
+    prs = find_own_property(&pr, p, prop);
+    if (prs) {
+        if (!(prs->flags & JS_PROP_CONFIGURABLE)) {
+            /* only the value of a writable property can be changed */
+            if ((prs->flags & JS_PROP_WRITABLE) &&
+                (flags & JS_PROP_C_W_E) == (prs->flags & JS_PROP_C_W_E)) {
+                set_value(ctx, &pr->value, val);
+                return TRUE;
+            }
+            JS_FreeValue(ctx, val);
+            return JS_ThrowTypeErrorOrFalse(ctx, flags, "property '%s' is not configurable", prop);
+        }
+        if ((prs->flags & JS_PROP_C_W_E) != (flags & JS_PROP_C_W_E)) {
+            if (js_shape_prepare_update(ctx, p, &prs)) {
+                JS_FreeValue(ctx, val);
+                return -1;
+            }
+            prs->flags = flags & JS_PROP_C_W_E;
+        }
+        set_value(ctx, &pr->value, val);
+        return TRUE;
+    }
+    if (unlikely(!p->extensible)) {
+        JS_FreeValue(ctx, val);
+        return JS_ThrowTypeErrorOrFalse(ctx, flags, "object is not extensible", prop);
+    }
+    pr = add_property(ctx, p, prop, flags & JS_PROP_C_W_E);
+    if (unlikely(!pr)) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    pr->value = val;
+    if (p->class_id == JS_CLASS_ARRAY)
+        js_update_array_length(ctx, p, prop);
+    return TRUE;
+}
+
+int JS_DefinePropertyValueStr(JSContext *ctx, JSValueConst this_obj,
+                              const char *prop, JSValue val, int flags)
+{
+    JSAtom atom;
+    int ret;
+    atom = JS_NewAtom(ctx, prop);
+    if (atom == JS_ATOM_NULL) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    ret = JS_DefinePropertyValue(ctx, this_obj, atom, val, flags);
+    JS_FreeAtom(ctx, atom);
+    return ret;
+}
@@ -0,0 +1,573 @@
+#ifndef QJS_OBJECT_H
+#define QJS_OBJECT_H
+#include "runtime.h"
+#include "atoms.h"
+
+typedef enum {
+    /* classid tag */    /* union usage   | properties */
+    JS_CLASS_OBJECT = 1, /* must be first */
+    JS_CLASS_ERROR,
+    JS_CLASS_C_FUNCTION, /* u.cfunc */
+    JS_CLASS_BYTECODE_FUNCTION, /* u.func */
+    JS_CLASS_ARRAY,      /* u.array       | length */
+    JS_CLASS_GENERATOR,  /* u.generator */
+    JS_CLASS_ARRAY_BUFFER, /* u.array_buffer | byteLength */
+    JS_CLASS_UINT8C_ARRAY, /* u.array     | length, byteLength, byteOffset, buffer */
+    JS_CLASS_INT8_ARRAY,   /* u.array     | same as Uint8ClampedArray */
+    JS_CLASS_UINT8_ARRAY,  /* u.array */
+    JS_CLASS_INT16_ARRAY,  /* u.array */
+    JS_CLASS_UINT16_ARRAY, /* u.array */
+    JS_CLASS_INT32_ARRAY,  /* u.array */
+    JS_CLASS_UINT32_ARRAY, /* u.array */
+    JS_CLASS_FLOAT32_ARRAY, /* u.array */
+    JS_CLASS_FLOAT64_ARRAY, /* u.array */
+    JS_CLASS_DATAVIEW,     /* u.array     | byteLength, byteOffset, buffer */
+
+    JS_CLASS_INIT_COUNT, /* last entry for predefined classes */
+} JSClassEnum;
+
+typedef union JSCFunctionType {
+    JSCFunction *generic;
+    JSCFunctionMagic *generic_magic;
+} JSCFunctionType;
+
+typedef struct JSFunctionBytecode JSFunctionBytecode;
+typedef struct JSAsyncFrame JSAsyncFrame;
+
+/* A variable captured by a closure. While the function defining the
+   variable runs, the reference points to its stack frame and is linked
+   in the frame list. It is detached (and becomes a GC object) when the
+   frame is left or the scope of the variable is closed. */
+typedef struct JSVarRef {
+    /* pvalue and value must come first (see JSVarCell) */
+    JSValue *pvalue; /* pointer to the value, either on the stack or to 'value' */
+    union {
+        JSValue value; /* used when the variable is no longer on the stack */
+        /* not detached: the suspended frame holding the variable (it
+           is kept alive by the reference), NULL if on the C stack */
+        JSAsyncFrame *async_frame;
+    };
+    union {
+        JSGCObjectHeader header;
+        struct {
+            int __gc_ref_count; /* corresponds to header.ref_count */
+            uint8_t __gc_mark; /* corresponds to header.mark/gc_obj_type */
+            uint8_t is_detached : 1;
+            uint8_t is_arg : 1;
+            uint16_t var_idx; /* index of the variable in the frame */
+        };
+    };
+} JSVarRef;
+
+/* A variable which is not modified after the creation of the closures
+   (JSClosureVar.is_copied): its value is copied in the closure, after
+   the var_refs array, instead of being shared in a JSVarRef. Its
+   layout is the start of JSVarRef so that the code reads all the
+   closure variables with var_refs[idx]->pvalue. */
+typedef struct JSVarCell {
+    JSValue *pvalue; /* points to 'value' */
+    JSValue value;
+} JSVarCell;
+
+typedef struct JSStackFrame {
+    JSValue *arg_buf; /* arguments */
+    JSValue *var_buf; /* variables */
+    struct list_head var_ref_list; /* list of JSVarRef.header.link */
+    JSAsyncFrame *async_frame; /* NULL if the frame is on the C stack */
+} JSStackFrame;
+
+/* The frame of a generator, which is suspended by the yield
+   instructions. The arguments, the variables and the value stack
+   follow the structure: their size is known from the bytecode. The
+   frames are taken from size classes of free frames kept by the
+   runtime (see async_frame_alloc()), so that the generators which are
+   created and completed repeatedly do not call malloc(). */
+struct JSAsyncFrame {
+    JSGCObjectHeader header; /* must come first */
+    JSStackFrame sf;
+    JSValue func_obj;
+    JSValue this_val;
+    const uint8_t *pc; /* where the code is resumed */
+    JSValue *sp; /* stack pointer of the suspended code, NULL if closed */
+    uint16_t slot_count; /* number of JSValues allocated in buf */
+    uint8_t is_completed : 1; /* the code has returned or thrown */
+    uint8_t throw_flag : 1; /* resume by throwing the current exception */
+    JSValue buf[0]; /* arguments, variables and stack */
+};
+
+typedef enum {
+    JS_GENERATOR_STATE_SUSPENDED_START,
+    JS_GENERATOR_STATE_SUSPENDED_YIELD,
+    JS_GENERATOR_STATE_EXECUTING,
+    JS_GENERATOR_STATE_COMPLETED,
+} JSGeneratorStateEnum;
+
+typedef struct JSShapeProperty {
+    uint32_t hash_next : 26; /* 0 if last in list */
+    uint32_t flags : 6;   /* JS_PROP_XXX */
+    JSAtom atom; /* JS_ATOM_NULL = free property entry */
+} JSShapeProperty;
+
+/* The properties of the shapes. A table is shared by the shapes of a
+   transition chain: a shape uses its first JSShape.prop_count
+   entries. The small tables are searched linearly. The larger ones
+   have a hash table, whose lists are sorted by decreasing index. */
+#define JS_SHAPE_LINEAR_MAX 8
+
+typedef struct JSShapeTable {
+    int ref_count; /* number of shapes using the table */
+    uint32_t count; /* used entries */
+    uint32_t size; /* allocated entries */
+    uint32_t hash_mask; /* only valid if hash != NULL */
+    uint32_t *hash; /* index + 1 of the last property, NULL if linear */
+    JSShapeProperty *prop; /* size entries */
+} JSShapeTable;
+
+/* A shape describes the property layout of an object. The hashed
+   shapes form a transition tree: a hashed shape is its parent plus one
+   property, and all the objects with the same layout (in any context
+   of the runtime) share it. The hashed shapes are read-only. The first
+   object modifying them gets a private copy (copy on write). The
+   prototype is kept in the object so that the shapes do not depend on
+   the context. */
+struct JSShape {
+    JSRefCountHeader header; /* must come first */
+    /* true if the shape is in the transition tree (and inserted in the
+       shape hash table). If not, JSShape.hash and JSShape.parent are not
+       valid */
+    uint8_t is_hashed;
+    uint16_t account_id; /* JSMemAccount.id of the block */
+    uint32_t hash; /* hash of the transition from 'parent' */
+    /* changed when the shape is created or modified in place: a
+       (shape, version) pair always denotes the same property layout,
+       even if the shape is freed and its memory reused */
+    uint32_t version;
+    int prop_size; /* allocated properties in the objects */
+    int prop_count; /* include deleted properties */
+    int deleted_prop_count;
+    JSShape *parent; /* holds a reference */
+    JSShape *shape_hash_next; /* in JSRuntime.shape_hash[h] list */
+    JSShapeTable *table;
+};
+
+typedef struct JSProperty {
+    JSValue value;
+} JSProperty;
+
+/* While an array is dense, its elements are kept in JSObject.u.array
+   and not in the properties: the 'length' property is then a writable
+   int equal to u.array.count and the shape has no index property. The
+   storage depends on the kind of the elements. The kind only widens
+   (int32, then double, then any value) so that the numeric arrays are
+   stored unboxed and are not scanned by the GC. A hole, an element with
+   other flags or a non-writable length convert the array to the
+   generic representation. */
+typedef enum {
+    JS_ARRAY_KIND_INT, /* int32_t */
+    JS_ARRAY_KIND_DOUBLE, /* double */
+    JS_ARRAY_KIND_VALUE, /* JSValue */
+    /* the typed arrays, in the order of their classes. Their kind is
+       fixed: the stored numbers are converted to it. */
+    JS_ARRAY_KIND_UINT8C,
+    JS_ARRAY_KIND_INT8,
+    JS_ARRAY_KIND_UINT8,
+    JS_ARRAY_KIND_INT16,
+    JS_ARRAY_KIND_UINT16,
+    JS_ARRAY_KIND_INT32,
+    JS_ARRAY_KIND_UINT32,
+    JS_ARRAY_KIND_FLOAT32,
+    JS_ARRAY_KIND_FLOAT64,
+} JSArrayKindEnum;
+
+/* The data of an ArrayBuffer is either allocated by the engine or
+   owned by the host (see JS_NewArrayBuffer()). The typed arrays and
+   the DataViews point into it and hold a reference to the ArrayBuffer
+   object (u.array.buffer), so the data is never moved or freed while
+   they exist. */
+typedef struct JSArrayBuffer {
+    uint32_t byte_length;
+    uint8_t *data;
+    JSFreeArrayBufferDataFunc *free_func; /* NULL if the host frees 'data' */
+    void *opaque; /* for free_func */
+} JSArrayBuffer;
+
+struct JSObject {
+    JSGCObjectHeader header; /* must come first, 32-bit */
+    uint8_t extensible : 1;
+    uint8_t free_mark : 1; /* only used when freeing objects with cycles */
+    uint8_t is_constructor : 1; /* TRUE if object is a constructor function */
+    uint8_t is_uncatchable_error : 1; /* if TRUE, error is not catchable */
+    uint8_t fast_array : 1; /* TRUE if u.array holds the elements */
+    uint16_t class_id; /* see JS_CLASS_x */
+    JSShape *shape; /* property names + flags */
+    JSProperty *prop; /* array of properties */
+    JSObject *proto; /* NULL for a null prototype */
+    union {
+        struct { /* JS_CLASS_C_FUNCTION */
+            JSContext *realm;
+            JSCFunctionType c_function;
+            uint8_t length;
+            uint8_t cproto;
+            int16_t magic;
+        } cfunc;
+        struct { /* JS_CLASS_BYTECODE_FUNCTION */
+            JSContext *realm;
+            JSFunctionBytecode *function_bytecode;
+            /* function_bytecode->closure_var_count entries, followed by
+               the JSVarCell of the copied variables */
+            JSVarRef **var_refs;
+        } func;
+        /* JS_CLASS_ARRAY if fast_array, the typed arrays (always
+           fast_array) and JS_CLASS_DATAVIEW */
+        struct {
+            union {
+                void *ptr;
+                int8_t *int8s;
+                uint8_t *uint8s;
+                int16_t *int16s;
+                uint16_t *uint16s;
+                int32_t *int32s;
+                uint32_t *uint32s;
+                float *floats;
+                double *doubles;
+                JSValue *values;
+            } u;
+            union {
+                uint32_t size; /* allocated elements (JS_CLASS_ARRAY) */
+                JSObject *buffer; /* ArrayBuffer of the typed arrays */
+            };
+            uint32_t count; /* number of elements (bytes if DataView) */
+            uint8_t kind; /* JS_ARRAY_KIND_x */
+        } array;
+        JSArrayBuffer *array_buffer; /* JS_CLASS_ARRAY_BUFFER */
+        struct { /* JS_CLASS_GENERATOR */
+            JSAsyncFrame *frame; /* NULL once completed */
+            uint8_t state; /* JS_GENERATOR_STATE_x */
+        } generator;
+    } u;
+};
+
+static inline JSShapeProperty *get_shape_prop(JSShape *sh)
+{
+    return sh->table->prop;
+}
+
+static inline void js_shape_new_version(JSRuntime *rt, JSShape *sh)
+{
+    sh->version = ++rt->shape_version;
+}
+
+static inline JSShape *js_dup_shape(JSShape *sh)
+{
+    sh->header.ref_count++;
+    return sh;
+}
+
+static js_force_inline JSShapeProperty *find_own_property1(JSObject *p,
+                                                          JSAtom atom)
+{
+    JSShape *sh;
+    JSShapeTable *tab;
+    JSShapeProperty *pr, *prop;
+    uint32_t h, n;
+    sh = p->shape;
+    tab = sh->table;
+    prop = tab->prop;
+    n = sh->prop_count;
+    if (!tab->hash) {
+        for(h = 0; h < n; h++) {
+            if (prop[h].atom == atom)
+                return &prop[h];
+        }
+        return NULL;
+    }
+    h = tab->hash[(uintptr_t)atom & tab->hash_mask];
+    while (h) {
+        pr = &prop[h - 1];
+        /* the entries after 'n' belong to the longer shapes */
+        if (likely(pr->atom == atom) && h <= n) {
+            return pr;
+        }
+        h = pr->hash_next;
+    }
+    return NULL;
+}
+
+static js_force_inline JSShapeProperty *find_own_property(JSProperty **ppr,
+                                                         JSObject *p,
+                                                         JSAtom atom)
+{
+    JSShape *sh;
+    JSShapeTable *tab;
+    JSShapeProperty *pr, *prop;
+    uint32_t h, n;
+    sh = p->shape;
+    tab = sh->table;
+    prop = tab->prop;
+    n = sh->prop_count;
+    if (!tab->hash) {
+        for(h = 0; h < n; h++) {
+            if (prop[h].atom == atom) {
+                *ppr = &p->prop[h];
+                return &prop[h];
+            }
+        }
+        *ppr = NULL;
+        return NULL;
+    }
+    h = tab->hash[(uintptr_t)atom & tab->hash_mask];
+    while (h) {
+        pr = &prop[h - 1];
+        if (likely(pr->atom == atom) && h <= n) {
+            *ppr = &p->prop[h - 1];
+            /* the compiler should be able to assume that pr != NULL here */
+            return pr;
+        }
+        h = pr->hash_next;
+    }
+    *ppr = NULL;
+    return NULL;
+}
+
+/* TRUE if 'atom' is an element of the fast array 'p' */
+static inline BOOL js_fast_array_has(JSObject *p, JSAtom atom)
+{
+    return __JS_AtomIsTaggedInt(atom) &&
+        __JS_AtomToUInt32(atom) < p->u.array.count;
+}
+
+static inline BOOL js_class_is_typed_array(int class_id)
+{
+    return class_id >= JS_CLASS_UINT8C_ARRAY &&
+        class_id <= JS_CLASS_FLOAT64_ARRAY;
+}
+
+/* element 'idx' < u.array.count of a fast array */
+static inline JSValue js_array_get_fast(JSContext *ctx, JSObject *p,
+                                        uint32_t idx)
+{
+    uint32_t v;
+
+    switch(p->u.array.kind) {
+    case JS_ARRAY_KIND_INT:
+    case JS_ARRAY_KIND_INT32:
+        return JS_NewInt32(ctx, p->u.array.u.int32s[idx]);
+    case JS_ARRAY_KIND_DOUBLE:
+    case JS_ARRAY_KIND_FLOAT64:
+        return __JS_NewFloat64(ctx, p->u.array.u.doubles[idx]);
+    case JS_ARRAY_KIND_VALUE:
+        return JS_DupValue(ctx, p->u.array.u.values[idx]);
+    case JS_ARRAY_KIND_UINT8C:
+    case JS_ARRAY_KIND_UINT8:
+        return JS_NewInt32(ctx, p->u.array.u.uint8s[idx]);
+    case JS_ARRAY_KIND_INT8:
+        return JS_NewInt32(ctx, p->u.array.u.int8s[idx]);
+    case JS_ARRAY_KIND_INT16:
+        return JS_NewInt32(ctx, p->u.array.u.int16s[idx]);
+    case JS_ARRAY_KIND_UINT16:
+        return JS_NewInt32(ctx, p->u.array.u.uint16s[idx]);
+    case JS_ARRAY_KIND_UINT32:
+        v = p->u.array.u.uint32s[idx];
+        if (v <= INT32_MAX)
+            return JS_NewInt32(ctx, v);
+        return __JS_NewFloat64(ctx, v);
+    default: /* JS_ARRAY_KIND_FLOAT32 */
+        return __JS_NewFloat64(ctx, p->u.array.u.floats[idx]);
+    }
+}
+
+/* store the int32 'v' in the element 'idx' of a typed array with
+   the ToUint8Clamp and modulo conversions */
+static inline void js_typed_array_store_int(JSObject *p, uint32_t idx,
+                                            int32_t v)
+{
+    switch(p->u.array.kind) {
+    case JS_ARRAY_KIND_UINT8C:
+        p->u.array.u.uint8s[idx] = v < 0 ? 0 : v > 255 ? 255 : v;
+        break;
+    case JS_ARRAY_KIND_INT8:
+    case JS_ARRAY_KIND_UINT8:
+        p->u.array.u.uint8s[idx] = v;
+        break;
+    case JS_ARRAY_KIND_INT16:
+    case JS_ARRAY_KIND_UINT16:
+        p->u.array.u.uint16s[idx] = v;
+        break;
+    case JS_ARRAY_KIND_INT32:
+    case JS_ARRAY_KIND_UINT32:
+        p->u.array.u.int32s[idx] = v;
+        break;
+    case JS_ARRAY_KIND_FLOAT32:
+        p->u.array.u.floats[idx] = v;
+        break;
+    default: /* JS_ARRAY_KIND_FLOAT64 */
+        p->u.array.u.doubles[idx] = v;
+        break;
+    }
+}
+
+/* same as js_typed_array_store_int() for a float64 (see typedarray.c) */
+void js_typed_array_store_double(JSObject *p, uint32_t idx, double d);
+
+/* store 'val' at 'idx' < u.array.count of a fast array if it fits the
+   kind of the elements. Return FALSE if not ('val' is not freed). */
+static inline BOOL js_array_set_fast(JSContext *ctx, JSObject *p,
+                                     uint32_t idx, JSValue val)
+{
+    JSValue old_val;
+    uint32_t tag;
+
+    tag = JS_VALUE_GET_TAG(val);
+    switch(p->u.array.kind) {
+    case JS_ARRAY_KIND_INT:
+        if (tag != JS_TAG_INT)
+            return FALSE;
+        p->u.array.u.int32s[idx] = JS_VALUE_GET_INT(val);
+        return TRUE;
+    case JS_ARRAY_KIND_DOUBLE:
+        if (tag == JS_TAG_INT)
+            p->u.array.u.doubles[idx] = JS_VALUE_GET_INT(val);
+        else if (JS_TAG_IS_FLOAT64(tag))
+            p->u.array.u.doubles[idx] = JS_VALUE_GET_FLOAT64(val);
+        else
+            return FALSE;
+        return TRUE;
+    case JS_ARRAY_KIND_VALUE:
+        old_val = p->u.array.u.values[idx];
+        p->u.array.u.values[idx] = val;
+        JS_FreeValue(ctx, old_val);
+        return TRUE;
+    default:
+        /* typed array: the other values are converted to numbers by
+           js_typed_array_set_element() */
+        if (tag == JS_TAG_INT)
+            js_typed_array_store_int(p, idx, JS_VALUE_GET_INT(val));
+        else if (JS_TAG_IS_FLOAT64(tag))
+            js_typed_array_store_double(p, idx, JS_VALUE_GET_FLOAT64(val));
+        else
+            return FALSE;
+        return TRUE;
+    }
+}
+
+/* shapes */
+int init_shape_hash(JSRuntime *rt);
+void free_shape_hash(JSRuntime *rt);
+/* the empty shape: hashed and shared */
+JSShape *js_new_shape(JSContext *ctx);
+void js_free_shape(JSRuntime *rt, JSShape *sh);
+/* add a property to 'p' and return the slot for its value. The value
+   is not initialized. Return NULL if exception. */
+JSProperty *add_property(JSContext *ctx, JSObject *p, JSAtom prop,
+                         int prop_flags);
+int delete_property(JSContext *ctx, JSObject *p, JSAtom atom);
+/* make the shape of 'p' private before modifying its properties */
+int js_shape_prepare_update(JSContext *ctx, JSObject *p,
+                            JSShapeProperty **pprs);
+/* make the shape of 'p' private with room for 'count' more properties:
+   the next 'count' add_property() calls cannot fail */
+int js_shape_reserve_properties(JSContext *ctx, JSObject *p, uint32_t count);
+/* memory used by the shape. A shared table counts for 1/n in each of
+   its n shapes. */
+double js_shape_size(JSShape *sh);
+
+/* objects */
+JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSObject *proto,
+                              JSClassEnum class_id);
+/* 'proto' is an object or null */
+JSValue JS_NewObjectProtoClass(JSContext *ctx, JSValueConst proto,
+                               JSClassEnum class_id);
+JSValue JS_NewObjectClass(JSContext *ctx, int class_id);
+void free_object(JSRuntime *rt, JSObject *p);
+void mark_object_children(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func);
+/* new object of class 'class_id' whose prototype is
+   new_target.prototype (the class prototype if undefined) */
+JSValue js_create_from_ctor(JSContext *ctx, JSValueConst new_target,
+                            int class_id);
+JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
+                               JSAtom prop, JSValueConst this_obj);
+/* new array of the 'len' values of 'tab'. The values are moved to the
+   array ('tab' is filled with undefined). */
+JSValue js_create_array(JSContext *ctx, int len, JSValue *tab);
+/* allocate at least 'new_len' elements to the fast array 'p' */
+int expand_fast_array(JSContext *ctx, JSObject *p, uint32_t new_len);
+/* set the element 'idx' <= u.array.count of a fast array ('val' is
+   appended if idx = u.array.count). Return -1 if exception. */
+int js_array_set_element(JSContext *ctx, JSObject *p, uint32_t idx,
+                         JSValue val);
+/* move the elements of a fast array to its properties */
+int convert_fast_array_to_array(JSContext *ctx, JSObject *p);
+/* 'flags' = JS_PROP_THROW or 0 (failures are silent in sloppy mode) */
+int JS_SetPropertyInternal(JSContext *ctx, JSValueConst this_obj,
+                           JSAtom prop, JSValue val, int flags);
+
+/* ArrayBuffer, typed arrays and DataView (see typedarray.c) */
+/* store 'val' converted to a number in the element 'idx' <
+   u.array.count of the typed array 'p'. Return -1 if exception. */
+int js_typed_array_set_element(JSContext *ctx, JSObject *p, uint32_t idx,
+                               JSValue val);
+void free_array_buffer(JSRuntime *rt, JSObject *p);
+void free_typed_array(JSRuntime *rt, JSObject *p);
+void mark_typed_array(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func);
+
+/* functions */
+/* C function whose prototype is 'proto' instead of Function.prototype */
+JSValue js_new_cfunction_proto(JSContext *ctx, JSCFunction *func,
+                               const char *name, int length,
+                               JSCFunctionEnum cproto, int magic,
+                               JSValueConst proto);
+void JS_SetConstructor(JSContext *ctx, JSValueConst func_obj,
+                       JSValueConst proto);
+/* define the 'length' and 'name' properties of a new function */
+int js_function_set_properties(JSContext *ctx, JSValueConst func_obj,
+                               JSAtom name, int len);
+JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
+                           JSValueConst this_obj,
+                           int argc, JSValueConst *argv,
+                           BOOL is_constructor_call);
+#define JS_CALL_FLAG_CONSTRUCTOR (1 << 0)
+#define JS_CALL_FLAG_COPY_ARGV   (1 << 1) /* 'argv' cannot be modified */
+#define JS_CALL_FLAG_GENERATOR   (1 << 2) /* resume the JSAsyncFrame 'func_obj' */
+/* call any function (see interpreter.c). 'new_target' is undefined
+   unless JS_CALL_FLAG_CONSTRUCTOR is set. */
+JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
+                        JSValueConst this_obj, JSValueConst new_target,
+                        int argc, JSValue *argv, int flags);
+JSValue JS_CallConstructorInternal(JSContext *ctx, JSValueConst func_obj,
+                                   JSValueConst new_target,
+                                   int argc, JSValue *argv, int flags);
+void free_var_ref(JSRuntime *rt, JSVarRef *var_ref);
+void free_bytecode_function(JSRuntime *rt, JSObject *p);
+void mark_bytecode_function(JSRuntime *rt, JSObject *p,
+                            JS_MarkFunc *mark_func);
+
+/* generators (see interpreter.c) */
+#define JS_GENERATOR_NEXT   0
+#define JS_GENERATOR_RETURN 1
+#define JS_GENERATOR_THROW  2
+/* next(), return() and throw() according to 'magic' */
+JSValue js_generator_next(JSContext *ctx, JSValueConst this_val,
+                          int argc, JSValueConst *argv, int magic);
+void free_generator(JSRuntime *rt, JSObject *p);
+void mark_generator(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func);
+void free_async_frame(JSRuntime *rt, JSAsyncFrame *af);
+void mark_async_frame(JSRuntime *rt, JSAsyncFrame *af,
+                      JS_MarkFunc *mark_func);
+void js_free_frame_pools(JSRuntime *rt);
+
+typedef struct JSCFunctionListEntry {
+    const char *name;
+    uint8_t length;
+    uint8_t cproto;
+    int16_t magic;
+    JSCFunctionType cfunc;
+} JSCFunctionListEntry;
+
+#define JS_CFUNC_DEF(name, length, func1) { name, length, JS_CFUNC_generic, 0, { .generic = func1 } }
+#define JS_CFUNC_MAGIC_DEF(name, length, func1, magic) { name, length, JS_CFUNC_generic_magic, magic, { .generic_magic = func1 } }
+
+/* define the functions as non enumerable properties of 'obj' */
+int JS_SetPropertyFunctionList(JSContext *ctx, JSValueConst obj,
+                               const JSCFunctionListEntry *tab, int len);
+
+#endif //QJS_OBJECT_H
@@ -0,0 +1,630 @@
+#include "context.h"
+
+#define JS_PROP_INITIAL_SIZE 2
+/* the objects with more properties get a private shape instead of
+   growing the transition tree */
+#define JS_SHAPE_TREE_MAX_PROPS 64
+
+static inline uint32_t shape_hash(uint32_t h, uint32_t val)
+{
+    return (h + val) * 0x9e370001;
+}
+
+/* truncate the shape hash to 'hash_bits' bits */
+static inline uint32_t get_shape_hash(uint32_t h, int hash_bits)
+{
+    return h >> (32 - hash_bits);
+}
+
+static inline uint32_t shape_initial_hash(void)
+{
+    return shape_hash(1, 0);
+}
+
+/* hash of the transition from 'parent' adding the property 'atom' */
+static inline uint32_t shape_transition_hash(JSShape *parent, JSAtom atom,
+                                             int prop_flags)
+{
+    uint32_t h;
+    h = shape_hash(shape_initial_hash(), (uintptr_t)parent >> 3);
+    return shape_hash(shape_hash(h, atom), prop_flags);
+}
+
+int init_shape_hash(JSRuntime *rt)
+{
+    rt->shape_hash_bits = 4;   /* 16 shapes */
+    rt->shape_hash_size = 1 << rt->shape_hash_bits;
+    rt->shape_hash_count = 0;
+    rt->shape_hash = js_mallocz_rt(rt, sizeof(rt->shape_hash[0]) *
+                                   rt->shape_hash_size);
+    if (!rt->shape_hash)
+        return -1;
+    return 0;
+}
+
+void free_shape_hash(JSRuntime *rt)
+{
+    assert(rt->shape_hash_count == 0);
+    js_free_rt(rt, rt->shape_hash);
+    rt->shape_hash = NULL;
+}
+
+static int resize_shape_hash(JSRuntime *rt, int new_shape_hash_bits)
+{
+    int new_shape_hash_size, i;
+    uint32_t h;
+    JSShape **new_shape_hash, *sh, *sh_next;
+
+    new_shape_hash_size = 1 << new_shape_hash_bits;
+    new_shape_hash = js_mallocz_rt(rt, sizeof(rt->shape_hash[0]) *
+                                   new_shape_hash_size);
+    if (!new_shape_hash)
+        return -1;
+    for(i = 0; i < rt->shape_hash_size; i++) {
+        for(sh = rt->shape_hash[i]; sh != NULL; sh = sh_next) {
+            sh_next = sh->shape_hash_next;
+            h = get_shape_hash(sh->hash, new_shape_hash_bits);
+            sh->shape_hash_next = new_shape_hash[h];
+            new_shape_hash[h] = sh;
+        }
+    }
+    js_free_rt(rt, rt->shape_hash);
+    rt->shape_hash_bits = new_shape_hash_bits;
+    rt->shape_hash_size = new_shape_hash_size;
+    rt->shape_hash = new_shape_hash;
+    return 0;
+}
+
+static void js_shape_hash_link(JSRuntime *rt, JSShape *sh)
+{
+    uint32_t h;
+
+    /* resize the shape hash table if necessary */
+    if (2 * (rt->shape_hash_count + 1) > rt->shape_hash_size) {
+        resize_shape_hash(rt, rt->shape_hash_bits + 1);
+    }
+    h = get_shape_hash(sh->hash, rt->shape_hash_bits);
+    sh->shape_hash_next = rt->shape_hash[h];
+    rt->shape_hash[h] = sh;
+    rt->shape_hash_count++;
+}
+
+static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
+{
+    uint32_t h;
+    JSShape **psh;
+
+    h = get_shape_hash(sh->hash, rt->shape_hash_bits);
+    psh = &rt->shape_hash[h];
+    while (*psh != sh)
+        psh = &(*psh)->shape_hash_next;
+    *psh = sh->shape_hash_next;
+    rt->shape_hash_count--;
+}
+
+/* property tables */
+
+static JSShapeTable *js_new_shape_table(JSContext *ctx, uint32_t size)
+{
+    JSShapeTable *tab;
+
+    tab = js_malloc(ctx, sizeof(*tab));
+    if (!tab)
+        return NULL;
+    tab->prop = js_malloc(ctx, sizeof(tab->prop[0]) * size);
+    if (!tab->prop) {
+        js_free(ctx, tab);
+        return NULL;
+    }
+    tab->ref_count = 1;
+    tab->count = 0;
+    tab->size = size;
+    tab->hash_mask = 0;
+    tab->hash = NULL;
+    return tab;
+}
+
+static void js_free_shape_table(JSRuntime *rt, JSShapeTable *tab)
+{
+    uint32_t i;
+
+    if (--tab->ref_count > 0)
+        return;
+    for(i = 0; i < tab->count; i++)
+        JS_FreeAtomRT(rt, tab->prop[i].atom);
+    js_free_rt(rt, tab->hash);
+    js_free_rt(rt, tab->prop);
+    js_free_rt(rt, tab);
+}
+
+static void shape_table_hash_add(JSShapeTable *tab, uint32_t idx)
+{
+    JSShapeProperty *pr;
+    uint32_t h;
+
+    pr = &tab->prop[idx];
+    h = (uintptr_t)pr->atom & tab->hash_mask;
+    pr->hash_next = tab->hash[h];
+    tab->hash[h] = idx + 1;
+}
+
+/* rebuild the hash table so that it holds at least 'count' properties */
+static int resize_shape_table_hash(JSContext *ctx, JSShapeTable *tab,
+                                   uint32_t count)
+{
+    uint32_t new_hash_size, *new_hash, i;
+
+    new_hash_size = 2 * JS_SHAPE_LINEAR_MAX;
+    while (new_hash_size < count)
+        new_hash_size = 2 * new_hash_size;
+    new_hash = js_mallocz(ctx, sizeof(new_hash[0]) * new_hash_size);
+    if (!new_hash)
+        return -1;
+    js_free(ctx, tab->hash);
+    tab->hash = new_hash;
+    tab->hash_mask = new_hash_size - 1;
+    for(i = 0; i < tab->count; i++) {
+        if (tab->prop[i].atom != JS_ATOM_NULL)
+            shape_table_hash_add(tab, i);
+    }
+    return 0;
+}
+
+/* append a property to the table */
+static int shape_table_add(JSContext *ctx, JSShapeTable *tab, JSAtom atom,
+                           int prop_flags)
+{
+    JSShapeProperty *pr;
+    uint32_t new_size;
+
+    if (unlikely(tab->count >= tab->size)) {
+        new_size = max_int(tab->count + 1, tab->size * 3 / 2);
+        pr = js_realloc(ctx, tab->prop, sizeof(tab->prop[0]) * new_size);
+        if (!pr)
+            return -1;
+        tab->prop = pr;
+        tab->size = new_size;
+    }
+    if (tab->count >= JS_SHAPE_LINEAR_MAX &&
+        (!tab->hash || tab->count >= tab->hash_mask + 1)) {
+        if (resize_shape_table_hash(ctx, tab, tab->count + 1))
+            return -1;
+    }
+    pr = &tab->prop[tab->count];
+    pr->atom = JS_DupAtom(ctx, atom);
+    pr->flags = prop_flags;
+    pr->hash_next = 0;
+    if (tab->hash)
+        shape_table_hash_add(tab, tab->count);
+    tab->count++;
+    return 0;
+}
+
+/* private copy of the 'count' first properties of 'tab1' */
+static JSShapeTable *js_clone_shape_table(JSContext *ctx, JSShapeTable *tab1,
+                                          uint32_t count, uint32_t size)
+{
+    JSShapeTable *tab;
+    uint32_t i;
+
+    tab = js_new_shape_table(ctx, max_int(size, count));
+    if (!tab)
+        return NULL;
+    memcpy(tab->prop, tab1->prop, sizeof(tab->prop[0]) * count);
+    for(i = 0; i < count; i++)
+        JS_DupAtom(ctx, tab->prop[i].atom);
+    tab->count = count;
+    if (count > JS_SHAPE_LINEAR_MAX) {
+        if (resize_shape_table_hash(ctx, tab, count)) {
+            js_free_shape_table(ctx->rt, tab);
+            return NULL;
+        }
+    }
+    return tab;
+}
+
+/* shapes */
+
+/* takes ownership of the table reference */
+static JSShape *js_alloc_shape(JSContext *ctx, JSShapeTable *tab,
+                               int prop_count, int prop_size)
+{
+    JSShape *sh;
+
+    sh = js_malloc_gc(ctx, sizeof(*sh));
+    if (!sh) {
+        js_free_shape_table(ctx->rt, tab);
+        return NULL;
+    }
+    sh->header.ref_count = 1;
+    sh->account_id = ctx->mem_account->id;
+    sh->is_hashed = FALSE;
+    sh->hash = 0;
+    js_shape_new_version(ctx->rt, sh);
+    sh->prop_size = prop_size;
+    sh->prop_count = prop_count;
+    sh->deleted_prop_count = 0;
+    sh->parent = NULL;
+    sh->shape_hash_next = NULL;
+    sh->table = tab;
+    return sh;
+}
+
+JSShape *js_new_shape(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+    JSShapeTable *tab;
+    JSShape *sh;
+    uint32_t h;
+
+    /* root of the transition tree */
+    h = shape_initial_hash();
+    for(sh = rt->shape_hash[get_shape_hash(h, rt->shape_hash_bits)];
+        sh != NULL; sh = sh->shape_hash_next) {
+        if (sh->hash == h && !sh->parent)
+            return js_dup_shape(sh);
+    }
+    tab = js_new_shape_table(ctx, JS_PROP_INITIAL_SIZE);
+    if (!tab)
+        return NULL;
+    sh = js_alloc_shape(ctx, tab, 0, JS_PROP_INITIAL_SIZE);
+    if (!sh)
+        return NULL;
+    sh->hash = h;
+    sh->is_hashed = TRUE;
+    js_shape_hash_link(rt, sh);
+    return sh;
+}
+
+/* The shape is cloned with a private table. The new shape is not
+   inserted in the transition tree */
+static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
+{
+    JSShapeTable *tab;
+    JSShape *sh;
+
+    tab = js_clone_shape_table(ctx, sh1->table, sh1->prop_count,
+                               sh1->prop_size);
+    if (!tab)
+        return NULL;
+    sh = js_alloc_shape(ctx, tab, sh1->prop_count, sh1->prop_size);
+    if (!sh)
+        return NULL;
+    sh->deleted_prop_count = sh1->deleted_prop_count;
+    return sh;
+}
+
+static void js_free_shape0(JSRuntime *rt, JSShape *sh)
+{
+    JSShape *parent;
+
+    /* iterative so that the long transition chains can be freed */
+    for(;;) {
+        assert(sh->header.ref_count == 0);
+        if (sh->is_hashed)
+            js_shape_hash_unlink(rt, sh);
+        parent = sh->parent;
+        js_free_shape_table(rt, sh->table);
+        js_free_gc_rt(rt, sh, sh->account_id);
+        if (!parent || --parent->header.ref_count > 0)
+            break;
+        sh = parent;
+    }
+}
+
+void js_free_shape(JSRuntime *rt, JSShape *sh)
+{
+    if (unlikely(--sh->header.ref_count <= 0)) {
+        js_free_shape0(rt, sh);
+    }
+}
+
+double js_shape_size(JSShape *sh)
+{
+    JSShapeTable *tab = sh->table;
+    size_t size;
+
+    size = sizeof(*tab) + tab->size * sizeof(tab->prop[0]);
+    if (tab->hash)
+        size += (tab->hash_mask + 1) * sizeof(tab->hash[0]);
+    return sizeof(*sh) + (double)size / tab->ref_count;
+}
+
+/* find the child of 'sh' with the property 'atom' */
+static JSShape *find_shape_transition(JSRuntime *rt, JSShape *sh,
+                                      JSAtom atom, int prop_flags)
+{
+    JSShape *sh1;
+    JSShapeProperty *pr;
+    uint32_t h;
+
+    h = shape_transition_hash(sh, atom, prop_flags);
+    for(sh1 = rt->shape_hash[get_shape_hash(h, rt->shape_hash_bits)];
+        sh1 != NULL; sh1 = sh1->shape_hash_next) {
+        if (sh1->hash == h && sh1->parent == sh) {
+            pr = &get_shape_prop(sh1)[sh1->prop_count - 1];
+            if (pr->atom == atom && pr->flags == prop_flags)
+                return sh1;
+        }
+    }
+    return NULL;
+}
+
+/* new child of 'sh' with the property 'atom' */
+static JSShape *js_new_shape_transition(JSContext *ctx, JSShape *sh,
+                                        JSAtom atom, int prop_flags)
+{
+    JSShapeTable *tab;
+    JSShape *new_sh;
+    int prop_size;
+
+    tab = sh->table;
+    if (tab->count == sh->prop_count) {
+        /* no other child uses the next entries: share the table */
+        if (shape_table_add(ctx, tab, atom, prop_flags))
+            return NULL;
+        tab->ref_count++;
+    } else {
+        tab = js_clone_shape_table(ctx, tab, sh->prop_count,
+                                   sh->prop_count + 1);
+        if (!tab)
+            return NULL;
+        if (shape_table_add(ctx, tab, atom, prop_flags)) {
+            js_free_shape_table(ctx->rt, tab);
+            return NULL;
+        }
+    }
+    prop_size = sh->prop_size;
+    if (sh->prop_count >= prop_size)
+        prop_size = max_int(sh->prop_count + 1, prop_size * 3 / 2);
+    new_sh = js_alloc_shape(ctx, tab, sh->prop_count + 1, prop_size);
+    if (!new_sh)
+        return NULL;
+    new_sh->parent = js_dup_shape(sh);
+    new_sh->hash = shape_transition_hash(sh, atom, prop_flags);
+    new_sh->is_hashed = TRUE;
+    js_shape_hash_link(ctx->rt, new_sh);
+    return new_sh;
+}
+
+/* remove the deleted properties */
+static int compact_properties(JSContext *ctx, JSObject *p)
+{
+    JSShape *sh;
+    JSShapeTable *tab, *old_tab;
+    uint32_t i, j, new_size;
+    JSShapeProperty *old_pr;
+    JSProperty *prop, *new_prop;
+
+    sh = p->shape;
+    assert(!sh->is_hashed);
+
+    new_size = max_int(JS_PROP_INITIAL_SIZE,
+                       sh->prop_count - sh->deleted_prop_count);
+    assert(new_size <= sh->prop_size);
+
+    tab = js_new_shape_table(ctx, new_size);
+    if (!tab)
+        return -1;
+    j = sh->prop_count - sh->deleted_prop_count;
+    if (j > JS_SHAPE_LINEAR_MAX && resize_shape_table_hash(ctx, tab, j)) {
+        js_free_shape_table(ctx->rt, tab);
+        return -1;
+    }
+    old_tab = sh->table;
+    j = 0;
+    old_pr = old_tab->prop;
+    prop = p->prop;
+    for(i = 0; i < sh->prop_count; i++) {
+        if (old_pr->atom != JS_ATOM_NULL) {
+            /* the atom reference is moved */
+            tab->prop[j].atom = old_pr->atom;
+            tab->prop[j].flags = old_pr->flags;
+            tab->prop[j].hash_next = 0;
+            if (tab->hash)
+                shape_table_hash_add(tab, j);
+            old_pr->atom = JS_ATOM_NULL;
+            prop[j] = prop[i];
+            j++;
+        }
+        old_pr++;
+    }
+    assert(j == (sh->prop_count - sh->deleted_prop_count));
+    tab->count = j;
+    js_free_shape_table(ctx->rt, old_tab);
+    sh->table = tab;
+    sh->prop_size = new_size;
+    sh->deleted_prop_count = 0;
+    sh->prop_count = j;
+    js_shape_new_version(ctx->rt, sh);
+
+    /* reduce the size of the object properties */
+    new_prop = js_realloc(ctx, p->prop, sizeof(new_prop[0]) * new_size);
+    if (new_prop)
+        p->prop = new_prop;
+    return 0;
+}
+
+/* add a property to the private shape of 'p' */
+static int add_shape_property(JSContext *ctx, JSObject *p, JSAtom atom,
+                              int prop_flags)
+{
+    JSShape *sh = p->shape;
+    JSProperty *new_prop;
+    uint32_t new_size;
+
+    assert(!sh->is_hashed && sh->header.ref_count == 1);
+    if (unlikely(sh->prop_count >= sh->prop_size)) {
+        new_size = max_int(sh->prop_count + 1, sh->prop_size * 3 / 2);
+        new_prop = js_realloc(ctx, p->prop, sizeof(new_prop[0]) * new_size);
+        if (unlikely(!new_prop))
+            return -1;
+        p->prop = new_prop;
+        sh->prop_size = new_size;
+    }
+    if (shape_table_add(ctx, sh->table, atom, prop_flags))
+        return -1;
+    /* The object property at p->prop[sh->prop_count] is uninitialized */
+    sh->prop_count++;
+    js_shape_new_version(ctx->rt, sh);
+    return 0;
+}
+
+JSProperty *add_property(JSContext *ctx, JSObject *p, JSAtom prop,
+                         int prop_flags)
+{
+    JSShape *sh, *new_sh;
+
+    sh = p->shape;
+    if (sh->is_hashed && sh->prop_count < JS_SHAPE_TREE_MAX_PROPS) {
+        /* follow or create the transition */
+        new_sh = find_shape_transition(ctx->rt, sh, prop, prop_flags);
+        if (new_sh) {
+            js_dup_shape(new_sh);
+        } else {
+            new_sh = js_new_shape_transition(ctx, sh, prop, prop_flags);
+            if (!new_sh)
+                return NULL;
+        }
+        /*  the property array may need to be resized */
+        if (new_sh->prop_size != sh->prop_size) {
+            JSProperty *new_prop;
+            new_prop = js_realloc(ctx, p->prop, sizeof(p->prop[0]) *
+                                  new_sh->prop_size);
+            if (!new_prop) {
+                js_free_shape(ctx->rt, new_sh);
+                return NULL;
+            }
+            p->prop = new_prop;
+        }
+        p->shape = new_sh;
+        js_free_shape(ctx->rt, sh);
+        return &p->prop[new_sh->prop_count - 1];
+    }
+    if (sh->is_hashed || sh->header.ref_count != 1) {
+        /* if the shape is shared, clone it */
+        new_sh = js_clone_shape(ctx, sh);
+        if (!new_sh)
+            return NULL;
+        js_free_shape(ctx->rt, p->shape);
+        p->shape = new_sh;
+    }
+    if (add_shape_property(ctx, p, prop, prop_flags))
+        return NULL;
+    return &p->prop[p->shape->prop_count - 1];
+}
+
+int js_shape_prepare_update(JSContext *ctx, JSObject *p,
+                            JSShapeProperty **pprs)
+{
+    JSShape *sh;
+    uint32_t idx = 0;    /* prevent warning */
+
+    sh = p->shape;
+    if (sh->is_hashed || sh->header.ref_count != 1) {
+        if (pprs)
+            idx = *pprs - get_shape_prop(sh);
+        /* clone the shape (the resulting one is not in the tree) */
+        sh = js_clone_shape(ctx, sh);
+        if (!sh)
+            return -1;
+        js_free_shape(ctx->rt, p->shape);
+        p->shape = sh;
+        if (pprs)
+            *pprs = get_shape_prop(sh) + idx;
+    } else {
+        /* the caller modifies the shape in place */
+        js_shape_new_version(ctx->rt, sh);
+    }
+    return 0;
+}
+
+int js_shape_reserve_properties(JSContext *ctx, JSObject *p, uint32_t count)
+{
+    JSShape *sh;
+    JSShapeTable *tab;
+    JSShapeProperty *new_pr;
+    JSProperty *new_prop;
+    uint32_t new_size;
+
+    if (js_shape_prepare_update(ctx, p, NULL))
+        return -1;
+    sh = p->shape;
+    tab = sh->table;
+    /* a private shape has a private table */
+    assert(tab->ref_count == 1 && tab->count == sh->prop_count);
+    new_size = sh->prop_count + count;
+    if (new_size > sh->prop_size) {
+        new_prop = js_realloc(ctx, p->prop, sizeof(new_prop[0]) * new_size);
+        if (!new_prop)
+            return -1;
+        p->prop = new_prop;
+        sh->prop_size = new_size;
+    }
+    if (new_size > tab->size) {
+        new_pr = js_realloc(ctx, tab->prop, sizeof(new_pr[0]) * new_size);
+        if (!new_pr)
+            return -1;
+        tab->prop = new_pr;
+        tab->size = new_size;
+    }
+    if (new_size > JS_SHAPE_LINEAR_MAX &&
+        (!tab->hash || new_size > tab->hash_mask + 1)) {
+        if (resize_shape_table_hash(ctx, tab, new_size))
+            return -1;
+    }
+    return 0;
+}
+
+/* return -1 if exception, FALSE if the property is not configurable
+   and TRUE otherwise */
+int delete_property(JSContext *ctx, JSObject *p, JSAtom atom)
+{
+    JSShape *sh;
+    JSShapeTable *tab;
+    JSShapeProperty *pr, *lpr, *prop;
+    JSProperty *pr1;
+    uint32_t idx, h, h1;
+
+    pr = find_own_property(&pr1, p, atom);
+    if (!pr)
+        return TRUE; /* not found */
+    if (!(pr->flags & JS_PROP_CONFIGURABLE))
+        return FALSE;
+    /* realloc the shape if needed */
+    if (js_shape_prepare_update(ctx, p, &pr))
+        return -1;
+    sh = p->shape;
+    tab = sh->table;
+    prop = get_shape_prop(sh);
+    idx = pr - prop;
+    /* remove property */
+    if (tab->hash) {
+        h1 = (uintptr_t)atom & tab->hash_mask;
+        h = tab->hash[h1];
+        lpr = NULL;
+        while (h != idx + 1) {
+            lpr = &prop[h - 1];
+            h = lpr->hash_next;
+        }
+        if (lpr)
+            lpr->hash_next = pr->hash_next;
+        else
+            tab->hash[h1] = pr->hash_next;
+    }
+    sh->deleted_prop_count++;
+    /* free the entry */
+    pr1 = &p->prop[idx];
+    JS_FreeValue(ctx, pr1->value);
+    JS_FreeAtom(ctx, pr->atom);
+    /* put default values */
+    pr->flags = 0;
+    pr->atom = JS_ATOM_NULL;
+    pr1->value = JS_UNDEFINED;
+
+    /* compact the properties if too many deleted properties */
+    if (sh->deleted_prop_count >= 8 &&
+        sh->deleted_prop_count >= ((unsigned)sh->prop_count / 2))
+        compact_properties(ctx, p);
+    return TRUE;
+}
@@ -0,0 +1,1095 @@
+#include <math.h>
+#include "context.h"
+
+/* ArrayBuffer, typed arrays and DataView.
+
+   The typed arrays are fast arrays (see object.h) whose u.array.u.ptr
+   points into the data of their ArrayBuffer: the element accesses of
+   the interpreter and of the machine code read and write the host
+   memory in place. There is no detach and no resizing: the data of an
+   ArrayBuffer lives as long as the ArrayBuffer object. */
+
+#if defined(__SSE2__) && !defined(CONFIG_TYPED_ARRAY_NO_SIMD)
+#define TYPED_ARRAY_SIMD
+#include <emmintrin.h>
+#endif
+
+/* log2 of the element size, indexed by kind - JS_ARRAY_KIND_UINT8C */
+static const uint8_t typed_array_size_log2[] = {
+    0, 0, 0, 1, 1, 2, 2, 2, 3,
+};
+
+static const char * const typed_array_names[] = {
+    "Uint8ClampedArray", "Int8Array", "Uint8Array",
+    "Int16Array", "Uint16Array", "Int32Array", "Uint32Array",
+    "Float32Array", "Float64Array",
+};
+
+static inline int js_typed_array_size_log2(int kind)
+{
+    return typed_array_size_log2[kind - JS_ARRAY_KIND_UINT8C];
+}
+
+static inline BOOL js_is_little_endian(void)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return FALSE;
+#else
+    return TRUE;
+#endif
+}
+
+/* kernels */
+
+/* store the element 0 of 'tab' in the elements [1, count) */
+static void js_fill_elements(uint8_t *tab, uint32_t count, int size_log2)
+{
+    size_t size = (size_t)1 << size_log2, len = (size_t)count << size_log2;
+    uint8_t *p, *end = tab + len;
+    uint64_t v = 0;
+    size_t i;
+
+    for(i = 1; i < size && tab[i] == tab[0]; i++)
+        continue;
+    if (i == size) {
+        /* a single byte repeated (e.g. 0) */
+        memset(tab, tab[0], len);
+        return;
+    }
+    memcpy(&v, tab, size);
+    p = tab + size;
+#ifdef TYPED_ARRAY_SIMD
+    {
+        __m128i vv;
+        switch(size_log2) {
+        case 1:
+            vv = _mm_set1_epi16((short)v);
+            break;
+        case 2:
+            vv = _mm_set1_epi32((int)v);
+            break;
+        default:
+            vv = _mm_set1_epi64x((long long)v);
+            break;
+        }
+        /* the pattern starts at 'tab': the stores start at an element
+           boundary after it */
+        while (end - p >= 16) {
+            _mm_storeu_si128((__m128i *)p, vv);
+            p += 16;
+        }
+    }
+#endif
+    for(; p < end; p += size)
+        memcpy(p, &v, size);
+}
+
+/* index of the first element equal to 'v' (element bits) in [k, len),
+   or -1 */
+static int js_find_element(const uint8_t *tab, uint32_t k, uint32_t len,
+                           int size_log2, uint64_t v)
+{
+    const uint8_t *p = tab + ((size_t)k << size_log2);
+    const uint8_t *end = tab + ((size_t)len << size_log2);
+#ifdef TYPED_ARRAY_SIMD
+    __m128i vv, x, m;
+    unsigned int mask;
+
+    switch(size_log2) {
+    case 0:
+        vv = _mm_set1_epi8((char)v);
+        break;
+    case 1:
+        vv = _mm_set1_epi16((short)v);
+        break;
+    case 2:
+        vv = _mm_set1_epi32((int)v);
+        break;
+    default:
+        vv = _mm_set1_epi64x((long long)v);
+        break;
+    }
+    while (end - p >= 16) {
+        x = _mm_loadu_si128((const __m128i *)p);
+        switch(size_log2) {
+        case 0:
+            m = _mm_cmpeq_epi8(x, vv);
+            break;
+        case 1:
+            m = _mm_cmpeq_epi16(x, vv);
+            break;
+        case 2:
+            m = _mm_cmpeq_epi32(x, vv);
+            break;
+        default:
+            /* no 64 bit compare in SSE2: both halves must be equal */
+            m = _mm_cmpeq_epi32(x, vv);
+            m = _mm_and_si128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+            break;
+        }
+        mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return (p - tab + ctz32(mask)) >> size_log2;
+        p += 16;
+    }
+#endif
+    switch(size_log2) {
+    case 0:
+        for(; p < end; p++) {
+            if (*p == (uint8_t)v)
+                return p - tab;
+        }
+        break;
+    case 1:
+        for(; p < end; p += 2) {
+            if (*(const uint16_t *)p == (uint16_t)v)
+                return (p - tab) >> 1;
+        }
+        break;
+    case 2:
+        for(; p < end; p += 4) {
+            if (*(const uint32_t *)p == (uint32_t)v)
+                return (p - tab) >> 2;
+        }
+        break;
+    default:
+        for(; p < end; p += 8) {
+            if (*(const uint64_t *)p == v)
+                return (p - tab) >> 3;
+        }
+        break;
+    }
+    return -1;
+}
+
+/* conversions */
+
+void js_typed_array_store_double(JSObject *p, uint32_t idx, double d)
+{
+    switch(p->u.array.kind) {
+    case JS_ARRAY_KIND_UINT8C:
+        /* ToUint8Clamp: NaN is 0, the ties are rounded to even */
+        if (!(d > 0))
+            p->u.array.u.uint8s[idx] = 0;
+        else if (d >= 255)
+            p->u.array.u.uint8s[idx] = 255;
+        else
+            p->u.array.u.uint8s[idx] = lrint(d);
+        break;
+    case JS_ARRAY_KIND_INT8:
+    case JS_ARRAY_KIND_UINT8:
+        p->u.array.u.uint8s[idx] = js_double_to_int32(d);
+        break;
+    case JS_ARRAY_KIND_INT16:
+    case JS_ARRAY_KIND_UINT16:
+        p->u.array.u.uint16s[idx] = js_double_to_int32(d);
+        break;
+    case JS_ARRAY_KIND_INT32:
+    case JS_ARRAY_KIND_UINT32:
+        p->u.array.u.int32s[idx] = js_double_to_int32(d);
+        break;
+    case JS_ARRAY_KIND_FLOAT32:
+        p->u.array.u.floats[idx] = d;
+        break;
+    default: /* JS_ARRAY_KIND_FLOAT64 */
+        p->u.array.u.doubles[idx] = d;
+        break;
+    }
+}
+
+int js_typed_array_set_element(JSContext *ctx, JSObject *p, uint32_t idx,
+                               JSValue val)
+{
+    double d;
+    int ret;
+
+    /* the length of a typed array does not change: 'idx' stays valid
+       if 'valueOf' runs */
+    ret = JS_ToFloat64(ctx, &d, val);
+    JS_FreeValue(ctx, val);
+    if (ret)
+        return -1;
+    js_typed_array_store_double(p, idx, d);
+    return TRUE;
+}
+
+/* store the 'len' elements of kind 'src_kind' at 'src' from the element
+   'idx' of 'p' */
+static void js_typed_array_convert(JSObject *p, uint32_t idx, int src_kind,
+                                   const void *src, uint32_t len)
+{
+    uint32_t i;
+
+    switch(src_kind) {
+    case JS_ARRAY_KIND_UINT8C:
+    case JS_ARRAY_KIND_UINT8:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_int(p, idx + i, ((const uint8_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_INT8:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_int(p, idx + i, ((const int8_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_INT16:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_int(p, idx + i, ((const int16_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_UINT16:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_int(p, idx + i, ((const uint16_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_INT:
+    case JS_ARRAY_KIND_INT32:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_int(p, idx + i, ((const int32_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_UINT32:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_double(p, idx + i, ((const uint32_t *)src)[i]);
+        break;
+    case JS_ARRAY_KIND_FLOAT32:
+        for(i = 0; i < len; i++)
+            js_typed_array_store_double(p, idx + i, ((const float *)src)[i]);
+        break;
+    default: /* JS_ARRAY_KIND_DOUBLE, JS_ARRAY_KIND_FLOAT64 */
+        for(i = 0; i < len; i++)
+            js_typed_array_store_double(p, idx + i, ((const double *)src)[i]);
+        break;
+    }
+}
+
+/* TRUE if the elements of kind 'src_kind' are copied as is to the kind
+   'dst_kind' */
+static BOOL js_typed_array_same_bits(int dst_kind, int src_kind)
+{
+    if (dst_kind == src_kind)
+        return TRUE;
+    if (dst_kind >= JS_ARRAY_KIND_FLOAT32 || src_kind >= JS_ARRAY_KIND_FLOAT32)
+        return FALSE;
+    /* the negative Int8 values are clamped */
+    if (dst_kind == JS_ARRAY_KIND_UINT8C && src_kind == JS_ARRAY_KIND_INT8)
+        return FALSE;
+    return js_typed_array_size_log2(dst_kind) ==
+        js_typed_array_size_log2(src_kind);
+}
+
+/* ToIndex */
+static int js_to_index(JSContext *ctx, uint32_t *pres, JSValueConst val,
+                       const char *name)
+{
+    double d;
+
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT) {
+        d = JS_VALUE_GET_INT(val);
+    } else if (JS_IsUndefined(val)) {
+        d = 0;
+    } else {
+        if (JS_ToFloat64(ctx, &d, val))
+            return -1;
+        d = isnan(d) ? 0 : trunc(d);
+    }
+    if (d < 0 || d > INT32_MAX) {
+        JS_ThrowRangeError(ctx, "invalid %s", name);
+        return -1;
+    }
+    *pres = d;
+    return 0;
+}
+
+/* relative index of the slice methods: the negative values count from
+   'len'. The result is clamped to [0, len]. */
+static int js_to_relative_index(JSContext *ctx, uint32_t *pres,
+                                JSValueConst val, uint32_t len,
+                                uint32_t def_val)
+{
+    double d;
+
+    if (JS_IsUndefined(val)) {
+        *pres = def_val;
+        return 0;
+    }
+    if (JS_ToFloat64(ctx, &d, val))
+        return -1;
+    d = isnan(d) ? 0 : trunc(d);
+    if (d < 0) {
+        d += len;
+        if (d < 0)
+            d = 0;
+    } else if (d > len) {
+        d = len;
+    }
+    *pres = d;
+    return 0;
+}
+
+/* ArrayBuffer */
+
+static void js_array_buffer_free(JSRuntime *rt, void *opaque, void *ptr)
+{
+    js_free_rt(rt, ptr);
+}
+
+void free_array_buffer(JSRuntime *rt, JSObject *p)
+{
+    JSArrayBuffer *abuf = p->u.array_buffer;
+
+    /* NULL if the creation failed */
+    if (!abuf)
+        return;
+    if (abuf->free_func)
+        abuf->free_func(rt, abuf->opaque, abuf->data);
+    js_free_rt(rt, abuf);
+    p->u.array_buffer = NULL;
+}
+
+/* 'buf' is not freed if exception */
+static JSValue js_array_buffer_new(JSContext *ctx, JSValueConst new_target,
+                                   uint8_t *buf, uint32_t len,
+                                   JSFreeArrayBufferDataFunc *free_func,
+                                   void *opaque)
+{
+    JSValue obj;
+    JSObject *p;
+    JSProperty *pr;
+    JSArrayBuffer *abuf;
+
+    obj = js_create_from_ctor(ctx, new_target, JS_CLASS_ARRAY_BUFFER);
+    if (JS_IsException(obj))
+        return obj;
+    p = JS_VALUE_GET_OBJ(obj);
+    pr = add_property(ctx, p, JS_ATOM_byteLength, 0);
+    if (!pr)
+        goto fail;
+    pr->value = JS_NewInt32(ctx, len);
+    abuf = js_malloc(ctx, sizeof(*abuf));
+    if (!abuf)
+        goto fail;
+    abuf->byte_length = len;
+    abuf->data = buf;
+    abuf->free_func = free_func;
+    abuf->opaque = opaque;
+    p->u.array_buffer = abuf;
+    return obj;
+ fail:
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+/* ArrayBuffer of 'len' zero bytes */
+static JSValue js_array_buffer_alloc(JSContext *ctx, JSValueConst new_target,
+                                     uint32_t len)
+{
+    JSValue obj;
+    uint8_t *buf;
+
+    buf = js_mallocz(ctx, max_int(len, 1));
+    if (!buf)
+        return JS_EXCEPTION;
+    obj = js_array_buffer_new(ctx, new_target, buf, len,
+                              js_array_buffer_free, NULL);
+    if (JS_IsException(obj))
+        js_free(ctx, buf);
+    return obj;
+}
+
+JSValue JS_NewArrayBuffer(JSContext *ctx, uint8_t *buf, size_t len,
+                          JSFreeArrayBufferDataFunc *free_func, void *opaque)
+{
+    if (len > INT32_MAX)
+        return JS_ThrowRangeError(ctx, "invalid array buffer length");
+    return js_array_buffer_new(ctx, JS_UNDEFINED, buf, len, free_func, opaque);
+}
+
+JSValue JS_NewArrayBufferCopy(JSContext *ctx, const uint8_t *buf, size_t len)
+{
+    JSValue obj;
+
+    if (len > INT32_MAX)
+        return JS_ThrowRangeError(ctx, "invalid array buffer length");
+    obj = js_array_buffer_alloc(ctx, JS_UNDEFINED, len);
+    if (!JS_IsException(obj) && len != 0)
+        memcpy(JS_VALUE_GET_OBJ(obj)->u.array_buffer->data, buf, len);
+    return obj;
+}
+
+static JSArrayBuffer *js_get_array_buffer(JSContext *ctx, JSValueConst obj)
+{
+    if (!JS_IsObject(obj) ||
+        JS_VALUE_GET_OBJ(obj)->class_id != JS_CLASS_ARRAY_BUFFER) {
+        JS_ThrowTypeError(ctx, "not an ArrayBuffer");
+        return NULL;
+    }
+    return JS_VALUE_GET_OBJ(obj)->u.array_buffer;
+}
+
+uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj)
+{
+    JSArrayBuffer *abuf;
+
+    abuf = js_get_array_buffer(ctx, obj);
+    if (!abuf) {
+        *psize = 0;
+        return NULL;
+    }
+    *psize = abuf->byte_length;
+    return abuf->data;
+}
+
+static JSValue js_array_buffer_constructor(JSContext *ctx,
+                                           JSValueConst new_target,
+                                           int argc, JSValueConst *argv)
+{
+    uint32_t len;
+
+    if (JS_IsUndefined(new_target))
+        return JS_ThrowTypeError(ctx, "constructor requires 'new'");
+    if (js_to_index(ctx, &len, argv[0], "array buffer length"))
+        return JS_EXCEPTION;
+    return js_array_buffer_alloc(ctx, new_target, len);
+}
+
+static JSValue js_array_buffer_slice(JSContext *ctx, JSValueConst this_val,
+                                     int argc, JSValueConst *argv)
+{
+    JSArrayBuffer *abuf;
+    uint32_t start, end;
+    JSValue obj;
+
+    abuf = js_get_array_buffer(ctx, this_val);
+    if (!abuf)
+        return JS_EXCEPTION;
+    if (js_to_relative_index(ctx, &start, argv[0], abuf->byte_length, 0) ||
+        js_to_relative_index(ctx, &end, argv[1], abuf->byte_length,
+                             abuf->byte_length))
+        return JS_EXCEPTION;
+    if (end < start)
+        end = start;
+    obj = js_array_buffer_alloc(ctx, JS_UNDEFINED, end - start);
+    if (!JS_IsException(obj) && end != start)
+        memcpy(JS_VALUE_GET_OBJ(obj)->u.array_buffer->data,
+               abuf->data + start, end - start);
+    return obj;
+}
+
+/* typed arrays and DataView */
+
+void free_typed_array(JSRuntime *rt, JSObject *p)
+{
+    if (p->u.array.buffer)
+        JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_OBJECT, p->u.array.buffer));
+    p->u.array.buffer = NULL;
+    p->u.array.u.ptr = NULL;
+    p->u.array.count = 0;
+}
+
+void mark_typed_array(JSRuntime *rt, JSObject *p, JS_MarkFunc *mark_func)
+{
+    if (p->u.array.buffer)
+        mark_func(rt, &p->u.array.buffer->header);
+}
+
+/* view of 'len' elements (bytes for a DataView) at 'offset' in the
+   ArrayBuffer 'buffer'. The bounds are checked by the caller. */
+static JSValue js_typed_array_new(JSContext *ctx, JSValueConst new_target,
+                                  int class_id, JSValueConst buffer,
+                                  uint32_t offset, uint32_t len)
+{
+    JSObject *p, *pbuf = JS_VALUE_GET_OBJ(buffer);
+    JSProperty *pr;
+    JSValue obj;
+    uint32_t byte_len;
+
+    obj = js_create_from_ctor(ctx, new_target, class_id);
+    if (JS_IsException(obj))
+        return obj;
+    p = JS_VALUE_GET_OBJ(obj);
+    p->u.array.buffer = pbuf;
+    pbuf->header.ref_count++;
+    p->u.array.u.uint8s = pbuf->u.array_buffer->data + offset;
+    p->u.array.count = len;
+    byte_len = len;
+    if (class_id != JS_CLASS_DATAVIEW) {
+        byte_len <<= js_typed_array_size_log2(p->u.array.kind);
+        pr = add_property(ctx, p, JS_ATOM_length, 0);
+        if (!pr)
+            goto fail;
+        pr->value = JS_NewInt32(ctx, len);
+    }
+    pr = add_property(ctx, p, JS_ATOM_byteLength, 0);
+    if (!pr)
+        goto fail;
+    pr->value = JS_NewInt32(ctx, byte_len);
+    pr = add_property(ctx, p, JS_ATOM_byteOffset, 0);
+    if (!pr)
+        goto fail;
+    pr->value = JS_NewInt32(ctx, offset);
+    pr = add_property(ctx, p, JS_ATOM_buffer, 0);
+    if (!pr)
+        goto fail;
+    pr->value = JS_DupValue(ctx, buffer);
+    return obj;
+ fail:
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+/* typed array of 'len' elements in a new ArrayBuffer */
+static JSValue js_typed_array_alloc(JSContext *ctx, JSValueConst new_target,
+                                    int class_id, uint32_t len)
+{
+    int size_log2;
+    JSValue buffer, obj;
+
+    size_log2 = typed_array_size_log2[class_id - JS_CLASS_UINT8C_ARRAY];
+    if (len > (INT32_MAX >> size_log2))
+        return JS_ThrowRangeError(ctx, "invalid length");
+    buffer = js_array_buffer_alloc(ctx, JS_UNDEFINED, len << size_log2);
+    if (JS_IsException(buffer))
+        return buffer;
+    obj = js_typed_array_new(ctx, new_target, class_id, buffer, 0, len);
+    JS_FreeValue(ctx, buffer);
+    return obj;
+}
+
+static JSObject *js_get_typed_array(JSContext *ctx, JSValueConst obj)
+{
+    if (!JS_IsObject(obj) ||
+        !js_class_is_typed_array(JS_VALUE_GET_OBJ(obj)->class_id)) {
+        JS_ThrowTypeError(ctx, "not a TypedArray");
+        return NULL;
+    }
+    return JS_VALUE_GET_OBJ(obj);
+}
+
+static int js_array_like_length(JSContext *ctx, uint32_t *plen,
+                                JSValueConst obj)
+{
+    JSValue val;
+    int ret;
+
+    val = JS_GetProperty(ctx, obj, JS_ATOM_length);
+    if (JS_IsException(val))
+        return -1;
+    ret = js_to_index(ctx, plen, val, "length");
+    JS_FreeValue(ctx, val);
+    return ret;
+}
+
+/* store the 'len' first elements of the object 'src' from the element
+   'idx' of the typed array 'p' */
+static int js_typed_array_copy_from(JSContext *ctx, JSObject *p, uint32_t idx,
+                                    JSValueConst src, uint32_t len)
+{
+    JSObject *ps = JS_VALUE_GET_OBJ(src);
+    size_t size;
+    uint8_t *tmp;
+    JSValue val;
+    JSAtom atom;
+    uint32_t i;
+
+    if (js_class_is_typed_array(ps->class_id)) {
+        size = (size_t)len << js_typed_array_size_log2(ps->u.array.kind);
+        if (js_typed_array_same_bits(p->u.array.kind, ps->u.array.kind)) {
+            memmove(p->u.array.u.uint8s +
+                    ((size_t)idx << js_typed_array_size_log2(p->u.array.kind)),
+                    ps->u.array.u.ptr, size);
+        } else if (ps->u.array.buffer == p->u.array.buffer) {
+            /* the source and the destination may overlap */
+            tmp = js_malloc(ctx, max_int(size, 1));
+            if (!tmp)
+                return -1;
+            memcpy(tmp, ps->u.array.u.ptr, size);
+            js_typed_array_convert(p, idx, ps->u.array.kind, tmp, len);
+            js_free(ctx, tmp);
+        } else {
+            js_typed_array_convert(p, idx, ps->u.array.kind,
+                                   ps->u.array.u.ptr, len);
+        }
+        return 0;
+    }
+    if (ps->class_id == JS_CLASS_ARRAY && ps->fast_array &&
+        ps->u.array.kind != JS_ARRAY_KIND_VALUE &&
+        len <= ps->u.array.count) {
+        /* no user code runs for the numeric elements */
+        js_typed_array_convert(p, idx, ps->u.array.kind, ps->u.array.u.ptr,
+                               len);
+        return 0;
+    }
+    for(i = 0; i < len; i++) {
+        atom = JS_NewAtomUInt32(ctx, i);
+        if (atom == JS_ATOM_NULL)
+            return -1;
+        val = JS_GetProperty(ctx, src, atom);
+        JS_FreeAtom(ctx, atom);
+        if (JS_IsException(val) ||
+            js_typed_array_set_element(ctx, p, idx + i, val) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static JSValue js_typed_array_constructor(JSContext *ctx,
+                                          JSValueConst new_target,
+                                          int argc, JSValueConst *argv,
+                                          int class_id)
+{
+    JSObject *ps;
+    JSArrayBuffer *abuf;
+    uint32_t offset, len, mask;
+    JSValue obj;
+
+    if (JS_IsUndefined(new_target))
+        return JS_ThrowTypeError(ctx, "constructor requires 'new'");
+    if (!JS_IsObject(argv[0])) {
+        if (js_to_index(ctx, &len, argv[0], "length"))
+            return JS_EXCEPTION;
+        return js_typed_array_alloc(ctx, new_target, class_id, len);
+    }
+    ps = JS_VALUE_GET_OBJ(argv[0]);
+    if (ps->class_id == JS_CLASS_ARRAY_BUFFER) {
+        /* view on the ArrayBuffer: the data is not copied */
+        abuf = ps->u.array_buffer;
+        mask = (1 << typed_array_size_log2[class_id - JS_CLASS_UINT8C_ARRAY]) - 1;
+        if (js_to_index(ctx, &offset, argv[1], "offset"))
+            return JS_EXCEPTION;
+        if ((offset & mask) != 0)
+            return JS_ThrowRangeError(ctx, "invalid offset");
+        if (JS_IsUndefined(argv[2])) {
+            if (offset > abuf->byte_length ||
+                ((abuf->byte_length - offset) & mask) != 0)
+                return JS_ThrowRangeError(ctx, "invalid length");
+            len = (abuf->byte_length - offset) / (mask + 1);
+        } else {
+            if (js_to_index(ctx, &len, argv[2], "length"))
+                return JS_EXCEPTION;
+            if ((uint64_t)offset + (uint64_t)len * (mask + 1) >
+                abuf->byte_length)
+                return JS_ThrowRangeError(ctx, "invalid length");
+        }
+        return js_typed_array_new(ctx, new_target, class_id, argv[0],
+                                  offset, len);
+    }
+    if (js_class_is_typed_array(ps->class_id)) {
+        len = ps->u.array.count;
+    } else if (js_array_like_length(ctx, &len, argv[0])) {
+        return JS_EXCEPTION;
+    }
+    obj = js_typed_array_alloc(ctx, new_target, class_id, len);
+    if (JS_IsException(obj))
+        return obj;
+    if (js_typed_array_copy_from(ctx, JS_VALUE_GET_OBJ(obj), 0, argv[0], len)) {
+        JS_FreeValue(ctx, obj);
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
+static JSValue js_typed_array_fill(JSContext *ctx, JSValueConst this_val,
+                                   int argc, JSValueConst *argv)
+{
+    JSObject *p;
+    uint32_t start, end;
+    int size_log2;
+    double d;
+
+    p = js_get_typed_array(ctx, this_val);
+    if (!p)
+        return JS_EXCEPTION;
+    if (JS_ToFloat64(ctx, &d, argv[0]) ||
+        js_to_relative_index(ctx, &start, argv[1], p->u.array.count, 0) ||
+        js_to_relative_index(ctx, &end, argv[2], p->u.array.count,
+                             p->u.array.count))
+        return JS_EXCEPTION;
+    if (start < end) {
+        /* the value is converted once, then its bytes are copied */
+        js_typed_array_store_double(p, start, d);
+        size_log2 = js_typed_array_size_log2(p->u.array.kind);
+        js_fill_elements(p->u.array.u.uint8s + ((size_t)start << size_log2),
+                         end - start, size_log2);
+    }
+    return JS_DupValue(ctx, this_val);
+}
+
+static JSValue js_typed_array_indexOf(JSContext *ctx, JSValueConst this_val,
+                                      int argc, JSValueConst *argv)
+{
+    JSObject *p;
+    uint32_t k, len, i;
+    uint64_t v;
+    int kind, res;
+    double d;
+    float f;
+
+    p = js_get_typed_array(ctx, this_val);
+    if (!p)
+        return JS_EXCEPTION;
+    len = p->u.array.count;
+    if (js_to_relative_index(ctx, &k, argv[1], len, 0))
+        return JS_EXCEPTION;
+    /* strict equality: only the numbers are found */
+    if (JS_VALUE_GET_TAG(argv[0]) == JS_TAG_INT)
+        d = JS_VALUE_GET_INT(argv[0]);
+    else if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(argv[0])))
+        d = JS_VALUE_GET_FLOAT64(argv[0]);
+    else
+        return JS_NewInt32(ctx, -1);
+    if (k >= len || isnan(d))
+        return JS_NewInt32(ctx, -1);
+    kind = p->u.array.kind;
+    switch(kind) {
+    case JS_ARRAY_KIND_FLOAT32:
+        f = d;
+        if (f != d)
+            return JS_NewInt32(ctx, -1);
+        if (f == 0) {
+            /* -0 and +0 have different bits */
+            for(i = k; i < len; i++) {
+                if (p->u.array.u.floats[i] == 0)
+                    return JS_NewInt32(ctx, i);
+            }
+            return JS_NewInt32(ctx, -1);
+        }
+        v = 0;
+        memcpy(&v, &f, sizeof(f));
+        break;
+    case JS_ARRAY_KIND_FLOAT64:
+        if (d == 0) {
+            for(i = k; i < len; i++) {
+                if (p->u.array.u.doubles[i] == 0)
+                    return JS_NewInt32(ctx, i);
+            }
+            return JS_NewInt32(ctx, -1);
+        }
+        memcpy(&v, &d, sizeof(d));
+        break;
+    default:
+        /* the value must be an element of the integer kind */
+        if (d != trunc(d))
+            return JS_NewInt32(ctx, -1);
+        switch(kind) {
+        case JS_ARRAY_KIND_INT8:
+            res = d >= INT8_MIN && d <= INT8_MAX;
+            break;
+        case JS_ARRAY_KIND_INT16:
+            res = d >= INT16_MIN && d <= INT16_MAX;
+            break;
+        case JS_ARRAY_KIND_UINT16:
+            res = d >= 0 && d <= UINT16_MAX;
+            break;
+        case JS_ARRAY_KIND_INT32:
+            res = d >= INT32_MIN && d <= INT32_MAX;
+            break;
+        case JS_ARRAY_KIND_UINT32:
+            res = d >= 0 && d <= UINT32_MAX;
+            break;
+        default: /* JS_ARRAY_KIND_UINT8C, JS_ARRAY_KIND_UINT8 */
+            res = d >= 0 && d <= UINT8_MAX;
+            break;
+        }
+        if (!res)
+            return JS_NewInt32(ctx, -1);
+        v = (uint64_t)(int64_t)d;
+        break;
+    }
+    return JS_NewInt32(ctx, js_find_element(p->u.array.u.uint8s, k, len,
+                                            js_typed_array_size_log2(kind), v));
+}
+
+static JSValue js_typed_array_set(JSContext *ctx, JSValueConst this_val,
+                                  int argc, JSValueConst *argv)
+{
+    JSObject *p, *ps;
+    uint32_t offset, len;
+
+    p = js_get_typed_array(ctx, this_val);
+    if (!p)
+        return JS_EXCEPTION;
+    if (js_to_index(ctx, &offset, argv[1], "offset"))
+        return JS_EXCEPTION;
+    if (!JS_IsObject(argv[0])) {
+        if (JS_IsUndefined(argv[0]) || JS_IsNull(argv[0]))
+            return JS_ThrowTypeError(ctx, "not an object");
+        /* the primitive values have no elements */
+        len = 0;
+    } else {
+        ps = JS_VALUE_GET_OBJ(argv[0]);
+        if (js_class_is_typed_array(ps->class_id))
+            len = ps->u.array.count;
+        else if (js_array_like_length(ctx, &len, argv[0]))
+            return JS_EXCEPTION;
+    }
+    if (offset > p->u.array.count || len > p->u.array.count - offset)
+        return JS_ThrowRangeError(ctx, "invalid array length");
+    if (len != 0 && js_typed_array_copy_from(ctx, p, offset, argv[0], len))
+        return JS_EXCEPTION;
+    return JS_UNDEFINED;
+}
+
+static JSValue js_typed_array_subarray(JSContext *ctx, JSValueConst this_val,
+                                       int argc, JSValueConst *argv)
+{
+    JSObject *p;
+    uint32_t start, end, offset;
+    int size_log2;
+
+    p = js_get_typed_array(ctx, this_val);
+    if (!p)
+        return JS_EXCEPTION;
+    if (js_to_relative_index(ctx, &start, argv[0], p->u.array.count, 0) ||
+        js_to_relative_index(ctx, &end, argv[1], p->u.array.count,
+                             p->u.array.count))
+        return JS_EXCEPTION;
+    if (end < start)
+        end = start;
+    /* same buffer: the elements are shared */
+    size_log2 = js_typed_array_size_log2(p->u.array.kind);
+    offset = p->u.array.u.uint8s - p->u.array.buffer->u.array_buffer->data;
+    return js_typed_array_new(ctx, JS_UNDEFINED, p->class_id,
+                              JS_MKPTR(JS_TAG_OBJECT, p->u.array.buffer),
+                              offset + (start << size_log2), end - start);
+}
+
+/* DataView */
+
+static JSValue js_dataview_constructor(JSContext *ctx, JSValueConst new_target,
+                                       int argc, JSValueConst *argv)
+{
+    JSArrayBuffer *abuf;
+    JSValueConst offset_val, len_val;
+    uint32_t offset, len;
+
+    if (JS_IsUndefined(new_target))
+        return JS_ThrowTypeError(ctx, "constructor requires 'new'");
+    abuf = js_get_array_buffer(ctx, argv[0]);
+    if (!abuf)
+        return JS_EXCEPTION;
+    /* 'length' is 1 */
+    offset_val = argc > 1 ? argv[1] : JS_UNDEFINED;
+    len_val = argc > 2 ? argv[2] : JS_UNDEFINED;
+    if (js_to_index(ctx, &offset, offset_val, "byteOffset"))
+        return JS_EXCEPTION;
+    if (offset > abuf->byte_length)
+        return JS_ThrowRangeError(ctx, "invalid byteOffset");
+    if (JS_IsUndefined(len_val)) {
+        len = abuf->byte_length - offset;
+    } else {
+        if (js_to_index(ctx, &len, len_val, "byteLength"))
+            return JS_EXCEPTION;
+        if (len > abuf->byte_length - offset)
+            return JS_ThrowRangeError(ctx, "invalid byteLength");
+    }
+    return js_typed_array_new(ctx, new_target, JS_CLASS_DATAVIEW, argv[0],
+                              offset, len);
+}
+
+/* pointer to the 'size' bytes at the byte offset 'pos_val' of the
+   DataView 'this_val', or NULL if exception */
+static uint8_t *js_dataview_get_ptr(JSContext *ctx, JSValueConst this_val,
+                                    JSValueConst pos_val, int size)
+{
+    JSObject *p;
+    uint32_t pos;
+
+    if (!JS_IsObject(this_val) ||
+        JS_VALUE_GET_OBJ(this_val)->class_id != JS_CLASS_DATAVIEW) {
+        JS_ThrowTypeError(ctx, "not a DataView");
+        return NULL;
+    }
+    p = JS_VALUE_GET_OBJ(this_val);
+    if (js_to_index(ctx, &pos, pos_val, "offset"))
+        return NULL;
+    if ((uint64_t)pos + size > p->u.array.count) {
+        JS_ThrowRangeError(ctx, "out of bound");
+        return NULL;
+    }
+    return p->u.array.u.uint8s + pos;
+}
+
+/* magic = JS_ARRAY_KIND_x */
+static JSValue js_dataview_getValue(JSContext *ctx, JSValueConst this_val,
+                                    int argc, JSValueConst *argv, int kind)
+{
+    uint8_t *ptr;
+    BOOL swap;
+    uint32_t v;
+    uint64_t v64;
+    union {
+        uint32_t u32;
+        float f;
+        uint64_t u64;
+        double d;
+    } u;
+
+    ptr = js_dataview_get_ptr(ctx, this_val, argv[0],
+                              1 << js_typed_array_size_log2(kind));
+    if (!ptr)
+        return JS_EXCEPTION;
+    /* big endian by default */
+    swap = (argc > 1 && JS_ToBool(ctx, argv[1])) != js_is_little_endian();
+    switch(kind) {
+    case JS_ARRAY_KIND_INT8:
+        return JS_NewInt32(ctx, get_i8(ptr));
+    case JS_ARRAY_KIND_UINT8:
+        return JS_NewInt32(ctx, get_u8(ptr));
+    case JS_ARRAY_KIND_INT16:
+    case JS_ARRAY_KIND_UINT16:
+        v = get_u16(ptr);
+        if (swap)
+            v = bswap16(v);
+        if (kind == JS_ARRAY_KIND_INT16)
+            return JS_NewInt32(ctx, (int16_t)v);
+        return JS_NewInt32(ctx, v);
+    case JS_ARRAY_KIND_INT32:
+    case JS_ARRAY_KIND_UINT32:
+    case JS_ARRAY_KIND_FLOAT32:
+        v = get_u32(ptr);
+        if (swap)
+            v = bswap32(v);
+        if (kind == JS_ARRAY_KIND_INT32)
+            return JS_NewInt32(ctx, v);
+        if (kind == JS_ARRAY_KIND_UINT32)
+            return JS_NewNumber(ctx, v);
+        u.u32 = v;
+        return __JS_NewFloat64(ctx, u.f);
+    default: /* JS_ARRAY_KIND_FLOAT64 */
+        v64 = get_u64(ptr);
+        if (swap)
+            v64 = bswap64(v64);
+        u.u64 = v64;
+        return __JS_NewFloat64(ctx, u.d);
+    }
+}
+
+static JSValue js_dataview_setValue(JSContext *ctx, JSValueConst this_val,
+                                    int argc, JSValueConst *argv, int kind)
+{
+    uint8_t *ptr;
+    BOOL swap;
+    uint32_t v;
+    uint64_t v64;
+    double d;
+    union {
+        uint32_t u32;
+        float f;
+        uint64_t u64;
+        double d;
+    } u;
+
+    ptr = js_dataview_get_ptr(ctx, this_val, argv[0],
+                              1 << js_typed_array_size_log2(kind));
+    if (!ptr)
+        return JS_EXCEPTION;
+    if (JS_ToFloat64(ctx, &d, argv[1]))
+        return JS_EXCEPTION;
+    swap = (argc > 2 && JS_ToBool(ctx, argv[2])) != js_is_little_endian();
+    switch(kind) {
+    case JS_ARRAY_KIND_INT8:
+    case JS_ARRAY_KIND_UINT8:
+        put_u8(ptr, js_double_to_int32(d));
+        break;
+    case JS_ARRAY_KIND_INT16:
+    case JS_ARRAY_KIND_UINT16:
+        v = js_double_to_int32(d);
+        put_u16(ptr, swap ? bswap16(v) : v);
+        break;
+    case JS_ARRAY_KIND_INT32:
+    case JS_ARRAY_KIND_UINT32:
+    case JS_ARRAY_KIND_FLOAT32:
+        if (kind == JS_ARRAY_KIND_FLOAT32) {
+            u.f = d;
+            v = u.u32;
+        } else {
+            v = js_double_to_int32(d);
+        }
+        put_u32(ptr, swap ? bswap32(v) : v);
+        break;
+    default: /* JS_ARRAY_KIND_FLOAT64 */
+        u.d = d;
+        v64 = u.u64;
+        put_u64(ptr, swap ? bswap64(v64) : v64);
+        break;
+    }
+    return JS_UNDEFINED;
+}
+
+static const JSCFunctionListEntry js_array_buffer_proto_funcs[] = {
+    JS_CFUNC_DEF("slice", 2, js_array_buffer_slice ),
+};
+
+/* %TypedArray%.prototype */
+static const JSCFunctionListEntry js_typed_array_base_proto_funcs[] = {
+    JS_CFUNC_DEF("fill", 3, js_typed_array_fill ),
+    JS_CFUNC_DEF("indexOf", 2, js_typed_array_indexOf ),
+    JS_CFUNC_DEF("set", 2, js_typed_array_set ),
+    JS_CFUNC_DEF("subarray", 2, js_typed_array_subarray ),
+};
+
+static const JSCFunctionListEntry js_dataview_proto_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("getInt8", 1, js_dataview_getValue, JS_ARRAY_KIND_INT8 ),
+    JS_CFUNC_MAGIC_DEF("getUint8", 1, js_dataview_getValue, JS_ARRAY_KIND_UINT8 ),
+    JS_CFUNC_MAGIC_DEF("getInt16", 1, js_dataview_getValue, JS_ARRAY_KIND_INT16 ),
+    JS_CFUNC_MAGIC_DEF("getUint16", 1, js_dataview_getValue, JS_ARRAY_KIND_UINT16 ),
+    JS_CFUNC_MAGIC_DEF("getInt32", 1, js_dataview_getValue, JS_ARRAY_KIND_INT32 ),
+    JS_CFUNC_MAGIC_DEF("getUint32", 1, js_dataview_getValue, JS_ARRAY_KIND_UINT32 ),
+    JS_CFUNC_MAGIC_DEF("getFloat32", 1, js_dataview_getValue, JS_ARRAY_KIND_FLOAT32 ),
+    JS_CFUNC_MAGIC_DEF("getFloat64", 1, js_dataview_getValue, JS_ARRAY_KIND_FLOAT64 ),
+    JS_CFUNC_MAGIC_DEF("setInt8", 2, js_dataview_setValue, JS_ARRAY_KIND_INT8 ),
+    JS_CFUNC_MAGIC_DEF("setUint8", 2, js_dataview_setValue, JS_ARRAY_KIND_UINT8 ),
+    JS_CFUNC_MAGIC_DEF("setInt16", 2, js_dataview_setValue, JS_ARRAY_KIND_INT16 ),
+    JS_CFUNC_MAGIC_DEF("setUint16", 2, js_dataview_setValue, JS_ARRAY_KIND_UINT16 ),
+    JS_CFUNC_MAGIC_DEF("setInt32", 2, js_dataview_setValue, JS_ARRAY_KIND_INT32 ),
+    JS_CFUNC_MAGIC_DEF("setUint32", 2, js_dataview_setValue, JS_ARRAY_KIND_UINT32 ),
+    JS_CFUNC_MAGIC_DEF("setFloat32", 2, js_dataview_setValue, JS_ARRAY_KIND_FLOAT32 ),
+    JS_CFUNC_MAGIC_DEF("setFloat64", 2, js_dataview_setValue, JS_ARRAY_KIND_FLOAT64 ),
+};
+
+void JS_AddIntrinsicTypedArrays(JSContext *ctx)
+{
+    JSValue base_proto, proto, ctor;
+    int i, size;
+
+    /* ArrayBuffer */
+    proto = JS_NewObject(ctx);
+    ctx->class_proto[JS_CLASS_ARRAY_BUFFER] = proto;
+    JS_SetPropertyFunctionList(ctx, proto, js_array_buffer_proto_funcs,
+                               countof(js_array_buffer_proto_funcs));
+    ctor = JS_NewCFunction2(ctx, js_array_buffer_constructor, "ArrayBuffer",
+                            1, JS_CFUNC_constructor, 0);
+    JS_SetConstructor(ctx, ctor, proto);
+    JS_DefinePropertyValueStr(ctx, ctx->global_obj, "ArrayBuffer", ctor,
+                              JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+
+    /* XXX: no %TypedArray% constructor: its prototype holds the methods
+       shared by the typed arrays */
+    base_proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, base_proto, js_typed_array_base_proto_funcs,
+                               countof(js_typed_array_base_proto_funcs));
+    for(i = JS_CLASS_UINT8C_ARRAY; i <= JS_CLASS_FLOAT64_ARRAY; i++) {
+        size = 1 << typed_array_size_log2[i - JS_CLASS_UINT8C_ARRAY];
+        proto = JS_NewObjectProto(ctx, base_proto);
+        ctx->class_proto[i] = proto;
+        JS_DefinePropertyValue(ctx, proto, JS_ATOM_BYTES_PER_ELEMENT,
+                               JS_NewInt32(ctx, size), 0);
+        ctor = JS_NewCFunctionMagic(ctx, js_typed_array_constructor,
+                                    typed_array_names[i - JS_CLASS_UINT8C_ARRAY],
+                                    3, JS_CFUNC_constructor_magic, i);
+        JS_DefinePropertyValue(ctx, ctor, JS_ATOM_BYTES_PER_ELEMENT,
+                               JS_NewInt32(ctx, size), 0);
+        JS_SetConstructor(ctx, ctor, proto);
+        JS_DefinePropertyValueStr(ctx, ctx->global_obj,
+                                  typed_array_names[i - JS_CLASS_UINT8C_ARRAY],
+                                  ctor, JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+    JS_FreeValue(ctx, base_proto);
+
+    /* DataView */
+    proto = JS_NewObject(ctx);
+    ctx->class_proto[JS_CLASS_DATAVIEW] = proto;
+    JS_SetPropertyFunctionList(ctx, proto, js_dataview_proto_funcs,
+                               countof(js_dataview_proto_funcs));
+    ctor = JS_NewCFunction2(ctx, js_dataview_constructor, "DataView",
+                            1, JS_CFUNC_constructor, 0);
+    JS_SetConstructor(ctx, ctor, proto);
+    JS_DefinePropertyValueStr(ctx, ctx->global_obj, "DataView", ctor,
+                              JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+}
@@ -0,0 +1,1201 @@
+#include <math.h>
+#include <stdarg.h>
+#include "lexer.h"
+#include "dtoa.h"
+#include "jsstring.h"
+
+/* The hot loops of the lexer (white space, comments and string bodies)
+   look for their stop characters 16 bytes at a time. The identifiers
+   are scanned with a character class table and the ASCII ones are
+   atomized directly from the source. */
+#if defined(__SSE2__) && !defined(CONFIG_LEXER_NO_SIMD)
+#define LEXER_SIMD
+#include <emmintrin.h>
+#endif
+
+#define CP_NBSP 0x00a0
+#define CP_BOM  0xfeff
+#define CP_LS   0x2028   /* line separator */
+#define CP_PS   0x2029   /* paragraph separator */
+
+#define ID_START 1
+#define ID_PART  2
+
+/* ASCII identifier characters. The other bytes (the backslash of the
+   escapes and the UTF-8 sequences) take the slow path. */
+static const uint8_t lexer_ident_table[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+    0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 3,
+    0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0,
+};
+
+static inline BOOL lexer_is_digit(int c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* white space other than the ASCII ones */
+static BOOL lexer_is_unicode_space(uint32_t c)
+{
+    return c == CP_NBSP || c == CP_BOM || c == 0x1680 ||
+        (c >= 0x2000 && c <= 0x200a) || c == 0x202f || c == 0x205f ||
+        c == 0x3000;
+}
+
+/* XXX: no Unicode tables yet. The non ASCII characters other than the
+   white spaces and the line terminators are accepted in the
+   identifiers. */
+static BOOL lexer_is_unicode_ident(uint32_t c)
+{
+    return c >= 0x80 && !lexer_is_unicode_space(c) &&
+        c != CP_LS && c != CP_PS && !(c >= 0xd800 && c <= 0xdfff);
+}
+
+static inline BOOL lexer_is_ls_ps(const uint8_t *p)
+{
+    return p[0] == 0xe2 && p[1] == 0x80 && (p[2] == 0xa8 || p[2] == 0xa9);
+}
+
+/* return the first position of [p, end) holding c0, c1, c2 or c3, or
+   'end'. */
+static force_inline const uint8_t *lexer_find4(const uint8_t *p,
+                                               const uint8_t *end,
+                                               uint8_t c0, uint8_t c1,
+                                               uint8_t c2, uint8_t c3)
+{
+#ifdef LEXER_SIMD
+    const __m128i v0 = _mm_set1_epi8((char)c0);
+    const __m128i v1 = _mm_set1_epi8((char)c1);
+    const __m128i v2 = _mm_set1_epi8((char)c2);
+    const __m128i v3 = _mm_set1_epi8((char)c3);
+    __m128i v, m;
+    unsigned int mask;
+
+    while (end - p >= 16) {
+        v = _mm_loadu_si128((const __m128i *)p);
+        m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, v0),
+                                      _mm_cmpeq_epi8(v, v1)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, v2),
+                                      _mm_cmpeq_epi8(v, v3)));
+        mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return p + ctz32(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != c0 && *p != c1 && *p != c2 && *p != c3)
+        p++;
+    return p;
+}
+
+/* skip the spaces, tabs and line feeds (e.g. the indentation after a
+   new line) */
+static force_inline const uint8_t *lexer_skip_blanks(JSParseState *s,
+                                                     const uint8_t *p)
+{
+    int lines = 0;
+#ifdef LEXER_SIMD
+    const __m128i vsp = _mm_set1_epi8(' ');
+    const __m128i vtab = _mm_set1_epi8('\t');
+    const __m128i vlf = _mm_set1_epi8('\n');
+    __m128i v;
+    unsigned int lf, ws;
+    int n;
+
+    /* most tokens are separated by a single space */
+    if (*p != ' ' && *p != '\t' && *p != '\n')
+        return p;
+    while (s->buf_end - p >= 16) {
+        v = _mm_loadu_si128((const __m128i *)p);
+        lf = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vlf));
+        ws = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, vsp),
+                                            _mm_cmpeq_epi8(v, vtab))) | lf;
+        if (ws != 0xffff) {
+            n = ctz32(~ws);
+            lines += __builtin_popcount(lf & ((1U << n) - 1));
+            p += n;
+            break;
+        }
+        lines += __builtin_popcount(lf);
+        p += 16;
+    }
+#endif
+    for(;;) {
+        if (*p == ' ' || *p == '\t') {
+            p++;
+        } else if (*p == '\n') {
+            lines++;
+            p++;
+        } else {
+            break;
+        }
+    }
+    if (lines != 0) {
+        s->line_num += lines;
+        s->got_lf = TRUE;
+    }
+    return p;
+}
+
+/* return the end of the line comment: its line terminator or the end
+   of input */
+static const uint8_t *lexer_skip_line_comment(const uint8_t *p,
+                                              const uint8_t *end)
+{
+    for(;;) {
+        p = lexer_find4(p, end, '\n', '\r', 0xe2, '\n');
+        if (*p != 0xe2 || lexer_is_ls_ps(p))
+            return p;
+        p++;
+    }
+}
+
+int js_parse_error(JSParseState *s, const char *fmt, ...)
+{
+    JSContext *ctx = s->ctx;
+    JSValue exc;
+    va_list ap;
+
+    va_start(ap, fmt);
+    JS_ThrowError(ctx, JS_SYNTAX_ERROR, fmt, ap);
+    va_end(ap);
+    exc = ctx->rt->current_exception;
+    if (JS_IsObject(exc)) {
+        JS_DefinePropertyValue(ctx, exc, JS_ATOM_fileName,
+                               JS_NewString(ctx, s->filename),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+        JS_DefinePropertyValue(ctx, exc, JS_ATOM_lineNumber,
+                               JS_NewInt32(ctx, s->line_num),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+    return -1;
+}
+
+/* *pp points after the opening slash */
+static int lexer_skip_block_comment(JSParseState *s, const uint8_t **pp)
+{
+    const uint8_t *p = *pp + 1;
+
+    for(;;) {
+        p = lexer_find4(p, s->buf_end, '*', '\n', '\r', 0xe2);
+        switch(*p) {
+        case '*':
+            if (p[1] == '/') {
+                *pp = p + 2;
+                return 0;
+            }
+            p++;
+            break;
+        case '\r':
+            /* DOS newlines count once */
+            if (p[1] != '\n')
+                s->line_num++;
+            s->got_lf = TRUE;
+            p++;
+            break;
+        case '\n':
+            s->line_num++;
+            s->got_lf = TRUE;
+            p++;
+            break;
+        case 0xe2:
+            if (lexer_is_ls_ps(p)) {
+                s->line_num++;
+                s->got_lf = TRUE;
+                p += 3;
+            } else {
+                p++;
+            }
+            break;
+        default:
+            /* end of input */
+            return js_parse_error(s, "unexpected end of comment");
+        }
+    }
+}
+
+static void free_token(JSParseState *s, JSToken *token)
+{
+    switch(token->val) {
+    case TOK_NUMBER:
+        JS_FreeValue(s->ctx, token->u.num.val);
+        break;
+    case TOK_STRING:
+    case TOK_TEMPLATE:
+        JS_FreeValue(s->ctx, token->u.str.str);
+        break;
+    case TOK_REGEXP:
+        JS_FreeValue(s->ctx, token->u.regexp.body);
+        JS_FreeValue(s->ctx, token->u.regexp.flags);
+        break;
+    case TOK_IDENT:
+    case TOK_PRIVATE_NAME:
+        JS_FreeAtom(s->ctx, token->u.ident.atom);
+        break;
+    default:
+        if (token->val >= TOK_FIRST_KEYWORD &&
+            token->val <= TOK_LAST_KEYWORD) {
+            JS_FreeAtom(s->ctx, token->u.ident.atom);
+        }
+        break;
+    }
+}
+
+void js_parse_init(JSContext *ctx, JSParseState *s,
+                   const char *input, size_t input_len,
+                   const char *filename)
+{
+    assert(input[input_len] == '\0');
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->filename = filename;
+    s->line_num = 1;
+    s->buf_ptr = (const uint8_t *)input;
+    s->buf_end = s->buf_ptr + input_len;
+    s->token.val = ' ';
+    s->token.line_num = 1;
+    /* the first line of the scripts run as executables */
+    if (input_len >= 2 && input[0] == '#' && input[1] == '!')
+        s->buf_ptr = lexer_skip_line_comment(s->buf_ptr + 2, s->buf_end);
+}
+
+void js_parse_free(JSParseState *s)
+{
+    free_token(s, &s->token);
+    s->token.val = TOK_EOF;
+}
+
+/* \uXXXX or \u{X...}. *pp points after the 'u'. Return -1 if error. */
+static int lexer_parse_unicode_escape(const uint8_t **pp)
+{
+    const uint8_t *p = *pp;
+    uint32_t c;
+    int h, i;
+
+    c = 0;
+    if (*p == '{') {
+        p++;
+        for(i = 0; ; i++) {
+            h = from_hex(*p);
+            if (h < 0)
+                break;
+            c = (c << 4) | h;
+            if (c > 0x10ffff)
+                return -1;
+            p++;
+        }
+        if (i == 0 || *p != '}')
+            return -1;
+        p++;
+    } else {
+        for(i = 0; i < 4; i++) {
+            h = from_hex(*p);
+            if (h < 0)
+                return -1;
+            c = (c << 4) | h;
+            p++;
+        }
+    }
+    *pp = p;
+    return c;
+}
+
+static void update_token_ident(JSParseState *s)
+{
+    JSAtom atom = s->token.u.ident.atom;
+
+    if (atom <= JS_ATOM_LAST_KEYWORD ||
+        (atom <= JS_ATOM_LAST_STRICT_KEYWORD && s->is_strict) ||
+        (atom == JS_ATOM_yield && s->is_generator)) {
+        if (s->token.u.ident.has_escape) {
+            s->token.u.ident.is_reserved = TRUE;
+            s->token.val = TOK_IDENT;
+        } else {
+            s->token.val = atom - 1 + TOK_FIRST_KEYWORD;
+        }
+    }
+}
+
+/* identifier with escapes or non ASCII characters. *pp points to its
+   first character. */
+static int js_parse_ident_slow(JSParseState *s, const uint8_t **pp)
+{
+    StringBuffer b_s, *b = &b_s;
+    const uint8_t *p = *pp, *p_next;
+    BOOL has_escape = FALSE;
+    JSString *str;
+    JSAtom atom;
+    int c, mask;
+
+    if (string_buffer_init(s->ctx->rt, b, 16))
+        goto oom;
+    for(;;) {
+        mask = b->len == 0 ? ID_START : ID_PART;
+        c = *p;
+        if (c == '\\' && p[1] == 'u') {
+            p_next = p + 2;
+            c = lexer_parse_unicode_escape(&p_next);
+            if (c < 0 || !(c < 0x80 ? (lexer_ident_table[c] & mask) :
+                           lexer_is_unicode_ident(c))) {
+                string_buffer_free(b);
+                return js_parse_error(s, "invalid escape sequence in identifier");
+            }
+            has_escape = TRUE;
+        } else if (c < 0x80) {
+            if (!(lexer_ident_table[c] & mask))
+                break;
+            p_next = p + 1;
+        } else {
+            c = unicode_from_utf8(p, UTF8_CHAR_LEN_MAX, &p_next);
+            if (c < 0 || !lexer_is_unicode_ident(c))
+                break;
+        }
+        if (string_buffer_putc(b, c)) {
+            string_buffer_free(b);
+            goto oom;
+        }
+        p = p_next;
+    }
+    if (b->len == 0) {
+        string_buffer_free(b);
+        return js_parse_error(s, "invalid identifier");
+    }
+    str = string_buffer_end(b);
+    if (!str)
+        goto oom;
+    atom = __JS_NewAtom(s->ctx->rt, str, JS_ATOM_TYPE_STRING);
+    if (atom == JS_ATOM_NULL)
+        goto oom;
+    s->token.u.ident.atom = atom;
+    s->token.u.ident.has_escape = has_escape;
+    s->token.u.ident.is_reserved = FALSE;
+    *pp = p;
+    return 0;
+ oom:
+    JS_ThrowOutOfMemory(s->ctx);
+    return -1;
+}
+
+/* check that a numeric literal is not followed by an identifier */
+static int lexer_check_number_end(JSParseState *s, const uint8_t *p)
+{
+    const uint8_t *p_next;
+    int c;
+
+    c = *p;
+    if (c == 'n')
+        return js_parse_error(s, "BigInt literals are not supported");
+    if (c < 0x80) {
+        if (!(lexer_ident_table[c] & ID_PART) && c != '\\')
+            return 0;
+    } else {
+        c = unicode_from_utf8(p, UTF8_CHAR_LEN_MAX, &p_next);
+        if (c < 0 || !lexer_is_unicode_ident(c))
+            return 0;
+    }
+    return js_parse_error(s, "invalid number literal");
+}
+
+/* binary, octal and hexadecimal literals. The value is correctly
+   rounded: the digits beyond 64 bits only set a sticky bit. */
+static int js_parse_radix(JSParseState *s, const uint8_t **pp,
+                          int radix_bits, BOOL allow_sep)
+{
+    const uint8_t *p = *pp;
+    uint64_t m;
+    int d, e, n, radix;
+    BOOL sticky;
+
+    radix = 1 << radix_bits;
+    m = 0;
+    e = 0;
+    n = 0;
+    sticky = FALSE;
+    for(;;) {
+        if (*p == '_' && allow_sep && n != 0) {
+            d = from_hex(p[1]);
+            if (d < 0 || d >= radix)
+                return js_parse_error(s, "invalid number literal");
+            p++;
+        }
+        d = from_hex(*p);
+        if (d < 0 || d >= radix)
+            break;
+        if (m >> (64 - radix_bits)) {
+            e += radix_bits;
+            sticky |= (d != 0);
+        } else {
+            m = (m << radix_bits) | d;
+        }
+        n++;
+        p++;
+    }
+    if (n == 0)
+        return js_parse_error(s, "invalid number literal");
+    /* m has more than 54 significant bits here: its lowest bit is only
+       used for the rounding */
+    if (sticky)
+        m |= 1;
+    if (lexer_check_number_end(s, p))
+        return -1;
+    s->token.val = TOK_NUMBER;
+    s->token.u.num.val = JS_NewNumber(s->ctx, ldexp((double)m, e));
+    *pp = p;
+    return 0;
+}
+
+/* skip the decimal digits and the separators between them. Return
+   NULL if a separator is misplaced. */
+static const uint8_t *lexer_skip_digits(const uint8_t *p, BOOL *phas_sep)
+{
+    const uint8_t *p_start = p;
+
+    for(;;) {
+        if (lexer_is_digit(*p)) {
+            p++;
+        } else if (*p == '_') {
+            if (p == p_start || !lexer_is_digit(p[1]))
+                return NULL;
+            *phas_sep = TRUE;
+            p++;
+        } else {
+            return p;
+        }
+    }
+}
+
+static int js_parse_number(JSParseState *s, const uint8_t **pp)
+{
+    JSContext *ctx = s->ctx;
+    const uint8_t *p = *pp, *p_start = p, *q;
+    char buf[64], *str;
+    BOOL has_sep;
+    size_t i, j;
+    double d;
+    int c;
+
+    if (p[0] == '0') {
+        c = p[1] | 0x20;
+        if (c == 'x' || c == 'o' || c == 'b') {
+            p += 2;
+            if (js_parse_radix(s, &p, c == 'x' ? 4 : c == 'o' ? 3 : 1, TRUE))
+                return -1;
+            *pp = p;
+            return 0;
+        }
+        if (lexer_is_digit(p[1])) {
+            if (s->is_strict)
+                return js_parse_error(s, "octal literals are deprecated in strict mode");
+            for(q = p + 1; *q >= '0' && *q <= '7'; q++)
+                continue;
+            if (!lexer_is_digit(*q) && *q != '.' && (*q | 0x20) != 'e') {
+                /* legacy octal literal */
+                p++;
+                if (js_parse_radix(s, &p, 3, FALSE))
+                    return -1;
+                *pp = p;
+                return 0;
+            }
+            /* decimal with leading zeros */
+        }
+    }
+
+    has_sep = FALSE;
+    p = lexer_skip_digits(p, &has_sep);
+    if (p && *p == '.') {
+        p++;
+        if (*p != '_')
+            p = lexer_skip_digits(p, &has_sep);
+    }
+    if (p && (*p | 0x20) == 'e') {
+        q = p + 1;
+        if (*q == '+' || *q == '-')
+            q++;
+        if (lexer_is_digit(*q))
+            p = lexer_skip_digits(q, &has_sep);
+    }
+    if (!p)
+        return js_parse_error(s, "invalid number literal");
+    if (lexer_check_number_end(s, p))
+        return -1;
+
+    if (!has_sep) {
+        d = js_strtod((const char *)p_start, NULL);
+    } else {
+        /* remove the separators */
+        str = buf;
+        if (p - p_start >= sizeof(buf)) {
+            str = js_malloc(ctx, p - p_start + 1);
+            if (!str)
+                return -1;
+        }
+        j = 0;
+        for(i = 0; i < p - p_start; i++) {
+            if (p_start[i] != '_')
+                str[j++] = p_start[i];
+        }
+        str[j] = '\0';
+        d = js_strtod(str, NULL);
+        if (str != buf)
+            js_free(ctx, str);
+    }
+    s->token.val = TOK_NUMBER;
+    s->token.u.num.val = JS_NewNumber(ctx, d);
+    *pp = p;
+    return 0;
+}
+
+/* *pp points after the backslash. Append the escaped character to 'b'
+   (nothing for a line continuation). */
+static int js_parse_escape(JSParseState *s, const uint8_t **pp,
+                           StringBuffer *b, BOOL is_template)
+{
+    const uint8_t *p = *pp, *p_next;
+    int c, h0, h1;
+
+    c = *p;
+    switch(c) {
+    case '\0':
+        if (p >= s->buf_end)
+            return js_parse_error(s, "unexpected end of string");
+        p++;
+        break;
+    case 'b':
+        c = '\b';
+        p++;
+        break;
+    case 'f':
+        c = '\f';
+        p++;
+        break;
+    case 'n':
+        c = '\n';
+        p++;
+        break;
+    case 'r':
+        c = '\r';
+        p++;
+        break;
+    case 't':
+        c = '\t';
+        p++;
+        break;
+    case 'v':
+        c = '\v';
+        p++;
+        break;
+    case '\r':
+        if (p[1] == '\n')
+            p++;
+        /* fall thru */
+    case '\n':
+        /* line continuation */
+        s->line_num++;
+        *pp = p + 1;
+        return 0;
+    case 'x':
+        h0 = from_hex(p[1]);
+        h1 = h0 < 0 ? -1 : from_hex(p[2]);
+        if (h1 < 0)
+            return js_parse_error(s, "invalid escape sequence");
+        c = (h0 << 4) | h1;
+        p += 3;
+        break;
+    case 'u':
+        p++;
+        c = lexer_parse_unicode_escape(&p);
+        if (c < 0)
+            return js_parse_error(s, "invalid escape sequence");
+        break;
+    case '0': case '1': case '2': case '3':
+    case '4': case '5': case '6': case '7':
+    case '8': case '9':
+        if (c == '0' && !lexer_is_digit(p[1])) {
+            c = 0;
+            p++;
+            break;
+        }
+        if (is_template)
+            return js_parse_error(s, "octal escape sequences are not allowed in templates");
+        if (s->is_strict)
+            return js_parse_error(s, "octal escape sequences are not allowed in strict mode");
+        p++;
+        if (c >= '8')
+            break;
+        /* legacy octal: at most 3 digits, up to \377 */
+        c -= '0';
+        if (*p >= '0' && *p <= '7') {
+            c = (c << 3) | (*p++ - '0');
+            if (c < 32 && *p >= '0' && *p <= '7')
+                c = (c << 3) | (*p++ - '0');
+        }
+        break;
+    default:
+        if (c >= 0x80) {
+            c = unicode_from_utf8(p, UTF8_CHAR_LEN_MAX, &p_next);
+            if (c < 0) {
+                c = 0xfffd;
+                p_next = p + 1;
+            }
+            p = p_next;
+            if (c == CP_LS || c == CP_PS) {
+                /* line continuation */
+                *pp = p;
+                return 0;
+            }
+        } else {
+            p++;
+        }
+        break;
+    }
+    if (string_buffer_putc(b, c)) {
+        JS_ThrowOutOfMemory(s->ctx);
+        return -1;
+    }
+    *pp = p;
+    return 0;
+}
+
+static int string_buffer_write_source(StringBuffer *b, const uint8_t *p,
+                                      const uint8_t *p_end)
+{
+    UTF8Decoder dec;
+
+    if (p == p_end)
+        return 0;
+    utf8_decode_init(&dec);
+    if (string_buffer_write_utf8(b, &dec, p, p_end - p) ||
+        string_buffer_write_utf8_end(b, &dec))
+        return -1;
+    return 0;
+}
+
+/* *pp points to the opening quote */
+static int js_parse_string(JSParseState *s, int sep, const uint8_t **pp)
+{
+    JSContext *ctx = s->ctx;
+    StringBuffer b_s, *b = &b_s;
+    const uint8_t *p, *p_start;
+    JSString *str;
+    JSValue val;
+
+    p_start = *pp + 1;
+    p = lexer_find4(p_start, s->buf_end, sep, '\\', '\n', '\r');
+    if (*p == sep) {
+        /* no escape: a single copy from the source */
+        val = JS_NewStringLen(ctx, (const char *)p_start, p - p_start);
+        if (JS_IsException(val))
+            return -1;
+        goto done;
+    }
+
+    if (string_buffer_init(ctx->rt, b, p - p_start + 16))
+        goto oom;
+    for(;;) {
+        if (string_buffer_write_source(b, p_start, p)) {
+            string_buffer_free(b);
+            goto oom;
+        }
+        if (*p == sep)
+            break;
+        if (*p != '\\') {
+            string_buffer_free(b);
+            if (p >= s->buf_end)
+                return js_parse_error(s, "unexpected end of string");
+            return js_parse_error(s, "unexpected line terminator in string");
+        }
+        p++;
+        if (js_parse_escape(s, &p, b, FALSE)) {
+            string_buffer_free(b);
+            return -1;
+        }
+        p_start = p;
+        p = lexer_find4(p_start, s->buf_end, sep, '\\', '\n', '\r');
+    }
+    str = string_buffer_end(b);
+    if (!str)
+        goto oom;
+    val = JS_MKPTR(JS_TAG_STRING, str);
+ done:
+    s->token.val = TOK_STRING;
+    s->token.u.str.str = val;
+    s->token.u.str.sep = sep;
+    *pp = p + 1;
+    return 0;
+ oom:
+    JS_ThrowOutOfMemory(ctx);
+    return -1;
+}
+
+int js_parse_template_part(JSParseState *s, const uint8_t *p)
+{
+    StringBuffer b_s, *b = &b_s;
+    const uint8_t *p_start;
+    JSString *str;
+    int c;
+
+    if (string_buffer_init(s->ctx->rt, b, 32))
+        goto oom;
+    p_start = p;
+    for(;;) {
+        c = *p;
+        if (c == '`' || (c == '$' && p[1] == '{') || c == '\\' ||
+            c == '\r' || (c == '\0' && p >= s->buf_end)) {
+            if (string_buffer_write_source(b, p_start, p)) {
+                string_buffer_free(b);
+                goto oom;
+            }
+            if (c == '`') {
+                p++;
+                break;
+            } else if (c == '$') {
+                p += 2;
+                break;
+            } else if (c == '\0') {
+                string_buffer_free(b);
+                return js_parse_error(s, "unexpected end of string");
+            } else if (c == '\r') {
+                /* the DOS and MAC newlines become line feeds */
+                if (p[1] == '\n')
+                    p++;
+                p++;
+                s->line_num++;
+                if (string_buffer_putc8(b, '\n')) {
+                    string_buffer_free(b);
+                    goto oom;
+                }
+            } else {
+                p++;
+                if (js_parse_escape(s, &p, b, TRUE)) {
+                    string_buffer_free(b);
+                    return -1;
+                }
+            }
+            p_start = p;
+            continue;
+        }
+        if (c == '\n')
+            s->line_num++;
+        p++;
+    }
+    str = string_buffer_end(b);
+    if (!str)
+        goto oom;
+    s->token.val = TOK_TEMPLATE;
+    s->token.u.str.str = JS_MKPTR(JS_TAG_STRING, str);
+    s->token.u.str.sep = c;
+    s->buf_ptr = p;
+    return 0;
+ oom:
+    JS_ThrowOutOfMemory(s->ctx);
+    return -1;
+}
+
+int js_parse_regexp(JSParseState *s)
+{
+    JSContext *ctx = s->ctx;
+    const uint8_t *p, *p_body, *p_flags;
+    BOOL in_class;
+    JSValue body, flags;
+    int c;
+
+    p = s->token.ptr + 1;
+    p_body = p;
+    in_class = FALSE;
+    for(;;) {
+        c = *p;
+        if (c == '\0' && p >= s->buf_end)
+            return js_parse_error(s, "unexpected end of regexp");
+        if (c == '\n' || c == '\r' || lexer_is_ls_ps(p))
+            return js_parse_error(s, "unexpected line terminator in regexp");
+        if (c == '/' && !in_class)
+            break;
+        if (c == '[') {
+            in_class = TRUE;
+        } else if (c == ']') {
+            in_class = FALSE;
+        } else if (c == '\\') {
+            p++;
+            c = *p;
+            if (c == '\0' && p >= s->buf_end)
+                return js_parse_error(s, "unexpected end of regexp");
+            if (c == '\n' || c == '\r' || lexer_is_ls_ps(p))
+                return js_parse_error(s, "unexpected line terminator in regexp");
+        }
+        p++;
+    }
+    p++;
+    p_flags = p;
+    while (lexer_ident_table[*p] & ID_PART)
+        p++;
+
+    body = JS_NewStringLen(ctx, (const char *)p_body, p_flags - 1 - p_body);
+    if (JS_IsException(body))
+        return -1;
+    flags = JS_NewStringLen(ctx, (const char *)p_flags, p - p_flags);
+    if (JS_IsException(flags)) {
+        JS_FreeValue(ctx, body);
+        return -1;
+    }
+    s->token.val = TOK_REGEXP;
+    s->token.u.regexp.body = body;
+    s->token.u.regexp.flags = flags;
+    s->buf_ptr = p;
+    return 0;
+}
+
+/* ASCII identifier, atomized from the source. 'h' is its atom hash. */
+static int js_parse_ident8(JSParseState *s, const uint8_t *p, size_t len,
+                           uint32_t h)
+{
+    JSAtom atom;
+
+    atom = __JS_NewAtom8(s->ctx->rt, p, len, h);
+    if (atom == JS_ATOM_NULL) {
+        JS_ThrowOutOfMemory(s->ctx);
+        return -1;
+    }
+    s->token.u.ident.atom = atom;
+    s->token.u.ident.has_escape = FALSE;
+    s->token.u.ident.is_reserved = FALSE;
+    return 0;
+}
+
+int next_token(JSParseState *s)
+{
+    const uint8_t *p, *p1;
+    uint32_t h;
+    int c;
+
+    free_token(s, &s->token);
+
+    p = s->last_ptr = s->buf_ptr;
+    s->got_lf = FALSE;
+    s->last_line_num = s->token.line_num;
+ redo:
+    s->token.line_num = s->line_num;
+    s->token.ptr = p;
+    c = *p;
+    switch(c) {
+    case 0:
+        if (p >= s->buf_end) {
+            s->token.val = TOK_EOF;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '`':
+        if (js_parse_template_part(s, p + 1))
+            goto fail;
+        p = s->buf_ptr;
+        break;
+    case '\'':
+    case '\"':
+        if (js_parse_string(s, c, &p))
+            goto fail;
+        break;
+    case '\r':  /* accept DOS and MAC newline sequences */
+        if (p[1] == '\n')
+            p++;
+        /* fall thru */
+    case '\n':
+        p++;
+    line_terminator:
+        s->got_lf = TRUE;
+        s->line_num++;
+        p = lexer_skip_blanks(s, p);
+        goto redo;
+    case '\f':
+    case '\v':
+    case ' ':
+    case '\t':
+        p = lexer_skip_blanks(s, p + 1);
+        goto redo;
+    case '/':
+        if (p[1] == '*') {
+            p++;
+            if (lexer_skip_block_comment(s, &p))
+                goto fail;
+            goto redo;
+        } else if (p[1] == '/') {
+            p = lexer_skip_line_comment(p + 2, s->buf_end);
+            goto redo;
+        } else if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_DIV_ASSIGN;
+        } else {
+            p++;
+            s->token.val = c;
+        }
+        break;
+    case '\\':
+        if (p[1] != 'u')
+            goto def_token;
+        goto ident_slow;
+    case 'a': case 'b': case 'c': case 'd':
+    case 'e': case 'f': case 'g': case 'h':
+    case 'i': case 'j': case 'k': case 'l':
+    case 'm': case 'n': case 'o': case 'p':
+    case 'q': case 'r': case 's': case 't':
+    case 'u': case 'v': case 'w': case 'x':
+    case 'y': case 'z':
+    case 'A': case 'B': case 'C': case 'D':
+    case 'E': case 'F': case 'G': case 'H':
+    case 'I': case 'J': case 'K': case 'L':
+    case 'M': case 'N': case 'O': case 'P':
+    case 'Q': case 'R': case 'S': case 'T':
+    case 'U': case 'V': case 'W': case 'X':
+    case 'Y': case 'Z':
+    case '_':
+    case '$':
+        /* the hash is computed while scanning */
+        p1 = p;
+        h = JS_ATOM_TYPE_STRING;
+        do {
+            h = js_atom_hash_step(h, *p);
+            p++;
+        } while (lexer_ident_table[*p] & ID_PART);
+        if (unlikely(*p >= 0x80 || *p == '\\')) {
+            p = p1;
+            goto ident_slow;
+        }
+        if (js_parse_ident8(s, p1, p - p1, h))
+            goto fail;
+        s->token.val = TOK_IDENT;
+        update_token_ident(s);
+        break;
+    ident_slow:
+        if (js_parse_ident_slow(s, &p))
+            goto fail;
+        s->token.val = TOK_IDENT;
+        update_token_ident(s);
+        break;
+    case '#':
+        p++;
+        if (js_parse_ident_slow(s, &p)) {
+            JS_FreeValue(s->ctx, JS_GetException(s->ctx));
+            js_parse_error(s, "invalid first character of private name");
+            goto fail;
+        }
+        s->token.val = TOK_PRIVATE_NAME;
+        break;
+    case '.':
+        if (p[1] == '.' && p[2] == '.') {
+            p += 3;
+            s->token.val = TOK_ELLIPSIS;
+            break;
+        }
+        if (lexer_is_digit(p[1]))
+            goto parse_number;
+        goto def_token;
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+    parse_number:
+        if (js_parse_number(s, &p))
+            goto fail;
+        break;
+    case '*':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_MUL_ASSIGN;
+        } else if (p[1] == '*') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_POW_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_POW;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '%':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_MOD_ASSIGN;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '+':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_PLUS_ASSIGN;
+        } else if (p[1] == '+') {
+            p += 2;
+            s->token.val = TOK_INC;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '-':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_MINUS_ASSIGN;
+        } else if (p[1] == '-') {
+            p += 2;
+            s->token.val = TOK_DEC;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '<':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_LTE;
+        } else if (p[1] == '<') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_SHL_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_SHL;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '>':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_GTE;
+        } else if (p[1] == '>') {
+            if (p[2] == '>') {
+                if (p[3] == '=') {
+                    p += 4;
+                    s->token.val = TOK_SHR_ASSIGN;
+                } else {
+                    p += 3;
+                    s->token.val = TOK_SHR;
+                }
+            } else if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_SAR_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_SAR;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '=':
+        if (p[1] == '=') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_STRICT_EQ;
+            } else {
+                p += 2;
+                s->token.val = TOK_EQ;
+            }
+        } else if (p[1] == '>') {
+            p += 2;
+            s->token.val = TOK_ARROW;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '!':
+        if (p[1] == '=') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_STRICT_NEQ;
+            } else {
+                p += 2;
+                s->token.val = TOK_NEQ;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '&':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_AND_ASSIGN;
+        } else if (p[1] == '&') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_LAND_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_LAND;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '^':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_XOR_ASSIGN;
+        } else {
+            goto def_token;
+        }
+        break;
+    case '|':
+        if (p[1] == '=') {
+            p += 2;
+            s->token.val = TOK_OR_ASSIGN;
+        } else if (p[1] == '|') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_LOR_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_LOR;
+            }
+        } else {
+            goto def_token;
+        }
+        break;
+    case '?':
+        if (p[1] == '?') {
+            if (p[2] == '=') {
+                p += 3;
+                s->token.val = TOK_DOUBLE_QUESTION_MARK_ASSIGN;
+            } else {
+                p += 2;
+                s->token.val = TOK_DOUBLE_QUESTION_MARK;
+            }
+        } else if (p[1] == '.' && !lexer_is_digit(p[2])) {
+            p += 2;
+            s->token.val = TOK_QUESTION_MARK_DOT;
+        } else {
+            goto def_token;
+        }
+        break;
+    default:
+        if (c >= 0x80) {
+            /* unicode value */
+            c = unicode_from_utf8(p, UTF8_CHAR_LEN_MAX, &p1);
+            if (c == CP_LS || c == CP_PS) {
+                p = p1;
+                goto line_terminator;
+            }
+            if (c >= 0 && lexer_is_unicode_space(c)) {
+                p = p1;
+                goto redo;
+            }
+            if (c >= 0 && lexer_is_unicode_ident(c))
+                goto ident_slow;
+            js_parse_error(s, "unexpected character");
+            goto fail;
+        }
+    def_token:
+        s->token.val = c;
+        p++;
+        break;
+    }
+    s->buf_ptr = p;
+    return 0;
+
+ fail:
+    s->token.val = TOK_ERROR;
+    return -1;
+}
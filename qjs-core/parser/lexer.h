@@ -0,0 +1,164 @@
+#ifndef QJS_LEXER_H
+#define QJS_LEXER_H
+#include "context.h"
+#include "atoms.h"
+
+enum {
+    TOK_NUMBER = -128,
+    TOK_STRING,
+    TOK_TEMPLATE,
+    TOK_IDENT,
+    TOK_REGEXP,
+    /* assignment operators */
+    TOK_MUL_ASSIGN,
+    TOK_DIV_ASSIGN,
+    TOK_MOD_ASSIGN,
+    TOK_PLUS_ASSIGN,
+    TOK_MINUS_ASSIGN,
+    TOK_SHL_ASSIGN,
+    TOK_SAR_ASSIGN,
+    TOK_SHR_ASSIGN,
+    TOK_AND_ASSIGN,
+    TOK_XOR_ASSIGN,
+    TOK_OR_ASSIGN,
+    TOK_POW_ASSIGN,
+    TOK_LAND_ASSIGN,
+    TOK_LOR_ASSIGN,
+    TOK_DOUBLE_QUESTION_MARK_ASSIGN,
+    TOK_DEC,
+    TOK_INC,
+    TOK_SHL,
+    TOK_SAR,
+    TOK_SHR,
+    TOK_LT,
+    TOK_LTE,
+    TOK_GT,
+    TOK_GTE,
+    TOK_EQ,
+    TOK_STRICT_EQ,
+    TOK_NEQ,
+    TOK_STRICT_NEQ,
+    TOK_LAND,
+    TOK_LOR,
+    TOK_POW,
+    TOK_ARROW,
+    TOK_ELLIPSIS,
+    TOK_DOUBLE_QUESTION_MARK,
+    TOK_QUESTION_MARK_DOT,
+    TOK_ERROR,
+    TOK_PRIVATE_NAME,
+    TOK_EOF,
+    /* keywords: same order as the atoms */
+    TOK_NULL, /* must be first */
+    TOK_FALSE,
+    TOK_TRUE,
+    TOK_IF,
+    TOK_ELSE,
+    TOK_RETURN,
+    TOK_VAR,
+    TOK_THIS,
+    TOK_DELETE,
+    TOK_VOID,
+    TOK_TYPEOF,
+    TOK_NEW,
+    TOK_IN,
+    TOK_INSTANCEOF,
+    TOK_DO,
+    TOK_WHILE,
+    TOK_FOR,
+    TOK_BREAK,
+    TOK_CONTINUE,
+    TOK_SWITCH,
+    TOK_CASE,
+    TOK_DEFAULT,
+    TOK_THROW,
+    TOK_TRY,
+    TOK_CATCH,
+    TOK_FINALLY,
+    TOK_FUNCTION,
+    TOK_DEBUGGER,
+    TOK_WITH,
+    /* FutureReservedWord */
+    TOK_CLASS,
+    TOK_CONST,
+    TOK_ENUM,
+    TOK_EXPORT,
+    TOK_EXTENDS,
+    TOK_IMPORT,
+    TOK_SUPER,
+    /* FutureReservedWords when parsing strict mode code */
+    TOK_IMPLEMENTS,
+    TOK_INTERFACE,
+    TOK_LET,
+    TOK_PACKAGE,
+    TOK_PRIVATE,
+    TOK_PROTECTED,
+    TOK_PUBLIC,
+    TOK_STATIC,
+    TOK_YIELD,
+    TOK_AWAIT, /* must be last */
+};
+
+#define TOK_FIRST_KEYWORD   TOK_NULL
+#define TOK_LAST_KEYWORD    TOK_AWAIT
+
+typedef struct JSToken {
+    int val;
+    int line_num;   /* line number of token start */
+    const uint8_t *ptr;
+    union {
+        struct {
+            JSValue str;
+            int sep; /* '`' or '$' (start of a substitution) for templates */
+        } str;
+        struct {
+            JSValue val;
+        } num;
+        struct {
+            JSAtom atom;
+            BOOL has_escape;
+            BOOL is_reserved;
+        } ident;
+        struct {
+            JSValue body;
+            JSValue flags;
+        } regexp;
+    } u;
+} JSToken;
+
+typedef struct JSParseState {
+    JSContext *ctx;
+    int last_line_num;  /* line number of last token */
+    int line_num;       /* line number of current offset */
+    const char *filename;
+    JSToken token;
+    BOOL got_lf; /* true if got line feed before the current token */
+    BOOL is_strict; /* the strict mode reserved words are keywords */
+    BOOL is_generator; /* 'yield' is a keyword */
+    const uint8_t *last_ptr;
+    const uint8_t *buf_ptr;
+    const uint8_t *buf_end;
+    /* function being compiled, NULL when only tokenizing */
+    struct JSFunctionDef *cur_func;
+    BOOL func_in_parens; /* the next token is "function" after '(' */
+} JSParseState;
+
+/* 'input' must be null terminated: input[input_len] == '\0' */
+void js_parse_init(JSContext *ctx, JSParseState *s,
+                   const char *input, size_t input_len,
+                   const char *filename);
+/* release the current token */
+void js_parse_free(JSParseState *s);
+/* throw a SyntaxError at the current line. Return -1. */
+int __attribute__((format(printf, 2, 3))) js_parse_error(JSParseState *s,
+                                                         const char *fmt, ...);
+/* read the next token. Return -1 if error (the token is then
+   TOK_ERROR and the exception is set). */
+int __exception next_token(JSParseState *s);
+/* read the template part starting at 'p' (after '`' or after the
+   closing '}' of a substitution) */
+int __exception js_parse_template_part(JSParseState *s, const uint8_t *p);
+/* read the current '/' or '/=' token again as a regular expression */
+int __exception js_parse_regexp(JSParseState *s);
+
+#endif //QJS_LEXER_H
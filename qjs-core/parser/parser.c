@@ -0,0 +1,3375 @@
+/*
+ * QuickJS Javascript Engine
+ *
+ * Copyright (c) 2017-2021 Fabrice Bellard
+ * Copyright (c) 2017-2021 Charlie Gordon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "parser.h"
+#include "bytecode.h"
+#include "gc.h"
+
+/* The compiler emits raw code: the variables are referenced by name
+   (scope_get_var...) and the jumps by label. When the whole script is
+   parsed, the variables of each function are resolved to locals,
+   arguments, closure variables or globals, then js_bytecode_finalize()
+   builds the final compact code.
+
+   Only the top level code and the function expressions in parentheses
+   are compiled at once. The code of the other functions is parsed to
+   check it and to resolve their closure variables, then dropped: they
+   are compiled again from their source on their first call (see
+   js_create_lazy_function()).
+
+   Not supported yet: regular expression literals, classes,
+   destructuring, spread and rest elements, getters and setters in
+   object literals, 'arguments', yield*, async functions and
+   for-in/for-of loops. They are reported as syntax errors. */
+
+#define JS_MAX_LOCAL_VARS 65535
+
+typedef struct JSVarScope {
+    int parent; /* index in JSFunctionDef.scopes */
+    int first;  /* first variable of the scope, -1 if none */
+} JSVarScope;
+
+/* breakable statements: loops, switch, labeled statements and the try
+   blocks (for the finally clauses) */
+typedef struct BlockEnv {
+    struct BlockEnv *prev;
+    JSAtom label_name; /* JS_ATOM_NULL if none */
+    int label_break; /* -1 if none */
+    int label_cont; /* -1 if none */
+    int drop_count; /* number of stack elements to drop */
+    int label_finally; /* -1 if none */
+    int scope_level;
+    BOOL is_regular_stmt; /* labeled statement: only the labeled break */
+} BlockEnv;
+
+typedef struct JSGlobalVar {
+    JSAtom var_name;
+    int cpool_idx; /* function declaration, -1 otherwise */
+} JSGlobalVar;
+
+typedef struct JSFunctionDef {
+    JSContext *ctx;
+    struct JSFunctionDef *parent;
+    int parent_cpool_idx; /* index of the function in the parent cpool */
+    int parent_scope_level; /* scope of the definition in the parent */
+    struct list_head child_list; /* list of JSFunctionDef.link */
+    struct list_head link;
+
+    BOOL is_global_var; /* the 'var's are global variables */
+    BOOL is_strict;
+    BOOL is_arrow;
+    BOOL is_func_expr; /* named function expression */
+    BOOL has_prototype;
+    BOOL is_generator;
+    BOOL is_lazy; /* compiled on its first call */
+    BOOL is_eager; /* the inner functions are compiled with it */
+    JSAtom func_name; /* JS_ATOM_NULL if anonymous */
+
+    JSVarDef *vars;
+    int var_size;
+    int var_count;
+    JSVarDef *args;
+    int arg_size;
+    int arg_count;
+    int defined_arg_count;
+    int this_var_idx; /* -1 if none */
+    int func_var_idx; /* variable holding the function, -1 if none */
+    int eval_ret_idx; /* completion value of the global code, -1 if none */
+
+    JSGlobalVar *global_vars;
+    int global_var_size;
+    int global_var_count;
+
+    int scope_level; /* current scope */
+    int body_scope; /* scope of the function body */
+    JSVarScope *scopes;
+    int scope_size;
+    int scope_count;
+
+    DynBuf byte_code;
+    int last_opcode_pos; /* -1 if no last opcode */
+    int last_opcode_line_num;
+    int label_count;
+    BlockEnv *top_break;
+
+    JSValue *cpool;
+    int cpool_count;
+    int cpool_size;
+
+    JSClosureVar *closure_var;
+    int closure_var_count;
+    int closure_var_size;
+
+    JSAtom filename;
+    int line_num;
+
+    /* the arguments and the body, kept by the lazy functions */
+    int func_type; /* JSParseFunctionEnum */
+    const uint8_t *source_ptr;
+    const uint8_t *source_end;
+    int source_line_num;
+} JSFunctionDef;
+
+typedef enum JSParseFunctionEnum {
+    JS_PARSE_FUNC_STATEMENT,
+    JS_PARSE_FUNC_EXPR,
+    JS_PARSE_FUNC_ARROW,
+    JS_PARSE_FUNC_METHOD,
+} JSParseFunctionEnum;
+
+typedef enum {
+    PUT_LVALUE_NOKEEP, /* a = b */
+    PUT_LVALUE_KEEP_TOP, /* the assigned value stays on the stack */
+    PUT_LVALUE_KEEP_SECOND, /* the value below it stays (postfix ++) */
+} PutLValueEnum;
+
+#define PF_IN_ACCEPTED  (1 << 0) /* the 'in' operator is accepted */
+#define PF_POSTFIX_CALL (1 << 1) /* the calls are accepted */
+#define PF_POW_ALLOWED  (1 << 2) /* '**' is accepted after the operand */
+#define PF_POW_FORBIDDEN (1 << 3) /* unary operator before '**' */
+
+typedef struct JSParsePos {
+    int last_line_num;
+    int line_num;
+    BOOL got_lf;
+    const uint8_t *ptr;
+} JSParsePos;
+
+static __exception int js_parse_expr(JSParseState *s);
+static __exception int js_parse_assign_expr(JSParseState *s);
+static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags);
+static __exception int js_parse_unary(JSParseState *s, int parse_flags);
+static __exception int js_parse_postfix_expr(JSParseState *s, int parse_flags);
+static __exception int js_parse_statement_or_decl(JSParseState *s,
+                                                  BOOL allow_decl);
+static __exception int js_parse_function_decl(JSParseState *s,
+                                              JSParseFunctionEnum func_type,
+                                              JSAtom func_name,
+                                              int function_line_num);
+static void js_free_function_def(JSContext *ctx, JSFunctionDef *fd);
+
+static int js_resize_array(JSContext *ctx, void **parray, int elem_size,
+                           int *psize, int req_size)
+{
+    int new_size;
+    void *new_array;
+
+    if (req_size > *psize) {
+        new_size = max_int(req_size, *psize * 3 / 2);
+        new_size = max_int(new_size, 4);
+        new_array = js_realloc(ctx, *parray, (size_t)new_size * elem_size);
+        if (!new_array)
+            return -1;
+        *parray = new_array;
+        *psize = new_size;
+    }
+    return 0;
+}
+
+/* function definitions */
+
+static JSFunctionDef *js_new_function_def(JSContext *ctx,
+                                          JSFunctionDef *parent,
+                                          BOOL is_func_expr,
+                                          JSAtom filename, int line_num)
+{
+    JSFunctionDef *fd;
+
+    fd = js_mallocz(ctx, sizeof(*fd));
+    if (!fd)
+        return NULL;
+    fd->ctx = ctx;
+    init_list_head(&fd->child_list);
+    fd->parent = parent;
+    fd->parent_cpool_idx = -1;
+    if (parent) {
+        list_add_tail(&fd->link, &parent->child_list);
+        fd->is_strict = parent->is_strict;
+        fd->is_eager = parent->is_eager;
+        fd->parent_scope_level = parent->scope_level;
+    }
+    fd->is_func_expr = is_func_expr;
+    fd->this_var_idx = -1;
+    fd->func_var_idx = -1;
+    fd->eval_ret_idx = -1;
+    js_dbuf_init(ctx, &fd->byte_code);
+    fd->last_opcode_pos = -1;
+    fd->last_opcode_line_num = line_num;
+    fd->filename = filename;
+    fd->line_num = line_num;
+
+    /* scope 0 holds the 'var' variables */
+    if (js_resize_array(ctx, (void **)&fd->scopes, sizeof(fd->scopes[0]),
+                        &fd->scope_size, 1)) {
+        js_free_function_def(ctx, fd);
+        return NULL;
+    }
+    fd->scopes[0].parent = -1;
+    fd->scopes[0].first = -1;
+    fd->scope_count = 1;
+    fd->scope_level = 0;
+    return fd;
+}
+
+static void js_free_function_def(JSContext *ctx, JSFunctionDef *fd)
+{
+    struct list_head *el, *el1;
+    int i;
+
+    list_for_each_safe(el, el1, &fd->child_list) {
+        js_free_function_def(ctx, list_entry(el, JSFunctionDef, link));
+    }
+
+    js_free_raw_code_atoms(ctx->rt, fd->byte_code.buf, fd->byte_code.size);
+    dbuf_free(&fd->byte_code);
+
+    for(i = 0; i < fd->var_count; i++)
+        JS_FreeAtom(ctx, fd->vars[i].var_name);
+    js_free(ctx, fd->vars);
+    for(i = 0; i < fd->arg_count; i++)
+        JS_FreeAtom(ctx, fd->args[i].var_name);
+    js_free(ctx, fd->args);
+    for(i = 0; i < fd->global_var_count; i++)
+        JS_FreeAtom(ctx, fd->global_vars[i].var_name);
+    js_free(ctx, fd->global_vars);
+    for(i = 0; i < fd->cpool_count; i++)
+        JS_FreeValue(ctx, fd->cpool[i]);
+    js_free(ctx, fd->cpool);
+    for(i = 0; i < fd->closure_var_count; i++)
+        JS_FreeAtom(ctx, fd->closure_var[i].var_name);
+    js_free(ctx, fd->closure_var);
+    js_free(ctx, fd->scopes);
+
+    JS_FreeAtom(ctx, fd->func_name);
+    JS_FreeAtom(ctx, fd->filename);
+    if (fd->parent)
+        list_del(&fd->link);
+    js_free(ctx, fd);
+}
+
+/* code emission */
+
+static inline int get_prev_opcode(JSFunctionDef *fd)
+{
+    if (fd->last_opcode_pos < 0)
+        return OP_invalid;
+    return fd->byte_code.buf[fd->last_opcode_pos];
+}
+
+static BOOL js_is_live_code(JSParseState *s)
+{
+    switch(get_prev_opcode(s->cur_func)) {
+    case OP_return:
+    case OP_return_undef:
+    case OP_throw:
+    case OP_throw_error:
+    case OP_goto:
+    case OP_ret:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+static void emit_u8(JSParseState *s, uint8_t val)
+{
+    dbuf_putc(&s->cur_func->byte_code, val);
+}
+
+static void emit_u16(JSParseState *s, uint16_t val)
+{
+    dbuf_put_u16(&s->cur_func->byte_code, val);
+}
+
+static void emit_u32(JSParseState *s, uint32_t val)
+{
+    dbuf_put_u32(&s->cur_func->byte_code, val);
+}
+
+static void emit_op(JSParseState *s, uint8_t val)
+{
+    JSFunctionDef *fd = s->cur_func;
+    DynBuf *bc = &fd->byte_code;
+
+    /* the line of the last token read */
+    if (fd->last_opcode_line_num != s->last_line_num) {
+        dbuf_putc(bc, OP_line_num);
+        dbuf_put_u32(bc, s->last_line_num);
+        fd->last_opcode_line_num = s->last_line_num;
+    }
+    fd->last_opcode_pos = bc->size;
+    dbuf_putc(bc, val);
+}
+
+static void emit_atom(JSParseState *s, JSAtom name)
+{
+    emit_u32(s, JS_DupAtom(s->ctx, name));
+}
+
+static int new_label(JSParseState *s)
+{
+    return s->cur_func->label_count++;
+}
+
+static void emit_label(JSParseState *s, int label)
+{
+    if (label >= 0) {
+        emit_op(s, OP_label);
+        emit_u32(s, label);
+    }
+}
+
+/* return the label. A new label is allocated if 'label' < 0. */
+static int emit_goto(JSParseState *s, int opcode, int label)
+{
+    if (label < 0)
+        label = new_label(s);
+    emit_op(s, opcode);
+    emit_u32(s, label);
+    return label;
+}
+
+/* take ownership of 'val'. Return its index or -1 if error. */
+static int cpool_add(JSParseState *s, JSValue val)
+{
+    JSFunctionDef *fd = s->cur_func;
+
+    if (js_resize_array(s->ctx, (void **)&fd->cpool, sizeof(fd->cpool[0]),
+                        &fd->cpool_size, fd->cpool_count + 1)) {
+        JS_FreeValue(s->ctx, val);
+        return -1;
+    }
+    fd->cpool[fd->cpool_count++] = val;
+    return fd->cpool_count - 1;
+}
+
+static int emit_push_number(JSParseState *s, JSValueConst val)
+{
+    int idx;
+
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT) {
+        emit_op(s, OP_push_i32);
+        emit_u32(s, JS_VALUE_GET_INT(val));
+    } else {
+        idx = cpool_add(s, JS_DupValue(s->ctx, val));
+        if (idx < 0)
+            return -1;
+        emit_op(s, OP_push_const);
+        emit_u32(s, idx);
+    }
+    return 0;
+}
+
+static int emit_push_string(JSParseState *s, JSValueConst str)
+{
+    JSAtom atom;
+
+    atom = JS_ValueToAtom(s->ctx, str);
+    if (atom == JS_ATOM_NULL)
+        return -1;
+    emit_op(s, OP_push_atom_value);
+    emit_u32(s, atom);
+    return 0;
+}
+
+/* scopes and variables */
+
+static int push_scope(JSParseState *s)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int scope = fd->scope_count;
+
+    if (scope >= 65535) {
+        JS_ThrowInternalError(s->ctx, "too many scopes");
+        return -1;
+    }
+    if (js_resize_array(s->ctx, (void **)&fd->scopes, sizeof(fd->scopes[0]),
+                        &fd->scope_size, fd->scope_count + 1))
+        return -1;
+    fd->scopes[scope].parent = fd->scope_level;
+    fd->scopes[scope].first = -1;
+    fd->scope_count++;
+    fd->scope_level = scope;
+    emit_op(s, OP_enter_scope);
+    emit_u16(s, scope);
+    return scope;
+}
+
+static void pop_scope(JSParseState *s)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int scope = fd->scope_level;
+
+    emit_op(s, OP_leave_scope);
+    emit_u16(s, scope);
+    fd->scope_level = fd->scopes[scope].parent;
+}
+
+/* leave the scopes down to 'scope_stop' (break, continue) */
+static void close_scopes(JSParseState *s, int scope, int scope_stop)
+{
+    while (scope > scope_stop) {
+        emit_op(s, OP_leave_scope);
+        emit_u16(s, scope);
+        scope = s->cur_func->scopes[scope].parent;
+    }
+}
+
+static int add_var(JSContext *ctx, JSFunctionDef *fd, JSAtom name)
+{
+    JSVarDef *vd;
+
+    if (fd->var_count >= JS_MAX_LOCAL_VARS) {
+        JS_ThrowInternalError(ctx, "too many local variables");
+        return -1;
+    }
+    if (js_resize_array(ctx, (void **)&fd->vars, sizeof(fd->vars[0]),
+                        &fd->var_size, fd->var_count + 1))
+        return -1;
+    vd = &fd->vars[fd->var_count++];
+    memset(vd, 0, sizeof(*vd));
+    vd->var_name = JS_DupAtom(ctx, name);
+    vd->scope_next = -1;
+    vd->func_pool_idx = -1;
+    return fd->var_count - 1;
+}
+
+static int add_scope_var(JSContext *ctx, JSFunctionDef *fd, JSAtom name,
+                         int scope, BOOL is_lexical, BOOL is_const)
+{
+    JSVarDef *vd;
+    int idx;
+
+    idx = add_var(ctx, fd, name);
+    if (idx >= 0) {
+        vd = &fd->vars[idx];
+        vd->is_lexical = is_lexical;
+        vd->is_const = is_const;
+        vd->scope_level = scope;
+        vd->scope_next = fd->scopes[scope].first;
+        fd->scopes[scope].first = idx;
+    }
+    return idx;
+}
+
+static int add_arg(JSContext *ctx, JSFunctionDef *fd, JSAtom name)
+{
+    JSVarDef *vd;
+
+    if (fd->arg_count >= JS_MAX_LOCAL_VARS) {
+        JS_ThrowInternalError(ctx, "too many arguments");
+        return -1;
+    }
+    if (js_resize_array(ctx, (void **)&fd->args, sizeof(fd->args[0]),
+                        &fd->arg_size, fd->arg_count + 1))
+        return -1;
+    vd = &fd->args[fd->arg_count++];
+    memset(vd, 0, sizeof(*vd));
+    vd->var_name = JS_DupAtom(ctx, name);
+    vd->scope_next = -1;
+    vd->func_pool_idx = -1;
+    return fd->arg_count - 1;
+}
+
+static int find_var_in_scope(JSFunctionDef *fd, JSAtom name, int scope)
+{
+    int idx;
+
+    for(idx = fd->scopes[scope].first; idx >= 0;
+        idx = fd->vars[idx].scope_next) {
+        if (fd->vars[idx].var_name == name)
+            return idx;
+    }
+    return -1;
+}
+
+static int find_arg(JSFunctionDef *fd, JSAtom name)
+{
+    int i;
+
+    for(i = fd->arg_count; i-- > 0;) {
+        if (fd->args[i].var_name == name)
+            return i;
+    }
+    return -1;
+}
+
+static JSGlobalVar *add_global_var(JSContext *ctx, JSFunctionDef *fd,
+                                   JSAtom name)
+{
+    JSGlobalVar *gv;
+    int i;
+
+    for(i = 0; i < fd->global_var_count; i++) {
+        if (fd->global_vars[i].var_name == name)
+            return &fd->global_vars[i];
+    }
+    if (js_resize_array(ctx, (void **)&fd->global_vars,
+                        sizeof(fd->global_vars[0]), &fd->global_var_size,
+                        fd->global_var_count + 1))
+        return NULL;
+    gv = &fd->global_vars[fd->global_var_count++];
+    gv->var_name = JS_DupAtom(ctx, name);
+    gv->cpool_idx = -1;
+    return gv;
+}
+
+/* declare 'name' in the current scope. 'tok' is TOK_VAR, TOK_LET,
+   TOK_CONST or TOK_CATCH. Return -1 if error. */
+static int define_var(JSParseState *s, JSAtom name, int tok)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int scope;
+
+    if (tok == TOK_VAR) {
+        for(scope = fd->scope_level; scope > 0;
+            scope = fd->scopes[scope].parent) {
+            if (find_var_in_scope(fd, name, scope) >= 0)
+                goto redef;
+        }
+        if (fd->is_global_var)
+            return add_global_var(s->ctx, fd, name) ? 0 : -1;
+        if (find_arg(fd, name) >= 0 || find_var_in_scope(fd, name, 0) >= 0)
+            return 0;
+        return add_scope_var(s->ctx, fd, name, 0, FALSE, FALSE) < 0 ? -1 : 0;
+    }
+    if (find_var_in_scope(fd, name, fd->scope_level) >= 0)
+        goto redef;
+    if (fd->scope_level == fd->body_scope) {
+        if (find_var_in_scope(fd, name, 0) >= 0 || find_arg(fd, name) >= 0)
+            goto redef;
+        if (fd->is_global_var) {
+            int i;
+            for(i = 0; i < fd->global_var_count; i++) {
+                if (fd->global_vars[i].var_name == name)
+                    goto redef;
+            }
+        }
+    }
+    return add_scope_var(s->ctx, fd, name, fd->scope_level, TRUE,
+                         tok == TOK_CONST) < 0 ? -1 : 0;
+ redef:
+    return js_parse_error(s, "invalid redefinition of lexical identifier");
+}
+
+/* register the function declaration 'name' defined by the constant
+   pool entry 'cpool_idx' of the current function */
+static int define_function(JSParseState *s, JSAtom name, int cpool_idx)
+{
+    JSFunctionDef *fd = s->cur_func;
+    JSGlobalVar *gv;
+    int idx;
+
+    if (fd->scope_level == fd->body_scope) {
+        /* hoisted to the top of the function */
+        if (fd->is_global_var) {
+            gv = add_global_var(s->ctx, fd, name);
+            if (!gv)
+                return -1;
+            gv->cpool_idx = cpool_idx;
+            return 0;
+        }
+        if (find_var_in_scope(fd, name, fd->body_scope) >= 0)
+            return js_parse_error(s, "invalid redefinition of lexical identifier");
+        idx = find_var_in_scope(fd, name, 0);
+        if (idx < 0) {
+            idx = add_scope_var(s->ctx, fd, name, 0, FALSE, FALSE);
+            if (idx < 0)
+                return -1;
+        }
+    } else {
+        /* initialized when entering the block */
+        if (find_var_in_scope(fd, name, fd->scope_level) >= 0)
+            return js_parse_error(s, "invalid redefinition of lexical identifier");
+        idx = add_scope_var(s->ctx, fd, name, fd->scope_level, TRUE, FALSE);
+        if (idx < 0)
+            return -1;
+    }
+    fd->vars[idx].func_pool_idx = cpool_idx;
+    return 0;
+}
+
+static void push_break_entry(JSFunctionDef *fd, BlockEnv *be,
+                             JSAtom label_name,
+                             int label_break, int label_cont,
+                             int drop_count)
+{
+    be->prev = fd->top_break;
+    fd->top_break = be;
+    be->label_name = label_name;
+    be->label_break = label_break;
+    be->label_cont = label_cont;
+    be->drop_count = drop_count;
+    be->label_finally = -1;
+    be->scope_level = fd->scope_level;
+    be->is_regular_stmt = FALSE;
+}
+
+static void pop_break_entry(JSFunctionDef *fd)
+{
+    fd->top_break = fd->top_break->prev;
+}
+
+/* name the anonymous function just emitted, as in 'f = function() {}' */
+static void set_object_name(JSParseState *s, JSAtom name)
+{
+    JSFunctionDef *fd = s->cur_func, *cfd;
+    struct list_head *el;
+    int idx;
+
+    if (get_prev_opcode(fd) != OP_fclosure)
+        return;
+    idx = get_u32(fd->byte_code.buf + fd->last_opcode_pos + 1);
+    list_for_each(el, &fd->child_list) {
+        cfd = list_entry(el, JSFunctionDef, link);
+        if (cfd->parent_cpool_idx == idx) {
+            if (cfd->func_name == JS_ATOM_NULL)
+                cfd->func_name = JS_DupAtom(s->ctx, name);
+            break;
+        }
+    }
+}
+
+/* token helpers */
+
+static void js_parse_get_pos(JSParseState *s, JSParsePos *sp)
+{
+    sp->last_line_num = s->last_line_num;
+    sp->line_num = s->token.line_num;
+    sp->ptr = s->token.ptr;
+    sp->got_lf = s->got_lf;
+}
+
+static __exception int js_parse_seek_token(JSParseState *s,
+                                           const JSParsePos *sp)
+{
+    s->token.line_num = sp->last_line_num;
+    s->line_num = sp->line_num;
+    s->buf_ptr = sp->ptr;
+    s->got_lf = sp->got_lf;
+    return next_token(s);
+}
+
+/* first character of the next token, after the blanks and the
+   comments. *pgot_lf is set if a line terminator was skipped. */
+static const uint8_t *js_parse_peek(JSParseState *s, BOOL *pgot_lf)
+{
+    const uint8_t *p = s->buf_ptr;
+    BOOL got_lf = FALSE;
+
+    for(;;) {
+        if (*p == ' ' || *p == '\t' || *p == '\v' || *p == '\f') {
+            p++;
+        } else if (*p == '\n' || *p == '\r') {
+            got_lf = TRUE;
+            p++;
+        } else if (p[0] == '/' && p[1] == '/') {
+            while (p < s->buf_end && *p != '\n' && *p != '\r')
+                p++;
+        } else if (p[0] == '/' && p[1] == '*') {
+            for(p += 2; p < s->buf_end; p++) {
+                if (p[0] == '*' && p[1] == '/') {
+                    p += 2;
+                    break;
+                }
+                if (*p == '\n' || *p == '\r')
+                    got_lf = TRUE;
+            }
+        } else {
+            break;
+        }
+    }
+    *pgot_lf = got_lf;
+    return p;
+}
+
+static BOOL token_is_ident(int tok)
+{
+    return tok == TOK_IDENT ||
+        (tok >= TOK_FIRST_KEYWORD && tok <= TOK_LAST_KEYWORD);
+}
+
+/* identifier usable as a binding or a reference */
+static BOOL is_binding_ident(JSParseState *s)
+{
+    return s->token.val == TOK_IDENT && !s->token.u.ident.is_reserved;
+}
+
+static BOOL is_label(JSParseState *s)
+{
+    BOOL got_lf;
+
+    return is_binding_ident(s) && *js_parse_peek(s, &got_lf) == ':';
+}
+
+/* 'ident =>' */
+static BOOL is_ident_arrow(JSParseState *s)
+{
+    const uint8_t *p;
+    BOOL got_lf;
+
+    p = js_parse_peek(s, &got_lf);
+    return !got_lf && p[0] == '=' && p[1] == '>';
+}
+
+/* skip the parenthesized tokens starting at the current '(' and return
+   the token following them. The parse position is restored. Used to
+   detect the arrow functions. */
+static int js_parse_skip_parens_token(JSParseState *s)
+{
+    JSContext *ctx = s->ctx;
+    JSParsePos pos;
+    char state[64];
+    int level, tok;
+
+    js_parse_get_pos(s, &pos);
+    level = 0;
+    tok = TOK_ERROR;
+    for(;;) {
+        switch(s->token.val) {
+        case '(':
+        case '[':
+        case '{':
+            if (level >= sizeof(state))
+                goto done;
+            state[level++] = s->token.val;
+            break;
+        case ')':
+            if (level == 0 || state[--level] != '(')
+                goto done;
+            break;
+        case ']':
+            if (level == 0 || state[--level] != '[')
+                goto done;
+            break;
+        case '}':
+            if (level == 0)
+                goto done;
+            if (state[level - 1] == '`') {
+                /* end of a template substitution */
+                if (js_parse_template_part(s, s->buf_ptr))
+                    goto done;
+                if (s->token.u.str.sep == '`')
+                    level--;
+            } else if (state[--level] != '{') {
+                goto done;
+            }
+            break;
+        case TOK_TEMPLATE:
+            if (s->token.u.str.sep == '$') {
+                if (level >= sizeof(state))
+                    goto done;
+                state[level++] = '`';
+            }
+            break;
+        case TOK_EOF:
+        case TOK_ERROR:
+            goto done;
+        }
+        if (level == 0)
+            break;
+        if (next_token(s))
+            goto done;
+    }
+    if (next_token(s) == 0)
+        tok = s->token.val;
+ done:
+    /* the errors are reported by the real parse */
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    if (js_parse_seek_token(s, &pos))
+        return TOK_ERROR;
+    return tok;
+}
+
+static __exception int js_parse_expect(JSParseState *s, int tok)
+{
+    if (s->token.val != tok)
+        return js_parse_error(s, "expecting '%c'", tok);
+    return next_token(s);
+}
+
+static __exception int js_parse_expect_semi(JSParseState *s)
+{
+    if (s->token.val != ';') {
+        /* automatic insertion of ';' */
+        if (s->token.val == TOK_EOF || s->token.val == '}' || s->got_lf)
+            return 0;
+        return js_parse_error(s, "expecting '%c'", ';');
+    }
+    return next_token(s);
+}
+
+static int js_parse_unexpected_token(JSParseState *s)
+{
+    if (s->token.val == TOK_EOF)
+        return js_parse_error(s, "unexpected end of input");
+    return js_parse_error(s, "unexpected token: '%.*s'",
+                          (int)(s->buf_ptr - s->token.ptr),
+                          (const char *)s->token.ptr);
+}
+
+/* "use strict" at the start of a function body or a script. Only the
+   first directive is checked. */
+static void js_parse_directives(JSParseState *s)
+{
+    const uint8_t *p = s->token.ptr;
+
+    if (s->token.val == TOK_STRING &&
+        !memcmp(p + 1, "use strict", 10) && p[11] == p[0]) {
+        s->cur_func->is_strict = TRUE;
+        s->is_strict = TRUE;
+    }
+}
+
+/* lvalues */
+
+/* the last emitted opcode is the lvalue. It is removed and, if 'keep',
+   replaced by the code reading the value and keeping the object and
+   the property on the stack. *pname holds the reference of the atom
+   operand. */
+static __exception int get_lvalue(JSParseState *s, int *popcode, int *pscope,
+                                  JSAtom *pname, int *pdepth, BOOL keep,
+                                  int tok)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int opcode, scope, depth;
+    JSAtom name;
+
+    scope = 0;
+    name = JS_ATOM_NULL;
+    switch(opcode = get_prev_opcode(fd)) {
+    case OP_scope_get_var:
+        name = get_u32(fd->byte_code.buf + fd->last_opcode_pos + 1);
+        scope = get_u16(fd->byte_code.buf + fd->last_opcode_pos + 5);
+        if (name == JS_ATOM_this)
+            goto invalid_lvalue;
+        if ((name == JS_ATOM_arguments || name == JS_ATOM_eval) &&
+            fd->is_strict)
+            return js_parse_error(s, "invalid lvalue in strict mode");
+        depth = 0;
+        break;
+    case OP_get_field:
+        name = get_u32(fd->byte_code.buf + fd->last_opcode_pos + 1);
+        depth = 1;
+        break;
+    case OP_get_array_el:
+        depth = 2;
+        break;
+    default:
+    invalid_lvalue:
+        if (tok == TOK_INC || tok == TOK_DEC)
+            return js_parse_error(s, "invalid increment/decrement operand");
+        return js_parse_error(s, "invalid assignment left-hand side");
+    }
+    /* remove the last opcode */
+    fd->byte_code.size = fd->last_opcode_pos;
+    fd->last_opcode_pos = -1;
+
+    if (keep) {
+        switch(opcode) {
+        case OP_scope_get_var:
+            emit_op(s, OP_scope_get_var);
+            emit_atom(s, name);
+            emit_u16(s, scope);
+            break;
+        case OP_get_field:
+            emit_op(s, OP_get_field2);
+            emit_atom(s, name);
+            break;
+        case OP_get_array_el:
+            emit_op(s, OP_dup2);
+            emit_op(s, OP_get_array_el);
+            break;
+        }
+    }
+    *popcode = opcode;
+    *pscope = scope;
+    *pname = name;
+    if (pdepth)
+        *pdepth = depth;
+    return 0;
+}
+
+/* store the value on the stack in the lvalue. Take ownership of
+   'name'. */
+static void put_lvalue(JSParseState *s, int opcode, int scope, JSAtom name,
+                       PutLValueEnum special, BOOL is_let)
+{
+    switch(opcode) {
+    case OP_scope_get_var:
+        if (special == PUT_LVALUE_KEEP_TOP)
+            emit_op(s, OP_dup);
+        emit_op(s, is_let ? OP_scope_put_var_init : OP_scope_put_var);
+        emit_u32(s, name);
+        emit_u16(s, scope);
+        break;
+    case OP_get_field:
+        if (special == PUT_LVALUE_KEEP_TOP)
+            emit_op(s, OP_insert2); /* obj v -> v obj v */
+        else if (special == PUT_LVALUE_KEEP_SECOND)
+            emit_op(s, OP_perm3); /* obj v0 v -> v0 obj v */
+        emit_op(s, OP_put_field);
+        emit_u32(s, name);
+        break;
+    case OP_get_array_el:
+        if (special == PUT_LVALUE_KEEP_TOP)
+            emit_op(s, OP_insert3); /* obj prop v -> v obj prop v */
+        else if (special == PUT_LVALUE_KEEP_SECOND)
+            emit_op(s, OP_perm4); /* obj prop v0 v -> v0 obj prop v */
+        emit_op(s, OP_put_array_el);
+        break;
+    default:
+        abort();
+    }
+}
+
+/* expressions */
+
+static __exception int js_parse_template(JSParseState *s)
+{
+    /* the current token is the first part */
+    if (emit_push_string(s, s->token.u.str.str))
+        return -1;
+    while (s->token.u.str.sep == '$') {
+        if (next_token(s))
+            return -1;
+        if (js_parse_expr(s))
+            return -1;
+        emit_op(s, OP_add);
+        if (s->token.val != '}')
+            return js_parse_error(s, "expected '}' after template expression");
+        if (js_parse_template_part(s, s->buf_ptr))
+            return -1;
+        if (JS_VALUE_GET_STRING(s->token.u.str.str)->len != 0) {
+            if (emit_push_string(s, s->token.u.str.str))
+                return -1;
+            emit_op(s, OP_add);
+        }
+    }
+    return next_token(s);
+}
+
+/* property name of an object literal or after '.'. Return JS_ATOM_NULL
+   if error. */
+static JSAtom js_parse_property_name(JSParseState *s, BOOL *pis_ident)
+{
+    JSAtom name;
+
+    *pis_ident = FALSE;
+    if (token_is_ident(s->token.val)) {
+        *pis_ident = is_binding_ident(s);
+        name = JS_DupAtom(s->ctx, s->token.u.ident.atom);
+    } else if (s->token.val == TOK_STRING) {
+        name = JS_ValueToAtom(s->ctx, s->token.u.str.str);
+    } else if (s->token.val == TOK_NUMBER) {
+        name = JS_ValueToAtom(s->ctx, s->token.u.num.val);
+    } else {
+        js_parse_error(s, "invalid property name");
+        return JS_ATOM_NULL;
+    }
+    if (name == JS_ATOM_NULL)
+        return JS_ATOM_NULL;
+    if (next_token(s)) {
+        JS_FreeAtom(s->ctx, name);
+        return JS_ATOM_NULL;
+    }
+    return name;
+}
+
+static __exception int js_parse_object_literal(JSParseState *s)
+{
+    JSAtom name;
+    BOOL is_ident, computed;
+    int line_num;
+
+    if (next_token(s))
+        return -1;
+    emit_op(s, OP_object);
+    while (s->token.val != '}') {
+        name = JS_ATOM_NULL;
+        computed = FALSE;
+        line_num = s->token.line_num;
+        if (s->token.val == TOK_ELLIPSIS)
+            return js_parse_error(s, "spread is not supported");
+        if (s->token.val == '[') {
+            if (next_token(s) || js_parse_assign_expr(s) ||
+                js_parse_expect(s, ']'))
+                return -1;
+            computed = TRUE;
+            is_ident = FALSE;
+        } else {
+            name = js_parse_property_name(s, &is_ident);
+            if (name == JS_ATOM_NULL)
+                return -1;
+            if ((name == JS_ATOM_get || name == JS_ATOM_set) && is_ident &&
+                s->token.val != ':' && s->token.val != '(' &&
+                s->token.val != ',' && s->token.val != '}') {
+                JS_FreeAtom(s->ctx, name);
+                return js_parse_error(s, "getters and setters are not supported");
+            }
+        }
+        if (s->token.val == ':') {
+            if (next_token(s) || js_parse_assign_expr(s))
+                goto fail;
+            if (!computed)
+                set_object_name(s, name);
+        } else if (s->token.val == '(') {
+            if (js_parse_function_decl(s, JS_PARSE_FUNC_METHOD,
+                                       JS_DupAtom(s->ctx, name), line_num))
+                goto fail;
+        } else if (is_ident &&
+                   (s->token.val == ',' || s->token.val == '}')) {
+            /* shorthand property */
+            emit_op(s, OP_scope_get_var);
+            emit_atom(s, name);
+            emit_u16(s, s->cur_func->scope_level);
+        } else {
+            js_parse_error(s, "invalid property definition");
+            goto fail;
+        }
+        if (computed) {
+            emit_op(s, OP_define_array_el);
+        } else {
+            emit_op(s, OP_define_field);
+            emit_u32(s, name);
+        }
+        if (s->token.val != ',')
+            break;
+        if (next_token(s))
+            return -1;
+    }
+    return js_parse_expect(s, '}');
+ fail:
+    JS_FreeAtom(s->ctx, name);
+    return -1;
+}
+
+static __exception int js_parse_array_literal(JSParseState *s)
+{
+    int count;
+
+    if (next_token(s))
+        return -1;
+    count = 0;
+    while (s->token.val != ']') {
+        if (count >= 65535)
+            return js_parse_error(s, "too many elements");
+        if (s->token.val == ',') {
+            /* XXX: the holes are undefined elements */
+            emit_op(s, OP_undefined);
+            count++;
+            if (next_token(s))
+                return -1;
+            continue;
+        }
+        if (s->token.val == TOK_ELLIPSIS)
+            return js_parse_error(s, "spread is not supported");
+        if (js_parse_assign_expr(s))
+            return -1;
+        count++;
+        if (s->token.val == ']')
+            break;
+        if (js_parse_expect(s, ','))
+            return -1;
+    }
+    if (next_token(s))
+        return -1;
+    emit_op(s, OP_array_from);
+    emit_u16(s, count);
+    return 0;
+}
+
+/* parse the call arguments. The current token is '('. */
+static __exception int js_parse_arguments(JSParseState *s, int *pargc)
+{
+    int argc;
+
+    if (next_token(s))
+        return -1;
+    argc = 0;
+    while (s->token.val != ')') {
+        if (argc >= 65535)
+            return js_parse_error(s, "Too many call arguments");
+        if (s->token.val == TOK_ELLIPSIS)
+            return js_parse_error(s, "spread is not supported");
+        if (js_parse_assign_expr(s))
+            return -1;
+        argc++;
+        if (s->token.val == ')')
+            break;
+        if (js_parse_expect(s, ','))
+            return -1;
+    }
+    if (next_token(s))
+        return -1;
+    *pargc = argc;
+    return 0;
+}
+
+static __exception int js_parse_postfix_expr(JSParseState *s, int parse_flags)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    BOOL accept_lparen = (parse_flags & PF_POSTFIX_CALL) != 0;
+    int optional_label, optional_method_label, argc, opcode;
+    JSAtom name;
+
+    switch(s->token.val) {
+    case TOK_NUMBER:
+        if (emit_push_number(s, s->token.u.num.val))
+            return -1;
+        if (next_token(s))
+            return -1;
+        break;
+    case TOK_STRING:
+        if (emit_push_string(s, s->token.u.str.str))
+            return -1;
+        if (next_token(s))
+            return -1;
+        break;
+    case TOK_TEMPLATE:
+        if (js_parse_template(s))
+            return -1;
+        break;
+    case '/':
+    case TOK_DIV_ASSIGN:
+        return js_parse_error(s, "regular expressions are not supported");
+    case '(':
+        if (js_parse_skip_parens_token(s) == TOK_ARROW) {
+            if (js_parse_function_decl(s, JS_PARSE_FUNC_ARROW, JS_ATOM_NULL,
+                                       s->token.line_num))
+                return -1;
+        } else {
+            if (next_token(s))
+                return -1;
+            /* usually called at once: "(function() {...})()" */
+            s->func_in_parens = (s->token.val == TOK_FUNCTION);
+            if (js_parse_expr(s) || js_parse_expect(s, ')'))
+                return -1;
+        }
+        break;
+    case TOK_FUNCTION:
+        if (js_parse_function_decl(s, JS_PARSE_FUNC_EXPR, JS_ATOM_NULL,
+                                   s->token.line_num))
+            return -1;
+        break;
+    case TOK_CLASS:
+        return js_parse_error(s, "classes are not supported");
+    case TOK_NULL:
+        emit_op(s, OP_null);
+        if (next_token(s))
+            return -1;
+        break;
+    case TOK_THIS:
+        if (fd->is_arrow) {
+            emit_op(s, OP_scope_get_var);
+            emit_atom(s, JS_ATOM_this);
+            emit_u16(s, fd->scope_level);
+        } else {
+            emit_op(s, OP_push_this);
+        }
+        if (next_token(s))
+            return -1;
+        break;
+    case TOK_FALSE:
+    case TOK_TRUE:
+        emit_op(s, s->token.val == TOK_TRUE ? OP_push_true : OP_push_false);
+        if (next_token(s))
+            return -1;
+        break;
+    case TOK_IDENT:
+        if (s->token.u.ident.is_reserved) {
+            char buf[64];
+            return js_parse_error(s, "'%s' is a reserved identifier",
+                                  JS_AtomGetStr(ctx, buf, sizeof(buf),
+                                                s->token.u.ident.atom));
+        }
+        if (is_ident_arrow(s)) {
+            if (js_parse_function_decl(s, JS_PARSE_FUNC_ARROW, JS_ATOM_NULL,
+                                       s->token.line_num))
+                return -1;
+            break;
+        }
+        emit_op(s, OP_scope_get_var);
+        emit_atom(s, s->token.u.ident.atom);
+        emit_u16(s, fd->scope_level);
+        if (next_token(s))
+            return -1;
+        break;
+    case '{':
+        if (js_parse_object_literal(s))
+            return -1;
+        break;
+    case '[':
+        if (js_parse_array_literal(s))
+            return -1;
+        break;
+    case TOK_NEW:
+        if (next_token(s))
+            return -1;
+        if (s->token.val == '.') {
+            if (next_token(s))
+                return -1;
+            if (s->token.val != TOK_IDENT ||
+                s->token.u.ident.atom != JS_ATOM_target)
+                return js_parse_error(s, "expecting target");
+            if (next_token(s))
+                return -1;
+            emit_op(s, OP_special_object);
+            emit_u8(s, OP_SPECIAL_OBJECT_NEW_TARGET);
+            break;
+        }
+        if (js_parse_postfix_expr(s, 0))
+            return -1;
+        argc = 0;
+        if (s->token.val == '(') {
+            if (js_parse_arguments(s, &argc))
+                return -1;
+        }
+        emit_op(s, OP_call_constructor);
+        emit_u16(s, argc);
+        break;
+    default:
+        return js_parse_unexpected_token(s);
+    }
+
+    optional_label = -1;
+    optional_method_label = -1;
+    for(;;) {
+        if (s->token.val == TOK_QUESTION_MARK_DOT) {
+            if (next_token(s))
+                return -1;
+            if (optional_label < 0)
+                optional_label = new_label(s);
+            opcode = get_prev_opcode(fd);
+            if (s->token.val == '(' && accept_lparen &&
+                (opcode == OP_get_field || opcode == OP_get_array_el)) {
+                /* a.b?.(): keep 'this' for the call */
+                fd->byte_code.buf[fd->last_opcode_pos] =
+                    (opcode == OP_get_field) ? OP_get_field2 : OP_get_array_el2;
+                if (optional_method_label < 0)
+                    optional_method_label = new_label(s);
+                emit_op(s, OP_dup);
+                emit_op(s, OP_is_undefined_or_null);
+                emit_goto(s, OP_if_true, optional_method_label);
+                if (js_parse_arguments(s, &argc))
+                    return -1;
+                emit_op(s, OP_call_method);
+                emit_u16(s, argc);
+                continue;
+            }
+            emit_op(s, OP_dup);
+            emit_op(s, OP_is_undefined_or_null);
+            emit_goto(s, OP_if_true, optional_label);
+            if (s->token.val == '(' && accept_lparen)
+                goto parse_func_call;
+            if (s->token.val == '[')
+                goto parse_array_access;
+            goto parse_property;
+        } else if (s->token.val == '(' && accept_lparen) {
+        parse_func_call:
+            opcode = get_prev_opcode(fd);
+            if (opcode == OP_get_field) {
+                fd->byte_code.buf[fd->last_opcode_pos] = OP_get_field2;
+            } else if (opcode == OP_get_array_el) {
+                fd->byte_code.buf[fd->last_opcode_pos] = OP_get_array_el2;
+            }
+            if (js_parse_arguments(s, &argc))
+                return -1;
+            if (opcode == OP_get_field || opcode == OP_get_array_el) {
+                emit_op(s, OP_call_method);
+            } else {
+                emit_op(s, OP_call);
+            }
+            emit_u16(s, argc);
+        } else if (s->token.val == '.') {
+            if (next_token(s))
+                return -1;
+        parse_property:
+            if (s->token.val == TOK_PRIVATE_NAME)
+                return js_parse_error(s, "private fields are not supported");
+            if (!token_is_ident(s->token.val))
+                return js_parse_error(s, "expecting field name");
+            name = s->token.u.ident.atom;
+            emit_op(s, OP_get_field);
+            emit_atom(s, name);
+            if (next_token(s))
+                return -1;
+        } else if (s->token.val == '[') {
+        parse_array_access:
+            if (next_token(s) || js_parse_expr(s) || js_parse_expect(s, ']'))
+                return -1;
+            emit_op(s, OP_get_array_el);
+        } else if (s->token.val == TOK_TEMPLATE) {
+            return js_parse_error(s, "tagged templates are not supported");
+        } else {
+            break;
+        }
+    }
+    if (optional_label >= 0) {
+        int label_next = emit_goto(s, OP_goto, -1);
+        if (optional_method_label >= 0) {
+            /* drop the function, 'this' is dropped below */
+            emit_label(s, optional_method_label);
+            emit_op(s, OP_drop);
+        }
+        emit_label(s, optional_label);
+        emit_op(s, OP_drop);
+        emit_op(s, OP_undefined);
+        emit_label(s, label_next);
+        /* the result is not an lvalue */
+        fd->last_opcode_pos = -1;
+    }
+    return 0;
+}
+
+static __exception int js_parse_delete(JSParseState *s)
+{
+    JSFunctionDef *fd = s->cur_func;
+    JSAtom name;
+
+    if (next_token(s))
+        return -1;
+    if (js_parse_unary(s, 0))
+        return -1;
+    switch(get_prev_opcode(fd)) {
+    case OP_get_field:
+        name = get_u32(fd->byte_code.buf + fd->last_opcode_pos + 1);
+        fd->byte_code.size = fd->last_opcode_pos;
+        fd->last_opcode_pos = -1;
+        emit_op(s, OP_push_atom_value);
+        emit_u32(s, name);
+        emit_op(s, OP_delete);
+        break;
+    case OP_get_array_el:
+        fd->byte_code.size = fd->last_opcode_pos;
+        fd->last_opcode_pos = -1;
+        emit_op(s, OP_delete);
+        break;
+    case OP_scope_get_var:
+        if (fd->is_strict)
+            return js_parse_error(s, "cannot delete a direct reference in strict mode");
+        fd->byte_code.buf[fd->last_opcode_pos] = OP_scope_delete_var;
+        break;
+    default:
+        emit_op(s, OP_drop);
+        emit_op(s, OP_push_true);
+        break;
+    }
+    return 0;
+}
+
+static __exception int js_parse_unary(JSParseState *s, int parse_flags)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int op, opcode, scope;
+    JSAtom name;
+
+    switch(s->token.val) {
+    case '+':
+    case '-':
+    case '!':
+    case '~':
+    case TOK_VOID:
+        op = s->token.val;
+        if (next_token(s))
+            return -1;
+        if (js_parse_unary(s, 0))
+            return -1;
+        switch(op) {
+        case '-':
+            emit_op(s, OP_neg);
+            break;
+        case '+':
+            emit_op(s, OP_plus);
+            break;
+        case '!':
+            emit_op(s, OP_lnot);
+            break;
+        case '~':
+            emit_op(s, OP_not);
+            break;
+        case TOK_VOID:
+            emit_op(s, OP_drop);
+            emit_op(s, OP_undefined);
+            break;
+        }
+        parse_flags = PF_POW_FORBIDDEN;
+        break;
+    case TOK_DEC:
+    case TOK_INC:
+        op = s->token.val;
+        if (next_token(s))
+            return -1;
+        if (js_parse_unary(s, 0))
+            return -1;
+        if (get_lvalue(s, &opcode, &scope, &name, NULL, TRUE, op))
+            return -1;
+        emit_op(s, OP_dec + op - TOK_DEC);
+        put_lvalue(s, opcode, scope, name, PUT_LVALUE_KEEP_TOP, FALSE);
+        break;
+    case TOK_TYPEOF:
+        if (next_token(s))
+            return -1;
+        if (js_parse_unary(s, 0))
+            return -1;
+        /* no ReferenceError on the undeclared variables */
+        if (get_prev_opcode(fd) == OP_scope_get_var)
+            fd->byte_code.buf[fd->last_opcode_pos] = OP_scope_get_var_undef;
+        emit_op(s, OP_typeof);
+        parse_flags = PF_POW_FORBIDDEN;
+        break;
+    case TOK_DELETE:
+        if (js_parse_delete(s))
+            return -1;
+        parse_flags = PF_POW_FORBIDDEN;
+        break;
+    default:
+        if (js_parse_postfix_expr(s, PF_POSTFIX_CALL))
+            return -1;
+        if (!s->got_lf &&
+            (s->token.val == TOK_DEC || s->token.val == TOK_INC)) {
+            op = s->token.val;
+            if (get_lvalue(s, &opcode, &scope, &name, NULL, TRUE, op))
+                return -1;
+            emit_op(s, OP_post_dec + op - TOK_DEC);
+            put_lvalue(s, opcode, scope, name, PUT_LVALUE_KEEP_SECOND, FALSE);
+            if (next_token(s))
+                return -1;
+        }
+        break;
+    }
+    if ((parse_flags & (PF_POW_ALLOWED | PF_POW_FORBIDDEN)) &&
+        s->token.val == TOK_POW) {
+        if (parse_flags & PF_POW_FORBIDDEN)
+            return js_parse_error(s, "unparenthesized unary expression can't appear on the left-hand side of '**'");
+        /* right associative */
+        if (next_token(s))
+            return -1;
+        if (js_parse_unary(s, PF_POW_ALLOWED))
+            return -1;
+        emit_op(s, OP_pow);
+    }
+    return 0;
+}
+
+static __exception int js_parse_expr_binary(JSParseState *s, int level,
+                                            int parse_flags)
+{
+    int op, opcode;
+
+    if (level == 0)
+        return js_parse_unary(s, PF_POW_ALLOWED);
+    if (js_parse_expr_binary(s, level - 1, parse_flags))
+        return -1;
+    for(;;) {
+        op = s->token.val;
+        switch(level) {
+        case 1:
+            switch(op) {
+            case '*':
+                opcode = OP_mul;
+                break;
+            case '/':
+                opcode = OP_div;
+                break;
+            case '%':
+                opcode = OP_mod;
+                break;
+            default:
+                return 0;
+            }
+            break;
+        case 2:
+            switch(op) {
+            case '+':
+                opcode = OP_add;
+                break;
+            case '-':
+                opcode = OP_sub;
+                break;
+            default:
+                return 0;
+            }
+            break;
+        case 3:
+            switch(op) {
+            case TOK_SHL:
+                opcode = OP_shl;
+                break;
+            case TOK_SAR:
+                opcode = OP_sar;
+                break;
+            case TOK_SHR:
+                opcode = OP_shr;
+                break;
+            default:
+                return 0;
+            }
+            break;
+        case 4:
+            switch(op) {
+            case '<':
+            case TOK_LT:
+                opcode = OP_lt;
+                break;
+            case '>':
+            case TOK_GT:
+                opcode = OP_gt;
+                break;
+            case TOK_LTE:
+                opcode = OP_lte;
+                break;
+            case TOK_GTE:
+                opcode = OP_gte;
+                break;
+            case TOK_INSTANCEOF:
+                opcode = OP_instanceof;
+                break;
+            case TOK_IN:
+                if (!(parse_flags & PF_IN_ACCEPTED))
+                    return 0;
+                opcode = OP_in;
+                break;
+            default:
+                return 0;
+            }
+            break;
+        case 5:
+            switch(op) {
+            case TOK_EQ:
+                opcode = OP_eq;
+                break;
+            case TOK_NEQ:
+                opcode = OP_neq;
+                break;
+            case TOK_STRICT_EQ:
+                opcode = OP_strict_eq;
+                break;
+            case TOK_STRICT_NEQ:
+                opcode = OP_strict_neq;
+                break;
+            default:
+                return 0;
+            }
+            break;
+        case 6:
+            if (op != '&')
+                return 0;
+            opcode = OP_and;
+            break;
+        case 7:
+            if (op != '^')
+                return 0;
+            opcode = OP_xor;
+            break;
+        case 8:
+            if (op != '|')
+                return 0;
+            opcode = OP_or;
+            break;
+        default:
+            abort();
+        }
+        if (next_token(s))
+            return -1;
+        if (js_parse_expr_binary(s, level - 1, parse_flags))
+            return -1;
+        emit_op(s, opcode);
+    }
+}
+
+static __exception int js_parse_logical_and_or(JSParseState *s, int op,
+                                               int parse_flags)
+{
+    int label1;
+
+    if (op == TOK_LAND) {
+        if (js_parse_expr_binary(s, 8, parse_flags))
+            return -1;
+    } else {
+        if (js_parse_logical_and_or(s, TOK_LAND, parse_flags))
+            return -1;
+    }
+    if (s->token.val == op) {
+        label1 = new_label(s);
+        for(;;) {
+            if (next_token(s))
+                return -1;
+            emit_op(s, OP_dup);
+            emit_goto(s, op == TOK_LAND ? OP_if_false : OP_if_true, label1);
+            emit_op(s, OP_drop);
+            if (op == TOK_LAND) {
+                if (js_parse_expr_binary(s, 8, parse_flags))
+                    return -1;
+            } else {
+                if (js_parse_logical_and_or(s, TOK_LAND, parse_flags))
+                    return -1;
+            }
+            if (s->token.val != op) {
+                if (s->token.val == TOK_DOUBLE_QUESTION_MARK)
+                    return js_parse_error(s, "cannot mix ?? with && or ||");
+                break;
+            }
+        }
+        emit_label(s, label1);
+    }
+    return 0;
+}
+
+static __exception int js_parse_coalesce_expr(JSParseState *s, int parse_flags)
+{
+    int label1;
+
+    if (js_parse_logical_and_or(s, TOK_LOR, parse_flags))
+        return -1;
+    if (s->token.val == TOK_DOUBLE_QUESTION_MARK) {
+        label1 = new_label(s);
+        for(;;) {
+            if (next_token(s))
+                return -1;
+            emit_op(s, OP_dup);
+            emit_op(s, OP_is_undefined_or_null);
+            emit_goto(s, OP_if_false, label1);
+            emit_op(s, OP_drop);
+            if (js_parse_expr_binary(s, 8, parse_flags))
+                return -1;
+            if (s->token.val != TOK_DOUBLE_QUESTION_MARK)
+                break;
+        }
+        emit_label(s, label1);
+    }
+    return 0;
+}
+
+static __exception int js_parse_cond_expr(JSParseState *s, int parse_flags)
+{
+    int label1, label2;
+
+    if (js_parse_coalesce_expr(s, parse_flags))
+        return -1;
+    if (s->token.val == '?') {
+        if (next_token(s))
+            return -1;
+        label1 = emit_goto(s, OP_if_false, -1);
+        if (js_parse_assign_expr(s))
+            return -1;
+        if (js_parse_expect(s, ':'))
+            return -1;
+        label2 = emit_goto(s, OP_goto, -1);
+        emit_label(s, label1);
+        if (js_parse_assign_expr2(s, parse_flags & PF_IN_ACCEPTED))
+            return -1;
+        emit_label(s, label2);
+    }
+    return 0;
+}
+
+static const uint8_t assign_opcodes[] = {
+    OP_mul, OP_div, OP_mod, OP_add, OP_sub,
+    OP_shl, OP_sar, OP_shr, OP_and, OP_xor, OP_or, OP_pow,
+};
+
+static void emit_generator_return(JSParseState *s);
+
+/* the generator suspends its frame on OP_yield. It is resumed with the
+   received value and TRUE if it must return it (see js_generator_next()) */
+static __exception int js_parse_yield(JSParseState *s, int parse_flags)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int label;
+
+    if (!fd->is_generator)
+        return js_parse_error(s, "'yield' is only valid in generators");
+    if (fd->body_scope == 0)
+        return js_parse_error(s, "yield is not allowed in the parameters");
+    if (next_token(s))
+        return -1;
+    if (s->token.val == '*')
+        return js_parse_error(s, "yield* is not supported");
+    if (s->token.val == ';' || s->token.val == ')' ||
+        s->token.val == ']' || s->token.val == '}' ||
+        s->token.val == ',' || s->token.val == ':' ||
+        s->token.val == TOK_EOF || s->got_lf) {
+        emit_op(s, OP_undefined);
+    } else {
+        if (js_parse_assign_expr2(s, parse_flags))
+            return -1;
+    }
+    emit_op(s, OP_yield);
+    label = new_label(s);
+    emit_goto(s, OP_if_false, label);
+    emit_generator_return(s);
+    emit_label(s, label);
+    return 0;
+}
+
+static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags)
+{
+    JSContext *ctx = s->ctx;
+    int op, opcode, scope, depth, label1, label2;
+    JSAtom name0, name;
+
+    if (s->token.val == TOK_YIELD)
+        return js_parse_yield(s, parse_flags);
+    name0 = JS_ATOM_NULL;
+    if (is_binding_ident(s))
+        name0 = JS_DupAtom(ctx, s->token.u.ident.atom);
+    if (js_parse_cond_expr(s, parse_flags))
+        goto fail;
+
+    op = s->token.val;
+    if (op == '=' || (op >= TOK_MUL_ASSIGN && op <= TOK_POW_ASSIGN)) {
+        if (next_token(s))
+            goto fail;
+        if (get_lvalue(s, &opcode, &scope, &name, NULL, (op != '='), op))
+            goto fail;
+        if (js_parse_assign_expr2(s, parse_flags)) {
+            JS_FreeAtom(ctx, name);
+            goto fail;
+        }
+        if (op == '=') {
+            if (opcode == OP_scope_get_var && name == name0)
+                set_object_name(s, name);
+        } else {
+            emit_op(s, assign_opcodes[op - TOK_MUL_ASSIGN]);
+        }
+        put_lvalue(s, opcode, scope, name, PUT_LVALUE_KEEP_TOP, FALSE);
+    } else if (op >= TOK_LAND_ASSIGN && op <= TOK_DOUBLE_QUESTION_MARK_ASSIGN) {
+        if (next_token(s))
+            goto fail;
+        if (get_lvalue(s, &opcode, &scope, &name, &depth, TRUE, op))
+            goto fail;
+        emit_op(s, OP_dup);
+        if (op == TOK_DOUBLE_QUESTION_MARK_ASSIGN)
+            emit_op(s, OP_is_undefined_or_null);
+        label1 = emit_goto(s, op == TOK_LOR_ASSIGN ? OP_if_true : OP_if_false,
+                           -1);
+        emit_op(s, OP_drop);
+        if (js_parse_assign_expr2(s, parse_flags)) {
+            JS_FreeAtom(ctx, name);
+            goto fail;
+        }
+        if (opcode == OP_scope_get_var && name == name0)
+            set_object_name(s, name);
+        put_lvalue(s, opcode, scope, name, PUT_LVALUE_KEEP_TOP, FALSE);
+        label2 = emit_goto(s, OP_goto, -1);
+        emit_label(s, label1);
+        /* remove the lvalue stack entries */
+        while (depth-- > 0)
+            emit_op(s, OP_nip);
+        emit_label(s, label2);
+    }
+    JS_FreeAtom(ctx, name0);
+    return 0;
+ fail:
+    JS_FreeAtom(ctx, name0);
+    return -1;
+}
+
+static __exception int js_parse_assign_expr(JSParseState *s)
+{
+    return js_parse_assign_expr2(s, PF_IN_ACCEPTED);
+}
+
+static __exception int js_parse_expr2(JSParseState *s, int parse_flags)
+{
+    BOOL comma = FALSE;
+
+    for(;;) {
+        if (js_parse_assign_expr2(s, parse_flags))
+            return -1;
+        if (comma) {
+            /* the last expression is not an lvalue */
+            s->cur_func->last_opcode_pos = -1;
+        }
+        if (s->token.val != ',')
+            break;
+        comma = TRUE;
+        if (next_token(s))
+            return -1;
+        emit_op(s, OP_drop);
+    }
+    return 0;
+}
+
+static __exception int js_parse_expr(JSParseState *s)
+{
+    return js_parse_expr2(s, PF_IN_ACCEPTED);
+}
+
+/* functions */
+
+/* parse the arguments and the body of 'cfd' (the current function).
+   The source range is recorded for the lazy compilation. On return,
+   the current function is the parent of 'cfd'. */
+static __exception int js_parse_function_body(JSParseState *s,
+                                              JSFunctionDef *cfd,
+                                              JSParseFunctionEnum func_type)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = cfd->parent;
+    BOOL has_default;
+    int idx, label;
+    JSAtom name;
+
+    cfd->func_type = func_type;
+    cfd->source_ptr = s->token.ptr;
+    cfd->source_line_num = s->token.line_num;
+
+    /* the arguments */
+    if (func_type == JS_PARSE_FUNC_ARROW && s->token.val == TOK_IDENT) {
+        if (add_arg(ctx, cfd, s->token.u.ident.atom) < 0 || next_token(s))
+            return -1;
+        cfd->defined_arg_count = 1;
+    } else {
+        if (js_parse_expect(s, '('))
+            return -1;
+        has_default = FALSE;
+        while (s->token.val != ')') {
+            if (s->token.val == TOK_ELLIPSIS)
+                return js_parse_error(s, "rest parameters are not supported");
+            if (!is_binding_ident(s))
+                return js_parse_error(s, "missing formal parameter");
+            name = s->token.u.ident.atom;
+            if (cfd->is_strict && find_arg(cfd, name) >= 0)
+                return js_parse_error(s, "duplicate argument names not allowed in this context");
+            idx = add_arg(ctx, cfd, name);
+            if (idx < 0 || next_token(s))
+                return -1;
+            if (s->token.val == '=') {
+                /* default value, evaluated if the argument is undefined */
+                has_default = TRUE;
+                if (next_token(s))
+                    return -1;
+                emit_op(s, OP_get_arg);
+                emit_u16(s, idx);
+                emit_op(s, OP_undefined);
+                emit_op(s, OP_strict_eq);
+                label = emit_goto(s, OP_if_false, -1);
+                if (js_parse_assign_expr(s))
+                    return -1;
+                emit_op(s, OP_put_arg);
+                emit_u16(s, idx);
+                emit_label(s, label);
+            } else if (!has_default) {
+                cfd->defined_arg_count = cfd->arg_count;
+            }
+            if (s->token.val == ')')
+                break;
+            if (js_parse_expect(s, ','))
+                return -1;
+        }
+        if (next_token(s))
+            return -1;
+    }
+
+    if (cfd->is_generator) {
+        /* the generator object is returned once the default values of
+           the arguments are evaluated */
+        emit_op(s, OP_initial_yield);
+    }
+
+    if (func_type == JS_PARSE_FUNC_ARROW) {
+        if (s->token.val != TOK_ARROW)
+            return js_parse_error(s, "expecting '%s'", "=>");
+        if (next_token(s))
+            return -1;
+    }
+
+    /* the body */
+    if (func_type == JS_PARSE_FUNC_ARROW && s->token.val != '{') {
+        if (push_scope(s) < 0)
+            return -1;
+        cfd->body_scope = cfd->scope_level;
+        if (js_parse_assign_expr(s))
+            return -1;
+        emit_op(s, OP_return);
+        s->cur_func = fd;
+        s->is_strict = fd ? fd->is_strict : FALSE;
+        s->is_generator = fd ? fd->is_generator : FALSE;
+    } else {
+        if (s->token.val != '{')
+            return js_parse_error(s, "expecting '%c'", '{');
+        if (next_token(s))
+            return -1;
+        js_parse_directives(s);
+        if (push_scope(s) < 0)
+            return -1;
+        cfd->body_scope = cfd->scope_level;
+        while (s->token.val != '}') {
+            if (js_parse_statement_or_decl(s, TRUE))
+                return -1;
+        }
+        if (js_is_live_code(s))
+            emit_op(s, OP_return_undef);
+        /* the token after the body is read in the mode of the parent */
+        s->cur_func = fd;
+        s->is_strict = fd ? fd->is_strict : FALSE;
+        s->is_generator = fd ? fd->is_generator : FALSE;
+        if (next_token(s))
+            return -1;
+    }
+    /* end of the last token of the function */
+    cfd->source_end = s->last_ptr;
+    if (dbuf_error(&cfd->byte_code)) {
+        JS_ThrowOutOfMemory(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+static __exception int js_parse_function_decl(JSParseState *s,
+                                              JSParseFunctionEnum func_type,
+                                              JSAtom func_name,
+                                              int function_line_num)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    JSFunctionDef *cfd;
+    BOOL is_eager, is_generator;
+    int idx;
+
+    is_eager = s->func_in_parens;
+    is_generator = FALSE;
+    s->func_in_parens = FALSE;
+    if (func_type == JS_PARSE_FUNC_STATEMENT ||
+        func_type == JS_PARSE_FUNC_EXPR) {
+        if (next_token(s))
+            goto fail;
+        if (s->token.val == '*') {
+            if (next_token(s))
+                goto fail;
+            is_generator = TRUE;
+        }
+        if (is_binding_ident(s)) {
+            func_name = JS_DupAtom(ctx, s->token.u.ident.atom);
+            if (next_token(s))
+                goto fail;
+        } else if (func_type == JS_PARSE_FUNC_STATEMENT) {
+            js_parse_error(s, "function name expected");
+            goto fail;
+        }
+    }
+
+    cfd = js_new_function_def(ctx, fd,
+                              func_type == JS_PARSE_FUNC_EXPR &&
+                              func_name != JS_ATOM_NULL,
+                              JS_DupAtom(ctx, fd->filename),
+                              function_line_num);
+    if (!cfd)
+        goto fail;
+    cfd->func_name = func_name;
+    func_name = JS_ATOM_NULL;
+    cfd->is_arrow = (func_type == JS_PARSE_FUNC_ARROW);
+    cfd->is_generator = is_generator;
+    cfd->has_prototype = (func_type == JS_PARSE_FUNC_STATEMENT ||
+                          func_type == JS_PARSE_FUNC_EXPR) && !is_generator;
+    cfd->is_lazy = !fd->is_eager && !is_eager;
+    s->cur_func = cfd;
+    s->is_generator = is_generator;
+
+    if (js_parse_function_body(s, cfd, func_type))
+        goto fail;
+
+    idx = cpool_add(s, JS_NULL);
+    if (idx < 0)
+        goto fail;
+    cfd->parent_cpool_idx = idx;
+    if (func_type == JS_PARSE_FUNC_STATEMENT) {
+        if (define_function(s, cfd->func_name, idx))
+            goto fail;
+    } else {
+        emit_op(s, OP_fclosure);
+        emit_u32(s, idx);
+    }
+    return 0;
+ fail:
+    /* the function definition is freed with its parent */
+    s->cur_func = fd;
+    s->is_strict = fd->is_strict;
+    s->is_generator = fd->is_generator;
+    JS_FreeAtom(ctx, func_name);
+    return -1;
+}
+
+/* statements */
+
+static __exception int js_parse_var(JSParseState *s, int tok,
+                                    int parse_flags)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    JSAtom name;
+
+    for(;;) {
+        if (s->token.val == '[' || s->token.val == '{')
+            return js_parse_error(s, "destructuring is not supported");
+        if (!is_binding_ident(s))
+            return js_parse_error(s, "variable name expected");
+        name = JS_DupAtom(ctx, s->token.u.ident.atom);
+        if (tok != TOK_VAR && name == JS_ATOM_let) {
+            js_parse_error(s, "'let' is not a valid lexical identifier");
+            goto fail;
+        }
+        if (define_var(s, name, tok) || next_token(s))
+            goto fail;
+        if (s->token.val == '=') {
+            if (next_token(s))
+                goto fail;
+            if (js_parse_assign_expr2(s, parse_flags))
+                goto fail;
+            set_object_name(s, name);
+            emit_op(s, tok == TOK_VAR ? OP_scope_put_var : OP_scope_put_var_init);
+            emit_atom(s, name);
+            emit_u16(s, fd->scope_level);
+        } else if (tok == TOK_CONST) {
+            js_parse_error(s, "missing initializer for const variable");
+            goto fail;
+        } else if (tok == TOK_LET) {
+            emit_op(s, OP_undefined);
+            emit_op(s, OP_scope_put_var_init);
+            emit_atom(s, name);
+            emit_u16(s, fd->scope_level);
+        }
+        JS_FreeAtom(ctx, name);
+        if (s->token.val != ',')
+            break;
+        if (next_token(s))
+            return -1;
+    }
+    return 0;
+ fail:
+    JS_FreeAtom(ctx, name);
+    return -1;
+}
+
+static __exception int js_parse_block(JSParseState *s)
+{
+    if (js_parse_expect(s, '{'))
+        return -1;
+    if (s->token.val != '}') {
+        if (push_scope(s) < 0)
+            return -1;
+        for(;;) {
+            if (js_parse_statement_or_decl(s, TRUE))
+                return -1;
+            if (s->token.val == '}')
+                break;
+        }
+        pop_scope(s);
+    }
+    return next_token(s);
+}
+
+static __exception int emit_break(JSParseState *s, JSAtom name, int is_cont)
+{
+    BlockEnv *top;
+    int i, scope_level;
+
+    scope_level = s->cur_func->scope_level;
+    top = s->cur_func->top_break;
+    while (top != NULL) {
+        close_scopes(s, scope_level, top->scope_level);
+        scope_level = top->scope_level;
+        if (is_cont && top->label_cont != -1 &&
+            (name == JS_ATOM_NULL || top->label_name == name)) {
+            /* continue stays inside the same block */
+            emit_goto(s, OP_goto, top->label_cont);
+            return 0;
+        }
+        if (!is_cont && top->label_break != -1 &&
+            ((name == JS_ATOM_NULL && !top->is_regular_stmt) ||
+             (name != JS_ATOM_NULL && top->label_name == name))) {
+            emit_goto(s, OP_goto, top->label_break);
+            return 0;
+        }
+        for(i = 0; i < top->drop_count; i++)
+            emit_op(s, OP_drop);
+        if (top->label_finally != -1) {
+            /* must push dummy value to keep same stack depth */
+            emit_op(s, OP_undefined);
+            emit_goto(s, OP_gosub, top->label_finally);
+            emit_op(s, OP_drop);
+        }
+        top = top->prev;
+    }
+    if (name == JS_ATOM_NULL) {
+        if (is_cont)
+            return js_parse_error(s, "continue must be inside loop");
+        else
+            return js_parse_error(s, "break must be inside loop or switch");
+    } else {
+        return js_parse_error(s, "break/continue label not found");
+    }
+}
+
+/* the finally blocks are run before returning */
+static void emit_return(JSParseState *s, BOOL hasval)
+{
+    BlockEnv *top;
+    int drop_count;
+
+    drop_count = 0;
+    top = s->cur_func->top_break;
+    while (top != NULL) {
+        drop_count += top->drop_count;
+        if (top->label_finally != -1) {
+            if (!hasval) {
+                emit_op(s, OP_undefined);
+                hasval = TRUE;
+            }
+            /* remove the stack elements up to the catch offset */
+            for(; drop_count > 0; drop_count--)
+                emit_op(s, OP_nip);
+            emit_goto(s, OP_gosub, top->label_finally);
+        }
+        top = top->prev;
+    }
+    emit_op(s, hasval ? OP_return : OP_return_undef);
+}
+
+/* return() of a suspended generator: the yield may be in the middle
+   of an expression, so the stack is dropped up to the catch offsets */
+static void emit_generator_return(JSParseState *s)
+{
+    BlockEnv *top;
+
+    for(top = s->cur_func->top_break; top != NULL; top = top->prev) {
+        if (top->label_finally != -1) {
+            emit_op(s, OP_nip_catch);
+            emit_goto(s, OP_gosub, top->label_finally);
+        }
+    }
+    emit_op(s, OP_return);
+}
+
+static __exception int js_parse_try(JSParseState *s)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    int label_catch, label_catch2, label_finally, label_end;
+    int saved_eval_ret;
+    JSAtom name;
+    BlockEnv block_env;
+
+    if (next_token(s))
+        return -1;
+    label_catch = new_label(s);
+    label_catch2 = new_label(s);
+    label_finally = new_label(s);
+    label_end = new_label(s);
+
+    emit_goto(s, OP_catch, label_catch);
+
+    push_break_entry(fd, &block_env, JS_ATOM_NULL, -1, -1, 1);
+    block_env.label_finally = label_finally;
+    if (js_parse_block(s))
+        return -1;
+    pop_break_entry(fd);
+
+    if (js_is_live_code(s)) {
+        /* drop the catch offset */
+        emit_op(s, OP_drop);
+        /* must push dummy value to keep same stack size */
+        emit_op(s, OP_undefined);
+        emit_goto(s, OP_gosub, label_finally);
+        emit_op(s, OP_drop);
+        emit_goto(s, OP_goto, label_end);
+    }
+
+    if (s->token.val == TOK_CATCH) {
+        if (next_token(s))
+            return -1;
+        emit_label(s, label_catch);
+        if (push_scope(s) < 0) /* catch variable */
+            return -1;
+        if (s->token.val == '{') {
+            /* optional catch binding */
+            emit_op(s, OP_drop);
+        } else {
+            if (js_parse_expect(s, '('))
+                return -1;
+            if (s->token.val == '[' || s->token.val == '{')
+                return js_parse_error(s, "destructuring is not supported");
+            if (!is_binding_ident(s))
+                return js_parse_error(s, "identifier expected");
+            name = JS_DupAtom(ctx, s->token.u.ident.atom);
+            if (next_token(s) || define_var(s, name, TOK_CATCH)) {
+                JS_FreeAtom(ctx, name);
+                return -1;
+            }
+            /* store the exception value in the catch variable */
+            emit_op(s, OP_scope_put_var_init);
+            emit_u32(s, name);
+            emit_u16(s, fd->scope_level);
+            if (js_parse_expect(s, ')'))
+                return -1;
+        }
+        emit_goto(s, OP_catch, label_catch2);
+
+        push_break_entry(fd, &block_env, JS_ATOM_NULL, -1, -1, 1);
+        block_env.label_finally = label_finally;
+        if (js_parse_block(s))
+            return -1;
+        pop_break_entry(fd);
+        pop_scope(s); /* catch variable */
+
+        if (js_is_live_code(s)) {
+            /* drop the catch2 offset */
+            emit_op(s, OP_drop);
+            emit_op(s, OP_undefined);
+            emit_goto(s, OP_gosub, label_finally);
+            emit_op(s, OP_drop);
+            emit_goto(s, OP_goto, label_end);
+        }
+        /* the exceptions thrown in the catch block run the finally
+           clause and are thrown again */
+        emit_label(s, label_catch2);
+        emit_goto(s, OP_gosub, label_finally);
+        emit_op(s, OP_throw);
+    } else if (s->token.val == TOK_FINALLY) {
+        /* finally without catch: run the finally clause and throw the
+           exception again */
+        emit_label(s, label_catch);
+        emit_goto(s, OP_gosub, label_finally);
+        emit_op(s, OP_throw);
+    } else {
+        return js_parse_error(s, "expecting catch or finally");
+    }
+    emit_label(s, label_finally);
+    if (s->token.val == TOK_FINALLY) {
+        if (next_token(s))
+            return -1;
+        saved_eval_ret = -1;
+        if (fd->eval_ret_idx >= 0) {
+            /* the finally clause does not change the completion value */
+            saved_eval_ret = add_var(ctx, fd, JS_ATOM__ret_);
+            if (saved_eval_ret < 0)
+                return -1;
+            emit_op(s, OP_get_loc);
+            emit_u16(s, fd->eval_ret_idx);
+            emit_op(s, OP_put_loc);
+            emit_u16(s, saved_eval_ret);
+        }
+        /* on the stack: ret_value gosub_ret_value */
+        push_break_entry(fd, &block_env, JS_ATOM_NULL, -1, -1, 2);
+        if (js_parse_block(s))
+            return -1;
+        pop_break_entry(fd);
+        if (saved_eval_ret >= 0) {
+            emit_op(s, OP_get_loc);
+            emit_u16(s, saved_eval_ret);
+            emit_op(s, OP_put_loc);
+            emit_u16(s, fd->eval_ret_idx);
+        }
+    }
+    emit_op(s, OP_ret);
+    emit_label(s, label_end);
+    return 0;
+}
+
+static __exception int js_parse_switch(JSParseState *s, JSAtom label_name)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int label_case, label_break, label1, default_label_pos;
+    BlockEnv break_entry;
+
+    if (next_token(s))
+        return -1;
+    if (js_parse_expect(s, '(') || js_parse_expr(s) ||
+        js_parse_expect(s, ')') || js_parse_expect(s, '{'))
+        return -1;
+    if (push_scope(s) < 0)
+        return -1;
+    label_break = new_label(s);
+    push_break_entry(fd, &break_entry, label_name, label_break, -1, 1);
+    label_case = -1;
+    default_label_pos = -1;
+    while (s->token.val != '}') {
+        if (s->token.val == TOK_CASE) {
+            label1 = -1;
+            if (label_case >= 0) {
+                /* skip the tests when falling through */
+                label1 = emit_goto(s, OP_goto, -1);
+            }
+            emit_label(s, label_case);
+            label_case = -1;
+            for(;;) {
+                /* sequence of case clauses */
+                if (next_token(s))
+                    return -1;
+                emit_op(s, OP_dup);
+                if (js_parse_expr(s))
+                    return -1;
+                if (js_parse_expect(s, ':'))
+                    return -1;
+                emit_op(s, OP_strict_eq);
+                if (s->token.val == TOK_CASE) {
+                    label1 = emit_goto(s, OP_if_true, label1);
+                } else {
+                    label_case = emit_goto(s, OP_if_false, -1);
+                    emit_label(s, label1);
+                    break;
+                }
+            }
+        } else if (s->token.val == TOK_DEFAULT) {
+            if (next_token(s) || js_parse_expect(s, ':'))
+                return -1;
+            if (default_label_pos >= 0)
+                return js_parse_error(s, "duplicate default");
+            if (label_case < 0) {
+                /* falling thru direct from switch expression */
+                label_case = emit_goto(s, OP_goto, -1);
+            }
+            /* the label is set when the last test is known */
+            emit_op(s, OP_label);
+            emit_u32(s, 0);
+            default_label_pos = fd->byte_code.size - 4;
+        } else {
+            if (label_case < 0)
+                return js_parse_error(s, "invalid switch statement");
+            if (js_parse_statement_or_decl(s, TRUE))
+                return -1;
+        }
+    }
+    if (js_parse_expect(s, '}'))
+        return -1;
+    if (default_label_pos >= 0) {
+        /* the failed tests go to the default clause */
+        put_u32(fd->byte_code.buf + default_label_pos, label_case);
+    } else {
+        emit_label(s, label_case);
+    }
+    emit_label(s, label_break);
+    emit_op(s, OP_drop); /* drop the switch expression */
+    pop_break_entry(fd);
+    pop_scope(s);
+    return 0;
+}
+
+/* 'for(;;)'. The 'let' variables of the init clause get a new binding
+   for each iteration: the closures are detached at the end of the
+   body. */
+static __exception int js_parse_for(JSParseState *s, JSAtom label_name)
+{
+    JSFunctionDef *fd = s->cur_func;
+    int tok, label_test, label_cont, label_body, label_break;
+    BOOL has_update;
+    BlockEnv break_entry;
+
+    if (next_token(s))
+        return -1;
+    if (js_parse_expect(s, '('))
+        return -1;
+    if (push_scope(s) < 0)
+        return -1;
+    tok = s->token.val;
+    if (tok == TOK_IDENT && s->token.u.ident.atom == JS_ATOM_let &&
+        !s->token.u.ident.has_escape) {
+        BOOL got_lf;
+        const uint8_t *p = js_parse_peek(s, &got_lf);
+        if (*p != '=' && *p != ';' && *p != ')')
+            tok = TOK_LET;
+    }
+    if (tok == TOK_VAR || tok == TOK_LET || tok == TOK_CONST) {
+        if (next_token(s))
+            return -1;
+        if (js_parse_var(s, tok, 0))
+            return -1;
+    } else if (s->token.val != ';') {
+        if (js_parse_expr2(s, 0))
+            return -1;
+        emit_op(s, OP_drop);
+    }
+    if (s->token.val == TOK_IN ||
+        (s->token.val == TOK_IDENT && s->token.u.ident.atom == JS_ATOM_of))
+        return js_parse_error(s, "for-in and for-of loops are not supported");
+    if (js_parse_expect(s, ';'))
+        return -1;
+
+    label_test = new_label(s);
+    label_cont = new_label(s);
+    label_body = new_label(s);
+    label_break = new_label(s);
+    push_break_entry(fd, &break_entry, label_name, label_break, label_cont, 0);
+
+    emit_label(s, label_test);
+    if (s->token.val != ';') {
+        if (js_parse_expr(s))
+            return -1;
+        emit_goto(s, OP_if_false, label_break);
+    }
+    if (js_parse_expect(s, ';'))
+        return -1;
+
+    has_update = (s->token.val != ')');
+    if (has_update) {
+        /* the update expression is emitted before the body */
+        emit_goto(s, OP_goto, label_body);
+        emit_label(s, label_cont);
+        close_scopes(s, fd->scope_level, fd->scopes[fd->scope_level].parent);
+        if (js_parse_expr(s))
+            return -1;
+        emit_op(s, OP_drop);
+        emit_goto(s, OP_goto, label_test);
+        emit_label(s, label_body);
+    }
+    if (js_parse_expect(s, ')'))
+        return -1;
+    if (js_parse_statement_or_decl(s, FALSE))
+        return -1;
+    if (has_update) {
+        emit_goto(s, OP_goto, label_cont);
+    } else {
+        emit_label(s, label_cont);
+        close_scopes(s, fd->scope_level, fd->scopes[fd->scope_level].parent);
+        emit_goto(s, OP_goto, label_test);
+    }
+    emit_label(s, label_break);
+    pop_break_entry(fd);
+    pop_scope(s);
+    return 0;
+}
+
+static __exception int js_parse_statement_or_decl(JSParseState *s,
+                                                  BOOL allow_decl)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    JSAtom label_name;
+    BlockEnv break_entry;
+    int tok, label_cont, label_break, label1, label2;
+
+    label_name = JS_ATOM_NULL;
+    if (is_label(s)) {
+        BlockEnv *be;
+
+        for(be = fd->top_break; be; be = be->prev) {
+            if (be->label_name == s->token.u.ident.atom)
+                return js_parse_error(s, "duplicate label name");
+        }
+        label_name = JS_DupAtom(ctx, s->token.u.ident.atom);
+        if (next_token(s) || next_token(s))
+            goto fail;
+        if (s->token.val != TOK_FOR && s->token.val != TOK_DO &&
+            s->token.val != TOK_WHILE) {
+            /* labeled regular statement */
+            label_break = new_label(s);
+            push_break_entry(fd, &break_entry, label_name, label_break, -1, 0);
+            break_entry.is_regular_stmt = TRUE;
+            if (js_parse_statement_or_decl(s, FALSE))
+                goto fail;
+            emit_label(s, label_break);
+            pop_break_entry(fd);
+            goto done;
+        }
+    }
+
+    tok = s->token.val;
+    switch(tok) {
+    case '{':
+        if (js_parse_block(s))
+            goto fail;
+        break;
+    case TOK_RETURN:
+        if (fd->eval_ret_idx >= 0) {
+            js_parse_error(s, "return not in a function");
+            goto fail;
+        }
+        if (next_token(s))
+            goto fail;
+        if (s->token.val != ';' && s->token.val != '}' &&
+            s->token.val != TOK_EOF && !s->got_lf) {
+            if (js_parse_expr(s))
+                goto fail;
+            emit_return(s, TRUE);
+        } else {
+            emit_return(s, FALSE);
+        }
+        if (js_parse_expect_semi(s))
+            goto fail;
+        break;
+    case TOK_THROW:
+        if (next_token(s))
+            goto fail;
+        if (s->got_lf) {
+            js_parse_error(s, "line terminator not allowed after throw");
+            goto fail;
+        }
+        if (js_parse_expr(s))
+            goto fail;
+        emit_op(s, OP_throw);
+        if (js_parse_expect_semi(s))
+            goto fail;
+        break;
+    case TOK_LET:
+    case TOK_CONST:
+    lexical_decl:
+        if (!allow_decl) {
+            js_parse_error(s, "lexical declaration cannot appear in a single-statement context");
+            goto fail;
+        }
+        /* fall thru */
+    case TOK_VAR:
+        if (next_token(s))
+            goto fail;
+        if (js_parse_var(s, tok, PF_IN_ACCEPTED))
+            goto fail;
+        if (js_parse_expect_semi(s))
+            goto fail;
+        break;
+    case TOK_IF:
+        if (next_token(s))
+            goto fail;
+        if (js_parse_expect(s, '(') || js_parse_expr(s) ||
+            js_parse_expect(s, ')'))
+            goto fail;
+        label1 = emit_goto(s, OP_if_false, -1);
+        if (js_parse_statement_or_decl(s, FALSE))
+            goto fail;
+        if (s->token.val == TOK_ELSE) {
+            label2 = emit_goto(s, OP_goto, -1);
+            if (next_token(s))
+                goto fail;
+            emit_label(s, label1);
+            if (js_parse_statement_or_decl(s, FALSE))
+                goto fail;
+            label1 = label2;
+        }
+        emit_label(s, label1);
+        break;
+    case TOK_WHILE:
+        label_cont = new_label(s);
+        label_break = new_label(s);
+        push_break_entry(fd, &break_entry, label_name, label_break,
+                         label_cont, 0);
+        if (next_token(s))
+            goto fail;
+        emit_label(s, label_cont);
+        if (js_parse_expect(s, '(') || js_parse_expr(s) ||
+            js_parse_expect(s, ')'))
+            goto fail;
+        emit_goto(s, OP_if_false, label_break);
+        if (js_parse_statement_or_decl(s, FALSE))
+            goto fail;
+        emit_goto(s, OP_goto, label_cont);
+        emit_label(s, label_break);
+        pop_break_entry(fd);
+        break;
+    case TOK_DO:
+        label_cont = new_label(s);
+        label_break = new_label(s);
+        label1 = new_label(s);
+        push_break_entry(fd, &break_entry, label_name, label_break,
+                         label_cont, 0);
+        if (next_token(s))
+            goto fail;
+        emit_label(s, label1);
+        if (js_parse_statement_or_decl(s, FALSE))
+            goto fail;
+        emit_label(s, label_cont);
+        if (s->token.val != TOK_WHILE) {
+            js_parse_error(s, "expecting '%s'", "while");
+            goto fail;
+        }
+        if (next_token(s))
+            goto fail;
+        if (js_parse_expect(s, '(') || js_parse_expr(s) ||
+            js_parse_expect(s, ')'))
+            goto fail;
+        /* the ';' is optional after do-while */
+        if (s->token.val == ';') {
+            if (next_token(s))
+                goto fail;
+        }
+        emit_goto(s, OP_if_true, label1);
+        emit_label(s, label_break);
+        pop_break_entry(fd);
+        break;
+    case TOK_FOR:
+        if (js_parse_for(s, label_name))
+            goto fail;
+        break;
+    case TOK_BREAK:
+    case TOK_CONTINUE:
+        {
+            JSAtom name = JS_ATOM_NULL;
+
+            if (next_token(s))
+                goto fail;
+            if (!s->got_lf && is_binding_ident(s))
+                name = s->token.u.ident.atom;
+            if (emit_break(s, name, tok == TOK_CONTINUE))
+                goto fail;
+            if (name != JS_ATOM_NULL) {
+                if (next_token(s))
+                    goto fail;
+            }
+            if (js_parse_expect_semi(s))
+                goto fail;
+        }
+        break;
+    case TOK_SWITCH:
+        if (js_parse_switch(s, label_name))
+            goto fail;
+        break;
+    case TOK_TRY:
+        if (js_parse_try(s))
+            goto fail;
+        break;
+    case ';':
+        if (next_token(s))
+            goto fail;
+        break;
+    case TOK_DEBUGGER:
+        if (next_token(s) || js_parse_expect_semi(s))
+            goto fail;
+        break;
+    case TOK_FUNCTION:
+        if (!allow_decl) {
+            js_parse_error(s, "function declarations can't appear in single-statement context");
+            goto fail;
+        }
+        if (js_parse_function_decl(s, JS_PARSE_FUNC_STATEMENT, JS_ATOM_NULL,
+                                   s->token.line_num))
+            goto fail;
+        break;
+    case TOK_CLASS:
+        js_parse_error(s, "classes are not supported");
+        goto fail;
+    case TOK_WITH:
+        js_parse_error(s, "'with' is not supported");
+        goto fail;
+    case TOK_IMPORT:
+    case TOK_EXPORT:
+        js_parse_error(s, "modules are not supported");
+        goto fail;
+    default:
+        if (tok == TOK_IDENT && s->token.u.ident.atom == JS_ATOM_let &&
+            !s->token.u.ident.has_escape) {
+            /* 'let' is a declaration if followed by a name */
+            BOOL got_lf;
+            const uint8_t *p = js_parse_peek(s, &got_lf);
+            if (*p == '[' || *p == '{' || *p == '_' || *p == '$' ||
+                (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                *p >= 0x80) {
+                tok = TOK_LET;
+                goto lexical_decl;
+            }
+        }
+        if (js_parse_expr(s))
+            goto fail;
+        if (fd->eval_ret_idx >= 0) {
+            /* completion value of the script */
+            emit_op(s, OP_put_loc);
+            emit_u16(s, fd->eval_ret_idx);
+        } else {
+            emit_op(s, OP_drop);
+        }
+        if (js_parse_expect_semi(s))
+            goto fail;
+        break;
+    }
+ done:
+    JS_FreeAtom(ctx, label_name);
+    return 0;
+ fail:
+    JS_FreeAtom(ctx, label_name);
+    return -1;
+}
+
+/* variable resolution */
+
+/* variable 'name' of 'fd' visible from 'scope_level'. Return its
+   index, -1 if not found or -2 if exception. */
+static int find_var(JSContext *ctx, JSFunctionDef *fd, JSAtom name,
+                    int scope_level, BOOL *pis_arg)
+{
+    int scope, idx;
+
+    *pis_arg = FALSE;
+    for(scope = scope_level; scope >= 0; scope = fd->scopes[scope].parent) {
+        idx = find_var_in_scope(fd, name, scope);
+        if (idx >= 0)
+            return idx;
+    }
+    idx = find_arg(fd, name);
+    if (idx >= 0) {
+        *pis_arg = TRUE;
+        return idx;
+    }
+    /* 'this' of the arrow functions */
+    if (name == JS_ATOM_this && !fd->is_arrow) {
+        if (fd->this_var_idx < 0) {
+            fd->this_var_idx = add_var(ctx, fd, name);
+            if (fd->this_var_idx < 0)
+                return -2;
+        }
+        return fd->this_var_idx;
+    }
+    if (fd->is_func_expr && name == fd->func_name) {
+        if (fd->func_var_idx < 0) {
+            fd->func_var_idx = add_var(ctx, fd, name);
+            if (fd->func_var_idx < 0)
+                return -2;
+            fd->vars[fd->func_var_idx].is_func_var = TRUE;
+            fd->vars[fd->func_var_idx].is_const = TRUE;
+        }
+        return fd->func_var_idx;
+    }
+    return -1;
+}
+
+static int get_closure_var(JSContext *ctx, JSFunctionDef *fd, BOOL is_local,
+                           BOOL is_arg, int var_idx, JSAtom var_name,
+                           BOOL is_const, BOOL is_lexical)
+{
+    JSClosureVar *cv;
+    int i;
+
+    for(i = 0; i < fd->closure_var_count; i++) {
+        cv = &fd->closure_var[i];
+        if (cv->var_idx == var_idx && cv->is_arg == is_arg &&
+            cv->is_local == is_local)
+            return i;
+    }
+    if (fd->closure_var_count >= JS_MAX_LOCAL_VARS) {
+        JS_ThrowInternalError(ctx, "too many closure variables");
+        return -2;
+    }
+    if (js_resize_array(ctx, (void **)&fd->closure_var,
+                        sizeof(fd->closure_var[0]), &fd->closure_var_size,
+                        fd->closure_var_count + 1))
+        return -2;
+    cv = &fd->closure_var[fd->closure_var_count++];
+    cv->is_local = is_local;
+    cv->is_arg = is_arg;
+    cv->is_const = is_const;
+    cv->is_lexical = is_lexical;
+    cv->is_copied = FALSE; /* set by the compilation of the parent */
+    cv->var_idx = var_idx;
+    cv->var_name = JS_DupAtom(ctx, var_name);
+    return fd->closure_var_count - 1;
+}
+
+/* closure variable of 'fd' for 'name' in the enclosing functions.
+   Return -1 if not found (global variable) or -2 if exception. */
+static int find_closure_var(JSContext *ctx, JSFunctionDef *fd, JSAtom name)
+{
+    JSFunctionDef *pfd = fd->parent;
+    JSVarDef *vd;
+    JSClosureVar *cv;
+    BOOL is_arg;
+    int idx;
+
+    if (!pfd) {
+        /* the closure variables of a lazy function are known before
+           its compilation */
+        for(idx = 0; idx < fd->closure_var_count; idx++) {
+            if (fd->closure_var[idx].var_name == name)
+                return idx;
+        }
+        return -1;
+    }
+    idx = find_var(ctx, pfd, name, fd->parent_scope_level, &is_arg);
+    if (idx < -1)
+        return -2;
+    if (idx >= 0) {
+        if (is_arg) {
+            vd = &pfd->args[idx];
+        } else {
+            vd = &pfd->vars[idx];
+        }
+        vd->is_captured = TRUE;
+        return get_closure_var(ctx, fd, TRUE, is_arg, idx, name,
+                               vd->is_const, vd->is_lexical);
+    }
+    idx = find_closure_var(ctx, pfd, name);
+    if (idx < 0)
+        return idx;
+    cv = &pfd->closure_var[idx];
+    return get_closure_var(ctx, fd, FALSE, FALSE, idx, name,
+                           cv->is_const, cv->is_lexical);
+}
+
+/* the closure variable 'idx' of 'fd' is assigned: the variable of the
+   enclosing function is not copied in the closures. The assignments of
+   a lazy function are found when its parent is compiled, so there is
+   nothing to do once the parent is gone. */
+static void set_closure_var_modified(JSFunctionDef *fd, int idx)
+{
+    JSFunctionDef *pfd;
+    JSClosureVar *cv;
+
+    while ((pfd = fd->parent) != NULL) {
+        cv = &fd->closure_var[idx];
+        if (cv->is_local) {
+            if (cv->is_arg)
+                pfd->args[cv->var_idx].is_closure_modified = TRUE;
+            else
+                pfd->vars[cv->var_idx].is_closure_modified = TRUE;
+            break;
+        }
+        idx = cv->var_idx;
+        fd = pfd;
+    }
+}
+
+static void put_op_u16(DynBuf *bc, int op, int idx)
+{
+    dbuf_putc(bc, op);
+    dbuf_put_u16(bc, idx);
+}
+
+static void put_op_atom(JSContext *ctx, DynBuf *bc, int op, JSAtom name)
+{
+    dbuf_putc(bc, op);
+    dbuf_put_u32(bc, JS_DupAtom(ctx, name));
+}
+
+/* assignment to a const variable */
+static void put_throw_ro(JSContext *ctx, DynBuf *bc, JSAtom name)
+{
+    put_op_atom(ctx, bc, OP_throw_error, name);
+    dbuf_putc(bc, JS_THROW_VAR_RO);
+}
+
+static int resolve_scope_var(JSContext *ctx, JSFunctionDef *fd, int op,
+                             JSAtom name, int scope_level, DynBuf *bc)
+{
+    JSVarDef *vd;
+    JSClosureVar *cv;
+    BOOL is_arg;
+    int idx;
+
+    idx = find_var(ctx, fd, name, scope_level, &is_arg);
+    if (idx < -1)
+        return -1;
+    if (idx >= 0) {
+        vd = is_arg ? &fd->args[idx] : &fd->vars[idx];
+        switch(op) {
+        case OP_scope_get_var:
+        case OP_scope_get_var_undef:
+            if (is_arg)
+                put_op_u16(bc, OP_get_arg, idx);
+            else
+                put_op_u16(bc, vd->is_lexical ? OP_get_loc_check : OP_get_loc, idx);
+            break;
+        case OP_scope_put_var:
+            if (vd->is_const)
+                put_throw_ro(ctx, bc, name);
+            else if (is_arg)
+                put_op_u16(bc, OP_put_arg, idx);
+            else
+                put_op_u16(bc, vd->is_lexical ? OP_put_loc_check : OP_put_loc, idx);
+            break;
+        case OP_scope_put_var_init:
+            put_op_u16(bc, is_arg ? OP_put_arg : OP_put_loc, idx);
+            break;
+        case OP_scope_delete_var:
+            dbuf_putc(bc, OP_push_false);
+            break;
+        }
+        return 0;
+    }
+
+    idx = find_closure_var(ctx, fd, name);
+    if (idx < -1)
+        return -1;
+    if (idx >= 0) {
+        cv = &fd->closure_var[idx];
+        switch(op) {
+        case OP_scope_get_var:
+        case OP_scope_get_var_undef:
+            put_op_u16(bc, cv->is_lexical ? OP_get_var_ref_check : OP_get_var_ref, idx);
+            break;
+        case OP_scope_put_var:
+        case OP_scope_put_var_init:
+            if (cv->is_const) {
+                put_throw_ro(ctx, bc, name);
+            } else {
+                put_op_u16(bc, cv->is_lexical ? OP_put_var_ref_check : OP_put_var_ref, idx);
+                set_closure_var_modified(fd, idx);
+            }
+            break;
+        case OP_scope_delete_var:
+            dbuf_putc(bc, OP_push_false);
+            break;
+        }
+        return 0;
+    }
+
+    /* global variable */
+    switch(op) {
+    case OP_scope_get_var:
+        put_op_atom(ctx, bc, OP_get_var, name);
+        break;
+    case OP_scope_get_var_undef:
+        put_op_atom(ctx, bc, OP_get_var_undef, name);
+        break;
+    case OP_scope_put_var:
+    case OP_scope_put_var_init:
+        put_op_atom(ctx, bc, fd->is_strict ? OP_put_var_strict : OP_put_var, name);
+        break;
+    case OP_scope_delete_var:
+        put_op_atom(ctx, bc, OP_delete_var, name);
+        break;
+    }
+    return 0;
+}
+
+/* convert the scope operations of the raw code of 'fd' and add the
+   function prologue */
+static int resolve_variables(JSContext *ctx, JSFunctionDef *fd, DynBuf *bc_out)
+{
+    const uint8_t *bc = fd->byte_code.buf;
+    int bc_len = fd->byte_code.size;
+    int pos, op, fmt, idx, scope, i;
+    DynBuf body;
+    JSVarDef *vd;
+
+    js_dbuf_init(ctx, &body);
+    for(pos = 0; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc[pos];
+        switch(op) {
+        case OP_enter_scope:
+            scope = get_u16(bc + pos + 1);
+            for(idx = fd->scopes[scope].first; idx >= 0;
+                idx = fd->vars[idx].scope_next) {
+                vd = &fd->vars[idx];
+                if (vd->func_pool_idx >= 0) {
+                    dbuf_putc(&body, OP_fclosure);
+                    dbuf_put_u32(&body, vd->func_pool_idx);
+                    put_op_u16(&body, OP_put_loc, idx);
+                } else if (vd->is_lexical) {
+                    put_op_u16(&body, OP_set_loc_uninitialized, idx);
+                }
+            }
+            break;
+        case OP_leave_scope:
+            scope = get_u16(bc + pos + 1);
+            for(idx = fd->scopes[scope].first; idx >= 0;
+                idx = fd->vars[idx].scope_next) {
+                if (fd->vars[idx].is_captured)
+                    put_op_u16(&body, OP_close_loc, idx);
+            }
+            break;
+        case OP_scope_get_var:
+        case OP_scope_get_var_undef:
+        case OP_scope_put_var:
+        case OP_scope_put_var_init:
+        case OP_scope_delete_var:
+            if (resolve_scope_var(ctx, fd, op, get_u32(bc + pos + 1),
+                                  get_u16(bc + pos + 5), &body))
+                goto fail;
+            break;
+        default:
+            dbuf_put(&body, bc + pos, opcode_info[op].size);
+            fmt = opcode_info[op].fmt;
+            if (fmt == OP_FMT_atom || fmt == OP_FMT_atom_u8)
+                JS_DupAtom(ctx, get_u32(bc + pos + 1));
+            break;
+        }
+    }
+
+    /* the prologue. The variables created by the resolution ('this' and
+       the function name) are known now. */
+    if (fd->this_var_idx >= 0) {
+        dbuf_putc(bc_out, OP_push_this);
+        put_op_u16(bc_out, OP_put_loc, fd->this_var_idx);
+    }
+    if (fd->func_var_idx >= 0) {
+        dbuf_putc(bc_out, OP_special_object);
+        dbuf_putc(bc_out, OP_SPECIAL_OBJECT_THIS_FUNC);
+        put_op_u16(bc_out, OP_put_loc, fd->func_var_idx);
+    }
+    for(i = 0; i < fd->global_var_count; i++) {
+        JSGlobalVar *gv = &fd->global_vars[i];
+        if (gv->cpool_idx < 0)
+            put_op_atom(ctx, bc_out, OP_define_var, gv->var_name);
+    }
+    for(i = 0; i < fd->global_var_count; i++) {
+        JSGlobalVar *gv = &fd->global_vars[i];
+        if (gv->cpool_idx >= 0) {
+            dbuf_putc(bc_out, OP_fclosure);
+            dbuf_put_u32(bc_out, gv->cpool_idx);
+            put_op_atom(ctx, bc_out, OP_define_func, gv->var_name);
+        }
+    }
+    /* the hoisted function declarations */
+    for(idx = fd->scopes[0].first; idx >= 0; idx = fd->vars[idx].scope_next) {
+        vd = &fd->vars[idx];
+        if (vd->func_pool_idx >= 0) {
+            dbuf_putc(bc_out, OP_fclosure);
+            dbuf_put_u32(bc_out, vd->func_pool_idx);
+            put_op_u16(bc_out, OP_put_loc, idx);
+        }
+    }
+    dbuf_put(bc_out, body.buf, body.size);
+    if (dbuf_error(&body) || dbuf_error(bc_out)) {
+        JS_ThrowOutOfMemory(ctx);
+        goto fail;
+    }
+    dbuf_free(&body);
+    return 0;
+ fail:
+    js_free_raw_code_atoms(ctx->rt, body.buf, body.size);
+    dbuf_free(&body);
+    return -1;
+}
+
+/* create the closure variables of 'fd' and of its inner functions
+   without generating their code: the variables of the parents are
+   resolved as in resolve_variables() */
+static int resolve_closure_vars(JSContext *ctx, JSFunctionDef *fd)
+{
+    const uint8_t *bc = fd->byte_code.buf;
+    int bc_len = fd->byte_code.size;
+    struct list_head *el;
+    int pos, op, idx;
+    BOOL is_arg;
+
+    list_for_each(el, &fd->child_list) {
+        if (resolve_closure_vars(ctx, list_entry(el, JSFunctionDef, link)))
+            return -1;
+    }
+    for(pos = 0; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc[pos];
+        switch(op) {
+        case OP_scope_get_var:
+        case OP_scope_get_var_undef:
+        case OP_scope_put_var:
+        case OP_scope_put_var_init:
+        case OP_scope_delete_var:
+            idx = find_var(ctx, fd, get_u32(bc + pos + 1),
+                           get_u16(bc + pos + 5), &is_arg);
+            if (idx == -1) {
+                idx = find_closure_var(ctx, fd, get_u32(bc + pos + 1));
+                /* same assignments as in resolve_scope_var() */
+                if (idx >= 0 && (op == OP_scope_put_var ||
+                                 op == OP_scope_put_var_init) &&
+                    !fd->closure_var[idx].is_const)
+                    set_closure_var_modified(fd, idx);
+            }
+            if (idx < -1)
+                return -1;
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+/* create the function 'fd' without its code: it is compiled from its
+   source by js_compile_lazy_function(). 'fd' is freed. */
+static JSValue js_create_lazy_function(JSContext *ctx, JSFunctionDef *fd)
+{
+    JSFunctionBytecode *b;
+    JSLazyFunction *lf;
+    uint32_t source_len;
+
+    if (resolve_closure_vars(ctx, fd))
+        goto fail;
+    lf = js_mallocz(ctx, sizeof(*lf));
+    if (!lf)
+        goto fail;
+    source_len = fd->source_end - fd->source_ptr;
+    lf->source = js_malloc(ctx, source_len + 1);
+    if (!lf->source) {
+        js_free(ctx, lf);
+        goto fail;
+    }
+    memcpy(lf->source, fd->source_ptr, source_len);
+    lf->source[source_len] = '\0';
+    lf->source_len = source_len;
+    lf->line_num = fd->source_line_num;
+    lf->func_type = fd->func_type;
+    lf->is_func_expr = fd->is_func_expr;
+    lf->is_parent_strict = fd->parent->is_strict;
+
+    b = js_mallocz_gc(ctx, sizeof(*b) +
+                      fd->closure_var_count * sizeof(*fd->closure_var));
+    if (!b) {
+        js_free_lazy_function(ctx->rt, lf);
+        goto fail;
+    }
+    b->header.ref_count = 1;
+    b->header.account_id = ctx->mem_account->id;
+    b->lazy = lf;
+    b->is_strict = fd->is_strict;
+    b->is_arrow = fd->is_arrow;
+    b->has_prototype = fd->has_prototype;
+    b->is_generator = fd->is_generator;
+    b->defined_arg_count = fd->defined_arg_count;
+    b->func_name = fd->func_name;
+    fd->func_name = JS_ATOM_NULL;
+    b->debug.filename = fd->filename;
+    fd->filename = JS_ATOM_NULL;
+    b->debug.line_num = fd->line_num;
+    if (fd->closure_var_count > 0) {
+        b->closure_var = (void *)(b + 1);
+        memcpy(b->closure_var, fd->closure_var,
+               fd->closure_var_count * sizeof(*fd->closure_var));
+    }
+    b->closure_var_count = fd->closure_var_count;
+    fd->closure_var_count = 0;
+    add_gc_object(ctx->rt, &b->header, JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
+    js_free_function_def(ctx, fd);
+    return JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b);
+ fail:
+    js_free_function_def(ctx, fd);
+    return JS_EXCEPTION;
+}
+
+/* create the bytecode of 'fd' and of its inner functions. 'fd' is
+   freed. */
+static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
+{
+    JSFunctionBytecode *b;
+    struct list_head *el, *el1;
+    JSValue func_obj;
+    DynBuf bc_out;
+    int function_size, cpool_offset, vardefs_offset, closure_var_offset;
+
+    /* the inner functions first: they create the closure variables of
+       their parents */
+    list_for_each_safe(el, el1, &fd->child_list) {
+        JSFunctionDef *fd1 = list_entry(el, JSFunctionDef, link);
+        int cpool_idx = fd1->parent_cpool_idx;
+        if (fd1->is_lazy)
+            func_obj = js_create_lazy_function(ctx, fd1);
+        else
+            func_obj = js_create_function(ctx, fd1);
+        if (JS_IsException(func_obj))
+            goto fail;
+        fd->cpool[cpool_idx] = func_obj;
+    }
+
+    js_dbuf_init(ctx, &bc_out);
+    if (resolve_variables(ctx, fd, &bc_out)) {
+        dbuf_free(&bc_out);
+        goto fail;
+    }
+
+    function_size = sizeof(*b);
+    cpool_offset = function_size;
+    function_size += fd->cpool_count * sizeof(*fd->cpool);
+    vardefs_offset = function_size;
+    function_size += (fd->arg_count + fd->var_count) * sizeof(*b->vardefs);
+    closure_var_offset = function_size;
+    function_size += fd->closure_var_count * sizeof(*fd->closure_var);
+    b = js_mallocz_gc(ctx, function_size);
+    if (!b) {
+        js_free_raw_code_atoms(ctx->rt, bc_out.buf, bc_out.size);
+        dbuf_free(&bc_out);
+        goto fail;
+    }
+    b->header.ref_count = 1;
+    b->header.account_id = ctx->mem_account->id;
+    b->is_strict = fd->is_strict;
+    b->is_arrow = fd->is_arrow;
+    b->has_prototype = fd->has_prototype;
+    b->is_generator = fd->is_generator;
+    b->func_name = fd->func_name;
+    fd->func_name = JS_ATOM_NULL;
+    b->debug.filename = fd->filename;
+    fd->filename = JS_ATOM_NULL;
+    b->debug.line_num = fd->line_num;
+
+    /* the values and the atoms are moved to 'b' */
+    if (fd->cpool_count > 0) {
+        b->cpool = (void *)((uint8_t *)b + cpool_offset);
+        memcpy(b->cpool, fd->cpool, fd->cpool_count * sizeof(*fd->cpool));
+    }
+    b->cpool_count = fd->cpool_count;
+    fd->cpool_count = 0;
+    if (fd->arg_count + fd->var_count > 0) {
+        b->vardefs = (void *)((uint8_t *)b + vardefs_offset);
+        if (fd->arg_count > 0)
+            memcpy(b->vardefs, fd->args, fd->arg_count * sizeof(*fd->args));
+        if (fd->var_count > 0)
+            memcpy(b->vardefs + fd->arg_count, fd->vars,
+                   fd->var_count * sizeof(*fd->vars));
+    }
+    b->arg_count = fd->arg_count;
+    b->var_count = fd->var_count;
+    b->defined_arg_count = fd->defined_arg_count;
+    fd->arg_count = 0;
+    fd->var_count = 0;
+    if (fd->closure_var_count > 0) {
+        b->closure_var = (void *)((uint8_t *)b + closure_var_offset);
+        memcpy(b->closure_var, fd->closure_var,
+               fd->closure_var_count * sizeof(*fd->closure_var));
+    }
+    b->closure_var_count = fd->closure_var_count;
+    fd->closure_var_count = 0;
+
+    add_gc_object(ctx->rt, &b->header, JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
+    func_obj = JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b);
+    if (js_bytecode_finalize(ctx, b, bc_out.buf, bc_out.size,
+                             fd->label_count)) {
+        js_free_raw_code_atoms(ctx->rt, bc_out.buf, bc_out.size);
+        dbuf_free(&bc_out);
+        JS_FreeValue(ctx, func_obj);
+        goto fail;
+    }
+    js_free_raw_code_atoms(ctx->rt, bc_out.buf, bc_out.size);
+    dbuf_free(&bc_out);
+    js_free_function_def(ctx, fd);
+    return func_obj;
+ fail:
+    js_free_function_def(ctx, fd);
+    return JS_EXCEPTION;
+}
+
+JSValue js_compile_script(JSContext *ctx, const char *input, size_t input_len,
+                          const char *filename, int eval_flags)
+{
+    JSParseState s1, *s = &s1;
+    JSFunctionDef *fd;
+    JSAtom filename_atom;
+
+    js_parse_init(ctx, s, input, input_len, filename);
+    filename_atom = JS_NewAtom(ctx, filename);
+    if (filename_atom == JS_ATOM_NULL)
+        return JS_EXCEPTION;
+    fd = js_new_function_def(ctx, NULL, FALSE, filename_atom, 1);
+    if (!fd) {
+        JS_FreeAtom(ctx, filename_atom);
+        return JS_EXCEPTION;
+    }
+    s->cur_func = fd;
+    fd->is_global_var = TRUE;
+    fd->is_strict = (eval_flags & JS_EVAL_FLAG_STRICT) != 0;
+    fd->is_eager = (eval_flags & JS_EVAL_FLAG_EAGER) != 0;
+    s->is_strict = fd->is_strict;
+    fd->eval_ret_idx = add_var(ctx, fd, JS_ATOM__ret_);
+    if (fd->eval_ret_idx < 0)
+        goto fail;
+
+    if (next_token(s))
+        goto fail;
+    js_parse_directives(s);
+    if (push_scope(s) < 0)
+        goto fail;
+    fd->body_scope = fd->scope_level;
+    while (s->token.val != TOK_EOF) {
+        if (js_parse_statement_or_decl(s, TRUE))
+            goto fail;
+    }
+    emit_op(s, OP_get_loc);
+    emit_u16(s, fd->eval_ret_idx);
+    emit_op(s, OP_return);
+    if (dbuf_error(&fd->byte_code)) {
+        JS_ThrowOutOfMemory(ctx);
+        goto fail;
+    }
+    return js_create_function(ctx, fd);
+ fail:
+    js_parse_free(s);
+    js_free_function_def(ctx, fd);
+    return JS_EXCEPTION;
+}
+
+JSFunctionBytecode *js_compile_lazy_function(JSContext *ctx,
+                                             JSFunctionBytecode *b)
+{
+    JSLazyFunction *lf = b->lazy;
+    JSParseState s1, *s = &s1;
+    JSFunctionDef *fd;
+    JSFunctionBytecode *b1;
+    JSValue func_obj;
+    JSClosureVar *cv;
+    char filename[64];
+    int i;
+
+    JS_AtomGetStr(ctx, filename, sizeof(filename), b->debug.filename);
+    js_parse_init(ctx, s, (const char *)lf->source, lf->source_len, filename);
+    s->line_num = lf->line_num;
+    fd = js_new_function_def(ctx, NULL, lf->is_func_expr,
+                             JS_DupAtom(ctx, b->debug.filename),
+                             b->debug.line_num);
+    if (!fd)
+        return NULL;
+    fd->func_name = JS_DupAtom(ctx, b->func_name);
+    fd->is_strict = lf->is_parent_strict;
+    fd->is_arrow = b->is_arrow;
+    fd->has_prototype = b->has_prototype;
+    fd->is_generator = b->is_generator;
+    /* the closure variables are found by name (see find_closure_var) */
+    if (js_resize_array(ctx, (void **)&fd->closure_var,
+                        sizeof(fd->closure_var[0]), &fd->closure_var_size,
+                        b->closure_var_count))
+        goto fail;
+    for(i = 0; i < b->closure_var_count; i++) {
+        cv = &fd->closure_var[i];
+        *cv = b->closure_var[i];
+        cv->var_name = JS_DupAtom(ctx, cv->var_name);
+    }
+    fd->closure_var_count = b->closure_var_count;
+    s->cur_func = fd;
+    s->is_strict = fd->is_strict;
+    s->is_generator = fd->is_generator;
+    if (next_token(s) || js_parse_function_body(s, fd, lf->func_type))
+        goto fail;
+    if (s->token.val != TOK_EOF) {
+        js_parse_error(s, "unexpected data after the function");
+        goto fail;
+    }
+    if (fd->closure_var_count != b->closure_var_count) {
+        JS_ThrowInternalError(ctx, "invalid lazy function");
+        goto fail;
+    }
+    func_obj = js_create_function(ctx, fd);
+    if (JS_IsException(func_obj))
+        return NULL;
+    b1 = JS_VALUE_GET_PTR(func_obj);
+    lf->compiled = b1;
+    js_free(ctx, lf->source);
+    lf->source = NULL;
+    return b1;
+ fail:
+    js_parse_free(s);
+    js_free_function_def(ctx, fd);
+    return NULL;
+}
+
+JSValue JS_Eval(JSContext *ctx, const char *input, size_t input_len,
+                const char *filename, int eval_flags)
+{
+    JSRuntime *rt = ctx->rt;
+    JSMemAccount *saved_account;
+    JSValue fun_obj;
+
+    /* the compiler buffers are charged to the context */
+    saved_account = rt->malloc_account;
+    rt->malloc_account = ctx->mem_account;
+    fun_obj = js_compile_script(ctx, input, input_len, filename, eval_flags);
+    rt->malloc_account = saved_account;
+    if (JS_IsException(fun_obj) || (eval_flags & JS_EVAL_FLAG_COMPILE_ONLY))
+        return fun_obj;
+    return JS_EvalFunction(ctx, fun_obj);
+}
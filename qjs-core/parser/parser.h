@@ -0,0 +1,15 @@
+#ifndef QJS_PARSER_H
+#define QJS_PARSER_H
+#include "lexer.h"
+
+/* Compile a script to a JS_TAG_FUNCTION_BYTECODE value. 'input' must be
+   null terminated. Return JS_EXCEPTION if error (SyntaxError with the
+   fileName and lineNumber properties). */
+JSValue js_compile_script(JSContext *ctx, const char *input, size_t input_len,
+                          const char *filename, int eval_flags);
+/* Compile the lazy function 'b' from its source (see JSLazyFunction).
+   The result is kept in b->lazy->compiled. Return NULL if exception. */
+JSFunctionBytecode *js_compile_lazy_function(JSContext *ctx,
+                                             JSFunctionBytecode *b);
+
+#endif //QJS_PARSER_H
@@ -0,0 +1,212 @@
+#include <math.h>
+#include "context.h"
+#include "dtoa.h"
+
+/* Type conversions (ECMAScript 7.1). There are no primitive wrapper
+   objects and no symbols yet: the objects are converted with their
+   'valueOf' and 'toString' methods only. */
+
+JSValue JS_ToPrimitive(JSContext *ctx, JSValueConst val, int hint)
+{
+    JSAtom method_names[2];
+    JSValue method, ret;
+    int i;
+
+    if (!JS_IsObject(val))
+        return JS_DupValue(ctx, val);
+    if (hint == HINT_STRING) {
+        method_names[0] = JS_ATOM_toString;
+        method_names[1] = JS_ATOM_valueOf;
+    } else {
+        method_names[0] = JS_ATOM_valueOf;
+        method_names[1] = JS_ATOM_toString;
+    }
+    for(i = 0; i < 2; i++) {
+        method = JS_GetProperty(ctx, val, method_names[i]);
+        if (JS_IsException(method))
+            return JS_EXCEPTION;
+        if (JS_IsFunction(ctx, method)) {
+            ret = JS_Call(ctx, method, val, 0, NULL);
+            JS_FreeValue(ctx, method);
+            if (JS_IsException(ret) || !JS_IsObject(ret))
+                return ret;
+            JS_FreeValue(ctx, ret);
+        } else {
+            JS_FreeValue(ctx, method);
+        }
+    }
+    return JS_ThrowTypeError(ctx, "cannot convert object to primitive value");
+}
+
+int JS_ToBool(JSContext *ctx, JSValueConst val)
+{
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_INT:
+    case JS_TAG_BOOL:
+        return JS_VALUE_GET_INT(val) != 0;
+    case JS_TAG_NULL:
+    case JS_TAG_UNDEFINED:
+    case JS_TAG_EXCEPTION:
+        return FALSE;
+    case JS_TAG_STRING:
+        return JS_VALUE_GET_STRING(val)->len != 0;
+    case JS_TAG_FLOAT64:
+        {
+            double d = JS_VALUE_GET_FLOAT64(val);
+            return !isnan(d) && d != 0;
+        }
+    default:
+        return TRUE;
+    }
+}
+
+static BOOL is_js_space(int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+        c == '\v' || c == '\f';
+}
+
+/* StringToNumber: NaN unless the whole string (without the leading
+   and trailing white space) is a number literal */
+static double js_string_to_number(const char *str, size_t len)
+{
+    const char *p, *end, *p1;
+    double d;
+    int radix, c, digit;
+
+    end = str + len;
+    while (end > str && is_js_space(end[-1]))
+        end--;
+    p = str;
+    while (p < end && is_js_space(*p))
+        p++;
+    if (p == end)
+        return 0;
+    if (end - p > 2 && p[0] == '0') {
+        switch(p[1]) {
+        case 'x': case 'X':
+            radix = 16;
+            goto parse_radix;
+        case 'o': case 'O':
+            radix = 8;
+            goto parse_radix;
+        case 'b': case 'B':
+            radix = 2;
+        parse_radix:
+            d = 0;
+            for(p += 2; p < end; p++) {
+                c = *p;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else if (c >= 'a' && c <= 'z')
+                    digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'Z')
+                    digit = c - 'A' + 10;
+                else
+                    return NAN;
+                if (digit >= radix)
+                    return NAN;
+                d = d * radix + digit;
+            }
+            return d;
+        default:
+            break;
+        }
+    }
+    /* js_strtod() stops at the first character not in the number */
+    d = js_strtod(p, &p1);
+    if (p1 != end)
+        return NAN;
+    return d;
+}
+
+JSValue JS_ToNumber(JSContext *ctx, JSValueConst val)
+{
+    const char *str;
+    JSValue prim, ret;
+    size_t len;
+    double d;
+
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_INT:
+    case JS_TAG_FLOAT64:
+        return val;
+    case JS_TAG_BOOL:
+    case JS_TAG_NULL:
+        return JS_NewInt32(ctx, JS_VALUE_GET_INT(val));
+    case JS_TAG_UNDEFINED:
+        return JS_NAN;
+    case JS_TAG_EXCEPTION:
+        return JS_EXCEPTION;
+    case JS_TAG_STRING:
+        str = JS_ToCStringLen(ctx, &len, val);
+        if (!str)
+            return JS_EXCEPTION;
+        d = js_string_to_number(str, len);
+        JS_FreeCString(ctx, str);
+        return JS_NewNumber(ctx, d);
+    case JS_TAG_OBJECT:
+        prim = JS_ToPrimitive(ctx, val, HINT_NUMBER);
+        if (JS_IsException(prim))
+            return prim;
+        ret = JS_ToNumber(ctx, prim);
+        JS_FreeValue(ctx, prim);
+        return ret;
+    default:
+        return JS_NAN;
+    }
+}
+
+int JS_ToFloat64(JSContext *ctx, double *pres, JSValueConst val)
+{
+    JSValue v;
+
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_INT:
+        *pres = JS_VALUE_GET_INT(val);
+        return 0;
+    case JS_TAG_FLOAT64:
+        *pres = JS_VALUE_GET_FLOAT64(val);
+        return 0;
+    default:
+        v = JS_ToNumber(ctx, val);
+        if (JS_IsException(v)) {
+            *pres = NAN;
+            return -1;
+        }
+        if (JS_VALUE_GET_TAG(v) == JS_TAG_INT)
+            *pres = JS_VALUE_GET_INT(v);
+        else
+            *pres = JS_VALUE_GET_FLOAT64(v);
+        return 0;
+    }
+}
+
+/* ToInt32: modulo 2^32 */
+int32_t js_double_to_int32(double d)
+{
+    if (d >= INT32_MIN && d <= INT32_MAX)
+        return (int32_t)d;
+    if (!isfinite(d))
+        return 0;
+    d = fmod(trunc(d), 4294967296.0);
+    if (d < 0)
+        d += 4294967296.0;
+    return (int32_t)(uint32_t)d;
+}
+
+int JS_ToInt32(JSContext *ctx, int32_t *pres, JSValueConst val)
+{
+    double d;
+
+    if (likely(JS_VALUE_GET_TAG(val) == JS_TAG_INT)) {
+        *pres = JS_VALUE_GET_INT(val);
+        return 0;
+    }
+    if (JS_ToFloat64(ctx, &d, val)) {
+        *pres = 0;
+        return -1;
+    }
+    *pres = js_double_to_int32(d);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <time.h>
+#include "context.h"
+
+/* The poll points only decrement rt->interrupt_counter. The sources of
+   interrupt (watchdog flag, CPU time limit, user handler) are checked
+   once per JS_INTERRUPT_COUNTER_INIT polls, so the fast path does no
+   system call and no atomic operation. */
+
+static inline int64_t js_thread_cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int __js_poll_interrupts(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+
+    rt->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+    if (__atomic_load_n(&rt->interrupt_requested, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&rt->interrupt_requested, 0, __ATOMIC_ACQUIRE))
+        goto interrupted;
+    /* stays set once reached: the script cannot catch and continue */
+    if (rt->cpu_deadline_ns != 0 &&
+        js_thread_cpu_time_ns() >= rt->cpu_deadline_ns)
+        goto interrupted;
+    if (rt->interrupt_handler &&
+        rt->interrupt_handler(rt, rt->interrupt_opaque))
+        goto interrupted;
+    return 0;
+ interrupted:
+    JS_ThrowInternalError(ctx, "interrupted");
+    /* the try/catch of the script cannot stop it */
+    if (JS_IsObject(rt->current_exception))
+        JS_VALUE_GET_OBJ(rt->current_exception)->is_uncatchable_error = TRUE;
+    return -1;
+}
+
+int JS_IsUncatchableError(JSContext *ctx, JSValueConst val)
+{
+    return JS_IsObject(val) && JS_VALUE_GET_OBJ(val)->is_uncatchable_error;
+}
+
+void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb,
+                            void *opaque)
+{
+    rt->interrupt_handler = cb;
+    rt->interrupt_opaque = opaque;
+}
+
+void JS_RequestInterrupt(JSRuntime *rt)
+{
+    __atomic_store_n(&rt->interrupt_requested, 1, __ATOMIC_RELEASE);
+}
+
+void JS_SetCPUTimeLimit(JSRuntime *rt, int64_t limit_us)
+{
+    /* a new budget: drop the interrupt requested for the previous one */
+    __atomic_store_n(&rt->interrupt_requested, 0, __ATOMIC_RELAXED);
+    if (limit_us <= 0)
+        rt->cpu_deadline_ns = 0;
+    else
+        rt->cpu_deadline_ns = js_thread_cpu_time_ns() + limit_us * 1000;
+}
@@ -0,0 +1,144 @@
+#include <time.h>
+#include "context.h"
+
+#define JS_JOB_RING_INITIAL_SIZE 64
+/* the clock is read once per batch of jobs */
+#define JS_JOB_CLOCK_INTERVAL 64
+
+static inline uint32_t job_count(JSRuntime *rt)
+{
+    return rt->job_tail - rt->job_head;
+}
+
+static int js_job_ring_resize(JSRuntime *rt)
+{
+    JSJobEntry *new_ring;
+    uint32_t new_size, count, i, mask;
+
+    new_size = max_int(JS_JOB_RING_INITIAL_SIZE, rt->job_ring_size * 2);
+    new_ring = js_malloc_rt(rt, sizeof(new_ring[0]) * new_size);
+    if (!new_ring)
+        return -1;
+    /* unwrap the pending jobs at the start of the new ring */
+    count = job_count(rt);
+    mask = rt->job_ring_size - 1;
+    for(i = 0; i < count; i++)
+        new_ring[i] = rt->job_ring[(rt->job_head + i) & mask];
+    js_free_rt(rt, rt->job_ring);
+    rt->job_ring = new_ring;
+    rt->job_ring_size = new_size;
+    rt->job_head = 0;
+    rt->job_tail = count;
+    return 0;
+}
+
+int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func, int argc,
+                  JSValueConst *argv)
+{
+    JSRuntime *rt = ctx->rt;
+    JSJobEntry *e;
+    int i;
+
+    assert(argc <= JS_JOB_MAX_ARGS);
+    if (unlikely(job_count(rt) == rt->job_ring_size)) {
+        if (js_job_ring_resize(rt)) {
+            JS_ThrowOutOfMemory(ctx);
+            return -1;
+        }
+    }
+    e = &rt->job_ring[rt->job_tail++ & (rt->job_ring_size - 1)];
+    e->realm = JS_DupContext(ctx);
+    e->job_func = job_func;
+    e->argc = argc;
+    for(i = 0; i < argc; i++)
+        e->argv[i] = JS_DupValue(ctx, argv[i]);
+    return 0;
+}
+
+int JS_IsJobPending(JSRuntime *rt)
+{
+    return rt->job_head != rt->job_tail;
+}
+
+/* run the job at the head of the ring. The entry is copied first
+   because the job may queue other jobs and resize the ring. */
+static int js_run_job(JSRuntime *rt, JSContext **pctx)
+{
+    JSJobEntry e;
+    JSMemAccount *saved_account;
+    JSValue res;
+    int i;
+
+    e = rt->job_ring[rt->job_head++ & (rt->job_ring_size - 1)];
+    saved_account = rt->malloc_account;
+    rt->malloc_account = e.realm->mem_account;
+    res = e.job_func(e.realm, e.argc, (JSValueConst *)e.argv);
+    rt->malloc_account = saved_account;
+    for(i = 0; i < e.argc; i++)
+        JS_FreeValue(e.realm, e.argv[i]);
+    if (JS_IsException(res)) {
+        /* the caller reads the exception then frees the realm */
+        *pctx = e.realm;
+        return -1;
+    }
+    JS_FreeValue(e.realm, res);
+    JS_FreeContext(e.realm);
+    *pctx = NULL;
+    return 1;
+}
+
+int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
+{
+    if (!JS_IsJobPending(rt)) {
+        *pctx = NULL;
+        return 0;
+    }
+    return js_run_job(rt, pctx);
+}
+
+static inline int64_t js_job_clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, int64_t budget_us,
+                          JSContext **pctx)
+{
+    int64_t deadline = 0;
+    int n, ret;
+
+    *pctx = NULL;
+    if (budget_us > 0)
+        deadline = js_job_clock_us() + budget_us;
+    for(n = 0; JS_IsJobPending(rt); ) {
+        if (max_jobs > 0 && n >= max_jobs)
+            break;
+        if (deadline != 0 && n != 0 && (n % JS_JOB_CLOCK_INTERVAL) == 0 &&
+            js_job_clock_us() >= deadline)
+            break;
+        ret = js_run_job(rt, pctx);
+        if (ret < 0)
+            return ret;
+        n++;
+    }
+    return n;
+}
+
+/* called by JS_FreeRuntime() */
+void js_free_jobs(JSRuntime *rt)
+{
+    JSJobEntry *e;
+    int i;
+
+    while (JS_IsJobPending(rt)) {
+        e = &rt->job_ring[rt->job_head++ & (rt->job_ring_size - 1)];
+        for(i = 0; i < e->argc; i++)
+            JS_FreeValueRT(rt, e->argv[i]);
+        JS_FreeContext(e->realm);
+    }
+    js_free_rt(rt, rt->job_ring);
+    rt->job_ring = NULL;
+    rt->job_ring_size = 0;
+}
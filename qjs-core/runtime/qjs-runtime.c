@@ -2,43 +2,183 @@
 // Created by benpeng.jiang on 2021/5/21.
 //
 
-#include "qjs-runtime.h"
-#include "jmemory.h"
-#include "list.h"
 #include <stdio.h>
+#include "context.h"
+#include "bytecode.h"
 
-struct JSRuntime {
-    JSMallocFunctions mf;
-    JSMallocState malloc_state;
 
-    struct list_head context_list; /* list of JSContext.link */
+static size_t js_malloc_usable_size_unknown(const void *ptr)
+{
+    return 0;
+}
 
-};
+/* size charged for a block, as counted by the default allocator */
+static inline size_t js_block_size(JSRuntime *rt, JSMallocHeader *h)
+{
+    return rt->mf.js_malloc_usable_size(h) + MALLOC_OVERHEAD;
+}
 
+static void js_account_release(JSRuntime *rt, JSMemAccount *account,
+                               size_t size)
+{
+    account->malloc_count--;
+    account->malloc_size -= size;
+    /* last block of a freed context */
+    if (account->malloc_count == 0 && !account->ctx)
+        js_free_account(rt, account);
+}
 
-static size_t js_malloc_usable_size_unknown(const void *ptr)
+/* new account with no limit, charged to the runtime. Return NULL if
+   there is no memory or no free id. */
+JSMemAccount *js_new_account(JSRuntime *rt)
 {
-    return 0;
+    JSMemAccount *account, **new_array;
+    int id, new_size;
+
+    for(id = rt->account_free_index; id < rt->account_size; id++) {
+        if (!rt->account_array[id])
+            break;
+    }
+    if (id >= rt->account_size) {
+        if (rt->account_size > JS_ACCOUNT_ID_MAX)
+            return NULL;
+        new_size = min_int(rt->account_size * 3 / 2,
+                           JS_ACCOUNT_ID_MAX + 1);
+        new_array = js_realloc_account(rt, NULL, rt->account_array,
+                                       sizeof(new_array[0]) * new_size);
+        if (!new_array)
+            return NULL;
+        memset(new_array + rt->account_size, 0,
+               sizeof(new_array[0]) * (new_size - rt->account_size));
+        rt->account_array = new_array;
+        rt->account_size = new_size;
+    }
+    account = js_malloc_account(rt, NULL, sizeof(*account));
+    if (!account)
+        return NULL;
+    memset(account, 0, sizeof(*account));
+    account->malloc_limit = -1;
+    account->gc_threshold = -1;
+    account->id = id;
+    rt->account_array[id] = account;
+    rt->account_free_index = id + 1;
+    return account;
+}
+
+void js_free_account(JSRuntime *rt, JSMemAccount *account)
+{
+    rt->account_array[account->id] = NULL;
+    if (account->id < rt->account_free_index)
+        rt->account_free_index = account->id;
+    js_free_rt(rt, account);
+}
+
+/* the block has no header: the caller keeps account->id and gives it
+   back to js_free_gc_rt() */
+void *js_malloc_gc_rt(JSRuntime *rt, JSMemAccount *account, size_t size)
+{
+    void *ptr;
+
+    if (unlikely(account->malloc_size + size > account->malloc_limit))
+        return NULL;
+    ptr = rt->mf.js_malloc(&rt->malloc_state, size);
+    if (unlikely(!ptr))
+        return NULL;
+    account->malloc_count++;
+    account->malloc_size += js_block_size(rt, ptr);
+    return ptr;
+}
+
+void js_free_gc_rt(JSRuntime *rt, void *ptr, int account_id)
+{
+    js_account_release(rt, rt->account_array[account_id],
+                       js_block_size(rt, ptr));
+    rt->mf.js_free(&rt->malloc_state, ptr);
+}
+
+/* allocate a block charged to 'account' (the runtime if NULL). Return
+   NULL if the account limit would be exceeded. */
+void *js_malloc_account(JSRuntime *rt, JSMemAccount *account, size_t size)
+{
+    JSMallocHeader *h;
+
+    if (account && unlikely(account->malloc_size + size > account->malloc_limit))
+        return NULL;
+    h = rt->mf.js_malloc(&rt->malloc_state, size + JS_MALLOC_HEADER_SIZE);
+    if (unlikely(!h))
+        return NULL;
+    h->account = account;
+    if (account) {
+        account->malloc_count++;
+        account->malloc_size += js_block_size(rt, h);
+    }
+    return h + 1;
 }
 
+/* a block keeps its account when resized. 'account' is used when 'ptr'
+   is NULL. */
+void *js_realloc_account(JSRuntime *rt, JSMemAccount *account,
+                         void *ptr, size_t size)
+{
+    JSMallocHeader *h;
+    size_t old_size;
+
+    if (!ptr) {
+        if (size == 0)
+            return NULL;
+        return js_malloc_account(rt, account, size);
+    }
+    if (size == 0) {
+        js_free_rt(rt, ptr);
+        return NULL;
+    }
+    h = (JSMallocHeader *)ptr - 1;
+    account = h->account;
+    old_size = 0;
+    if (account) {
+        old_size = js_block_size(rt, h);
+        /* malloc_size includes old_size */
+        if (unlikely(account->malloc_size - old_size + size +
+                     JS_MALLOC_HEADER_SIZE > account->malloc_limit))
+            return NULL;
+    }
+    h = rt->mf.js_realloc(&rt->malloc_state, h, size + JS_MALLOC_HEADER_SIZE);
+    if (unlikely(!h))
+        return NULL;
+    if (account)
+        account->malloc_size += js_block_size(rt, h) - old_size;
+    return h + 1;
+}
+
+/* the rt level allocations are charged to the context running */
 void *js_malloc_rt(JSRuntime *rt, size_t size)
 {
-    return rt->mf.js_malloc(&rt->malloc_state, size);
+    return js_malloc_account(rt, rt->malloc_account, size);
 }
 
 void js_free_rt(JSRuntime *rt, void *ptr)
 {
-    rt->mf.js_free(&rt->malloc_state, ptr);
+    JSMallocHeader *h;
+
+    if (!ptr)
+        return;
+    h = (JSMallocHeader *)ptr - 1;
+    if (h->account)
+        js_account_release(rt, h->account, js_block_size(rt, h));
+    rt->mf.js_free(&rt->malloc_state, h);
 }
 
 void *js_realloc_rt(JSRuntime *rt, void *ptr, size_t size)
 {
-    return rt->mf.js_realloc(&rt->malloc_state, ptr, size);
+    return js_realloc_account(rt, rt->malloc_account, ptr, size);
 }
 
 size_t js_malloc_usable_size_rt(JSRuntime *rt, const void *ptr)
 {
-    return rt->mf.js_malloc_usable_size(ptr);
+    size_t size;
+
+    size = rt->mf.js_malloc_usable_size((const JSMallocHeader *)ptr - 1);
+    return size ? size - JS_MALLOC_HEADER_SIZE : 0;
 }
 
 void *js_mallocz_rt(JSRuntime *rt, size_t size)
@@ -56,6 +196,7 @@ void *js_mallocz_rt(JSRuntime *rt, size_t size)
 JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
     JSRuntime * rt;
     JSMallocState ms;
+    int i;
 
     memset(&ms, 0, sizeof(ms));
     ms.opaque = opaque;
@@ -73,8 +214,33 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
     rt->malloc_state = ms;
 
     init_list_head(&rt->context_list);
+    init_list_head(&rt->gc_obj_list);
+    init_list_head(&rt->gc_zero_ref_count_list);
+    rt->gc_phase = JS_GC_PHASE_NONE;
+    rt->malloc_gc_threshold = 256 * 1024;
+    rt->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+    rt->stack_size = JS_DEFAULT_STACK_SIZE;
+    JS_UpdateStackTop(rt);
+    rt->jit_enabled = TRUE;
+    for(i = 0; i < JS_FRAME_POOL_CLASSES; i++)
+        init_list_head(&rt->frame_pool[i]);
 
+    rt->account_size = 16;
+    rt->account_array = js_mallocz_rt(rt, sizeof(rt->account_array[0]) *
+                                      rt->account_size);
+    if (!rt->account_array)
+        goto fail;
+    rt->account_free_index = 1;
+
+    if (JS_InitAtoms(rt))
+        goto fail;
+    if (init_shape_hash(rt))
+        goto fail;
+    rt->current_exception = JS_NULL;
     return rt;
+ fail:
+    JS_FreeRuntime(rt);
+    return NULL;
 }
 
 JSRuntime *JS_NewRuntime(void)
@@ -82,19 +248,196 @@ JSRuntime *JS_NewRuntime(void)
     return JS_NewRuntime2(&def_malloc_funcs, NULL);
 }
 
+void JS_FreeRuntime(JSRuntime *rt)
+{
+    js_free_jobs(rt);
+    JS_FreeValueRT(rt, rt->current_exception);
+    rt->current_exception = JS_NULL;
+
+    JS_RunGC(rt);
+    /* leaking objects */
+    assert(list_empty(&rt->gc_obj_list));
+    js_free_frame_pools(rt);
+
+    if (rt->shape_hash)
+        free_shape_hash(rt);
+    JS_FreeAtoms(rt);
+    /* the atoms may hold the last blocks of the freed contexts */
+    js_free_rt(rt, rt->account_array);
+
+    {
+        JSMallocState ms = rt->malloc_state;
+        rt->mf.js_free(&ms, rt);
+    }
+}
+
+static void update_stack_limit(JSRuntime *rt)
+{
+    if (rt->stack_size == 0) {
+        rt->stack_limit = 0; /* no limit */
+    } else {
+        rt->stack_limit = rt->stack_top - rt->stack_size;
+    }
+}
+
+void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size)
+{
+    rt->stack_size = stack_size;
+    update_stack_limit(rt);
+}
+
+void JS_UpdateStackTop(JSRuntime *rt)
+{
+    rt->stack_top = js_get_stack_pointer();
+    update_stack_limit(rt);
+}
+
+void *JS_GetRuntimeOpaque(JSRuntime *rt)
+{
+    return rt->user_opaque;
+}
+
+void JS_SetRuntimeOpaque(JSRuntime *rt, void *opaque)
+{
+    rt->user_opaque = opaque;
+}
+
 
 
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s) {
-    struct list_head *el, *el1;
+    struct list_head *el;
     int i;
     JSMemoryUsage_helper mem = {0}, *hp = &mem;
+    double shape_size = 0;
 
     memset(s, 0, sizeof(*s));
     s->malloc_count = rt->malloc_state.malloc_count;
     s->malloc_size = rt->malloc_state.malloc_size;
     s->malloc_limit = rt->malloc_state.malloc_limit;
 
-    s->memory_used_count = 2; /* rt + rt->class_array */
+    s->memory_used_count = 3; /* rt + rt->atom_array + rt->account_array */
+    s->memory_used_size = sizeof(JSRuntime) +
+        sizeof(rt->account_array[0]) * rt->account_size;
+    s->atom_count = rt->atom_count;
+    s->atom_size = sizeof(rt->atom_array[0]) * rt->atom_size +
+        sizeof(rt->atom_hash[0]) * rt->atom_hash_size;
+    s->memory_used_count += 1; /* atom_hash */
+    for(i = 0; i < rt->atom_size; i++) {
+        JSAtomStruct *p = rt->atom_array[i];
+        if (!((uintptr_t)p & 1)) {
+            s->atom_size += sizeof(JSString) +
+                ((p->len << p->is_wide_char) + 1 - p->is_wide_char);
+            s->memory_used_count++;
+        }
+    }
+
+    if (rt->job_ring) {
+        s->memory_used_count++;
+        s->memory_used_size += sizeof(rt->job_ring[0]) * rt->job_ring_size;
+    }
+    for(i = 0; i < JS_FRAME_POOL_CLASSES; i++)
+        s->memory_used_count += rt->frame_pool_count[i];
+    s->memory_used_size += rt->frame_pool_size;
+
+    list_for_each(el, &rt->context_list) {
+        JSContext *ctx = list_entry(el, JSContext, link);
+        s->memory_used_count += 1;
+        s->memory_used_size += sizeof(*ctx);
+    }
+
+    list_for_each(el, &rt->gc_obj_list) {
+        JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
+        JSObject *p;
+        JSShape *sh;
+        JSShapeProperty *prs;
+
+        if (gp->gc_obj_type == JS_GC_OBJ_TYPE_FUNCTION_BYTECODE) {
+            compute_bytecode_size((JSFunctionBytecode *)gp, hp);
+            continue;
+        }
+        /* XXX: could count the other GC object types too */
+        if (gp->gc_obj_type != JS_GC_OBJ_TYPE_JS_OBJECT)
+            continue;
+        p = (JSObject *)gp;
+        sh = p->shape;
+        s->obj_count++;
+        if (p->prop) {
+            s->memory_used_count++;
+            s->prop_size += sh->prop_size * sizeof(*p->prop);
+            s->prop_count += sh->prop_count;
+            prs = get_shape_prop(sh);
+            for(i = 0; i < sh->prop_count; i++) {
+                JSProperty *pr = &p->prop[i];
+                if (prs->atom != JS_ATOM_NULL &&
+                    JS_VALUE_GET_TAG(pr->value) == JS_TAG_STRING) {
+                    JSString *str = JS_VALUE_GET_STRING(pr->value);
+                    /* a string shared by n values counts for 1/n */
+                    hp->str_count += 1.0 / str->header.ref_count;
+                    hp->str_size += (sizeof(*str) + (str->len << str->is_wide_char) +
+                                     1 - str->is_wide_char) /
+                        (double)str->header.ref_count;
+                }
+                prs++;
+            }
+        }
+        /* the hashed shapes are counted below */
+        if (!sh->is_hashed) {
+            s->shape_count++;
+            shape_size += js_shape_size(sh);
+        }
+        switch(p->class_id) {
+        case JS_CLASS_C_FUNCTION:
+            s->c_func_count++;
+            break;
+        case JS_CLASS_ARRAY:
+            s->array_count++;
+            if (p->fast_array) {
+                s->fast_array_count++;
+                s->fast_array_elements += p->u.array.count;
+            }
+            break;
+        case JS_CLASS_ARRAY_BUFFER:
+            /* the data of the typed arrays is counted in their
+               ArrayBuffer, including the host memory */
+            if (p->u.array_buffer) {
+                s->binary_object_count++;
+                s->binary_object_size += p->u.array_buffer->byte_length;
+                s->memory_used_count++;
+                s->memory_used_size += sizeof(JSArrayBuffer);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    s->obj_size += s->obj_count * sizeof(JSObject);
+
+    /* hashed shapes */
+    s->memory_used_count++; /* rt->shape_hash */
+    s->memory_used_size += sizeof(rt->shape_hash[0]) * rt->shape_hash_size;
+    for(i = 0; i < rt->shape_hash_size; i++) {
+        JSShape *sh;
+        for(sh = rt->shape_hash[i]; sh != NULL; sh = sh->shape_hash_next) {
+            s->shape_count++;
+            shape_size += js_shape_size(sh);
+        }
+    }
+    s->shape_size = round(shape_size);
+
+    s->str_count = round(hp->str_count);
+    s->str_size = round(hp->str_size);
+    s->js_func_count = hp->js_func_count;
+    s->js_func_size = round(hp->js_func_size);
+    s->js_func_code_size = hp->js_func_code_size;
+    s->js_func_pc2line_count = hp->js_func_pc2line_count;
+    s->js_func_pc2line_size = hp->js_func_pc2line_size;
+    s->jit_func_count = hp->jit_func_count;
+    s->jit_code_size = hp->jit_code_size;
+    s->memory_used_count += round(hp->memory_used_count) +
+        s->obj_count + s->shape_count + s->str_count + s->js_func_count;
+    s->memory_used_size += s->atom_size + s->str_size +
+        s->obj_size + s->prop_size + s->shape_size +
+        s->js_func_size + s->js_func_code_size + s->js_func_pc2line_size;
 }
 
 
@@ -121,4 +464,61 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt) {
                 MALLOC_OVERHEAD, ((double)(s->malloc_size - s->memory_used_size) /
                                   s->memory_used_count));
     }
+    if (s->atom_count) {
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per atom)\n",
+                "atoms", s->atom_count, s->atom_size,
+                (double)s->atom_size / s->atom_count);
+    }
+    if (s->str_count) {
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per string)\n",
+                "strings", s->str_count, s->str_size,
+                (double)s->str_size / s->str_count);
+    }
+    if (s->obj_count) {
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per object)\n",
+                "objects", s->obj_count, s->obj_size,
+                (double)s->obj_size / s->obj_count);
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per object)\n",
+                "  properties", s->prop_count, s->prop_size,
+                (double)s->prop_count / s->obj_count);
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per shape)\n",
+                "  shapes", s->shape_count, s->shape_size,
+                (double)s->shape_size / s->shape_count);
+    }
+    if (s->js_func_count) {
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"\n",
+                "bytecode functions", s->js_func_count, s->js_func_size);
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per function)\n",
+                "  bytecode", s->js_func_count, s->js_func_code_size,
+                (double)s->js_func_code_size / s->js_func_count);
+        if (s->js_func_pc2line_count) {
+            fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per function)\n",
+                    "  pc2line", s->js_func_pc2line_count,
+                    s->js_func_pc2line_size,
+                    (double)s->js_func_pc2line_size / s->js_func_pc2line_count);
+        }
+        if (s->jit_func_count) {
+            fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per function)\n",
+                    "  machine code", s->jit_func_count, s->jit_code_size,
+                    (double)s->jit_code_size / s->jit_func_count);
+        }
+    }
+    if (s->c_func_count) {
+        fprintf(fp, "%-20s %8"PRId64"\n", "C functions", s->c_func_count);
+    }
+    if (s->array_count) {
+        fprintf(fp, "%-20s %8"PRId64"\n", "arrays", s->array_count);
+    }
+    if (s->fast_array_count) {
+        fprintf(fp, "%-20s %8"PRId64"\n", "  fast arrays", s->fast_array_count);
+        fprintf(fp, "%-20s %8"PRId64"  (%0.1f per fast array)\n",
+                "  elements", s->fast_array_elements,
+                (double)s->fast_array_elements / s->fast_array_count);
+    }
+    if (s->binary_object_count) {
+        fprintf(fp, "%-20s %8"PRId64" %8"PRId64"\n",
+                "binary objects", s->binary_object_count,
+                s->binary_object_size);
+    }
+    fprintf(fp, "\n");
 }
@@ -0,0 +1,128 @@
+#ifndef QJS_RUNTIME_INTERNAL_H
+#define QJS_RUNTIME_INTERNAL_H
+#include "qjs-core.h"
+#include "jmemory.h"
+#include "list.h"
+#include "gc.h"
+
+typedef struct JSString JSAtomStruct;
+typedef struct JSShape JSShape;
+
+#define JS_JOB_MAX_ARGS 5
+
+/* size classes of the free generator frames: class i holds the frames
+   of (i + 1) * JS_FRAME_POOL_GRANULE values. The larger frames are not
+   kept. */
+#define JS_FRAME_POOL_GRANULE 8
+#define JS_FRAME_POOL_CLASSES 16
+#define JS_FRAME_POOL_MAX_FREE 256 /* per class */
+
+/* pending job record, reused once the job has run */
+typedef struct JSJobEntry {
+    JSContext *realm;
+    JSJobFunc *job_func;
+    int argc;
+    JSValue argv[JS_JOB_MAX_ARGS];
+} JSJobEntry;
+
+struct JSRuntime {
+    JSMallocFunctions mf;
+    JSMallocState malloc_state;
+    /* account of the context running, charged by js_malloc_rt() */
+    JSMemAccount *malloc_account;
+    /* the accounts by id, slot 0 (the runtime) is not used */
+    JSMemAccount **account_array;
+    int account_size;
+    int account_free_index; /* lowest slot which may be free */
+
+    int atom_hash_size; /* power of two */
+    int atom_count;
+    int atom_size;
+    int atom_count_resize; /* resize hash table at this count */
+    uint32_t *atom_hash;
+    JSAtomStruct **atom_array;
+    int atom_free_index; /* 0 = none */
+
+    struct list_head context_list; /* list of JSContext.link */
+    /* list of JSGCObjectHeader.link. List of allocated GC objects (used
+       by the garbage collector) */
+    struct list_head gc_obj_list;
+    /* list of JSGCObjectHeader.link. Used during JS_FreeValueRT() */
+    struct list_head gc_zero_ref_count_list;
+    struct list_head tmp_obj_list; /* used during GC */
+    JSGCPhaseEnum gc_phase : 8;
+    size_t malloc_gc_threshold;
+
+    BOOL in_out_of_memory : 8;
+    JSValue current_exception;
+
+    /* hashed shapes, shared between the objects of all the contexts */
+    int shape_hash_bits;
+    int shape_hash_size;
+    int shape_hash_count; /* number of hashed shapes */
+    JSShape **shape_hash;
+    uint32_t shape_version; /* last JSShape.version */
+
+    /* pending jobs: ring buffer of job_ring_size entries (power of
+       two). The entries are kept allocated between the drains. */
+    JSJobEntry *job_ring;
+    uint32_t job_ring_size;
+    uint32_t job_head; /* next job to run */
+    uint32_t job_tail; /* next free entry */
+
+    /* free generator frames (list of JSAsyncFrame.header.link), reused
+       by the next generators. They are charged to the runtime because
+       they move between the contexts. */
+    struct list_head frame_pool[JS_FRAME_POOL_CLASSES];
+    uint32_t frame_pool_count[JS_FRAME_POOL_CLASSES];
+    size_t frame_pool_size; /* bytes held by the free frames */
+
+    void *user_opaque;
+
+    /* interrupts: the poll points decrement interrupt_counter and call
+       __js_poll_interrupts() when it reaches zero */
+    int interrupt_counter;
+    int interrupt_requested; /* set by JS_RequestInterrupt() */
+    int64_t cpu_deadline_ns; /* thread CPU time, 0 = no limit */
+    JSInterruptHandler *interrupt_handler;
+    void *interrupt_opaque;
+
+    /* the C stack used by the recursive calls */
+    uintptr_t stack_size; /* 0 = no limit */
+    uintptr_t stack_top;
+    uintptr_t stack_limit; /* lower stack limit */
+
+    BOOL jit_enabled; /* compile the hot functions (see jit.h) */
+};
+
+#define JS_DEFAULT_STACK_SIZE (1024 * 1024)
+
+static inline uintptr_t js_get_stack_pointer(void)
+{
+    return (uintptr_t)__builtin_frame_address(0);
+}
+
+/* TRUE if 'alloca_size' more bytes of stack would exceed the limit */
+static inline BOOL js_check_stack_overflow(JSRuntime *rt, size_t alloca_size)
+{
+    uintptr_t sp;
+    sp = js_get_stack_pointer() - alloca_size;
+    return unlikely(sp < rt->stack_limit);
+}
+
+#define JS_INTERRUPT_COUNTER_INIT 10000
+
+int __js_poll_interrupts(JSContext *ctx);
+
+void js_free_jobs(JSRuntime *rt);
+
+void *js_malloc_account(JSRuntime *rt, JSMemAccount *account, size_t size);
+void *js_realloc_account(JSRuntime *rt, JSMemAccount *account,
+                         void *ptr, size_t size);
+JSMemAccount *js_new_account(JSRuntime *rt);
+void js_free_account(JSRuntime *rt, JSMemAccount *account);
+/* blocks without account header: the caller keeps the account id */
+void *js_malloc_gc_rt(JSRuntime *rt, JSMemAccount *account, size_t size);
+void js_free_gc_rt(JSRuntime *rt, void *ptr, int account_id);
+
+#endif //QJS_RUNTIME_INTERNAL_H
@@ -3,16 +3,522 @@
 //
 
 #include "atoms.h"
+#include "context.h"
+#include "dtoa.h"
 
-/* only works with zero terminated 8 bit strings */
-static JSAtom __JS_NewAtomInit(JSRuntime *rt, const char *str, int len,
-                               int atom_type)
+static const char js_atom_init[] =
+#define DEF(name, str) str "\0"
+#include "qjs-atom.h"
+#undef DEF
+;
+
+/* free entries of atom_array are odd and hold the next free index */
+static inline BOOL atom_is_free(const JSAtomStruct *p)
 {
-    JSString *p;
-    p = js_alloc_string_rt(rt, len, 0);
-    if (!p)
+    return (uintptr_t)p & 1;
+}
+
+static inline JSAtomStruct *atom_set_free(uint32_t v)
+{
+    return (JSAtomStruct *)(((uintptr_t)v << 1) | 1);
+}
+
+static inline uint32_t atom_get_free(const JSAtomStruct *p)
+{
+    return (uintptr_t)p >> 1;
+}
+
+static inline uint32_t hash_string8(const uint8_t *str, size_t len, uint32_t h)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+        h = js_atom_hash_step(h, str[i]);
+    return h;
+}
+
+static inline uint32_t hash_string16(const uint16_t *str,
+                                     size_t len, uint32_t h)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+        h = js_atom_hash_step(h, str[i]);
+    return h;
+}
+
+static uint32_t hash_string(const JSString *str, uint32_t h)
+{
+    if (str->is_wide_char)
+        h = hash_string16(str->u.str16, str->len, h);
+    else
+        h = hash_string8(str->u.str8, str->len, h);
+    return h;
+}
+
+/* return TRUE if 'buf' is the canonical representation of an uint32
+   integer. Only the integers <= JS_ATOM_MAX_INT are tagged atoms. */
+static BOOL is_num_string8(uint32_t *pval, const uint8_t *buf, size_t len)
+{
+    uint64_t n;
+    size_t i;
+
+    if (len == 0 || len > 10)
+        return FALSE;
+    if (buf[0] == '0')
+        return len == 1 ? (*pval = 0, TRUE) : FALSE;
+    n = 0;
+    for(i = 0; i < len; i++) {
+        if (buf[i] < '0' || buf[i] > '9')
+            return FALSE;
+        n = n * 10 + buf[i] - '0';
+    }
+    if (n > UINT32_MAX)
+        return FALSE;
+    *pval = n;
+    return TRUE;
+}
+
+static BOOL is_num_string(uint32_t *pval, const JSString *p)
+{
+    uint8_t buf[10];
+    size_t i;
+
+    if (!p->is_wide_char)
+        return is_num_string8(pval, p->u.str8, p->len);
+    if (p->len > sizeof(buf))
+        return FALSE;
+    for(i = 0; i < p->len; i++) {
+        if (p->u.str16[i] >= 0x80)
+            return FALSE;
+        buf[i] = p->u.str16[i];
+    }
+    return is_num_string8(pval, buf, p->len);
+}
+
+static int JS_ResizeAtomHash(JSRuntime *rt, int new_hash_size)
+{
+    JSAtomStruct *p;
+    uint32_t new_hash_mask, h, i, hash_next1, j, *new_hash;
+
+    assert((new_hash_size & (new_hash_size - 1)) == 0); /* power of two */
+    new_hash_mask = new_hash_size - 1;
+    new_hash = js_mallocz_rt(rt, sizeof(rt->atom_hash[0]) * new_hash_size);
+    if (!new_hash)
+        return -1;
+    for(i = 0; i < rt->atom_hash_size; i++) {
+        h = rt->atom_hash[i];
+        while (h != 0) {
+            p = rt->atom_array[h];
+            hash_next1 = p->hash_next;
+            /* add in new hash table */
+            j = p->hash & new_hash_mask;
+            p->hash_next = new_hash[j];
+            new_hash[j] = h;
+            h = hash_next1;
+        }
+    }
+    js_free_rt(rt, rt->atom_hash);
+    rt->atom_hash = new_hash;
+    rt->atom_hash_size = new_hash_size;
+    rt->atom_count_resize = 2 * new_hash_size;
+    return 0;
+}
+
+/* make room for at least one more atom */
+static int js_atom_grow(JSRuntime *rt)
+{
+    JSAtomStruct **new_array;
+    JSAtomStruct *p;
+    int new_size, start, i;
+
+    new_size = max_int(211, rt->atom_size * 3 / 2);
+    if (new_size > JS_ATOM_MAX_INT)
+        return -1;
+    new_array = js_realloc_rt(rt, rt->atom_array,
+                              sizeof(*new_array) * new_size);
+    if (!new_array)
+        return -1;
+    start = rt->atom_size;
+    if (start == 0) {
+        /* the JS_ATOM_NULL entry is a permanent empty string */
+        p = js_mallocz_rt(rt, sizeof(JSAtomStruct) + 1);
+        if (!p) {
+            js_free_rt(rt, new_array);
+            return -1;
+        }
+        p->header.ref_count = 1;
+        p->atom_type = JS_ATOM_TYPE_STRING;
+        new_array[0] = p;
+        rt->atom_count++;
+        start = 1;
+    }
+    rt->atom_size = new_size;
+    rt->atom_array = new_array;
+    rt->atom_free_index = start;
+    for(i = start; i < new_size; i++)
+        rt->atom_array[i] = atom_set_free(i == new_size - 1 ? 0 : i + 1);
+    return 0;
+}
+
+static JSAtom js_atom_insert(JSRuntime *rt, JSString *str, uint32_t h,
+                            int atom_type)
+{
+    uint32_t i;
+
+    if (rt->atom_free_index == 0) {
+        if (js_atom_grow(rt))
+            return JS_ATOM_NULL;
+    }
+    i = rt->atom_free_index;
+    rt->atom_free_index = atom_get_free(rt->atom_array[i]);
+    rt->atom_array[i] = str;
+    str->atom_type = atom_type;
+    str->hash = h;
+    str->hash_next = rt->atom_hash[h & (rt->atom_hash_size - 1)];
+    rt->atom_hash[h & (rt->atom_hash_size - 1)] = i;
+    rt->atom_count++;
+    if (rt->atom_count >= rt->atom_count_resize)
+        JS_ResizeAtomHash(rt, rt->atom_hash_size * 2);
+    return i;
+}
+
+JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
+{
+    JSAtomStruct *p;
+    uint32_t h, i, n;
+
+    if (is_num_string(&n, str) && n <= JS_ATOM_MAX_INT) {
+        js_free_string_rt(rt, str);
+        return __JS_AtomFromUInt32(n);
+    }
+    h = hash_string(str, atom_type) & JS_ATOM_HASH_MASK;
+    i = rt->atom_hash[h & (rt->atom_hash_size - 1)];
+    while (i != 0) {
+        p = rt->atom_array[i];
+        if (p->hash == h && p->atom_type == atom_type &&
+            p->len == str->len && js_string_memcmp(p, str, str->len) == 0) {
+            js_free_string_rt(rt, str);
+            if (!__JS_AtomIsConst(i))
+                p->header.ref_count++;
+            return i;
+        }
+        i = p->hash_next;
+    }
+    i = js_atom_insert(rt, str, h, atom_type);
+    if (i == JS_ATOM_NULL)
+        js_free_string_rt(rt, str);
+    return i;
+}
+
+JSAtom __JS_NewAtomLen(JSRuntime *rt, const char *str, size_t len)
+{
+    const uint8_t *buf = (const uint8_t *)str;
+    JSString *s;
+    StringBuffer b_s, *b = &b_s;
+    UTF8Decoder dec;
+    uint32_t n;
+    size_t j;
+
+    for(j = 0; j < len; j++) {
+        if (buf[j] >= 0x80)
+            break;
+    }
+    if (j < len) {
+        /* non ASCII: convert to a JS string first */
+        utf8_decode_init(&dec);
+        if (string_buffer_init(rt, b, len))
+            return JS_ATOM_NULL;
+        if (string_buffer_write_utf8(b, &dec, buf, len) ||
+            string_buffer_write_utf8_end(b, &dec)) {
+            string_buffer_free(b);
+            return JS_ATOM_NULL;
+        }
+        s = string_buffer_end(b);
+        if (!s)
+            return JS_ATOM_NULL;
+        return __JS_NewAtom(rt, s, JS_ATOM_TYPE_STRING);
+    }
+
+    /* ASCII: lookup without allocation */
+    if (is_num_string8(&n, buf, len) && n <= JS_ATOM_MAX_INT)
+        return __JS_AtomFromUInt32(n);
+    return __JS_NewAtom8(rt, buf, len,
+                         hash_string8(buf, len, JS_ATOM_TYPE_STRING));
+}
+
+JSAtom __JS_NewAtom8(JSRuntime *rt, const uint8_t *buf, size_t len,
+                     uint32_t h)
+{
+    JSAtomStruct *p;
+    JSString *s;
+    uint32_t i;
+
+    h &= JS_ATOM_HASH_MASK;
+    i = rt->atom_hash[h & (rt->atom_hash_size - 1)];
+    while (i != 0) {
+        p = rt->atom_array[i];
+        if (p->hash == h && p->atom_type == JS_ATOM_TYPE_STRING &&
+            p->len == len && !p->is_wide_char &&
+            memcmp(p->u.str8, buf, len) == 0) {
+            if (!__JS_AtomIsConst(i))
+                p->header.ref_count++;
+            return i;
+        }
+        i = p->hash_next;
+    }
+    s = js_alloc_string_rt(rt, len, 0);
+    if (!s)
         return JS_ATOM_NULL;
-    memcpy(p->u.str8, str, len);
-    p->u.str8[len] = '\0';
-    return __JS_NewAtom(rt, p, atom_type);
-}
\ No newline at end of file
+    memcpy(s->u.str8, buf, len);
+    s->u.str8[len] = '\0';
+    i = js_atom_insert(rt, s, h, JS_ATOM_TYPE_STRING);
+    if (i == JS_ATOM_NULL)
+        js_free_string_rt(rt, s);
+    return i;
+}
+
+int JS_InitAtoms(JSRuntime *rt)
+{
+    const char *p;
+    size_t len;
+    int i;
+
+    rt->atom_hash_size = 0;
+    rt->atom_hash = NULL;
+    rt->atom_count = 0;
+    rt->atom_size = 0;
+    rt->atom_free_index = 0;
+    if (JS_ResizeAtomHash(rt, 256))
+        return -1;
+    /* the predefined atoms get consecutive indexes in the DEF order */
+    p = js_atom_init;
+    for(i = 1; i < JS_ATOM_END; i++) {
+        len = strlen(p);
+        if (__JS_NewAtomLen(rt, p, len) != i)
+            return -1;
+        p += len + 1;
+    }
+    return 0;
+}
+
+void JS_FreeAtoms(JSRuntime *rt)
+{
+    JSAtomStruct *p;
+    int i;
+
+    for(i = 0; i < rt->atom_size; i++) {
+        p = rt->atom_array[i];
+        if (!atom_is_free(p))
+            js_free_rt(rt, p);
+    }
+    js_free_rt(rt, rt->atom_array);
+    js_free_rt(rt, rt->atom_hash);
+    rt->atom_array = NULL;
+    rt->atom_hash = NULL;
+    rt->atom_size = 0;
+    rt->atom_count = 0;
+}
+
+/* remove the atom from the table and free it */
+void JS_FreeAtomStruct(JSRuntime *rt, JSAtomStruct *p)
+{
+    uint32_t i, h0, *ph;
+    JSAtomStruct *p1;
+
+    h0 = p->hash & (rt->atom_hash_size - 1);
+    ph = &rt->atom_hash[h0];
+    for(;;) {
+        i = *ph;
+        assert(i != 0);
+        p1 = rt->atom_array[i];
+        if (p1 == p)
+            break;
+        ph = &p1->hash_next;
+    }
+    *ph = p->hash_next;
+    rt->atom_array[i] = atom_set_free(rt->atom_free_index);
+    rt->atom_free_index = i;
+    rt->atom_count--;
+    js_free_rt(rt, p);
+}
+
+JSAtom JS_DupAtomRT(JSRuntime *rt, JSAtom v)
+{
+    if (!__JS_AtomIsConst(v))
+        rt->atom_array[v]->header.ref_count++;
+    return v;
+}
+
+void JS_FreeAtomRT(JSRuntime *rt, JSAtom v)
+{
+    JSAtomStruct *p;
+
+    if (__JS_AtomIsConst(v))
+        return;
+    p = rt->atom_array[v];
+    if (--p->header.ref_count <= 0)
+        JS_FreeAtomStruct(rt, p);
+}
+
+JSAtom JS_NewAtomLen(JSContext *ctx, const char *str, size_t len)
+{
+    JSAtom atom;
+
+    atom = __JS_NewAtomLen(ctx->rt, str, len);
+    if (atom == JS_ATOM_NULL)
+        JS_ThrowOutOfMemory(ctx);
+    return atom;
+}
+
+JSAtom JS_NewAtom(JSContext *ctx, const char *str)
+{
+    return JS_NewAtomLen(ctx, str, strlen(str));
+}
+
+JSAtom JS_NewAtomUInt32(JSContext *ctx, uint32_t n)
+{
+    char buf[JS_ITOA_MAX_LEN];
+    size_t len;
+
+    if (n <= JS_ATOM_MAX_INT)
+        return __JS_AtomFromUInt32(n);
+    len = u32toa(buf, n);
+    return JS_NewAtomLen(ctx, buf, len);
+}
+
+JSAtom JS_DupAtom(JSContext *ctx, JSAtom v)
+{
+    return JS_DupAtomRT(ctx->rt, v);
+}
+
+void JS_FreeAtom(JSContext *ctx, JSAtom v)
+{
+    JS_FreeAtomRT(ctx->rt, v);
+}
+
+JSValue JS_AtomToString(JSContext *ctx, JSAtom atom)
+{
+    char buf[JS_ITOA_MAX_LEN];
+    JSAtomStruct *p;
+    size_t len;
+
+    if (__JS_AtomIsTaggedInt(atom)) {
+        len = u32toa(buf, __JS_AtomToUInt32(atom));
+        return JS_NewStringLen(ctx, buf, len);
+    }
+    p = ctx->rt->atom_array[atom];
+    /* the atom reference count is the string reference count. The
+       predefined atoms keep their initial reference. */
+    return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, p));
+}
+
+/* return the index of an atom string */
+static JSAtom js_get_atom_index(JSRuntime *rt, JSAtomStruct *p)
+{
+    uint32_t i;
+
+    i = rt->atom_hash[p->hash & (rt->atom_hash_size - 1)];
+    while (rt->atom_array[i] != p) {
+        i = rt->atom_array[i]->hash_next;
+    }
+    return i;
+}
+
+JSAtom JS_ValueToAtom(JSContext *ctx, JSValueConst val)
+{
+    JSAtom atom;
+    JSString *p;
+    JSValue str;
+    uint32_t tag;
+
+    tag = JS_VALUE_GET_TAG(val);
+    if (tag == JS_TAG_INT && (uint32_t)JS_VALUE_GET_INT(val) <= JS_ATOM_MAX_INT) {
+        /* fast path for integer values */
+        return __JS_AtomFromUInt32(JS_VALUE_GET_INT(val));
+    } else if (tag == JS_TAG_STRING) {
+        p = JS_VALUE_GET_STRING(val);
+        if (p->atom_type)
+            return JS_DupAtom(ctx, js_get_atom_index(ctx->rt, p));
+        /* the string itself becomes the atom */
+        JS_DupValue(ctx, val);
+        atom = __JS_NewAtom(ctx->rt, p, JS_ATOM_TYPE_STRING);
+    } else {
+        str = JS_ToString(ctx, val);
+        if (JS_IsException(str))
+            return JS_ATOM_NULL;
+        atom = JS_ValueToAtom(ctx, str);
+        JS_FreeValue(ctx, str);
+        return atom;
+    }
+    if (atom == JS_ATOM_NULL)
+        JS_ThrowOutOfMemory(ctx);
+    return atom;
+}
+
+const char *JS_AtomGetStrRT(JSRuntime *rt, char *buf, int buf_size,
+                            JSAtom atom)
+{
+    JSAtomStruct *p;
+    char *q, *q_end;
+    uint32_t c;
+    uint32_t i;
+
+    if (buf_size <= 0)
+        return buf;
+    if (__JS_AtomIsTaggedInt(atom)) {
+        snprintf(buf, buf_size, "%u", __JS_AtomToUInt32(atom));
+        return buf;
+    }
+    if (atom >= rt->atom_size || atom_is_free(rt->atom_array[atom])) {
+        snprintf(buf, buf_size, "<invalid %x>", atom);
+        return buf;
+    }
+    p = rt->atom_array[atom];
+    if (!p->is_wide_char) {
+        /* pure ASCII strings need no conversion */
+        for(i = 0; i < p->len; i++) {
+            if (p->u.str8[i] >= 0x80)
+                break;
+        }
+        if (i == p->len)
+            return (const char *)p->u.str8;
+    }
+    q = buf;
+    q_end = buf + buf_size - UTF8_CHAR_LEN_MAX;
+    for(i = 0; i < p->len && q < q_end; i++) {
+        if (p->is_wide_char)
+            c = p->u.str16[i];
+        else
+            c = p->u.str8[i];
+        q += unicode_to_utf8((uint8_t *)q, c);
+    }
+    *q = '\0';
+    return buf;
+}
+
+const char *JS_AtomGetStr(JSContext *ctx, char *buf, int buf_size,
+                          JSAtom atom)
+{
+    return JS_AtomGetStrRT(ctx->rt, buf, buf_size, atom);
+}
+
+/* the array indexes are the integers < 2^32 - 1. Those above
+   JS_ATOM_MAX_INT are string atoms. */
+BOOL JS_AtomIsArrayIndex(JSContext *ctx, uint32_t *pidx, JSAtom atom)
+{
+    JSAtomStruct *p;
+    uint32_t n;
+
+    if (__JS_AtomIsTaggedInt(atom)) {
+        *pidx = __JS_AtomToUInt32(atom);
+        return TRUE;
+    }
+    p = ctx->rt->atom_array[atom];
+    if (p->atom_type == JS_ATOM_TYPE_STRING && is_num_string(&n, p) &&
+        n != UINT32_MAX) {
+        *pidx = n;
+        return TRUE;
+    }
+    return FALSE;
+}
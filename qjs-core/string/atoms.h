@@ -5,8 +5,76 @@
 #ifndef QJS_ATOMS_H
 #define QJS_ATOMS_H
 #include "jsstring.h"
+#include "runtime.h"
 
-typedef uint32_t JSAtom;
+enum {
+    __JS_ATOM_NULL = JS_ATOM_NULL,
+#define DEF(name, str) JS_ATOM_ ## name,
+#include "qjs-atom.h"
+#undef DEF
+    JS_ATOM_END,
+};
 
+#define JS_ATOM_TAG_INT (1U << 31)
+#define JS_ATOM_MAX_INT (JS_ATOM_TAG_INT - 1)
+#define JS_ATOM_HASH_MASK ((1 << 30) - 1)
+
+#define JS_ATOM_LAST_KEYWORD JS_ATOM_super
+#define JS_ATOM_LAST_STRICT_KEYWORD JS_ATOM_yield
+
+typedef enum {
+    JS_ATOM_TYPE_STRING = 1,
+} JSAtomTypeEnum;
+
+/* the atom hash of a string is computed from h = atom_type, one
+   character at a time */
+static inline uint32_t js_atom_hash_step(uint32_t h, uint32_t c)
+{
+    return h * 263 + c;
+}
+
+/* the integer atoms are not refcounted: they are never freed */
+static inline BOOL __JS_AtomIsTaggedInt(JSAtom v)
+{
+    return (v & JS_ATOM_TAG_INT) != 0;
+}
+
+static inline JSAtom __JS_AtomFromUInt32(uint32_t v)
+{
+    return v | JS_ATOM_TAG_INT;
+}
+
+static inline uint32_t __JS_AtomToUInt32(JSAtom atom)
+{
+    return atom & ~JS_ATOM_TAG_INT;
+}
+
+/* the predefined atoms are never freed */
+static inline BOOL __JS_AtomIsConst(JSAtom v)
+{
+    return (int32_t)v < JS_ATOM_END;
+}
+
+int JS_InitAtoms(JSRuntime *rt);
+void JS_FreeAtoms(JSRuntime *rt);
+/* take ownership of 'str'. Return JS_ATOM_NULL if error. */
+JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type);
+/* the UTF-8 string is not copied if the atom already exists */
+JSAtom __JS_NewAtomLen(JSRuntime *rt, const char *str, size_t len);
+/* find or add the atom of the 8 bit characters 'buf'. 'h' is their
+   string atom hash. 'buf' must not be an array index. */
+JSAtom __JS_NewAtom8(JSRuntime *rt, const uint8_t *buf, size_t len,
+                     uint32_t h);
+JSAtom JS_DupAtomRT(JSRuntime *rt, JSAtom v);
+void JS_FreeAtomStruct(JSRuntime *rt, JSAtomStruct *p);
+/* UTF-8 representation of the atom for debug and error messages */
+const char *JS_AtomGetStrRT(JSRuntime *rt, char *buf, int buf_size,
+                            JSAtom atom);
+const char *JS_AtomGetStr(JSContext *ctx, char *buf, int buf_size,
+                          JSAtom atom);
+/* Return JS_ATOM_NULL if exception */
+JSAtom JS_ValueToAtom(JSContext *ctx, JSValueConst val);
+/* return TRUE and set *pidx if 'atom' is an array index */
+BOOL JS_AtomIsArrayIndex(JSContext *ctx, uint32_t *pidx, JSAtom atom);
 
 #endif //QJS_ATOMS_H
@@ -2,12 +2,16 @@
 // Created by benpeng.jiang on 2021/5/23.
 //
 #include "jsstring.h"
+#include "context.h"
+#include "dtoa.h"
 
 /* Note: the string contents are uninitialized */
-static JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char)
+static JSString *js_alloc_string_account(JSRuntime *rt, JSMemAccount *account,
+                                         int max_len, int is_wide_char)
 {
     JSString *str;
-    str = js_malloc_rt(rt, sizeof(JSString) + (max_len << is_wide_char) + 1 - is_wide_char);
+    str = js_malloc_account(rt, account, sizeof(JSString) +
+                            (max_len << is_wide_char) + 1 - is_wide_char);
     if (unlikely(!str))
         return NULL;
     str->header.ref_count = 1;
@@ -20,4 +24,533 @@ static JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char
     list_add_tail(&str->link, &rt->string_list);
 #endif
     return str;
-}
\ No newline at end of file
+}
+
+JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char)
+{
+    return js_alloc_string_account(rt, rt->malloc_account, max_len,
+                                   is_wide_char);
+}
+
+void js_free_string_rt(JSRuntime *rt, JSString *str)
+{
+    if (--str->header.ref_count <= 0)
+        js_free_rt(rt, str);
+}
+
+JSString *js_alloc_string(JSContext *ctx, int max_len, int is_wide_char)
+{
+    JSString *p;
+    p = js_alloc_string_account(ctx->rt, ctx->mem_account, max_len,
+                                is_wide_char);
+    if (unlikely(!p)) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    return p;
+}
+
+int js_string_memcmp(const JSString *p1, const JSString *p2, int len)
+{
+    int i, c;
+
+    if (!p1->is_wide_char && !p2->is_wide_char)
+        return memcmp(p1->u.str8, p2->u.str8, len);
+    for(i = 0; i < len; i++) {
+        c = (p1->is_wide_char ? p1->u.str16[i] : p1->u.str8[i]) -
+            (p2->is_wide_char ? p2->u.str16[i] : p2->u.str8[i]);
+        if (c != 0)
+            return c;
+    }
+    return 0;
+}
+
+JSValue js_new_string8(JSContext *ctx, const uint8_t *buf, int len)
+{
+    JSString *str;
+
+    str = js_alloc_string(ctx, len, 0);
+    if (!str)
+        return JS_EXCEPTION;
+    memcpy(str->u.str8, buf, len);
+    str->u.str8[len] = '\0';
+    return JS_MKPTR(JS_TAG_STRING, str);
+}
+
+JSValue JS_NewStringLen(JSContext *ctx, const char *buf, size_t buf_len)
+{
+    StringBuffer b_s, *b = &b_s;
+    UTF8Decoder dec;
+    JSString *str;
+    size_t i;
+
+    for(i = 0; i < buf_len; i++) {
+        if ((uint8_t)buf[i] >= 0x80)
+            break;
+    }
+    if (i == buf_len) {
+        if (buf_len > JS_STRING_LEN_MAX)
+            return JS_ThrowRangeError(ctx, "invalid string length");
+        return js_new_string8(ctx, (const uint8_t *)buf, buf_len);
+    }
+    utf8_decode_init(&dec);
+    if (string_buffer_init(ctx->rt, b, buf_len))
+        goto fail;
+    if (string_buffer_write_utf8(b, &dec, (const uint8_t *)buf, buf_len) ||
+        string_buffer_write_utf8_end(b, &dec)) {
+        string_buffer_free(b);
+        goto fail;
+    }
+    str = string_buffer_end(b);
+    if (!str)
+        goto fail;
+    return JS_MKPTR(JS_TAG_STRING, str);
+ fail:
+    return JS_ThrowOutOfMemory(ctx);
+}
+
+struct JSStringDecoder {
+    JSContext *ctx;
+    StringBuffer b;
+    UTF8Decoder dec;
+};
+
+JSStringDecoder *JS_NewStringDecoder(JSContext *ctx)
+{
+    JSStringDecoder *d;
+
+    d = js_malloc(ctx, sizeof(*d));
+    if (!d)
+        return NULL;
+    if (string_buffer_init(ctx->rt, &d->b, 0)) {
+        js_free(ctx, d);
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    d->ctx = ctx;
+    utf8_decode_init(&d->dec);
+    return d;
+}
+
+int JS_StringDecoderWrite(JSStringDecoder *d, const char *buf, size_t len)
+{
+    if (string_buffer_write_utf8(&d->b, &d->dec, (const uint8_t *)buf, len)) {
+        JS_ThrowOutOfMemory(d->ctx);
+        return -1;
+    }
+    return 0;
+}
+
+JSValue JS_StringDecoderEnd(JSStringDecoder *d)
+{
+    JSContext *ctx = d->ctx;
+    JSString *str;
+
+    str = NULL;
+    if (!string_buffer_write_utf8_end(&d->b, &d->dec))
+        str = string_buffer_end(&d->b);
+    JS_FreeStringDecoder(d);
+    if (!str)
+        return JS_ThrowOutOfMemory(ctx);
+    return JS_MKPTR(JS_TAG_STRING, str);
+}
+
+void JS_FreeStringDecoder(JSStringDecoder *d)
+{
+    string_buffer_free(&d->b);
+    js_free(d->ctx, d);
+}
+
+JSValue JS_NewString(JSContext *ctx, const char *str)
+{
+    return JS_NewStringLen(ctx, str, strlen(str));
+}
+
+/* The result is kept in a JSString so that JS_FreeCString() can find
+   the string header. Pure ASCII strings are returned without copy. */
+const char *JS_ToCStringLen(JSContext *ctx, size_t *plen, JSValueConst val1)
+{
+    JSValue val;
+    JSString *str, *str_new;
+    uint8_t *q;
+    uint32_t c, c1;
+    int i, len, count;
+
+    val = JS_ToString(ctx, val1);
+    if (JS_IsException(val))
+        goto fail;
+    str = JS_VALUE_GET_STRING(val);
+    len = str->len;
+    if (!str->is_wide_char) {
+        count = 0;
+        for(i = 0; i < len; i++)
+            count += str->u.str8[i] >> 7;
+        if (count == 0) {
+            if (plen)
+                *plen = len;
+            return (const char *)str->u.str8;
+        }
+        str_new = js_alloc_string(ctx, len + count, 0);
+        if (!str_new)
+            goto fail1;
+        q = str_new->u.str8;
+        for(i = 0; i < len; i++)
+            q += unicode_to_utf8(q, str->u.str8[i]);
+    } else {
+        /* at most 3 bytes per UTF-16 code unit */
+        str_new = js_alloc_string(ctx, len * 3, 0);
+        if (!str_new)
+            goto fail1;
+        q = str_new->u.str8;
+        for(i = 0; i < len; i++) {
+            c = str->u.str16[i];
+            if (c >= 0xd800 && c < 0xdc00 && i + 1 < len) {
+                c1 = str->u.str16[i + 1];
+                if (c1 >= 0xdc00 && c1 < 0xe000) {
+                    c = (((c & 0x3ff) << 10) | (c1 & 0x3ff)) + 0x10000;
+                    i++;
+                }
+            }
+            q += unicode_to_utf8(q, c);
+        }
+    }
+    *q = '\0';
+    str_new->len = q - str_new->u.str8;
+    if (plen)
+        *plen = str_new->len;
+    JS_FreeValue(ctx, val);
+    return (const char *)str_new->u.str8;
+ fail1:
+    JS_FreeValue(ctx, val);
+ fail:
+    if (plen)
+        *plen = 0;
+    return NULL;
+}
+
+void JS_FreeCString(JSContext *ctx, const char *ptr)
+{
+    JSString *p;
+    if (!ptr)
+        return;
+    p = (JSString *)(void *)(ptr - offsetof(JSString, u));
+    JS_FreeValue(ctx, JS_MKPTR(JS_TAG_STRING, p));
+}
+
+JSValue JS_ConcatStrings(JSContext *ctx, JSValue op1, JSValue op2)
+{
+    StringBuffer b_s, *b = &b_s;
+    JSString *p1, *p2, *str;
+
+    p1 = JS_VALUE_GET_STRING(op1);
+    p2 = JS_VALUE_GET_STRING(op2);
+    if (p2->len == 0)
+        goto ret_op1;
+    if (p1->len == 0) {
+        JS_FreeValue(ctx, op1);
+        return op2;
+    }
+    if (string_buffer_init2(ctx->rt, b, p1->len + p2->len,
+                            p1->is_wide_char | p2->is_wide_char))
+        goto fail;
+    if (p1->is_wide_char)
+        string_buffer_write16(b, p1->u.str16, p1->len);
+    else
+        string_buffer_write8(b, p1->u.str8, p1->len);
+    if (p2->is_wide_char)
+        string_buffer_write16(b, p2->u.str16, p2->len);
+    else
+        string_buffer_write8(b, p2->u.str8, p2->len);
+    str = string_buffer_end(b);
+    if (!str)
+        goto fail;
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    return JS_MKPTR(JS_TAG_STRING, str);
+ fail:
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    return JS_ThrowOutOfMemory(ctx);
+ ret_op1:
+    JS_FreeValue(ctx, op2);
+    return op1;
+}
+
+JSValue JS_ToString(JSContext *ctx, JSValueConst val)
+{
+    char buf[JS_DTOA_MAX_LEN];
+    JSValue prim, ret;
+    size_t len;
+
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_STRING:
+        return JS_DupValue(ctx, val);
+    case JS_TAG_INT:
+        len = i32toa(buf, JS_VALUE_GET_INT(val));
+        return js_new_string8(ctx, (const uint8_t *)buf, len);
+    case JS_TAG_FLOAT64:
+        len = js_dtoa(buf, JS_VALUE_GET_FLOAT64(val));
+        return js_new_string8(ctx, (const uint8_t *)buf, len);
+    case JS_TAG_BOOL:
+        return JS_AtomToString(ctx, JS_VALUE_GET_BOOL(val) ?
+                               JS_ATOM_true : JS_ATOM_false);
+    case JS_TAG_NULL:
+        return JS_AtomToString(ctx, JS_ATOM_null);
+    case JS_TAG_UNDEFINED:
+        return JS_AtomToString(ctx, JS_ATOM_undefined);
+    case JS_TAG_EXCEPTION:
+        return JS_EXCEPTION;
+    case JS_TAG_OBJECT:
+        prim = JS_ToPrimitive(ctx, val, HINT_STRING);
+        if (JS_IsException(prim))
+            return prim;
+        ret = JS_ToString(ctx, prim);
+        JS_FreeValue(ctx, prim);
+        return ret;
+    default:
+        return js_new_string8(ctx, (const uint8_t *)"[unsupported type]", 18);
+    }
+}
+
+/* StringBuffer */
+
+int string_buffer_init2(JSRuntime *rt, StringBuffer *s, int size, int is_wide)
+{
+    s->rt = rt;
+    s->size = size;
+    s->len = 0;
+    s->is_wide_char = is_wide;
+    s->error_status = 0;
+    s->str = js_alloc_string_rt(rt, size, is_wide);
+    if (unlikely(!s->str)) {
+        s->size = 0;
+        return s->error_status = -1;
+    }
+    return 0;
+}
+
+void string_buffer_free(StringBuffer *s)
+{
+    js_free_rt(s->rt, s->str);
+    s->str = NULL;
+}
+
+static int string_buffer_set_error(StringBuffer *s)
+{
+    js_free_rt(s->rt, s->str);
+    s->str = NULL;
+    s->size = 0;
+    s->len = 0;
+    return s->error_status = -1;
+}
+
+static no_inline int string_buffer_widen(StringBuffer *s, int size)
+{
+    JSString *str;
+    int i;
+
+    if (s->error_status)
+        return -1;
+    str = js_realloc_rt(s->rt, s->str, sizeof(JSString) + (size << 1));
+    if (!str)
+        return string_buffer_set_error(s);
+    for(i = s->len; i-- > 0;) {
+        str->u.str16[i] = str->u.str8[i];
+    }
+    s->is_wide_char = 1;
+    s->size = size;
+    s->str = str;
+    return 0;
+}
+
+static no_inline int string_buffer_realloc(StringBuffer *s, int new_len, int c)
+{
+    JSString *new_str;
+    int new_size;
+    size_t new_size_bytes;
+
+    if (s->error_status)
+        return -1;
+
+    if (new_len > JS_STRING_LEN_MAX)
+        return string_buffer_set_error(s);
+    new_size = min_int(max_int(new_len, s->size * 3 / 2), JS_STRING_LEN_MAX);
+    if (!s->is_wide_char && c >= 0x100) {
+        return string_buffer_widen(s, new_size);
+    }
+    new_size_bytes = sizeof(JSString) + (new_size << s->is_wide_char) + 1 - s->is_wide_char;
+    new_str = js_realloc_rt(s->rt, s->str, new_size_bytes);
+    if (!new_str)
+        return string_buffer_set_error(s);
+    s->size = new_size;
+    s->str = new_str;
+    return 0;
+}
+
+static no_inline int string_buffer_putc_slow(StringBuffer *s, uint32_t c)
+{
+    if (unlikely(s->len >= s->size)) {
+        if (string_buffer_realloc(s, s->len + 1, c))
+            return -1;
+    }
+    if (s->is_wide_char) {
+        s->str->u.str16[s->len++] = c;
+    } else if (c < 0x100) {
+        s->str->u.str8[s->len++] = c;
+    } else {
+        if (string_buffer_widen(s, s->size))
+            return -1;
+        s->str->u.str16[s->len++] = c;
+    }
+    return 0;
+}
+
+/* 0 <= c <= 0xff */
+int string_buffer_putc8(StringBuffer *s, uint32_t c)
+{
+    if (unlikely(s->len >= s->size)) {
+        if (string_buffer_realloc(s, s->len + 1, c))
+            return -1;
+    }
+    if (s->is_wide_char) {
+        s->str->u.str16[s->len++] = c;
+    } else {
+        s->str->u.str8[s->len++] = c;
+    }
+    return 0;
+}
+
+/* 0 <= c <= 0xffff */
+int string_buffer_putc16(StringBuffer *s, uint32_t c)
+{
+    if (likely(s->len < s->size)) {
+        if (s->is_wide_char) {
+            s->str->u.str16[s->len++] = c;
+            return 0;
+        } else if (c < 0x100) {
+            s->str->u.str8[s->len++] = c;
+            return 0;
+        }
+    }
+    return string_buffer_putc_slow(s, c);
+}
+
+/* 0 <= c <= 0x10ffff */
+int string_buffer_putc(StringBuffer *s, uint32_t c)
+{
+    if (unlikely(c >= 0x10000)) {
+        /* surrogate pair */
+        c -= 0x10000;
+        if (string_buffer_putc16(s, (c >> 10) + 0xd800))
+            return -1;
+        c = (c & 0x3ff) + 0xdc00;
+    }
+    return string_buffer_putc16(s, c);
+}
+
+int string_buffer_write8(StringBuffer *s, const uint8_t *p, int len)
+{
+    int i;
+
+    if (s->len + len > s->size) {
+        if (string_buffer_realloc(s, s->len + len, 0))
+            return -1;
+    }
+    if (s->is_wide_char) {
+        for (i = 0; i < len; i++) {
+            s->str->u.str16[s->len + i] = p[i];
+        }
+        s->len += len;
+    } else {
+        memcpy(&s->str->u.str8[s->len], p, len);
+        s->len += len;
+    }
+    return 0;
+}
+
+int string_buffer_write16(StringBuffer *s, const uint16_t *p, int len)
+{
+    int c = 0, i;
+
+    for (i = 0; i < len; i++) {
+        c |= p[i];
+    }
+    if (s->len + len > s->size) {
+        if (string_buffer_realloc(s, s->len + len, c))
+            return -1;
+    } else if (!s->is_wide_char && c >= 0x100) {
+        if (string_buffer_widen(s, s->size))
+            return -1;
+    }
+    if (s->is_wide_char) {
+        memcpy(&s->str->u.str16[s->len], p, len << 1);
+        s->len += len;
+    } else {
+        for (i = 0; i < len; i++) {
+            s->str->u.str8[s->len + i] = p[i];
+        }
+        s->len += len;
+    }
+    return 0;
+}
+
+/* Append a chunk of UTF-8 input. A multi-byte sequence split between
+   two chunks is kept in 'dec' and completed by the next call. */
+int string_buffer_write_utf8(StringBuffer *s, UTF8Decoder *dec,
+                             const uint8_t *buf, size_t len)
+{
+    uint16_t tmp[256];
+    const uint8_t *p, *p_end, *p_start;
+    size_t n;
+
+    p = buf;
+    p_end = buf + len;
+    while (p < p_end) {
+        if (!utf8_decode_pending(dec) && *p < 0x80) {
+            /* ASCII runs are copied without conversion */
+            p_start = p;
+            while (p < p_end && *p < 0x80)
+                p++;
+            if (string_buffer_write8(s, p_start, p - p_start))
+                return -1;
+        } else {
+            n = utf8_decode16(dec, tmp, countof(tmp), &p, p_end);
+            if (string_buffer_write16(s, tmp, n))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Signal the end of the UTF-8 input: a truncated sequence is replaced
+   by U+FFFD */
+int string_buffer_write_utf8_end(StringBuffer *s, UTF8Decoder *dec)
+{
+    uint16_t c;
+
+    if (utf8_decode16_end(dec, &c))
+        return string_buffer_putc16(s, c);
+    return 0;
+}
+
+JSString *string_buffer_end(StringBuffer *s)
+{
+    JSString *str;
+    str = s->str;
+    if (s->error_status)
+        return NULL;
+    if (s->len < s->size) {
+        /* smaller size so js_realloc should not fail, but OK if it does */
+        str = js_realloc_rt(s->rt, str, sizeof(JSString) +
+                            (s->len << s->is_wide_char) + 1 - s->is_wide_char);
+        if (str == NULL)
+            str = s->str;
+        s->str = str;
+    }
+    if (!s->is_wide_char)
+        str->u.str8[s->len] = 0;
+    str->is_wide_char = s->is_wide_char;
+    str->len = s->len;
+    s->str = NULL;
+    return str;
+}
@@ -6,9 +6,13 @@
 #define QJS_JSSTRING_H
 
 #include "qjs-runtime.h"
+#include "cutils.h"
+#include "gc.h"
 typedef struct JSString JSString;
 typedef struct JSString JSAtomStruct;
 
+#define JS_STRING_LEN_MAX ((1 << 30) - 1)
+
 struct JSString {
     JSRefCountHeader header; /* must come first, 32-bit */
     uint32_t len : 31;
@@ -26,5 +30,42 @@ struct JSString {
     } u;
 };
 
+#define JS_VALUE_GET_STRING(v) ((JSString *)JS_VALUE_GET_PTR(v))
+
+JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char);
+void js_free_string_rt(JSRuntime *rt, JSString *str);
+JSString *js_alloc_string(JSContext *ctx, int max_len, int is_wide_char);
+/* compare the first 'len' characters of two strings of any width */
+int js_string_memcmp(const JSString *p1, const JSString *p2, int len);
+JSValue js_new_string8(JSContext *ctx, const uint8_t *buf, int len);
+/* concatenate two strings, taking ownership of both */
+JSValue JS_ConcatStrings(JSContext *ctx, JSValue op1, JSValue op2);
+
+/* Incremental string construction. The string stays 8 bit wide until
+   a character >= 0x100 is added. */
+typedef struct StringBuffer {
+    JSRuntime *rt;
+    JSString *str;
+    int len;
+    int size;
+    int is_wide_char;
+    int error_status;
+} StringBuffer;
+
+int string_buffer_init2(JSRuntime *rt, StringBuffer *s, int size, int is_wide);
+static inline int string_buffer_init(JSRuntime *rt, StringBuffer *s, int size)
+{
+    return string_buffer_init2(rt, s, size, 0);
+}
+void string_buffer_free(StringBuffer *s);
+int string_buffer_putc8(StringBuffer *s, uint32_t c);
+int string_buffer_putc16(StringBuffer *s, uint32_t c);
+int string_buffer_putc(StringBuffer *s, uint32_t c);
+int string_buffer_write8(StringBuffer *s, const uint8_t *p, int len);
+int string_buffer_write16(StringBuffer *s, const uint16_t *p, int len);
+int string_buffer_write_utf8(StringBuffer *s, UTF8Decoder *dec,
+                             const uint8_t *buf, size_t len);
+int string_buffer_write_utf8_end(StringBuffer *s, UTF8Decoder *dec);
+JSString *string_buffer_end(StringBuffer *s);
 
 #endif //QJS_JSSTRING_H
@@ -0,0 +1,120 @@
+/*
+ * QuickJS atom definitions
+ *
+ * Copyright (c) 2017-2018 Fabrice Bellard
+ * Copyright (c) 2017-2018 Charlie Gordon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef DEF
+
+/* keywords: must be first, in the token order of the lexer */
+DEF(null, "null")
+DEF(false, "false")
+DEF(true, "true")
+DEF(if, "if")
+DEF(else, "else")
+DEF(return, "return")
+DEF(var, "var")
+DEF(this, "this")
+DEF(delete, "delete")
+DEF(void, "void")
+DEF(typeof, "typeof")
+DEF(new, "new")
+DEF(in, "in")
+DEF(instanceof, "instanceof")
+DEF(do, "do")
+DEF(while, "while")
+DEF(for, "for")
+DEF(break, "break")
+DEF(continue, "continue")
+DEF(switch, "switch")
+DEF(case, "case")
+DEF(default, "default")
+DEF(throw, "throw")
+DEF(try, "try")
+DEF(catch, "catch")
+DEF(finally, "finally")
+DEF(function, "function")
+DEF(debugger, "debugger")
+DEF(with, "with")
+/* FutureReservedWord */
+DEF(class, "class")
+DEF(const, "const")
+DEF(enum, "enum")
+DEF(export, "export")
+DEF(extends, "extends")
+DEF(import, "import")
+DEF(super, "super")
+/* FutureReservedWords when parsing strict mode code */
+DEF(implements, "implements")
+DEF(interface, "interface")
+DEF(let, "let")
+DEF(package, "package")
+DEF(private, "private")
+DEF(protected, "protected")
+DEF(public, "public")
+DEF(static, "static")
+DEF(yield, "yield")
+DEF(await, "await")
+DEF(undefined, "undefined")
+DEF(empty_string, "")
+DEF(length, "length")
+DEF(message, "message")
+DEF(name, "name")
+DEF(fileName, "fileName")
+DEF(lineNumber, "lineNumber")
+DEF(prototype, "prototype")
+DEF(constructor, "constructor")
+DEF(toString, "toString")
+DEF(valueOf, "valueOf")
+DEF(hasOwnProperty, "hasOwnProperty")
+DEF(getPrototypeOf, "getPrototypeOf")
+DEF(globalThis, "globalThis")
+DEF(Object, "Object")
+DEF(Function, "Function")
+DEF(Error, "Error")
+/* native error names: must be in the JSErrorEnum order */
+DEF(RangeError, "RangeError")
+DEF(ReferenceError, "ReferenceError")
+DEF(SyntaxError, "SyntaxError")
+DEF(TypeError, "TypeError")
+DEF(InternalError, "InternalError")
+DEF(arguments, "arguments")
+DEF(get, "get")
+DEF(set, "set")
+DEF(target, "target")
+DEF(of, "of")
+DEF(value, "value")
+DEF(done, "done")
+DEF(eval, "eval")
+DEF(number, "number")
+DEF(string, "string")
+DEF(boolean, "boolean")
+DEF(object, "object")
+DEF(NaN, "NaN")
+DEF(Infinity, "Infinity")
+DEF(byteLength, "byteLength")
+DEF(byteOffset, "byteOffset")
+DEF(buffer, "buffer")
+DEF(BYTES_PER_ELEMENT, "BYTES_PER_ELEMENT")
+DEF(_ret_, "<ret>")
+
+#endif /* DEF */
@@ -26,6 +26,12 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <limits.h>
+#if !defined(_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
 
 #include "cutils.h"
 
@@ -166,6 +172,60 @@ int dbuf_putstr(DynBuf *s, const char *str)
     return dbuf_put(s, (const uint8_t *)str, strlen(str));
 }
 
+int dbuf_put_leb128(DynBuf *s, uint32_t v)
+{
+    uint32_t a;
+    for(;;) {
+        a = v & 0x7f;
+        v >>= 7;
+        if (v != 0) {
+            if (dbuf_putc(s, a | 0x80))
+                return -1;
+        } else {
+            return dbuf_putc(s, a);
+        }
+    }
+}
+
+int dbuf_put_sleb128(DynBuf *s, int32_t v1)
+{
+    uint32_t v = v1;
+    /* zigzag: the small negative values are short too */
+    return dbuf_put_leb128(s, (2 * v) ^ -(v >> 31));
+}
+
+int get_leb128(uint32_t *pval, const uint8_t *buf, const uint8_t *buf_end)
+{
+    const uint8_t *ptr = buf;
+    uint32_t v, a, i;
+    v = 0;
+    for(i = 0; i < 5; i++) {
+        if (unlikely(ptr >= buf_end))
+            break;
+        a = *ptr++;
+        v |= (a & 0x7f) << (i * 7);
+        if (!(a & 0x80)) {
+            *pval = v;
+            return ptr - buf;
+        }
+    }
+    *pval = 0;
+    return -1;
+}
+
+int get_sleb128(int32_t *pval, const uint8_t *buf, const uint8_t *buf_end)
+{
+    int ret;
+    uint32_t val;
+    ret = get_leb128(&val, buf, buf_end);
+    if (ret < 0) {
+        *pval = 0;
+        return -1;
+    }
+    *pval = (val >> 1) ^ -(val & 1);
+    return ret;
+}
+
 int __attribute__((format(printf, 2, 3))) dbuf_printf(DynBuf *s,
                                                       const char *fmt, ...)
 {
@@ -201,6 +261,256 @@ void dbuf_free(DynBuf *s)
     memset(s, 0, sizeof(*s));
 }
 
+/* Segmented dynamic buffer package */
+
+void sbuf_init2(SegBuf *s, void *opaque, DynBufReallocFunc *realloc_func)
+{
+    memset(s, 0, sizeof(*s));
+    if (!realloc_func)
+        realloc_func = dbuf_default_realloc;
+    s->opaque = opaque;
+    s->realloc_func = realloc_func;
+    s->chunk_size = SBUF_CHUNK_SIZE_MIN;
+    s->chunk_size_max = SBUF_CHUNK_SIZE_MAX;
+}
+
+void sbuf_init(SegBuf *s)
+{
+    sbuf_init2(s, NULL, NULL);
+}
+
+/* append a new chunk with at least 'len' bytes of payload. The chunk
+   size grows geometrically so that the number of chunks (hence of
+   iovec entries) stays logarithmic in the total size. */
+static SegBufChunk *sbuf_new_chunk(SegBuf *s, size_t len)
+{
+    SegBufChunk *c;
+    size_t size;
+
+    if (s->error)
+        return NULL;
+    size = s->chunk_size;
+    if (size < len)
+        size = len;
+    c = s->realloc_func(s->opaque, NULL, sizeof(SegBufChunk) + size);
+    if (!c) {
+        s->error = TRUE;
+        return NULL;
+    }
+    c->next = NULL;
+    c->size = 0;
+    c->allocated_size = size;
+    if (s->last)
+        s->last->next = c;
+    else
+        s->first = c;
+    s->last = c;
+    s->chunk_count++;
+    if (s->chunk_size < s->chunk_size_max)
+        s->chunk_size = min_int64(s->chunk_size * 2, s->chunk_size_max);
+    return c;
+}
+
+/* return a pointer to 'len' contiguous bytes appended to the buffer
+   or NULL if error. The bytes are uninitialized. */
+uint8_t *sbuf_reserve(SegBuf *s, size_t len)
+{
+    SegBufChunk *c;
+    uint8_t *ptr;
+
+    c = s->last;
+    if (unlikely(!c || c->size + len > c->allocated_size)) {
+        c = sbuf_new_chunk(s, len);
+        if (!c)
+            return NULL;
+    }
+    ptr = c->data + c->size;
+    c->size += len;
+    s->size += len;
+    return ptr;
+}
+
+int sbuf_put(SegBuf *s, const uint8_t *data, size_t len)
+{
+    SegBufChunk *c;
+    size_t l;
+
+    c = s->last;
+    if (c) {
+        /* fill the current chunk before allocating a new one */
+        l = c->allocated_size - c->size;
+        if (l > len)
+            l = len;
+        memcpy(c->data + c->size, data, l);
+        c->size += l;
+        s->size += l;
+        data += l;
+        len -= l;
+    }
+    if (len != 0) {
+        c = sbuf_new_chunk(s, len);
+        if (!c)
+            return -1;
+        memcpy(c->data, data, len);
+        c->size = len;
+        s->size += len;
+    }
+    return 0;
+}
+
+int sbuf_putc(SegBuf *s, uint8_t c)
+{
+    return sbuf_put(s, &c, 1);
+}
+
+int sbuf_putstr(SegBuf *s, const char *str)
+{
+    return sbuf_put(s, (const uint8_t *)str, strlen(str));
+}
+
+int __attribute__((format(printf, 2, 3))) sbuf_printf(SegBuf *s,
+                                                      const char *fmt, ...)
+{
+    va_list ap;
+    char buf[128];
+    uint8_t *ptr;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < sizeof(buf)) {
+        /* fast case */
+        return sbuf_put(s, (uint8_t *)buf, len);
+    } else {
+        /* the trailing '\0' is written in the reserved space and then
+           dropped */
+        ptr = sbuf_reserve(s, len + 1);
+        if (!ptr)
+            return -1;
+        va_start(ap, fmt);
+        vsnprintf((char *)ptr, len + 1, fmt, ap);
+        va_end(ap);
+        s->last->size--;
+        s->size--;
+    }
+    return 0;
+}
+
+/* append the content of 's' to 'd' */
+int sbuf_to_dbuf(SegBuf *s, DynBuf *d)
+{
+    SegBufChunk *c;
+
+    if (dbuf_realloc(d, d->size + s->size))
+        return -1;
+    for(c = s->first; c != NULL; c = c->next) {
+        if (c == s->first)
+            dbuf_put(d, c->data + s->head, c->size - s->head);
+        else
+            dbuf_put(d, c->data, c->size);
+    }
+    return 0;
+}
+
+void sbuf_free(SegBuf *s)
+{
+    SegBufChunk *c, *c1;
+
+    for(c = s->first; c != NULL; c = c1) {
+        c1 = c->next;
+        s->realloc_func(s->opaque, c, 0);
+    }
+    s->first = s->last = NULL;
+    s->size = 0;
+    s->head = 0;
+    s->chunk_count = 0;
+    s->chunk_size = SBUF_CHUNK_SIZE_MIN;
+    s->error = FALSE;
+}
+
+#if !defined(_WIN32)
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Fill at most 'iov_max' entries of 'iov' with the chunks of 's'. The
+   pointers stay valid until the buffer is freed. Return the number of
+   entries needed to describe the whole buffer. */
+int sbuf_to_iovec(SegBuf *s, struct iovec *iov, int iov_max)
+{
+    SegBufChunk *c;
+    size_t offset;
+    int n;
+
+    n = 0;
+    offset = s->head;
+    for(c = s->first; c != NULL; c = c->next) {
+        if (c->size > offset) {
+            if (n < iov_max) {
+                iov[n].iov_base = c->data + offset;
+                iov[n].iov_len = c->size - offset;
+            }
+            n++;
+        }
+        offset = 0;
+    }
+    return n;
+}
+
+/* remove the first 'len' bytes of the buffer */
+static void sbuf_consume(SegBuf *s, size_t len)
+{
+    SegBufChunk *c;
+
+    s->size -= len;
+    len += s->head;
+    while ((c = s->first) != NULL && len >= c->size && c != s->last) {
+        len -= c->size;
+        s->first = c->next;
+        s->chunk_count--;
+        s->realloc_func(s->opaque, c, 0);
+    }
+    /* the last chunk is kept for the next appends */
+    s->head = len;
+}
+
+/* Write the buffer to 'fd' with writev(). Partial writes and EINTR
+   are retried. The written bytes are removed from the buffer, so that
+   on error (e.g. EAGAIN on a non-blocking fd) the buffer holds exactly
+   the bytes which remain to be written. Return the number of bytes
+   written, or -1 if error before any byte was written (errno is
+   set). The buffer is empty when the returned count is the initial
+   size. */
+ssize_t sbuf_writev(SegBuf *s, int fd)
+{
+    struct iovec iov[64];
+    size_t total;
+    ssize_t ret;
+    int n;
+
+    total = 0;
+    while (s->size != 0) {
+        n = sbuf_to_iovec(s, iov, min_int(countof(iov), IOV_MAX));
+        ret = writev(fd, iov, min_int(n, min_int(countof(iov), IOV_MAX)));
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (total == 0)
+                return -1;
+            break;
+        }
+        sbuf_consume(s, ret);
+        total += ret;
+    }
+    if (s->size == 0)
+        sbuf_free(s);
+    return total;
+}
+
+#endif /* !_WIN32 */
+
 /* Note: at most 31 bits are encoded. At most UTF8_CHAR_LEN_MAX bytes
    are output. */
 int unicode_to_utf8(uint8_t *buf, unsigned int c)
@@ -303,6 +613,106 @@ int unicode_from_utf8(const uint8_t *p, int max_len, const uint8_t **pp)
     return c;
 }
 
+void utf8_decode_init(UTF8Decoder *s)
+{
+    s->c = 0;
+    s->needed = 0;
+    s->seen = 0;
+    s->lower = 0x80;
+    s->upper = 0xbf;
+}
+
+/* Decode the bytes from *psrc to src_end as UTF-16 code units stored
+   in dst. Decoding stops at the end of the input or when dst has less
+   than UTF8_DECODE16_MIN_DST free units. An incomplete sequence at the
+   end of the input is kept in the decoder state. *psrc is updated.
+   Return the number of code units written. */
+size_t utf8_decode16(UTF8Decoder *s, uint16_t *dst, size_t dst_size,
+                     const uint8_t **psrc, const uint8_t *src_end)
+{
+    const uint8_t *p;
+    uint16_t *q, *q_end;
+    uint32_t b, c;
+
+    if (dst_size < UTF8_DECODE16_MIN_DST)
+        return 0;
+    p = *psrc;
+    q = dst;
+    q_end = dst + dst_size - (UTF8_DECODE16_MIN_DST - 1);
+    while (p < src_end && q < q_end) {
+        b = *p;
+        if (s->needed == 0) {
+            if (b < 0x80) {
+                /* ASCII fast path */
+                do {
+                    *q++ = b;
+                    p++;
+                } while (p < src_end && q < q_end && (b = *p) < 0x80);
+                continue;
+            }
+            p++;
+            if (b >= 0xc2 && b <= 0xdf) {
+                s->needed = 1;
+                s->c = b & 0x1f;
+            } else if (b >= 0xe0 && b <= 0xef) {
+                /* no overlong forms and no surrogates */
+                if (b == 0xe0)
+                    s->lower = 0xa0;
+                else if (b == 0xed)
+                    s->upper = 0x9f;
+                s->needed = 2;
+                s->c = b & 0xf;
+            } else if (b >= 0xf0 && b <= 0xf4) {
+                /* no overlong forms and nothing above 0x10ffff */
+                if (b == 0xf0)
+                    s->lower = 0x90;
+                else if (b == 0xf4)
+                    s->upper = 0x8f;
+                s->needed = 3;
+                s->c = b & 0x7;
+            } else {
+                *q++ = 0xfffd;
+            }
+        } else {
+            if (b < s->lower || b > s->upper) {
+                /* the byte is decoded again as the start of a sequence */
+                utf8_decode_init(s);
+                *q++ = 0xfffd;
+                continue;
+            }
+            p++;
+            s->lower = 0x80;
+            s->upper = 0xbf;
+            s->c = (s->c << 6) | (b & 0x3f);
+            if (++s->seen == s->needed) {
+                c = s->c;
+                if (c >= 0x10000) {
+                    /* surrogate pair */
+                    c -= 0x10000;
+                    *q++ = (c >> 10) + 0xd800;
+                    *q++ = (c & 0x3ff) + 0xdc00;
+                } else {
+                    *q++ = c;
+                }
+                utf8_decode_init(s);
+            }
+        }
+    }
+    *psrc = p;
+    return q - dst;
+}
+
+/* Signal the end of the input. Return the number of code units (0 or
+   1) stored in dst for a truncated sequence. */
+size_t utf8_decode16_end(UTF8Decoder *s, uint16_t *dst)
+{
+    if (s->needed == 0)
+        return 0;
+    utf8_decode_init(s);
+    dst[0] = 0xfffd;
+    return 1;
+}
+
 #if 0
 
 #if defined(EMSCRIPTEN) || defined(__ANDROID__)
@@ -629,3 +1039,598 @@ void rqsort(void *base, size_t nmemb, size_t size, cmp_f cmp, void *opaque)
 }
 
 #endif
+
+/* Stable sort: natural merge sort with galloping (Tim Peters'
+   listsort). Runs already in order are detected, short runs are
+   extended with a binary insertion sort and the runs are merged with
+   a temporary buffer of at most nmemb / 2 elements. */
+
+#define TIMSORT_MIN_MERGE  32
+#define TIMSORT_MIN_GALLOP 7
+#define TIMSORT_MAX_RUNS   85 /* enough for 2^64 elements */
+
+typedef struct TimSortState {
+    uint8_t *base;
+    size_t size;
+    cmp_f cmp;
+    void *opaque;
+    uint8_t *tmp; /* room for nmemb / 2 + 1 elements */
+    int64_t min_gallop;
+    int n_runs;
+    int64_t run_base[TIMSORT_MAX_RUNS];
+    int64_t run_len[TIMSORT_MAX_RUNS];
+} TimSortState;
+
+static inline void ts_copy1(void *dst, const void *src, size_t size)
+{
+    /* constant sizes for the common element types */
+    if (size == 8)
+        memcpy(dst, src, 8);
+    else if (size == 16)
+        memcpy(dst, src, 16);
+    else if (size == 4)
+        memcpy(dst, src, 4);
+    else
+        memcpy(dst, src, size);
+}
+
+#define TS_ELT(p, i) ((p) + (i) * (int64_t)s->size)
+
+static void ts_reverse(TimSortState *s, uint8_t *lo, size_t n)
+{
+    exchange_f swap = exchange_func(lo, s->size);
+    uint8_t *hi = lo + (n - 1) * s->size;
+
+    while (lo < hi) {
+        swap(lo, hi, s->size);
+        lo += s->size;
+        hi -= s->size;
+    }
+}
+
+/* length of the run starting at 'lo'. Strictly descending runs are
+   reversed in place (strictly so that stability is preserved). */
+static size_t ts_count_run(TimSortState *s, uint8_t *lo, size_t n)
+{
+    size_t run;
+
+    if (n < 2)
+        return n;
+    run = 2;
+    if (s->cmp(TS_ELT(lo, 1), lo, s->opaque) < 0) {
+        while (run < n &&
+               s->cmp(TS_ELT(lo, run), TS_ELT(lo, run - 1), s->opaque) < 0)
+            run++;
+        ts_reverse(s, lo, run);
+    } else {
+        while (run < n &&
+               s->cmp(TS_ELT(lo, run), TS_ELT(lo, run - 1), s->opaque) >= 0)
+            run++;
+    }
+    return run;
+}
+
+/* sort lo[0..n[ knowing that lo[0..start[ is sorted */
+static void ts_binary_insertion_sort(TimSortState *s, uint8_t *lo, size_t n,
+                                     size_t start, uint8_t *pivot)
+{
+    size_t i, l, r, m;
+
+    for(i = start; i < n; i++) {
+        ts_copy1(pivot, TS_ELT(lo, i), s->size);
+        l = 0;
+        r = i;
+        /* insert after the equal elements */
+        while (l < r) {
+            m = (l + r) >> 1;
+            if (s->cmp(pivot, TS_ELT(lo, m), s->opaque) < 0)
+                r = m;
+            else
+                l = m + 1;
+        }
+        if (l < i) {
+            memmove(TS_ELT(lo, l + 1), TS_ELT(lo, l), (i - l) * s->size);
+            ts_copy1(TS_ELT(lo, l), pivot, s->size);
+        }
+    }
+}
+
+static size_t ts_min_run(size_t n)
+{
+    size_t r = 0;
+    while (n >= TIMSORT_MIN_MERGE) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+/* position of 'key' in the sorted array a[0..len[ before the equal
+   elements, starting the search at 'hint' */
+static int64_t ts_gallop_left(TimSortState *s, const uint8_t *key,
+                              const uint8_t *a, int64_t len, int64_t hint)
+{
+    int64_t last_ofs, ofs, max_ofs, m, t;
+
+    last_ofs = 0;
+    ofs = 1;
+    if (s->cmp(key, TS_ELT(a, hint), s->opaque) > 0) {
+        /* a[hint + last_ofs] < key <= a[hint + ofs] */
+        max_ofs = len - hint;
+        while (ofs < max_ofs &&
+               s->cmp(key, TS_ELT(a, hint + ofs), s->opaque) > 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs)
+            ofs = max_ofs;
+        last_ofs += hint;
+        ofs += hint;
+    } else {
+        /* a[hint - ofs] < key <= a[hint - last_ofs] */
+        max_ofs = hint + 1;
+        while (ofs < max_ofs &&
+               s->cmp(key, TS_ELT(a, hint - ofs), s->opaque) <= 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs)
+            ofs = max_ofs;
+        t = last_ofs;
+        last_ofs = hint - ofs;
+        ofs = hint - t;
+    }
+    last_ofs++;
+    while (last_ofs < ofs) {
+        m = last_ofs + ((ofs - last_ofs) >> 1);
+        if (s->cmp(key, TS_ELT(a, m), s->opaque) > 0)
+            last_ofs = m + 1;
+        else
+            ofs = m;
+    }
+    return ofs;
+}
+
+/* position of 'key' in the sorted array a[0..len[ after the equal
+   elements, starting the search at 'hint' */
+static int64_t ts_gallop_right(TimSortState *s, const uint8_t *key,
+                               const uint8_t *a, int64_t len, int64_t hint)
+{
+    int64_t last_ofs, ofs, max_ofs, m, t;
+
+    last_ofs = 0;
+    ofs = 1;
+    if (s->cmp(key, TS_ELT(a, hint), s->opaque) < 0) {
+        /* a[hint - ofs] <= key < a[hint - last_ofs] */
+        max_ofs = hint + 1;
+        while (ofs < max_ofs &&
+               s->cmp(key, TS_ELT(a, hint - ofs), s->opaque) < 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs)
+            ofs = max_ofs;
+        t = last_ofs;
+        last_ofs = hint - ofs;
+        ofs = hint - t;
+    } else {
+        /* a[hint + last_ofs] <= key < a[hint + ofs] */
+        max_ofs = len - hint;
+        while (ofs < max_ofs &&
+               s->cmp(key, TS_ELT(a, hint + ofs), s->opaque) >= 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs)
+            ofs = max_ofs;
+        last_ofs += hint;
+        ofs += hint;
+    }
+    last_ofs++;
+    while (last_ofs < ofs) {
+        m = last_ofs + ((ofs - last_ofs) >> 1);
+        if (s->cmp(key, TS_ELT(a, m), s->opaque) < 0)
+            ofs = m;
+        else
+            last_ofs = m + 1;
+    }
+    return ofs;
+}
+
+/* merge the adjacent runs a[base1..] and a[base2..] with len1 <= len2
+   from the left, the first run being moved to the temporary buffer */
+static void ts_merge_lo(TimSortState *s, int64_t base1, int64_t len1,
+                        int64_t base2, int64_t len2)
+{
+    uint8_t *a = s->base, *tmp = s->tmp;
+    int64_t cursor1, cursor2, dest, count1, count2, min_gallop;
+    size_t size = s->size;
+
+    memcpy(tmp, TS_ELT(a, base1), len1 * size);
+    cursor1 = 0;
+    cursor2 = base2;
+    dest = base1;
+    ts_copy1(TS_ELT(a, dest++), TS_ELT(a, cursor2++), size);
+    if (--len2 == 0) {
+        memcpy(TS_ELT(a, dest), TS_ELT(tmp, cursor1), len1 * size);
+        return;
+    }
+    if (len1 == 1) {
+        memmove(TS_ELT(a, dest), TS_ELT(a, cursor2), len2 * size);
+        ts_copy1(TS_ELT(a, dest + len2), TS_ELT(tmp, cursor1), size);
+        return;
+    }
+    min_gallop = s->min_gallop;
+    for(;;) {
+        count1 = 0;
+        count2 = 0;
+        /* one pair at a time until a run wins consistently */
+        do {
+            if (s->cmp(TS_ELT(a, cursor2), TS_ELT(tmp, cursor1), s->opaque) < 0) {
+                ts_copy1(TS_ELT(a, dest++), TS_ELT(a, cursor2++), size);
+                count2++;
+                count1 = 0;
+                if (--len2 == 0)
+                    goto done;
+            } else {
+                ts_copy1(TS_ELT(a, dest++), TS_ELT(tmp, cursor1++), size);
+                count1++;
+                count2 = 0;
+                if (--len1 == 1)
+                    goto done;
+            }
+        } while ((count1 | count2) < min_gallop);
+
+        /* galloping mode */
+        do {
+            count1 = ts_gallop_right(s, TS_ELT(a, cursor2),
+                                     TS_ELT(tmp, cursor1), len1, 0);
+            if (count1 != 0) {
+                memcpy(TS_ELT(a, dest), TS_ELT(tmp, cursor1), count1 * size);
+                dest += count1;
+                cursor1 += count1;
+                len1 -= count1;
+                if (len1 <= 1)
+                    goto done;
+            }
+            ts_copy1(TS_ELT(a, dest++), TS_ELT(a, cursor2++), size);
+            if (--len2 == 0)
+                goto done;
+            count2 = ts_gallop_left(s, TS_ELT(tmp, cursor1),
+                                    TS_ELT(a, cursor2), len2, 0);
+            if (count2 != 0) {
+                memmove(TS_ELT(a, dest), TS_ELT(a, cursor2), count2 * size);
+                dest += count2;
+                cursor2 += count2;
+                len2 -= count2;
+                if (len2 == 0)
+                    goto done;
+            }
+            ts_copy1(TS_ELT(a, dest++), TS_ELT(tmp, cursor1++), size);
+            if (--len1 == 1)
+                goto done;
+            min_gallop--;
+        } while (count1 >= TIMSORT_MIN_GALLOP || count2 >= TIMSORT_MIN_GALLOP);
+        if (min_gallop < 0)
+            min_gallop = 0;
+        min_gallop += 2;
+    }
+ done:
+    s->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+    if (len1 == 1) {
+        memmove(TS_ELT(a, dest), TS_ELT(a, cursor2), len2 * size);
+        ts_copy1(TS_ELT(a, dest + len2), TS_ELT(tmp, cursor1), size);
+    } else if (len1 > 0) {
+        /* len1 == 0 only happens with an inconsistent comparison
+           function */
+        memcpy(TS_ELT(a, dest), TS_ELT(tmp, cursor1), len1 * size);
+    }
+}
+
+/* merge the adjacent runs a[base1..] and a[base2..] with len1 > len2
+   from the right, the second run being moved to the temporary buffer */
+static void ts_merge_hi(TimSortState *s, int64_t base1, int64_t len1,
+                        int64_t base2, int64_t len2)
+{
+    uint8_t *a = s->base, *tmp = s->tmp;
+    int64_t cursor1, cursor2, dest, count1, count2, min_gallop;
+    size_t size = s->size;
+
+    memcpy(tmp, TS_ELT(a, base2), len2 * size);
+    cursor1 = base1 + len1 - 1;
+    cursor2 = len2 - 1;
+    dest = base2 + len2 - 1;
+    ts_copy1(TS_ELT(a, dest--), TS_ELT(a, cursor1--), size);
+    if (--len1 == 0) {
+        memcpy(TS_ELT(a, dest - (len2 - 1)), tmp, len2 * size);
+        return;
+    }
+    if (len2 == 1) {
+        dest -= len1;
+        cursor1 -= len1;
+        memmove(TS_ELT(a, dest + 1), TS_ELT(a, cursor1 + 1), len1 * size);
+        ts_copy1(TS_ELT(a, dest), TS_ELT(tmp, cursor2), size);
+        return;
+    }
+    min_gallop = s->min_gallop;
+    for(;;) {
+        count1 = 0;
+        count2 = 0;
+        do {
+            if (s->cmp(TS_ELT(tmp, cursor2), TS_ELT(a, cursor1), s->opaque) < 0) {
+                ts_copy1(TS_ELT(a, dest--), TS_ELT(a, cursor1--), size);
+                count1++;
+                count2 = 0;
+                if (--len1 == 0)
+                    goto done;
+            } else {
+                ts_copy1(TS_ELT(a, dest--), TS_ELT(tmp, cursor2--), size);
+                count2++;
+                count1 = 0;
+                if (--len2 == 1)
+                    goto done;
+            }
+        } while ((count1 | count2) < min_gallop);
+
+        do {
+            count1 = len1 - ts_gallop_right(s, TS_ELT(tmp, cursor2),
+                                            TS_ELT(a, base1), len1, len1 - 1);
+            if (count1 != 0) {
+                dest -= count1;
+                cursor1 -= count1;
+                len1 -= count1;
+                memmove(TS_ELT(a, dest + 1), TS_ELT(a, cursor1 + 1),
+                        count1 * size);
+                if (len1 == 0)
+                    goto done;
+            }
+            ts_copy1(TS_ELT(a, dest--), TS_ELT(tmp, cursor2--), size);
+            if (--len2 == 1)
+                goto done;
+            count2 = len2 - ts_gallop_left(s, TS_ELT(a, cursor1), tmp,
+                                           len2, len2 - 1);
+            if (count2 != 0) {
+                dest -= count2;
+                cursor2 -= count2;
+                len2 -= count2;
+                memcpy(TS_ELT(a, dest + 1), TS_ELT(tmp, cursor2 + 1),
+                       count2 * size);
+                if (len2 <= 1)
+                    goto done;
+            }
+            ts_copy1(TS_ELT(a, dest--), TS_ELT(a, cursor1--), size);
+            if (--len1 == 0)
+                goto done;
+            min_gallop--;
+        } while (count1 >= TIMSORT_MIN_GALLOP || count2 >= TIMSORT_MIN_GALLOP);
+        if (min_gallop < 0)
+            min_gallop = 0;
+        min_gallop += 2;
+    }
+ done:
+    s->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+    if (len2 == 1) {
+        dest -= len1;
+        cursor1 -= len1;
+        memmove(TS_ELT(a, dest + 1), TS_ELT(a, cursor1 + 1), len1 * size);
+        ts_copy1(TS_ELT(a, dest), TS_ELT(tmp, cursor2), size);
+    } else if (len2 > 0) {
+        memcpy(TS_ELT(a, dest - (len2 - 1)), tmp, len2 * size);
+    }
+}
+
+/* merge the runs i and i + 1 of the stack */
+static void ts_merge_at(TimSortState *s, int i)
+{
+    int64_t base1, len1, base2, len2, k;
+
+    base1 = s->run_base[i];
+    len1 = s->run_len[i];
+    base2 = s->run_base[i + 1];
+    len2 = s->run_len[i + 1];
+    s->run_len[i] = len1 + len2;
+    if (i == s->n_runs - 3) {
+        s->run_base[i + 1] = s->run_base[i + 2];
+        s->run_len[i + 1] = s->run_len[i + 2];
+    }
+    s->n_runs--;
+
+    /* elements of run1 already in place */
+    k = ts_gallop_right(s, TS_ELT(s->base, base2), TS_ELT(s->base, base1),
+                        len1, 0);
+    base1 += k;
+    len1 -= k;
+    if (len1 == 0)
+        return;
+    /* elements of run2 already in place */
+    len2 = ts_gallop_left(s, TS_ELT(s->base, base1 + len1 - 1),
+                          TS_ELT(s->base, base2), len2, len2 - 1);
+    if (len2 == 0)
+        return;
+    if (len1 <= len2)
+        ts_merge_lo(s, base1, len1, base2, len2);
+    else
+        ts_merge_hi(s, base1, len1, base2, len2);
+}
+
+/* keep run lengths decreasing faster than the Fibonacci sequence */
+static void ts_merge_collapse(TimSortState *s)
+{
+    int64_t *len = s->run_len;
+    int n;
+
+    while (s->n_runs > 1) {
+        n = s->n_runs - 2;
+        if ((n > 0 && len[n - 1] <= len[n] + len[n + 1]) ||
+            (n > 1 && len[n - 2] <= len[n] + len[n - 1])) {
+            if (len[n - 1] < len[n + 1])
+                n--;
+        } else if (len[n] > len[n + 1]) {
+            break;
+        }
+        ts_merge_at(s, n);
+    }
+}
+
+static void ts_merge_force_collapse(TimSortState *s)
+{
+    int n;
+
+    while (s->n_runs > 1) {
+        n = s->n_runs - 2;
+        if (n > 0 && s->run_len[n - 1] < s->run_len[n + 1])
+            n--;
+        ts_merge_at(s, n);
+    }
+}
+
+/* Return -1 if the temporary buffer cannot be allocated (the array is
+   then left unchanged). */
+int rqsort_stable(void *base, size_t nmemb, size_t size, cmp_f cmp, void *opaque)
+{
+    TimSortState s_s, *s = &s_s;
+    uint8_t pivot_buf[64];
+    uint8_t *lo;
+    size_t remaining, min_run, run, force;
+
+    if (nmemb < 2 || size <= 0)
+        return 0;
+    s->base = base;
+    s->size = size;
+    s->cmp = cmp;
+    s->opaque = opaque;
+    s->n_runs = 0;
+    s->min_gallop = TIMSORT_MIN_GALLOP;
+
+    if (nmemb < TIMSORT_MIN_MERGE && size <= sizeof(pivot_buf)) {
+        /* small arrays: no allocation */
+        run = ts_count_run(s, base, nmemb);
+        ts_binary_insertion_sort(s, base, nmemb, run, pivot_buf);
+        return 0;
+    }
+    s->tmp = malloc((nmemb / 2 + 1) * size);
+    if (!s->tmp)
+        return -1;
+
+    lo = base;
+    remaining = nmemb;
+    min_run = ts_min_run(nmemb);
+    do {
+        run = ts_count_run(s, lo, remaining);
+        if (run < min_run) {
+            force = remaining <= min_run ? remaining : min_run;
+            ts_binary_insertion_sort(s, lo, force, run, s->tmp);
+            run = force;
+        }
+        s->run_base[s->n_runs] = (lo - s->base) / size;
+        s->run_len[s->n_runs] = run;
+        s->n_runs++;
+        ts_merge_collapse(s);
+        lo += run * size;
+        remaining -= run;
+    } while (remaining != 0);
+    ts_merge_force_collapse(s);
+    free(s->tmp);
+    return 0;
+}
+
+#undef TS_ELT
+
+/* Radix sorts for typed keys: stable LSD radix sort on 8 bit digits.
+   The key function maps the elements to unsigned integers in the same
+   order. Already sorted input is detected while building the
+   histograms and passes where all the elements have the same digit
+   are skipped. */
+
+#define RADIX_SORT_SMALL 64
+
+#define DEF_RADIX_SORT(name, type, key_type, get_key)                  \
+int name(type *tab, size_t n)                                          \
+{                                                                      \
+    size_t count[sizeof(key_type)][256];                               \
+    type *src, *dst, *tmp, v;                                          \
+    key_type k, k1;                                                    \
+    size_t i, j, pos, c;                                               \
+    int d, shift;                                                      \
+    BOOL sorted;                                                       \
+                                                                       \
+    if (n < RADIX_SORT_SMALL) {                                        \
+        /* insertion sort */                                           \
+        for(i = 1; i < n; i++) {                                       \
+            v = tab[i];                                                \
+            k = get_key(v);                                            \
+            for(j = i; j > 0 && (k1 = get_key(tab[j - 1]), k1 > k); j--) \
+                tab[j] = tab[j - 1];                                   \
+            tab[j] = v;                                                \
+        }                                                              \
+        return 0;                                                      \
+    }                                                                  \
+    memset(count, 0, sizeof(count));                                   \
+    k1 = 0;                                                            \
+    sorted = TRUE;                                                     \
+    for(i = 0; i < n; i++) {                                           \
+        k = get_key(tab[i]);                                           \
+        sorted &= (k >= k1);                                           \
+        k1 = k;                                                        \
+        for(d = 0; d < (int)sizeof(key_type); d++)                     \
+            count[d][(k >> (d * 8)) & 0xff]++;                         \
+    }                                                                  \
+    if (sorted)                                                        \
+        return 0;                                                      \
+    tmp = malloc(n * sizeof(type));                                    \
+    if (!tmp)                                                          \
+        return -1;                                                     \
+    src = tab;                                                         \
+    dst = tmp;                                                         \
+    for(d = 0; d < (int)sizeof(key_type); d++) {                       \
+        shift = d * 8;                                                 \
+        k = get_key(src[0]);                                           \
+        if (count[d][(k >> shift) & 0xff] == n)                        \
+            continue;                                                  \
+        pos = 0;                                                       \
+        for(j = 0; j < 256; j++) {                                     \
+            c = count[d][j];                                           \
+            count[d][j] = pos;                                         \
+            pos += c;                                                  \
+        }                                                              \
+        for(i = 0; i < n; i++) {                                       \
+            v = src[i];                                                \
+            k = get_key(v);                                            \
+            dst[count[d][(k >> shift) & 0xff]++] = v;                  \
+        }                                                              \
+        tmp = src;                                                     \
+        src = dst;                                                     \
+        dst = tmp;                                                     \
+    }                                                                  \
+    if (src != tab) {                                                  \
+        memcpy(tab, src, n * sizeof(type));                            \
+        free(src);                                                     \
+    } else {                                                           \
+        free(dst);                                                     \
+    }                                                                  \
+    return 0;                                                          \
+}
+
+#define RADIX_KEY_U32(v) ((uint32_t)(v))
+#define RADIX_KEY_I32(v) ((uint32_t)(v) ^ 0x80000000)
+
+/* total order with -0 < +0 and NaN after +Infinity, as required by
+   the TypedArray sort */
+static inline uint64_t radix_key_f64(double d)
+{
+    union {
+        double d;
+        uint64_t u;
+    } u;
+    u.d = d;
+    if (d != d)
+        return UINT64_MAX;
+    if (u.u >> 63)
+        return ~u.u;
+    else
+        return u.u | ((uint64_t)1 << 63);
+}
+
+DEF_RADIX_SORT(radix_sort_u32, uint32_t, uint32_t, RADIX_KEY_U32)
+DEF_RADIX_SORT(radix_sort_i32, int32_t, uint32_t, RADIX_KEY_I32)
+DEF_RADIX_SORT(radix_sort_f64, double, uint64_t, radix_key_f64)
@@ -27,6 +27,9 @@
 
 #include <stdlib.h>
 #include <inttypes.h>
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
 
 /* set if CPU is big endian */
 #undef WORDS_BIGENDIAN
@@ -36,6 +39,7 @@
 #define force_inline inline __attribute__((always_inline))
 #define no_inline __attribute__((noinline))
 #define __maybe_unused __attribute__((unused))
+#define __exception __attribute__((warn_unused_result))
 
 #define xglue(x, y) x ## y
 #define glue(x, y) xglue(x, y)
@@ -262,6 +266,9 @@ static inline int dbuf_put_u64(DynBuf *s, uint64_t val)
 {
     return dbuf_put(s, (uint8_t *)&val, 8);
 }
+/* LEB128: 7 bits per byte, the low bits first */
+int dbuf_put_leb128(DynBuf *s, uint32_t v);
+int dbuf_put_sleb128(DynBuf *s, int32_t v);
 int __attribute__((format(printf, 2, 3))) dbuf_printf(DynBuf *s,
                                                       const char *fmt, ...);
 void dbuf_free(DynBuf *s);
@@ -273,11 +280,101 @@ static inline void dbuf_set_error(DynBuf *s)
     s->error = TRUE;
 }
 
+/* return the number of bytes read or -1 if the value is truncated or
+   longer than 5 bytes */
+int get_leb128(uint32_t *pval, const uint8_t *buf, const uint8_t *buf_end);
+int get_sleb128(int32_t *pval, const uint8_t *buf, const uint8_t *buf_end);
+
+/* Segmented dynamic buffer: same interface as DynBuf, but the data is
+   stored in a list of chunks which are never moved once allocated, so
+   appending never copies what was already written. */
+typedef struct SegBufChunk {
+    struct SegBufChunk *next;
+    size_t size; /* number of used bytes in data[] */
+    size_t allocated_size;
+    uint8_t data[0];
+} SegBufChunk;
+
+typedef struct SegBuf {
+    SegBufChunk *first;
+    SegBufChunk *last;
+    size_t size; /* total number of bytes in all the chunks */
+    size_t head; /* bytes of the first chunk already written out */
+    int chunk_count;
+    size_t chunk_size; /* minimum payload size of the next chunk */
+    size_t chunk_size_max;
+    BOOL error; /* true if a memory allocation error occurred */
+    DynBufReallocFunc *realloc_func;
+    void *opaque; /* for realloc_func */
+} SegBuf;
+
+#define SBUF_CHUNK_SIZE_MIN 4096
+#define SBUF_CHUNK_SIZE_MAX (1 << 20)
+
+void sbuf_init(SegBuf *s);
+void sbuf_init2(SegBuf *s, void *opaque, DynBufReallocFunc *realloc_func);
+uint8_t *sbuf_reserve(SegBuf *s, size_t len);
+int sbuf_put(SegBuf *s, const uint8_t *data, size_t len);
+int sbuf_putc(SegBuf *s, uint8_t c);
+int sbuf_putstr(SegBuf *s, const char *str);
+static inline int sbuf_put_u16(SegBuf *s, uint16_t val)
+{
+    return sbuf_put(s, (uint8_t *)&val, 2);
+}
+static inline int sbuf_put_u32(SegBuf *s, uint32_t val)
+{
+    return sbuf_put(s, (uint8_t *)&val, 4);
+}
+static inline int sbuf_put_u64(SegBuf *s, uint64_t val)
+{
+    return sbuf_put(s, (uint8_t *)&val, 8);
+}
+int __attribute__((format(printf, 2, 3))) sbuf_printf(SegBuf *s,
+                                                      const char *fmt, ...);
+int sbuf_to_dbuf(SegBuf *s, DynBuf *d);
+void sbuf_free(SegBuf *s);
+static inline BOOL sbuf_error(SegBuf *s) {
+    return s->error;
+}
+static inline void sbuf_set_error(SegBuf *s)
+{
+    s->error = TRUE;
+}
+
+#if !defined(_WIN32)
+struct iovec;
+int sbuf_to_iovec(SegBuf *s, struct iovec *iov, int iov_max);
+ssize_t sbuf_writev(SegBuf *s, int fd);
+#endif
+
 #define UTF8_CHAR_LEN_MAX 6
 
 int unicode_to_utf8(uint8_t *buf, unsigned int c);
 int unicode_from_utf8(const uint8_t *p, int max_len, const uint8_t **pp);
 
+/* Incremental UTF-8 decoder. The input can be split at any byte, a
+   multi-byte sequence being completed by the next chunk. Invalid
+   sequences are replaced by U+FFFD as in the WHATWG encoding spec. */
+typedef struct UTF8Decoder {
+    uint32_t c; /* partially decoded code point */
+    uint8_t needed; /* number of continuation bytes of the sequence */
+    uint8_t seen; /* number of continuation bytes already received */
+    uint8_t lower, upper; /* range of the next continuation byte */
+} UTF8Decoder;
+
+/* a code point needs at most 2 UTF-16 code units and an invalid byte
+   may produce U+FFFD before being decoded */
+#define UTF8_DECODE16_MIN_DST 3
+
+void utf8_decode_init(UTF8Decoder *s);
+static inline BOOL utf8_decode_pending(const UTF8Decoder *s)
+{
+    return s->needed != 0;
+}
+size_t utf8_decode16(UTF8Decoder *s, uint16_t *dst, size_t dst_size,
+                     const uint8_t **psrc, const uint8_t *src_end);
+size_t utf8_decode16_end(UTF8Decoder *s, uint16_t *dst);
+
 static inline int from_hex(int c)
 {
     if (c >= '0' && c <= '9')
@@ -293,5 +390,15 @@ static inline int from_hex(int c)
 void rqsort(void *base, size_t nmemb, size_t size,
             int (*cmp)(const void *, const void *, void *),
             void *arg);
+/* stable sort, fast on partially ordered input. Return -1 if memory
+   allocation failed (the array is then unchanged) */
+int rqsort_stable(void *base, size_t nmemb, size_t size,
+                  int (*cmp)(const void *, const void *, void *),
+                  void *arg);
+/* ascending order. For doubles: -0 < +0 and NaNs are sorted last.
+   Return -1 if memory allocation failed. */
+int radix_sort_u32(uint32_t *tab, size_t n);
+int radix_sort_i32(int32_t *tab, size_t n);
+int radix_sort_f64(double *tab, size_t n);
 
 #endif  /* CUTILS_H */
@@ -0,0 +1,1040 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "dtoa.h"
+
+/* Integer formatting */
+
+static const char digits_lut[200] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+/* write exactly 8 digits of n < 10^8 */
+static void u32toa_8(char *buf, uint32_t n)
+{
+    uint32_t hi, lo;
+    hi = n / 10000;
+    lo = n % 10000;
+    memcpy(buf, digits_lut + 2 * (hi / 100), 2);
+    memcpy(buf + 2, digits_lut + 2 * (hi % 100), 2);
+    memcpy(buf + 4, digits_lut + 2 * (lo / 100), 2);
+    memcpy(buf + 6, digits_lut + 2 * (lo % 100), 2);
+}
+
+size_t u32toa(char *buf, uint32_t n)
+{
+    char tmp[10], *q;
+    size_t len;
+
+    q = tmp + sizeof(tmp);
+    while (n >= 100) {
+        q -= 2;
+        memcpy(q, digits_lut + 2 * (n % 100), 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        q -= 2;
+        memcpy(q, digits_lut + 2 * n, 2);
+    } else {
+        *--q = '0' + n;
+    }
+    len = tmp + sizeof(tmp) - q;
+    memcpy(buf, q, len);
+    buf[len] = '\0';
+    return len;
+}
+
+size_t i32toa(char *buf, int32_t n)
+{
+    if (n >= 0)
+        return u32toa(buf, n);
+    buf[0] = '-';
+    return 1 + u32toa(buf + 1, -(uint32_t)n);
+}
+
+size_t u64toa(char *buf, uint64_t n)
+{
+    size_t len;
+
+    if (n <= UINT32_MAX)
+        return u32toa(buf, n);
+    /* at most 20 digits: split in groups of 8 digits to stay in
+       32 bit arithmetic */
+    len = u64toa(buf, n / 100000000);
+    u32toa_8(buf + len, n % 100000000);
+    len += 8;
+    buf[len] = '\0';
+    return len;
+}
+
+size_t i64toa(char *buf, int64_t n)
+{
+    if (n >= 0)
+        return u64toa(buf, n);
+    buf[0] = '-';
+    return 1 + u64toa(buf + 1, -(uint64_t)n);
+}
+
+/* Small fixed size big integers for the exact slow paths */
+
+/* enough for the 800 significant digits of js_strtod() scaled by the
+   smallest exponent */
+#define BIGNUM_LIMBS 132
+
+typedef struct Bignum {
+    int len; /* number of used limbs, tab[len - 1] != 0 */
+    uint32_t tab[BIGNUM_LIMBS];
+} Bignum;
+
+static void bn_set_u64(Bignum *a, uint64_t v)
+{
+    a->len = 0;
+    while (v != 0) {
+        a->tab[a->len++] = (uint32_t)v;
+        v >>= 32;
+    }
+}
+
+static int bn_bitlen(const Bignum *a)
+{
+    if (a->len == 0)
+        return 0;
+    return a->len * 32 - clz32(a->tab[a->len - 1]);
+}
+
+static BOOL bn_is_zero(const Bignum *a)
+{
+    return a->len == 0;
+}
+
+/* a = a * m + c */
+static void bn_muladd_small(Bignum *a, uint32_t m, uint32_t c)
+{
+    uint64_t carry;
+    int i;
+
+    carry = c;
+    for(i = 0; i < a->len; i++) {
+        carry += (uint64_t)a->tab[i] * m;
+        a->tab[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry != 0) {
+        assert(a->len < BIGNUM_LIMBS);
+        a->tab[a->len++] = (uint32_t)carry;
+    }
+}
+
+static const uint32_t pow10_u32[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000,
+};
+
+static void bn_mul_pow10(Bignum *a, int n)
+{
+    while (n >= 9) {
+        bn_muladd_small(a, pow10_u32[9], 0);
+        n -= 9;
+    }
+    if (n > 0)
+        bn_muladd_small(a, pow10_u32[n], 0);
+}
+
+static void bn_shl(Bignum *a, int n)
+{
+    int i, w, b;
+
+    if (a->len == 0 || n == 0)
+        return;
+    w = n / 32;
+    b = n % 32;
+    assert(a->len + w + 1 <= BIGNUM_LIMBS);
+    if (b == 0) {
+        a->tab[a->len + w] = 0;
+        for(i = a->len - 1; i >= 0; i--)
+            a->tab[i + w] = a->tab[i];
+    } else {
+        a->tab[a->len + w] = a->tab[a->len - 1] >> (32 - b);
+        for(i = a->len - 1; i > 0; i--)
+            a->tab[i + w] = (a->tab[i] << b) | (a->tab[i - 1] >> (32 - b));
+        a->tab[w] = a->tab[0] << b;
+    }
+    for(i = 0; i < w; i++)
+        a->tab[i] = 0;
+    a->len += w + 1;
+    while (a->len > 0 && a->tab[a->len - 1] == 0)
+        a->len--;
+}
+
+static void bn_shr1(Bignum *a)
+{
+    int i;
+
+    for(i = 0; i < a->len - 1; i++)
+        a->tab[i] = (a->tab[i] >> 1) | (a->tab[i + 1] << 31);
+    if (a->len > 0) {
+        a->tab[a->len - 1] >>= 1;
+        if (a->tab[a->len - 1] == 0)
+            a->len--;
+    }
+}
+
+static int bn_cmp(const Bignum *a, const Bignum *b)
+{
+    int i;
+
+    if (a->len != b->len)
+        return a->len < b->len ? -1 : 1;
+    for(i = a->len - 1; i >= 0; i--) {
+        if (a->tab[i] != b->tab[i])
+            return a->tab[i] < b->tab[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/* a = a - b, a >= b */
+static void bn_sub(Bignum *a, const Bignum *b)
+{
+    uint64_t borrow, t;
+    int i;
+
+    borrow = 0;
+    for(i = 0; i < a->len; i++) {
+        t = (uint64_t)a->tab[i] - (i < b->len ? b->tab[i] : 0) - borrow;
+        a->tab[i] = (uint32_t)t;
+        borrow = (t >> 32) & 1;
+    }
+    while (a->len > 0 && a->tab[a->len - 1] == 0)
+        a->len--;
+}
+
+/* r = a + b */
+static void bn_add(Bignum *r, const Bignum *a, const Bignum *b)
+{
+    uint64_t carry;
+    int i, len;
+
+    len = max_int(a->len, b->len);
+    carry = 0;
+    for(i = 0; i < len; i++) {
+        carry += (uint64_t)(i < a->len ? a->tab[i] : 0) +
+            (i < b->len ? b->tab[i] : 0);
+        r->tab[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    r->len = len;
+    if (carry != 0) {
+        assert(len < BIGNUM_LIMBS);
+        r->tab[r->len++] = (uint32_t)carry;
+    }
+}
+
+/* Shortest double to decimal digits */
+
+#define DBL_SIGNIFICAND_MASK ((uint64_t)0x000fffffffffffff)
+#define DBL_HIDDEN_BIT       ((uint64_t)0x0010000000000000)
+#define DBL_EXPONENT_BIAS    (0x3ff + 52)
+#define DBL_DENORMAL_EXPONENT (-DBL_EXPONENT_BIAS + 1)
+
+typedef union {
+    double d;
+    uint64_t u64;
+} DblBits;
+
+/* "do it yourself floating point": f * 2^e */
+typedef struct DiyFp {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+static inline DiyFp diyfp_make(uint64_t f, int e)
+{
+    DiyFp r;
+    r.f = f;
+    r.e = e;
+    return r;
+}
+
+/* rounded 64x64 -> upper 64 bits product */
+static inline DiyFp diyfp_mul(DiyFp x, DiyFp y)
+{
+    uint64_t a, b, c, d, ac, bc, ad, bd, tmp;
+
+    a = x.f >> 32;
+    b = x.f & 0xffffffff;
+    c = y.f >> 32;
+    d = y.f & 0xffffffff;
+    ac = a * c;
+    bc = b * c;
+    ad = a * d;
+    bd = b * d;
+    tmp = (bd >> 32) + (ad & 0xffffffff) + (bc & 0xffffffff);
+    tmp += 1U << 31; /* round */
+    return diyfp_make(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                      x.e + y.e + 64);
+}
+
+static inline DiyFp diyfp_normalize(DiyFp x)
+{
+    int s = clz64(x.f);
+    return diyfp_make(x.f << s, x.e - s);
+}
+
+typedef struct CachedPower {
+    uint64_t f;
+    int16_t e;
+    int16_t k;
+} CachedPower;
+
+/* normalized 10^k for k = -348 to 340 by steps of 8 */
+static const CachedPower cached_powers[] = {
+    { 0xfa8fd5a0081c0288, -1220, -348 },
+    { 0xbaaee17fa23ebf76, -1193, -340 },
+    { 0x8b16fb203055ac76, -1166, -332 },
+    { 0xcf42894a5dce35ea, -1140, -324 },
+    { 0x9a6bb0aa55653b2d, -1113, -316 },
+    { 0xe61acf033d1a45df, -1087, -308 },
+    { 0xab70fe17c79ac6ca, -1060, -300 },
+    { 0xff77b1fcbebcdc4f, -1034, -292 },
+    { 0xbe5691ef416bd60c, -1007, -284 },
+    { 0x8dd01fad907ffc3c, -980, -276 },
+    { 0xd3515c2831559a83, -954, -268 },
+    { 0x9d71ac8fada6c9b5, -927, -260 },
+    { 0xea9c227723ee8bcb, -901, -252 },
+    { 0xaecc49914078536d, -874, -244 },
+    { 0x823c12795db6ce57, -847, -236 },
+    { 0xc21094364dfb5637, -821, -228 },
+    { 0x9096ea6f3848984f, -794, -220 },
+    { 0xd77485cb25823ac7, -768, -212 },
+    { 0xa086cfcd97bf97f4, -741, -204 },
+    { 0xef340a98172aace5, -715, -196 },
+    { 0xb23867fb2a35b28e, -688, -188 },
+    { 0x84c8d4dfd2c63f3b, -661, -180 },
+    { 0xc5dd44271ad3cdba, -635, -172 },
+    { 0x936b9fcebb25c996, -608, -164 },
+    { 0xdbac6c247d62a584, -582, -156 },
+    { 0xa3ab66580d5fdaf6, -555, -148 },
+    { 0xf3e2f893dec3f126, -529, -140 },
+    { 0xb5b5ada8aaff80b8, -502, -132 },
+    { 0x87625f056c7c4a8b, -475, -124 },
+    { 0xc9bcff6034c13053, -449, -116 },
+    { 0x964e858c91ba2655, -422, -108 },
+    { 0xdff9772470297ebd, -396, -100 },
+    { 0xa6dfbd9fb8e5b88f, -369, -92 },
+    { 0xf8a95fcf88747d94, -343, -84 },
+    { 0xb94470938fa89bcf, -316, -76 },
+    { 0x8a08f0f8bf0f156b, -289, -68 },
+    { 0xcdb02555653131b6, -263, -60 },
+    { 0x993fe2c6d07b7fac, -236, -52 },
+    { 0xe45c10c42a2b3b06, -210, -44 },
+    { 0xaa242499697392d3, -183, -36 },
+    { 0xfd87b5f28300ca0e, -157, -28 },
+    { 0xbce5086492111aeb, -130, -20 },
+    { 0x8cbccc096f5088cc, -103, -12 },
+    { 0xd1b71758e219652c, -77, -4 },
+    { 0x9c40000000000000, -50, 4 },
+    { 0xe8d4a51000000000, -24, 12 },
+    { 0xad78ebc5ac620000, 3, 20 },
+    { 0x813f3978f8940984, 30, 28 },
+    { 0xc097ce7bc90715b3, 56, 36 },
+    { 0x8f7e32ce7bea5c70, 83, 44 },
+    { 0xd5d238a4abe98068, 109, 52 },
+    { 0x9f4f2726179a2245, 136, 60 },
+    { 0xed63a231d4c4fb27, 162, 68 },
+    { 0xb0de65388cc8ada8, 189, 76 },
+    { 0x83c7088e1aab65db, 216, 84 },
+    { 0xc45d1df942711d9a, 242, 92 },
+    { 0x924d692ca61be758, 269, 100 },
+    { 0xda01ee641a708dea, 295, 108 },
+    { 0xa26da3999aef774a, 322, 116 },
+    { 0xf209787bb47d6b85, 348, 124 },
+    { 0xb454e4a179dd1877, 375, 132 },
+    { 0x865b86925b9bc5c2, 402, 140 },
+    { 0xc83553c5c8965d3d, 428, 148 },
+    { 0x952ab45cfa97a0b3, 455, 156 },
+    { 0xde469fbd99a05fe3, 481, 164 },
+    { 0xa59bc234db398c25, 508, 172 },
+    { 0xf6c69a72a3989f5c, 534, 180 },
+    { 0xb7dcbf5354e9bece, 561, 188 },
+    { 0x88fcf317f22241e2, 588, 196 },
+    { 0xcc20ce9bd35c78a5, 614, 204 },
+    { 0x98165af37b2153df, 641, 212 },
+    { 0xe2a0b5dc971f303a, 667, 220 },
+    { 0xa8d9d1535ce3b396, 694, 228 },
+    { 0xfb9b7cd9a4a7443c, 720, 236 },
+    { 0xbb764c4ca7a44410, 747, 244 },
+    { 0x8bab8eefb6409c1a, 774, 252 },
+    { 0xd01fef10a657842c, 800, 260 },
+    { 0x9b10a4e5e9913129, 827, 268 },
+    { 0xe7109bfba19c0c9d, 853, 276 },
+    { 0xac2820d9623bf429, 880, 284 },
+    { 0x80444b5e7aa7cf85, 907, 292 },
+    { 0xbf21e44003acdd2d, 933, 300 },
+    { 0x8e679c2f5e44ff8f, 960, 308 },
+    { 0xd433179d9c8cb841, 986, 316 },
+    { 0x9e19db92b4e31ba9, 1013, 324 },
+    { 0xeb96bf6ebadf77d9, 1039, 332 },
+    { 0xaf87023b9bf0ee6b, 1066, 340 },
+};
+
+#define CACHED_POWERS_OFFSET 348
+#define CACHED_POWERS_DISTANCE 8
+/* range of the binary exponent of the scaled value */
+#define GRISU_MIN_TARGET_EXPONENT (-60)
+#define GRISU_MAX_TARGET_EXPONENT (-32)
+
+static CachedPower get_cached_power(int min_exponent)
+{
+    int k, index;
+
+    /* 0.30102999566398114 = 1 / log2(10) */
+    k = (int)ceil((min_exponent + 64 - 1) * 0.30102999566398114);
+    index = (CACHED_POWERS_OFFSET + k - 1) / CACHED_POWERS_DISTANCE + 1;
+    return cached_powers[index];
+}
+
+/* return the largest power of ten <= n with n < 2^bits */
+static void biggest_power_ten(uint32_t n, int bits, uint32_t *ppower,
+                              int *pexponent_plus_one)
+{
+    int e;
+
+    /* 1233 / 4096 ~= 1 / log2(10) */
+    e = ((bits + 1) * 1233 >> 12) + 1;
+    if (e > 10)
+        e = 10;
+    while (e > 0 && n < pow10_u32[e - 1])
+        e--;
+    *ppower = e > 0 ? pow10_u32[e - 1] : 0;
+    *pexponent_plus_one = e;
+}
+
+/* Move the last digit of 'buf' closer to 'w' while it stays in the
+   safe interval. Return FALSE if the result cannot be proven to be
+   the shortest closest representation. */
+static BOOL grisu_round_weed(char *buf, int len, uint64_t dist_too_high_w,
+                             uint64_t unsafe_interval, uint64_t rest,
+                             uint64_t ten_kappa, uint64_t unit)
+{
+    uint64_t small_dist = dist_too_high_w - unit;
+    uint64_t big_dist = dist_too_high_w + unit;
+
+    while (rest < small_dist &&
+           unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_dist ||
+            small_dist - rest >= rest + ten_kappa - small_dist)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+    if (rest < big_dist &&
+        unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_dist ||
+         big_dist - rest > rest + ten_kappa - big_dist)) {
+        return FALSE;
+    }
+    return (2 * unit <= rest) && (rest <= unsafe_interval - 4 * unit);
+}
+
+static BOOL grisu_digit_gen(DiyFp low, DiyFp w, DiyFp high,
+                            char *buf, int *plen, int *pkappa)
+{
+    uint64_t unit, unsafe_interval, one_f, fractionals, rest;
+    uint32_t integrals, divisor;
+    DiyFp too_low, too_high;
+    int kappa, len, one_e, digit;
+
+    unit = 1;
+    too_low = diyfp_make(low.f - unit, low.e);
+    too_high = diyfp_make(high.f + unit, high.e);
+    unsafe_interval = too_high.f - too_low.f;
+    one_e = -w.e;
+    one_f = (uint64_t)1 << one_e;
+    integrals = (uint32_t)(too_high.f >> one_e);
+    fractionals = too_high.f & (one_f - 1);
+    biggest_power_ten(integrals, 64 - one_e, &divisor, &kappa);
+    len = 0;
+    while (kappa > 0) {
+        digit = integrals / divisor;
+        buf[len++] = '0' + digit;
+        integrals %= divisor;
+        kappa--;
+        rest = ((uint64_t)integrals << one_e) + fractionals;
+        if (rest < unsafe_interval) {
+            *plen = len;
+            *pkappa = kappa;
+            return grisu_round_weed(buf, len, too_high.f - w.f,
+                                    unsafe_interval, rest,
+                                    (uint64_t)divisor << one_e, unit);
+        }
+        divisor /= 10;
+    }
+    for(;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        digit = (int)(fractionals >> one_e);
+        buf[len++] = '0' + digit;
+        fractionals &= one_f - 1;
+        kappa--;
+        if (fractionals < unsafe_interval) {
+            *plen = len;
+            *pkappa = kappa;
+            return grisu_round_weed(buf, len, (too_high.f - w.f) * unit,
+                                    unsafe_interval, fractionals, one_f,
+                                    unit);
+        }
+    }
+}
+
+/* Grisu3 (Florian Loitsch, "Printing Floating-Point Numbers Quickly
+   and Accurately with Integers"). Succeeds for about 99.5% of the
+   inputs. value = digits * 10^(*pdexp) */
+static BOOL dtoa_grisu3(char *digits, int *plen, int *pdexp,
+                        uint64_t f, int e, BOOL lower_closer)
+{
+    DiyFp w, m_plus, m_minus, c;
+    CachedPower cp;
+    int kappa;
+
+    w = diyfp_normalize(diyfp_make(f, e));
+    m_plus = diyfp_normalize(diyfp_make((f << 1) + 1, e - 1));
+    if (lower_closer)
+        m_minus = diyfp_make((f << 2) - 1, e - 2);
+    else
+        m_minus = diyfp_make((f << 1) - 1, e - 1);
+    m_minus.f <<= m_minus.e - m_plus.e;
+    m_minus.e = m_plus.e;
+
+    cp = get_cached_power(GRISU_MIN_TARGET_EXPONENT - (w.e + 64));
+    assert(GRISU_MIN_TARGET_EXPONENT <= w.e + cp.e + 64 &&
+           w.e + cp.e + 64 <= GRISU_MAX_TARGET_EXPONENT);
+    c = diyfp_make(cp.f, cp.e);
+    if (!grisu_digit_gen(diyfp_mul(m_minus, c), diyfp_mul(w, c),
+                         diyfp_mul(m_plus, c), digits, plen, &kappa))
+        return FALSE;
+    *pdexp = -cp.k + kappa;
+    return TRUE;
+}
+
+/* Exact free-format algorithm (Steele & White, Burger & Dybvig) used
+   when Grisu3 gives up. value = 0.digits * 10^(*pk) */
+static int dtoa_bignum(char *digits, int *pk, uint64_t f, int e,
+                       BOOL lower_closer)
+{
+    Bignum r, s, mp, mm, t;
+    BOOL even, tc1, tc2;
+    int k, len, d, c;
+
+    even = !(f & 1);
+    bn_set_u64(&r, f);
+    bn_set_u64(&mp, 1);
+    bn_set_u64(&mm, 1);
+    bn_set_u64(&s, 1);
+    if (e >= 0) {
+        bn_shl(&r, e + 1 + lower_closer);
+        bn_shl(&s, 1 + lower_closer);
+        bn_shl(&mp, e + lower_closer);
+        bn_shl(&mm, e);
+    } else {
+        bn_shl(&r, 1 + lower_closer);
+        bn_shl(&s, 1 - e + lower_closer);
+        bn_shl(&mp, lower_closer);
+    }
+    /* lower estimate of ceil(log10(value)) */
+    k = (int)ceil((e + 63 - clz64(f)) * 0.30102999566398114 - 1e-10);
+    if (k >= 0) {
+        bn_mul_pow10(&s, k);
+    } else {
+        bn_mul_pow10(&r, -k);
+        bn_mul_pow10(&mp, -k);
+        bn_mul_pow10(&mm, -k);
+    }
+    /* fixup: the upper boundary must be below 10^k */
+    for(;;) {
+        bn_add(&t, &r, &mp);
+        c = bn_cmp(&t, &s);
+        if (even ? c < 0 : c <= 0)
+            break;
+        bn_muladd_small(&s, 10, 0);
+        k++;
+    }
+
+    len = 0;
+    for(;;) {
+        bn_muladd_small(&r, 10, 0);
+        bn_muladd_small(&mp, 10, 0);
+        bn_muladd_small(&mm, 10, 0);
+        d = 0;
+        while (bn_cmp(&r, &s) >= 0) {
+            bn_sub(&r, &s);
+            d++;
+        }
+        c = bn_cmp(&r, &mm);
+        tc1 = even ? c <= 0 : c < 0;
+        bn_add(&t, &r, &mp);
+        c = bn_cmp(&t, &s);
+        tc2 = even ? c >= 0 : c > 0;
+        if (!tc1 && !tc2) {
+            digits[len++] = '0' + d;
+            continue;
+        }
+        if (tc1 && tc2) {
+            /* both digits are possible: take the closest one */
+            t = r;
+            bn_shl(&t, 1);
+            c = bn_cmp(&t, &s);
+            if (c > 0 || (c == 0 && (d & 1)))
+                d++;
+        } else if (tc2) {
+            d++;
+        }
+        digits[len++] = '0' + d;
+        break;
+    }
+    *pk = k;
+    return len;
+}
+
+/* 'd' must be finite and > 0. Return the number of digits (at most
+   17) and set *pn so that d = 0.digits * 10^(*pn) */
+static int dtoa_shortest(char *digits, int *pn, double d)
+{
+    DblBits u;
+    uint64_t f;
+    int e, be, len, dexp;
+    BOOL lower_closer;
+
+    u.d = d;
+    be = (u.u64 >> 52) & 0x7ff;
+    f = u.u64 & DBL_SIGNIFICAND_MASK;
+    if (be == 0) {
+        e = DBL_DENORMAL_EXPONENT;
+    } else {
+        f |= DBL_HIDDEN_BIT;
+        e = be - DBL_EXPONENT_BIAS;
+    }
+    lower_closer = (f == DBL_HIDDEN_BIT && be > 1);
+    if (dtoa_grisu3(digits, &len, &dexp, f, e, lower_closer)) {
+        *pn = len + dexp;
+        return len;
+    }
+    return dtoa_bignum(digits, pn, f, e, lower_closer);
+}
+
+/* Number::toString(10) layout of the digits. Return the length. */
+static size_t js_dtoa_format(char *buf, const char *digits, int k, int n)
+{
+    char *q = buf;
+    int i, e;
+
+    if (k <= n && n <= 21) {
+        /* integer */
+        memcpy(q, digits, k);
+        q += k;
+        for(i = k; i < n; i++)
+            *q++ = '0';
+    } else if (0 < n && n <= 21) {
+        memcpy(q, digits, n);
+        q += n;
+        *q++ = '.';
+        memcpy(q, digits + n, k - n);
+        q += k - n;
+    } else if (-6 < n && n <= 0) {
+        *q++ = '0';
+        *q++ = '.';
+        for(i = n; i < 0; i++)
+            *q++ = '0';
+        memcpy(q, digits, k);
+        q += k;
+    } else {
+        *q++ = digits[0];
+        if (k > 1) {
+            *q++ = '.';
+            memcpy(q, digits + 1, k - 1);
+            q += k - 1;
+        }
+        *q++ = 'e';
+        e = n - 1;
+        if (e < 0) {
+            *q++ = '-';
+            e = -e;
+        } else {
+            *q++ = '+';
+        }
+        q += u32toa(q, e);
+    }
+    *q = '\0';
+    return q - buf;
+}
+
+size_t js_dtoa(char *buf, double d)
+{
+    char digits[20];
+    char *q = buf;
+    int k, n;
+
+    if (isnan(d)) {
+        memcpy(buf, "NaN", 4);
+        return 3;
+    }
+    if (d == 0) {
+        /* also -0 */
+        memcpy(buf, "0", 2);
+        return 1;
+    }
+    if (d < 0) {
+        *q++ = '-';
+        d = -d;
+    }
+    if (isinf(d)) {
+        memcpy(q, "Infinity", 9);
+        return q + 8 - buf;
+    }
+    /* integers below 2^53 are their own shortest representation */
+    if (d < 9007199254740992.0 && d == (double)(uint64_t)d)
+        return q - buf + u64toa(q, (uint64_t)d);
+    k = dtoa_shortest(digits, &n, d);
+    return q - buf + js_dtoa_format(q, digits, k, n);
+}
+
+int dbuf_put_itoa(DynBuf *s, int64_t n)
+{
+    if (dbuf_realloc(s, s->size + JS_ITOA_MAX_LEN))
+        return -1;
+    s->size += i64toa((char *)s->buf + s->size, n);
+    return 0;
+}
+
+int dbuf_put_dtoa(DynBuf *s, double d)
+{
+    if (dbuf_realloc(s, s->size + JS_DTOA_MAX_LEN))
+        return -1;
+    s->size += js_dtoa((char *)s->buf + s->size, d);
+    return 0;
+}
+
+/* Decimal string to double */
+
+/* more than the 767 significant digits which may be needed to decide
+   the rounding of a halfway case */
+#define STRTOD_MAX_DIGITS 800
+
+static const double pow10_dbl[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* 10^1 to 10^7 as normalized DiyFp */
+static const DiyFp adjustment_powers[7] = {
+    { 0xa000000000000000, -60 },
+    { 0xc800000000000000, -57 },
+    { 0xfa00000000000000, -54 },
+    { 0x9c40000000000000, -50 },
+    { 0xc350000000000000, -47 },
+    { 0xf424000000000000, -44 },
+    { 0x9896800000000000, -40 },
+};
+
+/* convert f * 2^e to the nearest double, truncating extra bits */
+static double diyfp_to_double(uint64_t f, int e)
+{
+    DblBits u;
+    int be;
+
+    while (f > DBL_HIDDEN_BIT + DBL_SIGNIFICAND_MASK) {
+        f >>= 1;
+        e++;
+    }
+    if (e >= 0x7ff - DBL_EXPONENT_BIAS)
+        return INFINITY;
+    if (e < DBL_DENORMAL_EXPONENT)
+        return 0;
+    while (e > DBL_DENORMAL_EXPONENT && (f & DBL_HIDDEN_BIT) == 0) {
+        f <<= 1;
+        e--;
+    }
+    if (e == DBL_DENORMAL_EXPONENT && (f & DBL_HIDDEN_BIT) == 0)
+        be = 0;
+    else
+        be = e + DBL_EXPONENT_BIAS;
+    u.u64 = (f & DBL_SIGNIFICAND_MASK) | ((uint64_t)be << 52);
+    return u.d;
+}
+
+/* number of significand bits of a double whose top bit has the given
+   weight (fewer than 53 for denormals) */
+static int dbl_significand_size(int order)
+{
+    if (order >= DBL_DENORMAL_EXPONENT + 53)
+        return 53;
+    if (order <= DBL_DENORMAL_EXPONENT)
+        return 0;
+    return order - DBL_DENORMAL_EXPONENT;
+}
+
+/* Approximate digits * 10^e10 with 64 bit arithmetic and a cached
+   power of ten while tracking the error in 1/8 ulp units. Return FALSE
+   if the error interval contains a rounding boundary. */
+static BOOL strtod_diyfp(const char *digits, int nd, int e10, double *pres)
+{
+    const int denom_log = 3;
+    const int denom = 1 << denom_log;
+    DiyFp input;
+    CachedPower cp;
+    uint64_t error, mask, bits, half_way;
+    int i, n, remaining, old_e, prec, shift;
+
+    /* at most 19 digits fit in 64 bits */
+    n = min_int(nd, 19);
+    input.f = 0;
+    for(i = 0; i < n; i++)
+        input.f = input.f * 10 + (digits[i] - '0');
+    remaining = nd - n;
+    if (remaining > 0 && digits[n] >= '5')
+        input.f++;
+    input.e = 0;
+    e10 += remaining;
+    error = remaining == 0 ? 0 : denom / 2;
+
+    old_e = input.e;
+    input = diyfp_normalize(input);
+    error <<= old_e - input.e;
+
+    if (e10 < -CACHED_POWERS_OFFSET) {
+        *pres = 0;
+        return TRUE;
+    }
+    cp = cached_powers[(e10 + CACHED_POWERS_OFFSET) / CACHED_POWERS_DISTANCE];
+    if (cp.k != e10) {
+        int adj = e10 - cp.k;
+        input = diyfp_mul(input, adjustment_powers[adj - 1]);
+        /* exact if the product still fits in 64 bits */
+        if (19 - n < adj)
+            error += denom / 2;
+    }
+    input = diyfp_mul(input, diyfp_make(cp.f, cp.e));
+    /* error of the cached power, of the product and of the rounding */
+    error += denom / 2 + (error != 0) + denom / 2;
+
+    old_e = input.e;
+    input = diyfp_normalize(input);
+    error <<= old_e - input.e;
+
+    prec = 64 - dbl_significand_size(64 + input.e);
+    if (prec + denom_log >= 64) {
+        shift = prec + denom_log - 64 + 1;
+        input.f >>= shift;
+        input.e += shift;
+        error = (error >> shift) + 1 + denom;
+        prec -= shift;
+    }
+    mask = ((uint64_t)1 << prec) - 1;
+    bits = (input.f & mask) * denom;
+    half_way = ((uint64_t)1 << (prec - 1)) * denom;
+    input.f >>= prec;
+    input.e += prec;
+    if (bits >= half_way + error)
+        input.f++;
+    *pres = diyfp_to_double(input.f, input.e);
+    return !(half_way - error < bits && bits < half_way + error);
+}
+
+/* correctly rounded digits * 10^e10 using big integer arithmetic */
+static double strtod_bignum(const char *digits, int nd, int e10)
+{
+    Bignum num, den, b;
+    uint64_t q, m, mask;
+    int i, l, sh, drop, e_top;
+    BOOL sticky, half, rest;
+
+    bn_set_u64(&num, 0);
+    for(i = 0; i < nd; i += l) {
+        uint32_t v = 0;
+        int j;
+        l = min_int(9, nd - i);
+        for(j = 0; j < l; j++)
+            v = v * 10 + (digits[i + j] - '0');
+        bn_muladd_small(&num, pow10_u32[l], v);
+    }
+    bn_set_u64(&den, 1);
+    if (e10 >= 0)
+        bn_mul_pow10(&num, e10);
+    else
+        bn_mul_pow10(&den, -e10);
+
+    /* scale so that 2^63 <= num / den < 2^64 */
+    sh = 63 - (bn_bitlen(&num) - bn_bitlen(&den));
+    if (sh >= 0)
+        bn_shl(&num, sh);
+    else
+        bn_shl(&den, -sh);
+    b = den;
+    bn_shl(&b, 63);
+    if (bn_cmp(&num, &b) < 0) {
+        bn_shl(&num, 1);
+        sh++;
+    }
+    /* 64 bit quotient by shift and subtract */
+    q = 0;
+    for(i = 63; i >= 0; i--) {
+        if (bn_cmp(&num, &b) >= 0) {
+            bn_sub(&num, &b);
+            q |= (uint64_t)1 << i;
+        }
+        bn_shr1(&b);
+    }
+    sticky = !bn_is_zero(&num);
+
+    /* value = (q + sticky) * 2^-sh, round to 53 bits or less for
+       denormals */
+    e_top = 63 - sh;
+    drop = 11;
+    if (e_top < -1022)
+        drop += -1022 - e_top;
+    if (drop > 65)
+        return 0;
+    if (drop >= 64) {
+        m = 0;
+        half = (drop == 64) ? (q >> 63) : 0;
+        mask = (drop == 64) ? ((uint64_t)1 << 63) - 1 : q;
+    } else {
+        m = q >> drop;
+        half = (q >> (drop - 1)) & 1;
+        mask = q & (((uint64_t)1 << (drop - 1)) - 1);
+    }
+    rest = (mask != 0) || sticky;
+    if (half && (rest || (m & 1)))
+        m++;
+    return ldexp((double)m, drop - sh);
+}
+
+double js_strtod(const char *str, const char **pp)
+{
+    char digits[STRTOD_MAX_DIGITS + 1];
+    const char *p, *p_start_digits;
+    int nd, dexp, exp_val, e10;
+    BOOL neg, exp_neg, truncated, has_digits;
+    uint64_t m;
+    double d;
+
+    p = str;
+    neg = FALSE;
+    if (*p == '+' || *p == '-') {
+        neg = (*p == '-');
+        p++;
+    }
+    if (strstart(p, "Infinity", &p)) {
+        d = INFINITY;
+        goto done;
+    }
+
+    nd = 0;
+    dexp = 0;
+    truncated = FALSE;
+    has_digits = FALSE;
+    p_start_digits = p;
+    while (*p >= '0' && *p <= '9') {
+        if (nd == 0 && *p == '0') {
+            /* skip leading zeros */
+        } else if (nd < STRTOD_MAX_DIGITS) {
+            digits[nd++] = *p;
+        } else {
+            dexp++;
+            truncated |= (*p != '0');
+        }
+        p++;
+    }
+    has_digits = (p != p_start_digits);
+    if (*p == '.') {
+        p++;
+        p_start_digits = p;
+        while (*p >= '0' && *p <= '9') {
+            if (nd == 0 && *p == '0') {
+                dexp--;
+            } else if (nd < STRTOD_MAX_DIGITS) {
+                digits[nd++] = *p;
+                dexp--;
+            } else {
+                truncated |= (*p != '0');
+            }
+            p++;
+        }
+        has_digits |= (p != p_start_digits);
+    }
+    if (!has_digits) {
+        if (pp)
+            *pp = str;
+        return NAN;
+    }
+    if (*p == 'e' || *p == 'E') {
+        const char *p1 = p + 1;
+        exp_neg = FALSE;
+        if (*p1 == '+' || *p1 == '-') {
+            exp_neg = (*p1 == '-');
+            p1++;
+        }
+        if (*p1 >= '0' && *p1 <= '9') {
+            exp_val = 0;
+            while (*p1 >= '0' && *p1 <= '9') {
+                if (exp_val < 100000)
+                    exp_val = exp_val * 10 + (*p1 - '0');
+                p1++;
+            }
+            dexp += exp_neg ? -exp_val : exp_val;
+            p = p1;
+        }
+    }
+
+    if (truncated) {
+        /* a non zero digit after the last kept one only matters for
+           halfway cases */
+        digits[nd++] = '1';
+        dexp--;
+    }
+    while (nd > 0 && digits[nd - 1] == '0') {
+        nd--;
+        dexp++;
+    }
+    if (nd == 0) {
+        d = 0;
+        goto done;
+    }
+    /* value = digits * 10^dexp with 10^(nd + dexp - 1) <= value */
+    if (nd + dexp > 310) {
+        d = INFINITY;
+        goto done;
+    }
+    if (nd + dexp < -324) {
+        d = 0;
+        goto done;
+    }
+    e10 = dexp;
+    if (nd <= 15) {
+        /* exact fast paths: both the significand and the power of ten
+           are exactly representable */
+        int i;
+        m = 0;
+        for(i = 0; i < nd; i++)
+            m = m * 10 + (digits[i] - '0');
+        if (e10 >= 0 && e10 <= 22) {
+            d = (double)m * pow10_dbl[e10];
+            goto done;
+        } else if (e10 < 0 && e10 >= -22) {
+            d = (double)m / pow10_dbl[-e10];
+            goto done;
+        } else if (e10 > 22 && e10 <= 22 + 15 - nd) {
+            d = (double)(m * (uint64_t)pow10_dbl[e10 - 22]) * 1e22;
+            goto done;
+        }
+    }
+    if (!strtod_diyfp(digits, nd, e10, &d))
+        d = strtod_bignum(digits, nd, e10);
+ done:
+    if (pp)
+        *pp = p;
+    return neg ? -d : d;
+}
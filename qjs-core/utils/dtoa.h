@@ -0,0 +1,31 @@
+#ifndef QJS_DTOA_H
+#define QJS_DTOA_H
+#include "cutils.h"
+
+/* Locale independent number <-> string conversions. The double
+   conversions follow the ECMAScript Number::toString(10) and
+   StringToNumber semantics. */
+
+/* maximum length of the output of js_dtoa(), including the null
+   terminator */
+#define JS_DTOA_MAX_LEN 32
+/* maximum length of the output of i64toa(), including the null
+   terminator */
+#define JS_ITOA_MAX_LEN 21
+
+size_t u32toa(char *buf, uint32_t n);
+size_t i32toa(char *buf, int32_t n);
+size_t u64toa(char *buf, uint64_t n);
+size_t i64toa(char *buf, int64_t n);
+
+/* shortest decimal representation which round trips to 'd' */
+size_t js_dtoa(char *buf, double d);
+/* parse a StrDecimalLiteral (optional sign, digits, fraction, exponent
+   or "Infinity"). The result is correctly rounded. Return NAN and set
+   *pp to str if no number could be parsed. */
+double js_strtod(const char *str, const char **pp);
+
+int dbuf_put_itoa(DynBuf *s, int64_t n);
+int dbuf_put_dtoa(DynBuf *s, double d);
+
+#endif //QJS_DTOA_H
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "psort.h"
+
+typedef int psort_cmp_f(const void *, const void *, void *);
+
+typedef struct PSortState {
+    uint8_t *src;
+    uint8_t *dst;
+    size_t nmemb;
+    size_t size;
+    psort_cmp_f *cmp;
+    void *opaque;
+    int n_runs; /* number of sorted runs in 'src' */
+    int n_segs; /* number of tasks per merged pair */
+} PSortState;
+
+static inline size_t psort_run_start(PSortState *s, int i)
+{
+    return (size_t)((uint64_t)s->nmemb * i / s->n_runs);
+}
+
+static void psort_sort_run(void *opaque, int i)
+{
+    PSortState *s = opaque;
+    size_t start, end;
+
+    start = psort_run_start(s, i);
+    end = psort_run_start(s, i + 1);
+    rqsort(s->src + start * s->size, end - start, s->size, s->cmp, s->opaque);
+}
+
+/* number of elements of a[0..len_a[ among the first k elements of the
+   merge of a and b. Elements of 'a' come first in case of equality. */
+static size_t psort_co_rank(PSortState *s, const uint8_t *a, size_t len_a,
+                            const uint8_t *b, size_t len_b, size_t k)
+{
+    size_t lo, hi, mid;
+
+    lo = k > len_b ? k - len_b : 0;
+    hi = k < len_a ? k : len_a;
+    while (lo < hi) {
+        mid = lo + ((hi - lo) >> 1);
+        if (s->cmp(a + mid * s->size, b + (k - mid - 1) * s->size,
+                   s->opaque) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void psort_merge_seg(void *opaque, int task)
+{
+    PSortState *s = opaque;
+    size_t size = s->size;
+    size_t a0, b0, b1, len_a, len_b, len, k0, k1, i, j, i_end, j_end;
+    uint8_t *a, *b, *d;
+    int pair, seg;
+
+    pair = task / s->n_segs;
+    seg = task % s->n_segs;
+    a0 = psort_run_start(s, 2 * pair);
+    b0 = psort_run_start(s, 2 * pair + 1);
+    b1 = psort_run_start(s, 2 * pair + 2);
+    a = s->src + a0 * size;
+    b = s->src + b0 * size;
+    len_a = b0 - a0;
+    len_b = b1 - b0;
+    len = len_a + len_b;
+    k0 = (size_t)((uint64_t)len * seg / s->n_segs);
+    k1 = (size_t)((uint64_t)len * (seg + 1) / s->n_segs);
+    i = psort_co_rank(s, a, len_a, b, len_b, k0);
+    j = k0 - i;
+    i_end = psort_co_rank(s, a, len_a, b, len_b, k1);
+    j_end = k1 - i_end;
+    d = s->dst + (a0 + k0) * size;
+
+    while (i < i_end && j < j_end) {
+        if (s->cmp(a + i * size, b + j * size, s->opaque) <= 0) {
+            memcpy(d, a + i * size, size);
+            i++;
+        } else {
+            memcpy(d, b + j * size, size);
+            j++;
+        }
+        d += size;
+    }
+    memcpy(d, a + i * size, (i_end - i) * size);
+    d += (i_end - i) * size;
+    memcpy(d, b + j * size, (j_end - j) * size);
+}
+
+static void psort_copy_back(void *opaque, int i)
+{
+    PSortState *s = opaque;
+    size_t start, end;
+
+    start = psort_run_start(s, i);
+    end = psort_run_start(s, i + 1);
+    memcpy(s->dst + start * s->size, s->src + start * s->size,
+           (end - start) * s->size);
+}
+
+void rqsort_parallel(JSThreadPool *tp, void *base, size_t nmemb, size_t size,
+                     psort_cmp_f *cmp, void *opaque, size_t min_parallel)
+{
+    PSortState s_s, *s = &s_s;
+    uint8_t *tmp, *t;
+    int n_threads, n_runs;
+
+    if (min_parallel == 0)
+        min_parallel = PSORT_MIN_PARALLEL_DEFAULT;
+    n_threads = tp ? js_thread_pool_get_thread_count(tp) : 1;
+    if (n_threads <= 1 || nmemb < min_parallel || nmemb < 2 * n_threads)
+        goto seq_sort;
+    tmp = malloc(nmemb * size);
+    if (!tmp)
+        goto seq_sort;
+
+    /* the number of runs is a power of two so that each merge round
+       halves it */
+    n_runs = 1;
+    while (n_runs < n_threads)
+        n_runs *= 2;
+    s->src = base;
+    s->dst = tmp;
+    s->nmemb = nmemb;
+    s->size = size;
+    s->cmp = cmp;
+    s->opaque = opaque;
+    s->n_runs = n_runs;
+    js_thread_pool_run(tp, psort_sort_run, s, n_runs);
+
+    while (s->n_runs > 1) {
+        /* a pair of runs at run start 2 * i becomes run i */
+        s->n_segs = max_int(1, (2 * n_threads) / (s->n_runs / 2));
+        js_thread_pool_run(tp, psort_merge_seg, s, (s->n_runs / 2) * s->n_segs);
+        s->n_runs /= 2;
+        t = s->src;
+        s->src = s->dst;
+        s->dst = t;
+    }
+    if (s->src != base) {
+        s->n_runs = n_threads;
+        js_thread_pool_run(tp, psort_copy_back, s, n_threads);
+    }
+    free(tmp);
+    return;
+ seq_sort:
+    rqsort(base, nmemb, size, cmp, opaque);
+}
@@ -0,0 +1,20 @@
+#ifndef QJS_PSORT_H
+#define QJS_PSORT_H
+#include "cutils.h"
+#include "threadpool.h"
+
+/* below this number of elements, rqsort_parallel() uses rqsort() */
+#define PSORT_MIN_PARALLEL_DEFAULT (1 << 16)
+
+/* Sort with a parallel merge sort on 'tp': the array is cut in one run
+   per thread, the runs are sorted with rqsort() and then merged pairwise,
+   each merge being itself split between the threads. 'min_parallel' is
+   the size threshold (0 = PSORT_MIN_PARALLEL_DEFAULT). Falls back to
+   rqsort() when tp is NULL, has a single thread or when the temporary
+   buffer cannot be allocated. As with rqsort(), the order of equal
+   elements is unspecified. */
+void rqsort_parallel(JSThreadPool *tp, void *base, size_t nmemb, size_t size,
+                     int (*cmp)(const void *, const void *, void *),
+                     void *opaque, size_t min_parallel);
+
+#endif //QJS_PSORT_H
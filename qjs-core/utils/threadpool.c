@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+struct JSThreadPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond; /* a new batch is available */
+    pthread_cond_t done_cond; /* the current batch is finished */
+    int n_threads; /* including the calling thread */
+    int n_started;
+    pthread_t *threads;
+    BOOL terminate;
+    /* current batch */
+    uint32_t generation;
+    JSThreadPoolFunc *func;
+    void *opaque;
+    int count;
+    int next_index; /* next item to be executed */
+    int pending; /* items not finished yet */
+};
+
+/* execute items of the current batch until none is left. The mutex
+   must be held. */
+static void thread_pool_work(JSThreadPool *tp)
+{
+    JSThreadPoolFunc *func;
+    void *opaque;
+    int index;
+
+    while (tp->next_index < tp->count) {
+        index = tp->next_index++;
+        func = tp->func;
+        opaque = tp->opaque;
+        pthread_mutex_unlock(&tp->mutex);
+        func(opaque, index);
+        pthread_mutex_lock(&tp->mutex);
+        if (--tp->pending == 0)
+            pthread_cond_broadcast(&tp->done_cond);
+    }
+}
+
+static void *thread_pool_worker(void *arg)
+{
+    JSThreadPool *tp = arg;
+    uint32_t generation = 0;
+
+    pthread_mutex_lock(&tp->mutex);
+    for(;;) {
+        while (!tp->terminate && tp->generation == generation)
+            pthread_cond_wait(&tp->work_cond, &tp->mutex);
+        if (tp->terminate)
+            break;
+        generation = tp->generation;
+        thread_pool_work(tp);
+    }
+    pthread_mutex_unlock(&tp->mutex);
+    return NULL;
+}
+
+JSThreadPool *js_thread_pool_new(int n_threads)
+{
+    JSThreadPool *tp;
+    int i;
+
+    if (n_threads <= 0) {
+        n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n_threads <= 0)
+            n_threads = 1;
+    }
+    tp = calloc(1, sizeof(*tp));
+    if (!tp)
+        return NULL;
+    tp->n_threads = n_threads;
+    pthread_mutex_init(&tp->mutex, NULL);
+    pthread_cond_init(&tp->work_cond, NULL);
+    pthread_cond_init(&tp->done_cond, NULL);
+    if (n_threads > 1) {
+        tp->threads = malloc(sizeof(tp->threads[0]) * (n_threads - 1));
+        if (!tp->threads)
+            goto fail;
+        for(i = 0; i < n_threads - 1; i++) {
+            if (pthread_create(&tp->threads[i], NULL, thread_pool_worker, tp))
+                goto fail;
+            tp->n_started++;
+        }
+    }
+    return tp;
+ fail:
+    js_thread_pool_free(tp);
+    return NULL;
+}
+
+void js_thread_pool_free(JSThreadPool *tp)
+{
+    int i;
+
+    pthread_mutex_lock(&tp->mutex);
+    tp->terminate = TRUE;
+    pthread_cond_broadcast(&tp->work_cond);
+    pthread_mutex_unlock(&tp->mutex);
+    for(i = 0; i < tp->n_started; i++)
+        pthread_join(tp->threads[i], NULL);
+    free(tp->threads);
+    pthread_cond_destroy(&tp->done_cond);
+    pthread_cond_destroy(&tp->work_cond);
+    pthread_mutex_destroy(&tp->mutex);
+    free(tp);
+}
+
+int js_thread_pool_get_thread_count(JSThreadPool *tp)
+{
+    return tp->n_threads;
+}
+
+void js_thread_pool_run(JSThreadPool *tp, JSThreadPoolFunc *func,
+                        void *opaque, int count)
+{
+    int i;
+
+    if (count <= 0)
+        return;
+    if (tp->n_started == 0 || count == 1) {
+        for(i = 0; i < count; i++)
+            func(opaque, i);
+        return;
+    }
+    pthread_mutex_lock(&tp->mutex);
+    tp->func = func;
+    tp->opaque = opaque;
+    tp->count = count;
+    tp->next_index = 0;
+    tp->pending = count;
+    tp->generation++;
+    pthread_cond_broadcast(&tp->work_cond);
+    thread_pool_work(tp);
+    while (tp->pending != 0)
+        pthread_cond_wait(&tp->done_cond, &tp->mutex);
+    pthread_mutex_unlock(&tp->mutex);
+}
@@ -0,0 +1,22 @@
+#ifndef QJS_THREADPOOL_H
+#define QJS_THREADPOOL_H
+#include "cutils.h"
+
+/* Fixed set of worker threads executing fork/join batches. The calling
+   thread takes part in each batch so a pool of N threads starts N - 1
+   workers. */
+typedef struct JSThreadPool JSThreadPool;
+
+typedef void JSThreadPoolFunc(void *opaque, int index);
+
+/* n_threads <= 0 selects the number of online CPUs. Return NULL if
+   error. */
+JSThreadPool *js_thread_pool_new(int n_threads);
+void js_thread_pool_free(JSThreadPool *tp);
+int js_thread_pool_get_thread_count(JSThreadPool *tp);
+/* call func(opaque, i) for 0 <= i < count and wait for completion.
+   Batches must not be submitted concurrently nor from inside 'func'. */
+void js_thread_pool_run(JSThreadPool *tp, JSThreadPoolFunc *func,
+                        void *opaque, int count);
+
+#endif //QJS_THREADPOOL_H
@@ -1,18 +1,375 @@
 //
 // Created by benpeng.jiang on 2021/5/22.
 //
+#include <stdlib.h>
+#include <string.h>
 #include "qjs.h"
+#include "qjs-workers.h"
+#include "qjs-bccache.h"
+#include "qjs-port-loop.h"
+
+/* The file is read in chunks because pipes and character devices
+   cannot be sized with fseek()/ftell(). The parser needs the whole
+   source and consumes the UTF-8 bytes directly: the chunked decoding
+   (JS_NewStringDecoder()) is for the data read by the scripts. */
+static uint8_t *js_load_file(JSContext *ctx, size_t *pbuf_len,
+                             const char *filename)
+{
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    FILE *f;
+    uint8_t *buf, *new_buf;
+    size_t buf_len, buf_size, n;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        return NULL;
+    buf = NULL;
+    buf_len = 0;
+    buf_size = 0;
+    for(;;) {
+        /* keep one byte for the terminating null */
+        if (buf_size - buf_len < 4096 + 1) {
+            buf_size = buf_size * 3 / 2 + 4096 + 1;
+            new_buf = js_realloc_rt(rt, buf, buf_size);
+            if (!new_buf)
+                goto fail;
+            buf = new_buf;
+        }
+        n = fread(buf + buf_len, 1, buf_size - buf_len - 1, f);
+        buf_len += n;
+        if (n == 0) {
+            if (ferror(f))
+                goto fail;
+            break;
+        }
+    }
+    buf[buf_len] = '\0';
+    fclose(f);
+    *pbuf_len = buf_len;
+    return buf;
+ fail:
+    js_free_rt(rt, buf);
+    fclose(f);
+    return NULL;
+}
+
+static void print_exception(JSContext *ctx)
+{
+    JSValue exc, val;
+    const char *str;
+
+    exc = JS_GetException(ctx);
+    str = JS_ToCString(ctx, exc);
+    if (str) {
+        val = JS_GetPropertyStr(ctx, exc, "lineNumber");
+        if (JS_VALUE_GET_TAG(val) == JS_TAG_INT)
+            fprintf(stderr, "line %d: ", JS_VALUE_GET_INT(val));
+        JS_FreeValue(ctx, val);
+        fprintf(stderr, "%s\n", str);
+        JS_FreeCString(ctx, str);
+    } else {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        fprintf(stderr, "[exception]\n");
+    }
+    JS_FreeValue(ctx, exc);
+}
+
+static JSValue js_print(JSContext *ctx, JSValueConst this_val,
+                        int argc, JSValueConst *argv)
+{
+    const char *str;
+    size_t len;
+    int i;
+
+    for(i = 0; i < argc; i++) {
+        if (i != 0)
+            putchar(' ');
+        str = JS_ToCStringLen(ctx, &len, argv[i]);
+        if (!str)
+            return JS_EXCEPTION;
+        fwrite(str, 1, len, stdout);
+        JS_FreeCString(ctx, str);
+    }
+    putchar('\n');
+    return JS_UNDEFINED;
+}
+
+/* the globals of the scripts, installed on the context of the single
+   runtime mode and on the template context of each worker */
+static int add_globals(JSContext *ctx)
+{
+    JSValue global;
+    int ret;
+
+    global = JS_GetGlobalObject(ctx);
+    ret = JS_SetPropertyStr(ctx, global, "print",
+                            JS_NewCFunction(ctx, js_print, "print", 1));
+    JS_FreeValue(ctx, global);
+    return ret < 0 ? -1 : 0;
+}
+
+/* a job runs a script file or a source line in a fresh context */
+static int run_job(JSContext *ctx, const QJSJob *job)
+{
+    uint8_t *buf;
+    size_t buf_len;
+    JSValue val;
+
+    if (job->type == QJS_JOB_FILE) {
+        buf = js_load_file(ctx, &buf_len, job->str);
+        if (!buf) {
+            fprintf(stderr, "qjs: could not load '%s'\n", job->str);
+            return -1;
+        }
+        val = JS_Eval(ctx, (const char *)buf, buf_len, job->str,
+                      JS_EVAL_TYPE_GLOBAL);
+        js_free_rt(JS_GetRuntime(ctx), buf);
+    } else {
+        val = JS_Eval(ctx, job->str, strlen(job->str), "<stdin>",
+                      JS_EVAL_TYPE_GLOBAL);
+    }
+    if (JS_IsException(val)) {
+        val = JS_GetException(ctx);
+        if (JS_IsUncatchableError(ctx, val)) {
+            /* counted in the statistics */
+            JS_FreeValue(ctx, val);
+            return QJS_JOB_INTERRUPTED;
+        }
+        JS_Throw(ctx, val);
+        fprintf(stderr, "%s: ",
+                job->type == QJS_JOB_FILE ? job->str : "<stdin>");
+        print_exception(ctx);
+        return -1;
+    }
+    JS_FreeValue(ctx, val);
+    return 0;
+}
+
+/* one job per non empty line of stdin */
+static int read_stdin_jobs(QJSJob **pjobs, int *pjob_count, int *pjob_size)
+{
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    QJSJob *new_jobs;
+
+    while ((len = getline(&line, &line_size, stdin)) >= 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0)
+            continue;
+        if (*pjob_count >= *pjob_size) {
+            int new_size = *pjob_size * 3 / 2 + 8;
+            new_jobs = realloc(*pjobs, sizeof(new_jobs[0]) * new_size);
+            if (!new_jobs)
+                goto fail;
+            *pjobs = new_jobs;
+            *pjob_size = new_size;
+        }
+        (*pjobs)[*pjob_count].type = QJS_JOB_SOURCE;
+        (*pjobs)[*pjob_count].str = strdup(line);
+        if (!(*pjobs)[*pjob_count].str)
+            goto fail;
+        (*pjob_count)++;
+    }
+    free(line);
+    return 0;
+ fail:
+    free(line);
+    return -1;
+}
+
+static void help(void)
+{
+    printf("usage: qjs [options] [file...]\n"
+           "-h  --help         list options\n"
+           "-d  --dump         dump the memory usage stats\n"
+           "-w  --workers n    run the files as jobs on n threads, each one with\n"
+           "                   its own runtime (0 = number of CPUs)\n"
+           "    --stdin        with -w, read one script per line from stdin\n"
+           "-r  --repeat n     with -w, run each job n times\n"
+           "-t  --timeout ms   with -w, interrupt the jobs running longer than ms\n"
+           "-c  --cache file   keep the compiled scripts in the bytecode cache file\n"
+           "                   (not with -w)\n"
+           "    --no-jit       run the bytecode with the interpreter only\n");
+    exit(1);
+}
+
+static int run_worker_mode(int worker_count, int repeat, int64_t timeout_ms,
+                           int use_jit, int use_stdin, char **files,
+                           int file_count)
+{
+    QJSJob *jobs = NULL;
+    QJSWorkerStats stats;
+    int i, job_count, job_size, ret;
+
+    job_count = 0;
+    job_size = file_count;
+    if (file_count > 0) {
+        jobs = malloc(sizeof(jobs[0]) * file_count);
+        if (!jobs)
+            return 2;
+        for (i = 0; i < file_count; i++) {
+            jobs[i].type = QJS_JOB_FILE;
+            jobs[i].str = files[i];
+        }
+        job_count = file_count;
+    }
+    if (use_stdin && read_stdin_jobs(&jobs, &job_count, &job_size)) {
+        fprintf(stderr, "qjs: out of memory\n");
+        return 2;
+    }
+    ret = qjs_run_workers(worker_count, jobs, job_count, repeat, timeout_ms,
+                          use_jit, add_globals, run_job, &stats);
+    if (ret < 0)
+        fprintf(stderr, "qjs: could not run the jobs\n");
+    else
+        qjs_dump_worker_stats(stdout, &stats);
+    for (i = file_count; i < job_count; i++)
+        free((char *)jobs[i].str);
+    free(jobs);
+    if (ret < 0)
+        return 2;
+    return stats.failed_count != 0;
+}
+
+static int eval_file(JSContext *ctx, QJSBytecodeCache *cache,
+                     const char *filename)
+{
+    uint8_t *buf;
+    size_t buf_len;
+    JSValue val;
+
+    buf = js_load_file(ctx, &buf_len, filename);
+    if (!buf) {
+        fprintf(stderr, "qjs: could not load '%s'\n", filename);
+        return -1;
+    }
+    /* compiled then run so that the cache keeps the compiled script */
+    if (cache) {
+        val = qjs_bccache_compile(cache, ctx, (const char *)buf, buf_len,
+                                  filename);
+    } else {
+        val = JS_Eval(ctx, (const char *)buf, buf_len, filename,
+                      JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+    }
+    js_free_rt(JS_GetRuntime(ctx), buf);
+    if (!JS_IsException(val))
+        val = JS_EvalFunction(ctx, val);
+    if (JS_IsException(val)) {
+        fprintf(stderr, "%s: ", filename);
+        print_exception(ctx);
+        return -1;
+    }
+    JS_FreeValue(ctx, val);
+    return 0;
+}
 
 int main(int argc, char **argv) {
-    int dump_memory = 1;
+    int dump_memory = 0;
+    int worker_count = -1;
+    int repeat = 1;
+    int64_t timeout_ms = 0;
+    int use_stdin = 0;
+    int use_jit = 1;
+    const char *cache_filename = NULL;
+    QJSBytecodeCache *cache = NULL;
+    int optind, i, ret;
 
     JSRuntime *rt;
     JSContext *ctx;
+    jerry_port_loop_t *loop;
+
+    /* cannot use getopt because we want to pass the command line to
+       the script */
+    optind = 1;
+    while (optind < argc && *argv[optind] == '-') {
+        char *arg = argv[optind];
+
+        optind++;
+        if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            help();
+        } else if (!strcmp(arg, "-d") || !strcmp(arg, "--dump")) {
+            dump_memory = 1;
+        } else if ((!strcmp(arg, "-w") || !strcmp(arg, "--workers")) &&
+                   optind < argc) {
+            worker_count = atoi(argv[optind++]);
+        } else if ((!strcmp(arg, "-r") || !strcmp(arg, "--repeat")) &&
+                   optind < argc) {
+            repeat = atoi(argv[optind++]);
+        } else if ((!strcmp(arg, "-t") || !strcmp(arg, "--timeout")) &&
+                   optind < argc) {
+            timeout_ms = strtoll(argv[optind++], NULL, 0);
+        } else if ((!strcmp(arg, "-c") || !strcmp(arg, "--cache")) &&
+                   optind < argc) {
+            cache_filename = argv[optind++];
+        } else if (!strcmp(arg, "--stdin")) {
+            use_stdin = 1;
+        } else if (!strcmp(arg, "--no-jit")) {
+            use_jit = 0;
+        } else {
+            fprintf(stderr, "qjs: unknown option '%s'\n", arg);
+            help();
+        }
+    }
+
+    if (worker_count >= 0) {
+        /* the cache holds the functions of a single runtime */
+        if (cache_filename) {
+            fprintf(stderr, "qjs: --cache cannot be used with --workers\n");
+            return 1;
+        }
+        return run_worker_mode(worker_count, repeat, timeout_ms, use_jit,
+                               use_stdin, argv + optind, argc - optind);
+    }
+
     rt = JS_NewRuntime();
+    JS_SetJITEnabled(rt, use_jit);
+    ctx = JS_NewContext(rt);
+    if (!ctx) {
+        fprintf(stderr, "qjs: cannot allocate JS context\n");
+        exit(2);
+    }
+    if (cache_filename) {
+        cache = qjs_bccache_open(cache_filename);
+        if (!cache) {
+            fprintf(stderr, "qjs: out of memory\n");
+            exit(2);
+        }
+    }
+
+    /* the timers and reads of the scripts run after the scripts, the
+       workers have no event loop */
+    loop = jerry_port_loop_new(rt);
+    if (!loop || add_globals(ctx) || jerry_port_loop_add_intrinsics(ctx)) {
+        fprintf(stderr, "qjs: cannot allocate JS context\n");
+        exit(2);
+    }
+
+    ret = 0;
+    for (i = optind; i < argc; i++) {
+        if (eval_file(ctx, cache, argv[i]))
+            ret = 1;
+    }
+    jerry_port_loop_run(loop);
 
     if (dump_memory) {
         JSMemoryUsage stats;
         JS_ComputeMemoryUsage(rt, &stats);
         JS_DumpMemoryUsage(stdout, &stats, rt);
+        if (cache)
+            qjs_bccache_dump_stats(stdout, cache);
+    }
+    jerry_port_loop_free(loop);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    if (cache) {
+        if (qjs_bccache_save(cache)) {
+            fprintf(stderr, "qjs: could not write '%s'\n", cache_filename);
+            ret = 1;
+        }
+        /* the functions read from the cache are freed with the runtime */
+        qjs_bccache_close(cache);
     }
-}
\ No newline at end of file
+    return ret;
+}
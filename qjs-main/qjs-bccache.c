@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cutils.h"
+#include "qjs-bccache.h"
+
+/* File layout: a header, the entry table sorted by key then the
+   serialized scripts (JS_WriteObject() output). All integers are in
+   the host byte order: a file written on another host is rejected by
+   the magic check and gives an empty cache. */
+
+#define QJS_BCCACHE_MAGIC   0x43434251 /* "QBCC" */
+#define QJS_BCCACHE_VERSION 1
+
+typedef struct QJSBCCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+} QJSBCCacheHeader;
+
+typedef struct QJSBCCacheEntry {
+    uint64_t hash; /* hash of the file name and of the source */
+    uint32_t source_len;
+    uint32_t size;
+    uint64_t offset; /* from the start of the file */
+} QJSBCCacheEntry;
+
+/* entry compiled during this session, not yet in the file */
+typedef struct QJSBCCacheNewEntry {
+    QJSBCCacheEntry e;
+    uint8_t *data;
+} QJSBCCacheNewEntry;
+
+struct QJSBytecodeCache {
+    char *filename;
+    uint8_t *map; /* NULL if no valid file */
+    size_t map_size;
+    const QJSBCCacheEntry *entries; /* in 'map' */
+    uint32_t entry_count;
+    QJSBCCacheNewEntry *new_entries;
+    int new_count;
+    int new_size;
+    int64_t hit_count;
+    int64_t miss_count;
+};
+
+/* FNV-1a */
+static uint64_t bccache_hash(uint64_t h, const uint8_t *buf, size_t len)
+{
+    size_t i;
+    for(i = 0; i < len; i++) {
+        h ^= buf[i];
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+static int bccache_entry_cmp(const QJSBCCacheEntry *a, const QJSBCCacheEntry *b)
+{
+    if (a->hash != b->hash)
+        return a->hash < b->hash ? -1 : 1;
+    if (a->source_len != b->source_len)
+        return a->source_len < b->source_len ? -1 : 1;
+    return 0;
+}
+
+static int bccache_entry_cmp2(const void *a, const void *b)
+{
+    return bccache_entry_cmp(a, b);
+}
+
+static int bccache_new_entry_cmp(const void *a, const void *b)
+{
+    return bccache_entry_cmp(&((const QJSBCCacheNewEntry *)a)->e,
+                             &((const QJSBCCacheNewEntry *)b)->e);
+}
+
+static BOOL bccache_map_file(QJSBytecodeCache *c)
+{
+    const QJSBCCacheHeader *h;
+    const QJSBCCacheEntry *e;
+    struct stat st;
+    uint32_t i;
+    void *map;
+    int fd;
+
+    fd = open(c->filename, O_RDONLY);
+    if (fd < 0)
+        return FALSE;
+    if (fstat(fd, &st) < 0 || st.st_size < sizeof(QJSBCCacheHeader)) {
+        close(fd);
+        return FALSE;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return FALSE;
+    c->map = map;
+    c->map_size = st.st_size;
+
+    h = map;
+    if (h->magic != QJS_BCCACHE_MAGIC || h->version != QJS_BCCACHE_VERSION)
+        return FALSE;
+    if (h->entry_count > (c->map_size - sizeof(*h)) / sizeof(*e))
+        return FALSE;
+    e = (const QJSBCCacheEntry *)(h + 1);
+    for(i = 0; i < h->entry_count; i++) {
+        if (e[i].offset > c->map_size || e[i].size > c->map_size - e[i].offset)
+            return FALSE;
+        if (i > 0 && bccache_entry_cmp(&e[i - 1], &e[i]) >= 0)
+            return FALSE;
+    }
+    c->entries = e;
+    c->entry_count = h->entry_count;
+    return TRUE;
+}
+
+QJSBytecodeCache *qjs_bccache_open(const char *filename)
+{
+    QJSBytecodeCache *c;
+
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+    c->filename = strdup(filename);
+    if (!c->filename) {
+        free(c);
+        return NULL;
+    }
+    if (!bccache_map_file(c) && c->map) {
+        munmap(c->map, c->map_size);
+        c->map = NULL;
+        c->map_size = 0;
+    }
+    return c;
+}
+
+static QJSBCCacheNewEntry *bccache_find_new(QJSBytecodeCache *c,
+                                            const QJSBCCacheEntry *key)
+{
+    int i;
+    for(i = 0; i < c->new_count; i++) {
+        if (!bccache_entry_cmp(&c->new_entries[i].e, key))
+            return &c->new_entries[i];
+    }
+    return NULL;
+}
+
+static int bccache_add(QJSBytecodeCache *c, const QJSBCCacheEntry *key,
+                       const uint8_t *buf, size_t size)
+{
+    QJSBCCacheNewEntry *ne;
+
+    if (size > UINT32_MAX)
+        return -1;
+    if (c->new_count >= c->new_size) {
+        int new_size = c->new_size * 3 / 2 + 4;
+        ne = realloc(c->new_entries, sizeof(ne[0]) * new_size);
+        if (!ne)
+            return -1;
+        c->new_entries = ne;
+        c->new_size = new_size;
+    }
+    ne = &c->new_entries[c->new_count];
+    ne->data = malloc(size);
+    if (!ne->data)
+        return -1;
+    memcpy(ne->data, buf, size);
+    ne->e = *key;
+    ne->e.size = size;
+    ne->e.offset = 0;
+    c->new_count++;
+    return 0;
+}
+
+JSValue qjs_bccache_compile(QJSBytecodeCache *c, JSContext *ctx,
+                            const char *source, size_t source_len,
+                            const char *filename)
+{
+    const QJSBCCacheEntry *e;
+    QJSBCCacheNewEntry *ne;
+    QJSBCCacheEntry key;
+    JSValue obj;
+    uint8_t *buf;
+    size_t size;
+
+    key.hash = bccache_hash(0xcbf29ce484222325, (const uint8_t *)filename,
+                            strlen(filename) + 1);
+    key.hash = bccache_hash(key.hash, (const uint8_t *)source, source_len);
+    key.source_len = source_len;
+
+    /* the entries recompiled in this session replace the mapped ones */
+    ne = bccache_find_new(c, &key);
+    if (ne) {
+        obj = JS_ReadObject(ctx, ne->data, ne->e.size,
+                            JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
+        if (!JS_IsException(obj)) {
+            c->hit_count++;
+            return obj;
+        }
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    } else if (c->entry_count > 0) {
+        e = bsearch(&key, c->entries, c->entry_count, sizeof(*e),
+                    bccache_entry_cmp2);
+        if (e) {
+            obj = JS_ReadObject(ctx, c->map + e->offset, e->size,
+                                JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
+            if (!JS_IsException(obj)) {
+                c->hit_count++;
+                return obj;
+            }
+            /* invalid entry: recompile it */
+            JS_FreeValue(ctx, JS_GetException(ctx));
+        }
+    }
+
+    c->miss_count++;
+    obj = JS_Eval(ctx, source, source_len, filename,
+                  JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+    if (JS_IsException(obj) || ne)
+        return obj;
+    buf = JS_WriteObject(ctx, &size, obj, JS_WRITE_OBJ_BYTECODE);
+    if (!buf) {
+        /* the script is still usable */
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return obj;
+    }
+    bccache_add(c, &key, buf, size);
+    js_free_rt(JS_GetRuntime(ctx), buf);
+    return obj;
+}
+
+static int bccache_write(FILE *f, const void *buf, size_t len)
+{
+    return fwrite(buf, 1, len, f) == len ? 0 : -1;
+}
+
+int qjs_bccache_save(QJSBytecodeCache *c)
+{
+    QJSBCCacheHeader h;
+    QJSBCCacheEntry *tab, *e;
+    const uint8_t *data;
+    char *tmp_filename;
+    uint64_t offset;
+    uint32_t i, count;
+    int j, ret;
+    FILE *f;
+
+    if (c->new_count == 0)
+        return 0;
+
+    /* merge the mapped entries not replaced with the new ones */
+    qsort(c->new_entries, c->new_count, sizeof(c->new_entries[0]),
+          bccache_new_entry_cmp);
+    tab = malloc(sizeof(tab[0]) * ((size_t)c->entry_count + c->new_count));
+    if (!tab)
+        return -1;
+    count = 0;
+    i = 0;
+    j = 0;
+    while (i < c->entry_count || j < c->new_count) {
+        int cmp;
+        if (i >= c->entry_count)
+            cmp = 1;
+        else if (j >= c->new_count)
+            cmp = -1;
+        else
+            cmp = bccache_entry_cmp(&c->entries[i], &c->new_entries[j].e);
+        if (cmp < 0) {
+            tab[count++] = c->entries[i++];
+        } else {
+            /* the new entries are marked by offset = 0 */
+            tab[count++] = c->new_entries[j++].e;
+            if (cmp == 0)
+                i++;
+        }
+    }
+
+    tmp_filename = malloc(strlen(c->filename) + 5);
+    if (!tmp_filename) {
+        free(tab);
+        return -1;
+    }
+    strcpy(tmp_filename, c->filename);
+    strcat(tmp_filename, ".tmp");
+    f = fopen(tmp_filename, "wb");
+    if (!f)
+        goto fail;
+
+    h.magic = QJS_BCCACHE_MAGIC;
+    h.version = QJS_BCCACHE_VERSION;
+    h.entry_count = count;
+    h.reserved = 0;
+    ret = bccache_write(f, &h, sizeof(h));
+    offset = sizeof(h) + sizeof(tab[0]) * (uint64_t)count;
+    /* the data is written in the table order */
+    for(i = 0; i < count; i++) {
+        e = &tab[i];
+        e->offset = offset;
+        offset += e->size;
+    }
+    if (!ret)
+        ret = bccache_write(f, tab, sizeof(tab[0]) * count);
+    j = 0;
+    for(i = 0; i < count && !ret; i++) {
+        e = &tab[i];
+        if (j < c->new_count && !bccache_entry_cmp(e, &c->new_entries[j].e)) {
+            data = c->new_entries[j++].data;
+        } else {
+            const QJSBCCacheEntry *old;
+            old = bsearch(e, c->entries, c->entry_count, sizeof(*old),
+                          bccache_entry_cmp2);
+            data = c->map + old->offset;
+        }
+        ret = bccache_write(f, data, e->size);
+    }
+    if (fclose(f) != 0)
+        ret = -1;
+    /* the mapped file is replaced, not modified */
+    if (ret || rename(tmp_filename, c->filename) < 0) {
+        unlink(tmp_filename);
+        goto fail;
+    }
+    free(tmp_filename);
+    free(tab);
+    return 0;
+ fail:
+    free(tmp_filename);
+    free(tab);
+    return -1;
+}
+
+void qjs_bccache_close(QJSBytecodeCache *c)
+{
+    int i;
+
+    if (!c)
+        return;
+    for(i = 0; i < c->new_count; i++)
+        free(c->new_entries[i].data);
+    free(c->new_entries);
+    if (c->map)
+        munmap(c->map, c->map_size);
+    free(c->filename);
+    free(c);
+}
+
+void qjs_bccache_dump_stats(FILE *fp, const QJSBytecodeCache *c)
+{
+    fprintf(fp, "bytecode cache '%s': %u entries, %d new, %" PRId64 " hits, %" PRId64 " misses\n",
+            c->filename, c->entry_count, c->new_count,
+            c->hit_count, c->miss_count);
+}
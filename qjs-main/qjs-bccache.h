@@ -0,0 +1,29 @@
+#ifndef QJS_BCCACHE_H
+#define QJS_BCCACHE_H
+#include <stdio.h>
+#include "qjs.h"
+
+/* Persistent bytecode cache: a file of serialized compiled scripts
+   keyed by a hash of their file name and source. The file is mapped in
+   memory and an entry is only read when its script is requested; the
+   code of the functions is then used in place from the mapping.
+
+   The functions read from the cache reference the mapping: the cache
+   must be closed after the runtimes using it are freed. */
+
+typedef struct QJSBytecodeCache QJSBytecodeCache;
+
+/* a missing or invalid file gives an empty cache. Return NULL if out of
+   memory. */
+QJSBytecodeCache *qjs_bccache_open(const char *filename);
+/* compiled function of the script, read from the cache or compiled and
+   added to it. Return JS_EXCEPTION if the script cannot be compiled. */
+JSValue qjs_bccache_compile(QJSBytecodeCache *c, JSContext *ctx,
+                            const char *source, size_t source_len,
+                            const char *filename);
+/* write the cache file if entries were added. Return -1 if error. */
+int qjs_bccache_save(QJSBytecodeCache *c);
+void qjs_bccache_close(QJSBytecodeCache *c);
+void qjs_bccache_dump_stats(FILE *fp, const QJSBytecodeCache *c);
+
+#endif //QJS_BCCACHE_H
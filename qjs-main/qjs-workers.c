@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "cutils.h"
+#include "threadpool.h"
+#include "qjs-workers.h"
+
+/* Job deque of a worker. The owner pops from the bottom (most
+   recently queued first), the thieves take from the top. The jobs do
+   not create other jobs so the deques are filled once before the
+   workers start. */
+typedef struct QJSDeque {
+    pthread_mutex_t lock;
+    int32_t *tab;
+    int top;
+    int bottom;
+} QJSDeque;
+
+typedef struct QJSWorker {
+    QJSDeque deque;
+    int64_t done_count;
+    int64_t failed_count;
+    int64_t steal_count;
+    int64_t timeout_count;
+    /* shared with the watchdog */
+    pthread_mutex_t watch_lock;
+    JSRuntime *rt; /* NULL when the worker has no runtime */
+    int64_t job_start_ns; /* 0 when idle */
+    BOOL interrupted; /* the current job was interrupted */
+} __attribute__((aligned(64))) QJSWorker;
+
+typedef struct QJSWorkerPool {
+    QJSWorker *workers;
+    int worker_count;
+    const QJSJob *jobs;
+    int job_count;
+    int use_jit;
+    QJSContextInitFunc *init_func;
+    QJSJobFunc *func;
+    int64_t *latency_ns; /* indexed by job number */
+    int64_t timeout_ms;
+    /* watchdog */
+    pthread_mutex_t watchdog_lock;
+    pthread_cond_t watchdog_cond;
+    BOOL watchdog_stop;
+} QJSWorkerPool;
+
+static inline int64_t qjs_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int deque_pop(QJSDeque *d)
+{
+    int n = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top)
+        n = d->tab[--d->bottom];
+    pthread_mutex_unlock(&d->lock);
+    return n;
+}
+
+static int deque_steal(QJSDeque *d)
+{
+    int n = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top)
+        n = d->tab[d->top++];
+    pthread_mutex_unlock(&d->lock);
+    return n;
+}
+
+static int next_job(QJSWorkerPool *wp, int index)
+{
+    QJSWorker *w = &wp->workers[index];
+    int i, n;
+
+    n = deque_pop(&w->deque);
+    if (n >= 0)
+        return n;
+    for (i = 1; i < wp->worker_count; i++) {
+        n = deque_steal(&wp->workers[(index + i) % wp->worker_count].deque);
+        if (n >= 0) {
+            w->steal_count++;
+            return n;
+        }
+    }
+    return -1;
+}
+
+static void worker_set_job(QJSWorker *w, JSRuntime *rt, int64_t start_ns)
+{
+    pthread_mutex_lock(&w->watch_lock);
+    w->rt = rt;
+    w->job_start_ns = start_ns;
+    w->interrupted = FALSE;
+    pthread_mutex_unlock(&w->watch_lock);
+}
+
+static void worker_main(void *opaque, int index)
+{
+    QJSWorkerPool *wp = opaque;
+    QJSWorker *w = &wp->workers[index];
+    JSRuntime *rt;
+    JSContext *tmpl, *ctx;
+    int64_t t0;
+    int n, ret;
+
+    rt = JS_NewRuntime();
+    if (!rt)
+        return;
+    JS_SetJITEnabled(rt, wp->use_jit);
+    tmpl = JS_NewContext(rt);
+    if (!tmpl) {
+        /* the other workers will steal the jobs of this one */
+        JS_FreeRuntime(rt);
+        return;
+    }
+    if (wp->init_func && wp->init_func(tmpl)) {
+        JS_FreeContext(tmpl);
+        JS_FreeRuntime(rt);
+        return;
+    }
+    while ((n = next_job(wp, index)) >= 0) {
+        t0 = qjs_time_ns();
+        if (wp->timeout_ms > 0) {
+            /* publish the start time first so that an interrupt the
+               watchdog requested for the previous job is dropped by
+               the new budget */
+            worker_set_job(w, rt, t0);
+            JS_SetCPUTimeLimit(rt, wp->timeout_ms * 1000);
+        }
+        ctx = JS_CloneContext(tmpl);
+        if (ctx) {
+            ret = wp->func(ctx, &wp->jobs[n % wp->job_count]);
+            JS_FreeContext(ctx);
+        } else {
+            JS_FreeValue(tmpl, JS_GetException(tmpl));
+            ret = -1;
+        }
+        /* the watchdog must not time the idle worker */
+        if (wp->timeout_ms > 0)
+            worker_set_job(w, rt, 0);
+        wp->latency_ns[n] = qjs_time_ns() - t0;
+        w->done_count++;
+        if (ret < 0)
+            w->failed_count++;
+        /* whether the CPU time limit or the watchdog raised it */
+        if (ret == QJS_JOB_INTERRUPTED)
+            w->timeout_count++;
+    }
+    /* the watchdog must not see the runtime once it is freed */
+    worker_set_job(w, NULL, 0);
+    JS_FreeContext(tmpl);
+    JS_FreeRuntime(rt);
+}
+
+/* interrupt the jobs running for more than timeout_ms of wall clock
+   time, e.g. blocked on I/O between two interrupt polls. The CPU time
+   limit is checked by the runtimes themselves. */
+static void *watchdog_main(void *opaque)
+{
+    QJSWorkerPool *wp = opaque;
+    QJSWorker *w;
+    struct timespec ts;
+    int64_t period_ns, timeout_ns, now;
+    int i;
+
+    timeout_ns = wp->timeout_ms * 1000000;
+    period_ns = max_int(1, min_int(100, wp->timeout_ms / 4)) * 1000000;
+    pthread_mutex_lock(&wp->watchdog_lock);
+    while (!wp->watchdog_stop) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += period_ns;
+        ts.tv_sec += ts.tv_nsec / 1000000000;
+        ts.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&wp->watchdog_cond, &wp->watchdog_lock, &ts);
+        now = qjs_time_ns();
+        for (i = 0; i < wp->worker_count; i++) {
+            w = &wp->workers[i];
+            pthread_mutex_lock(&w->watch_lock);
+            if (w->rt && w->job_start_ns != 0 && !w->interrupted &&
+                now - w->job_start_ns > timeout_ns) {
+                JS_RequestInterrupt(w->rt);
+                w->interrupted = TRUE;
+            }
+            pthread_mutex_unlock(&w->watch_lock);
+        }
+    }
+    pthread_mutex_unlock(&wp->watchdog_lock);
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b, void *opaque)
+{
+    int64_t v1 = *(const int64_t *)a, v2 = *(const int64_t *)b;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static int64_t percentile(const int64_t *tab, int64_t n, int p)
+{
+    int64_t i;
+    if (n == 0)
+        return 0;
+    /* nearest rank */
+    i = (n * p + 99) / 100 - 1;
+    return tab[i < 0 ? 0 : i];
+}
+
+int qjs_run_workers(int worker_count, const QJSJob *jobs, int job_count,
+                    int repeat, int64_t timeout_ms, int use_jit,
+                    QJSContextInitFunc *init_func, QJSJobFunc *func,
+                    QJSWorkerStats *s)
+{
+    QJSWorkerPool wp_s, *wp = &wp_s;
+    JSThreadPool *tp;
+    QJSWorker *w;
+    pthread_t watchdog;
+    BOOL has_watchdog = FALSE;
+    int64_t t0, total, done_count;
+    int i, n, ret = -1;
+
+    memset(s, 0, sizeof(*s));
+    if (job_count <= 0 || repeat <= 0)
+        return 0;
+    if ((int64_t)job_count * repeat > INT32_MAX)
+        return -1;
+    total = (int64_t)job_count * repeat;
+    tp = js_thread_pool_new(worker_count);
+    if (!tp)
+        return -1;
+    memset(wp, 0, sizeof(*wp));
+    wp->worker_count = js_thread_pool_get_thread_count(tp);
+    wp->jobs = jobs;
+    wp->job_count = job_count;
+    wp->use_jit = use_jit;
+    wp->init_func = init_func;
+    wp->func = func;
+    wp->timeout_ms = timeout_ms;
+    pthread_mutex_init(&wp->watchdog_lock, NULL);
+    pthread_cond_init(&wp->watchdog_cond, NULL);
+    wp->latency_ns = malloc(sizeof(wp->latency_ns[0]) * total);
+    wp->workers = aligned_alloc(64, sizeof(wp->workers[0]) * wp->worker_count);
+    if (!wp->latency_ns || !wp->workers)
+        goto done;
+    memset(wp->workers, 0, sizeof(wp->workers[0]) * wp->worker_count);
+    for (i = 0; i < wp->worker_count; i++) {
+        w = &wp->workers[i];
+        pthread_mutex_init(&w->deque.lock, NULL);
+        pthread_mutex_init(&w->watch_lock, NULL);
+        w->deque.tab = malloc(sizeof(w->deque.tab[0]) *
+                              (total / wp->worker_count + 1));
+        if (!w->deque.tab)
+            goto done;
+    }
+    /* round robin distribution. The owner pops from the bottom so the
+       jobs are pushed in reverse order to run them in input order. */
+    for (n = total - 1; n >= 0; n--) {
+        w = &wp->workers[n % wp->worker_count];
+        w->deque.tab[w->deque.bottom++] = n;
+    }
+
+    if (timeout_ms > 0) {
+        if (pthread_create(&watchdog, NULL, watchdog_main, wp))
+            goto done;
+        has_watchdog = TRUE;
+    }
+    t0 = qjs_time_ns();
+    js_thread_pool_run(tp, worker_main, wp, wp->worker_count);
+    s->total_ns = qjs_time_ns() - t0;
+    if (has_watchdog) {
+        pthread_mutex_lock(&wp->watchdog_lock);
+        wp->watchdog_stop = TRUE;
+        pthread_cond_signal(&wp->watchdog_cond);
+        pthread_mutex_unlock(&wp->watchdog_lock);
+        pthread_join(watchdog, NULL);
+    }
+
+    done_count = 0;
+    for (i = 0; i < wp->worker_count; i++) {
+        w = &wp->workers[i];
+        done_count += w->done_count;
+        s->failed_count += w->failed_count;
+        s->steal_count += w->steal_count;
+        s->timeout_count += w->timeout_count;
+    }
+    s->worker_count = wp->worker_count;
+    s->job_count = done_count;
+    if (done_count == total) {
+        rqsort(wp->latency_ns, total, sizeof(wp->latency_ns[0]), cmp_i64, NULL);
+        s->p50_ns = percentile(wp->latency_ns, total, 50);
+        s->p90_ns = percentile(wp->latency_ns, total, 90);
+        s->p99_ns = percentile(wp->latency_ns, total, 99);
+        s->max_ns = wp->latency_ns[total - 1];
+        ret = 0;
+    }
+ done:
+    if (wp->workers) {
+        for (i = 0; i < wp->worker_count; i++) {
+            free(wp->workers[i].deque.tab);
+            pthread_mutex_destroy(&wp->workers[i].deque.lock);
+            pthread_mutex_destroy(&wp->workers[i].watch_lock);
+        }
+    }
+    pthread_cond_destroy(&wp->watchdog_cond);
+    pthread_mutex_destroy(&wp->watchdog_lock);
+    free(wp->workers);
+    free(wp->latency_ns);
+    js_thread_pool_free(tp);
+    return ret;
+}
+
+void qjs_dump_worker_stats(FILE *fp, const QJSWorkerStats *s)
+{
+    fprintf(fp, "%-12s %d\n", "workers", s->worker_count);
+    fprintf(fp, "%-12s %"PRId64" (%"PRId64" failed, %"PRId64" stolen, "
+            "%"PRId64" timed out)\n", "jobs", s->job_count, s->failed_count,
+            s->steal_count, s->timeout_count);
+    fprintf(fp, "%-12s %0.1f ms\n", "time", s->total_ns / 1e6);
+    if (s->total_ns > 0) {
+        fprintf(fp, "%-12s %0.1f jobs/s\n", "throughput",
+                s->job_count * 1e9 / s->total_ns);
+    }
+    fprintf(fp, "%-12s p50 %0.1f  p90 %0.1f  p99 %0.1f  max %0.1f us\n",
+            "latency", s->p50_ns / 1e3, s->p90_ns / 1e3, s->p99_ns / 1e3,
+            s->max_ns / 1e3);
+}
@@ -0,0 +1,54 @@
+#ifndef QJS_WORKERS_H
+#define QJS_WORKERS_H
+#include <stdint.h>
+#include "qjs.h"
+
+/* Multi-isolate mode: each worker thread owns a JSRuntime and runs
+   the jobs in a fresh context cloned from its template context. The
+   jobs are distributed round robin to per-worker deques; an idle worker
+   steals from the others. */
+
+typedef enum {
+    QJS_JOB_FILE,   /* 'str' is a file name */
+    QJS_JOB_SOURCE, /* 'str' is the script source */
+} QJSJobTypeEnum;
+
+typedef struct QJSJob {
+    QJSJobTypeEnum type;
+    const char *str;
+} QJSJob;
+
+/* run one job in 'ctx'. Return 0 if OK, -1 if the job failed,
+   QJS_JOB_INTERRUPTED if it was stopped by an interrupt. */
+#define QJS_JOB_INTERRUPTED (-2)
+typedef int QJSJobFunc(JSContext *ctx, const QJSJob *job);
+
+/* initialize the template context of a worker, from which the context
+   of each job is cloned. Return -1 if error. */
+typedef int QJSContextInitFunc(JSContext *ctx);
+
+typedef struct QJSWorkerStats {
+    int worker_count;
+    int64_t job_count;
+    int64_t failed_count;
+    int64_t steal_count;
+    int64_t timeout_count; /* jobs stopped by the CPU time limit or
+                              the watchdog */
+    int64_t total_ns; /* wall clock time */
+    /* job latency percentiles */
+    int64_t p50_ns, p90_ns, p99_ns, max_ns;
+} QJSWorkerStats;
+
+/* run 'job_count' jobs, each one 'repeat' times, on 'worker_count'
+   threads (<= 0 for the number of CPUs). If 'timeout_ms' > 0, a job is
+   interrupted when it exceeds 'timeout_ms' of CPU time or, as seen by
+   a watchdog thread, of wall clock time. 'use_jit' is given to
+   JS_SetJITEnabled() for the runtime of each worker. Return -1 if
+   error. */
+int qjs_run_workers(int worker_count, const QJSJob *jobs, int job_count,
+                    int repeat, int64_t timeout_ms, int use_jit,
+                    QJSContextInitFunc *init_func, QJSJobFunc *func,
+                    QJSWorkerStats *s);
+void qjs_dump_worker_stats(FILE *fp, const QJSWorkerStats *s);
+
+#endif //QJS_WORKERS_H
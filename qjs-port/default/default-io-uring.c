@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "default-io-uring.h"
+
+#define URING_OFF(base_p, off) ((uint32_t *) ((uint8_t *) (base_p) + (off)))
+
+/**
+ * Create the ring and map its queues.
+ *
+ * @return 0 if OK, -errno otherwise (e.g. -ENOSYS on old kernels or
+ *         when io_uring is disabled by a seccomp filter)
+ */
+int
+jerry_port_uring_init (jerry_port_uring_t *ring_p, /**< ring */
+                       uint32_t entries) /**< submission queue size */
+{
+    struct io_uring_params params;
+    int fd, err;
+
+    memset (ring_p, 0, sizeof (*ring_p));
+    ring_p->ring_fd = -1;
+    memset (&params, 0, sizeof (params));
+    fd = (int) syscall (__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    ring_p->ring_fd = fd;
+    ring_p->sq_entries = params.sq_entries;
+    ring_p->cq_entries = params.cq_entries;
+
+    ring_p->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof (uint32_t);
+    ring_p->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring_p->cq_ring_size > ring_p->sq_ring_size)
+        {
+            ring_p->sq_ring_size = ring_p->cq_ring_size;
+        }
+        ring_p->cq_ring_size = 0;
+    }
+    ring_p->sq_ring_p = mmap (NULL, ring_p->sq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring_p->sq_ring_p == MAP_FAILED)
+    {
+        ring_p->sq_ring_p = NULL;
+        goto fail;
+    }
+    if (ring_p->cq_ring_size == 0)
+    {
+        ring_p->cq_ring_p = ring_p->sq_ring_p;
+    }
+    else
+    {
+        ring_p->cq_ring_p = mmap (NULL, ring_p->cq_ring_size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring_p->cq_ring_p == MAP_FAILED)
+        {
+            ring_p->cq_ring_p = NULL;
+            goto fail;
+        }
+    }
+    ring_p->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+    ring_p->sqes_p = mmap (NULL, ring_p->sqes_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring_p->sqes_p == MAP_FAILED)
+    {
+        ring_p->sqes_p = NULL;
+        goto fail;
+    }
+
+    ring_p->sq_head_p = URING_OFF (ring_p->sq_ring_p, params.sq_off.head);
+    ring_p->sq_tail_p = URING_OFF (ring_p->sq_ring_p, params.sq_off.tail);
+    ring_p->sq_mask_p = URING_OFF (ring_p->sq_ring_p, params.sq_off.ring_mask);
+    ring_p->sq_array_p = URING_OFF (ring_p->sq_ring_p, params.sq_off.array);
+    ring_p->cq_head_p = URING_OFF (ring_p->cq_ring_p, params.cq_off.head);
+    ring_p->cq_tail_p = URING_OFF (ring_p->cq_ring_p, params.cq_off.tail);
+    ring_p->cq_mask_p = URING_OFF (ring_p->cq_ring_p, params.cq_off.ring_mask);
+    ring_p->cqes_p = (struct io_uring_cqe *) ((uint8_t *) ring_p->cq_ring_p + params.cq_off.cqes);
+    return 0;
+
+fail:
+    err = -errno;
+    jerry_port_uring_free (ring_p);
+    return err;
+} /* jerry_port_uring_init */
+
+void
+jerry_port_uring_free (jerry_port_uring_t *ring_p) /**< ring */
+{
+    if (ring_p->sqes_p)
+    {
+        munmap (ring_p->sqes_p, ring_p->sqes_size);
+    }
+    if (ring_p->cq_ring_p && ring_p->cq_ring_p != ring_p->sq_ring_p)
+    {
+        munmap (ring_p->cq_ring_p, ring_p->cq_ring_size);
+    }
+    if (ring_p->sq_ring_p)
+    {
+        munmap (ring_p->sq_ring_p, ring_p->sq_ring_size);
+    }
+    if (ring_p->ring_fd >= 0)
+    {
+        close (ring_p->ring_fd);
+    }
+    memset (ring_p, 0, sizeof (*ring_p));
+    ring_p->ring_fd = -1;
+} /* jerry_port_uring_free */
+
+/**
+ * Queue a read or a write. The entry is handed to the kernel by the
+ * next jerry_port_uring_submit, so a loop iteration submits all its
+ * requests with a single system call.
+ *
+ * @return false if the submission queue is full
+ */
+bool
+jerry_port_uring_queue (jerry_port_uring_t *ring_p, /**< ring */
+                        bool is_write, /**< write or read */
+                        int fd, /**< file descriptor */
+                        void *buf_p, /**< buffer */
+                        uint32_t len, /**< byte count */
+                        uint64_t offset, /**< file offset */
+                        uint64_t user_data) /**< returned with the completion */
+{
+    struct io_uring_sqe *sqe_p;
+    uint32_t tail, head, index;
+
+    tail = *ring_p->sq_tail_p;
+    head = __atomic_load_n (ring_p->sq_head_p, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring_p->sq_entries)
+    {
+        return false;
+    }
+    index = tail & *ring_p->sq_mask_p;
+    sqe_p = &ring_p->sqes_p[index];
+    memset (sqe_p, 0, sizeof (*sqe_p));
+    sqe_p->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe_p->fd = fd;
+    sqe_p->off = offset;
+    sqe_p->addr = (uint64_t) (uintptr_t) buf_p;
+    sqe_p->len = len;
+    sqe_p->user_data = user_data;
+    ring_p->sq_array_p[index] = index;
+    __atomic_store_n (ring_p->sq_tail_p, tail + 1, __ATOMIC_RELEASE);
+    ring_p->to_submit++;
+    return true;
+} /* jerry_port_uring_queue */
+
+/**
+ * Submit the queued entries and wait for 'min_complete' completions.
+ *
+ * @return 0 if OK, -errno otherwise
+ */
+int
+jerry_port_uring_submit (jerry_port_uring_t *ring_p, /**< ring */
+                         uint32_t min_complete) /**< completions to wait for */
+{
+    int ret;
+
+    for (;;)
+    {
+        ret = (int) syscall (__NR_io_uring_enter, ring_p->ring_fd, ring_p->to_submit, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0)
+        {
+            ring_p->to_submit -= (uint32_t) ret;
+            return 0;
+        }
+        if (errno != EINTR)
+        {
+            return -errno;
+        }
+    }
+} /* jerry_port_uring_submit */
+
+/**
+ * Call 'cb' for each available completion.
+ *
+ * @return number of completions
+ */
+uint32_t
+jerry_port_uring_reap (jerry_port_uring_t *ring_p, /**< ring */
+                       jerry_port_uring_cb_t cb) /**< completion callback */
+{
+    struct io_uring_cqe *cqe_p;
+    uint64_t user_data;
+    uint32_t head, tail, count = 0;
+    int32_t res;
+
+    head = *ring_p->cq_head_p;
+    tail = __atomic_load_n (ring_p->cq_tail_p, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        cqe_p = &ring_p->cqes_p[head & *ring_p->cq_mask_p];
+        user_data = cqe_p->user_data;
+        res = cqe_p->res;
+        head++;
+        /* release the entry first: the callback may queue new requests */
+        __atomic_store_n (ring_p->cq_head_p, head, __ATOMIC_RELEASE);
+        cb (user_data, res);
+        count++;
+    }
+    return count;
+} /* jerry_port_uring_reap */
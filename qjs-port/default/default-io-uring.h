@@ -0,0 +1,47 @@
+#ifndef QJS_PORT_DEFAULT_IO_URING_H
+#define QJS_PORT_DEFAULT_IO_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Minimal io_uring ring driven by the raw system calls (no liburing).
+ * The ring fd is readable when completions are available so the event
+ * loop polls it with epoll like any other fd.
+ */
+typedef struct
+{
+    int ring_fd;
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t to_submit; /**< queued but not yet submitted entries */
+    /* submission queue */
+    uint32_t *sq_head_p;
+    uint32_t *sq_tail_p;
+    uint32_t *sq_mask_p;
+    uint32_t *sq_array_p;
+    struct io_uring_sqe *sqes_p;
+    /* completion queue */
+    uint32_t *cq_head_p;
+    uint32_t *cq_tail_p;
+    uint32_t *cq_mask_p;
+    struct io_uring_cqe *cqes_p;
+    /* mappings */
+    void *sq_ring_p;
+    size_t sq_ring_size;
+    void *cq_ring_p;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} jerry_port_uring_t;
+
+typedef void (*jerry_port_uring_cb_t) (uint64_t user_data, int32_t res);
+
+int jerry_port_uring_init (jerry_port_uring_t *ring_p, uint32_t entries);
+void jerry_port_uring_free (jerry_port_uring_t *ring_p);
+bool jerry_port_uring_queue (jerry_port_uring_t *ring_p, bool is_write, int fd, void *buf_p,
+                             uint32_t len, uint64_t offset, uint64_t user_data);
+int jerry_port_uring_submit (jerry_port_uring_t *ring_p, uint32_t min_complete);
+uint32_t jerry_port_uring_reap (jerry_port_uring_t *ring_p, jerry_port_uring_cb_t cb);
+
+#endif /* !QJS_PORT_DEFAULT_IO_URING_H */
@@ -0,0 +1,1040 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
+#include "qjs-port.h"
+#include "qjs-port-loop.h"
+#ifdef JERRY_PORT_IO_URING
+#include "default-io-uring.h"
+#endif /* JERRY_PORT_IO_URING */
+
+#define LOOP_MAX_EVENTS 64
+#define LOOP_URING_ENTRIES 256
+/* time given to the pending jobs in one iteration, the remaining jobs
+   run after the next poll so the I/O is not starved */
+#define LOOP_JOB_BUDGET_US 10000
+/* readFile decodes the file as it is read, one chunk at a time */
+#define LOOP_READ_CHUNK_SIZE 65536
+
+/* script timer ids: slot index in the low bits, sequence number in the
+   high bits so that a stale id does not cancel a new timer */
+#define LOOP_TIMER_INDEX_BITS 20
+#define LOOP_TIMER_INDEX_MASK ((1 << LOOP_TIMER_INDEX_BITS) - 1)
+#define LOOP_TIMER_SEQ_MASK ((1 << (31 - LOOP_TIMER_INDEX_BITS)) - 1)
+
+typedef struct
+{
+    uint32_t events;
+    jerry_port_fd_cb_t cb;
+    void *user_p;
+} jerry_port_fd_handler_t;
+
+/**
+ * setTimeout and setInterval state.
+ */
+typedef struct
+{
+    jerry_port_timer_t timer;
+    jerry_port_loop_t *loop_p;
+  JSContext *ctx;
+  JSValue func;
+    int64_t interval_ms; /**< -1 for setTimeout */
+    int32_t id;
+} jerry_port_js_timer_t;
+
+/**
+ * readFile state.
+ */
+typedef struct jerry_port_js_read_t
+{
+    jerry_port_io_t io;
+    struct jerry_port_js_read_t *next_p; /**< list of the pending reads */
+    struct jerry_port_js_read_t *prev_p;
+    jerry_port_loop_t *loop_p;
+  JSContext *ctx;
+  JSValue func;
+    int fd;
+    JSStringDecoder *decoder_p; /**< content decoded so far */
+    size_t size; /**< file size, 0 if unknown */
+    size_t pos;
+    char buf[LOOP_READ_CHUNK_SIZE]; /**< chunk being read */
+} jerry_port_js_read_t;
+
+struct jerry_port_loop_t
+{
+  JSRuntime *rt;
+    int epoll_fd;
+    bool is_freeing;
+    jerry_port_timer_wheel_t wheel;
+
+    /* fd handlers indexed by fd */
+    jerry_port_fd_handler_t *fd_handlers_p;
+    int fd_handler_size;
+    int fd_count; /**< watched fds, including the internal ones */
+    int internal_fd_count;
+
+    /* file I/O */
+#ifdef JERRY_PORT_IO_URING
+    bool has_uring;
+    jerry_port_uring_t ring;
+    uint32_t uring_inflight;
+#endif /* JERRY_PORT_IO_URING */
+    uint32_t io_inflight; /**< requests whose callback is not called yet */
+    jerry_port_io_t *io_done_p; /**< completed synchronously, to be reported */
+    jerry_port_io_t *io_done_last_p;
+
+    /* scripts */
+    jerry_port_js_timer_t **js_timers_p; /**< indexed by timer id */
+    uint32_t *js_timer_free_p; /**< free slots */
+    uint32_t js_timer_size;
+    uint32_t js_timer_free_count;
+    uint32_t js_timer_seq;
+    jerry_port_js_read_t js_reads; /**< list head */
+};
+
+static inline uint64_t
+loop_clock_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+} /* loop_clock_ms */
+
+static inline int64_t
+loop_clock_us (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+} /* loop_clock_us */
+
+static int loop_watch_fd (jerry_port_loop_t *loop_p, int fd, uint32_t events,
+                          jerry_port_fd_cb_t cb, void *user_p);
+
+#ifdef JERRY_PORT_IO_URING
+static void
+loop_uring_complete (uint64_t user_data, /**< request */
+                     int32_t res) /**< result */
+{
+    jerry_port_io_t *io_p = (jerry_port_io_t *) (uintptr_t) user_data;
+
+    io_p->result = res;
+    io_p->cb (io_p, res);
+} /* loop_uring_complete */
+
+static void
+loop_uring_reap (jerry_port_loop_t *loop_p) /**< loop */
+{
+    uint32_t n;
+
+    n = jerry_port_uring_reap (&loop_p->ring, loop_uring_complete);
+    loop_p->uring_inflight -= n;
+    loop_p->io_inflight -= n;
+} /* loop_uring_reap */
+
+static void
+loop_uring_ready (jerry_port_loop_t *loop_p, /**< loop */
+                  int fd, /**< ring fd */
+                  uint32_t events, /**< events */
+                  void *user_p) /**< unused */
+{
+    (void) fd;
+    (void) events;
+    (void) user_p;
+    loop_uring_reap (loop_p);
+} /* loop_uring_ready */
+#endif /* JERRY_PORT_IO_URING */
+
+/**
+ * Create an event loop for 'rt'. The loop is stored as the runtime
+ * opaque so that the script functions can find it.
+ *
+ * @return NULL if error
+ */
+jerry_port_loop_t *
+jerry_port_loop_new (JSRuntime *rt) /**< runtime */
+{
+    jerry_port_loop_t *loop_p;
+
+    loop_p = calloc (1, sizeof (*loop_p));
+    if (!loop_p)
+    {
+        return NULL;
+    }
+    loop_p->rt = rt;
+    loop_p->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (loop_p->epoll_fd < 0)
+    {
+        free (loop_p);
+        return NULL;
+    }
+    jerry_port_timer_wheel_init (&loop_p->wheel, loop_clock_ms ());
+    loop_p->js_reads.next_p = &loop_p->js_reads;
+    loop_p->js_reads.prev_p = &loop_p->js_reads;
+
+#ifdef JERRY_PORT_IO_URING
+    /* the synchronous backend is used if the kernel refuses the ring */
+    if (jerry_port_uring_init (&loop_p->ring, LOOP_URING_ENTRIES) == 0)
+    {
+        if (loop_watch_fd (loop_p, loop_p->ring.ring_fd, JERRY_PORT_LOOP_READ, loop_uring_ready, NULL) == 0)
+        {
+            loop_p->has_uring = true;
+            loop_p->internal_fd_count++;
+        }
+        else
+        {
+            jerry_port_uring_free (&loop_p->ring);
+        }
+    }
+#endif /* JERRY_PORT_IO_URING */
+
+    if (rt)
+    {
+        JS_SetRuntimeOpaque (rt, loop_p);
+    }
+    return loop_p;
+} /* jerry_port_loop_new */
+
+/**
+ * Return the loop of a runtime or NULL.
+ */
+jerry_port_loop_t *
+jerry_port_loop_get (JSRuntime *rt) /**< runtime */
+{
+    return JS_GetRuntimeOpaque (rt);
+} /* jerry_port_loop_get */
+
+bool
+jerry_port_loop_has_io_uring (jerry_port_loop_t *loop_p) /**< loop */
+{
+#ifdef JERRY_PORT_IO_URING
+    return loop_p->has_uring;
+#else /* !JERRY_PORT_IO_URING */
+    (void) loop_p;
+    return false;
+#endif /* JERRY_PORT_IO_URING */
+} /* jerry_port_loop_has_io_uring */
+
+/**
+ * Return the current time in milliseconds (monotonic clock).
+ */
+uint64_t
+jerry_port_loop_now (jerry_port_loop_t *loop_p) /**< loop */
+{
+    (void) loop_p;
+    return loop_clock_ms ();
+} /* jerry_port_loop_now */
+
+void
+jerry_port_loop_add_timer (jerry_port_loop_t *loop_p, /**< loop */
+                           jerry_port_timer_t *timer_p, /**< timer */
+                           int64_t delay_ms) /**< delay */
+{
+    if (delay_ms < 0)
+    {
+        delay_ms = 0;
+    }
+    jerry_port_timer_add (&loop_p->wheel, timer_p, loop_clock_ms () + (uint64_t) delay_ms);
+} /* jerry_port_loop_add_timer */
+
+void
+jerry_port_loop_remove_timer (jerry_port_loop_t *loop_p, /**< loop */
+                              jerry_port_timer_t *timer_p) /**< timer */
+{
+    jerry_port_timer_remove (&loop_p->wheel, timer_p);
+} /* jerry_port_loop_remove_timer */
+
+static int
+loop_watch_fd (jerry_port_loop_t *loop_p, /**< loop */
+               int fd, /**< file descriptor */
+               uint32_t events, /**< JERRY_PORT_LOOP_x, 0 to stop watching */
+               jerry_port_fd_cb_t cb, /**< callback */
+               void *user_p) /**< callback argument */
+{
+    jerry_port_fd_handler_t *handler_p;
+    struct epoll_event ev;
+    int op, new_size;
+
+    if (fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (fd >= loop_p->fd_handler_size)
+    {
+        if (events == 0)
+        {
+            return 0;
+        }
+        new_size = loop_p->fd_handler_size ? loop_p->fd_handler_size : 64;
+        while (new_size <= fd)
+        {
+            new_size *= 2;
+        }
+        handler_p = realloc (loop_p->fd_handlers_p, sizeof (*handler_p) * (size_t) new_size);
+        if (!handler_p)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        memset (handler_p + loop_p->fd_handler_size, 0,
+                sizeof (*handler_p) * (size_t) (new_size - loop_p->fd_handler_size));
+        loop_p->fd_handlers_p = handler_p;
+        loop_p->fd_handler_size = new_size;
+    }
+
+    handler_p = &loop_p->fd_handlers_p[fd];
+    memset (&ev, 0, sizeof (ev));
+    ev.data.fd = fd;
+    if (events & JERRY_PORT_LOOP_READ)
+    {
+        ev.events |= EPOLLIN;
+    }
+    if (events & JERRY_PORT_LOOP_WRITE)
+    {
+        ev.events |= EPOLLOUT;
+    }
+    if (events == 0)
+    {
+        op = EPOLL_CTL_DEL;
+    }
+    else if (handler_p->events == 0)
+    {
+        op = EPOLL_CTL_ADD;
+    }
+    else
+    {
+        op = EPOLL_CTL_MOD;
+    }
+    if (op == EPOLL_CTL_DEL && handler_p->events == 0)
+    {
+        return 0;
+    }
+    if (epoll_ctl (loop_p->epoll_fd, op, fd, &ev) < 0)
+    {
+        return -1;
+    }
+    if (op == EPOLL_CTL_ADD)
+    {
+        loop_p->fd_count++;
+    }
+    else if (op == EPOLL_CTL_DEL)
+    {
+        loop_p->fd_count--;
+    }
+    handler_p->events = events;
+    handler_p->cb = events ? cb : NULL;
+    handler_p->user_p = events ? user_p : NULL;
+    return 0;
+} /* loop_watch_fd */
+
+/**
+ * Call 'cb' when 'fd' is readable or writable, as selected by 'events'.
+ * The watch is level triggered. Passing 0 as 'events' stops watching.
+ *
+ * @return 0 if OK, -1 otherwise (errno is set)
+ */
+int
+jerry_port_loop_watch_fd (jerry_port_loop_t *loop_p, /**< loop */
+                          int fd, /**< file descriptor */
+                          uint32_t events, /**< JERRY_PORT_LOOP_x, 0 to stop watching */
+                          jerry_port_fd_cb_t cb, /**< callback */
+                          void *user_p) /**< callback argument */
+{
+    return loop_watch_fd (loop_p, fd, events & (JERRY_PORT_LOOP_READ | JERRY_PORT_LOOP_WRITE), cb, user_p);
+} /* jerry_port_loop_watch_fd */
+
+static int
+loop_io (jerry_port_loop_t *loop_p, /**< loop */
+         jerry_port_io_t *io_p, /**< request */
+         bool is_write, /**< write or read */
+         int fd, /**< file descriptor */
+         void *buf_p, /**< buffer */
+         size_t len, /**< byte count */
+         uint64_t offset) /**< file offset */
+{
+    ssize_t res;
+
+    if (len > INT32_MAX)
+    {
+        len = INT32_MAX;
+    }
+    io_p->next_p = NULL;
+#ifdef JERRY_PORT_IO_URING
+    /* keep room in the completion queue for all the requests */
+    if (loop_p->has_uring && loop_p->uring_inflight < loop_p->ring.cq_entries)
+    {
+        if (!jerry_port_uring_queue (&loop_p->ring, is_write, fd, buf_p, (uint32_t) len,
+                                     offset, (uint64_t) (uintptr_t) io_p))
+        {
+            jerry_port_uring_submit (&loop_p->ring, 0);
+            if (!jerry_port_uring_queue (&loop_p->ring, is_write, fd, buf_p, (uint32_t) len,
+                                         offset, (uint64_t) (uintptr_t) io_p))
+            {
+                goto sync_io;
+            }
+        }
+        loop_p->uring_inflight++;
+        loop_p->io_inflight++;
+        return 0;
+    }
+sync_io:
+#endif /* JERRY_PORT_IO_URING */
+    /* synchronous backend: the result is reported by the next
+       iteration so the callback never runs before this call returns */
+    do
+    {
+        if (is_write)
+        {
+            res = pwrite (fd, buf_p, len, (off_t) offset);
+        }
+        else
+        {
+            res = pread (fd, buf_p, len, (off_t) offset);
+        }
+    }
+    while (res < 0 && errno == EINTR);
+    io_p->result = res < 0 ? -errno : res;
+    if (loop_p->io_done_p)
+    {
+        loop_p->io_done_last_p->next_p = io_p;
+    }
+    else
+    {
+        loop_p->io_done_p = io_p;
+    }
+    loop_p->io_done_last_p = io_p;
+    loop_p->io_inflight++;
+    return 0;
+} /* loop_io */
+
+/**
+ * Start an asynchronous read at 'offset'. io_p->cb is called by the loop
+ * with the byte count or -errno.
+ *
+ * @return 0 (the errors are reported to the callback)
+ */
+int
+jerry_port_loop_read (jerry_port_loop_t *loop_p, /**< loop */
+                      jerry_port_io_t *io_p, /**< request, cb must be set */
+                      int fd, /**< file descriptor */
+                      void *buf_p, /**< destination */
+                      size_t len, /**< byte count */
+                      uint64_t offset) /**< file offset */
+{
+    return loop_io (loop_p, io_p, false, fd, buf_p, len, offset);
+} /* jerry_port_loop_read */
+
+int
+jerry_port_loop_write (jerry_port_loop_t *loop_p, /**< loop */
+                       jerry_port_io_t *io_p, /**< request, cb must be set */
+                       int fd, /**< file descriptor */
+                       const void *buf_p, /**< source */
+                       size_t len, /**< byte count */
+                       uint64_t offset) /**< file offset */
+{
+    return loop_io (loop_p, io_p, true, fd, (void *) buf_p, len, offset);
+} /* jerry_port_loop_write */
+
+static void
+loop_report_io_done (jerry_port_loop_t *loop_p) /**< loop */
+{
+    jerry_port_io_t *io_p, *next_p;
+
+    /* the callbacks may start new requests */
+    io_p = loop_p->io_done_p;
+    loop_p->io_done_p = NULL;
+    loop_p->io_done_last_p = NULL;
+    for (; io_p; io_p = next_p)
+    {
+        next_p = io_p->next_p;
+        loop_p->io_inflight--;
+        io_p->cb (io_p, io_p->result);
+    }
+} /* loop_report_io_done */
+
+static void
+loop_dump_error (JSContext *ctx) /**< context with a pending exception */
+{
+    JSValue exception_val;
+    const char *str;
+
+    exception_val = JS_GetException (ctx);
+    str = JS_ToCString (ctx, exception_val);
+    if (str)
+    {
+        jerry_port_log (JERRY_LOG_LEVEL_WARNING, "%s\n", str);
+        JS_FreeCString (ctx, str);
+    }
+    else
+    {
+        JS_FreeValue (ctx, JS_GetException (ctx));
+        jerry_port_log (JERRY_LOG_LEVEL_WARNING, "[exception]\n");
+    }
+    JS_FreeValue (ctx, exception_val);
+} /* loop_dump_error */
+
+static bool
+loop_is_alive (jerry_port_loop_t *loop_p) /**< loop */
+{
+    return (loop_p->wheel.count != 0
+            || loop_p->fd_count > loop_p->internal_fd_count
+            || loop_p->io_inflight != 0
+            || (loop_p->rt && JS_IsJobPending (loop_p->rt)));
+} /* loop_is_alive */
+
+/**
+ * Run one iteration: submit the queued I/O, wait at most 'timeout_ms'
+ * (no limit if < 0) for an event, call the fd, I/O and timer callbacks
+ * then run the pending jobs. The exceptions raised by the jobs are
+ * logged.
+ *
+ * @return 1 if the loop has more work, 0 otherwise
+ */
+int
+jerry_port_loop_run_once (jerry_port_loop_t *loop_p, /**< loop */
+                          int timeout_ms) /**< maximum wait */
+{
+    struct epoll_event events[LOOP_MAX_EVENTS];
+    jerry_port_fd_handler_t *handler_p;
+    JSContext *ctx;
+    uint64_t now, deadline;
+    int64_t ticks, job_deadline, job_budget;
+    uint32_t ev;
+    int i, n;
+
+#ifdef JERRY_PORT_IO_URING
+    if (loop_p->has_uring && loop_p->ring.to_submit != 0)
+    {
+        jerry_port_uring_submit (&loop_p->ring, 0);
+    }
+#endif /* JERRY_PORT_IO_URING */
+
+    if (loop_p->io_done_p || (loop_p->rt && JS_IsJobPending (loop_p->rt)))
+    {
+        timeout_ms = 0;
+    }
+    else if ((ticks = jerry_port_timer_wheel_timeout (&loop_p->wheel)) >= 0)
+    {
+        deadline = loop_p->wheel.now + (uint64_t) ticks;
+        now = loop_clock_ms ();
+        ticks = deadline > now ? (int64_t) (deadline - now) : 0;
+        if (timeout_ms < 0 || ticks < timeout_ms)
+        {
+            timeout_ms = (int) ticks;
+        }
+    }
+    else if (!loop_is_alive (loop_p))
+    {
+        return 0;
+    }
+
+    n = epoll_wait (loop_p->epoll_fd, events, LOOP_MAX_EVENTS, timeout_ms);
+    for (i = 0; i < n; i++)
+    {
+        /* a previous callback may have removed the handler */
+        if (events[i].data.fd >= loop_p->fd_handler_size)
+        {
+            continue;
+        }
+        handler_p = &loop_p->fd_handlers_p[events[i].data.fd];
+        if (!handler_p->cb)
+        {
+            continue;
+        }
+        ev = 0;
+        if (events[i].events & EPOLLIN)
+        {
+            ev |= JERRY_PORT_LOOP_READ;
+        }
+        if (events[i].events & EPOLLOUT)
+        {
+            ev |= JERRY_PORT_LOOP_WRITE;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+        {
+            ev |= JERRY_PORT_LOOP_ERROR;
+        }
+        handler_p->cb (loop_p, events[i].data.fd, ev, handler_p->user_p);
+    }
+
+    loop_report_io_done (loop_p);
+    jerry_port_timer_wheel_advance (&loop_p->wheel, loop_clock_ms ());
+
+    if (loop_p->rt)
+    {
+        /* the failing jobs do not restart the budget */
+        job_deadline = loop_clock_us () + LOOP_JOB_BUDGET_US;
+        job_budget = LOOP_JOB_BUDGET_US;
+        while (JS_ExecutePendingJobs (loop_p->rt, 0, job_budget, &ctx) < 0)
+        {
+            loop_dump_error (ctx);
+            JS_FreeContext (ctx);
+            job_budget = job_deadline - loop_clock_us ();
+            if (job_budget <= 0)
+            {
+                break;
+            }
+        }
+    }
+    return loop_is_alive (loop_p);
+} /* jerry_port_loop_run_once */
+
+/**
+ * Run until there are no timers, watched fds, I/O requests or jobs left.
+ *
+ * @return 0
+ */
+int
+jerry_port_loop_run (jerry_port_loop_t *loop_p) /**< loop */
+{
+    while (jerry_port_loop_run_once (loop_p, -1) > 0)
+    {
+    }
+    return 0;
+} /* jerry_port_loop_run */
+
+/* scripts */
+
+static JSValue
+js_loop_call_job (JSContext *ctx, /**< realm */
+                  int argc, /**< function and arguments */
+                  JSValueConst *argv) /**< function and arguments */
+{
+    return JS_Call (ctx, argv[0], JS_UNDEFINED, argc - 1, argv + 1);
+} /* js_loop_call_job */
+
+static jerry_port_loop_t *
+js_loop_get (JSContext *ctx) /**< context */
+{
+    jerry_port_loop_t *loop_p = JS_GetRuntimeOpaque (JS_GetRuntime (ctx));
+
+    if (!loop_p)
+    {
+        JS_ThrowInternalError (ctx, "no event loop");
+    }
+    return loop_p;
+} /* js_loop_get */
+
+static int
+js_loop_get_delay (JSContext *ctx, /**< context */
+                   JSValueConst val, /**< delay argument */
+                   int64_t *pdelay) /**< [out] delay in ms */
+{
+    double d;
+
+    switch (JS_VALUE_GET_TAG (val))
+    {
+        case JS_TAG_INT:
+            *pdelay = JS_VALUE_GET_INT (val);
+            break;
+        case JS_TAG_FLOAT64:
+            d = JS_VALUE_GET_FLOAT64 (val);
+            /* NaN is 0 */
+            *pdelay = (d > 0 && d < (double) INT32_MAX) ? (int64_t) d : (d >= (double) INT32_MAX ? INT32_MAX : 0);
+            break;
+        case JS_TAG_UNDEFINED:
+            *pdelay = 0;
+            break;
+        default:
+            JS_ThrowTypeError (ctx, "delay is not a number");
+            return -1;
+    }
+    if (*pdelay < 0)
+    {
+        *pdelay = 0;
+    }
+    return 0;
+} /* js_loop_get_delay */
+
+static void
+js_loop_free_timer (jerry_port_js_timer_t *th) /**< timer */
+{
+    jerry_port_loop_t *loop_p = th->loop_p;
+    uint32_t index = (uint32_t) th->id & LOOP_TIMER_INDEX_MASK;
+
+    jerry_port_timer_remove (&loop_p->wheel, &th->timer);
+    loop_p->js_timers_p[index] = NULL;
+    loop_p->js_timer_free_p[loop_p->js_timer_free_count++] = index;
+    JS_FreeValue (th->ctx, th->func);
+    JS_FreeContext (th->ctx);
+    free (th);
+} /* js_loop_free_timer */
+
+static void
+js_loop_timer_cb (jerry_port_timer_t *timer_p) /**< expired timer */
+{
+    jerry_port_js_timer_t *th = (jerry_port_js_timer_t *) timer_p;
+    jerry_port_loop_t *loop_p = th->loop_p;
+
+    if (JS_EnqueueJob (th->ctx, js_loop_call_job, 1, (JSValueConst *) &th->func) < 0)
+    {
+        loop_dump_error (th->ctx);
+    }
+    if (th->interval_ms >= 0)
+    {
+        jerry_port_loop_add_timer (loop_p, &th->timer, th->interval_ms);
+    }
+    else
+    {
+        js_loop_free_timer (th);
+    }
+} /* js_loop_timer_cb */
+
+static JSValue
+js_loop_set_timer (JSContext *ctx, /**< context */
+                   JSValueConst this_val, /**< this */
+                   int argc, /**< argument count */
+                   JSValueConst *argv, /**< func, delay */
+                   int magic) /**< 1 for setInterval */
+{
+    jerry_port_loop_t *loop_p;
+    jerry_port_js_timer_t *th;
+    uint32_t index, new_size, *new_free_p;
+    jerry_port_js_timer_t **new_timers_p;
+    int64_t delay;
+
+    (void) this_val;
+    (void) argc;
+    loop_p = js_loop_get (ctx);
+    if (!loop_p)
+    {
+        return JS_EXCEPTION;
+    }
+    if (!JS_IsFunction (ctx, argv[0]))
+    {
+        return JS_ThrowTypeError (ctx, "not a function");
+    }
+    if (js_loop_get_delay (ctx, argv[1], &delay))
+    {
+        return JS_EXCEPTION;
+    }
+
+    if (loop_p->js_timer_free_count == 0)
+    {
+        new_size = loop_p->js_timer_size ? loop_p->js_timer_size * 2 : 16;
+        if (new_size > LOOP_TIMER_INDEX_MASK + 1)
+        {
+            return JS_ThrowRangeError (ctx, "too many timers");
+        }
+        new_timers_p = realloc (loop_p->js_timers_p, sizeof (new_timers_p[0]) * new_size);
+        if (!new_timers_p)
+        {
+            return JS_ThrowOutOfMemory (ctx);
+        }
+        loop_p->js_timers_p = new_timers_p;
+        new_free_p = realloc (loop_p->js_timer_free_p, sizeof (new_free_p[0]) * new_size);
+        if (!new_free_p)
+        {
+            return JS_ThrowOutOfMemory (ctx);
+        }
+        loop_p->js_timer_free_p = new_free_p;
+        /* the lowest indexes are popped first */
+        for (index = new_size; index-- > loop_p->js_timer_size;)
+        {
+            loop_p->js_timers_p[index] = NULL;
+            loop_p->js_timer_free_p[loop_p->js_timer_free_count++] = index;
+        }
+        loop_p->js_timer_size = new_size;
+    }
+
+    th = calloc (1, sizeof (*th));
+    if (!th)
+    {
+        return JS_ThrowOutOfMemory (ctx);
+    }
+    index = loop_p->js_timer_free_p[--loop_p->js_timer_free_count];
+    loop_p->js_timer_seq = (loop_p->js_timer_seq + 1) & LOOP_TIMER_SEQ_MASK;
+    th->id = (int32_t) ((loop_p->js_timer_seq << LOOP_TIMER_INDEX_BITS) | index);
+    th->loop_p = loop_p;
+    th->ctx = JS_DupContext (ctx);
+    th->func = JS_DupValue (ctx, argv[0]);
+    /* an interval of 0 would never let the loop poll */
+    th->interval_ms = magic ? (delay > 0 ? delay : 1) : -1;
+    th->timer.cb = js_loop_timer_cb;
+    loop_p->js_timers_p[index] = th;
+    jerry_port_loop_add_timer (loop_p, &th->timer, delay);
+    return JS_NewInt32 (ctx, th->id);
+} /* js_loop_set_timer */
+
+static JSValue
+js_loop_clear_timer (JSContext *ctx, /**< context */
+                     JSValueConst this_val, /**< this */
+                     int argc, /**< argument count */
+                     JSValueConst *argv) /**< timer id */
+{
+    jerry_port_loop_t *loop_p;
+    jerry_port_js_timer_t *th;
+    uint32_t index;
+    int32_t id;
+
+    (void) this_val;
+    (void) argc;
+    loop_p = js_loop_get (ctx);
+    if (!loop_p)
+    {
+        return JS_EXCEPTION;
+    }
+    /* unknown ids are ignored */
+    if (JS_VALUE_GET_TAG (argv[0]) != JS_TAG_INT)
+    {
+        return JS_UNDEFINED;
+    }
+    id = JS_VALUE_GET_INT (argv[0]);
+    index = (uint32_t) id & LOOP_TIMER_INDEX_MASK;
+    if (id >= 0 && index < loop_p->js_timer_size)
+    {
+        th = loop_p->js_timers_p[index];
+        if (th && th->id == id)
+        {
+            js_loop_free_timer (th);
+        }
+    }
+    return JS_UNDEFINED;
+} /* js_loop_clear_timer */
+
+static void
+js_loop_free_read (jerry_port_js_read_t *rh) /**< read state */
+{
+    rh->prev_p->next_p = rh->next_p;
+    rh->next_p->prev_p = rh->prev_p;
+    close (rh->fd);
+    if (rh->decoder_p)
+    {
+        JS_FreeStringDecoder (rh->decoder_p);
+    }
+    JS_FreeValue (rh->ctx, rh->func);
+    JS_FreeContext (rh->ctx);
+    free (rh);
+} /* js_loop_free_read */
+
+/**
+ * Queue the callback of readFile with an Error built from 'err' or with
+ * the file content.
+ */
+static void
+js_loop_read_done (JSContext *ctx, /**< context */
+                   JSValueConst func, /**< callback */
+                   int err, /**< errno, 0 if OK */
+                   JSStringDecoder *decoder_p) /**< content, freed */
+{
+    JSValue args[3];
+    int i;
+
+    args[0] = JS_DupValue (ctx, func);
+    if (err)
+    {
+        args[1] = JS_NewError (ctx);
+        if (!JS_IsException (args[1]))
+        {
+            JS_DefinePropertyValueStr (ctx, args[1], "message", JS_NewString (ctx, strerror (err)),
+                                       JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+        }
+        args[2] = JS_NULL;
+    }
+    else
+    {
+        args[1] = JS_NULL;
+        args[2] = JS_StringDecoderEnd (decoder_p);
+    }
+    if (JS_IsException (args[1]) || JS_IsException (args[2])
+        || JS_EnqueueJob (ctx, js_loop_call_job, 3, (JSValueConst *) args) < 0)
+    {
+        loop_dump_error (ctx);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        JS_FreeValue (ctx, args[i]);
+    }
+} /* js_loop_read_done */
+
+static void
+js_loop_read_cb (jerry_port_io_t *io_p, /**< request */
+                 ssize_t result) /**< byte count or -errno */
+{
+    jerry_port_js_read_t *rh = (jerry_port_js_read_t *) io_p;
+    JSStringDecoder *decoder_p;
+
+    if (rh->loop_p->is_freeing)
+    {
+        js_loop_free_read (rh);
+        return;
+    }
+    if (result < 0)
+    {
+        js_loop_read_done (rh->ctx, rh->func, (int) -result, NULL);
+        js_loop_free_read (rh);
+        return;
+    }
+    rh->pos += (size_t) result;
+    /* a sequence cut at the end of the chunk is completed by the next one */
+    if (JS_StringDecoderWrite (rh->decoder_p, rh->buf, (size_t) result) < 0)
+    {
+        JS_FreeValue (rh->ctx, JS_GetException (rh->ctx));
+        js_loop_read_done (rh->ctx, rh->func, ENOMEM, NULL);
+        js_loop_free_read (rh);
+        return;
+    }
+    /* a regular file is complete when its size is reached */
+    if (result == 0 || (rh->size != 0 && rh->pos >= rh->size))
+    {
+        decoder_p = rh->decoder_p;
+        rh->decoder_p = NULL;
+        js_loop_read_done (rh->ctx, rh->func, 0, decoder_p);
+        js_loop_free_read (rh);
+        return;
+    }
+    jerry_port_loop_read (rh->loop_p, &rh->io, rh->fd, rh->buf, sizeof (rh->buf), rh->pos);
+} /* js_loop_read_cb */
+
+static JSValue
+js_loop_read_file (JSContext *ctx, /**< context */
+                   JSValueConst this_val, /**< this */
+                   int argc, /**< argument count */
+                   JSValueConst *argv) /**< path, callback(err, data) */
+{
+    jerry_port_loop_t *loop_p;
+    jerry_port_js_read_t *rh;
+    const char *path;
+    struct stat st;
+    int fd;
+
+    (void) this_val;
+    (void) argc;
+    loop_p = js_loop_get (ctx);
+    if (!loop_p)
+    {
+        return JS_EXCEPTION;
+    }
+    if (!JS_IsFunction (ctx, argv[1]))
+    {
+        return JS_ThrowTypeError (ctx, "not a function");
+    }
+    path = JS_ToCString (ctx, argv[0]);
+    if (!path)
+    {
+        return JS_EXCEPTION;
+    }
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+    JS_FreeCString (ctx, path);
+    if (fd < 0)
+    {
+        /* reported asynchronously as the other errors */
+        js_loop_read_done (ctx, argv[1], errno, NULL);
+        return JS_UNDEFINED;
+    }
+    rh = calloc (1, sizeof (*rh));
+    if (!rh)
+    {
+        close (fd);
+        return JS_ThrowOutOfMemory (ctx);
+    }
+    if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode))
+    {
+        rh->size = (size_t) st.st_size;
+    }
+    rh->decoder_p = JS_NewStringDecoder (ctx);
+    if (!rh->decoder_p)
+    {
+        close (fd);
+        free (rh);
+        return JS_EXCEPTION;
+    }
+    rh->io.cb = js_loop_read_cb;
+    rh->loop_p = loop_p;
+    rh->ctx = JS_DupContext (ctx);
+    rh->func = JS_DupValue (ctx, argv[1]);
+    rh->fd = fd;
+    rh->next_p = &loop_p->js_reads;
+    rh->prev_p = loop_p->js_reads.prev_p;
+    loop_p->js_reads.prev_p->next_p = rh;
+    loop_p->js_reads.prev_p = rh;
+    jerry_port_loop_read (loop_p, &rh->io, fd, rh->buf, sizeof (rh->buf), 0);
+    return JS_UNDEFINED;
+} /* js_loop_read_file */
+
+/**
+ * Define setTimeout, clearTimeout, setInterval, clearInterval and
+ * readFile(path, callback) in the global object of 'ctx'. The runtime
+ * must have a loop. The callbacks run as jobs of the runtime queue.
+ *
+ * @return 0 if OK, -1 if exception
+ */
+int
+jerry_port_loop_add_intrinsics (JSContext *ctx) /**< context */
+{
+    JSValue global_obj;
+    int ret = -1;
+
+    global_obj = JS_GetGlobalObject (ctx);
+    if (JS_SetPropertyStr (ctx, global_obj, "setTimeout",
+                           JS_NewCFunctionMagic (ctx, js_loop_set_timer, "setTimeout", 2,
+                                                 JS_CFUNC_generic_magic, 0)) < 0
+        || JS_SetPropertyStr (ctx, global_obj, "setInterval",
+                              JS_NewCFunctionMagic (ctx, js_loop_set_timer, "setInterval", 2,
+                                                    JS_CFUNC_generic_magic, 1)) < 0
+        || JS_SetPropertyStr (ctx, global_obj, "clearTimeout",
+                              JS_NewCFunction (ctx, js_loop_clear_timer, "clearTimeout", 1)) < 0
+        || JS_SetPropertyStr (ctx, global_obj, "clearInterval",
+                              JS_NewCFunction (ctx, js_loop_clear_timer, "clearInterval", 1)) < 0
+        || JS_SetPropertyStr (ctx, global_obj, "readFile",
+                              JS_NewCFunction (ctx, js_loop_read_file, "readFile", 2)) < 0)
+    {
+        goto done;
+    }
+    ret = 0;
+done:
+    JS_FreeValue (ctx, global_obj);
+    return ret;
+} /* jerry_port_loop_add_intrinsics */
+
+/**
+ * Free the loop. The pending script timers and reads are dropped; the
+ * file descriptors watched by the caller are not closed.
+ */
+void
+jerry_port_loop_free (jerry_port_loop_t *loop_p) /**< loop */
+{
+    uint32_t i;
+
+    loop_p->is_freeing = true;
+#ifdef JERRY_PORT_IO_URING
+    /* the kernel may still write to the buffers of the requests */
+    while (loop_p->has_uring && loop_p->uring_inflight != 0)
+    {
+        if (jerry_port_uring_submit (&loop_p->ring, 1) < 0)
+        {
+            break;
+        }
+        loop_uring_reap (loop_p);
+    }
+#endif /* JERRY_PORT_IO_URING */
+    loop_report_io_done (loop_p);
+    for (i = 0; i < loop_p->js_timer_size; i++)
+    {
+        if (loop_p->js_timers_p[i])
+        {
+            js_loop_free_timer (loop_p->js_timers_p[i]);
+        }
+    }
+    free (loop_p->js_timers_p);
+    free (loop_p->js_timer_free_p);
+#ifdef JERRY_PORT_IO_URING
+    if (loop_p->has_uring)
+    {
+        jerry_port_uring_free (&loop_p->ring);
+    }
+#endif /* JERRY_PORT_IO_URING */
+    close (loop_p->epoll_fd);
+    free (loop_p->fd_handlers_p);
+    if (loop_p->rt && JS_GetRuntimeOpaque (loop_p->rt) == loop_p)
+    {
+        JS_SetRuntimeOpaque (loop_p->rt, NULL);
+    }
+    free (loop_p);
+} /* jerry_port_loop_free */
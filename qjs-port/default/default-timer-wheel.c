@@ -0,0 +1,269 @@
+#include <assert.h>
+
+#include "qjs-port-loop.h"
+
+/* Hierarchical timing wheel. Level 0 holds the timers expiring in the
+ * next 64 ticks, one slot per tick. A slot of level n covers 64^n
+ * ticks; its timers are moved to the lower levels (cascaded) when the
+ * wheel enters its range. Adding and removing a timer is O(1), and the
+ * bitmaps of non empty slots let the wheel skip the idle ticks. */
+
+#define WHEEL_MASK (JERRY_PORT_WHEEL_SIZE - 1)
+#define WHEEL_MAX_DELAY (((uint64_t) 1 << (JERRY_PORT_WHEEL_BITS * JERRY_PORT_WHEEL_LEVELS)) - 1)
+
+static inline int
+wheel_ctz64 (uint64_t a)
+{
+    return __builtin_ctzll (a);
+} /* wheel_ctz64 */
+
+void
+jerry_port_timer_wheel_init (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+                             uint64_t now) /**< current tick */
+{
+    int level, i;
+
+    wheel_p->now = now;
+    wheel_p->count = 0;
+    for (level = 0; level < JERRY_PORT_WHEEL_LEVELS; level++)
+    {
+        wheel_p->bitmap[level] = 0;
+        for (i = 0; i < JERRY_PORT_WHEEL_SIZE; i++)
+        {
+            wheel_p->slots[level][i].next_p = &wheel_p->slots[level][i];
+            wheel_p->slots[level][i].prev_p = &wheel_p->slots[level][i];
+        }
+    }
+} /* jerry_port_timer_wheel_init */
+
+static void
+wheel_insert (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+              jerry_port_timer_t *timer_p) /**< timer */
+{
+    jerry_port_timer_link_t *head_p;
+    uint64_t delta, expire;
+    int level, index;
+
+    expire = timer_p->expire;
+    if (expire < wheel_p->now)
+    {
+        expire = wheel_p->now;
+    }
+    delta = expire - wheel_p->now;
+    if (delta > WHEEL_MAX_DELAY)
+    {
+        /* parked in the last level, inserted again when cascaded */
+        delta = WHEEL_MAX_DELAY;
+        expire = wheel_p->now + delta;
+    }
+    for (level = 0; level < JERRY_PORT_WHEEL_LEVELS - 1; level++)
+    {
+        if (delta < ((uint64_t) 1 << (JERRY_PORT_WHEEL_BITS * (level + 1))))
+        {
+            break;
+        }
+    }
+    index = (int) (expire >> (JERRY_PORT_WHEEL_BITS * level)) & WHEEL_MASK;
+
+    head_p = &wheel_p->slots[level][index];
+    timer_p->link.next_p = head_p;
+    timer_p->link.prev_p = head_p->prev_p;
+    head_p->prev_p->next_p = &timer_p->link;
+    head_p->prev_p = &timer_p->link;
+    timer_p->slot = (uint16_t) (level * JERRY_PORT_WHEEL_SIZE + index);
+    wheel_p->bitmap[level] |= (uint64_t) 1 << index;
+} /* wheel_insert */
+
+static void
+wheel_unlink (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+              jerry_port_timer_t *timer_p) /**< timer */
+{
+    jerry_port_timer_link_t *next_p = timer_p->link.next_p;
+    jerry_port_timer_link_t *prev_p = timer_p->link.prev_p;
+
+    prev_p->next_p = next_p;
+    next_p->prev_p = prev_p;
+    /* the timer was alone in its slot */
+    if (next_p == prev_p)
+    {
+        wheel_p->bitmap[timer_p->slot / JERRY_PORT_WHEEL_SIZE] &=
+            ~((uint64_t) 1 << (timer_p->slot % JERRY_PORT_WHEEL_SIZE));
+    }
+    timer_p->link.next_p = NULL;
+    timer_p->link.prev_p = NULL;
+} /* wheel_unlink */
+
+/**
+ * Add a timer expiring at tick 'expire'. An already expired timer runs
+ * at the next advance.
+ */
+void
+jerry_port_timer_add (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+                      jerry_port_timer_t *timer_p, /**< timer */
+                      uint64_t expire) /**< expiration tick */
+{
+    if (timer_p->is_pending)
+    {
+        jerry_port_timer_remove (wheel_p, timer_p);
+    }
+    timer_p->expire = expire;
+    timer_p->is_pending = true;
+    wheel_insert (wheel_p, timer_p);
+    wheel_p->count++;
+} /* jerry_port_timer_add */
+
+/**
+ * Remove a timer. Nothing is done if it is not pending.
+ */
+void
+jerry_port_timer_remove (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+                         jerry_port_timer_t *timer_p) /**< timer */
+{
+    if (!timer_p->is_pending)
+    {
+        return;
+    }
+    wheel_unlink (wheel_p, timer_p);
+    timer_p->is_pending = false;
+    wheel_p->count--;
+} /* jerry_port_timer_remove */
+
+/**
+ * Return the first tick >= now at which the wheel has work to do: a
+ * non empty level 0 slot or the cascade at the end of the current
+ * level 0 round.
+ */
+static uint64_t
+wheel_next_tick (const jerry_port_timer_wheel_t *wheel_p) /**< wheel */
+{
+    uint64_t bits;
+    int index;
+
+    index = (int) (wheel_p->now & WHEEL_MASK);
+    if (index == 0)
+    {
+        /* the cascade of this round is not done yet */
+        return wheel_p->now;
+    }
+    bits = wheel_p->bitmap[0] >> index;
+    if (bits != 0)
+    {
+        return wheel_p->now + (uint64_t) wheel_ctz64 (bits);
+    }
+    return (wheel_p->now | WHEEL_MASK) + 1;
+} /* wheel_next_tick */
+
+/**
+ * Return the number of ticks until the next timer may expire (0 if
+ * some are already expired), or -1 if no timer is pending. The result
+ * can be earlier than the actual expiration when the next event is a
+ * cascade.
+ */
+int64_t
+jerry_port_timer_wheel_timeout (const jerry_port_timer_wheel_t *wheel_p) /**< wheel */
+{
+    if (wheel_p->count == 0)
+    {
+        return -1;
+    }
+    return (int64_t) (wheel_next_tick (wheel_p) - wheel_p->now);
+} /* jerry_port_timer_wheel_timeout */
+
+static void
+wheel_cascade (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+               int level, /**< source level */
+               int index) /**< source slot */
+{
+    jerry_port_timer_link_t *head_p, *link_p, *next_p;
+
+    head_p = &wheel_p->slots[level][index];
+    link_p = head_p->next_p;
+    head_p->next_p = head_p;
+    head_p->prev_p = head_p;
+    wheel_p->bitmap[level] &= ~((uint64_t) 1 << index);
+    for (; link_p != head_p; link_p = next_p)
+    {
+        next_p = link_p->next_p;
+        wheel_insert (wheel_p, (jerry_port_timer_t *) link_p);
+    }
+} /* wheel_cascade */
+
+/**
+ * Advance the wheel to tick 'now' and run the callbacks of the expired
+ * timers in expiration order. The callbacks may add and remove timers.
+ *
+ * @return number of expired timers
+ */
+uint32_t
+jerry_port_timer_wheel_advance (jerry_port_timer_wheel_t *wheel_p, /**< wheel */
+                                uint64_t now) /**< current tick */
+{
+    jerry_port_timer_link_t list, *head_p;
+    jerry_port_timer_t *timer_p;
+    uint64_t tick;
+    uint32_t expired = 0;
+    int level, index;
+
+    while (wheel_p->now <= now)
+    {
+        if (wheel_p->count == 0)
+        {
+            wheel_p->now = now + 1;
+            break;
+        }
+        tick = wheel_next_tick (wheel_p);
+        if (tick > now)
+        {
+            wheel_p->now = now + 1;
+            break;
+        }
+        wheel_p->now = tick;
+        index = (int) (tick & WHEEL_MASK);
+        if (index == 0)
+        {
+            /* entering a new round: refill the lower levels */
+            for (level = 1; level < JERRY_PORT_WHEEL_LEVELS; level++)
+            {
+                index = (int) (tick >> (JERRY_PORT_WHEEL_BITS * level)) & WHEEL_MASK;
+                wheel_cascade (wheel_p, level, index);
+                if (index != 0)
+                {
+                    break;
+                }
+            }
+            index = 0;
+        }
+
+        /* detach the slot before running the callbacks: a timer added
+           again for the current tick goes to the next one */
+        head_p = &wheel_p->slots[0][index];
+        if (head_p->next_p == head_p)
+        {
+            wheel_p->now = tick + 1;
+            continue;
+        }
+        list.next_p = head_p->next_p;
+        list.prev_p = head_p->prev_p;
+        list.next_p->prev_p = &list;
+        list.prev_p->next_p = &list;
+        head_p->next_p = head_p;
+        head_p->prev_p = head_p;
+        wheel_p->bitmap[0] &= ~((uint64_t) 1 << index);
+        wheel_p->now = tick + 1;
+
+        while (list.next_p != &list)
+        {
+            timer_p = (jerry_port_timer_t *) list.next_p;
+            assert (timer_p->expire <= tick);
+            list.next_p = timer_p->link.next_p;
+            list.next_p->prev_p = &list;
+            timer_p->link.next_p = NULL;
+            timer_p->link.prev_p = NULL;
+            timer_p->is_pending = false;
+            wheel_p->count--;
+            expired++;
+            timer_p->cb (timer_p);
+        }
+    }
+    return expired;
+} /* jerry_port_timer_wheel_advance */
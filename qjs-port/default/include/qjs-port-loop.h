@@ -0,0 +1,132 @@
+#ifndef QJS_PORT_LOOP_H
+#define QJS_PORT_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "qjs.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/** \addtogroup jerry_port_loop Default port event loop
+ * Single threaded event loop: timers in a hierarchical timing wheel, fd
+ * readiness through epoll and asynchronous file I/O through io_uring
+ * when available. One loop serves all the contexts of a runtime.
+ * @{
+ */
+
+/**
+ * Timing wheel geometry: 4 levels of 64 slots with a 1 ms tick. The
+ * delays longer than 64^4 ticks (about 4.6 hours) are cascaded again.
+ */
+#define JERRY_PORT_WHEEL_BITS 6
+#define JERRY_PORT_WHEEL_SIZE (1 << JERRY_PORT_WHEEL_BITS)
+#define JERRY_PORT_WHEEL_LEVELS 4
+
+typedef struct jerry_port_timer_t jerry_port_timer_t;
+
+/**
+ * Timer callback. The timer is no longer pending and may be added again.
+ */
+typedef void (*jerry_port_timer_cb_t) (jerry_port_timer_t *timer_p);
+
+/**
+ * Doubly linked list node of a wheel slot.
+ */
+typedef struct jerry_port_timer_link_t
+{
+    struct jerry_port_timer_link_t *next_p;
+    struct jerry_port_timer_link_t *prev_p;
+} jerry_port_timer_link_t;
+
+/**
+ * Timer, allocated by the caller.
+ */
+struct jerry_port_timer_t
+{
+    jerry_port_timer_link_t link; /**< must be first */
+    uint64_t expire; /**< expiration tick */
+    uint16_t slot; /**< level * JERRY_PORT_WHEEL_SIZE + slot index */
+    bool is_pending;
+    jerry_port_timer_cb_t cb;
+    void *user_p;
+};
+
+typedef struct
+{
+    uint64_t now; /**< next tick to process */
+    uint32_t count; /**< number of pending timers */
+    uint64_t bitmap[JERRY_PORT_WHEEL_LEVELS]; /**< non empty slots */
+    jerry_port_timer_link_t slots[JERRY_PORT_WHEEL_LEVELS][JERRY_PORT_WHEEL_SIZE];
+} jerry_port_timer_wheel_t;
+
+void jerry_port_timer_wheel_init (jerry_port_timer_wheel_t *wheel_p, uint64_t now);
+void jerry_port_timer_add (jerry_port_timer_wheel_t *wheel_p, jerry_port_timer_t *timer_p, uint64_t expire);
+void jerry_port_timer_remove (jerry_port_timer_wheel_t *wheel_p, jerry_port_timer_t *timer_p);
+int64_t jerry_port_timer_wheel_timeout (const jerry_port_timer_wheel_t *wheel_p);
+uint32_t jerry_port_timer_wheel_advance (jerry_port_timer_wheel_t *wheel_p, uint64_t now);
+
+typedef struct jerry_port_loop_t jerry_port_loop_t;
+
+/**
+ * fd readiness events.
+ */
+#define JERRY_PORT_LOOP_READ  (1 << 0)
+#define JERRY_PORT_LOOP_WRITE (1 << 1)
+#define JERRY_PORT_LOOP_ERROR (1 << 2) /**< error or hang up, always reported */
+
+typedef void (*jerry_port_fd_cb_t) (jerry_port_loop_t *loop_p, int fd, uint32_t events, void *user_p);
+
+typedef struct jerry_port_io_t jerry_port_io_t;
+
+/**
+ * File I/O completion callback. 'result' is the byte count or -errno.
+ */
+typedef void (*jerry_port_io_cb_t) (jerry_port_io_t *io_p, ssize_t result);
+
+/**
+ * File I/O request, allocated by the caller. It must stay valid until
+ * its callback is called.
+ */
+struct jerry_port_io_t
+{
+    jerry_port_io_t *next_p; /**< completion list of the synchronous backend */
+    ssize_t result;
+    jerry_port_io_cb_t cb;
+    void *user_p;
+};
+
+jerry_port_loop_t *jerry_port_loop_new (JSRuntime *rt);
+void jerry_port_loop_free (jerry_port_loop_t *loop_p);
+jerry_port_loop_t *jerry_port_loop_get (JSRuntime *rt);
+bool jerry_port_loop_has_io_uring (jerry_port_loop_t *loop_p);
+uint64_t jerry_port_loop_now (jerry_port_loop_t *loop_p);
+
+void jerry_port_loop_add_timer (jerry_port_loop_t *loop_p, jerry_port_timer_t *timer_p, int64_t delay_ms);
+void jerry_port_loop_remove_timer (jerry_port_loop_t *loop_p, jerry_port_timer_t *timer_p);
+
+int jerry_port_loop_watch_fd (jerry_port_loop_t *loop_p, int fd, uint32_t events,
+                              jerry_port_fd_cb_t cb, void *user_p);
+
+int jerry_port_loop_read (jerry_port_loop_t *loop_p, jerry_port_io_t *io_p, int fd,
+                          void *buf_p, size_t len, uint64_t offset);
+int jerry_port_loop_write (jerry_port_loop_t *loop_p, jerry_port_io_t *io_p, int fd,
+                           const void *buf_p, size_t len, uint64_t offset);
+
+int jerry_port_loop_run_once (jerry_port_loop_t *loop_p, int timeout_ms);
+int jerry_port_loop_run (jerry_port_loop_t *loop_p);
+
+int jerry_port_loop_add_intrinsics (JSContext *ctx);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* !QJS_PORT_LOOP_H */
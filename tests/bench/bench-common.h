@@ -0,0 +1,25 @@
+#ifndef QJS_BENCH_COMMON_H
+#define QJS_BENCH_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t bench_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* xorshift, deterministic between runs */
+static inline uint32_t bench_rand32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+#endif //QJS_BENCH_COMMON_H
@@ -0,0 +1,59 @@
+#include "context.h"
+#include "bench-common.h"
+
+#define N 20000
+
+/* a template with some user globals, as an embedder would set up */
+static void init_template(JSContext *ctx)
+{
+    JSValue global, obj;
+    char name[32];
+    int i;
+
+    global = JS_GetGlobalObject(ctx);
+    for (i = 0; i < 64; i++) {
+        obj = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, obj, "id", JS_NewInt32(ctx, i));
+        JS_SetPropertyStr(ctx, obj, "name", JS_NewString(ctx, "config"));
+        snprintf(name, sizeof(name), "module%d", i);
+        JS_SetPropertyStr(ctx, global, name, obj);
+    }
+    JS_FreeValue(ctx, global);
+}
+
+static void bench(JSRuntime *rt, JSContext *tmpl, const char *name)
+{
+    JSContext *ctx;
+    JSMemoryUsage stats;
+    int64_t t0;
+    int i;
+
+    t0 = bench_time_ns();
+    for (i = 0; i < N; i++) {
+        ctx = tmpl ? JS_CloneContext(tmpl) : JS_NewContext(rt);
+        if (!tmpl)
+            init_template(ctx);
+        JS_FreeContext(ctx);
+    }
+    JS_RunGC(rt);
+    JS_ComputeMemoryUsage(rt, &stats);
+    printf("%-24s %8.2f us/context  (%"PRId64" bytes allocated)\n", name,
+           (bench_time_ns() - t0) / 1e3 / N, stats.malloc_size);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *tmpl;
+
+    rt = JS_NewRuntime();
+    tmpl = JS_NewContext(rt);
+    init_template(tmpl);
+
+    bench(rt, NULL, "JS_NewContext + init");
+    bench(rt, tmpl, "JS_CloneContext");
+
+    JS_FreeContext(tmpl);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "context.h"
+#include "bench-common.h"
+
+#define LOOP_COUNT 2000000
+
+/* each script runs a loop of 'n' iterations, 'n' being a global */
+static const struct {
+    const char *name;
+    const char *source;
+} bench_scripts[] = {
+    { "empty loop",
+      "for (var i = 0; i < n; i++);" },
+    { "int arithmetic",
+      "var s = 0; for (var i = 0; i < n; i++) s = (s + i * 3) & 0xffff;" },
+    { "float arithmetic",
+      "var s = 0.5; for (var i = 0; i < n; i++) s = s * 1.000001 + 0.25;" },
+    { "local variables",
+      "(function() { var s = 0; for (let i = 0; i < n; i++) s += i; })();" },
+    { "property get/set",
+      "var o = { x: 1, y: 2 }; for (var i = 0; i < n; i++) o.x = o.x + o.y;" },
+    { "prototype methods",
+      "function P() { this.v = 1; } P.prototype.get = function() { return this.v; };\n"
+      "var p = new P(), s = 0; for (var i = 0; i < n; i++) s += p.get();" },
+    { "polymorphic get",
+      "var os = [{ x: 1 }, { y: 0, x: 2 }, { z: 0, x: 3 }];\n"
+      "var s = 0; for (var i = 0; i < n; i++) s += os[i % 3].x;" },
+    { "object creation",
+      "function R(i) { this.id = i; this.a = 1; this.b = 2; this.c = 3; this.d = 4;\n"
+      "  this.e = 5; this.f = 6; this.g = 7; this.h = 8; this.k = 9; this.l = 10; }\n"
+      "for (var i = 0; i < n; i++) new R(i);" },
+    { "array elements",
+      "var a = [1, 2, 3, 4]; for (var i = 0; i < n; i++) a[i & 3] = a[(i + 1) & 3] + 1;" },
+    { "numeric arrays",
+      "var d = []; for (var i = 0; i < 1024; i++) d[i] = i * 0.5;\n"
+      "var s = 0; for (var i = 0; i < n; i++) s += d[i & 1023];" },
+    { "typed array elements",
+      "var u = new Uint8Array(1024), f = new Float64Array(1024), s = 0;\n"
+      "for (var i = 0; i < n; i++) { u[i & 1023] = i; f[i & 1023] += u[(i + 1) & 1023]; }" },
+    { "typed array fill+indexOf",
+      "var b = new Uint8Array(256), w = new Uint32Array(b.buffer);\n"
+      "for (var i = 0; i < n; i += 16) { w.fill(i); b[255] = 7; b.indexOf(7); }" },
+    { "function calls",
+      "function add(a, b) { return a + b; }\n"
+      "var s = 0; for (var i = 0; i < n; i++) s = add(s, 1);" },
+    { "closure variables",
+      "var inc = (function() { var c = 0; return function() { return ++c; }; })();\n"
+      "for (var i = 0; i < n; i++) inc();" },
+    { "closure creation",
+      "function mk(a, b) { var c = a * 2; return function() { return a + b + c; }; }\n"
+      "var s = 0; for (var i = 0; i < n; i++) s += mk(i, 1)();" },
+    { "string concat",
+      "var s; for (var i = 0; i < n; i++) { s = 'a'; s += i; }" },
+    { "generator resume",
+      "function* nat() { for (var k = 0;; k++) yield k; }\n"
+      "var it = nat(), s = 0; for (var i = 0; i < n; i++) s += it.next().value;" },
+    { "generator creation",
+      "function* two(a) { yield a; return a + 1; }\n"
+      "var s = 0; for (var i = 0; i < n; i++) { var it = two(i); it.next(); s += it.next().value; }" },
+};
+
+static void bench_script(JSContext *ctx, const char *name, const char *source)
+{
+    JSValue val;
+    int64_t t0;
+
+    t0 = bench_time_ns();
+    val = JS_Eval(ctx, source, strlen(source), "bench.js", 0);
+    if (JS_IsException(val)) {
+        fprintf(stderr, "%s: exception\n", name);
+        exit(1);
+    }
+    JS_FreeValue(ctx, val);
+    printf("%-24s %8.1f ns/iteration\n", name,
+           (double)(bench_time_ns() - t0) / LOOP_COUNT);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSValue global;
+    int i;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "n", JS_NewInt32(ctx, LOOP_COUNT));
+    JS_FreeValue(ctx, global);
+
+    for(i = 0; i < countof(bench_scripts); i++)
+        bench_script(ctx, bench_scripts[i].name, bench_scripts[i].source);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
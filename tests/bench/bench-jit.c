@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+#include "context.h"
+#include "bench-common.h"
+
+#define LOOP_COUNT 2000000
+
+/* each script runs a loop of 'n' iterations, 'n' being a global */
+static const struct {
+    const char *name;
+    const char *source;
+} bench_scripts[] = {
+    { "empty loop",
+      "for (var i = 0; i < n; i++);" },
+    { "int arithmetic",
+      "var s = 0; for (var i = 0; i < n; i++) s = (s + i * 3) & 0xffff;" },
+    { "float arithmetic",
+      "var s = 0.5; for (var i = 0; i < n; i++) s = s * 1.000001 + 0.25;" },
+    { "local variables",
+      "(function() { var s = 0; for (let i = 0; i < n; i++) s += i; })();" },
+    { "compares and branches",
+      "(function() { var c = 0; for (var i = 0; i < n; i++) {\n"
+      "  if ((i & 7) == 3) c++; else if (i > c) c += 2; } })();" },
+    { "property get/set",
+      "var o = { x: 1, y: 2 }; for (var i = 0; i < n; i++) o.x = o.x + o.y;" },
+    { "function calls",
+      "function add(a, b) { return a + b; }\n"
+      "var s = 0; for (var i = 0; i < n; i++) s = add(s, 1);" },
+    { "closure variables",
+      "var inc = (function() { var c = 0; return function() { return ++c; }; })();\n"
+      "for (var i = 0; i < n; i++) inc();" },
+    { "recursive calls",
+      "function fib(k) { return k < 2 ? k : fib(k - 1) + fib(k - 2); }\n"
+      "for (var i = 0; i < n; i += 1000) fib(10);" },
+};
+
+static double bench_script(int use_jit, const char *name, const char *source)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSValue global, val;
+    int64_t t0;
+
+    rt = JS_NewRuntime();
+    JS_SetJITEnabled(rt, use_jit);
+    ctx = JS_NewContext(rt);
+    global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "n", JS_NewInt32(ctx, LOOP_COUNT));
+    JS_FreeValue(ctx, global);
+
+    t0 = bench_time_ns();
+    val = JS_Eval(ctx, source, strlen(source), "bench.js", 0);
+    t0 = bench_time_ns() - t0;
+    if (JS_IsException(val)) {
+        fprintf(stderr, "%s: exception\n", name);
+        exit(1);
+    }
+    JS_FreeValue(ctx, val);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return (double)t0 / LOOP_COUNT;
+}
+
+int main(int argc, char **argv)
+{
+    double t_interp, t_jit;
+    int i;
+
+    printf("%-24s %12s %12s\n", "ns/iteration", "interpreter", "jit");
+    for(i = 0; i < countof(bench_scripts); i++) {
+        t_interp = bench_script(FALSE, bench_scripts[i].name,
+                                bench_scripts[i].source);
+        t_jit = bench_script(TRUE, bench_scripts[i].name,
+                             bench_scripts[i].source);
+        printf("%-24s %12.1f %12.1f  x%.2f\n", bench_scripts[i].name,
+               t_interp, t_jit, t_interp / t_jit);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "context.h"
+#include "bench-common.h"
+
+#define N 2000000
+#define FAN_OUT 100
+
+static JSValue job_nop(JSContext *ctx, int argc, JSValueConst *argv)
+{
+    return JS_UNDEFINED;
+}
+
+/* the previous design: one allocated list entry per job */
+typedef struct ListJob {
+    struct list_head link;
+    JSContext *ctx;
+    JSJobFunc *job_func;
+    int argc;
+    JSValue argv[0];
+} ListJob;
+
+static void list_enqueue(JSContext *ctx, struct list_head *job_list,
+                         JSJobFunc *job_func, int argc, JSValueConst *argv)
+{
+    ListJob *e;
+    int i;
+
+    e = js_malloc(ctx, sizeof(*e) + argc * sizeof(JSValue));
+    e->ctx = ctx;
+    e->job_func = job_func;
+    e->argc = argc;
+    for (i = 0; i < argc; i++)
+        e->argv[i] = JS_DupValue(ctx, argv[i]);
+    list_add_tail(&e->link, job_list);
+}
+
+static void list_drain(struct list_head *job_list)
+{
+    ListJob *e;
+    int i;
+
+    while (!list_empty(job_list)) {
+        e = list_entry(job_list->next, ListJob, link);
+        list_del(&e->link);
+        JS_FreeValue(e->ctx, e->job_func(e->ctx, e->argc, e->argv));
+        for (i = 0; i < e->argc; i++)
+            JS_FreeValue(e->ctx, e->argv[i]);
+        js_free(e->ctx, e);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx, *ctx1;
+    struct list_head job_list;
+    JSValue args[2];
+    int64_t t0;
+    int i, j;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    args[0] = JS_NewObject(ctx);
+    args[1] = JS_NewInt32(ctx, 1);
+
+    /* each handler queues FAN_OUT reactions which are then drained */
+    init_list_head(&job_list);
+    t0 = bench_time_ns();
+    for (i = 0; i < N / FAN_OUT; i++) {
+        for (j = 0; j < FAN_OUT; j++)
+            list_enqueue(ctx, &job_list, job_nop, 2, args);
+        list_drain(&job_list);
+    }
+    printf("%-24s %8.1f ns/job\n", "malloc per job",
+           (double)(bench_time_ns() - t0) / N);
+
+    t0 = bench_time_ns();
+    for (i = 0; i < N / FAN_OUT; i++) {
+        for (j = 0; j < FAN_OUT; j++)
+            JS_EnqueueJob(ctx, job_nop, 2, args);
+        JS_ExecutePendingJobs(rt, 0, 0, &ctx1);
+    }
+    printf("%-24s %8.1f ns/job\n", "job ring",
+           (double)(bench_time_ns() - t0) / N);
+
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "bench-common.h"
+
+#define BUNDLE_SIZE (8 << 20)
+#define ROUNDS 5
+#define MAX_ATOMS (4 << 20)
+
+/* a minified-ish bundle: indented modules with comments, strings,
+   numbers and many repeated identifiers */
+static const char *module_text =
+    "/**\n"
+    " * Module %d. Licensed under the MIT license, see LICENSE for the\n"
+    " * details. This block is long enough to be skipped 16 bytes at once.\n"
+    " */\n"
+    "function module_%d(exports, require, module) {\n"
+    "    'use strict';\n"
+    "    const helper = require(\"./helper_%d.js\");\n"
+    "    // compute the layout of the component tree\n"
+    "    function layoutComponent(node, parentWidth, options) {\n"
+    "        let width = parentWidth * 0.5 + options.margin_left;\n"
+    "        for (let index = 0; index < node.children.length; index++) {\n"
+    "            const child = node.children[index];\n"
+    "            if (child.visible && child.style.display !== \"none\") {\n"
+    "                width += layoutComponent(child, width, options) | 0x1f;\n"
+    "            }\n"
+    "        }\n"
+    "        return `${node.name}: ${width}px`.length + /ab+c/.lastIndex;\n"
+    "    }\n"
+    "    exports.layoutComponent = layoutComponent;\n"
+    "    exports.version = '1.0.%d';\n"
+    "}\n\n";
+
+static char *make_bundle(size_t *plen)
+{
+    char *buf, chunk[2048];
+    size_t len, n;
+    int i;
+
+    buf = malloc(BUNDLE_SIZE + sizeof(chunk));
+    len = 0;
+    for(i = 0; len < BUNDLE_SIZE; i++) {
+        n = snprintf(chunk, sizeof(chunk), module_text, i, i, i % 100, i);
+        memcpy(buf + len, chunk, n);
+        len += n;
+    }
+    buf[len] = '\0';
+    *plen = len;
+    return buf;
+}
+
+static char *load_file(const char *filename, size_t *plen)
+{
+    FILE *f;
+    char *buf;
+    long len;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len + 1);
+    if (fread(buf, 1, len, f) != len) {
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    buf[len] = '\0';
+    fclose(f);
+    *plen = len;
+    return buf;
+}
+
+/* return the token count or -1. The identifiers stay referenced as
+   they would be by the compiled code. */
+static int64_t lex_all(JSContext *ctx, const char *buf, size_t len,
+                       JSAtom *atoms, int *patom_count)
+{
+    JSParseState s;
+    int64_t count;
+    int prev;
+
+    js_parse_init(ctx, &s, buf, len, "bundle.js");
+    count = 0;
+    prev = 0;
+    for(;;) {
+        if (next_token(&s))
+            return -1;
+        /* crude regexp detection, enough for the synthesized bundle */
+        if (s.token.val == '/' && prev == '+') {
+            if (js_parse_regexp(&s))
+                return -1;
+        } else if (s.token.val == '}' && *s.buf_ptr != '\n' &&
+                   *s.buf_ptr != ' ' && *s.buf_ptr != ';' &&
+                   *s.buf_ptr != '\0') {
+            /* end of a template substitution */
+            if (js_parse_template_part(&s, s.buf_ptr))
+                return -1;
+        }
+        if (s.token.val == TOK_EOF)
+            break;
+        if (s.token.val == TOK_IDENT && *patom_count < MAX_ATOMS)
+            atoms[(*patom_count)++] = JS_DupAtom(ctx, s.token.u.ident.atom);
+        prev = s.token.val;
+        count++;
+    }
+    js_parse_free(&s);
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSAtom *atoms;
+    char *buf;
+    size_t len;
+    int64_t t0, t, best, count;
+    int i, j, atom_count;
+
+    if (argc > 1) {
+        buf = load_file(argv[1], &len);
+        if (!buf) {
+            fprintf(stderr, "could not read %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        buf = make_bundle(&len);
+    }
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+
+    atoms = malloc(sizeof(atoms[0]) * MAX_ATOMS);
+    best = INT64_MAX;
+    count = 0;
+    for(i = 0; i < ROUNDS; i++) {
+        atom_count = 0;
+        t0 = bench_time_ns();
+        count = lex_all(ctx, buf, len, atoms, &atom_count);
+        t = bench_time_ns() - t0;
+        if (count < 0) {
+            fprintf(stderr, "syntax error\n");
+            return 1;
+        }
+        for(j = 0; j < atom_count; j++)
+            JS_FreeAtom(ctx, atoms[j]);
+        if (t < best)
+            best = t;
+    }
+    printf("%-24s %8.1f MB  %"PRId64" tokens\n", "input", len / 1e6, count);
+    printf("%-24s %8.1f MB/s  %8.1f Mtokens/s\n", "lexer",
+           len / 1e6 / (best / 1e9), count / 1e6 / (best / 1e9));
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    free(atoms);
+    free(buf);
+    return 0;
+}
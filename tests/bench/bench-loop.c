@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "context.h"
+#include "qjs-port-loop.h"
+#include "bench-common.h"
+
+#define TIMER_COUNT 1000000
+#define READ_COUNT 100000
+#define READ_CONCURRENCY 256
+#define READ_SIZE 4096
+#define FILE_SIZE (1 << 20)
+
+static int expired_count;
+
+static void timer_cb(jerry_port_timer_t *timer_p)
+{
+    expired_count++;
+}
+
+static void bench_wheel(void)
+{
+    static jerry_port_timer_wheel_t wheel;
+    jerry_port_timer_t *timers;
+    uint32_t seed = 1;
+    int64_t t0;
+    uint64_t now;
+    int i;
+
+    timers = calloc(TIMER_COUNT, sizeof(timers[0]));
+    jerry_port_timer_wheel_init(&wheel, 0);
+
+    /* typical request timeouts: most are cancelled before expiring */
+    t0 = bench_time_ns();
+    for (i = 0; i < TIMER_COUNT; i++) {
+        timers[i].cb = timer_cb;
+        jerry_port_timer_add(&wheel, &timers[i], bench_rand32(&seed) % 30000);
+    }
+    for (i = 0; i < TIMER_COUNT; i += 2)
+        jerry_port_timer_remove(&wheel, &timers[i]);
+    for (now = 0; wheel.count != 0; now += 10)
+        jerry_port_timer_wheel_advance(&wheel, now);
+    printf("%-24s %8.1f ns/timer (%d expired)\n", "timing wheel",
+           (double)(bench_time_ns() - t0) / TIMER_COUNT, expired_count);
+    free(timers);
+}
+
+typedef struct {
+    jerry_port_io_t io;
+    jerry_port_loop_t *loop_p;
+    int fd;
+    char buf[READ_SIZE];
+} BenchRead;
+
+static int reads_started, reads_done;
+static uint32_t read_seed = 1;
+
+static void read_start(BenchRead *r)
+{
+    uint64_t offset = (bench_rand32(&read_seed) % (FILE_SIZE / READ_SIZE)) * READ_SIZE;
+    reads_started++;
+    jerry_port_loop_read(r->loop_p, &r->io, r->fd, r->buf, READ_SIZE, offset);
+}
+
+static void read_cb(jerry_port_io_t *io_p, ssize_t result)
+{
+    BenchRead *r = (BenchRead *)io_p;
+
+    if (result != READ_SIZE)
+        abort();
+    reads_done++;
+    if (reads_started < READ_COUNT)
+        read_start(r);
+}
+
+static void bench_reads(const char *path)
+{
+    static BenchRead reads[READ_CONCURRENCY];
+    jerry_port_loop_t *loop_p;
+    char buf[READ_SIZE];
+    int64_t t0;
+    int fd, i;
+
+    fd = open(path, O_RDONLY);
+    t0 = bench_time_ns();
+    for (i = 0; i < READ_COUNT; i++) {
+        uint64_t offset = (bench_rand32(&read_seed) % (FILE_SIZE / READ_SIZE)) * READ_SIZE;
+        if (pread(fd, buf, READ_SIZE, offset) != READ_SIZE)
+            abort();
+    }
+    printf("%-24s %8.1f ns/read\n", "blocking pread",
+           (double)(bench_time_ns() - t0) / READ_COUNT);
+
+    loop_p = jerry_port_loop_new(NULL);
+    t0 = bench_time_ns();
+    for (i = 0; i < READ_CONCURRENCY; i++) {
+        reads[i].io.cb = read_cb;
+        reads[i].loop_p = loop_p;
+        reads[i].fd = fd;
+        read_start(&reads[i]);
+    }
+    jerry_port_loop_run(loop_p);
+    printf("%-24s %8.1f ns/read (%d in flight, %s)\n", "event loop",
+           (double)(bench_time_ns() - t0) / reads_done, READ_CONCURRENCY,
+           jerry_port_loop_has_io_uring(loop_p) ? "io_uring" : "synchronous");
+    jerry_port_loop_free(loop_p);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    char path[64], *data;
+    int fd;
+
+    bench_wheel();
+
+    snprintf(path, sizeof(path), "/tmp/bench-loop-%d", (int)getpid());
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    data = calloc(1, FILE_SIZE);
+    if (fd < 0 || write(fd, data, FILE_SIZE) != FILE_SIZE)
+        return 1;
+    close(fd);
+    free(data);
+    bench_reads(path);
+    unlink(path);
+    return 0;
+}
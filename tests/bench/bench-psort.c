@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <string.h>
+#include "psort.h"
+#include "bench-common.h"
+
+#define N (1 << 24)
+
+static int cmp_f64(const void *a, const void *b, void *opaque)
+{
+    double d1 = *(const double *)a, d2 = *(const double *)b;
+    return (d1 > d2) - (d1 < d2);
+}
+
+static void fill(double *tab, size_t n)
+{
+    uint32_t state = 2463534242u;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        tab[i] = bench_rand32(&state) * 0.25;
+}
+
+int main(int argc, char **argv)
+{
+    static const int thread_counts[] = { 1, 2, 4, 8 };
+    double *tab = malloc(sizeof(tab[0]) * N);
+    JSThreadPool *tp;
+    int64_t t0;
+    int i;
+
+    fill(tab, N);
+    t0 = bench_time_ns();
+    rqsort(tab, N, sizeof(tab[0]), cmp_f64, NULL);
+    printf("%-24s %10.1f ms\n", "rqsort", (bench_time_ns() - t0) / 1e6);
+
+    for (i = 0; i < countof(thread_counts); i++) {
+        tp = js_thread_pool_new(thread_counts[i]);
+        fill(tab, N);
+        t0 = bench_time_ns();
+        rqsort_parallel(tp, tab, N, sizeof(tab[0]), cmp_f64, NULL, 0);
+        printf("rqsort_parallel %2d threads %8.1f ms\n", thread_counts[i],
+               (bench_time_ns() - t0) / 1e6);
+        js_thread_pool_free(tp);
+    }
+    free(tab);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cutils.h"
+#include "bench-common.h"
+
+#define N (1 << 20)
+
+enum {
+    PAT_SORTED,
+    PAT_REVERSED,
+    PAT_RANDOM,
+    PAT_DUPLICATES,
+    PAT_COUNT,
+};
+
+static const char *pattern_names[PAT_COUNT] = {
+    "sorted", "reversed", "random", "duplicates",
+};
+
+static int cmp_f64(const void *a, const void *b, void *opaque)
+{
+    double d1 = *(const double *)a, d2 = *(const double *)b;
+    return (d1 > d2) - (d1 < d2);
+}
+
+static int cmp_i32(const void *a, const void *b, void *opaque)
+{
+    int32_t v1 = *(const int32_t *)a, v2 = *(const int32_t *)b;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static void fill(int32_t *tab, double *dtab, size_t n, int pattern)
+{
+    uint32_t state = 2463534242u;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        switch (pattern) {
+        case PAT_SORTED:
+            tab[i] = i;
+            break;
+        case PAT_REVERSED:
+            tab[i] = n - i;
+            break;
+        case PAT_RANDOM:
+            tab[i] = bench_rand32(&state);
+            break;
+        default:
+            tab[i] = bench_rand32(&state) % 100;
+            break;
+        }
+        dtab[i] = tab[i] * 0.5;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int32_t *tab = malloc(sizeof(tab[0]) * N);
+    double *dtab = malloc(sizeof(dtab[0]) * N);
+    int64_t t0, t[6];
+    int pattern;
+
+    printf("%-12s %10s %10s %10s %10s %10s %10s\n", "ms (1M elts)",
+           "rqsort i32", "stable i32", "radix i32",
+           "rqsort f64", "stable f64", "radix f64");
+    for (pattern = 0; pattern < PAT_COUNT; pattern++) {
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        rqsort(tab, N, sizeof(tab[0]), cmp_i32, NULL);
+        t[0] = bench_time_ns() - t0;
+
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        rqsort_stable(tab, N, sizeof(tab[0]), cmp_i32, NULL);
+        t[1] = bench_time_ns() - t0;
+
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        radix_sort_i32(tab, N);
+        t[2] = bench_time_ns() - t0;
+
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        rqsort(dtab, N, sizeof(dtab[0]), cmp_f64, NULL);
+        t[3] = bench_time_ns() - t0;
+
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        rqsort_stable(dtab, N, sizeof(dtab[0]), cmp_f64, NULL);
+        t[4] = bench_time_ns() - t0;
+
+        fill(tab, dtab, N, pattern);
+        t0 = bench_time_ns();
+        radix_sort_f64(dtab, N);
+        t[5] = bench_time_ns() - t0;
+
+        printf("%-12s %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+               pattern_names[pattern], t[0] / 1e6, t[1] / 1e6, t[2] / 1e6,
+               t[3] / 1e6, t[4] / 1e6, t[5] / 1e6);
+    }
+    free(tab);
+    free(dtab);
+    return 0;
+}
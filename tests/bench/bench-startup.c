@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+#include "context.h"
+#include "bench-common.h"
+
+#define MODULE_COUNT 4000
+#define ROUNDS 5
+
+/* a bundle of modules registered at startup: only a few of their
+   functions are called */
+static const char *module_text =
+    "modules[%d] = function(exports) {\n"
+    "    var cache = {}, count = 0;\n"
+    "    function layout(node, width, options) {\n"
+    "        var w = width * 0.5 + options.margin;\n"
+    "        for (var i = 0; i < node.children.length; i++) {\n"
+    "            var child = node.children[i];\n"
+    "            if (child.visible && child.display !== 'none')\n"
+    "                w += layout(child, w, options) | 0x1f;\n"
+    "        }\n"
+    "        count++;\n"
+    "        return w;\n"
+    "    }\n"
+    "    function format(value, digits) {\n"
+    "        var s = '' + value, pad = digits - s.length;\n"
+    "        while (pad-- > 0) s = '0' + s;\n"
+    "        return cache[value] = s;\n"
+    "    }\n"
+    "    exports.layout = layout;\n"
+    "    exports.format = format;\n"
+    "    exports.stats = function() { return { count: count, id: %d }; };\n"
+    "    return exports;\n"
+    "};\n";
+
+static const char *main_text =
+    "for (var i = 0; i < modules.length; i += 100) {\n"
+    "    var m = modules[i]({});\n"
+    "    m.format(i, 8);\n"
+    "}\n";
+
+static char *make_bundle(size_t *plen)
+{
+    char *buf, chunk[2048];
+    size_t len, size, n;
+    int i;
+
+    size = strlen(module_text) * MODULE_COUNT * 2 + 1024;
+    buf = malloc(size);
+    len = snprintf(buf, size, "var modules = [];\n");
+    for(i = 0; i < MODULE_COUNT; i++) {
+        n = snprintf(chunk, sizeof(chunk), module_text, i, i);
+        memcpy(buf + len, chunk, n);
+        len += n;
+    }
+    strcpy(buf + len, main_text);
+    len += strlen(main_text);
+    *plen = len;
+    return buf;
+}
+
+static void bench_startup(const char *name, const char *bundle, size_t len,
+                          int eval_flags)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSMemoryUsage stats;
+    JSValue val;
+    int64_t t0, best;
+    int i;
+
+    best = INT64_MAX;
+    for(i = 0; i < ROUNDS; i++) {
+        rt = JS_NewRuntime();
+        ctx = JS_NewContext(rt);
+        t0 = bench_time_ns();
+        val = JS_Eval(ctx, bundle, len, "bundle.js", eval_flags);
+        t0 = bench_time_ns() - t0;
+        if (JS_IsException(val)) {
+            fprintf(stderr, "%s: exception\n", name);
+            exit(1);
+        }
+        JS_FreeValue(ctx, val);
+        if (t0 < best)
+            best = t0;
+        if (i == ROUNDS - 1) {
+            JS_ComputeMemoryUsage(rt, &stats);
+            printf("%-8s %8.2f ms  %6" PRId64 " functions  code %8" PRId64
+                   "  functions %8" PRId64 " bytes\n", name, best / 1e6,
+                   stats.js_func_count, stats.js_func_code_size,
+                   stats.js_func_size);
+        }
+        JS_FreeContext(ctx);
+        JS_FreeRuntime(rt);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char *bundle;
+    size_t len;
+
+    bundle = make_bundle(&len);
+    printf("bundle: %d modules, %zu bytes\n", MODULE_COUNT, len);
+    bench_startup("eager", bundle, len, JS_EVAL_FLAG_EAGER);
+    bench_startup("lazy", bundle, len, 0);
+    free(bundle);
+    return 0;
+}
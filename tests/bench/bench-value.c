@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include "context.h"
+#include "bench-common.h"
+
+/* compare the JSValue layouts: build once with the default NaN boxing
+   and once with -DQJS_NAN_BOXING=OFF */
+
+#define LOOP_COUNT 1000000
+#define VALUE_COUNT (1 << 20)
+#define SCAN_COUNT 20
+
+static const struct {
+    const char *name;
+    const char *source;
+} bench_scripts[] = {
+    { "float arithmetic",
+      "var s = 0.5; for (var i = 0; i < n; i++) s = s * 0.999 + i * 0.25;" },
+    { "mixed numbers",
+      "var a = [0.5, 1, 1.5, 2], s = 0;\n"
+      "for (var i = 0; i < n; i++) { s += a[i & 3]; a[i & 3] = (s & 7) + 0.5; }" },
+    { "object fields",
+      "function P(x, y) { this.x = x; this.y = y; this.next = null; this.tag = 'p'; }\n"
+      "var l = null;\n"
+      "for (var i = 0; i < n; i++) { var p = new P(i, i * 0.5); p.next = l; l = (i & 255) ? p : null; }" },
+    { "object graph",
+      "var objs = [];\n"
+      "for (var i = 0; i < 1024; i++) objs[i] = { v: i, o: null };\n"
+      "for (var i = 0; i < n; i++) { var o = objs[i & 1023]; o.o = objs[(i * 7) & 1023]; o.v = o.o.v + 1; }" },
+};
+
+static void bench_script(JSContext *ctx, const char *name, const char *source)
+{
+    JSValue val;
+    int64_t t0;
+
+    t0 = bench_time_ns();
+    val = JS_Eval(ctx, source, strlen(source), "bench.js", 0);
+    if (JS_IsException(val)) {
+        fprintf(stderr, "%s: exception\n", name);
+        exit(1);
+    }
+    JS_FreeValue(ctx, val);
+    printf("%-24s %8.1f ns/iteration\n", name,
+           (double)(bench_time_ns() - t0) / LOOP_COUNT);
+}
+
+/* the value arrays are memory bound: their size matters */
+static void bench_value_array(JSContext *ctx)
+{
+    JSValue *tab;
+    double sum;
+    int64_t t0;
+    int i, j;
+
+    tab = malloc(sizeof(tab[0]) * VALUE_COUNT);
+    if (!tab)
+        exit(1);
+    for(i = 0; i < VALUE_COUNT; i++) {
+        if (i & 1)
+            tab[i] = JS_NewFloat64(ctx, i * 0.5);
+        else
+            tab[i] = JS_NewInt32(ctx, i);
+    }
+    sum = 0;
+    t0 = bench_time_ns();
+    for(j = 0; j < SCAN_COUNT; j++) {
+        for(i = 0; i < VALUE_COUNT; i++) {
+            if (JS_VALUE_GET_TAG(tab[i]) == JS_TAG_INT)
+                sum += JS_VALUE_GET_INT(tab[i]);
+            else
+                sum += JS_VALUE_GET_FLOAT64(tab[i]);
+        }
+    }
+    printf("%-24s %8.2f ns/value (sum=%g)\n", "value array scan",
+           (double)(bench_time_ns() - t0) / ((double)VALUE_COUNT * SCAN_COUNT),
+           sum);
+    free(tab);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSValue global;
+    int i;
+
+#ifdef JS_NAN_BOXING
+    printf("JSValue: NaN boxing, %d bytes\n", (int)sizeof(JSValue));
+#else
+    printf("JSValue: structure, %d bytes\n", (int)sizeof(JSValue));
+#endif
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "n", JS_NewInt32(ctx, LOOP_COUNT));
+    JS_FreeValue(ctx, global);
+
+    for(i = 0; i < countof(bench_scripts); i++)
+        bench_script(ctx, bench_scripts[i].name, bench_scripts[i].source);
+    bench_value_array(ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
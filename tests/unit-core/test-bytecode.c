@@ -0,0 +1,351 @@
+#include "qjs.h"
+#include "test-common.h"
+#include "bytecode.h"
+
+static JSValue compile(JSContext *ctx, const char *src, int flags)
+{
+    return JS_Eval(ctx, src, strlen(src), "test.js",
+                   flags | JS_EVAL_FLAG_COMPILE_ONLY);
+}
+
+/* the disassembly of 'src' is 'expected' */
+static void check_dump(JSContext *ctx, const char *src, const char *expected)
+{
+    JSValue val;
+    DynBuf dbuf;
+
+    val = compile(ctx, src, JS_EVAL_FLAG_EAGER);
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_FUNCTION_BYTECODE);
+    dbuf_init(&dbuf);
+    js_dump_function_bytecode(ctx, &dbuf, JS_VALUE_GET_PTR(val));
+    dbuf_putc(&dbuf, '\0');
+    TEST_ASSERT(!dbuf_error(&dbuf));
+    TEST_ASSERT_STR(expected, (char *)dbuf.buf);
+    dbuf_free(&dbuf);
+    JS_FreeValue(ctx, val);
+}
+
+/* compiling 'src' fails with a SyntaxError at 'line_num' */
+static void check_error(JSContext *ctx, const char *src, int flags,
+                        const char *message, int line_num)
+{
+    JSValue exc, val;
+    const char *str;
+
+    val = compile(ctx, src, flags);
+    TEST_ASSERT(JS_IsException(val));
+    exc = JS_GetException(ctx);
+    TEST_ASSERT(JS_IsError(ctx, exc));
+    val = JS_GetPropertyStr(ctx, exc, "message");
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT_STR(message, str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+    val = JS_GetPropertyStr(ctx, exc, "lineNumber");
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_INT);
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == line_num);
+    JS_FreeValue(ctx, exc);
+}
+
+static void test_short_forms(JSContext *ctx)
+{
+    check_dump(ctx, "var x = 1; x + 2",
+               "function : args=0 vars=1 closure_vars=0 stack_size=1 code=11 bytes\n"
+               "    0: define_var x\n"
+               "    2: push_1\n"
+               "    3: put_var x\n"
+               "    5: get_var x\n"
+               "    7: add_i8 2\n"
+               "    9: set_loc0 ; <ret>\n"
+               "   10: return\n");
+    /* arguments, closures and lexical variables */
+    check_dump(ctx, "function f(a, b = 2) { let c = a + b; return () => c + this.x; }",
+               "function : args=0 vars=1 closure_vars=0 stack_size=1 code=6 bytes\n"
+               "    0: fclosure 0\n"
+               "    2: define_func f\n"
+               "    4: get_loc0 ; <ret>\n"
+               "    5: return\n"
+               "\n"
+               "function f: args=2 vars=2 closure_vars=0 stack_size=2 code=19 bytes\n"
+               "    0: push_this\n"
+               "    1: put_loc1 ; this\n"
+               "    2: get_arg1 ; b\n"
+               "    3: undefined\n"
+               "    4: strict_eq\n"
+               "    5: if_false8 9\n"
+               "    7: push_2\n"
+               "    8: put_arg1 ; b\n"
+               "    9: set_loc_uninitialized 0 ; c\n"
+               "   12: get_arg0 ; a\n"
+               "   13: get_arg1 ; b\n"
+               "   14: add\n"
+               "   15: put_loc0 ; c\n"
+               "   16: fclosure 0\n"
+               "   18: return\n"
+               "\n"
+               "function : args=0 vars=0 closure_vars=2 stack_size=2 code=8 bytes\n"
+               "    0: get_var_ref_check 0 ; c\n"
+               "    3: get_var_ref1 ; this\n"
+               "    4: get_field x\n"
+               "    6: add\n"
+               "    7: return\n");
+    /* optional call of a method */
+    check_dump(ctx, "a.b?.(1)",
+               "function : args=0 vars=1 closure_vars=0 stack_size=3 code=19 bytes\n"
+               "    0: get_var a\n"
+               "    2: get_field2 b\n"
+               "    4: dup\n"
+               "    5: is_undefined_or_null\n"
+               "    6: if_true8 14\n"
+               "    8: push_1\n"
+               "    9: call_method 1\n"
+               "   12: goto8 17\n"
+               "   14: drop\n"
+               "   15: drop\n"
+               "   16: undefined\n"
+               "   17: set_loc0 ; <ret>\n"
+               "   18: return\n");
+}
+
+/* the fused sequences, the jump threading and the dead code */
+static void test_peephole(JSContext *ctx)
+{
+    check_dump(ctx, "function f(o) { return o.x + o.y; }",
+               "function : args=0 vars=1 closure_vars=0 stack_size=1 code=6 bytes\n"
+               "    0: fclosure 0\n"
+               "    2: define_func f\n"
+               "    4: get_loc0 ; <ret>\n"
+               "    5: return\n"
+               "\n"
+               "function f: args=1 vars=0 closure_vars=0 stack_size=2 code=8 bytes\n"
+               "    0: get_arg_get_field x ; o\n"
+               "    3: get_arg_get_field y ; o\n"
+               "    6: add\n"
+               "    7: return\n");
+    check_dump(ctx, "function g(n) { var s = 0; for (var i = 0; i < n; i++) s += i; return s; }\n"
+               "function h() { return 1; return 2; }",
+               "function : args=0 vars=1 closure_vars=0 stack_size=1 code=10 bytes\n"
+               "    0: fclosure 0\n"
+               "    2: define_func g\n"
+               "    4: fclosure 1\n"
+               "    6: define_func h\n"
+               "    8: get_loc0 ; <ret>\n"
+               "    9: return\n"
+               "\n"
+               "function g: args=1 vars=2 closure_vars=0 stack_size=2 code=24 bytes\n"
+               "    0: push_0\n"
+               "    1: put_loc0 ; s\n"
+               "    2: push_0\n"
+               "    3: put_loc1 ; i\n"
+               "    4: get_loc1 ; i\n"
+               "    5: get_arg0 ; n\n"
+               "    6: lt_if_false8 22\n"
+               "    8: goto8 16\n"
+               "   10: get_loc1 ; i\n"
+               "   11: post_inc\n"
+               "   12: put_loc1 ; i\n"
+               "   13: drop\n"
+               "   14: goto8 4\n"
+               "   16: get_loc0 ; s\n"
+               "   17: get_loc1 ; i\n"
+               "   18: add\n"
+               "   19: put_loc0 ; s\n"
+               "   20: goto8 10\n"
+               "   22: get_loc0 ; s\n"
+               "   23: return\n"
+               "\n"
+               "function h: args=0 vars=0 closure_vars=0 stack_size=1 code=2 bytes\n"
+               "    0: push_1\n"
+               "    1: return\n");
+}
+
+/* the first instruction with opcode 'op' after 'pos' */
+static int find_opcode(JSFunctionBytecode *b, int op, int pos)
+{
+    for(; pos < b->byte_code_len; pos += js_opcode_size(b->byte_code_buf + pos)) {
+        if (b->byte_code_buf[pos] == op)
+            return pos;
+    }
+    return -1;
+}
+
+static void test_pc2line(JSContext *ctx)
+{
+    JSFunctionBytecode *b;
+    DynBuf dbuf;
+    JSValue val;
+    int i, pos;
+
+    /* small deltas and a large line jump */
+    dbuf_init(&dbuf);
+    dbuf_printf(&dbuf, "x = 1;\ny = 2;");
+    for(i = 0; i < 1000; i++)
+        dbuf_putc(&dbuf, '\n');
+    dbuf_printf(&dbuf, "z = 3;\n");
+    dbuf_putc(&dbuf, '\0');
+    TEST_ASSERT(!dbuf_error(&dbuf));
+
+    val = compile(ctx, (char *)dbuf.buf, 0);
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_FUNCTION_BYTECODE);
+    b = JS_VALUE_GET_PTR(val);
+    TEST_ASSERT(b->debug.pc2line_len > 0);
+    pos = find_opcode(b, OP_put_var, 0);
+    TEST_ASSERT(js_bytecode_find_line_num(b, pos) == 1);
+    pos = find_opcode(b, OP_put_var, pos + 1);
+    TEST_ASSERT(js_bytecode_find_line_num(b, pos) == 2);
+    pos = find_opcode(b, OP_put_var, pos + 1);
+    TEST_ASSERT(js_bytecode_find_line_num(b, pos) == 1002);
+    JS_FreeValue(ctx, val);
+    dbuf_free(&dbuf);
+}
+
+static void test_memory_usage(JSContext *ctx)
+{
+    JSMemoryUsage s0, s1;
+    JSValue val;
+
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s0);
+    val = compile(ctx, "function f() {\n return 1;\n}\nf();\n",
+                  JS_EVAL_FLAG_EAGER);
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_FUNCTION_BYTECODE);
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s1);
+    TEST_ASSERT(s1.js_func_count == s0.js_func_count + 2);
+    TEST_ASSERT(s1.js_func_code_size > s0.js_func_code_size);
+    TEST_ASSERT(s1.js_func_pc2line_count == s0.js_func_pc2line_count + 2);
+    TEST_ASSERT(s1.js_func_size > s0.js_func_size);
+    JS_FreeValue(ctx, val);
+
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s1);
+    TEST_ASSERT(s1.js_func_count == s0.js_func_count);
+}
+
+/* the inner functions are compiled on their first call */
+static void test_lazy_functions(JSContext *ctx)
+{
+    static const char src[] =
+        "var k = 3;\n"
+        "function f(a, b) {\n"
+        "  var c = a * k;\n"
+        "  return function g() { return c + b; };\n"
+        "}\n"
+        "(function() { k++; })();\n";
+    JSMemoryUsage s0, s1, s2;
+    JSValue val, val2;
+    DynBuf dbuf;
+
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s0);
+    val = compile(ctx, src, JS_EVAL_FLAG_EAGER);
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s1);
+    val2 = compile(ctx, src, 0);
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s2);
+    /* 'g' is not parsed again, the call in parentheses is compiled */
+    TEST_ASSERT(s1.js_func_count - s0.js_func_count == 4);
+    TEST_ASSERT(s2.js_func_count - s1.js_func_count == 3);
+    TEST_ASSERT(s2.js_func_code_size - s1.js_func_code_size <
+                s1.js_func_code_size - s0.js_func_code_size);
+    JS_FreeValue(ctx, val);
+    JS_FreeValue(ctx, val2);
+
+    /* only the source of the arguments and of the body is kept */
+    val = compile(ctx, "x = (a) => a + 1;", 0);
+    dbuf_init(&dbuf);
+    js_dump_function_bytecode(ctx, &dbuf, JS_VALUE_GET_PTR(val));
+    dbuf_putc(&dbuf, '\0');
+    TEST_ASSERT(!dbuf_error(&dbuf));
+    TEST_ASSERT_STR("function : args=0 vars=1 closure_vars=0 stack_size=2 code=7 bytes\n"
+                    "    0: fclosure 0\n"
+                    "    2: dup\n"
+                    "    3: put_var x\n"
+                    "    5: set_loc0 ; <ret>\n"
+                    "    6: return\n"
+                    "\n"
+                    "function x: not compiled, source=12 bytes\n",
+                    (char *)dbuf.buf);
+    dbuf_free(&dbuf);
+    JS_FreeValue(ctx, val);
+}
+
+/* the inner function 'idx' of 'b' */
+static JSFunctionBytecode *get_inner_function(JSFunctionBytecode *b, int idx)
+{
+    TEST_ASSERT(idx < b->cpool_count);
+    TEST_ASSERT(JS_VALUE_GET_TAG(b->cpool[idx]) == JS_TAG_FUNCTION_BYTECODE);
+    return JS_VALUE_GET_PTR(b->cpool[idx]);
+}
+
+/* the closure variables which are copied, as a string of 0 and 1 */
+static void check_copied_vars(JSFunctionBytecode *b, const char *expected)
+{
+    char buf[32];
+    int i;
+
+    TEST_ASSERT(b->closure_var_count < sizeof(buf));
+    for(i = 0; i < b->closure_var_count; i++)
+        buf[i] = '0' + b->closure_var[i].is_copied;
+    buf[i] = '\0';
+    TEST_ASSERT_STR(expected, buf);
+}
+
+static void test_copied_closure_vars(JSContext *ctx)
+{
+    static const char src[] =
+        "function f(a, b) {\n"
+        "  var c = a * 2, d = 0, e = 1;\n"
+        "  var g = function() { d++; return function() { return a + c + d; }; };\n"
+        "  e = 2;\n"
+        "  for (var i = 0; i < b; i++) { let l = i; g = () => l + e; }\n"
+        "  e = 3;\n"
+        "  return g;\n"
+        "}\n";
+    JSFunctionBytecode *f, *g;
+    JSValue val;
+
+    val = compile(ctx, src, JS_EVAL_FLAG_EAGER);
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_FUNCTION_BYTECODE);
+    f = get_inner_function(JS_VALUE_GET_PTR(val), 0);
+    /* a, c: not modified, d: modified by the closure */
+    g = get_inner_function(f, 0);
+    check_copied_vars(g, "110");
+    /* the copies of the parent are copied */
+    check_copied_vars(get_inner_function(g, 0), "110");
+    /* l: a new variable per iteration, e: modified after the capture */
+    check_copied_vars(get_inner_function(f, 1), "10");
+    JS_FreeValue(ctx, val);
+}
+
+static void test_errors(JSContext *ctx)
+{
+    check_error(ctx, "var a;\nlet a;", 0,
+                "invalid redefinition of lexical identifier", 2);
+    check_error(ctx, "x = 1;\n\nx +;", 0, "unexpected token: ';'", 3);
+    check_error(ctx, "-x ** 2", 0,
+                "unparenthesized unary expression can't appear on the left-hand side of '**'", 1);
+    check_error(ctx, "while (1) {\n  continue foo;\n}", 0,
+                "break/continue label not found", 2);
+    check_error(ctx, "function f() {\n  'use strict';\n  delete x;\n}", 0,
+                "cannot delete a direct reference in strict mode", 3);
+    check_error(ctx, "delete x", JS_EVAL_FLAG_STRICT,
+                "cannot delete a direct reference in strict mode", 1);
+    check_error(ctx, "class A {}", 0, "classes are not supported", 1);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+
+    test_short_forms(ctx);
+    test_peephole(ctx);
+    test_pc2line(ctx);
+    test_memory_usage(ctx);
+    test_lazy_functions(ctx);
+    test_copied_closure_vars(ctx);
+    test_errors(ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
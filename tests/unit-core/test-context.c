@@ -0,0 +1,348 @@
+#include "context.h"
+#include "test-common.h"
+
+static void check_string(JSContext *ctx, JSValueConst val, const char *expected)
+{
+    const char *str;
+
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT(str != NULL);
+    TEST_ASSERT_STR(expected, str);
+    JS_FreeCString(ctx, str);
+}
+
+static JSValue js_add(JSContext *ctx, JSValueConst this_val,
+                      int argc, JSValueConst *argv)
+{
+    /* the missing arguments are undefined */
+    if (!JS_IsNumber(argv[0]) || !JS_IsNumber(argv[1]))
+        return JS_ThrowTypeError(ctx, "not a number");
+    return JS_NewInt32(ctx, JS_VALUE_GET_INT(argv[0]) +
+                       JS_VALUE_GET_INT(argv[1]));
+}
+
+static void test_properties(JSContext *ctx)
+{
+    JSValue obj1, obj2, val;
+    JSAtom atom;
+
+    obj1 = JS_NewObject(ctx);
+    obj2 = JS_NewObject(ctx);
+    TEST_ASSERT(JS_SetPropertyStr(ctx, obj1, "x", JS_NewInt32(ctx, 1)) == TRUE);
+    TEST_ASSERT(JS_SetPropertyStr(ctx, obj1, "y", JS_NewString(ctx, "hello")) == TRUE);
+    TEST_ASSERT(JS_SetPropertyStr(ctx, obj2, "x", JS_NewInt32(ctx, 2)) == TRUE);
+    TEST_ASSERT(JS_SetPropertyStr(ctx, obj2, "y", JS_NULL) == TRUE);
+    /* same layout: the hashed shape is shared */
+    TEST_ASSERT(JS_VALUE_GET_OBJ(obj1)->shape == JS_VALUE_GET_OBJ(obj2)->shape);
+
+    val = JS_GetPropertyStr(ctx, obj2, "x");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 2);
+    val = JS_GetPropertyStr(ctx, obj1, "y");
+    check_string(ctx, val, "hello");
+    JS_FreeValue(ctx, val);
+
+    /* inherited from Object.prototype */
+    val = JS_GetPropertyStr(ctx, obj1, "toString");
+    TEST_ASSERT(JS_IsFunction(ctx, val));
+    JS_FreeValue(ctx, val);
+    check_string(ctx, obj1, "[object Object]");
+
+    atom = JS_NewAtom(ctx, "x");
+    TEST_ASSERT(JS_DeleteProperty(ctx, obj1, atom, 0) == TRUE);
+    JS_FreeAtom(ctx, atom);
+    TEST_ASSERT(JS_VALUE_GET_OBJ(obj1)->shape != JS_VALUE_GET_OBJ(obj2)->shape);
+    val = JS_GetPropertyStr(ctx, obj1, "x");
+    TEST_ASSERT(JS_IsUndefined(val));
+    val = JS_GetPropertyStr(ctx, obj2, "x");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 2);
+
+    /* read-only property */
+    TEST_ASSERT(JS_DefinePropertyValueStr(ctx, obj2, "z", JS_NewInt32(ctx, 3), 0) == TRUE);
+    TEST_ASSERT(JS_SetPropertyStr(ctx, obj2, "z", JS_NewInt32(ctx, 4)) == -1);
+    val = JS_GetException(ctx);
+    TEST_ASSERT(JS_IsError(ctx, val));
+    check_string(ctx, val, "TypeError: 'z' is read-only");
+    JS_FreeValue(ctx, val);
+
+    /* cycle collected by JS_RunGC() */
+    JS_SetPropertyStr(ctx, obj1, "other", JS_DupValue(ctx, obj2));
+    JS_SetPropertyStr(ctx, obj2, "other", JS_DupValue(ctx, obj1));
+    JS_FreeValue(ctx, obj1);
+    JS_FreeValue(ctx, obj2);
+}
+
+static void test_functions(JSContext *ctx)
+{
+    JSValue global, func, args[2], val, ctor;
+
+    global = JS_GetGlobalObject(ctx);
+    func = JS_NewCFunction(ctx, js_add, "add", 2);
+    JS_SetPropertyStr(ctx, global, "add", JS_DupValue(ctx, func));
+
+    args[0] = JS_NewInt32(ctx, 40);
+    args[1] = JS_NewInt32(ctx, 2);
+    val = JS_Call(ctx, func, JS_UNDEFINED, 2, args);
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 42);
+    val = JS_Call(ctx, func, JS_UNDEFINED, 1, args);
+    TEST_ASSERT(JS_IsException(val));
+    val = JS_GetException(ctx);
+    check_string(ctx, val, "TypeError: not a number");
+    JS_FreeValue(ctx, val);
+
+    val = JS_GetPropertyStr(ctx, func, "name");
+    check_string(ctx, val, "add");
+    JS_FreeValue(ctx, val);
+    val = JS_GetPropertyStr(ctx, func, "length");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 2);
+    TEST_ASSERT(JS_IsException(JS_CallConstructor(ctx, func, 0, NULL)));
+    JS_FreeValue(ctx, JS_GetException(ctx));
+
+    /* new RangeError("bad") */
+    ctor = JS_GetPropertyStr(ctx, global, "RangeError");
+    args[0] = JS_NewString(ctx, "bad");
+    val = JS_CallConstructor(ctx, ctor, 1, args);
+    JS_FreeValue(ctx, args[0]);
+    TEST_ASSERT(JS_IsError(ctx, val));
+    check_string(ctx, val, "RangeError: bad");
+    JS_FreeValue(ctx, val);
+    JS_FreeValue(ctx, ctor);
+
+    JS_FreeValue(ctx, func);
+    JS_FreeValue(ctx, global);
+}
+
+static void test_clone(JSRuntime *rt, JSContext *tmpl)
+{
+    JSContext *ctx1, *ctx2;
+    JSValue global, global1, global2, proto, proto1, val, args[2];
+
+    global = JS_GetGlobalObject(tmpl);
+    JS_SetPropertyStr(tmpl, global, "config", JS_NewString(tmpl, "template"));
+
+    ctx1 = JS_CloneContext(tmpl);
+    ctx2 = JS_CloneContext(tmpl);
+    TEST_ASSERT(ctx1 != NULL && ctx2 != NULL);
+
+    global1 = JS_GetGlobalObject(ctx1);
+    global2 = JS_GetGlobalObject(ctx2);
+    TEST_ASSERT(JS_VALUE_GET_OBJ(global1) != JS_VALUE_GET_OBJ(global));
+    /* the shapes are shared until modified */
+    TEST_ASSERT(JS_VALUE_GET_OBJ(global1)->shape == JS_VALUE_GET_OBJ(global)->shape);
+
+    val = JS_GetPropertyStr(ctx1, global1, "config");
+    check_string(ctx1, val, "template");
+    JS_FreeValue(ctx1, val);
+
+    /* the globals and the prototypes are isolated */
+    JS_SetPropertyStr(ctx1, global1, "config", JS_NewString(ctx1, "clone1"));
+    JS_SetPropertyStr(ctx1, global1, "extra", JS_NewInt32(ctx1, 1));
+    proto1 = ctx1->class_proto[JS_CLASS_OBJECT];
+    JS_SetPropertyStr(ctx1, proto1, "polluted", JS_TRUE);
+    TEST_ASSERT(JS_VALUE_GET_OBJ(global1)->shape != JS_VALUE_GET_OBJ(global)->shape);
+
+    val = JS_GetPropertyStr(tmpl, global, "config");
+    check_string(tmpl, val, "template");
+    JS_FreeValue(tmpl, val);
+    val = JS_GetPropertyStr(ctx2, global2, "config");
+    check_string(ctx2, val, "template");
+    JS_FreeValue(ctx2, val);
+    TEST_ASSERT(JS_IsUndefined(JS_GetPropertyStr(ctx2, global2, "extra")));
+    TEST_ASSERT(JS_IsUndefined(JS_GetPropertyStr(tmpl, global, "polluted")));
+    val = JS_GetPropertyStr(ctx1, global1, "polluted");
+    TEST_ASSERT(JS_IsBool(val) && JS_VALUE_GET_BOOL(val));
+
+    /* the object graph is preserved inside the clone */
+    proto = JS_GetPrototype(ctx2, global2);
+    TEST_ASSERT(JS_VALUE_GET_OBJ(proto) ==
+                JS_VALUE_GET_OBJ(ctx2->class_proto[JS_CLASS_OBJECT]));
+    JS_FreeValue(ctx2, proto);
+    val = JS_GetPropertyStr(ctx2, global2, "globalThis");
+    TEST_ASSERT(JS_VALUE_GET_OBJ(val) == JS_VALUE_GET_OBJ(global2));
+    JS_FreeValue(ctx2, val);
+
+    /* the C functions run in the realm of the clone */
+    val = JS_GetPropertyStr(ctx2, global2, "add");
+    TEST_ASSERT(JS_VALUE_GET_OBJ(val)->u.cfunc.realm == ctx2);
+    args[0] = JS_NewInt32(ctx2, 1);
+    args[1] = JS_NewInt32(ctx2, 2);
+    TEST_ASSERT(JS_VALUE_GET_INT(JS_Call(ctx2, val, JS_UNDEFINED, 2, args)) == 3);
+    JS_FreeValue(ctx2, val);
+    JS_ThrowTypeError(ctx2, "from clone");
+    val = JS_GetException(ctx2);
+    proto = JS_GetPrototype(ctx2, val);
+    TEST_ASSERT(JS_VALUE_GET_OBJ(proto) ==
+                JS_VALUE_GET_OBJ(ctx2->native_error_proto[JS_TYPE_ERROR]));
+    JS_FreeValue(ctx2, proto);
+    JS_FreeValue(ctx2, val);
+
+    JS_FreeValue(ctx1, global1);
+    JS_FreeValue(ctx2, global2);
+    JS_FreeContext(ctx1);
+    JS_FreeContext(ctx2);
+    JS_FreeValue(tmpl, global);
+    JS_RunGC(rt);
+}
+
+/* the objects built in the same order share one transition chain */
+static void test_shapes(JSRuntime *rt, JSContext *ctx)
+{
+    JSMemoryUsage stats0, stats;
+    JSValue objs[100], obj, big, val;
+    JSShape *sh;
+    JSAtom atom;
+    char name[16];
+    int i, j;
+
+    JS_ComputeMemoryUsage(rt, &stats0);
+    for(i = 0; i < countof(objs); i++) {
+        objs[i] = JS_NewObject(ctx);
+        for(j = 0; j < 12; j++) {
+            snprintf(name, sizeof(name), "p%d", j);
+            JS_SetPropertyStr(ctx, objs[i], name, JS_NewInt32(ctx, i + j));
+        }
+    }
+    JS_ComputeMemoryUsage(rt, &stats);
+    sh = JS_VALUE_GET_OBJ(objs[0])->shape;
+    TEST_ASSERT(sh->is_hashed && sh->prop_count == 12);
+    TEST_ASSERT(stats.shape_count == stats0.shape_count + 12);
+    /* the table of 12 properties is shared by the shapes of the chain */
+    TEST_ASSERT(sh->table == sh->parent->parent->table);
+    TEST_ASSERT(sh->table->hash != NULL);
+    TEST_ASSERT(stats.shape_size - stats0.shape_size <
+                12 * sizeof(JSShape) + 16 * 4 * sizeof(JSShapeProperty));
+
+    /* another branch after 'p5' */
+    obj = JS_NewObject(ctx);
+    for(j = 0; j < 6; j++) {
+        snprintf(name, sizeof(name), "p%d", j);
+        JS_SetPropertyStr(ctx, obj, name, JS_NewInt32(ctx, j));
+    }
+    TEST_ASSERT(JS_VALUE_GET_OBJ(obj)->shape->table == sh->table);
+    JS_SetPropertyStr(ctx, obj, "q", JS_NewInt32(ctx, 100));
+    TEST_ASSERT(JS_VALUE_GET_OBJ(obj)->shape->table != sh->table);
+    val = JS_GetPropertyStr(ctx, obj, "q");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 100);
+    val = JS_GetPropertyStr(ctx, obj, "p6");
+    TEST_ASSERT(JS_IsUndefined(val));
+    val = JS_GetPropertyStr(ctx, objs[7], "p11");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 18);
+    JS_FreeValue(ctx, obj);
+
+    /* a deletion gives a private shape */
+    atom = JS_NewAtom(ctx, "p3");
+    TEST_ASSERT(JS_DeleteProperty(ctx, objs[1], atom, 0) == TRUE);
+    JS_FreeAtom(ctx, atom);
+    TEST_ASSERT(!JS_VALUE_GET_OBJ(objs[1])->shape->is_hashed);
+    val = JS_GetPropertyStr(ctx, objs[1], "p3");
+    TEST_ASSERT(JS_IsUndefined(val));
+    val = JS_GetPropertyStr(ctx, objs[1], "p4");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 5);
+    val = JS_GetPropertyStr(ctx, objs[2], "p3");
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == 5);
+
+    /* the large objects leave the tree */
+    big = JS_NewObject(ctx);
+    for(j = 0; j < 200; j++) {
+        snprintf(name, sizeof(name), "b%d", j);
+        JS_SetPropertyStr(ctx, big, name, JS_NewInt32(ctx, j));
+    }
+    TEST_ASSERT(!JS_VALUE_GET_OBJ(big)->shape->is_hashed);
+    for(j = 0; j < 200; j++) {
+        snprintf(name, sizeof(name), "b%d", j);
+        val = JS_GetPropertyStr(ctx, big, name);
+        TEST_ASSERT(JS_VALUE_GET_INT(val) == j);
+    }
+    JS_FreeValue(ctx, big);
+
+    for(i = 0; i < countof(objs); i++)
+        JS_FreeValue(ctx, objs[i]);
+    JS_ComputeMemoryUsage(rt, &stats);
+    TEST_ASSERT(stats.shape_count == stats0.shape_count);
+}
+
+/* the element storage of the fast arrays */
+static void test_arrays(JSRuntime *rt, JSContext *tmpl)
+{
+    static const char source[] =
+        "var ai = [1, 2, 3], ad = [], av = [1, 'x', {}], ah = [1, 2];\n"
+        "for (var i = 0; i < 100; i++) ad[i] = i + 0.5;\n"
+        "delete ah[0]; ah[1] = [ah]; 0";
+    static const char source1[] =
+        "ai[0] = 'y'; ad[99] = 0; ai[0] + ad[98] + av[1] + ah[1][0].length";
+    static const char source2[] = "ai[0] + ':' + ad[99]";
+    JSMemoryUsage stats;
+    JSContext *ctx;
+    JSValue global, val;
+    JSObject *p;
+
+    val = JS_Eval(tmpl, source, strlen(source), "test.js", 0);
+    TEST_ASSERT(!JS_IsException(val));
+    global = JS_GetGlobalObject(tmpl);
+    val = JS_GetPropertyStr(tmpl, global, "ai");
+    p = JS_VALUE_GET_OBJ(val);
+    TEST_ASSERT(p->fast_array && p->u.array.kind == JS_ARRAY_KIND_INT &&
+                p->u.array.count == 3);
+    JS_FreeValue(tmpl, val);
+    val = JS_GetPropertyStr(tmpl, global, "ad");
+    p = JS_VALUE_GET_OBJ(val);
+    TEST_ASSERT(p->fast_array && p->u.array.kind == JS_ARRAY_KIND_DOUBLE &&
+                p->u.array.count == 100 && p->u.array.size >= 100);
+    JS_FreeValue(tmpl, val);
+    val = JS_GetPropertyStr(tmpl, global, "av");
+    p = JS_VALUE_GET_OBJ(val);
+    TEST_ASSERT(p->fast_array && p->u.array.kind == JS_ARRAY_KIND_VALUE);
+    JS_FreeValue(tmpl, val);
+    /* a hole gives a generic array */
+    val = JS_GetPropertyStr(tmpl, global, "ah");
+    TEST_ASSERT(!JS_VALUE_GET_OBJ(val)->fast_array);
+    JS_FreeValue(tmpl, val);
+    JS_ComputeMemoryUsage(rt, &stats);
+    TEST_ASSERT(stats.fast_array_count >= 4 &&
+                stats.fast_array_elements >= 3 + 100 + 3 + 1);
+
+    /* the clones have their own elements */
+    ctx = JS_CloneContext(tmpl);
+    TEST_ASSERT(ctx != NULL);
+    val = JS_Eval(ctx, source1, strlen(source1), "test.js", 0);
+    check_string(ctx, val, "y98.5x2");
+    JS_FreeValue(ctx, val);
+    JS_FreeContext(ctx);
+    val = JS_Eval(tmpl, source2, strlen(source2), "test.js", 0);
+    check_string(tmpl, val, "1:99.5");
+    JS_FreeValue(tmpl, val);
+    JS_FreeValue(tmpl, global);
+}
+
+int main(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSMemoryUsage stats;
+    int64_t obj_count;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    TEST_ASSERT(ctx != NULL);
+
+    JS_RunGC(rt);
+    JS_ComputeMemoryUsage(rt, &stats);
+    obj_count = stats.obj_count;
+
+    test_properties(ctx);
+    test_functions(ctx);
+    test_shapes(rt, ctx);
+    JS_RunGC(rt);
+    JS_ComputeMemoryUsage(rt, &stats);
+    /* only the 'add' function was added */
+    TEST_ASSERT(stats.obj_count == obj_count + 1);
+
+    test_clone(rt, ctx);
+    JS_ComputeMemoryUsage(rt, &stats);
+    TEST_ASSERT(stats.obj_count == obj_count + 1);
+
+    test_arrays(rt, ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "test-common.h"
+#include "dtoa.h"
+
+static uint64_t rand_u64(void)
+{
+    return ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ rand();
+}
+
+static double u64_to_dbl(uint64_t v)
+{
+    union { uint64_t u; double d; } u = { .u = v };
+    return u.d;
+}
+
+/* number of significant digits of the shortest correctly rounded
+   representation which round trips, computed the slow way. For powers
+   of two a shorter representation which is not the closest at that
+   precision may exist. */
+static int ref_shortest_len(double d)
+{
+    char buf[64];
+    int prec;
+
+    for (prec = 1; prec < 17; prec++) {
+        snprintf(buf, sizeof(buf), "%.*e", prec - 1, d);
+        if (strtod(buf, NULL) == d)
+            break;
+    }
+    return prec;
+}
+
+static int digit_count(const char *s)
+{
+    int n = 0, leading = 1;
+    for (; *s && *s != 'e'; s++) {
+        if (*s >= '0' && *s <= '9') {
+            if (*s != '0')
+                leading = 0;
+            if (!leading)
+                n++;
+        }
+    }
+    return n;
+}
+
+static void check_dtoa(double d, const char *expected)
+{
+    char buf[JS_DTOA_MAX_LEN];
+    js_dtoa(buf, d);
+    TEST_ASSERT_STR(expected, buf);
+}
+
+static void check_roundtrip(double d)
+{
+    char buf[JS_DTOA_MAX_LEN];
+    const char *p;
+    size_t len;
+    int e;
+
+    len = js_dtoa(buf, d);
+    TEST_ASSERT(len < JS_DTOA_MAX_LEN && len == strlen(buf));
+    TEST_ASSERT(strtod(buf, NULL) == d);
+    TEST_ASSERT(js_strtod(buf, &p) == d && *p == '\0');
+    /* trailing zeros of integers are not significant */
+    if (strchr(buf, '.') || strchr(buf, 'e')) {
+        if (fabs(frexp(d, &e)) == 0.5)
+            TEST_ASSERT(digit_count(buf) <= ref_shortest_len(d));
+        else
+            TEST_ASSERT(digit_count(buf) == ref_shortest_len(d));
+    }
+}
+
+static void check_strtod(const char *str)
+{
+    const char *p1;
+    char *p2;
+    double d1, d2;
+
+    d1 = js_strtod(str, &p1);
+    d2 = strtod(str, &p2);
+    TEST_ASSERT(memcmp(&d1, &d2, sizeof(d1)) == 0);
+    TEST_ASSERT(p1 == p2);
+}
+
+int main(int argc, char **argv) {
+    char buf[JS_DTOA_MAX_LEN * 4];
+    DynBuf dbuf;
+    const char *p;
+    int i, j;
+
+    srand(1234);
+
+    /* integers */
+    TEST_ASSERT(u32toa(buf, 0) == 1 && !strcmp(buf, "0"));
+    TEST_ASSERT_STR("4294967295", (u32toa(buf, UINT32_MAX), buf));
+    TEST_ASSERT_STR("-2147483648", (i32toa(buf, INT32_MIN), buf));
+    TEST_ASSERT_STR("18446744073709551615", (u64toa(buf, UINT64_MAX), buf));
+    TEST_ASSERT_STR("-9223372036854775808", (i64toa(buf, INT64_MIN), buf));
+    TEST_ASSERT_STR("100000000", (u64toa(buf, 100000000), buf));
+    TEST_ASSERT_STR("4294967296", (u64toa(buf, 4294967296ULL), buf));
+    for (i = 0; i < 10000; i++) {
+        int64_t v = (int64_t)rand_u64() >> (rand() % 64);
+        char ref[32];
+        snprintf(ref, sizeof(ref), "%" PRId64, v);
+        i64toa(buf, v);
+        TEST_ASSERT_STR(ref, buf);
+    }
+
+    /* Number.prototype.toString layout */
+    check_dtoa(0.0, "0");
+    check_dtoa(-0.0, "0");
+    check_dtoa(NAN, "NaN");
+    check_dtoa(-INFINITY, "-Infinity");
+    check_dtoa(0.1, "0.1");
+    check_dtoa(0.1 + 0.2, "0.30000000000000004");
+    check_dtoa(-1.5, "-1.5");
+    check_dtoa(100, "100");
+    check_dtoa(1e20, "100000000000000000000");
+    check_dtoa(1e21, "1e+21");
+    check_dtoa(123456789012345680000.0, "123456789012345680000");
+    check_dtoa(0.000001, "0.000001");
+    check_dtoa(1.5e-7, "1.5e-7");
+    check_dtoa(123e-20, "1.23e-18");
+    check_dtoa(5e-324, "5e-324");
+    check_dtoa(1.7976931348623157e308, "1.7976931348623157e+308");
+    check_dtoa(2.2250738585072014e-308, "2.2250738585072014e-308");
+    check_dtoa(9007199254740993.0, "9007199254740992");
+    check_dtoa(18014398509481984.0, "18014398509481984");
+    check_dtoa(1152921504606846976.0, "1152921504606847000");
+
+    /* random bit patterns (Grisu3 and bignum paths) */
+    for (i = 0; i < 200000; i++) {
+        double d = u64_to_dbl(rand_u64());
+        if (isnan(d))
+            continue;
+        check_roundtrip(d);
+    }
+    /* denormals and powers of two (lower boundary closer) */
+    for (i = 0; i < 2046; i++)
+        check_roundtrip(ldexp(1.0, i - 1074));
+    for (i = 0; i < 20000; i++)
+        check_roundtrip(u64_to_dbl(rand_u64() & 0x000fffffffffffffULL));
+
+    /* parsing */
+    check_strtod("0");
+    check_strtod("-0");
+    check_strtod("12345");
+    check_strtod("1.5e10");
+    check_strtod(".5");
+    check_strtod("5.");
+    check_strtod("1e");
+    check_strtod("1e+");
+    check_strtod("2.2250738585072011e-308");
+    check_strtod("2.4703282292062327e-324");
+    check_strtod("2.4703282292062328e-324");
+    check_strtod("1.7976931348623158e308");
+    check_strtod("1.7976931348623159e308");
+    check_strtod("1e400");
+    check_strtod("1e-400");
+    check_strtod("9007199254740993");
+    check_strtod("123456789012345678901234567890e-10");
+    /* halfway case which needs all its digits */
+    check_strtod("9007199254740992.999999999999999999999999999999999999999999");
+    check_strtod("9007199254740993.000000000000000000000000000000000000000001");
+    check_strtod("9007199254740993.0000000000000000000000000000000000000000000");
+    for (i = 0; i < 100000; i++) {
+        int nd = 1 + rand() % 25;
+        char *q = buf;
+        if (rand() & 1)
+            *q++ = '-';
+        for (j = 0; j < nd; j++) {
+            if (j == rand() % nd)
+                *q++ = '.';
+            *q++ = '0' + rand() % 10;
+        }
+        q += sprintf(q, "e%d", rand() % 700 - 350);
+        check_strtod(buf);
+    }
+    TEST_ASSERT(js_strtod("Infinity", &p) == INFINITY && *p == '\0');
+    TEST_ASSERT(js_strtod("-Infinity", &p) == -INFINITY && *p == '\0');
+    TEST_ASSERT(isnan(js_strtod("abc", &p)) && !strcmp(p, "abc"));
+    TEST_ASSERT(isnan(js_strtod("-.e1", &p)) && !strcmp(p, "-.e1"));
+
+    /* DynBuf output */
+    dbuf_init(&dbuf);
+    dbuf_put_itoa(&dbuf, -42);
+    dbuf_putc(&dbuf, ',');
+    dbuf_put_dtoa(&dbuf, 0.25);
+    dbuf_putc(&dbuf, '\0');
+    TEST_ASSERT_STR("-42,0.25", dbuf.buf);
+    dbuf_free(&dbuf);
+    return 0;
+}
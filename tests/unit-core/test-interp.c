@@ -0,0 +1,473 @@
+#include "qjs.h"
+#include "test-common.h"
+
+/* run 'source' and compare the string conversion of its result */
+static void check_eval(JSContext *ctx, const char *source,
+                       const char *expected)
+{
+    JSValue val;
+    const char *str;
+
+    val = JS_Eval(ctx, source, strlen(source), "test.js", 0);
+    if (JS_IsException(val))
+        val = JS_GetException(ctx);
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT(str != NULL);
+    if (strcmp(str, expected) != 0)
+        printf("%s\n-> %s\n", source, str);
+    TEST_ASSERT_STR(expected, str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+}
+
+/* the encoding of the values (NaN boxed or not) */
+static void test_values(JSContext *ctx)
+{
+    JSValue v;
+    union {
+        double d;
+        uint64_t u64;
+    } u;
+
+#ifdef JS_NAN_BOXING
+    TEST_ASSERT(sizeof(JSValue) == 8);
+#endif
+    v = JS_NewInt32(ctx, -5);
+    TEST_ASSERT(JS_VALUE_GET_TAG(v) == JS_TAG_INT && JS_VALUE_GET_INT(v) == -5);
+    v = JS_NewFloat64(ctx, -0.0);
+    TEST_ASSERT(JS_VALUE_GET_NORM_TAG(v) == JS_TAG_FLOAT64);
+    TEST_ASSERT(JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(v)) && !JS_VALUE_HAS_REF_COUNT(v));
+    TEST_ASSERT(signbit(JS_VALUE_GET_FLOAT64(v)));
+    v = JS_NewFloat64(ctx, -INFINITY);
+    TEST_ASSERT(JS_VALUE_GET_NORM_TAG(v) == JS_TAG_FLOAT64 &&
+                JS_VALUE_GET_FLOAT64(v) == -INFINITY);
+    /* all the NaNs are the same value */
+    u.u64 = 0xfff8000000000001;
+    v = JS_NewFloat64(ctx, u.d);
+    TEST_ASSERT(JS_VALUE_GET_NORM_TAG(v) == JS_TAG_FLOAT64 &&
+                isnan(JS_VALUE_GET_FLOAT64(v)));
+    v = JS_NewBool(ctx, 1);
+    TEST_ASSERT(JS_VALUE_GET_TAG(v) == JS_TAG_BOOL && JS_VALUE_GET_BOOL(v));
+    TEST_ASSERT(JS_VALUE_GET_TAG(JS_UNDEFINED) == JS_TAG_UNDEFINED);
+    v = JS_NewString(ctx, "str");
+    TEST_ASSERT(JS_IsString(v) && JS_VALUE_HAS_REF_COUNT(v));
+    JS_FreeValue(ctx, v);
+
+    check_eval(ctx, "var z = -0; (1 / z) + ':' + (0 / 0 !== 0 / 0) + ':' + (-1e308 * 10)",
+               "-Infinity:true:-Infinity");
+    check_eval(ctx, "var o = { d: 1.5, i: 3, s: 's', n: null }; o.d * 2 + o.i + o.s + o.n",
+               "6snull");
+}
+
+static void test_operators(JSContext *ctx)
+{
+    check_eval(ctx, "1 + 2 * 3", "7");
+    check_eval(ctx, "2147483647 + 1", "2147483648");
+    check_eval(ctx, "0.1 + 0.2", "0.30000000000000004");
+    check_eval(ctx, "2 ** 10 - 7 % -3", "1023");
+    check_eval(ctx, "-7 % 3 + 1 / 4", "-0.75");
+    check_eval(ctx, "1 / (0 * -1)", "-Infinity");
+    check_eval(ctx, "(-1 >>> 0) + ':' + (1 << 31) + ':' + (-9 >> 1)",
+               "4294967295:-2147483648:-5");
+    check_eval(ctx, "'a' + 1 + 2 + ':' + (1 + 2 + 'a')", "a12:3a");
+    check_eval(ctx, "'3' * '4' - '0x10' + true", "-3");
+    check_eval(ctx, "var x = 5; x++ + ++x + x-- + --x", "24");
+    check_eval(ctx, "'10' < '9' && 10 > 9 && !(0 / 0 <= 0 / 0)", "true");
+    check_eval(ctx, "null == undefined && 1 == '1' && null !== undefined", "true");
+    check_eval(ctx, "typeof 1 + typeof 'a' + typeof null + typeof undefined + "
+               "typeof function() {}", "numberstringobjectundefinedfunction");
+    check_eval(ctx, "var o = { valueOf: function() { return 42; } }; o + 1", "43");
+    check_eval(ctx, "'x' in { x: 1 } && !('y' in { x: 1 })", "true");
+}
+
+/* the superinstructions keep the semantics of the fused opcodes */
+static void test_superinstructions(JSContext *ctx)
+{
+    check_eval(ctx, "function add1(x) { return x + 1; }\n"
+               "add1(1) + ':' + add1(2147483647) + ':' + add1(1.5) + ':' + add1('5') + ':' + add1(null)",
+               "2:2147483648:2.5:51:1");
+    check_eval(ctx, "function lt(a, b) { if (a < b) return 1; return 0; }\n"
+               "'' + lt(1, 2) + lt(2, 1) + lt(0 / 0, 1) + lt('10', '9') + lt(1.5, 2)",
+               "10011");
+    check_eval(ctx, "function cmp(a, b) { var r = '';\n"
+               "  if (a <= b) r += 'le'; if (a > b) r += 'gt'; if (a >= b) r += 'ge';\n"
+               "  return r; }\n"
+               "cmp(1, 1) + ':' + cmp(2, 1) + ':' + cmp(0 / 0, 0 / 0) + ':' + cmp('b', 'a')",
+               "lege:gtge::gtge");
+    check_eval(ctx, "function fld(o) { var p = o; return p.x + o.x; }\n"
+               "fld({ x: 1 }) + fld({ y: 2, x: 3 }) + fld({ x: 'a' })", "8aa");
+    check_eval(ctx, "function fld2(o) { return o.x; } try { fld2(null) } catch (e) { e.name }",
+               "TypeError");
+    check_eval(ctx, "var bad = { valueOf: function() { throw 'v'; } };\n"
+               "function lt2(a) { try { if (a < 3) return 'y'; return 'n'; } catch (e) { return e; } }\n"
+               "function add2(a) { try { return a + 1; } catch (e) { return e; } }\n"
+               "lt2(bad) + add2(bad) + lt2(2)", "vvy");
+}
+
+static void test_functions(JSContext *ctx)
+{
+    JSValue global, f, args[2], ret;
+
+    check_eval(ctx, "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+               "fib(20)", "6765");
+    check_eval(ctx, "function counter() { var n = 0; return function() { return ++n; }; }\n"
+               "var c1 = counter(), c2 = counter(); c1(); c1(); c2(); c1() + c2()", "5");
+    /* a new binding per iteration */
+    check_eval(ctx, "var fs = [];\n"
+               "for (let i = 0; i < 3; i++) fs[i] = () => i;\n"
+               "'' + fs[0]() + fs[1]() + fs[2]()", "012");
+    check_eval(ctx, "function P(x) { this.x = x; }\n"
+               "var p = new P(3); p.x + (p instanceof P) + (p.constructor === P)",
+               "5");
+    check_eval(ctx, "function g(a, b) { return b; } g(1) === undefined", "true");
+    check_eval(ctx, "var a = [1, 2, 3]; a[5] = 4; a.length + ':' + a[1] + ':' + a",
+               "6:2:[object Array]");
+
+    /* call from C */
+    global = JS_GetGlobalObject(ctx);
+    f = JS_GetPropertyStr(ctx, global, "fib");
+    args[0] = JS_NewInt32(ctx, 10);
+    ret = JS_Call(ctx, f, JS_UNDEFINED, 1, args);
+    TEST_ASSERT(JS_VALUE_GET_TAG(ret) == JS_TAG_INT && JS_VALUE_GET_INT(ret) == 55);
+    JS_FreeValue(ctx, f);
+    f = JS_GetPropertyStr(ctx, global, "P");
+    args[0] = JS_NewString(ctx, "s");
+    args[1] = JS_NULL;
+    ret = JS_CallConstructor(ctx, f, 2, args);
+    TEST_ASSERT(JS_IsObject(ret));
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeValue(ctx, ret);
+    JS_FreeValue(ctx, f);
+    JS_FreeValue(ctx, global);
+}
+
+static void test_exceptions(JSContext *ctx)
+{
+    check_eval(ctx, "var r = '';\n"
+               "function f() {\n"
+               "  try { r += 'a'; throw 1; }\n"
+               "  catch (e) { r += e; return r; }\n"
+               "  finally { r += 'f'; }\n"
+               "}\n"
+               "f() + r", "a1a1f");
+    check_eval(ctx, "function h() {\n  return undefined_var;\n}\nh()",
+               "ReferenceError: 'undefined_var' is not defined");
+    check_eval(ctx, "function h() {\n  null();\n}\n"
+               "try { h(); } catch (e) { e.lineNumber + e.fileName }", "2test.js");
+    check_eval(ctx, "let z = z + 1", "ReferenceError: 'z' is not initialized");
+    check_eval(ctx, "'use strict'; const k = 1; k = 2",
+               "TypeError: 'k' is read-only");
+    check_eval(ctx, "new 1", "TypeError: not a constructor");
+}
+
+/* the accesses run several times so that they use the inline caches
+   after a change of the objects */
+static void test_inline_caches(JSContext *ctx)
+{
+    JSValue global, o;
+
+    check_eval(ctx, "function getx(o) { return o.x; }\n"
+               "var o = { x: 1, y: 2 }, r = '';\n"
+               "for (var i = 0; i < 3; i++) r += getx(o);\n"
+               "delete o.x; r += getx(o);\n"
+               "o.x = 3; r += getx(o); r", "111undefined3");
+    /* polymorphic accesses, more shapes than cache entries */
+    check_eval(ctx, "var objs = [{ x: 1 }, { a: 0, x: 2 }, { b: 0, x: 3 },\n"
+               "            { c: 0, x: 4 }, { d: 0, x: 5 }, { e: 0, x: 6 }];\n"
+               "var s = 0;\n"
+               "for (var i = 0; i < 60; i++) s += getx(objs[i % 6]); s", "210");
+    /* properties of the prototype */
+    check_eval(ctx, "function P() {}\n"
+               "P.prototype.m = function() { return 'p'; };\n"
+               "var p = new P(), r = '';\n"
+               "for (var i = 0; i < 3; i++) r += p.m();\n"
+               "P.prototype.m = function() { return 'q'; }; r += p.m();\n"
+               "p.m = function() { return 'o'; }; r += p.m();\n"
+               "delete p.m; delete P.prototype.m; r += typeof p.m; r",
+               "pppqoundefined");
+    /* a new property of the prototype hides nothing before */
+    check_eval(ctx, "function Q() {}\n"
+               "var q = new Q(), r = '';\n"
+               "for (var i = 0; i < 3; i++) r += q.z;\n"
+               "Q.prototype.z = 1; r += q.z; r",
+               "undefinedundefinedundefined1");
+    /* the stores do not bypass the read-only properties */
+    check_eval(ctx, "function setx(o, v) { o.x = v; }\n"
+               "var o = { x: 1 };\n"
+               "for (var i = 0; i < 3; i++) setx(o, i); o.x", "2");
+    global = JS_GetGlobalObject(ctx);
+    o = JS_GetPropertyStr(ctx, global, "o");
+    TEST_ASSERT(JS_DefinePropertyValueStr(ctx, o, "x", JS_NewInt32(ctx, 5),
+                                          JS_PROP_ENUMERABLE) >= 0);
+    JS_FreeValue(ctx, o);
+    JS_FreeValue(ctx, global);
+    check_eval(ctx, "setx(o, 10); o.x", "5");
+    check_eval(ctx, "function setu(v) { undefined = v; }\n"
+               "for (var i = 0; i < 3; i++) setu(i); typeof undefined",
+               "undefined");
+    /* global variables */
+    check_eval(ctx, "function getg() { return typeof gv; }\n"
+               "var r = getg() + getg();\n"
+               "gv = 1; r += getg(); delete gv; r += getg(); r",
+               "undefinedundefinednumberundefined");
+    check_eval(ctx, "'use strict'; function setg(v) { gw = v; }\n"
+               "try { setg(1); } catch (e) { e.name }", "ReferenceError");
+}
+
+/* the fast arrays and the transitions of their element kind */
+static void test_arrays(JSContext *ctx)
+{
+    check_eval(ctx, "var a = [1, 2, 3]; a[3] = 4; a[1] = 2.5;\n"
+               "var r = a.length + ':' + (a[0] + a[1]) + ':';\n"
+               "a[2] = 'x'; r += a[2] + a[3] + ':'; a.length = 2;\n"
+               "r + a.length + a[2] + a[1]", "4:3.5:x4:2undefined2.5");
+    /* the 'length' stores are not cached */
+    check_eval(ctx, "function trunc(a) { var n = a.length; a.length = n - 1; }\n"
+               "var b = [0, 1, 2, 3, 4]; for (var i = 0; i < 3; i++) trunc(b);\n"
+               "b.length + ':' + b[1] + ':' + b[2]", "2:1:undefined");
+    check_eval(ctx, "var c = []; for (var i = 0; i < 100; i++) c[i] = i * 0.5;\n"
+               "var s = 0; for (var i = 0; i < c.length; i++) s += c[i]; s",
+               "2475");
+    check_eval(ctx, "var d = [-0, 1]; (1 / d[0]) + ':' + d.hasOwnProperty(1) + ':' +\n"
+               "d.hasOwnProperty(2) + ':' + (1 in d)", "-Infinity:true:false:true");
+    /* holes, other flags or big lengths: generic arrays */
+    check_eval(ctx, "var e = [1, 2, 3, 4]; delete e[1];\n"
+               "e[1] + ':' + e.length + ':' + e[2] + ':' + (1 in e)",
+               "undefined:4:3:false");
+    check_eval(ctx, "var f = [1]; f[3] = 4; f.length + ':' + f[2] + ':' + f[3]",
+               "4:undefined:4");
+    check_eval(ctx, "var g = [1, 2]; g.length = 5; g[4] = 5; g.length + ':' + g[1]",
+               "5:2");
+    /* the length is an uint32, a smaller one deletes the elements */
+    check_eval(ctx, "var a = [1, 2, 3]; a.length = -1", "RangeError: invalid array length");
+    check_eval(ctx, "var a = [1, 2, 3]; a.length = 1.5", "RangeError: invalid array length");
+    check_eval(ctx, "var a = [1, 2, 3]; a.length = 4294967296", "RangeError: invalid array length");
+    check_eval(ctx, "var c = [1, 2, 3]; c.length = '1'; c.length + ':' + c[2] + ':' + c[0]",
+               "1:undefined:1");
+    check_eval(ctx, "var a = [1, 2, 3]; a[10] = 1; a.length = 2;\n"
+               "a.length + ':' + a[10] + ':' + a[2] + ':' + a[1] + ':' + (10 in a)",
+               "2:undefined:undefined:2:false");
+    check_eval(ctx, "var f = []; for (var i = 0; i < 40; i++) f[i * 2] = i;\n"
+               "f.length = 3; f.length + ':' + f[2] + ':' + f[4] + ':' + f[78]",
+               "3:1:undefined:undefined");
+    /* the indexes above JS_ATOM_MAX_INT are string atoms */
+    check_eval(ctx, "var c = []; c[2147483648] = 1; c.length + ':' + c[2147483648]",
+               "2147483649:1");
+    check_eval(ctx, "var b = [1]; b[4294967294] = 1; b[4294967295] = 2;\n"
+               "b.length + ':' + b[4294967295]", "4294967295:2");
+    /* cycles through the elements are collected */
+    check_eval(ctx, "var h = [1, 2]; h[1] = h; h[0] = [h]; h = null; 0", "0");
+}
+
+/* the inner functions compiled on their first call */
+static void test_lazy_functions(JSContext *ctx)
+{
+    /* closure variables of the parent and of the enclosing functions */
+    check_eval(ctx, "function outer(a) {\n"
+               "  var b = a * 2;\n"
+               "  function mid(c) {\n"
+               "    return function inner(d) { b++; return a + b + c + d; };\n"
+               "  }\n"
+               "  return mid;\n"
+               "}\n"
+               "var m = outer(1), i1 = m(10), i2 = m(20);\n"
+               "i1(100) + ':' + i2(200) + ':' + i1(0)", "114:225:16");
+    /* closures created before and after the compilation share it */
+    check_eval(ctx, "function mk() { var n = 0; return [function() { return ++n; },\n"
+               "  function() { return n * 10; }]; }\n"
+               "var p = mk(), q = mk(); p[0](); p[0](); q[0]();\n"
+               "p[1]() + ':' + q[1]() + ':' + mk()[1]()", "20:10:0");
+    /* 'this' of the arrows, named function expressions, default values */
+    check_eval(ctx, "function T() { this.v = 5; var g = () => () => this.v; return g; }\n"
+               "var h = new T()(); var fact = function f(n) { return n ? n * f(n - 1) : 1; };\n"
+               "function dflt(a, b = a + 1, c) { return a + b; }\n"
+               "h() + ':' + fact(5) + ':' + dflt(1) + ':' + dflt.length + ':' + fact.name",
+               "5:120:3:1:f");
+    /* the strict mode of the parent and of the function */
+    check_eval(ctx, "function s1() { 'use strict'; undeclared1 = 1; }\n"
+               "try { s1(); 'no error' } catch (e) { e.name }", "ReferenceError");
+    check_eval(ctx, "'use strict'; var s2 = x => { undeclared2 = x; };\n"
+               "try { s2(1); 'no error' } catch (e) { e.name }", "ReferenceError");
+    check_eval(ctx, "function s3(a, a) { return a; } s3(1, 2)", "2");
+    /* the errors of the inner functions are found by the first parse */
+    check_eval(ctx, "var ok = 1; function bad() { return 1 +; }",
+               "SyntaxError: unexpected token: ';'");
+    check_eval(ctx, "typeof ok", "undefined");
+    /* the line numbers of the lazy functions */
+    check_eval(ctx, "function l1() {\n"
+               "  return function() {\n"
+               "\n"
+               "    throw new Error('x');\n"
+               "  };\n"
+               "}\n"
+               "try { l1()(); } catch (e) { e.lineNumber }", "4");
+}
+
+/* the captured variables which are not modified after the creation
+   of the closures are copied in them */
+static void test_copied_closure_vars(JSContext *ctx)
+{
+    /* assigned after the capture, by the closure or by the parent */
+    check_eval(ctx, "function cv1() { var x = 1; var f = () => x; x = 2; return f(); }\n"
+               "function cv2(a) { function g() { return a; } a = 5; return g(); }\n"
+               "function cv3() { var n = 0; var inc = () => ++n; inc(); return inc() + n; }\n"
+               "'' + cv1() + cv2(1) + cv3()", "254");
+    /* a 'var' assigned again by the next iteration, a new 'let' per
+       iteration */
+    check_eval(ctx, "function cv4() { var fs = [];\n"
+               "  for (var i = 0; i < 3; i++) { var y = i; fs[i] = () => y; }\n"
+               "  return '' + fs[0]() + fs[1]() + fs[2](); }\n"
+               "function cv5() { var fs = [];\n"
+               "  for (var i = 0; i < 3; i++) { let y = i * 2; fs[i] = () => y; }\n"
+               "  return '' + fs[0]() + fs[1]() + fs[2](); }\n"
+               "cv4() + ':' + cv5()", "222:024");
+    /* captured before the initialization */
+    check_eval(ctx, "function cv6() { var g = () => k; let k = 7; return g(); }\n"
+               "function cv7(c) { switch (c) { case 0: let k = 1; case 1: return () => k; } }\n"
+               "cv6() + ':' + (function() { try { cv7(1)(); } catch (e) { return e.name; } })() +\n"
+               "':' + cv7(0)()", "7:ReferenceError:1");
+    /* the inner functions of the closures, 'this' of the arrows */
+    check_eval(ctx, "function cv8(a) { var b = a + 1;\n"
+               "  return function(c) { return function() { return a + b + c; }; }; }\n"
+               "function C9() { this.v = 3; var f = () => () => this.v; this.f = f(); }\n"
+               "var o9 = new C9(); o9.v = 4; cv8(1)(10)() + ':' + o9.f()", "13:4");
+    /* assigned by an inner function of the closure */
+    check_eval(ctx, "function cv10() { var x = 1;\n"
+               "  var f = function() { return function() { x = 9; }; };\n"
+               "  var g = () => x; f()(); return g() + x; }\n"
+               "cv10()", "18");
+    /* a loop going back before the assignment through a finally block */
+    check_eval(ctx, "function cv11() { var fs = [], i = 0;\n"
+               "  while (i < 2) { try { var z = i; fs[i] = () => z; } finally { i++; } }\n"
+               "  return '' + fs[0]() + fs[1](); }\n"
+               "cv11()", "11");
+    /* the copies are freed with the closures, cycles included */
+    check_eval(ctx, "function cv12() { var o = {}; o.f = () => o; return o.f() === o; }\n"
+               "var r12 = true; for (var i = 0; i < 100; i++) r12 = r12 && cv12(); r12", "true");
+}
+
+/* the generators run in heap frames, taken from the runtime pools */
+static void test_generators(JSContext *ctx)
+{
+    static const char gen_src[] =
+        "var gens = []; for (var i = 0; i < 8; i++) {\n"
+        "  gens[i] = pool(i); gens[i].next(); } 0";
+    static const char done_src[] =
+        "for (var i = 0; i < 8; i++) gens[i].next(); gens = null; 0";
+    JSRuntime *rt;
+    JSMemoryUsage s0, s1, s2;
+    int64_t n1;
+
+    /* the received values, the arguments evaluated by the call */
+    check_eval(ctx, "function* g1(a, b = a + 1) {\n"
+               "  var x = yield a; var y = 10 + (yield b + x); return x + y; }\n"
+               "var it = g1(1), r = it.next('lost'), s = r.value + ':' + r.done;\n"
+               "r = it.next(5); s += ' ' + r.value + ':' + r.done;\n"
+               "r = it.next(7); s += ' ' + r.value + ':' + r.done;\n"
+               "r = it.next(); s + ' ' + r.value + ':' + r.done",
+               "1:false 7:false 22:true undefined:true");
+    /* return() in the middle of an expression runs the finally blocks,
+       which can yield again */
+    check_eval(ctx, "var l = '';\n"
+               "function* g2() { try { try { l += 'a'; 1 + (yield 1); }\n"
+               "  finally { l += 'i'; 3 * (yield 2); } } finally { l += 'o'; } }\n"
+               "var it = g2(); it.next(); var r = it.return(5);\n"
+               "var s = r.value + ':' + r.done; r = it.return(6);\n"
+               "s + ' ' + r.value + ':' + r.done + ' ' + l + it.next().done",
+               "2:false 6:true aiotrue");
+    check_eval(ctx, "function* g3() { try { yield 1; } catch (e) { yield 'c' + e; } }\n"
+               "function* g4() { yield 1; throw new RangeError('x'); }\n"
+               "var it = g3(); it.next(); var s = it.throw('E').value;\n"
+               "it = g4(); it.next(); try { it.next(); } catch (e) { s += e.name; }\n"
+               "s + it.next().done + ':' + g4().return(3).value", "cERangeErrortrue:3");
+    /* the closures keep the variables of the completed generators */
+    check_eval(ctx, "var it = function* () { var k = 0;\n"
+               "  for (;;) { let j = k; yield () => j + k; k++; } }();\n"
+               "var a = it.next().value, b = it.next().value; it.return();\n"
+               "'' + a() + b()", "12");
+    /* cycles through the suspended frames are collected */
+    check_eval(ctx, "function* g10() { var me = it10; yield me; }\n"
+               "for (var i = 0; i < 100; i++) { var it10 = g10(); it10.next(); } 0", "0");
+    check_eval(ctx, "function* g5() { it.next(); yield 1; } var it = g5();\n"
+               "try { it.next(); } catch (e) { e.message }",
+               "cannot invoke a running generator");
+    check_eval(ctx, "function* g6() { yield 1; }\n"
+               "try { new g6(); } catch (e) { e.name + typeof g6.prototype }",
+               "TypeErrorundefined");
+    check_eval(ctx, "'use strict'; function g7() { yield 1; }",
+               "SyntaxError: 'yield' is only valid in generators");
+    check_eval(ctx, "function* g8(a = yield) {}",
+               "SyntaxError: yield is not allowed in the parameters");
+    check_eval(ctx, "function* g9(a) { yield* a; }", "SyntaxError: yield* is not supported");
+
+    /* the frames of the completed generators are used again. The
+       first call compiles 'pool' and leaves one frame in the pool of
+       the new runtime. */
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    check_eval(ctx, "var gens, i;\n"
+               "function* pool(n) { var a = n, b = a + 1; yield a + b; return b; }\n"
+               "pool(0) && 0", "0");
+    JS_ComputeMemoryUsage(rt, &s0);
+    check_eval(ctx, gen_src, "0");
+    JS_ComputeMemoryUsage(rt, &s1);
+    n1 = s1.malloc_count - s0.malloc_count;
+    check_eval(ctx, done_src, "0");
+    JS_ComputeMemoryUsage(rt, &s2);
+    /* the 7 new frames stay in the pool for the next calls */
+    TEST_ASSERT(s2.malloc_count - s0.malloc_count == 7);
+    JS_ComputeMemoryUsage(rt, &s0);
+    check_eval(ctx, gen_src, "0");
+    JS_ComputeMemoryUsage(rt, &s1);
+    TEST_ASSERT(s1.malloc_count - s0.malloc_count == n1 - 7);
+    check_eval(ctx, done_src, "0");
+    JS_ComputeMemoryUsage(rt, &s2);
+    TEST_ASSERT(s2.malloc_count == s0.malloc_count);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
+static int interrupt_handler(JSRuntime *rt, void *opaque)
+{
+    return 1;
+}
+
+static void test_limits(JSRuntime *rt, JSContext *ctx)
+{
+    check_eval(ctx, "function deep() { return deep() + 1; } deep()",
+               "InternalError: stack overflow");
+    /* the stack overflow can be caught */
+    check_eval(ctx, "try { deep(); } catch (e) { 'caught' }", "caught");
+
+    /* the interrupts cannot be caught */
+    JS_SetInterruptHandler(rt, interrupt_handler, NULL);
+    check_eval(ctx, "for (;;) { try { for (;;); } catch (e) {} }",
+               "InternalError: interrupted");
+    JS_SetInterruptHandler(rt, NULL, NULL);
+    check_eval(ctx, "1 + 1", "2");
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+
+    test_values(ctx);
+    test_operators(ctx);
+    test_superinstructions(ctx);
+    test_functions(ctx);
+    test_exceptions(ctx);
+    test_inline_caches(ctx);
+    test_arrays(ctx);
+    test_lazy_functions(ctx);
+    test_copied_closure_vars(ctx);
+    test_generators(ctx);
+    test_limits(rt, ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "context.h"
+#include "test-common.h"
+
+static int64_t call_count;
+static int handler_calls;
+
+static JSValue js_nop(JSContext *ctx, JSValueConst this_val,
+                      int argc, JSValueConst *argv)
+{
+    call_count++;
+    return JS_UNDEFINED;
+}
+
+/* a runaway script: calls argv[0] until an exception */
+static JSValue js_spin(JSContext *ctx, JSValueConst this_val,
+                       int argc, JSValueConst *argv)
+{
+    JSValue ret;
+
+    for(;;) {
+        ret = JS_Call(ctx, argv[0], JS_UNDEFINED, 0, NULL);
+        if (JS_IsException(ret))
+            return ret;
+    }
+}
+
+static void check_interrupted(JSContext *ctx, JSValue ret)
+{
+    JSValue val;
+    const char *str;
+
+    TEST_ASSERT(JS_IsException(ret));
+    val = JS_GetException(ctx);
+    TEST_ASSERT(JS_IsUncatchableError(ctx, val));
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT_STR("InternalError: interrupted", str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+}
+
+static int interrupt_handler(JSRuntime *rt, void *opaque)
+{
+    return ++handler_calls == *(int *)opaque;
+}
+
+static void *watchdog(void *opaque)
+{
+    usleep(20000);
+    JS_RequestInterrupt(opaque);
+    return NULL;
+}
+
+static int64_t cpu_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSValue nop, spin;
+    pthread_t thread;
+    int64_t t0;
+    int stop_at;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    nop = JS_NewCFunction(ctx, js_nop, "nop", 0);
+    spin = JS_NewCFunction(ctx, js_spin, "spin", 1);
+
+    /* no interrupt source: the calls are only counted */
+    TEST_ASSERT(JS_IsUndefined(JS_Call(ctx, nop, JS_UNDEFINED, 0, NULL)));
+
+    /* the handler is called once per JS_INTERRUPT_COUNTER_INIT polls */
+    stop_at = 3;
+    JS_SetInterruptHandler(rt, interrupt_handler, &stop_at);
+    check_interrupted(ctx, JS_Call(ctx, spin, JS_UNDEFINED, 1, &nop));
+    TEST_ASSERT(handler_calls == 3);
+    TEST_ASSERT(call_count > 2 * JS_INTERRUPT_COUNTER_INIT &&
+                call_count <= 3 * JS_INTERRUPT_COUNTER_INIT);
+    JS_SetInterruptHandler(rt, NULL, NULL);
+
+    /* interrupt requested by another thread */
+    TEST_ASSERT(pthread_create(&thread, NULL, watchdog, rt) == 0);
+    check_interrupted(ctx, JS_Call(ctx, spin, JS_UNDEFINED, 1, &nop));
+    pthread_join(thread, NULL);
+    /* the request is consumed */
+    TEST_ASSERT(JS_IsUndefined(JS_Call(ctx, nop, JS_UNDEFINED, 0, NULL)));
+
+    /* CPU time budget */
+    t0 = cpu_time_ms();
+    JS_SetCPUTimeLimit(rt, 30000);
+    check_interrupted(ctx, JS_Call(ctx, spin, JS_UNDEFINED, 1, &nop));
+    TEST_ASSERT(cpu_time_ms() - t0 >= 30);
+    /* the budget stays exhausted until a new one is set */
+    rt->interrupt_counter = 1;
+    check_interrupted(ctx, JS_Call(ctx, nop, JS_UNDEFINED, 0, NULL));
+    JS_SetCPUTimeLimit(rt, 0);
+    rt->interrupt_counter = 1;
+    TEST_ASSERT(JS_IsUndefined(JS_Call(ctx, nop, JS_UNDEFINED, 0, NULL)));
+
+    /* a new budget drops a stale request */
+    JS_RequestInterrupt(rt);
+    JS_SetCPUTimeLimit(rt, 1000000);
+    rt->interrupt_counter = 1;
+    TEST_ASSERT(JS_IsUndefined(JS_Call(ctx, nop, JS_UNDEFINED, 0, NULL)));
+
+    JS_FreeValue(ctx, spin);
+    JS_FreeValue(ctx, nop);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include "qjs.h"
+#include "jit.h"
+#include "test-common.h"
+
+/* the loops run more than JS_JIT_THRESHOLD iterations so that the
+   functions are compiled, in the middle of the loop or on a call */
+#define HOT "3000"
+
+static JSRuntime *new_runtime(int use_jit, JSContext **pctx)
+{
+    JSRuntime *rt;
+
+    rt = JS_NewRuntime();
+    TEST_ASSERT(rt != NULL);
+    JS_SetJITEnabled(rt, use_jit);
+    *pctx = JS_NewContext(rt);
+    TEST_ASSERT(*pctx != NULL);
+    return rt;
+}
+
+static void check_eval1(JSContext *ctx, const char *source,
+                        const char *expected)
+{
+    JSValue val;
+    const char *str;
+
+    val = JS_Eval(ctx, source, strlen(source), "test.js", 0);
+    if (JS_IsException(val))
+        val = JS_GetException(ctx);
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT(str != NULL);
+    if (strcmp(str, expected) != 0)
+        printf("%s\n-> %s\n", source, str);
+    TEST_ASSERT_STR(expected, str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+}
+
+/* the interpreter and the machine code give the same result */
+static void check_eval(const char *source, const char *expected)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    int use_jit;
+
+    for(use_jit = 0; use_jit < 2; use_jit++) {
+        rt = new_runtime(use_jit, &ctx);
+        check_eval1(ctx, source, expected);
+        JS_FreeContext(ctx);
+        JS_FreeRuntime(rt);
+    }
+}
+
+static void test_arithmetic(void)
+{
+    check_eval("var s = 0; for (var i = 0; i < " HOT "; i++) s = (s + i * 3) & 0xffff; s",
+               "60620");
+    /* overflow of the int32 operations */
+    check_eval("var s = 0, m = 1; for (var i = 0; i < " HOT "; i++) {\n"
+               "  s = s + 2147483647; m = (m * 65537) | 0; }\n"
+               "s + ':' + m", "6442450941000:196608001");
+    check_eval("var s = 0; for (var i = 0; i < " HOT "; i++) s -= 1 << 30; s",
+               "-3221225472000");
+    /* -0, NaN and the float results of the int operations */
+    check_eval("var r = ''; for (var i = 0; i < " HOT "; i++) {\n"
+               "  var z = (i - i) * -1, q = -(i - i), n = (i % 2) * (0 / 0);\n"
+               "  if (i == 2999) r = (1 / z) + ':' + (1 / q) + ':' + n + ':' +\n"
+               "    (1 / (-i % i)) + ':' + (i / 2) + ':' + (7 % -0); }\n"
+               "r", "-Infinity:-Infinity:NaN:-Infinity:1499.5:NaN");
+    check_eval("var x = 0.5; for (var i = 0; i < " HOT "; i++) x = x * 1.0001 - 0.25 + i;\n"
+               "x", "4982982.198064746");
+    check_eval("var r = 0; for (var i = -1500; i < 1500; i++)\n"
+               "  r = (r + (i >> 3) + (i << 29) + (i >>> 28) + (i ^ 0x55) + (~i) + (-i)) | 0;\n"
+               "r", "-2147464148");
+    check_eval("var c = 0; for (var i = 0; i < " HOT "; i++) {\n"
+               "  if (i < 100) c++; if (i <= 100) c++; if (i > 2900) c++;\n"
+               "  if (i >= 2900) c++; if (i == 5) c++; if (i != 5) c++;\n"
+               "  if (!(i & 1)) c++; if (i === 7.5) c = 0; }\n"
+               "c", "4900");
+    /* operands which are not numbers */
+    check_eval("var r = 0, v = [1, 2.5, '3', true, null, undefined, {}];\n"
+               "for (var i = 0; i < " HOT "; i++) r += +v[i % 7] + (v[i % 7] == null) | 0;\n"
+               "r", "3431");
+}
+
+static void test_functions(void)
+{
+    check_eval("function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+               "fib(20)", "6765");
+    check_eval("function f(n) { var t = 0; for (let i = 0; i < n; i++) t += i; return t; }\n"
+               "f(100000)", "4999950000");
+    /* closure variables and a new binding per iteration */
+    check_eval("var fs = []; for (let i = 0; i < " HOT "; i++) fs[i] = () => i;\n"
+               "fs[5]() + ':' + fs[2999]()", "5:2999");
+    check_eval("var inc = (function() { var c = 0; return function() { return ++c; }; })();\n"
+               "for (var i = 0; i < " HOT "; i++) inc(); inc()", "3001");
+    check_eval("function g(a, b) { a += b; return (b === undefined) + a; }\n"
+               "var s = 0; for (var i = 0; i < " HOT "; i++) s += g(i, 1); s",
+               "4501500");
+    check_eval("var o = { x: 1, y: 2 }; for (var i = 0; i < " HOT "; i++) o.x = o.x + o.y;\n"
+               "o.x", "6001");
+    /* the elements of the typed arrays are read and written in place */
+    check_eval("var u = new Uint8Array(16), f = new Float32Array(4);\n"
+               "for (var i = 0; i < " HOT "; i++) { u[i & 15] = u[(i + 1) & 15] + i; f[i & 3] = u[i & 15] / 2; }\n"
+               "u[15] + ':' + f[3] + ':' + u.indexOf(u[3])", "180:122:3");
+    /* the superinstructions on the locals and the arguments */
+    check_eval("function sup(n, o) { var p = o, s = 0, c = 0, v = [1, 0 / 0, 'b', 2.5];\n"
+               "  for (var i = 0; i < n; i++) {\n"
+               "    s = s + p.x + o.y; c = c + 1; if (v[i % 4] < 2) c = c + 3;\n"
+               "    if (v[i % 4] >= 'a') s = s + 7; if (i > n - 10) c = c + 2147483647; }\n"
+               "  return s + ':' + c; }\n"
+               "sup(" HOT ", { x: 1, y: 0.5 })", "9750:19327358073");
+    /* the machine code of a generator runs in its heap frame */
+    check_eval("function* gen(n) { for (var i = 0; i < n; i++) {\n"
+               "  var t = 0; for (var j = 0; j < " HOT "; j++) t += j; yield t + i; } }\n"
+               "var s = 0, it = gen(3), r; while (!(r = it.next()).done) s += r.value; s",
+               "13495503");
+}
+
+static void test_exceptions(void)
+{
+    check_eval("var c = 0; for (var i = 0; i < " HOT "; i++) {\n"
+               "  try { if (i % 100 == 0) throw i; c++; } catch (e) { c += 1000; } }\n"
+               "c", "32970");
+    check_eval("var c = 0; for (var i = 0; i < " HOT "; i++) {\n"
+               "  try { c++; } finally { c += 2; } }\n"
+               "c", "9000");
+    /* exceptions of the compiled code and their line numbers */
+    check_eval("function h(n) {\n"
+               "  for (var i = 0; i < n; i++);\n"
+               "  return null.x;\n"
+               "}\n"
+               "try { h(" HOT "); } catch (e) { e.lineNumber + e.name }", "3TypeError");
+    check_eval("function tdz() { for (var i = 0; i < " HOT "; i++); return k; let k; }\n"
+               "tdz()", "ReferenceError: 'k' is not initialized");
+}
+
+static int interrupt_handler(JSRuntime *rt, void *opaque)
+{
+    return 1;
+}
+
+static void test_runtime(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSMemoryUsage stats;
+    int use_jit;
+
+    for(use_jit = 0; use_jit < 2; use_jit++) {
+        rt = new_runtime(use_jit, &ctx);
+        check_eval1(ctx, "function sum(n) { var s = 0; for (var i = 0; i < n; i++) s += i;\n"
+                    "  return s; }\n"
+                    "sum(" HOT ")", "4498500");
+        JS_ComputeMemoryUsage(rt, &stats);
+#ifdef CONFIG_JIT
+        TEST_ASSERT(use_jit ? stats.jit_func_count == 1 && stats.jit_code_size > 0 :
+                    stats.jit_func_count == 0);
+#else
+        TEST_ASSERT(stats.jit_func_count == 0);
+#endif
+        /* the hot loops are interrupted */
+        JS_SetInterruptHandler(rt, interrupt_handler, NULL);
+        check_eval1(ctx, "for (;;) { try { for (;;); } catch (e) {} }",
+                    "InternalError: interrupted");
+        JS_SetInterruptHandler(rt, NULL, NULL);
+        JS_FreeContext(ctx);
+        JS_FreeRuntime(rt);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    test_arithmetic();
+    test_functions();
+    test_exceptions();
+    test_runtime();
+    return 0;
+}
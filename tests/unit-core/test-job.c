@@ -0,0 +1,100 @@
+#include "context.h"
+#include "test-common.h"
+
+static int run_count;
+static int last_value;
+static int requeue_stop;
+
+static JSValue job_check_order(JSContext *ctx, int argc, JSValueConst *argv)
+{
+    /* FIFO order */
+    TEST_ASSERT(JS_VALUE_GET_INT(argv[0]) == last_value + 1);
+    last_value = JS_VALUE_GET_INT(argv[0]);
+    run_count++;
+    return JS_UNDEFINED;
+}
+
+static JSValue job_requeue(JSContext *ctx, int argc, JSValueConst *argv)
+{
+    int n = JS_VALUE_GET_INT(argv[0]);
+    JSValue val;
+
+    run_count++;
+    if (n > 0 && !requeue_stop) {
+        val = JS_NewInt32(ctx, n - 1);
+        if (JS_EnqueueJob(ctx, job_requeue, 1, &val))
+            return JS_EXCEPTION;
+    }
+    return JS_UNDEFINED;
+}
+
+static JSValue job_throw(JSContext *ctx, int argc, JSValueConst *argv)
+{
+    run_count++;
+    return JS_ThrowTypeError(ctx, "job failed");
+}
+
+int main(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx, *ctx1;
+    JSValue args[2], obj;
+    int i, ret;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    TEST_ASSERT(!JS_IsJobPending(rt));
+    TEST_ASSERT(JS_ExecutePendingJob(rt, &ctx1) == 0 && ctx1 == NULL);
+
+    /* the ring grows past its initial size, keeping the order */
+    for (i = 1; i <= 1000; i++) {
+        args[0] = JS_NewInt32(ctx, i);
+        TEST_ASSERT(JS_EnqueueJob(ctx, job_check_order, 1, args) == 0);
+    }
+    TEST_ASSERT(JS_ExecutePendingJob(rt, &ctx1) == 1 && ctx1 == NULL);
+    TEST_ASSERT(JS_ExecutePendingJobs(rt, 99, 0, &ctx1) == 99);
+    TEST_ASSERT(run_count == 100);
+    TEST_ASSERT(JS_ExecutePendingJobs(rt, 0, 0, &ctx1) == 900);
+    TEST_ASSERT(!JS_IsJobPending(rt) && last_value == 1000);
+
+    /* wrap around while jobs are queued during the drain */
+    run_count = 0;
+    for (i = 0; i < 50; i++) {
+        args[0] = JS_NewInt32(ctx, 20);
+        JS_EnqueueJob(ctx, job_requeue, 1, args);
+    }
+    TEST_ASSERT(JS_ExecutePendingJobs(rt, 0, 0, &ctx1) == 50 * 21);
+    TEST_ASSERT(run_count == 50 * 21);
+
+    /* the time budget stops an endless chain of jobs */
+    args[0] = JS_NewInt32(ctx, INT32_MAX);
+    JS_EnqueueJob(ctx, job_requeue, 1, args);
+    ret = JS_ExecutePendingJobs(rt, 0, 1000, &ctx1);
+    TEST_ASSERT(ret > 0 && JS_IsJobPending(rt));
+    requeue_stop = 1;
+    TEST_ASSERT(JS_ExecutePendingJobs(rt, 0, 0, &ctx1) == 1);
+
+    /* an exception stops the drain */
+    run_count = 0;
+    JS_EnqueueJob(ctx, job_throw, 0, NULL);
+    args[0] = JS_NewInt32(ctx, 0);
+    JS_EnqueueJob(ctx, job_requeue, 1, args);
+    ret = JS_ExecutePendingJobs(rt, 0, 0, &ctx1);
+    TEST_ASSERT(ret < 0 && ctx1 == ctx && run_count == 1);
+    obj = JS_GetException(ctx);
+    TEST_ASSERT(JS_IsError(ctx, obj));
+    JS_FreeValue(ctx, obj);
+    JS_FreeContext(ctx1);
+    TEST_ASSERT(JS_IsJobPending(rt));
+
+    /* the pending jobs and their arguments are freed with the runtime */
+    args[0] = JS_NewObject(ctx);
+    args[1] = JS_NewString(ctx, "pending");
+    JS_EnqueueJob(ctx, job_check_order, 2, args);
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeValue(ctx, args[1]);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,366 @@
+#include "qjs.h"
+#include "test-common.h"
+#include "lexer.h"
+
+#define MAX_TOKENS 64
+
+typedef struct {
+    int val[MAX_TOKENS];
+    int line[MAX_TOKENS];
+    int count;
+} TokenList;
+
+/* lex 'src' to the end, return -1 at the first error */
+static int lex(JSContext *ctx, const char *src, BOOL is_strict, TokenList *l)
+{
+    JSParseState s;
+
+    js_parse_init(ctx, &s, src, strlen(src), "test.js");
+    s.is_strict = is_strict;
+    l->count = 0;
+    for(;;) {
+        if (next_token(&s)) {
+            js_parse_free(&s);
+            return -1;
+        }
+        if (s.token.val == TOK_EOF)
+            break;
+        TEST_ASSERT(l->count < MAX_TOKENS);
+        l->val[l->count] = s.token.val;
+        l->line[l->count] = s.token.line_num;
+        l->count++;
+    }
+    js_parse_free(&s);
+    return 0;
+}
+
+static void check_tokens(JSContext *ctx, const char *src, const int *expected,
+                         int count)
+{
+    TokenList l;
+    int i;
+
+    TEST_ASSERT(lex(ctx, src, FALSE, &l) == 0);
+    TEST_ASSERT(l.count == count);
+    for(i = 0; i < count; i++)
+        TEST_ASSERT(l.val[i] == expected[i]);
+}
+
+/* read the first token of 'src' */
+static void first_token(JSContext *ctx, JSParseState *s, const char *src,
+                        BOOL is_strict)
+{
+    js_parse_init(ctx, s, src, strlen(src), "test.js");
+    s->is_strict = is_strict;
+    TEST_ASSERT(next_token(s) == 0);
+}
+
+static double number_value(JSValueConst val)
+{
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT)
+        return JS_VALUE_GET_INT(val);
+    TEST_ASSERT(JS_VALUE_GET_NORM_TAG(val) == JS_TAG_FLOAT64);
+    return JS_VALUE_GET_FLOAT64(val);
+}
+
+static double lex_number(JSContext *ctx, const char *src)
+{
+    JSParseState s;
+    double d;
+
+    first_token(ctx, &s, src, FALSE);
+    TEST_ASSERT(s.token.val == TOK_NUMBER);
+    d = number_value(s.token.u.num.val);
+    TEST_ASSERT(next_token(&s) == 0 && s.token.val == TOK_EOF);
+    js_parse_free(&s);
+    return d;
+}
+
+static void check_string(JSContext *ctx, const char *src, const char *expected)
+{
+    JSParseState s;
+    const char *str;
+
+    first_token(ctx, &s, src, FALSE);
+    TEST_ASSERT(s.token.val == TOK_STRING || s.token.val == TOK_TEMPLATE);
+    str = JS_ToCString(ctx, s.token.u.str.str);
+    TEST_ASSERT_STR(expected, str);
+    JS_FreeCString(ctx, str);
+    js_parse_free(&s);
+}
+
+/* lexing 'src' fails with a SyntaxError at 'line_num' */
+static void check_error(JSContext *ctx, const char *src, BOOL is_strict,
+                        const char *message, int line_num)
+{
+    JSParseState s;
+    JSValue exc, val;
+    const char *str;
+
+    js_parse_init(ctx, &s, src, strlen(src), "test.js");
+    s.is_strict = is_strict;
+    while (next_token(&s) == 0)
+        TEST_ASSERT(s.token.val != TOK_EOF);
+    TEST_ASSERT(s.token.val == TOK_ERROR);
+    js_parse_free(&s);
+
+    exc = JS_GetException(ctx);
+    TEST_ASSERT(JS_IsError(ctx, exc));
+    val = JS_GetPropertyStr(ctx, exc, "message");
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT_STR(message, str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+    val = JS_GetPropertyStr(ctx, exc, "lineNumber");
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_INT);
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == line_num);
+    val = JS_GetPropertyStr(ctx, exc, "fileName");
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT_STR("test.js", str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+    JS_FreeValue(ctx, exc);
+}
+
+static void test_punctuators(JSContext *ctx)
+{
+    static const int hello[] = {
+        TOK_IDENT, '.', TOK_IDENT, '(', TOK_STRING, ')', ';',
+    };
+    static const int ops[] = {
+        TOK_SHR_ASSIGN, TOK_SHR, TOK_SAR_ASSIGN, TOK_SAR, TOK_GTE, '>',
+        TOK_STRICT_EQ, TOK_EQ, TOK_ARROW, '=', TOK_STRICT_NEQ, TOK_NEQ, '!',
+        TOK_POW_ASSIGN, TOK_POW, TOK_MUL_ASSIGN, TOK_ELLIPSIS,
+        TOK_DOUBLE_QUESTION_MARK_ASSIGN, TOK_DOUBLE_QUESTION_MARK,
+        TOK_QUESTION_MARK_DOT, '?', TOK_NUMBER, TOK_LAND_ASSIGN, TOK_LAND,
+        TOK_LOR_ASSIGN, TOK_LOR, TOK_INC, TOK_DEC, TOK_DIV_ASSIGN, '/',
+    };
+
+    check_tokens(ctx, "console.log(\"hello word!\");", hello, countof(hello));
+    check_tokens(ctx, ">>>= >>> >>= >> >= > === == => = !== != ! "
+                 "**= ** *= ... ?\?= ?? ?. ?.5 &&= && ||= || ++ -- /= /",
+                 ops, countof(ops));
+}
+
+static void test_identifiers(JSContext *ctx)
+{
+    static const char *names[] = {
+        "a", "_private", "$el", "camelCase99", "console",
+        "a_rather_long_identifier_name_crossing_sixteen_bytes",
+    };
+    static const int tokens[] = {
+        TOK_IF, TOK_ELSE, TOK_FUNCTION, TOK_RETURN, TOK_NULL, TOK_SUPER,
+        TOK_IDENT, TOK_IDENT, TOK_IDENT,
+    };
+    JSParseState s;
+    JSAtom atom;
+    int i;
+
+    /* the atoms created from the source are the usual ones */
+    for(i = 0; i < countof(names); i++) {
+        atom = JS_NewAtom(ctx, names[i]);
+        first_token(ctx, &s, names[i], FALSE);
+        TEST_ASSERT(s.token.val == TOK_IDENT);
+        TEST_ASSERT(s.token.u.ident.atom == atom);
+        TEST_ASSERT(!s.token.u.ident.has_escape);
+        js_parse_free(&s);
+        JS_FreeAtom(ctx, atom);
+    }
+
+    /* keywords, then the strict mode ones outside strict mode */
+    check_tokens(ctx, "if else function return null super let yield "
+                 "iff", tokens, countof(tokens));
+    first_token(ctx, &s, "yield", TRUE);
+    TEST_ASSERT(s.token.val == TOK_YIELD);
+    js_parse_free(&s);
+
+    /* escaped identifiers */
+    atom = JS_NewAtom(ctx, "abc");
+    first_token(ctx, &s, "\\u0061b\\u{63}", FALSE);
+    TEST_ASSERT(s.token.val == TOK_IDENT);
+    TEST_ASSERT(s.token.u.ident.atom == atom);
+    TEST_ASSERT(s.token.u.ident.has_escape);
+    js_parse_free(&s);
+    first_token(ctx, &s, "ab\\u0063", FALSE);
+    TEST_ASSERT(s.token.u.ident.atom == atom);
+    js_parse_free(&s);
+    JS_FreeAtom(ctx, atom);
+    /* an escaped keyword is a reserved identifier */
+    first_token(ctx, &s, "\\u0069f", FALSE);
+    TEST_ASSERT(s.token.val == TOK_IDENT);
+    TEST_ASSERT(s.token.u.ident.is_reserved);
+    js_parse_free(&s);
+
+    /* non ASCII identifier */
+    atom = JS_NewAtom(ctx, "caf\xc3\xa9");
+    first_token(ctx, &s, "caf\xc3\xa9 = 1", FALSE);
+    TEST_ASSERT(s.token.val == TOK_IDENT);
+    TEST_ASSERT(s.token.u.ident.atom == atom);
+    js_parse_free(&s);
+    JS_FreeAtom(ctx, atom);
+
+    first_token(ctx, &s, "#field", FALSE);
+    TEST_ASSERT(s.token.val == TOK_PRIVATE_NAME);
+    js_parse_free(&s);
+
+    check_error(ctx, "\\u0031a", FALSE, "invalid escape sequence in identifier", 1);
+    check_error(ctx, "# x", FALSE, "invalid first character of private name", 1);
+}
+
+static void test_numbers(JSContext *ctx)
+{
+    TEST_ASSERT(lex_number(ctx, "0") == 0);
+    TEST_ASSERT(lex_number(ctx, "42") == 42);
+    TEST_ASSERT(lex_number(ctx, "3.25") == 3.25);
+    TEST_ASSERT(lex_number(ctx, ".5") == 0.5);
+    TEST_ASSERT(lex_number(ctx, "5.") == 5);
+    TEST_ASSERT(lex_number(ctx, "1e3") == 1000);
+    TEST_ASSERT(lex_number(ctx, "2.5E-1") == 0.25);
+    TEST_ASSERT(lex_number(ctx, "1_000_000") == 1000000);
+    TEST_ASSERT(lex_number(ctx, "1_0.2_5e1_0") == 10.25e10);
+    TEST_ASSERT(lex_number(ctx, "0xff") == 255);
+    TEST_ASSERT(lex_number(ctx, "0Xdead_BEEF") == 0xdeadbeef);
+    TEST_ASSERT(lex_number(ctx, "0o17") == 15);
+    TEST_ASSERT(lex_number(ctx, "0b1010") == 10);
+    TEST_ASSERT(lex_number(ctx, "017") == 15);
+    TEST_ASSERT(lex_number(ctx, "019") == 19);
+    TEST_ASSERT(lex_number(ctx, "08.5") == 8.5);
+    /* correctly rounded beyond 53 bits: ties to even, then up */
+    TEST_ASSERT(lex_number(ctx, "0x20000000000001") == 9007199254740992.0);
+    TEST_ASSERT(lex_number(ctx, "0x20000000000003") == 9007199254740996.0);
+    TEST_ASSERT(lex_number(ctx, "0x200000000000010000000001") ==
+                ldexp(9007199254740994.0, 40));
+    TEST_ASSERT(lex_number(ctx, "0xffffffffffffffffffff") == 0x1p80);
+
+    check_error(ctx, "017", TRUE, "octal literals are deprecated in strict mode", 1);
+    check_error(ctx, "1__0", FALSE, "invalid number literal", 1);
+    check_error(ctx, "1_", FALSE, "invalid number literal", 1);
+    check_error(ctx, "0x", FALSE, "invalid number literal", 1);
+    check_error(ctx, "0b2", FALSE, "invalid number literal", 1);
+    check_error(ctx, "\n3in", FALSE, "invalid number literal", 2);
+    check_error(ctx, "10n", FALSE, "BigInt literals are not supported", 1);
+}
+
+static void test_strings(JSContext *ctx)
+{
+    JSParseState s;
+
+    check_string(ctx, "'single'", "single");
+    check_string(ctx, "\"\"", "");
+    check_string(ctx, "\"it's\"", "it's");
+    check_string(ctx, "'a\\tb\\n\\\\\\''", "a\tb\n\\'");
+    check_string(ctx, "'\\x41\\u0042\\u{43}\\u{1F600}'", "ABC\xf0\x9f\x98\x80");
+    check_string(ctx, "'\\101\\8\\0'", "A8");
+    check_string(ctx, "'caf\xc3\xa9 \\u00e9'", "caf\xc3\xa9 \xc3\xa9");
+    check_string(ctx, "'line\\\r\ncontinuation'", "linecontinuation");
+
+    /* the line continuations are counted */
+    js_parse_init(ctx, &s, "'a\\\nb' x", 8, "test.js");
+    TEST_ASSERT(next_token(&s) == 0 && s.token.line_num == 1);
+    TEST_ASSERT(next_token(&s) == 0 && s.token.line_num == 2);
+    js_parse_free(&s);
+
+    check_error(ctx, "x\n'abc", FALSE, "unexpected end of string", 2);
+    check_error(ctx, "'abc\ndef'", FALSE, "unexpected line terminator in string", 1);
+    check_error(ctx, "'\\101'", TRUE,
+                "octal escape sequences are not allowed in strict mode", 1);
+    check_error(ctx, "'\\xg0'", FALSE, "invalid escape sequence", 1);
+}
+
+static void test_templates_regexps(JSContext *ctx)
+{
+    JSParseState s;
+    const char *str;
+
+    check_string(ctx, "`plain\r\ntext`", "plain\ntext");
+    first_token(ctx, &s, "`a${x}b`", FALSE);
+    TEST_ASSERT(s.token.val == TOK_TEMPLATE);
+    TEST_ASSERT(s.token.u.str.sep == '$');
+    TEST_ASSERT(next_token(&s) == 0 && s.token.val == TOK_IDENT);
+    TEST_ASSERT(next_token(&s) == 0 && s.token.val == '}');
+    TEST_ASSERT(js_parse_template_part(&s, s.buf_ptr) == 0);
+    TEST_ASSERT(s.token.val == TOK_TEMPLATE);
+    TEST_ASSERT(s.token.u.str.sep == '`');
+    str = JS_ToCString(ctx, s.token.u.str.str);
+    TEST_ASSERT_STR("b", str);
+    JS_FreeCString(ctx, str);
+    js_parse_free(&s);
+    check_error(ctx, "`\\01`", FALSE,
+                "octal escape sequences are not allowed in templates", 1);
+
+    /* the parser decides when '/' starts a regexp */
+    first_token(ctx, &s, "/[/\\]]+\\//gi;", FALSE);
+    TEST_ASSERT(s.token.val == '/');
+    TEST_ASSERT(js_parse_regexp(&s) == 0);
+    TEST_ASSERT(s.token.val == TOK_REGEXP);
+    str = JS_ToCString(ctx, s.token.u.regexp.body);
+    TEST_ASSERT_STR("[/\\]]+\\/", str);
+    JS_FreeCString(ctx, str);
+    str = JS_ToCString(ctx, s.token.u.regexp.flags);
+    TEST_ASSERT_STR("gi", str);
+    JS_FreeCString(ctx, str);
+    TEST_ASSERT(next_token(&s) == 0 && s.token.val == ';');
+    js_parse_free(&s);
+
+    first_token(ctx, &s, "/abc\n/", FALSE);
+    TEST_ASSERT(js_parse_regexp(&s) == -1);
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    js_parse_free(&s);
+}
+
+/* white space and comments, at every alignment of the 16 byte scans */
+static void test_blanks(JSContext *ctx)
+{
+    static const char body[] =
+        "a /* block comment\n  spanning ** lines\r\n */ b\n"
+        "        \t\t        \n\n\n                  c // line comment\n"
+        "\r\n\r\n   d\xe2\x80\xa8" "e /*\xe2\x80\xa9*/ f\xc2\xa0g\n"
+        "// the end";
+    static const int lines[] = { 1, 3, 7, 10, 11, 12, 12 };
+    char buf[sizeof(body) + 16];
+    JSParseState s;
+    TokenList l;
+    int shift, i;
+
+    for(shift = 0; shift < 16; shift++) {
+        memset(buf, ' ', shift);
+        memcpy(buf + shift, body, sizeof(body));
+        TEST_ASSERT(lex(ctx, buf, FALSE, &l) == 0);
+        TEST_ASSERT(l.count == countof(lines));
+        for(i = 0; i < l.count; i++) {
+            TEST_ASSERT(l.val[i] == TOK_IDENT);
+            TEST_ASSERT(l.line[i] == lines[i]);
+        }
+    }
+
+    /* got_lf marks the tokens after a line terminator */
+    js_parse_init(ctx, &s, "x /*\n*/ y z", 11, "test.js");
+    TEST_ASSERT(next_token(&s) == 0 && s.got_lf == FALSE);
+    TEST_ASSERT(next_token(&s) == 0 && s.got_lf == TRUE);
+    TEST_ASSERT(next_token(&s) == 0 && s.got_lf == FALSE);
+    js_parse_free(&s);
+
+    /* shebang */
+    check_tokens(ctx, "#!/usr/bin/env qjs\nx", (const int []){ TOK_IDENT }, 1);
+    check_error(ctx, "x\n/* never closed\n\n", FALSE, "unexpected end of comment", 4);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+
+    test_punctuators(ctx);
+    test_identifiers(ctx);
+    test_numbers(ctx);
+    test_strings(ctx);
+    test_templates_regexps(ctx);
+    test_blanks(ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
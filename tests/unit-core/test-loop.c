@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "context.h"
+#include "qjs-port-loop.h"
+#include "test-common.h"
+
+#define TIMER_COUNT 2000
+
+static jerry_port_timer_wheel_t wheel;
+static uint64_t last_expire;
+static int fired_count;
+
+static void timer_cb(jerry_port_timer_t *timer_p)
+{
+    /* the expired timers run in order, at their tick */
+    TEST_ASSERT(timer_p->expire >= last_expire);
+    TEST_ASSERT(timer_p->expire == wheel.now - 1);
+    last_expire = timer_p->expire;
+    timer_p->user_p = (void *)1;
+    fired_count++;
+}
+
+static void count_cb(jerry_port_timer_t *timer_p)
+{
+    fired_count++;
+}
+
+static void test_wheel(void)
+{
+    static jerry_port_timer_t timers[TIMER_COUNT];
+    uint64_t start, now, expire;
+    int i, removed;
+
+    start = 1000003;
+    jerry_port_timer_wheel_init(&wheel, start);
+    TEST_ASSERT(jerry_port_timer_wheel_timeout(&wheel) == -1);
+    srand(1234);
+    for(i = 0; i < TIMER_COUNT; i++) {
+        /* every level, including the delays beyond the last one */
+        switch(i % 5) {
+        case 0: expire = start + rand() % 64; break;
+        case 1: expire = start + rand() % 4096; break;
+        case 2: expire = start + rand() % (1 << 18); break;
+        case 3: expire = start + rand() % (1 << 24); break;
+        default: expire = start + (1 << 24) + rand() % (1 << 24); break;
+        }
+        timers[i].cb = timer_cb;
+        jerry_port_timer_add(&wheel, &timers[i], expire);
+    }
+    TEST_ASSERT(wheel.count == TIMER_COUNT);
+    removed = 0;
+    for(i = 0; i < TIMER_COUNT; i += 7) {
+        jerry_port_timer_remove(&wheel, &timers[i]);
+        removed++;
+    }
+    TEST_ASSERT(jerry_port_timer_wheel_timeout(&wheel) >= 0);
+
+    now = start;
+    while (wheel.count != 0) {
+        now += 1 + rand() % 5000;
+        jerry_port_timer_wheel_advance(&wheel, now);
+        /* no pending timer has expired */
+        for(i = 0; i < TIMER_COUNT; i++) {
+            if (timers[i].is_pending)
+                TEST_ASSERT(timers[i].expire > now);
+            else if (timers[i].user_p)
+                TEST_ASSERT(timers[i].expire <= now);
+        }
+    }
+    TEST_ASSERT(fired_count == TIMER_COUNT - removed);
+    for(i = 0; i < TIMER_COUNT; i++)
+        TEST_ASSERT((timers[i].user_p != NULL) == (i % 7 != 0));
+
+    /* already expired timers run at the next advance */
+    timers[0].cb = count_cb;
+    jerry_port_timer_add(&wheel, &timers[0], 0);
+    TEST_ASSERT(jerry_port_timer_wheel_timeout(&wheel) == 0);
+    TEST_ASSERT(jerry_port_timer_wheel_advance(&wheel, wheel.now) == 1);
+    TEST_ASSERT(wheel.count == 0);
+}
+
+static int pipe_events;
+
+static void pipe_cb(jerry_port_loop_t *loop_p, int fd, uint32_t events, void *user_p)
+{
+    char c;
+
+    TEST_ASSERT(user_p == &pipe_events);
+    TEST_ASSERT(read(fd, &c, 1) == 1);
+    pipe_events++;
+    jerry_port_loop_watch_fd(loop_p, fd, 0, NULL, NULL);
+}
+
+static ssize_t io_result;
+
+static void io_cb(jerry_port_io_t *io_p, ssize_t result)
+{
+    TEST_ASSERT(io_p->result == result);
+    io_result = result;
+}
+
+static void test_loop_io(jerry_port_loop_t *loop_p, const char *path)
+{
+    jerry_port_io_t io;
+    char buf[64];
+    int fds[2], fd;
+
+    TEST_ASSERT(pipe(fds) == 0);
+    TEST_ASSERT(jerry_port_loop_watch_fd(loop_p, fds[0], JERRY_PORT_LOOP_READ,
+                                         pipe_cb, &pipe_events) == 0);
+    /* nothing to read: the timeout expires */
+    TEST_ASSERT(jerry_port_loop_run_once(loop_p, 1) == 1);
+    TEST_ASSERT(pipe_events == 0);
+    TEST_ASSERT(write(fds[1], "x", 1) == 1);
+    TEST_ASSERT(jerry_port_loop_run(loop_p) == 0);
+    TEST_ASSERT(pipe_events == 1);
+    close(fds[0]);
+    close(fds[1]);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    TEST_ASSERT(fd >= 0);
+    memset(&io, 0, sizeof(io));
+    io.cb = io_cb;
+    io_result = -1;
+    jerry_port_loop_write(loop_p, &io, fd, "hello loop", 10, 0);
+    /* the callback is never called before the loop runs */
+    TEST_ASSERT(io_result == -1);
+    TEST_ASSERT(jerry_port_loop_run(loop_p) == 0);
+    TEST_ASSERT(io_result == 10);
+    jerry_port_loop_read(loop_p, &io, fd, buf, sizeof(buf), 6);
+    jerry_port_loop_run(loop_p);
+    TEST_ASSERT(io_result == 4);
+    TEST_ASSERT(memcmp(buf, "loop", 4) == 0);
+    close(fd);
+}
+
+static int call_count;
+static char read_data[64];
+static char read_error[64];
+
+static JSValue js_count(JSContext *ctx, JSValueConst this_val,
+                        int argc, JSValueConst *argv)
+{
+    call_count++;
+    return JS_UNDEFINED;
+}
+
+static JSValue js_stop(JSContext *ctx, JSValueConst this_val,
+                       int argc, JSValueConst *argv)
+{
+    JSValue global, func, id;
+
+    /* clear both intervals after 3 calls */
+    if (call_count < 3)
+        return JS_UNDEFINED;
+    global = JS_GetGlobalObject(ctx);
+    func = JS_GetPropertyStr(ctx, global, "clearInterval");
+    id = JS_GetPropertyStr(ctx, global, "interval_id");
+    JS_FreeValue(ctx, JS_Call(ctx, func, JS_UNDEFINED, 1, &id));
+    id = JS_GetPropertyStr(ctx, global, "stop_id");
+    JS_FreeValue(ctx, JS_Call(ctx, func, JS_UNDEFINED, 1, &id));
+    JS_FreeValue(ctx, func);
+    JS_FreeValue(ctx, global);
+    return JS_UNDEFINED;
+}
+
+static JSValue js_on_read(JSContext *ctx, JSValueConst this_val,
+                          int argc, JSValueConst *argv)
+{
+    const char *str;
+    char *dst = JS_IsNull(argv[0]) ? read_data : read_error;
+
+    str = JS_ToCString(ctx, JS_IsNull(argv[0]) ? argv[1] : argv[0]);
+    TEST_ASSERT(str != NULL);
+    snprintf(dst, sizeof(read_data), "%s", str);
+    JS_FreeCString(ctx, str);
+    return JS_UNDEFINED;
+}
+
+static JSValue js_throw(JSContext *ctx, JSValueConst this_val,
+                        int argc, JSValueConst *argv)
+{
+    return JS_ThrowTypeError(ctx, "from timer");
+}
+
+static JSValue call_global(JSContext *ctx, const char *name,
+                           int argc, JSValueConst *argv)
+{
+    JSValue global, func, res;
+
+    global = JS_GetGlobalObject(ctx);
+    func = JS_GetPropertyStr(ctx, global, name);
+    res = JS_Call(ctx, func, JS_UNDEFINED, argc, argv);
+    JS_FreeValue(ctx, func);
+    JS_FreeValue(ctx, global);
+    return res;
+}
+
+static void test_scripts(jerry_port_loop_t *loop_p, JSContext *ctx,
+                         const char *path)
+{
+    JSValue global, count, stop, args[2], id;
+    uint64_t t0;
+
+    TEST_ASSERT(jerry_port_loop_add_intrinsics(ctx) == 0);
+    global = JS_GetGlobalObject(ctx);
+    count = JS_NewCFunction(ctx, js_count, "count", 0);
+    stop = JS_NewCFunction(ctx, js_stop, "stop", 0);
+
+    /* a cancelled timeout never runs */
+    args[0] = count;
+    args[1] = JS_NewInt32(ctx, 5);
+    id = call_global(ctx, "setTimeout", 2, args);
+    TEST_ASSERT(JS_VALUE_GET_TAG(id) == JS_TAG_INT);
+    TEST_ASSERT(JS_IsUndefined(call_global(ctx, "clearTimeout", 1, &id)));
+    /* stale ids are ignored */
+    TEST_ASSERT(JS_IsUndefined(call_global(ctx, "clearTimeout", 1, &id)));
+    jerry_port_loop_run(loop_p);
+    TEST_ASSERT(call_count == 0);
+
+    /* three interval calls, then the stop timer clears the intervals */
+    t0 = jerry_port_loop_now(loop_p);
+    args[1] = JS_NewInt32(ctx, 2);
+    id = call_global(ctx, "setInterval", 2, args);
+    JS_SetPropertyStr(ctx, global, "interval_id", id);
+    args[0] = stop;
+    args[1] = JS_NewInt32(ctx, 1);
+    JS_SetPropertyStr(ctx, global, "stop_id", call_global(ctx, "setInterval", 2, args));
+    args[0] = JS_NewCFunction(ctx, js_throw, "throw", 0);
+    args[1] = JS_NewInt32(ctx, 0);
+    JS_FreeValue(ctx, call_global(ctx, "setTimeout", 2, args));
+    JS_FreeValue(ctx, args[0]);
+    /* the loop ends when both intervals are cleared. A late tick may
+       have queued more calls before the clear. */
+    TEST_ASSERT(jerry_port_loop_run(loop_p) == 0);
+    TEST_ASSERT(jerry_port_loop_now(loop_p) - t0 >= 5);
+    TEST_ASSERT(call_count >= 3);
+
+    /* file content and error */
+    args[0] = JS_NewString(ctx, path);
+    args[1] = JS_NewCFunction(ctx, js_on_read, "on_read", 2);
+    JS_FreeValue(ctx, call_global(ctx, "readFile", 2, args));
+    JS_FreeValue(ctx, args[0]);
+    args[0] = JS_NewString(ctx, "/nonexistent/file");
+    JS_FreeValue(ctx, call_global(ctx, "readFile", 2, args));
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeValue(ctx, args[1]);
+    TEST_ASSERT(jerry_port_loop_run(loop_p) == 0);
+    TEST_ASSERT_STR("hello loop", read_data);
+    TEST_ASSERT_STR("Error: No such file or directory", read_error);
+
+    /* the pending timers are released with the loop */
+    args[0] = count;
+    args[1] = JS_NewInt32(ctx, 100000);
+    JS_FreeValue(ctx, call_global(ctx, "setTimeout", 2, args));
+
+    JS_FreeValue(ctx, count);
+    JS_FreeValue(ctx, stop);
+    JS_FreeValue(ctx, global);
+}
+
+int main(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    jerry_port_loop_t *loop_p;
+    char path[64];
+
+    test_wheel();
+
+    snprintf(path, sizeof(path), "/tmp/test-loop-%d", (int)getpid());
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    loop_p = jerry_port_loop_new(rt);
+    TEST_ASSERT(loop_p != NULL);
+    TEST_ASSERT(jerry_port_loop_get(rt) == loop_p);
+    printf("io_uring: %s\n", jerry_port_loop_has_io_uring(loop_p) ? "yes" : "no");
+
+    test_loop_io(loop_p, path);
+    test_scripts(loop_p, ctx, path);
+    unlink(path);
+
+    jerry_port_loop_free(loop_p);
+    TEST_ASSERT(jerry_port_loop_get(rt) == NULL);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -4,11 +4,120 @@
 
 #include "qjs.h"
 #include "test-common.h"
+#include "context.h"
 #include "jmemory.h"
+#include "jsstring.h"
 
-int main(int argc, char **argv) {
-    int dump_memory = 1;
+static JSValue js_new_objects(JSContext *ctx, JSValueConst this_val,
+                              int argc, JSValueConst *argv)
+{
+    JSValue obj;
+    int i;
+
+    /* garbage only */
+    for(i = 0; i < 100; i++) {
+        obj = JS_NewObject(ctx);
+        if (JS_IsException(obj))
+            return obj;
+        JS_FreeValue(ctx, obj);
+    }
+    /* the rt level allocations are charged to the running context */
+    return JS_ConcatStrings(ctx, JS_NewString(ctx, "tenant "),
+                            JS_NewString(ctx, "string"));
+}
+
+static void test_context_accounting(JSRuntime *rt)
+{
+    JSContext *ctx1, *ctx2;
+    JSContextMemoryUsage u1, u2, base1, base2;
+    JSValue func, str, obj, exc, arr[64];
+    int i, n;
+
+    ctx1 = JS_NewContext(rt);
+    ctx2 = JS_NewContext(rt);
+    JS_ComputeContextMemoryUsage(ctx1, &base1);
+    JS_ComputeContextMemoryUsage(ctx2, &base2);
+    TEST_ASSERT(base1.malloc_count > 0);
+    TEST_ASSERT(base1.malloc_limit == -1);
+
+    /* a string of ctx1 freed in ctx2 is credited to ctx1 */
+    func = JS_NewCFunction(ctx1, js_new_objects, "new_objects", 0);
+    str = JS_Call(ctx2, func, JS_UNDEFINED, 0, NULL);
+    TEST_ASSERT(!JS_IsException(str));
+    JS_ComputeContextMemoryUsage(ctx1, &u1);
+    JS_ComputeContextMemoryUsage(ctx2, &u2);
+    TEST_ASSERT(u1.malloc_size > base1.malloc_size);
+    TEST_ASSERT(u2.malloc_size == base2.malloc_size);
+    JS_FreeValue(ctx2, str);
+    JS_FreeValue(ctx2, func);
+    JS_ComputeContextMemoryUsage(ctx1, &u1);
+    TEST_ASSERT(u1.malloc_count == base1.malloc_count);
+    TEST_ASSERT(u1.malloc_size == base1.malloc_size);
+
+    /* the limit only stops ctx2 */
+    JS_SetContextMemoryLimit(ctx2, base2.malloc_size + 4096);
+    n = 0;
+    for(i = 0; i < countof(arr); i++) {
+        arr[i] = JS_NewObject(ctx2);
+        if (JS_IsException(arr[i]))
+            break;
+        n++;
+    }
+    TEST_ASSERT(n > 0 && n < countof(arr));
+    exc = JS_GetException(ctx2);
+    JS_FreeValue(ctx2, exc);
+    JS_ComputeContextMemoryUsage(ctx2, &u2);
+    TEST_ASSERT(u2.malloc_size <= base2.malloc_size + 4096);
+    obj = JS_NewObject(ctx1);
+    TEST_ASSERT(JS_IsObject(obj));
+    JS_FreeValue(ctx1, obj);
+    for(i = 0; i < n; i++)
+        JS_FreeValue(ctx2, arr[i]);
+    obj = JS_NewObject(ctx2);
+    TEST_ASSERT(JS_IsObject(obj));
+
+    /* the account of ctx2 outlives it while its object is alive */
+    JS_FreeContext(ctx2);
+    JS_FreeValue(ctx1, obj);
+    JS_FreeContext(ctx1);
+}
+
+/* the objects and the shapes have no account header but the id of
+   their account, which is reused once the account is freed */
+static void test_account_ids(JSRuntime *rt)
+{
+    JSContext *ctx1, *ctx2;
+    JSContextMemoryUsage u1, base1;
+    JSValue obj;
+    int i;
+
+    ctx1 = JS_NewContext(rt);
+    JS_ComputeContextMemoryUsage(ctx1, &base1);
+    obj = JS_NewObject(ctx1);
+    TEST_ASSERT(JS_SetPropertyStr(ctx1, obj, "x", JS_NewInt32(ctx1, 1)) >= 0);
+    JS_ComputeContextMemoryUsage(ctx1, &u1);
+    TEST_ASSERT(u1.malloc_count > base1.malloc_count);
+    JS_FreeValue(ctx1, obj);
+    JS_ComputeContextMemoryUsage(ctx1, &u1);
+    TEST_ASSERT(u1.malloc_count == base1.malloc_count);
+    TEST_ASSERT(u1.malloc_size == base1.malloc_size);
 
+    /* an object freed after its context releases the account */
+    obj = JS_NewObject(ctx1);
+    JS_FreeContext(ctx1);
+    ctx2 = JS_NewContext(rt);
+    JS_FreeValue(ctx2, obj);
+    JS_FreeContext(ctx2);
+
+    /* more contexts than ids over time */
+    for(i = 0; i < JS_ACCOUNT_ID_MAX + 16; i++) {
+        ctx1 = JS_NewContextRaw(rt);
+        TEST_ASSERT(ctx1 != NULL);
+        JS_FreeContext(ctx1);
+    }
+}
+
+int main(int argc, char **argv) {
     JSRuntime *rt;
     JSContext *ctx;
     rt = JS_NewRuntime();
@@ -17,15 +126,37 @@ int main(int argc, char **argv) {
     JS_ComputeMemoryUsage(rt, &stats);
     JS_DumpMemoryUsage(stdout, &stats, rt);
 
+    /* the runtime also allocates the atom and shape tables */
+    int64_t before_count = stats.malloc_count;
     int64_t before_alloc = stats.malloc_size;
-    int64_t rt_size = def_malloc_funcs.js_malloc_usable_size(rt);
-    TEST_ASSERT(stats.malloc_count==1);
-    TEST_ASSERT(before_alloc==rt_size);
+    TEST_ASSERT(stats.atom_count > 0);
+
+    void *ptr = js_malloc_rt(rt, 4);
+    TEST_ASSERT(((uintptr_t)ptr % _Alignof(max_align_t)) == 0);
+    JS_ComputeMemoryUsage(rt, &stats);
+    JS_DumpMemoryUsage(stdout, &stats, rt);
 
-    js_malloc_rt(rt, 4);
+    TEST_ASSERT(stats.malloc_count == before_count + 1);
+    TEST_ASSERT(stats.malloc_size == before_alloc +
+                (int64_t)js_malloc_usable_size_rt(rt, ptr) +
+                JS_MALLOC_HEADER_SIZE + MALLOC_OVERHEAD);
+    js_free_rt(rt, ptr);
+
+    ctx = JS_NewContext(rt);
+    TEST_ASSERT(ctx != NULL);
     JS_ComputeMemoryUsage(rt, &stats);
     JS_DumpMemoryUsage(stdout, &stats, rt);
+    TEST_ASSERT(stats.obj_count > 0);
+    TEST_ASSERT(stats.shape_count > 0);
+    JS_FreeContext(ctx);
 
-    TEST_ASSERT(stats.malloc_count==2);
+    test_context_accounting(rt);
+    test_account_ids(rt);
+    /* the cycles of the freed contexts, and their accounts */
+    JS_RunGC(rt);
+    JS_ComputeMemoryUsage(rt, &stats);
+    TEST_ASSERT(stats.malloc_count == before_count);
 
+    JS_FreeRuntime(rt);
+    return 0;
 }
\ No newline at end of file
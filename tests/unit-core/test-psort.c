@@ -0,0 +1,55 @@
+#include "psort.h"
+#include "test-common.h"
+
+static uint32_t seed = 1;
+
+static uint32_t rand32(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 1;
+}
+
+static int cmp_u32(const void *a, const void *b, void *opaque)
+{
+    uint32_t v1 = *(const uint32_t *)a, v2 = *(const uint32_t *)b;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static void test_sort(JSThreadPool *tp, size_t n, uint32_t modulo)
+{
+    uint32_t *tab, *ref;
+    size_t i;
+
+    tab = malloc(sizeof(tab[0]) * (n + 1));
+    ref = malloc(sizeof(ref[0]) * (n + 1));
+    for (i = 0; i < n; i++)
+        tab[i] = ref[i] = rand32() % modulo;
+    rqsort(ref, n, sizeof(ref[0]), cmp_u32, NULL);
+    rqsort_parallel(tp, tab, n, sizeof(tab[0]), cmp_u32, NULL, 16);
+    TEST_ASSERT(memcmp(tab, ref, n * sizeof(tab[0])) == 0);
+    free(tab);
+    free(ref);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 0, 1, 15, 16, 17, 100, 1023, 100000 };
+    static const int thread_counts[] = { 1, 2, 3, 4, 7 };
+    JSThreadPool *tp;
+    size_t i;
+    int j;
+
+    for (j = 0; j < countof(thread_counts); j++) {
+        tp = js_thread_pool_new(thread_counts[j]);
+        TEST_ASSERT(tp != NULL);
+        TEST_ASSERT(js_thread_pool_get_thread_count(tp) == thread_counts[j]);
+        for (i = 0; i < countof(sizes); i++) {
+            test_sort(tp, sizes[i], 0xffffffff);
+            test_sort(tp, sizes[i], 10);
+        }
+        js_thread_pool_free(tp);
+    }
+    /* no pool: sequential path */
+    test_sort(NULL, 1000, 100);
+    return 0;
+}
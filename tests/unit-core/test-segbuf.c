@@ -0,0 +1,138 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "test-common.h"
+#include "cutils.h"
+
+static void check_content(SegBuf *s, const uint8_t *ref, size_t len)
+{
+    struct iovec iov[64];
+    size_t pos;
+    int i, n;
+
+    n = sbuf_to_iovec(s, iov, countof(iov));
+    TEST_ASSERT(n <= (int)countof(iov));
+    pos = 0;
+    for (i = 0; i < n; i++) {
+        TEST_ASSERT(pos + iov[i].iov_len <= len);
+        TEST_ASSERT(memcmp(iov[i].iov_base, ref + pos, iov[i].iov_len) == 0);
+        pos += iov[i].iov_len;
+    }
+    TEST_ASSERT(pos == len);
+}
+
+int main(int argc, char **argv) {
+    SegBuf s;
+    DynBuf d;
+    uint8_t *ref, *first_chunk_data, *out;
+    size_t len, i, pos, pipe_len, remaining;
+    int fds[2];
+    ssize_t ret;
+
+    /* reference content: several chunks worth of data */
+    len = 3 * SBUF_CHUNK_SIZE_MAX + 12345;
+    ref = malloc(len);
+    TEST_ASSERT(ref != NULL);
+    for (i = 0; i < len; i++)
+        ref[i] = (uint8_t)(i * 7 + (i >> 9));
+
+    sbuf_init(&s);
+    pos = 0;
+    TEST_ASSERT(sbuf_putc(&s, ref[pos]) == 0);
+    pos++;
+    first_chunk_data = s.first->data;
+    /* odd sized writes so that chunk boundaries are crossed */
+    while (pos < len) {
+        size_t l = min_int64(len - pos, 1 + (pos % 5000));
+        TEST_ASSERT(sbuf_put(&s, ref + pos, l) == 0);
+        pos += l;
+    }
+    TEST_ASSERT(!sbuf_error(&s));
+    TEST_ASSERT(s.size == len);
+    /* existing data is never moved */
+    TEST_ASSERT(s.first->data == first_chunk_data);
+    TEST_ASSERT(s.chunk_count < 16);
+    check_content(&s, ref, len);
+
+    /* flatten */
+    dbuf_init(&d);
+    TEST_ASSERT(sbuf_to_dbuf(&s, &d) == 0);
+    TEST_ASSERT(d.size == len && memcmp(d.buf, ref, len) == 0);
+    dbuf_free(&d);
+    sbuf_free(&s);
+
+    /* formatted output, including the slow path */
+    sbuf_init(&s);
+    sbuf_printf(&s, "%d-%s", 42, "abc");
+    memset(ref, 'x', 300);
+    ref[300] = '\0';
+    sbuf_printf(&s, "[%s]", (char *)ref);
+    sbuf_put_u32(&s, 0x64636261);
+    dbuf_init(&d);
+    sbuf_to_dbuf(&s, &d);
+    dbuf_putc(&d, '\0');
+    TEST_ASSERT(d.size == 6 + 302 + 4 + 1);
+    TEST_ASSERT(memcmp(d.buf, "42-abc[x", 8) == 0);
+    TEST_ASSERT_STR("x]abcd", (char *)d.buf + 6 + 302 - 2);
+    dbuf_free(&d);
+    sbuf_free(&s);
+
+    /* writev flush through a pipe */
+    TEST_ASSERT(pipe(fds) == 0);
+    sbuf_init(&s);
+    for (i = 0; i < 3000; i++)
+        sbuf_printf(&s, "%04d", (int)(i % 10000));
+    ret = sbuf_writev(&s, fds[1]);
+    TEST_ASSERT(ret == 12000);
+    TEST_ASSERT(s.size == 0 && s.first == NULL);
+    close(fds[1]);
+    pos = 0;
+    while ((ret = read(fds[0], ref + pos, len - pos)) > 0)
+        pos += ret;
+    close(fds[0]);
+    TEST_ASSERT(pos == 12000);
+    TEST_ASSERT(memcmp(ref, "000000010002", 12) == 0);
+    TEST_ASSERT(memcmp(ref + 11996, "2999", 4) == 0);
+    sbuf_free(&s);
+
+    /* a full non-blocking pipe: the written bytes are removed from the
+       buffer and the remaining ones are sent by the next calls */
+    TEST_ASSERT(pipe(fds) == 0);
+    TEST_ASSERT(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+    TEST_ASSERT(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    sbuf_init(&s);
+    for (i = 0; i < len; i++)
+        ref[i] = (uint8_t)(i * 13 + (i >> 11));
+    pipe_len = 1 << 20;
+    TEST_ASSERT(sbuf_put(&s, ref, pipe_len) == 0);
+    out = malloc(pipe_len);
+    TEST_ASSERT(out != NULL);
+    ret = sbuf_writev(&s, fds[1]);
+    TEST_ASSERT(ret > 0 && ret < pipe_len);
+    TEST_ASSERT(s.size == pipe_len - ret);
+    remaining = s.size;
+    ret = sbuf_writev(&s, fds[1]);
+    TEST_ASSERT(ret == -1 && errno == EAGAIN);
+    TEST_ASSERT(s.size == remaining);
+    pos = 0;
+    for (;;) {
+        ret = read(fds[0], out + pos, pipe_len - pos);
+        if (ret > 0)
+            pos += ret;
+        if (s.size == 0 && pos == pipe_len)
+            break;
+        ret = sbuf_writev(&s, fds[1]);
+        TEST_ASSERT(ret > 0 || errno == EAGAIN);
+    }
+    TEST_ASSERT(memcmp(out, ref, pipe_len) == 0);
+    TEST_ASSERT(s.first == NULL);
+    close(fds[0]);
+    close(fds[1]);
+    free(out);
+    sbuf_free(&s);
+
+    free(ref);
+    return 0;
+}
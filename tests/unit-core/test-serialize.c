@@ -0,0 +1,218 @@
+#include "qjs.h"
+#include "test-common.h"
+#include "bytecode.h"
+
+static const char test_source[] =
+    "var s = 'h\\u00e9llo', n = 1.5, big = 1e300;\n"
+    "function f(a, b = 2) {\n"
+    "  let c = a + b;\n"
+    "  try { c++; } catch (e) { return e; } finally { c--; }\n"
+    "  return () => c + this.x;\n"
+    "}\n"
+    "for (var i = 0; i < 10; i++)\n"
+    "  s += f(i, -100000);\n";
+
+static char *dump_function(JSContext *ctx, JSValueConst val)
+{
+    DynBuf dbuf;
+
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_FUNCTION_BYTECODE);
+    dbuf_init(&dbuf);
+    js_dump_function_bytecode(ctx, &dbuf, JS_VALUE_GET_PTR(val));
+    dbuf_putc(&dbuf, '\0');
+    TEST_ASSERT(!dbuf_error(&dbuf));
+    return (char *)dbuf.buf;
+}
+
+static void test_round_trip(JSContext *ctx, int eval_flags, int read_flags)
+{
+    JSValue val, val2;
+    uint8_t *buf, *buf2;
+    size_t size, size2;
+    char *dump, *dump2;
+
+    val = JS_Eval(ctx, test_source, strlen(test_source), "test.js",
+                  eval_flags | JS_EVAL_FLAG_COMPILE_ONLY);
+    dump = dump_function(ctx, val);
+    buf = JS_WriteObject(ctx, &size, val, JS_WRITE_OBJ_BYTECODE);
+    TEST_ASSERT(buf != NULL);
+    JS_FreeValue(ctx, val);
+
+    val2 = JS_ReadObject(ctx, buf, size, read_flags);
+    dump2 = dump_function(ctx, val2);
+    TEST_ASSERT_STR(dump, dump2);
+    TEST_ASSERT(js_bytecode_find_line_num(JS_VALUE_GET_PTR(val2), 0) == 1);
+
+    /* the output is stable */
+    buf2 = JS_WriteObject(ctx, &size2, val2, JS_WRITE_OBJ_BYTECODE);
+    TEST_ASSERT(buf2 != NULL);
+    TEST_ASSERT(size2 == size && !memcmp(buf, buf2, size));
+    /* the lazy functions are compiled from the source read */
+    val2 = JS_EvalFunction(ctx, val2);
+    TEST_ASSERT(!JS_IsException(val2));
+    JS_FreeValue(ctx, val2);
+
+    js_free_rt(JS_GetRuntime(ctx), buf2);
+    js_free_rt(JS_GetRuntime(ctx), buf);
+    free(dump2);
+    free(dump);
+}
+
+static void test_values(JSContext *ctx)
+{
+    JSValue val;
+    uint8_t *buf;
+    size_t size;
+    const char *str;
+
+    buf = JS_WriteObject(ctx, &size, JS_NewInt32(ctx, -123456), 0);
+    val = JS_ReadObject(ctx, buf, size, 0);
+    TEST_ASSERT(JS_VALUE_GET_TAG(val) == JS_TAG_INT);
+    TEST_ASSERT(JS_VALUE_GET_INT(val) == -123456);
+    js_free_rt(JS_GetRuntime(ctx), buf);
+
+    val = JS_NewString(ctx, "h\xc3\xa9llo");
+    buf = JS_WriteObject(ctx, &size, val, 0);
+    JS_FreeValue(ctx, val);
+    val = JS_ReadObject(ctx, buf, size, 0);
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT_STR("h\xc3\xa9llo", str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+    js_free_rt(JS_GetRuntime(ctx), buf);
+
+    /* the functions are only written and read when allowed */
+    val = JS_Eval(ctx, "1", 1, "test.js", JS_EVAL_FLAG_COMPILE_ONLY);
+    buf = JS_WriteObject(ctx, &size, val, 0);
+    TEST_ASSERT(buf == NULL);
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    buf = JS_WriteObject(ctx, &size, val, JS_WRITE_OBJ_BYTECODE);
+    JS_FreeValue(ctx, val);
+    val = JS_ReadObject(ctx, buf, size, 0);
+    TEST_ASSERT(JS_IsException(val));
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    js_free_rt(JS_GetRuntime(ctx), buf);
+}
+
+/* truncated or corrupted buffers are rejected or give a valid function */
+static void test_invalid(JSContext *ctx, int read_flags)
+{
+    JSValue val;
+    uint8_t *buf, *buf2;
+    size_t size, i;
+    int bit;
+
+    val = JS_Eval(ctx, test_source, strlen(test_source), "test.js",
+                  JS_EVAL_FLAG_COMPILE_ONLY);
+    buf = JS_WriteObject(ctx, &size, val, JS_WRITE_OBJ_BYTECODE);
+    TEST_ASSERT(buf != NULL);
+    JS_FreeValue(ctx, val);
+    buf2 = malloc(size);
+    TEST_ASSERT(buf2 != NULL);
+
+    for(i = 0; i < size; i++) {
+        memcpy(buf2, buf, i);
+        val = JS_ReadObject(ctx, buf2, i, read_flags);
+        TEST_ASSERT(JS_IsException(val));
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    for(i = 0; i < size; i++) {
+        for(bit = 0; bit < 8; bit += 3) {
+            memcpy(buf2, buf, size);
+            buf2[i] ^= 1 << bit;
+            val = JS_ReadObject(ctx, buf2, size, read_flags);
+            if (JS_IsException(val))
+                JS_FreeValue(ctx, JS_GetException(ctx));
+            else
+                JS_FreeValue(ctx, val);
+        }
+    }
+    free(buf2);
+    js_free_rt(JS_GetRuntime(ctx), buf);
+}
+
+static int stop_interrupt_handler(JSRuntime *rt, void *opaque)
+{
+    return ++*(int *)opaque >= 100;
+}
+
+/* the opcodes which change the stack inside a finally block must be
+   rejected by the verifier: ret would pop a value which is not the
+   return address pushed by gosub */
+static void test_finally_mutations(JSContext *ctx)
+{
+    static const char source[] =
+        "function f(a) {\n"
+        "  var r = 0;\n"
+        "  try { r = a[0]; } finally { r += a[1] + a[r]; }\n"
+        "  return r;\n"
+        "}\n"
+        "f([1, 2, 3]);\n";
+    static const uint8_t ops[] = {
+        OP_push_1, OP_push_i32, OP_undefined, OP_drop, OP_dup, OP_nip,
+        OP_swap, OP_ret,
+    };
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    JSValue val;
+    uint8_t *buf, *buf2;
+    size_t size, i, j;
+    int poll_count, run_count;
+
+    val = JS_Eval(ctx, source, strlen(source), "finally.js",
+                  JS_EVAL_FLAG_COMPILE_ONLY);
+    buf = JS_WriteObject(ctx, &size, val, JS_WRITE_OBJ_BYTECODE);
+    TEST_ASSERT(buf != NULL);
+    JS_FreeValue(ctx, val);
+    buf2 = malloc(size);
+    TEST_ASSERT(buf2 != NULL);
+
+    /* the accepted mutations are run, a loop is stopped by the
+       interrupt handler */
+    JS_SetInterruptHandler(rt, stop_interrupt_handler, &poll_count);
+    run_count = 0;
+    for(i = 0; i < size; i++) {
+        for(j = 0; j < countof(ops); j++) {
+            if (buf[i] == ops[j])
+                continue;
+            memcpy(buf2, buf, size);
+            buf2[i] = ops[j];
+            val = JS_ReadObject(ctx, buf2, size, JS_READ_OBJ_BYTECODE);
+            if (!JS_IsException(val)) {
+                poll_count = 0;
+                val = JS_EvalFunction(ctx, val);
+                run_count++;
+            }
+            if (JS_IsException(val))
+                JS_FreeValue(ctx, JS_GetException(ctx));
+            else
+                JS_FreeValue(ctx, val);
+        }
+    }
+    JS_SetInterruptHandler(rt, NULL, NULL);
+    TEST_ASSERT(run_count > 0);
+    free(buf2);
+    js_free_rt(rt, buf);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+
+    test_round_trip(ctx, 0, JS_READ_OBJ_BYTECODE);
+    test_round_trip(ctx, 0, JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
+    test_round_trip(ctx, JS_EVAL_FLAG_EAGER, JS_READ_OBJ_BYTECODE);
+    test_round_trip(ctx, JS_EVAL_FLAG_EAGER,
+                    JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
+    test_values(ctx);
+    test_invalid(ctx, JS_READ_OBJ_BYTECODE);
+    test_invalid(ctx, JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
+    test_finally_mutations(ctx);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <math.h>
+#include "cutils.h"
+#include "test-common.h"
+
+typedef struct {
+    uint32_t key;
+    uint32_t index;
+} Pair;
+
+static uint32_t seed = 12345;
+
+static uint32_t rand32(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 1;
+}
+
+static int pair_cmp(const void *a, const void *b, void *opaque)
+{
+    const Pair *p1 = a, *p2 = b;
+    return (p1->key > p2->key) - (p1->key < p2->key);
+}
+
+static void check_stable(Pair *tab, size_t n)
+{
+    size_t i;
+    for (i = 1; i < n; i++) {
+        TEST_ASSERT(tab[i - 1].key <= tab[i].key);
+        if (tab[i - 1].key == tab[i].key)
+            TEST_ASSERT(tab[i - 1].index < tab[i].index);
+    }
+}
+
+static void test_stable(size_t n, int pattern)
+{
+    Pair *tab;
+    size_t i;
+
+    tab = malloc(sizeof(tab[0]) * (n + 1));
+    for (i = 0; i < n; i++) {
+        switch (pattern) {
+        case 0: /* random, many duplicates */
+            tab[i].key = rand32() % 16;
+            break;
+        case 1: /* sorted */
+            tab[i].key = i / 3;
+            break;
+        case 2: /* reversed */
+            tab[i].key = (n - i) / 3;
+            break;
+        default: /* sorted runs with random tail */
+            tab[i].key = (i % 1000 < 900) ? i % 1000 : rand32();
+            break;
+        }
+        tab[i].index = i;
+    }
+    TEST_ASSERT(rqsort_stable(tab, n, sizeof(tab[0]), pair_cmp, NULL) == 0);
+    check_stable(tab, n);
+    free(tab);
+}
+
+static void test_radix(size_t n)
+{
+    uint32_t *u = malloc(sizeof(u[0]) * n);
+    int32_t *s = malloc(sizeof(s[0]) * n);
+    double *d = malloc(sizeof(d[0]) * n);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        u[i] = rand32() ^ (rand32() << 16);
+        s[i] = (int32_t)u[i];
+        d[i] = (double)s[i] / 7.0;
+    }
+    if (n >= 4) {
+        d[0] = NAN;
+        d[1] = -0.0;
+        d[2] = 0.0;
+        d[3] = -INFINITY;
+    }
+    TEST_ASSERT(radix_sort_u32(u, n) == 0);
+    TEST_ASSERT(radix_sort_i32(s, n) == 0);
+    TEST_ASSERT(radix_sort_f64(d, n) == 0);
+    for (i = 1; i < n; i++) {
+        TEST_ASSERT(u[i - 1] <= u[i]);
+        TEST_ASSERT(s[i - 1] <= s[i]);
+        if (i < n - 1)
+            TEST_ASSERT(d[i - 1] <= d[i]);
+    }
+    if (n >= 4) {
+        TEST_ASSERT(isnan(d[n - 1]));
+        TEST_ASSERT(d[0] == -INFINITY);
+        for (i = 1; i < n - 1; i++) {
+            if (d[i] == 0 && d[i - 1] == 0)
+                TEST_ASSERT(signbit(d[i - 1]) && !signbit(d[i]));
+        }
+    }
+    free(u);
+    free(s);
+    free(d);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 0, 1, 2, 31, 32, 33, 100, 1000, 100000 };
+    size_t i;
+    int pattern;
+
+    for (i = 0; i < countof(sizes); i++) {
+        for (pattern = 0; pattern < 4; pattern++)
+            test_stable(sizes[i], pattern);
+        test_radix(sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "qjs.h"
+#include "test-common.h"
+
+static void check_eval(JSContext *ctx, const char *source,
+                       const char *expected)
+{
+    JSValue val;
+    const char *str;
+
+    val = JS_Eval(ctx, source, strlen(source), "test.js", 0);
+    if (JS_IsException(val))
+        val = JS_GetException(ctx);
+    str = JS_ToCString(ctx, val);
+    TEST_ASSERT(str != NULL);
+    if (strcmp(str, expected) != 0)
+        printf("%s\n-> %s\n", source, str);
+    TEST_ASSERT_STR(expected, str);
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, val);
+}
+
+static void test_elements(JSContext *ctx)
+{
+    /* the conversions of the stored numbers */
+    check_eval(ctx, "var a = new Uint8Array(4); a[0] = 257; a[1] = -1; a[2] = 3.7; a[3] = '12';\n"
+               "a[0] + ',' + a[1] + ',' + a[2] + ',' + a[3]", "1,255,3,12");
+    check_eval(ctx, "var c = new Uint8ClampedArray(6); c[0] = 300; c[1] = -5; c[2] = 1.5;\n"
+               "c[3] = 2.5; c[4] = 0 / 0; c[5] = 254.6;\n"
+               "c[0] + ',' + c[1] + ',' + c[2] + ',' + c[3] + ',' + c[4] + ',' + c[5]",
+               "255,0,2,2,0,255");
+    check_eval(ctx, "var i8 = new Int8Array(2), u16 = new Uint16Array(1), u32 = new Uint32Array(1);\n"
+               "i8[0] = 200; i8[1] = -129; u16[0] = -1; u32[0] = -1;\n"
+               "i8[0] + ',' + i8[1] + ',' + u16[0] + ',' + u32[0]", "-56,127,65535,4294967295");
+    check_eval(ctx, "var f = new Float32Array(2), d = new Float64Array(1);\n"
+               "f[0] = 0.1; f[1] = 16777217; d[0] = 0.1;\n"
+               "(f[0] == 0.1) + ',' + f[1] + ',' + d[0]", "false,16777216,0.1");
+    /* no elements out of the bounds */
+    check_eval(ctx, "var a = new Int32Array(2); a[2] = 5; a[-1] = 1;\n"
+               "a[2] + ',' + a.length + ',' + a[-1]", "undefined,2,1");
+    check_eval(ctx, "'use strict'; var a = new Int16Array(2); delete a[0]",
+               "TypeError: could not delete property '0'");
+    check_eval(ctx, "'use strict'; var a = new Int16Array(2); a.length = 5",
+               "TypeError: 'length' is read-only");
+    check_eval(ctx, "var a = new Float64Array(3), s = 0;\n"
+               "for (var i = 0; i < 3000; i++) { a[i % 3] += i; s += a[i % 3]; }\n"
+               "s + ':' + a[0] + ':' + a[1]", "1501500000:1498500:1499500");
+    check_eval(ctx, "var o = { valueOf: function() { return 42; } }, a = new Int32Array(1);\n"
+               "a[0] = o; a[0]", "42");
+}
+
+static void test_constructors(JSContext *ctx)
+{
+    check_eval(ctx, "var b = new ArrayBuffer(8), a = new Uint16Array(b, 2), c = new Uint8Array(b, 1, 3);\n"
+               "a.length + ',' + a.byteOffset + ',' + a.byteLength + ',' + (a.buffer === b) + ',' +\n"
+               "c.length + ',' + Uint16Array.BYTES_PER_ELEMENT + ',' + a.BYTES_PER_ELEMENT",
+               "3,2,6,true,3,2,2");
+    check_eval(ctx, "new Uint32Array(new ArrayBuffer(8), 2)",
+               "RangeError: invalid offset");
+    check_eval(ctx, "new Uint32Array(new ArrayBuffer(7))",
+               "RangeError: invalid length");
+    check_eval(ctx, "new Uint8Array(new ArrayBuffer(4), 1, 4)",
+               "RangeError: invalid length");
+    check_eval(ctx, "new Float64Array(-1)", "RangeError: invalid length");
+    check_eval(ctx, "Uint8Array(1)", "TypeError: constructor requires 'new'");
+    /* copies of the arrays and of the typed arrays */
+    check_eval(ctx, "var a = new Int8Array([1, -2, 300, 'x']), b = new Float32Array([0.5, 2]);\n"
+               "var c = new Uint8ClampedArray(new Int8Array([-3, 100])), d = new Int16Array(b);\n"
+               "a[0] + ',' + a[1] + ',' + a[2] + ',' + a[3] + ',' + b[0] + ',' + c[0] + ',' +\n"
+               "c[1] + ',' + d[0] + ',' + d[1]", "1,-2,44,0,0.5,0,100,0,2");
+    check_eval(ctx, "var a = new Uint8Array({ length: 2, 0: 7, 1: 8 }); a[0] * 10 + a[1]", "78");
+    check_eval(ctx, "var b = new ArrayBuffer(4), c = b.slice(1, -1); new Uint8Array(b)[1] = 9;\n"
+               "c.byteLength + ',' + new Uint8Array(c)[0] + ',' + new ArrayBuffer(3).slice(-2).byteLength",
+               "2,0,2");
+}
+
+static void test_methods(JSContext *ctx)
+{
+    /* fill: the byte patterns, the SIMD body and the tail */
+    check_eval(ctx, "var a = new Uint16Array(37).fill(0x1234, 1, -1);\n"
+               "a[0] + ',' + a[1] + ',' + a[35] + ',' + a[36]", "0,4660,4660,0");
+    check_eval(ctx, "var a = new Float64Array(9).fill(-1.5, 2), b = new Int32Array(5).fill(-1);\n"
+               "a[1] + ',' + a[2] + ',' + a[8] + ',' + b[4]", "0,-1.5,-1.5,-1");
+    check_eval(ctx, "var a = new Uint8ClampedArray(40).fill(999); a[39] + ',' + a[0]", "255,255");
+    /* indexOf: every element size, the start index and the values
+       which are not elements */
+    check_eval(ctx, "var a = new Uint8Array(100); a[77] = 5; a[90] = 5;\n"
+               "a.indexOf(5) + ',' + a.indexOf(5, 78) + ',' + a.indexOf(5, -10) + ',' +\n"
+               "a.indexOf(261) + ',' + a.indexOf('5') + ',' + a.indexOf(5.5)", "77,90,90,-1,-1,-1");
+    check_eval(ctx, "var a = new Int16Array(50), b = new Int32Array(50), c = new Uint32Array(50);\n"
+               "a[41] = -2; b[33] = -70000; c[9] = 4000000000;\n"
+               "a.indexOf(-2) + ',' + a.indexOf(65534) + ',' + b.indexOf(-70000) + ',' +\n"
+               "c.indexOf(4000000000) + ',' + c.indexOf(-294967296)", "41,-1,33,9,-1");
+    check_eval(ctx, "var f = new Float64Array(20), g = new Float32Array(20);\n"
+               "f[13] = 0.1; f[2] = -0; f[0] = 1; g[17] = 0.5; g[3] = 0 / 0;\n"
+               "f.indexOf(0.1) + ',' + f.indexOf(0) + ',' + f.indexOf(0, 1) + ',' + g.indexOf(0.5) + ',' +\n"
+               "g.indexOf(0.1) + ',' + g.indexOf(0 / 0) + ',' + f.indexOf(1)", "13,1,1,17,-1,-1,0");
+    check_eval(ctx, "var f = new Float64Array(20); f[7] = 2; f[7] = 0; f[19] = 3; f.indexOf(3)", "19");
+    /* set: same kind, conversion and overlapping views */
+    check_eval(ctx, "var a = new Uint8Array(8); a.set([1, 2, 3], 2); a.set(new Uint8Array([9]), 7);\n"
+               "a[2] + ',' + a[4] + ',' + a[7]", "1,3,9");
+    check_eval(ctx, "new Uint8Array(2).set([1, 2, 3])", "RangeError: invalid array length");
+    check_eval(ctx, "var b = new ArrayBuffer(8), u8 = new Uint8Array(b), u16 = new Uint16Array(b);\n"
+               "u8.set([1, 2, 3, 4]); u16.set(u8.subarray(0, 4));\n"
+               "u16[0] + ',' + u16[1] + ',' + u16[2] + ',' + u16[3]", "1,2,3,4");
+    check_eval(ctx, "var a = new Int32Array([1, 2, 3, 4, 5]); a.set(a.subarray(0, 3), 2);\n"
+               "a[2] + ',' + a[3] + ',' + a[4]", "1,2,3");
+    /* subarray: a view on the same buffer */
+    check_eval(ctx, "var a = new Int16Array([1, 2, 3, 4, 5]), s = a.subarray(1, -1); s[0] = 20;\n"
+               "s.length + ',' + s.byteOffset + ',' + a[1] + ',' + (s.buffer === a.buffer) + ',' +\n"
+               "a.subarray(4, 2).length + ',' + s.subarray(1)[0]", "3,2,20,true,0,3");
+}
+
+static void test_dataview(JSContext *ctx)
+{
+    check_eval(ctx, "var b = new ArrayBuffer(16), v = new DataView(b, 2), u8 = new Uint8Array(b);\n"
+               "v.setUint16(0, 0x1234); v.setUint32(2, 0x11223344, true); v.setFloat64(6, 1.5);\n"
+               "u8[2] + ',' + u8[3] + ',' + u8[4] + ',' + u8[7] + ',' + v.getUint16(0, true) + ',' +\n"
+               "v.getInt32(2) + ',' + v.getFloat64(6) + ',' + v.getInt8(0) + ',' + v.byteLength",
+               "18,52,68,17,13330,1144201745,1.5,18,14");
+    check_eval(ctx, "var v = new DataView(new ArrayBuffer(8));\n"
+               "v.setInt16(0, -2); v.setFloat32(4, 0.5, true);\n"
+               "v.getInt16(0) + ',' + v.getUint16(0) + ',' + v.getFloat32(4, true) + ',' +\n"
+               "v.getUint32(4) + ',' + v.getInt8(1)", "-2,65534,0.5,63,-2");
+    check_eval(ctx, "new DataView(new ArrayBuffer(4)).getUint32(1)",
+               "RangeError: out of bound");
+    check_eval(ctx, "new DataView(new ArrayBuffer(4), 5)",
+               "RangeError: invalid byteOffset");
+}
+
+static int free_count;
+
+static void free_host_buffer(JSRuntime *rt, void *opaque, void *ptr)
+{
+    TEST_ASSERT(opaque == &free_count);
+    free_count++;
+    free(ptr);
+}
+
+static void test_host_buffer(void)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+    JSMemoryUsage stats;
+    JSValue buf, global;
+    uint8_t *data, *ptr;
+    uint8_t bytes[4] = { 1, 2, 3, 4 };
+    size_t size;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    global = JS_GetGlobalObject(ctx);
+
+    /* the memory of the host is shared with the scripts */
+    data = malloc(64);
+    memset(data, 0, 64);
+    buf = JS_NewArrayBuffer(ctx, data, 64, free_host_buffer, &free_count);
+    TEST_ASSERT(!JS_IsException(buf));
+    ptr = JS_GetArrayBuffer(ctx, &size, buf);
+    TEST_ASSERT(ptr == data && size == 64);
+    JS_SetPropertyStr(ctx, global, "hb", buf);
+    data[10] = 42;
+    check_eval(ctx, "var u = new Uint8Array(hb); u[11] = u[10] + 1;\n"
+               "new Uint32Array(hb, 16).fill(0xdeadbeef); u[10]", "42");
+    TEST_ASSERT(data[11] == 43);
+    TEST_ASSERT(data[16] == 0xef && data[63] == 0xde);
+
+    /* the copies are not shared */
+    buf = JS_NewArrayBufferCopy(ctx, bytes, sizeof(bytes));
+    TEST_ASSERT(!JS_IsException(buf));
+    ptr = JS_GetArrayBuffer(ctx, &size, buf);
+    TEST_ASSERT(ptr != bytes && size == 4 && ptr[3] == 4);
+    JS_SetPropertyStr(ctx, global, "cb", buf);
+    check_eval(ctx, "new Uint8Array(cb)[0] = 9; new Uint8Array(cb)[0]", "9");
+    TEST_ASSERT(bytes[0] == 1);
+
+    /* the data of the typed arrays is counted once in its ArrayBuffer */
+    check_eval(ctx, "var big = new Float64Array(100), view = big.subarray(10); 0", "0");
+    JS_ComputeMemoryUsage(rt, &stats);
+    TEST_ASSERT(stats.binary_object_count == 3);
+    TEST_ASSERT(stats.binary_object_size == 64 + 4 + 800);
+
+    ptr = JS_GetArrayBuffer(ctx, &size, global);
+    TEST_ASSERT(ptr == NULL && size == 0);
+    JS_FreeValue(ctx, JS_GetException(ctx));
+
+    /* free_func runs once, when the ArrayBuffer is collected */
+    TEST_ASSERT(free_count == 0);
+    check_eval(ctx, "hb = undefined; u = undefined; 0", "0");
+    TEST_ASSERT(free_count == 1);
+    JS_FreeValue(ctx, global);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    TEST_ASSERT(free_count == 1);
+
+    /* no callback: the host keeps its memory */
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    buf = JS_NewArrayBuffer(ctx, bytes, sizeof(bytes), NULL, NULL);
+    TEST_ASSERT(!JS_IsException(buf));
+    JS_FreeValue(ctx, buf);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    TEST_ASSERT(bytes[0] == 1);
+}
+
+int main(int argc, char **argv)
+{
+    JSRuntime *rt;
+    JSContext *ctx;
+
+    rt = JS_NewRuntime();
+    ctx = JS_NewContext(rt);
+    test_elements(ctx);
+    test_constructors(ctx);
+    test_methods(ctx);
+    test_dataview(ctx);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    test_host_buffer();
+    return 0;
+}
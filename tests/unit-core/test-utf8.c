@@ -0,0 +1,138 @@
+#include "qjs.h"
+#include "test-common.h"
+#include "jsstring.h"
+
+/* decode 'buf' split in chunks of random sizes */
+static JSString *decode_chunked(JSRuntime *rt, const uint8_t *buf, size_t len,
+                                int max_chunk)
+{
+    StringBuffer b;
+    UTF8Decoder dec;
+    size_t pos, l;
+
+    string_buffer_init(rt, &b, 0);
+    utf8_decode_init(&dec);
+    for (pos = 0; pos < len; pos += l) {
+        l = 1 + rand() % max_chunk;
+        if (l > len - pos)
+            l = len - pos;
+        TEST_ASSERT(string_buffer_write_utf8(&b, &dec, buf + pos, l) == 0);
+    }
+    TEST_ASSERT(string_buffer_write_utf8_end(&b, &dec) == 0);
+    return string_buffer_end(&b);
+}
+
+static void check_decode(JSRuntime *rt, const char *input,
+                         const uint16_t *expected, int expected_len)
+{
+    JSString *str;
+    int i, chunk;
+
+    for (chunk = 1; chunk <= 4; chunk++) {
+        str = decode_chunked(rt, (const uint8_t *)input, strlen(input), chunk);
+        TEST_ASSERT(str != NULL);
+        TEST_ASSERT((int)str->len == expected_len);
+        for (i = 0; i < expected_len; i++) {
+            uint32_t c = str->is_wide_char ? str->u.str16[i] : str->u.str8[i];
+            TEST_ASSERT(c == expected[i]);
+        }
+        js_free_string_rt(rt, str);
+    }
+}
+
+int main(int argc, char **argv) {
+    JSRuntime *rt;
+    JSString *str;
+    DynBuf ref;
+    uint8_t utf8[UTF8_CHAR_LEN_MAX];
+    uint32_t cps[4096];
+    int i, j, n, len;
+
+    srand(42);
+    rt = JS_NewRuntime();
+
+    /* ASCII and Latin-1 stay 8 bit */
+    str = decode_chunked(rt, (const uint8_t *)"hello \xc3\xa9t\xc3\xa9", 11, 3);
+    TEST_ASSERT(str && !str->is_wide_char && str->len == 9);
+    TEST_ASSERT_STR("hello \xe9t\xe9", (char *)str->u.str8);
+    js_free_string_rt(rt, str);
+
+    {
+        /* BMP, astral (surrogate pair) */
+        static const uint16_t exp1[] = { 'a', 0x20ac, 0xd83d, 0xde00, 'b' };
+        check_decode(rt, "a\xe2\x82\xac\xf0\x9f\x98\x80" "b", exp1, countof(exp1));
+    }
+    {
+        /* invalid bytes, overlong forms, surrogates and truncated
+           sequences give one U+FFFD per maximal subpart */
+        static const uint16_t exp2[] = { 0xfffd, 'x', 0xfffd, 0xfffd, 'y',
+                                         0xfffd, 0xfffd, 0xfffd, 'z',
+                                         0xfffd, 'w', 0xfffd };
+        check_decode(rt, "\xff" "x" "\xc0\xaf" "y" "\xed\xa0\x80" "z"
+                     "\xe2\x82" "w" "\xf0\x9f\x98", exp2, countof(exp2));
+    }
+
+    /* random code points split at random positions */
+    for (j = 0; j < 50; j++) {
+        dbuf_init(&ref);
+        n = 1 + rand() % countof(cps);
+        for (i = 0; i < n; i++) {
+            uint32_t c;
+            do {
+                switch (rand() % 4) {
+                case 0: c = rand() % 0x80; break;
+                case 1: c = rand() % 0x800; break;
+                case 2: c = rand() % 0x10000; break;
+                default: c = rand() % 0x110000; break;
+                }
+            } while (c >= 0xd800 && c <= 0xdfff);
+            cps[i] = c;
+            len = unicode_to_utf8(utf8, c);
+            dbuf_put(&ref, utf8, len);
+        }
+        str = decode_chunked(rt, ref.buf, ref.size, 1 + rand() % 7);
+        TEST_ASSERT(str != NULL);
+        len = 0;
+        for (i = 0; i < n; i++) {
+            uint32_t c = cps[i];
+            if (c >= 0x10000) {
+                TEST_ASSERT(str->is_wide_char);
+                TEST_ASSERT(str->u.str16[len++] == 0xd800 + ((c - 0x10000) >> 10));
+                TEST_ASSERT(str->u.str16[len++] == 0xdc00 + ((c - 0x10000) & 0x3ff));
+            } else {
+                TEST_ASSERT((str->is_wide_char ? str->u.str16[len] : str->u.str8[len]) == c);
+                len++;
+            }
+        }
+        TEST_ASSERT((int)str->len == len);
+        js_free_string_rt(rt, str);
+        dbuf_free(&ref);
+    }
+
+    /* public API: one byte per chunk */
+    {
+        static const char input[] = "a\xe2\x82\xac\xf0\x9f\x98\x80" "b";
+        JSContext *ctx = JS_NewContext(rt);
+        JSStringDecoder *d;
+        JSValue val;
+        const char *cstr;
+
+        d = JS_NewStringDecoder(ctx);
+        TEST_ASSERT(d != NULL);
+        for (i = 0; i < (int)strlen(input); i++)
+            TEST_ASSERT(JS_StringDecoderWrite(d, input + i, 1) == 0);
+        val = JS_StringDecoderEnd(d);
+        TEST_ASSERT(JS_IsString(val));
+        cstr = JS_ToCString(ctx, val);
+        TEST_ASSERT_STR(input, cstr);
+        JS_FreeCString(ctx, cstr);
+        JS_FreeValue(ctx, val);
+        /* freed before the end */
+        d = JS_NewStringDecoder(ctx);
+        TEST_ASSERT(JS_StringDecoderWrite(d, input, 3) == 0);
+        JS_FreeStringDecoder(d);
+        JS_FreeContext(ctx);
+    }
+    JS_FreeRuntime(rt);
+    return 0;
+}